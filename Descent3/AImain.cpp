@@ -45,6 +45,7 @@
 #include "matcen.h"
 #include "PHYSICS.H"
 #include "difficulty.h"
+#include "rtperformance.h"
 #include "osiris_dll.h"
 #include "multi.h"
 #include "gamecinematics.h"
@@ -2723,110 +2724,247 @@ void AIInitAll()
 	mprintf((0, "Done Initializing AI systems\n"));
 }
 
-void AICheckTargetVis(object *obj)
+// Line of sight rays cast together for the robots by AIBatchTargetVis()
+typedef struct ai_vis_ray
+{
+	int frame;							// FrameCount the ray was cast on
+	int target_handle;
+	vector pos;							// Where the robot was
+	vector target_pos;				// Where the target was
+	int flags;							// fvi flags the ray was cast with
+	int fate;
+	int hit_object;
+} ai_vis_ray;
+
+static ai_vis_ray AI_vis_rays[MAX_OBJECTS];
+static int AI_vis_batch_frame = -1;	// FrameCount of the last batch
+
+#define AI_VIS_MAX_IGNORED				100
+#define AI_VIS_BATCH_IGNORE_POOL		4096
+
+// Sets up the line of sight ray from a robot to its target.  ignore_obj_list gets the robot, its
+// attached children and the -1 terminator.  Returns the number of list entries used.
+static int AIVisRaySetup(object *obj, object *target, fvi_query *fq, int *ignore_obj_list, int max_ignored)
 {
 	ai_frame *ai_info = obj->ai_info;
-	object *target = ObjGet(ai_info->target_handle);
+	int num_ignored = 1;
+	int i;
 
-	#ifdef _DEBUG
-	if(AI_debug_robot_do && OBJNUM(obj) == AI_debug_robot_index)
+	fq->p0 = &obj->pos;         
+	fq->p1 = &target->pos;
+	fq->startroom = obj->roomnum; 
+			
+	fq->rad   = 0.0f; 
+	fq->flags = FQ_CHECK_OBJS | FQ_IGNORE_POWERUPS | FQ_IGNORE_WEAPONS | FQ_NO_RELINK/* | FQ_IGNORE_MOVING_OBJECTS*/; 
+	if(ai_info->agression > .7f)
 	{
-		mprintf((0, "AI Note: Vis 1\n"));
+		fq->flags |= FQ_IGNORE_MOVING_OBJECTS;
 	}
-	#endif
 	
+	fq->thisobjnum = -1; 
+
+	ignore_obj_list[0] = OBJNUM(obj);
+
+	// CHRISHACK - ONLY IGNORES FIRST LEVEL OF CHILDREN - DO RECERSIVE
+	for(i = 0; i < Poly_models[obj->rtype.pobj_info.model_num].n_attach; i++)
+	{
+		object *child;
+		
+		if((child = ObjGet(obj->attach_children[i])) != NULL && num_ignored < max_ignored - 1)
+		{
+			ignore_obj_list[num_ignored++] = OBJNUM(child);
+		}
+	}
+
+	ignore_obj_list[num_ignored] = -1;
+	fq->ignore_obj_list = ignore_obj_list;
+
+	return num_ignored + 1;
+}
+
+// Checks everything that can stop a robot from seeing its target before a line of sight ray is
+// worth casting: field of view, distance, awareness and the target's visibility.  The rooms must
+// already be known to see each other.  Fills in the direction and distance to the target's aim
+// point.  Returns true if the ray should be cast.
+static bool AITargetVisPrecheck(object *obj, object *target, vector *vec_to_target, float *dist_to_target)
+{
+	ai_frame *ai_info = obj->ai_info;
+	vector pos;
+	vector fov_vec;
+
+	AIDetermineAimPoint(obj, target, &pos);
+	*vec_to_target = pos - obj->pos;
+	*dist_to_target = vm_NormalizeVector(vec_to_target);
+	*dist_to_target -= (obj->size + target->size);
+	if(*dist_to_target < 0.0f)
+		*dist_to_target = 0.0f;
+
+	AIDetermineFovVec(obj, &fov_vec);
+
+	if(*vec_to_target * fov_vec < ai_info->fov) 
+		return false;
 
 	#ifdef _DEBUG
-	if(!Game_do_ai_vis)
+	if(AI_debug_robot_do && OBJNUM(obj) == AI_debug_robot_index)
 	{
-		ai_info->status_reg &= ~AISR_SEES_GOAL;
-		ai_info->last_see_target_pos = obj->pos;
-		return;
+		mprintf((0, "AI Note: Vis 4\n"));
 	}
 	#endif
 
-	if(target == NULL)
+	if(*dist_to_target > MAX_TRACK_TARGET_DIST * Diff_ai_vis_dist[DIFF_LEVEL] && obj->roomnum != target->roomnum)
+		return false;
+
+	#ifdef _DEBUG
+	if(AI_debug_robot_do && OBJNUM(obj) == AI_debug_robot_index)
 	{
-		ai_info->status_reg &= ~AISR_SEES_GOAL;
-		ai_info->last_see_target_pos = obj->pos;
-		return;
+		mprintf((0, "AI Note: Vis 5\n"));
 	}
+	#endif
+
+	if(ai_info->awareness == AWARE_NONE && (target->roomnum != obj->roomnum) && *dist_to_target > MAX_SEE_TARGET_DIST * Diff_ai_vis_dist[DIFF_LEVEL]) 
+		return false;
 
 	#ifdef _DEBUG
 	if(AI_debug_robot_do && OBJNUM(obj) == AI_debug_robot_index)
 	{
-		mprintf((0, "AI Note: Vis 2\n"));
+		mprintf((0, "AI Note: Vis 6\n"));
 	}
 	#endif
 
-	if(!BOA_IsVisible(obj->roomnum, target->roomnum))
+	if((*dist_to_target > MAX_SEE_TARGET_DIST * Diff_ai_vis_dist[DIFF_LEVEL] && ai_info->awareness <= AWARE_BARELY && (target->roomnum != obj->roomnum)) || 
+		(target->type == OBJ_PLAYER && (Players[target->id].flags & (PLAYER_FLAGS_DEAD | PLAYER_FLAGS_DYING)))  || target->type == OBJ_GHOST ||
+			!AIDetermineObjVisLevel(obj, target)) 
 	{
-		ai_info->status_reg &= ~AISR_SEES_GOAL;
-		return;
+//.		mprintf((0, "No check vis\n"));
+		return false;
 	}
 
 	#ifdef _DEBUG
 	if(AI_debug_robot_do && OBJNUM(obj) == AI_debug_robot_index)
 	{
-		mprintf((0, "AI Note: Vis 3\n"));
+		mprintf((0, "AI Note: Vis 7\n"));
 	}
 	#endif
 
-	vector pos;
-	AIDetermineAimPoint(obj, target, &pos);
-	ai_info->vec_to_target_actual = pos - obj->pos;
-	ai_info->dist_to_target_actual = vm_NormalizeVector(&ai_info->vec_to_target_actual);
-	ai_info->dist_to_target_actual -= (obj->size + target->size);
-	if(ai_info->dist_to_target_actual < 0.0f)
-		ai_info->dist_to_target_actual = 0.0f;
+	return true;
+}
 
-	vector fov_vec;
-	AIDetermineFovVec(obj, &fov_vec);
+// Casts the line of sight rays for every robot from first_objnum on that AICheckTargetVis() expects
+// to cast one this frame, all in one fvi_FindIntersectionBatch() call.  It's called by the first
+// robot that needs a ray, from ObjDoFrameAll(), so the players and everything before that robot
+// have already moved and the rays use the positions the robots will see.  AICheckTargetVis() only
+// uses a ray if neither end has moved since and the ray hit a wall, because nothing else moving this
+// frame can change that.  Otherwise it casts its own ray as before.
+static void AIBatchTargetVis(int first_objnum)
+{
+	static fvi_query fq[MAX_OBJECTS];
+	static fvi_info hit_info[MAX_OBJECTS];
+	static int objnums[MAX_OBJECTS];
+	static int ignore_pool[AI_VIS_BATCH_IGNORE_POOL];
+	int num_rays = 0;
+	int num_ignore_used = 0;
+	int i;
+
+	AI_vis_batch_frame = FrameCount;
 
-	if(ai_info->vec_to_target_actual * fov_vec < ai_info->fov) 
+	#ifdef _DEBUG
+	if(!Game_do_ai_vis)
+		return;
+	#endif
+
+	if(Demo_flags == DF_PLAYBACK)
+		return;
+
+	// In the order ObjDoFrameAll() does them, so these are the robots that haven't thought yet
+	for(i = first_objnum; i != -1; i = ObjNextLive(i))
 	{
-		ai_info->status_reg &= ~AISR_SEES_GOAL;
+		object *obj = &Objects[i];
+		ai_frame *ai_info = obj->ai_info;
+
+		if(obj->type == OBJ_NONE || obj->type == OBJ_DUMMY || (obj->flags & OF_DEAD) || !ai_info)
+			continue;
+
+		if((obj->control_type != CT_AI && obj->control_type != CT_DYING_AND_AI) || (ai_info->flags & AIF_DISABLED))
+			continue;
+
+		if(!(ai_info->notify_flags & (0x00000001 << AIN_SEE_TARGET)))
+			continue;
+
+		if(Gametime - ai_info->last_see_target_time <= MIN_VIS_RECENT_CHECK_INTERVAL || Gametime < ai_info->next_check_see_target_time)
+			continue;
+
+		object *target = ObjGet(ai_info->target_handle);
+		vector vec_to_target;
+		float dist_to_target;
+
+		if(target == NULL || !BOA_IsVisible(obj->roomnum, target->roomnum) || !AITargetVisPrecheck(obj, target, &vec_to_target, &dist_to_target))
+			continue;
+
+		if(num_ignore_used + AI_VIS_MAX_IGNORED > AI_VIS_BATCH_IGNORE_POOL)
+			break;
+
+		num_ignore_used += AIVisRaySetup(obj, target, &fq[num_rays], &ignore_pool[num_ignore_used], AI_VIS_MAX_IGNORED);
+		objnums[num_rays++] = i;
+	}
+
+	if(num_rays == 0)
 		return;
+
+	fvi_FindIntersectionBatch(num_rays, fq, hit_info);
+
+	for(i = 0; i < num_rays; i++)
+	{
+		object *obj = &Objects[objnums[i]];
+		ai_vis_ray *ray = &AI_vis_rays[objnums[i]];
+
+		ray->frame = FrameCount;
+		ray->target_handle = obj->ai_info->target_handle;
+		ray->pos = obj->pos;
+		ray->target_pos = *fq[i].p1;
+		ray->flags = fq[i].flags;
+		ray->fate = hit_info[i].hit_type[0];
+		ray->hit_object = hit_info[i].hit_object[0];
 	}
+}
+
+void AICheckTargetVis(object *obj)
+{
+	ai_frame *ai_info = obj->ai_info;
+	object *target = ObjGet(ai_info->target_handle);
 
 	#ifdef _DEBUG
 	if(AI_debug_robot_do && OBJNUM(obj) == AI_debug_robot_index)
 	{
-		mprintf((0, "AI Note: Vis 4\n"));
+		mprintf((0, "AI Note: Vis 1\n"));
 	}
 	#endif
+	
 
-	if(ai_info->dist_to_target_actual > MAX_TRACK_TARGET_DIST * Diff_ai_vis_dist[DIFF_LEVEL] && (!ObjGet(ai_info->target_handle) || (obj->roomnum != ObjGet(ai_info->target_handle)->roomnum)))
+	#ifdef _DEBUG
+	if(!Game_do_ai_vis)
 	{
 		ai_info->status_reg &= ~AISR_SEES_GOAL;
+		ai_info->last_see_target_pos = obj->pos;
 		return;
 	}
-
-	#ifdef _DEBUG
-	if(AI_debug_robot_do && OBJNUM(obj) == AI_debug_robot_index)
-	{
-		mprintf((0, "AI Note: Vis 5\n"));
-	}
 	#endif
 
-	if(ai_info->awareness == AWARE_NONE && (target->roomnum != obj->roomnum) && ai_info->dist_to_target_actual > MAX_SEE_TARGET_DIST * Diff_ai_vis_dist[DIFF_LEVEL]) 
+	if(target == NULL)
 	{
 		ai_info->status_reg &= ~AISR_SEES_GOAL;
+		ai_info->last_see_target_pos = obj->pos;
 		return;
 	}
 
 	#ifdef _DEBUG
 	if(AI_debug_robot_do && OBJNUM(obj) == AI_debug_robot_index)
 	{
-		mprintf((0, "AI Note: Vis 6\n"));
+		mprintf((0, "AI Note: Vis 2\n"));
 	}
 	#endif
 
-	if((ai_info->dist_to_target_actual > MAX_SEE_TARGET_DIST * Diff_ai_vis_dist[DIFF_LEVEL] && ai_info->awareness <= AWARE_BARELY && (target->roomnum != obj->roomnum)) || 
-		(target->type == OBJ_PLAYER && (Players[target->id].flags & (PLAYER_FLAGS_DEAD | PLAYER_FLAGS_DYING)))  || target->type == OBJ_GHOST ||
-			!AIDetermineObjVisLevel(obj, target)) 
+	if(!BOA_IsVisible(obj->roomnum, target->roomnum))
 	{
-//.		mprintf((0, "No check vis\n"));
 		ai_info->status_reg &= ~AISR_SEES_GOAL;
 		return;
 	}
@@ -2834,10 +2972,16 @@ void AICheckTargetVis(object *obj)
 	#ifdef _DEBUG
 	if(AI_debug_robot_do && OBJNUM(obj) == AI_debug_robot_index)
 	{
-		mprintf((0, "AI Note: Vis 7\n"));
+		mprintf((0, "AI Note: Vis 3\n"));
 	}
 	#endif
 
+	if(!AITargetVisPrecheck(obj, target, &ai_info->vec_to_target_actual, &ai_info->dist_to_target_actual))
+	{
+		ai_info->status_reg &= ~AISR_SEES_GOAL;
+		return;
+	}
+
 	// Can I see the target?
 	if(Gametime - ai_info->last_see_target_time > MIN_VIS_RECENT_CHECK_INTERVAL)
 	{
@@ -2847,45 +2991,43 @@ void AICheckTargetVis(object *obj)
 			fvi_info hit_info;  
 			fvi_query fq;
 			int fate;
+			int hit_object;
 
 			//Project a ray and see if target is around. -- We can use a quick room check to see if we should even do it.  :) --chrishack (do this later when room structure is in the game)
 			// if we are in the same room, see see the target
 			//Do FVI_stuff (maybe just a room connection check)
 		
 		// shoot a ray from the light position to the current vertex
-			fq.p0 = &obj->pos;         
-			fq.p1 = &target->pos;
-			fq.startroom = obj->roomnum; 
-					
-			fq.rad   = 0.0f; 
-			fq.flags = FQ_CHECK_OBJS | FQ_IGNORE_POWERUPS | FQ_IGNORE_WEAPONS | FQ_NO_RELINK/* | FQ_IGNORE_MOVING_OBJECTS*/; 
-			if(ai_info->agression > .7f)
-			{
-				fq.flags |= FQ_IGNORE_MOVING_OBJECTS;
-			}
-			
-			fq.thisobjnum = -1; 
+			int ignore_obj_list[AI_VIS_MAX_IGNORED];
+			AIVisRaySetup(obj, target, &fq, ignore_obj_list, AI_VIS_MAX_IGNORED);
 
-			int ignore_obj_list[100];
-			ignore_obj_list[0] = OBJNUM(obj);
-			int num_ignored = 1;
-			int i;
+			// Use the batched ray if it was cast between the same two points and a wall was in the
+			// way.  Objects may have moved since, but they can't clear the wall.  If this robot's
+			// ray was cast just now, nothing has moved and any result can be used.
+			ai_vis_ray *ray = &AI_vis_rays[OBJNUM(obj)];
+			bool f_just_cast = false;
 
-			// CHRISHACK - ONLY IGNORES FIRST LEVEL OF CHILDREN - DO RECERSIVE
-			for(i = 0; i < Poly_models[obj->rtype.pobj_info.model_num].n_attach; i++)
+			if(AI_vis_batch_frame != FrameCount)
 			{
-				object *child;
-				
-				if((child = ObjGet(obj->attach_children[i])) != NULL && num_ignored < 99)
-				{
-					ignore_obj_list[num_ignored++] = OBJNUM(child);
-				}
+				AIBatchTargetVis(OBJNUM(obj));
+				f_just_cast = true;
 			}
 
-			ignore_obj_list[num_ignored] = -1;
-			fq.ignore_obj_list = ignore_obj_list;
+			if(ray->frame == FrameCount && ray->target_handle == ai_info->target_handle && ray->flags == fq.flags &&
+				ray->pos == obj->pos && ray->target_pos == target->pos && (f_just_cast || ray->fate == HIT_WALL || ray->fate == HIT_TERRAIN))
+			{
+				fate = ray->fate;
+				hit_object = ray->hit_object;
+				RTP_INCRVALUE(ai_vis_batch_hits,1);
+			}
+			else
+			{
+				if(ray->frame == FrameCount)
+					RTP_INCRVALUE(ai_vis_batch_misses,1);
 
-			fate = fvi_FindIntersection(&fq, &hit_info); 
+				fate = fvi_FindIntersection(&fq, &hit_info); 
+				hit_object = hit_info.hit_object[0];
+			}
 			
 			#ifdef _DEBUG
 			if(AI_debug_robot_do && OBJNUM(obj) == AI_debug_robot_index)
@@ -2894,7 +3036,7 @@ void AICheckTargetVis(object *obj)
 			}
 			#endif
 
-			if(((fate == HIT_OBJECT || fate == HIT_SPHERE_2_POLY_OBJECT) && hit_info.hit_object[0] == OBJNUM(target)) || (fate == HIT_NONE))
+			if(((fate == HIT_OBJECT || fate == HIT_SPHERE_2_POLY_OBJECT) && hit_object == OBJNUM(target)) || (fate == HIT_NONE))
 			{
 				ai_info->status_reg |= AISR_SEES_GOAL;  // chrishack -- need to do this stuff correctly
 				//if(ai_info->highest_vis > )  chrishack -- need to do this stuff
@@ -5611,10 +5753,14 @@ object *AIFindObjOfType(object *obj, int type, int id, bool f_ignore_init_room,
 	object *best_obj = NULL;
 	int i;
 	int my_obj_index = OBJNUM(obj);
+	unsigned int type_mask = OBJ_TYPE_BIT(type);
 
-	for(i = 0; i <= Highest_object_index; i++)
+	if(type == OBJ_ROBOT)
+		type_mask |= OBJ_TYPE_BIT(OBJ_BUILDING);
+
+	for(i = ObjFirstOfTypes(type_mask); i != -1; i = ObjNextOfTypes(type_mask, i))
 	{
-		if((Objects[i].type == type || (type == OBJ_ROBOT && Objects[i].type == OBJ_BUILDING)) && i != my_obj_index)
+		if(i != my_obj_index)
 		{
 			float cur_dist;
 
@@ -36,9 +36,17 @@
 #include "mem.h"
 #include "doorway.h"
 #include "string.h"
+#include "CFILE.H"
+#include "ddio.h"
+#include "TaskSystem.h"
+#include "../md5/md5.h"
 
 #define BOA_VERSION 25
 
+//Version of the BOA cache file layout.  Bump this if the file format changes.
+#define BOA_CACHE_VERSION	2
+#define BOA_CACHE_TAG		"D3BC"
+
 const ubyte bbf_lookup[27] =
 {
 (0),
@@ -86,6 +94,15 @@ int BOA_num_terrain_regions = 0;
 int BOA_num_connect[MAX_BOA_TERRAIN_REGIONS];
 connect_data BOA_connect[MAX_BOA_TERRAIN_REGIONS][MAX_PATH_PORTALS];
 
+char BOA_cache_directory[_MAX_PATH] = "";
+
+// The BOAF_VIS bits of BOA_Array, packed one bit per room so queries touch a few cache lines instead of
+// the whole array.  Row i has the rooms visible from vis index i.  Rooms that aren't in use only see
+// themselves.  The last row is for room -1.
+uint BOA_vis_table[BOA_VIS_MASK_BITS][BOA_VIS_MASK_WORDS];
+int BOA_vis_table_highest_room = -1;	// Highest_room_index when the table was built
+#define BOA_VIS_NONE_INDEX	(BOA_VIS_MASK_BITS - 1)
+
 void ComputeBOAVisFaceUpperLeft(room* rp, face* fp, vector* upper_left, float* xdiff, float* ydiff, vector* center);
 
 bool BOA_PassablePortal(int room, int portal_index, bool f_for_sound, bool f_making_robot_path_invalid_list)
@@ -469,55 +486,143 @@ bool BOA_HasPossibleBlockage(int start_room, int end_room)
 
 	return ((BOA_Array[s_index][e_index] & BOAF_BLOCKAGE) != 0);
 }
-bool BOA_IsVisible(int start_room, int end_room)
+// Rebuilds the packed visibility table from BOA_Array
+void BOA_UpdateVisTable()
 {
-	int s_index = start_room;
-	int e_index = end_room;
-
-	if (!BOA_vis_valid)
-		return true;
-
-	if (start_room == end_room)
-		return true;
+	int i, j;
 
-	if (start_room == -1 || end_room == -1)
-	{
-		return false;
-	}
+	memset(BOA_vis_table, 0, sizeof(BOA_vis_table));
 
-	if ((!ROOMNUM_OUTSIDE(s_index)) && s_index <= Highest_room_index)
+	for (i = 0; i <= Highest_room_index + MAX_BOA_TERRAIN_REGIONS; i++)
 	{
-		if (!Rooms[s_index].used)
+		if (i > Highest_room_index || Rooms[i].used)
 		{
-			return false;
+			for (j = 0; j <= Highest_room_index + MAX_BOA_TERRAIN_REGIONS; j++)
+			{
+				if ((j > Highest_room_index || Rooms[j].used) && (BOA_Array[i][j] & BOAF_VIS))
+					BOA_vis_table[i][j >> 5] |= (1u << (j & 31));
+			}
 		}
 	}
-	else if (ROOMNUM_OUTSIDE(s_index))
-	{
-		s_index = TERRAIN_REGION(start_room) + Highest_room_index + 1;
-	}
-	else
+
+	// A room can always see itself, even an unused one (and "no room" sees "no room")
+	for (i = 0; i <= Highest_room_index; i++)
+		BOA_vis_table[i][i >> 5] |= (1u << (i & 31));
+	BOA_vis_table[BOA_VIS_NONE_INDEX][BOA_VIS_NONE_INDEX >> 5] |= (1u << (BOA_VIS_NONE_INDEX & 31));
+
+	BOA_vis_table_highest_room = Highest_room_index;
+}
+
+// Gets the row of the vis table for a room
+static inline int BOA_GetVisIndex(int room)
+{
+	if (room == -1)
+		return BOA_VIS_NONE_INDEX;
+
+	if (ROOMNUM_OUTSIDE(room))
+		return TERRAIN_REGION(room) + Highest_room_index + 1;
+
+	ASSERT(room <= Highest_room_index + MAX_BOA_TERRAIN_REGIONS);
+	return room;
+}
+
+// Makes sure the vis table matches the mine, in case rooms were added in the editor
+static inline void BOA_CheckVisTable()
+{
+	if (BOA_vis_table_highest_room != Highest_room_index)
+		BOA_UpdateVisTable();
+}
+
+// Makes a mask with a bit set for each of the rooms in the list
+void BOA_MakeRoomMask(boa_vis_mask* mask, const int* rooms, int num_rooms)
+{
+	memset(mask, 0, sizeof(*mask));
+
+	for (int i = 0; i < num_rooms; i++)
 	{
-		ASSERT(s_index <= Highest_room_index + MAX_BOA_TERRAIN_REGIONS);
+		int index = BOA_GetVisIndex(rooms[i]);
+		mask->bits[index >> 5] |= (1u << (index & 31));
 	}
+}
 
-	if ((!ROOMNUM_OUTSIDE(e_index)) && e_index <= Highest_room_index)
+// Makes a mask of every room that's visible from any of the rooms in the list
+void BOA_MakeVisibleMask(boa_vis_mask* mask, const int* rooms, int num_rooms)
+{
+	int i, w;
+
+	if (!BOA_vis_valid)
 	{
-		if (!Rooms[e_index].used)
-		{
-			return false;
-		}
+		memset(mask, 0xff, sizeof(*mask));
+		return;
 	}
-	else if (ROOMNUM_OUTSIDE(e_index))
+
+	BOA_CheckVisTable();
+	memset(mask, 0, sizeof(*mask));
+
+	for (i = 0; i < num_rooms; i++)
 	{
-		e_index = TERRAIN_REGION(end_room) + Highest_room_index + 1;
+		const uint* row = BOA_vis_table[BOA_GetVisIndex(rooms[i])];
+		for (w = 0; w < BOA_VIS_MASK_WORDS; w++)
+			mask->bits[w] |= row[w];
 	}
-	else
+}
+
+// Tells if a room's bit is set in a mask
+bool BOA_IsRoomInMask(int room, const boa_vis_mask* mask)
+{
+	int index = BOA_GetVisIndex(room);
+	return (mask->bits[index >> 5] & (1u << (index & 31))) != 0;
+}
+
+// Tells if a room can see any of the rooms in a mask made with BOA_MakeRoomMask()
+bool BOA_IsVisibleToMask(int room, const boa_vis_mask* mask)
+{
+	uint any = 0;
+
+	if (!BOA_vis_valid)
+		return true;
+
+	BOA_CheckVisTable();
+
+	const uint* row = BOA_vis_table[BOA_GetVisIndex(room)];
+	for (int w = 0; w < BOA_VIS_MASK_WORDS; w++)
+		any |= row[w] & mask->bits[w];
+
+	return any != 0;
+}
+
+// For each of a list of rooms, tells if it's visible from any of the source rooms
+int BOA_GetVisibleRooms(const int* rooms, int num_rooms, const int* src_rooms, int num_src_rooms, bool* visible)
+{
+	boa_vis_mask mask;
+	int num_visible = 0;
+
+	BOA_MakeVisibleMask(&mask, src_rooms, num_src_rooms);
+
+	for (int i = 0; i < num_rooms; i++)
 	{
-		ASSERT(e_index <= Highest_room_index + MAX_BOA_TERRAIN_REGIONS);
+		visible[i] = BOA_IsRoomInMask(rooms[i], &mask);
+		if (visible[i])
+			num_visible++;
 	}
 
-	return ((BOA_Array[s_index][e_index] & BOAF_VIS) != 0);
+	return num_visible;
+}
+
+bool BOA_IsVisible(int start_room, int end_room)
+{
+	if (!BOA_vis_valid)
+		return true;
+
+	if (start_room == end_room)
+		return true;
+
+	BOA_CheckVisTable();
+
+	int s_index = BOA_GetVisIndex(start_room);
+	int e_index = BOA_GetVisIndex(end_room);
+
+	return (BOA_vis_table[s_index][e_index >> 5] & (1u << (e_index & 31))) != 0;
 }
 
 int BOA_GetNextRoom(int start_room, int end_room)
@@ -976,6 +1081,20 @@ void update_path_info(q_item* node_list[MAX_ROOMS], int start, int end)
 	}
 }
 
+// Cost of going from a room through one of its portals into next_room: the distance from the room to
+// the portal plus the distance from the portal to next_room.  A portal that's only passable one way has
+// no portal back from next_room, so only the first part counts.
+static float path_edge_cost(int roomnum, int portal_index, int next_room)
+{
+	int next_portal = BOA_DetermineStartRoomPortal(next_room, NULL, roomnum, NULL);
+	float cost = BOA_cost_array[BOA_INDEX(roomnum)][portal_index];
+
+	if (next_portal >= 0)
+		cost += BOA_cost_array[BOA_INDEX(next_room)][next_portal];
+
+	return cost;
+}
+
 void FindPath(int i, int j)
 {
 	pq PQPath;
@@ -998,7 +1117,7 @@ void FindPath(int i, int j)
 	PQPath.push(start_node);
 	ASSERT(start_node->roomnum <= Highest_room_index + BOA_num_terrain_regions);
 
-	while (cur_node = PQPath.pop())
+	while ((cur_node = PQPath.pop()) != NULL)
 	{
 		node_list[BOA_INDEX(cur_node->roomnum)] = cur_node;
 		ASSERT(BOA_INDEX(cur_node->roomnum) >= 0 && BOA_INDEX(cur_node->roomnum) <= Highest_room_index + MAX_BOA_TERRAIN_REGIONS);
@@ -1054,13 +1173,11 @@ void FindPath(int i, int j)
 					ASSERT(next_room <= Highest_room_index + BOA_num_terrain_regions);
 				}
 
-				int next_portal;
-				if (BOA_INDEX(next_room) != BOA_INDEX(cur_node->roomnum))
-				{
-					next_portal = BOA_DetermineStartRoomPortal(next_room, NULL, cur_node->roomnum, NULL);
-				}
+				// A portal back into the same room can't take the path anywhere new
+				if (BOA_INDEX(next_room) == BOA_INDEX(cur_node->roomnum))
+					continue;
 
-				new_cost = cur_node->cost + BOA_cost_array[BOA_INDEX(cur_node->roomnum)][counter] + BOA_cost_array[BOA_INDEX(next_room)][next_portal];
+				new_cost = cur_node->cost + path_edge_cost(cur_node->roomnum, counter, next_room);
 
 				list_item = node_list[BOA_INDEX(next_room)];
 				if (list_item != NULL && list_item->cost <= new_cost)
@@ -1122,13 +1239,11 @@ void FindPath(int i, int j)
 					next_room = Highest_room_index + TERRAIN_REGION(cell) + 1;
 				}
 
-				int next_portal;
-				if (BOA_INDEX(next_room) != BOA_INDEX(cur_node->roomnum))
-				{
-					next_portal = BOA_DetermineStartRoomPortal(next_room, NULL, cur_node->roomnum, NULL);
-				}
+				// A portal back into the same room can't take the path anywhere new
+				if (BOA_INDEX(next_room) == BOA_INDEX(cur_node->roomnum))
+					continue;
 
-				new_cost = cur_node->cost + BOA_cost_array[BOA_INDEX(cur_node->roomnum)][counter] + BOA_cost_array[BOA_INDEX(next_room)][next_portal];
+				new_cost = cur_node->cost + path_edge_cost(cur_node->roomnum, counter, next_room);
 
 				list_item = node_list[BOA_INDEX(next_room)];
 				if (list_item != NULL && list_item->cost <= new_cost)
@@ -1164,7 +1279,164 @@ done:
 	return;
 }
 
-void compute_next_segs()
+// Shortest path trees from every room and terrain region, for compute_next_segs().  Row i holds the parent
+// of each room on the paths from room i, -1 for room i itself, or -2 if there's no path to it.
+short* BOA_path_parent = NULL;
+ubyte* BOA_path_bad = NULL;	// set for a row if the tree might not match what FindPath() would do
+int BOA_path_stride;
+
+// Builds the shortest path tree from one room.  This runs the same search as FindPath(), in the same
+// order, but doesn't stop when it gets to a particular room.  A search stops at a room when it's popped,
+// so as long as a popped room can never be reached more cheaply, each room's path in the tree is the
+// one FindPath() would find.  That can only fail if an edge has a negative cost (left over costs for
+// terrain regions can be), and then the row is marked bad and its paths are found with FindPath().
+// Runs on a worker thread, so it only reads the mine and writes its own row.
+static void find_path_tree(int index, void* parm)
+{
+	int i = ((int*)parm)[index];
+	short* parent = BOA_path_parent + i * BOA_path_stride;
+	pq PQPath;
+	int counter;
+	q_item* cur_node;
+
+	// Each room goes on the queue at most once, so it gets its own node
+	q_item arena[MAX_ROOMS + MAX_BOA_TERRAIN_REGIONS];
+	q_item* node_list[MAX_ROOMS + MAX_BOA_TERRAIN_REGIONS];
+
+	memset(node_list, 0, sizeof(q_item*) * (MAX_ROOMS + MAX_BOA_TERRAIN_REGIONS));
+	for (counter = 0; counter < BOA_path_stride; counter++)
+		parent[counter] = -2;
+
+	q_item* start_node = &arena[BOA_INDEX(i)];
+	*start_node = q_item(BOA_INDEX(i), -1, 0.0);
+	node_list[BOA_INDEX(i)] = start_node;
+	PQPath.push(start_node);
+
+	while ((cur_node = PQPath.pop()) != NULL)
+	{
+		parent[cur_node->roomnum] = cur_node->parent;
+
+		int num_portals;
+		bool f_room = true;
+		int t_index;
+
+		if (cur_node->roomnum <= Highest_room_index)
+		{
+			num_portals = Rooms[cur_node->roomnum].num_portals;
+		}
+		else
+		{
+			t_index = cur_node->roomnum - Highest_room_index - 1;
+			num_portals = BOA_num_connect[t_index];
+			f_room = false;
+		}
+
+		for (counter = 0; counter < num_portals; counter++)
+		{
+			int next_room;
+			q_item* list_item;
+			float new_cost;
+
+			if (!BOA_PassablePortal(cur_node->roomnum, counter))
+				continue;
+
+			if (f_room)
+				next_room = Rooms[cur_node->roomnum].portals[counter].croom;
+			else
+				next_room = BOA_connect[t_index][counter].roomnum;
+
+			if (next_room < 0 || next_room == BOA_NO_PATH)
+				continue;
+
+			if ((next_room <= Highest_room_index) && (Rooms[next_room].flags & RF_EXTERNAL))
+			{
+				ASSERT(cur_node->roomnum <= Highest_room_index);
+				int cell = GetTerrainCellFromPos(&Rooms[cur_node->roomnum].portals[counter].path_pnt);
+				ASSERT(cell != -1);		//DAJ -1FIX
+				next_room = Highest_room_index + TERRAIN_REGION(cell) + 1;
+			}
+
+			if (BOA_INDEX(next_room) == BOA_INDEX(cur_node->roomnum))
+				continue;
+
+			float edge_cost = path_edge_cost(cur_node->roomnum, counter, next_room);
+			if (!(edge_cost >= 0.0f))
+			{
+				BOA_path_bad[i] = 1;
+				return;
+			}
+
+			new_cost = cur_node->cost + edge_cost;
+
+			list_item = node_list[BOA_INDEX(next_room)];
+			if (list_item != NULL && list_item->cost <= new_cost)
+				continue;
+
+			if (list_item == NULL)
+			{
+				list_item = &arena[BOA_INDEX(next_room)];
+				*list_item = q_item(BOA_INDEX(next_room), cur_node->roomnum, new_cost);
+				node_list[BOA_INDEX(next_room)] = list_item;
+				PQPath.push(list_item);
+				ASSERT(list_item->roomnum <= Highest_room_index + BOA_num_terrain_regions);
+			}
+			else
+			{
+				list_item->cost = new_cost;
+				list_item->parent = cur_node->roomnum;
+			}
+		}
+	}
+}
+
+// Does what FindPath(i, j) would, using the path tree from room i
+static void find_path_from_tree(int i, int j)
+{
+	short* parent = BOA_path_parent + i * BOA_path_stride;
+	int cur_room, par_room, end = j;
+
+	if (parent[j] == -2)
+	{
+		//Mark as an impossible path.
+		BOA_Array[i][j] = BOA_NO_PATH;
+		return;
+	}
+
+	// Same as update_path_info()
+	while (end != i)
+	{
+		cur_room = end;
+		par_room = parent[end];
+
+		while (par_room != -1)
+		{
+			BOA_Array[par_room][end] = cur_room;
+
+			cur_room = parent[cur_room];
+			par_room = parent[cur_room];
+		}
+
+		end = parent[end];
+	}
+}
+
+// Tells if compute_next_segs() needs a path from this room or terrain region
+static bool is_path_endpoint(int i)
+{
+	if (i <= Highest_room_index && (!Rooms[i].used))
+		return false;
+
+	if (i <= Highest_room_index && (Rooms[i].flags & RF_EXTERNAL))
+		return false;
+
+	if (i > Highest_room_index + BOA_num_terrain_regions)
+		return false;
+
+	return true;
+}
+
+// Fills in the next rooms.  With f_trees, paths are found with the path trees where they're good.
+static void fill_next_segs(bool f_trees)
 {
 	int i, j;
 
@@ -1204,12 +1476,66 @@ void compute_next_segs()
 				continue;
 			}
 
-			if (i != j && BOA_Array[i][j] == i) FindPath(i, j);
-			if (i != j && BOA_Array[j][i] == j) FindPath(j, i);
+			if (i != j && BOA_Array[i][j] == i)
+			{
+				if (f_trees && !BOA_path_bad[i]) find_path_from_tree(i, j);
+				else FindPath(i, j);
+			}
+
+			if (i != j && BOA_Array[j][i] == j)
+			{
+				if (f_trees && !BOA_path_bad[j]) find_path_from_tree(j, i);
+				else FindPath(j, i);
+			}
 		}
 	}
 }
 
+// Finds the next room on the path between every pair of rooms.  Paths that go through rooms already
+// done fill in those rooms too, so the result depends on the order the pairs are done in.  To get the
+// same answer as doing each pair with FindPath() in that order, the path tree from every room is
+// built on the worker threads, and then the pairs are walked in order using the trees.
+// If f_serial is set, each pair is done with FindPath() instead.
+void compute_next_segs(bool f_serial)
+{
+	int i, num_sources = 0;
+	int sources[MAX_ROOMS + MAX_BOA_TERRAIN_REGIONS];
+	int num_bad = 0;
+
+	if (f_serial)
+	{
+		fill_next_segs(false);
+		return;
+	}
+
+	BOA_path_stride = Highest_room_index + MAX_BOA_TERRAIN_REGIONS + 1;
+	BOA_path_parent = (short*)mem_malloc(BOA_path_stride * BOA_path_stride * sizeof(short));
+	BOA_path_bad = (ubyte*)mem_malloc(BOA_path_stride);
+	ASSERT(BOA_path_parent && BOA_path_bad);
+	memset(BOA_path_bad, 0, BOA_path_stride);
+
+	for (i = 0; i < BOA_path_stride; i++)
+	{
+		if (is_path_endpoint(i))
+			sources[num_sources++] = i;
+	}
+
+	task_ParallelFor(num_sources, find_path_tree, sources);
+
+	for (i = 0; i < BOA_path_stride; i++)
+		num_bad += BOA_path_bad[i];
+
+	if (num_bad)
+		mprintf((0, "  %d rooms have a negative path cost, so finding their paths separately.\n", num_bad));
+
+	fill_next_segs(true);
+
+	mem_free(BOA_path_parent);
+	mem_free(BOA_path_bad);
+	BOA_path_parent = NULL;
+	BOA_path_bad = NULL;
+}
+
 void compute_blockage_info()
 {
 	int i, j;
@@ -2070,6 +2396,7 @@ void MakeBOAVisTable(bool from_lighting)
 
 	BOA_vis_checksum = BOA_mine_checksum;
 	BOA_vis_valid = 1;
+	BOA_UpdateVisTable();
 }
 #endif
 
@@ -2210,6 +2537,318 @@ void compute_robot_path_info()
 	}
 }
 
+#define cf_ReadVector(f,v)  do {(v)->x=cf_ReadFloat(f); (v)->y=cf_ReadFloat(f); (v)->z=cf_ReadFloat(f); } while (0)
+#define cf_WriteVector(f,v)  do {cf_WriteFloat((f),(v)->x); cf_WriteFloat((f),(v)->y); cf_WriteFloat((f),(v)->z); } while (0)
+
+// Gets an MD5 digest of the room and portal geometry MakeBOA() works from, to name and check the
+// cache file with.  BOAGetMineChecksum() adds up rounded coordinates, so different mines can
+// have the same checksum; the digest takes in every bit of every vertex.  It also takes in the
+// room, portal and texture flags BOA_PassablePortal() and compute_blockage_info() look at, and
+// the path points designers put in by hand.
+static void BOA_GetCacheDigest(ubyte* digest)
+{
+	MD5 md5;
+	int i, t, k;
+
+	md5.MD5Init();
+	md5.MD5Update((int)BOA_VERSION);
+	md5.MD5Update(Highest_room_index);
+
+	for (i = 0; i <= Highest_room_index; i++)
+	{
+		room* rp = &Rooms[i];
+
+		md5.MD5Update((int)rp->used);
+		if (!rp->used)
+			continue;
+
+		md5.MD5Update(rp->flags & (RF_EXTERNAL | RF_DOOR | RF_MANUAL_PATH_PNT));
+		if (rp->flags & RF_MANUAL_PATH_PNT)
+		{
+			md5.MD5Update(rp->path_pnt.x);
+			md5.MD5Update(rp->path_pnt.y);
+			md5.MD5Update(rp->path_pnt.z);
+		}
+		md5.MD5Update(rp->num_verts);
+		md5.MD5Update(rp->num_faces);
+		md5.MD5Update(rp->num_portals);
+
+		for (t = 0; t < rp->num_verts; t++)
+		{
+			md5.MD5Update(rp->verts[t].x);
+			md5.MD5Update(rp->verts[t].y);
+			md5.MD5Update(rp->verts[t].z);
+		}
+
+		for (t = 0; t < rp->num_faces; t++)
+		{
+			face* fp = &rp->faces[t];
+
+			md5.MD5Update((int)fp->num_verts);
+			md5.MD5Update((int)fp->portal_num);
+			for (k = 0; k < fp->num_verts; k++)
+				md5.MD5Update((int)fp->face_verts[k]);
+		}
+
+		for (t = 0; t < rp->num_portals; t++)
+		{
+			portal* pp = &rp->portals[t];
+
+			md5.MD5Update((int)pp->portal_face);
+			md5.MD5Update((int)pp->croom);
+			md5.MD5Update((int)pp->cportal);
+			md5.MD5Update(pp->flags & (PF_BLOCK | PF_BLOCK_REMOVABLE | PF_RENDER_FACES | PF_RENDERED_FLYTHROUGH));
+
+			// A rendered portal is passable if its face is breakable or a forcefield
+			md5.MD5Update(GameTextures[rp->faces[pp->portal_face].tmap].flags & (TF_BREAKABLE | TF_FORCEFIELD));
+		}
+	}
+
+	for (i = 0; i < TERRAIN_WIDTH * TERRAIN_DEPTH; i++)
+		md5.MD5Update(Terrain_seg[i].ypos);
+
+	md5.MD5Final(digest);
+}
+
+// Gets the name of the cache file for a mine.  The BOA version is part of the digest, and the
+// cache version is part of the name, so a change to either one makes new files.
+static void BOA_GetCacheFilename(char* filename, const ubyte* digest)
+{
+	char name[_MAX_PATH];
+	char* s = name + sprintf(name, "boa_");
+	for (int i = 0; i < 16; i++)
+		s += sprintf(s, "%02x", digest[i]);
+	sprintf(s, "_%d.dat", BOA_CACHE_VERSION);
+	ddio_MakePath(filename, BOA_cache_directory, name, NULL);
+}
+
+// Size of the BOA cache file for the current mine, given how many rooms and portals it has
+static int BOA_CacheFileSize(int num_used_rooms, int num_portals)
+{
+	int n = Highest_room_index + MAX_BOA_TERRAIN_REGIONS + 1;
+	int size = 4 + 16 + 6 * sizeof(int);														// header
+	size += (Highest_room_index + 1) + num_used_rooms * 2 * sizeof(int);					// room layout
+	size += num_used_rooms * (1 + sizeof(vector));													// rooms
+	size += num_portals * (sizeof(vector) + 1);													// portals
+	size += TERRAIN_WIDTH * TERRAIN_DEPTH;															// terrain regions
+	size += 2 * sizeof(int);																			// mine & region counts
+	size += MAX_BOA_TERRAIN_REGIONS * (sizeof(int) + MAX_PATH_PORTALS * 2 * sizeof(int));	// connections
+	size += n * n * sizeof(short);																	// BOA_Array
+	size += n * MAX_PATH_PORTALS * sizeof(float);												// BOA_cost_array
+	return size;
+}
+
+// Loads everything MakeBOA() computes from the cache, if the cache has this mine
+// Returns true if the data was loaded
+static bool BOA_ReadCache(const ubyte* digest)
+{
+	char filename[_MAX_PATH];
+	char tag[4];
+	ubyte file_digest[16];
+	int i, j;
+	int n = Highest_room_index + MAX_BOA_TERRAIN_REGIONS + 1;
+
+	if (!BOA_cache_directory[0])
+		return false;
+
+	BOA_GetCacheFilename(filename, digest);
+	CFILE* fp = cfopen(filename, "rb");
+	if (!fp)
+		return false;
+
+	bool ok = false;
+	try
+	{
+		int num_used_rooms = 0, num_portals = 0;
+
+		// Make sure the file is for this mine.  Nothing is changed until the whole file checks out.
+		cf_ReadBytes((ubyte*)tag, 4, fp);
+		if (memcmp(tag, BOA_CACHE_TAG, 4) || cf_ReadInt(fp) != BOA_CACHE_VERSION)
+			goto done;
+
+		cf_ReadBytes(file_digest, 16, fp);
+		if (memcmp(file_digest, digest, 16) ||
+			cf_ReadInt(fp) != Highest_room_index || cf_ReadInt(fp) != MAX_BOA_TERRAIN_REGIONS ||
+			cf_ReadInt(fp) != MAX_PATH_PORTALS || cf_ReadInt(fp) != TERRAIN_WIDTH || cf_ReadInt(fp) != TERRAIN_DEPTH)
+			goto done;
+
+		for (i = 0; i <= Highest_room_index; i++)
+		{
+			if (cf_ReadByte(fp) != (Rooms[i].used ? 1 : 0))
+				goto done;
+			if (Rooms[i].used)
+			{
+				if (cf_ReadInt(fp) != Rooms[i].num_faces || cf_ReadInt(fp) != Rooms[i].num_portals)
+					goto done;
+				num_used_rooms++;
+				num_portals += Rooms[i].num_portals;
+			}
+		}
+
+		if (cfilelength(fp) != BOA_CacheFileSize(num_used_rooms, num_portals))
+			goto done;
+
+		for (i = 0; i <= Highest_room_index; i++)
+		{
+			room* rp = &Rooms[i];
+
+			if (!rp->used)
+				continue;
+
+			rp->flags = (rp->flags & ~RFM_MINE) | ((cf_ReadByte(fp) << 20) & RFM_MINE);
+			cf_ReadVector(fp, &rp->path_pnt);
+
+			for (j = 0; j < rp->num_portals; j++)
+			{
+				cf_ReadVector(fp, &rp->portals[j].path_pnt);
+				if (cf_ReadByte(fp))
+					rp->portals[j].flags |= PF_TOO_SMALL_FOR_ROBOT;
+				else
+					rp->portals[j].flags &= ~PF_TOO_SMALL_FOR_ROBOT;
+			}
+		}
+
+		for (i = 0; i < TERRAIN_WIDTH * TERRAIN_DEPTH; i++)
+			Terrain_seg[i].flags = (Terrain_seg[i].flags & ~TFM_REGION_MASK) | ((cf_ReadByte(fp) << 5) & TFM_REGION_MASK);
+
+		BOA_num_mines = cf_ReadInt(fp);
+		BOA_num_terrain_regions = cf_ReadInt(fp);
+
+		for (i = 0; i < MAX_BOA_TERRAIN_REGIONS; i++)
+		{
+			BOA_num_connect[i] = cf_ReadInt(fp);
+			for (j = 0; j < MAX_PATH_PORTALS; j++)
+			{
+				BOA_connect[i][j].roomnum = cf_ReadInt(fp);
+				BOA_connect[i][j].portal = cf_ReadInt(fp);
+			}
+		}
+
+		for (i = 0; i < n; i++)
+			for (j = 0; j < n; j++)
+				BOA_Array[i][j] = cf_ReadShort(fp);
+
+		for (i = 0; i < n; i++)
+			for (j = 0; j < MAX_PATH_PORTALS; j++)
+				BOA_cost_array[i][j] = cf_ReadFloat(fp);
+
+		for (i = 0; i < MAX_ROOMS; i++)
+			BOA_AABB_ROOM_checksum[i] = 0;
+
+		ok = true;
+	}
+	catch (cfile_error*)
+	{
+		ok = false;
+	}
+
+done:
+	cfclose(fp);
+
+	// A bad file would never get replaced, so get rid of it
+	if (!ok)
+	{
+		mprintf((0, "BOA cache file %s is bad\n", filename));
+		ddio_DeleteFile(filename);
+	}
+
+	return ok;
+}
+
+// Saves everything MakeBOA() computed to the cache.  The file is written under a temporary
+// name and renamed into place, so nobody sharing the cache directory can see it half written.
+static void BOA_WriteCache(const ubyte* digest)
+{
+	char filename[_MAX_PATH], tempfilename[_MAX_PATH];
+	int i, j;
+	int n = Highest_room_index + MAX_BOA_TERRAIN_REGIONS + 1;
+
+	if (!BOA_cache_directory[0])
+		return;
+
+	if (!ddio_GetTempFileName(BOA_cache_directory, "boa", tempfilename))
+		return;
+
+	CFILE* fp = cfopen(tempfilename, "wb");
+	if (!fp)
+		return;
+
+	bool ok = true;
+	try
+	{
+		cf_WriteBytes((ubyte*)BOA_CACHE_TAG, 4, fp);
+		cf_WriteInt(fp, BOA_CACHE_VERSION);
+		cf_WriteBytes(digest, 16, fp);
+		cf_WriteInt(fp, Highest_room_index);
+		cf_WriteInt(fp, MAX_BOA_TERRAIN_REGIONS);
+		cf_WriteInt(fp, MAX_PATH_PORTALS);
+		cf_WriteInt(fp, TERRAIN_WIDTH);
+		cf_WriteInt(fp, TERRAIN_DEPTH);
+
+		for (i = 0; i <= Highest_room_index; i++)
+		{
+			cf_WriteByte(fp, Rooms[i].used ? 1 : 0);
+			if (Rooms[i].used)
+			{
+				cf_WriteInt(fp, Rooms[i].num_faces);
+				cf_WriteInt(fp, Rooms[i].num_portals);
+			}
+		}
+
+		for (i = 0; i <= Highest_room_index; i++)
+		{
+			room* rp = &Rooms[i];
+
+			if (!rp->used)
+				continue;
+
+			cf_WriteByte(fp, MINE_INDEX(i));
+			cf_WriteVector(fp, &rp->path_pnt);
+
+			for (j = 0; j < rp->num_portals; j++)
+			{
+				cf_WriteVector(fp, &rp->portals[j].path_pnt);
+				cf_WriteByte(fp, (rp->portals[j].flags & PF_TOO_SMALL_FOR_ROBOT) ? 1 : 0);
+			}
+		}
+
+		for (i = 0; i < TERRAIN_WIDTH * TERRAIN_DEPTH; i++)
+			cf_WriteByte(fp, (Terrain_seg[i].flags & TFM_REGION_MASK) >> 5);
+
+		cf_WriteInt(fp, BOA_num_mines);
+		cf_WriteInt(fp, BOA_num_terrain_regions);
+
+		for (i = 0; i < MAX_BOA_TERRAIN_REGIONS; i++)
+		{
+			cf_WriteInt(fp, BOA_num_connect[i]);
+			for (j = 0; j < MAX_PATH_PORTALS; j++)
+			{
+				cf_WriteInt(fp, BOA_connect[i][j].roomnum);
+				cf_WriteInt(fp, BOA_connect[i][j].portal);
+			}
+		}
+
+		for (i = 0; i < n; i++)
+			for (j = 0; j < n; j++)
+				cf_WriteShort(fp, BOA_Array[i][j]);
+
+		for (i = 0; i < n; i++)
+			for (j = 0; j < MAX_PATH_PORTALS; j++)
+				cf_WriteFloat(fp, BOA_cost_array[i][j]);
+	}
+	catch (cfile_error*)
+	{
+		ok = false;
+	}
+
+	cfclose(fp);
+
+	// If the rename fails, someone else already wrote this mine's file
+	BOA_GetCacheFilename(filename, digest);
+	if (!ok || !ddio_RenameFile(tempfilename, filename))
+		ddio_DeleteFile(tempfilename);
+}
+
 void MakeBOA(void)
 {
 	ASSERT(BOA_ROOM_MASK > MAX_ROOMS + MAX_BOA_TERRAIN_REGIONS);
@@ -2220,11 +2859,26 @@ void MakeBOA(void)
 	else
 		BOA_vis_valid = 0;
 
-	if (cur_check == BOA_mine_checksum) return;
+	if (cur_check == BOA_mine_checksum)
+	{
+		BOA_UpdateVisTable();
+		return;
+	}
 
 	//OutrageMessageBox("Reminder: You need to make BOA Vis on this level.\nThis is either because it hasn't\nbeen done or Chris updated BOA.");
 
 	BOA_mine_checksum = cur_check;
+
+	ubyte digest[16];
+	BOA_GetCacheDigest(digest);
+
+	if (BOA_ReadCache(digest))
+	{
+		mprintf((0, "Loaded BOA from the cache\n"));
+		BOA_UpdateVisTable();
+		return;
+	}
+
 	BOA_f_making_boa = true;
 
 	mprintf((0, "Making BOA and friends\n"));
@@ -2249,7 +2903,7 @@ void MakeBOA(void)
 	mprintf((0, "  Done computing %d terrain regions.\n", BOA_num_terrain_regions));
 
 	mprintf((0, "  Making designers wait for no particular reason...\n"));
-	compute_next_segs();
+	compute_next_segs(false);
 	mprintf((0, "  Done with the sodomy...\n"));
 
 	mprintf((0, "  Start computing blockage info.\n"));
@@ -2286,6 +2940,10 @@ void MakeBOA(void)
 	BOA_f_making_boa = false;
 	mprintf((0, "BOA is done\n"));
 
+	BOA_UpdateVisTable();
+
+	BOA_WriteCache(digest);
+
 }
 
 int Current_sort_room;
@@ -3352,5 +4010,7 @@ void ComputeAABB(bool f_full)
 		}
 	}
 
+	fvi_BuildRoomBVHs();
+
 	mprintf((0, "Done Computing AABB's.\n"));
 }
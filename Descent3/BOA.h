@@ -37,6 +37,7 @@ extern int BOA_AABB_ROOM_checksum[MAX_ROOMS+MAX_BOA_TERRAIN_REGIONS];
 class q_item 
 {
 	public:
+	q_item() {}
 	q_item(int room_index, int par, float n_cost) 
 	{
 		roomnum = room_index; 
@@ -156,6 +157,10 @@ extern int BOA_num_terrain_regions;
 extern int BOA_num_connect[MAX_BOA_TERRAIN_REGIONS];
 extern connect_data BOA_connect[MAX_BOA_TERRAIN_REGIONS][MAX_PATH_PORTALS];
 
+// Directory where MakeBOA() caches what it computes, so a mine is only computed once.
+// Empty if there's no cache.
+extern char BOA_cache_directory[];
+
 void MakeBOA(void);
 
 // Goes through all the rooms and determines their visibility in relation to one another
@@ -168,6 +173,36 @@ bool BOA_ComputeMinDist(int start_room, int end_room, float max_check_dist, floa
 bool BOA_ComputePropDist(int start_room, vector *start_pos, int end_room, vector *end_pos, float *dist, int *num_blockages);
 bool BOA_IsSoundAudible(int start_room, int end_room);
 bool BOA_IsVisible(int start_room, int end_room);
+
+// Visibility masks have one bit for each room and terrain region, plus one for room -1
+#define BOA_VIS_MASK_BITS	(MAX_ROOMS + MAX_BOA_TERRAIN_REGIONS + 1)
+#define BOA_VIS_MASK_WORDS	((BOA_VIS_MASK_BITS + 31) / 32)
+
+struct boa_vis_mask
+{
+	uint bits[BOA_VIS_MASK_WORDS];
+};
+
+// Rebuilds the packed visibility table from BOA_Array.  Called whenever the vis data changes.
+void BOA_UpdateVisTable();
+
+// Makes a mask with a bit set for each of the rooms in the list
+void BOA_MakeRoomMask(boa_vis_mask *mask, const int *rooms, int num_rooms);
+
+// Makes a mask of every room that's visible from any of the rooms in the list.
+// Testing a room in the mask gives the same answer as BOA_IsVisible(list room, room) for any list room.
+void BOA_MakeVisibleMask(boa_vis_mask *mask, const int *rooms, int num_rooms);
+
+// Tells if a room's bit is set in a mask
+bool BOA_IsRoomInMask(int room, const boa_vis_mask *mask);
+
+// Tells if a room can see any of the rooms in a mask made with BOA_MakeRoomMask().
+// Same as BOA_IsVisible(room, mask room) for any of the mask rooms.
+bool BOA_IsVisibleToMask(int room, const boa_vis_mask *mask);
+
+// For each of a list of rooms, tells if it's visible from any of the source rooms.  visible[n] is set to
+// whether BOA_IsVisible(source, rooms[n]) is true for any source.  Returns how many rooms are visible.
+int BOA_GetVisibleRooms(const int *rooms, int num_rooms, const int *src_rooms, int num_src_rooms, bool *visible);
 bool BOA_HasPossibleBlockage(int start_room, int end_room);
 int BOA_GetNextRoom(int start_room, int end_room);
 int BOA_DetermineStartRoomPortal(int start_room, vector *start_pos, int end_room, vector *end_pos, bool f_for_sound = false, bool f_making_robot_path_invalid_list = false, int *blocked_portal = NULL);
@@ -156,6 +156,10 @@ short gamegauge_fpslog[GAMEGAUGE_MAX_LOG];
 
 bool Game_gauge_do_time_test = false;
 char Game_gauge_usefile[_MAX_PATH] = "gg.dem";
+
+//Benchmarks are time tests that run uncapped and log every frame's performance counters
+bool Game_benchmark = false;
+char Game_benchmark_logfile[_MAX_PATH] = "benchmark.csv";
 //#endif
 
 double last_timer = 0;
@@ -2021,6 +2025,11 @@ void GameRenderFrame(void)
 			RenderHUDText(GR_RGB(255, 40, 40), 255, 1, x, y, buffer); y += height;
 			sprintf(buffer, "Uploads=%d", stats.texture_uploads);
 			RenderHUDText(GR_RGB(255, 40, 40), 255, 1, x, y, buffer); y += height;
+			sprintf(buffer, "Batches=%d", stats.batch_count);
+			RenderHUDText(GR_RGB(255, 40, 40), 255, 1, x, y, buffer); y += height;
+			sprintf(buffer, "Flushes tex=%d shd=%d st=%d full=%d frm=%d ext=%d", stats.batch_flushes[RBF_TEXTURE], stats.batch_flushes[RBF_SHADER],
+				stats.batch_flushes[RBF_STATE], stats.batch_flushes[RBF_FULL], stats.batch_flushes[RBF_FRAME], stats.batch_flushes[RBF_EXTERNAL]);
+			RenderHUDText(GR_RGB(255, 40, 40), 255, 1, x, y, buffer); y += height;
 			grtext_Flush();
 			EndFrame();
 		}
@@ -76,6 +76,7 @@
 #include "soundload.h"
 #include "bnode.h"
 #include "localization.h"
+#include "vclip.h"
 
 #ifdef EDITOR
 #include "editor\d3edit.h"
@@ -4565,6 +4566,16 @@ ubyte texture_counted[MAX_BITMAPS];
 ubyte sound_counted[MAX_SOUNDS];
 ubyte poly_counted[MAX_POLY_MODELS];
 
+//Files that will be read when the data is paged in, so they can be prefetched while the level finishes loading
+#define MAX_PREFETCH_NAMES	(MAX_TEXTURES + MAX_SOUNDS + MAX_POLY_MODELS)
+const char *Prefetch_names[MAX_PREFETCH_NAMES];
+int Num_prefetch_names = 0;
+
+void AddPrefetchName(const char *name)
+{
+	if (Num_prefetch_names < MAX_PREFETCH_NAMES)
+		Prefetch_names[Num_prefetch_names++] = name;
+}
 
 void AlmostPageInLevelTexture(int id)
 {
@@ -4575,6 +4586,17 @@ void AlmostPageInLevelTexture(int id)
 	{
 		texture_counted[id] = 1;
 		need_to_page_num++;
+		//The dedicated server doesn't page in textures
+		if (!Dedicated_server)
+		{
+			if (GameTextures[id].flags & TF_ANIMATED)
+			{
+				if (GameVClips[GameTextures[id].bm_handle].flags & VCF_NOT_RESIDENT)
+					AddPrefetchName(GameVClips[GameTextures[id].bm_handle].name);
+			}
+			else if (GameBitmaps[GameTextures[id].bm_handle].flags & BF_NOT_RESIDENT)
+				AddPrefetchName(GameBitmaps[GameTextures[id].bm_handle].name);
+		}
 		/*
 		//Get the size and add it to the count
 		CFILE * infile = cfopen (GameBitmaps[id].name,"rb");
@@ -4602,6 +4624,12 @@ void AlmostPageInSound(int id)
 		return;
 	sound_counted[id] = 1;
 	need_to_page_num++;
+	if (!Dedicated_server && (Sounds[id].sample_index != -1))
+	{
+		int sample = Sounds[id].sample_index;
+		if (SoundFiles[sample].sample_16bit == NULL && SoundFiles[sample].sample_8bit == NULL)
+			AddPrefetchName(SoundFiles[sample].name);
+	}
 	/*
 	//Check for space this sound takes up, and add it to our counter
 	CFILE * infile = cfopen (SoundFiles[id].name,"rb");
@@ -4620,6 +4648,7 @@ void AlmostPageInPolymodel(int num)
 	{
 		poly_counted[num] = 1;
 		need_to_page_num++;
+		AddPrefetchName(Poly_models[num].name);
 		/*
 		CFILE * infile = cfopen (Poly_models[num].name,"rb");
 		//Get the size and add it to the count
@@ -5004,6 +5033,7 @@ int CountDataToPageIn()
 
 	need_to_page_num = 0;
 	need_to_page_in = 0;
+	Num_prefetch_names = 0;
 
 	int i;
 
@@ -5022,6 +5052,9 @@ int CountDataToPageIn()
 
 	AlmostPageInAllData();
 
+	//Start reading the files now, so they're in memory by the time PageInAllData() gets to them
+	cf_PrefetchFiles(Prefetch_names, Num_prefetch_names);
+
 	return need_to_page_in;
 }
 
@@ -200,7 +200,7 @@ int ObjInitGeneric(object* objp, bool reinit)
 		if (GetFunctionMode() == EDITOR_MODE)
 			OutrageMessageBox("Object %d (\"%s\"), type name \"%s\", changed from type %s to %s", OBJNUM(objp), objp->name ? objp->name : "<no name>", obj_info->name, Object_type_names[objp->type], Object_type_names[obj_info->type]);
 #endif
-		objp->type = obj_info->type;
+		ObjSetType(objp, obj_info->type);
 	}
 
 	//Set size & shields
@@ -23,6 +23,8 @@
 #include "ddio.h"
 #include "manage.h"
 #include <stdlib.h>
+#include <algorithm>
+#include <functional>
 #include "mem.h"
 #include "DllWrappers.h"
 #include "objinfo.h"
@@ -235,6 +237,7 @@ void Osiris_InitModuleLoader(void)
 
 	Osiris_InitMemoryManager();
 	Osiris_InitOMMS();
+	Osiris_InitTimers();
 
 	OSIRIS_Extracted_script_dir = NULL;
 
@@ -2057,7 +2060,8 @@ bool Osiris_CallEvent(object* obj, int event, tOSIRISEventInfo* data)
 	return (bool)((ret & CONTINUE_DEFAULT) != 0);
 }
 
-#define MAX_OSIRIS_TIMERS	64
+#define MAX_OSIRIS_TIMERS	32768
+#define OSIRIS_TIMER_HASH_SIZE	4096		// Must be a power of 2
 #define OITF_USED			0x0001
 #define OITF_REPEATCALL		0x0002
 #define OITF_TRIGGERTIMER	0x0004
@@ -2078,153 +2082,519 @@ struct tOSIRISINTERNALTIMER
 	float timer_interval;
 	float timer_next_signal;
 	float timer_end;
+
+	// Everything below is rebuilt on restore, not saved
+	float due;						// When the timer next needs processing (its key in the queue)
+	int queue_index;				// Where the timer is in Osiris_timer_queue, or -1
+	int next_handle;				// Handle hash chain.  A slot stays in it until the slot is reused.
+	int next_id, prev_id;		// ID hash chain
+	int next_obj, prev_obj;		// Object handle hash chain (object timers only)
+	int next_poll, prev_poll;	// List of OITF_CANCELONDEAD timers, which are checked every frame
+	bool handle_hashed;			// In the handle hash
+	bool in_work;					// In this frame's work list
+	bool orphaned;					// In the orphan list
 };
 tOSIRISINTERNALTIMER OsirisTimers[MAX_OSIRIS_TIMERS];
 
+//	Timers are kept in a queue sorted by when they're due, so a frame only looks at timers that
+//	go off, timers with a detonator to check, and object timers whose object was deleted.  Those
+//	get processed in slot order, which is the order the old scan of every slot went off in.
+static int Osiris_timer_queue[MAX_OSIRIS_TIMERS];		// Heap ordered by due time, then slot
+static int Osiris_timer_queue_size = 0;
+static int Osiris_timer_free[MAX_OSIRIS_TIMERS];		// Heap of free slots, lowest first
+static int Osiris_num_free_timers = 0;
+static int Osiris_timer_work[MAX_OSIRIS_TIMERS];		// Heap of slots to process this frame, lowest first
+static int Osiris_num_timer_work = 0;
+static int Osiris_timer_orphans[MAX_OSIRIS_TIMERS];	// Object timers to check next frame
+static int Osiris_num_timer_orphans = 0;
+static int Osiris_timer_handle_hash[OSIRIS_TIMER_HASH_SIZE];
+static int Osiris_timer_id_hash[OSIRIS_TIMER_HASH_SIZE];
+static int Osiris_timer_obj_hash[OSIRIS_TIMER_HASH_SIZE];
+static int Osiris_timer_poll_list = -1;
+static int Osiris_timer_current = -1;						// Slot being processed, -1 outside Osiris_ProcessTimers()
+static bool Osiris_timer_check_all = false;				// Process every timer next frame (after a restore)
+
+//	A handle is the slot in the low OSIRIS_TIMER_SLOT_BITS bits with the timer counter above it, so
+//	two running timers never share a handle even once the counter wraps.  Handles are looked up
+//	through Osiris_timer_handle_hash, which forgets a slot's old handle when the slot is reused.
+#define OSIRIS_TIMER_SLOT_BITS	15
+
+#if (1 << OSIRIS_TIMER_SLOT_BITS) != MAX_OSIRIS_TIMERS
+#error OSIRIS_TIMER_SLOT_BITS does not match MAX_OSIRIS_TIMERS
+#endif
+
 inline int FORM_HANDLE(int counter, int slot)
 {
-	return (((counter & 0xFFFFFF) << 8) | (slot & 0xFF));
+	return (int)(((unsigned int)counter << OSIRIS_TIMER_SLOT_BITS) | (unsigned int)slot);
 }
 
-inline int GET_SLOT(int handle)
+int Osiris_timer_counter = 0;
+
+// Set by Osiris_SetTimerEventHook() to catch timer events instead of sending them to scripts
+static osiris_timer_hook Osiris_timer_hook = NULL;
+
+static inline int Osiris_TimerHandleBucket(int handle)
 {
-	return (handle & 0xFF);
+	return (handle ^ (handle >> 12)) & (OSIRIS_TIMER_HASH_SIZE - 1);
 }
 
-int Osiris_timer_counter = 0;
+static inline int Osiris_TimerIDBucket(int id)
+{
+	return ((unsigned int)id * 2654435761u >> 20) & (OSIRIS_TIMER_HASH_SIZE - 1);
+}
 
-//	Osiris_ProcessTimers
-//	Purpose:
-//		This function checks all timers currently running, if any need to be signaled it signals them.
-void Osiris_ProcessTimers(void)
+static inline int Osiris_TimerObjBucket(int objhandle)
 {
-	object* obj;
-	bool signal, kill;
-	tOSIRISEventInfo ei;
+	return objhandle & (OSIRIS_TIMER_HASH_SIZE - 1);
+}
 
-	for (int i = 0; i < MAX_OSIRIS_TIMERS; i++)
+static inline bool Osiris_IsObjectTimer(const tOSIRISINTERNALTIMER* t)
+{
+	return !(t->flags & (OITF_TRIGGERTIMER | OITF_LEVELTIMER));
+}
+
+// Returns when a timer will next do something if nothing happens to it
+static inline float Osiris_TimerDue(const tOSIRISINTERNALTIMER* t)
+{
+	if ((t->flags & OITF_REPEATCALL) && (t->repeat_count == -1))
+		return t->timer_next_signal;
+
+	return (t->timer_end < t->timer_next_signal) ? t->timer_end : t->timer_next_signal;
+}
+
+static inline bool Osiris_TimerBefore(int a, int b)
+{
+	if (OsirisTimers[a].due != OsirisTimers[b].due)
+		return OsirisTimers[a].due < OsirisTimers[b].due;
+
+	return a < b;
+}
+
+static void Osiris_TimerQueueSet(int pos, int slot)
+{
+	Osiris_timer_queue[pos] = slot;
+	OsirisTimers[slot].queue_index = pos;
+}
+
+static void Osiris_TimerQueueSiftUp(int pos)
+{
+	int slot = Osiris_timer_queue[pos];
+
+	while (pos > 0)
 	{
-		signal = false;
-		kill = false;
+		int parent = (pos - 1) / 2;
+		if (!Osiris_TimerBefore(slot, Osiris_timer_queue[parent]))
+			break;
 
-		if (OsirisTimers[i].flags & OITF_USED)
+		Osiris_TimerQueueSet(pos, Osiris_timer_queue[parent]);
+		pos = parent;
+	}
+
+	Osiris_TimerQueueSet(pos, slot);
+}
+
+static void Osiris_TimerQueueSiftDown(int pos)
+{
+	int slot = Osiris_timer_queue[pos];
+
+	for (;;)
+	{
+		int child = pos * 2 + 1;
+		if (child >= Osiris_timer_queue_size)
+			break;
+
+		if (child + 1 < Osiris_timer_queue_size && Osiris_TimerBefore(Osiris_timer_queue[child + 1], Osiris_timer_queue[child]))
+			child++;
+
+		if (!Osiris_TimerBefore(Osiris_timer_queue[child], slot))
+			break;
+
+		Osiris_TimerQueueSet(pos, Osiris_timer_queue[child]);
+		pos = child;
+	}
+
+	Osiris_TimerQueueSet(pos, slot);
+}
+
+static void Osiris_TimerQueueInsert(int slot)
+{
+	ASSERT(OsirisTimers[slot].queue_index == -1);
+
+	OsirisTimers[slot].due = Osiris_TimerDue(&OsirisTimers[slot]);
+	Osiris_TimerQueueSet(Osiris_timer_queue_size++, slot);
+	Osiris_TimerQueueSiftUp(Osiris_timer_queue_size - 1);
+}
+
+static void Osiris_TimerQueueRemove(int slot)
+{
+	int pos = OsirisTimers[slot].queue_index;
+
+	if (pos == -1)
+		return;
+
+	OsirisTimers[slot].queue_index = -1;
+
+	int last = Osiris_timer_queue[--Osiris_timer_queue_size];
+	if (pos == Osiris_timer_queue_size)
+		return;
+
+	Osiris_TimerQueueSet(pos, last);
+	Osiris_TimerQueueSiftUp(pos);
+	Osiris_TimerQueueSiftDown(OsirisTimers[last].queue_index);
+}
+
+// Adds a slot to this frame's work list
+static void Osiris_TimerAddWork(int slot)
+{
+	if (OsirisTimers[slot].in_work)
+		return;
+
+	OsirisTimers[slot].in_work = true;
+	Osiris_timer_work[Osiris_num_timer_work++] = slot;
+	std::push_heap(Osiris_timer_work, Osiris_timer_work + Osiris_num_timer_work, std::greater<int>());
+}
+
+// Makes sure a timer gets processed soon.  The old scan went through every slot each frame, so a
+// timer after the one being processed gets looked at this frame, and anything else next frame.
+static void Osiris_TimerCheckSoon(int slot)
+{
+	if (Osiris_timer_current != -1 && slot > Osiris_timer_current)
+	{
+		Osiris_TimerAddWork(slot);
+	}
+	else if (!OsirisTimers[slot].orphaned)
+	{
+		//a slot can be reused and orphaned again before the list is emptied
+		if (Osiris_num_timer_orphans == MAX_OSIRIS_TIMERS)
 		{
-			if (OsirisTimers[i].flags & OITF_CANCELONDEAD)
-			{
-				obj = ObjGet(OsirisTimers[i].objhandle_detonator);
-				if (!obj || (obj->type == OBJ_GHOST) || (obj->type == OBJ_PLAYER && Players[obj->id].flags & (PLAYER_FLAGS_DYING | PLAYER_FLAGS_DEAD))) {
-					//the detontator died...cancel the timer!					
-					OsirisTimers[i].flags &= ~OITF_USED;
-					OsirisTimers[i].repeat_count = 0;
+			Osiris_timer_check_all = true;
+			return;
+		}
 
-					tOSIRISEventInfo ei;
-					ei.evt_timercancel.detonated = 1;
-					ei.evt_timercancel.handle = OsirisTimers[i].handle;
+		OsirisTimers[slot].orphaned = true;
+		Osiris_timer_orphans[Osiris_num_timer_orphans++] = slot;
+	}
+}
 
-					if (OsirisTimers[i].flags & OITF_TRIGGERTIMER)
-					{
-						Osiris_CallTriggerEvent(OsirisTimers[i].trignum, EVT_TIMERCANCEL, &ei);
-					}
-					else if (OsirisTimers[i].flags & OITF_LEVELTIMER)
-					{
-						Osiris_CallLevelEvent(EVT_TIMERCANCEL, &ei);
-					}
-					else
-					{
-						object* obj = ObjGet(OsirisTimers[i].objhandle);
-						if (obj)
-							Osiris_CallEvent(obj, EVT_TIMERCANCEL, &ei);
-					}
+static void Osiris_TimerHashHandle(int slot)
+{
+	int bucket = Osiris_TimerHandleBucket(OsirisTimers[slot].handle);
 
-					mprintf((0, "OSIRIS TIMER: Cancelling Timer (%d/%d)\n", OsirisTimers[i].handle, i));
-					continue;
-				}
-			}
+	OsirisTimers[slot].next_handle = Osiris_timer_handle_hash[bucket];
+	Osiris_timer_handle_hash[bucket] = slot;
+	OsirisTimers[slot].handle_hashed = true;
+}
 
-			if (OsirisTimers[i].timer_next_signal <= Gametime)
-			{
-				//this timer needs to be signaled
-				signal = true;
+static void Osiris_TimerUnhashHandle(int slot)
+{
+	if (!OsirisTimers[slot].handle_hashed)
+		return;
 
-				if (OsirisTimers[i].flags & OITF_REPEATCALL)
-				{
-					//this is a repeater
-					if (OsirisTimers[i].repeat_count != -1)
-					{
-						//it has a finite repeat
-						OsirisTimers[i].repeat_count--;
-						if (OsirisTimers[i].repeat_count <= 0)
-						{
-							//remove the timer
-							kill = true;
-							OsirisTimers[i].repeat_count = 0;
-						}
-						else
-						{
-							//adjust for next signal
-							OsirisTimers[i].timer_next_signal += OsirisTimers[i].timer_interval;
-						}
-					}
-					else
-					{
-						//infinite repeat
-						OsirisTimers[i].timer_next_signal += OsirisTimers[i].timer_interval;
-					}
+	int* link = &Osiris_timer_handle_hash[Osiris_TimerHandleBucket(OsirisTimers[slot].handle)];
 
+	while (*link != slot)
+		link = &OsirisTimers[*link].next_handle;
 
-				}
-			}
+	*link = OsirisTimers[slot].next_handle;
+	OsirisTimers[slot].handle_hashed = false;
+}
 
-			if ((!((OsirisTimers[i].flags & OITF_REPEATCALL) && (OsirisTimers[i].repeat_count == -1))) &&
-				OsirisTimers[i].timer_end <= Gametime)
-			{
+// Returns the slot the timer with this handle is (or was last) in, or -1
+static int Osiris_FindTimerHandle(int handle)
+{
+	for (int i = Osiris_timer_handle_hash[Osiris_TimerHandleBucket(handle)]; i != -1; i = OsirisTimers[i].next_handle)
+	{
+		if (OsirisTimers[i].handle == handle)
+			return i;
+	}
 
-				//this timer has expired, remove it
-				kill = true;
-				//signal timer
-				signal = true;
-			}
+	return -1;
+}
 
-			if (signal)
-			{
-				ei.evt_timer.game_time = Gametime;
-				ei.evt_timer.id = OsirisTimers[i].id;
-			}
+// Returns the lowest slot of a running timer with this id, or -1
+static int Osiris_FindTimerID(int id)
+{
+	int found = -1;
 
-			//this timer is currently in use, see what kind of trigger it is
-			if (OsirisTimers[i].flags & OITF_TRIGGERTIMER)
-			{
-				//trigger timer
-				if (signal)
-					Osiris_CallTriggerEvent(OsirisTimers[i].trignum, EVT_TIMER, &ei);
-			}
-			else if (OsirisTimers[i].flags & OITF_LEVELTIMER)
-			{
-				//level timer
-				if (signal)
-					Osiris_CallLevelEvent(EVT_TIMER, &ei);
-			}
-			else
+	for (int i = Osiris_timer_id_hash[Osiris_TimerIDBucket(id)]; i != -1; i = OsirisTimers[i].next_id)
+	{
+		if (OsirisTimers[i].id == id && (found == -1 || i < found))
+			found = i;
+	}
+
+	return found;
+}
+
+// Adds a running timer to the lookups and the queue
+static void Osiris_LinkTimer(int slot)
+{
+	tOSIRISINTERNALTIMER* t = &OsirisTimers[slot];
+	int bucket;
+
+	bucket = Osiris_TimerIDBucket(t->id);
+	t->prev_id = -1;
+	t->next_id = Osiris_timer_id_hash[bucket];
+	if (t->next_id != -1)
+		OsirisTimers[t->next_id].prev_id = slot;
+	Osiris_timer_id_hash[bucket] = slot;
+
+	if (Osiris_IsObjectTimer(t))
+	{
+		bucket = Osiris_TimerObjBucket(t->objhandle);
+		t->prev_obj = -1;
+		t->next_obj = Osiris_timer_obj_hash[bucket];
+		if (t->next_obj != -1)
+			OsirisTimers[t->next_obj].prev_obj = slot;
+		Osiris_timer_obj_hash[bucket] = slot;
+	}
+
+	if (t->flags & OITF_CANCELONDEAD)
+	{
+		t->prev_poll = -1;
+		t->next_poll = Osiris_timer_poll_list;
+		if (t->next_poll != -1)
+			OsirisTimers[t->next_poll].prev_poll = slot;
+		Osiris_timer_poll_list = slot;
+	}
+
+	Osiris_TimerQueueInsert(slot);
+}
+
+// Removes a timer from the lookups and the queue.  The handle hash is left alone.
+static void Osiris_UnlinkTimer(int slot)
+{
+	tOSIRISINTERNALTIMER* t = &OsirisTimers[slot];
+
+	if (t->prev_id == -1)
+		Osiris_timer_id_hash[Osiris_TimerIDBucket(t->id)] = t->next_id;
+	else
+		OsirisTimers[t->prev_id].next_id = t->next_id;
+	if (t->next_id != -1)
+		OsirisTimers[t->next_id].prev_id = t->prev_id;
+
+	if (Osiris_IsObjectTimer(t))
+	{
+		if (t->prev_obj == -1)
+			Osiris_timer_obj_hash[Osiris_TimerObjBucket(t->objhandle)] = t->next_obj;
+		else
+			OsirisTimers[t->prev_obj].next_obj = t->next_obj;
+		if (t->next_obj != -1)
+			OsirisTimers[t->next_obj].prev_obj = t->prev_obj;
+	}
+
+	if (t->flags & OITF_CANCELONDEAD)
+	{
+		if (t->prev_poll == -1)
+			Osiris_timer_poll_list = t->next_poll;
+		else
+			OsirisTimers[t->prev_poll].next_poll = t->next_poll;
+		if (t->next_poll != -1)
+			OsirisTimers[t->next_poll].prev_poll = t->prev_poll;
+	}
+
+	Osiris_TimerQueueRemove(slot);
+	t->orphaned = false;
+}
+
+// Stops a timer and gives its slot back
+static void Osiris_FreeTimer(int slot)
+{
+	if (!(OsirisTimers[slot].flags & OITF_USED))
+		return;
+
+	Osiris_UnlinkTimer(slot);
+	OsirisTimers[slot].flags &= ~OITF_USED;
+
+	Osiris_timer_free[Osiris_num_free_timers++] = slot;
+	std::push_heap(Osiris_timer_free, Osiris_timer_free + Osiris_num_free_timers, std::greater<int>());
+}
+
+// Sends a timer event to whatever owns the timer.  An object timer's event goes nowhere if the
+// object is gone, hook or not.
+static void Osiris_SendTimerEvent(tOSIRISINTERNALTIMER* t, int event, tOSIRISEventInfo* ei)
+{
+	object* obj = NULL;
+
+	if (Osiris_IsObjectTimer(t) && !(obj = ObjGet(t->objhandle)))
+		return;
+
+	if (Osiris_timer_hook)
+	{
+		(*Osiris_timer_hook)(t->handle, event, ei);
+		return;
+	}
+
+	if (t->flags & OITF_TRIGGERTIMER)
+	{
+		Osiris_CallTriggerEvent(t->trignum, event, ei);
+	}
+	else if (t->flags & OITF_LEVELTIMER)
+	{
+		Osiris_CallLevelEvent(event, ei);
+	}
+	else
+	{
+		Osiris_CallEvent(obj, event, ei);
+	}
+}
+
+//	Osiris_ProcessTimer
+//	Purpose:
+//		Checks one running timer, and signals it if it's time
+static void Osiris_ProcessTimer(int i)
+{
+	object* obj;
+	bool signal, kill;
+	tOSIRISEventInfo ei;
+
+	signal = false;
+	kill = false;
+
+	if (OsirisTimers[i].flags & OITF_CANCELONDEAD)
+	{
+		obj = ObjGet(OsirisTimers[i].objhandle_detonator);
+		if (!obj || (obj->type == OBJ_GHOST) || (obj->type == OBJ_PLAYER && Players[obj->id].flags & (PLAYER_FLAGS_DYING | PLAYER_FLAGS_DEAD))) {
+			//the detontator died...cancel the timer!
+			Osiris_FreeTimer(i);
+			OsirisTimers[i].repeat_count = 0;
+
+			tOSIRISEventInfo ei;
+			ei.evt_timercancel.detonated = 1;
+			ei.evt_timercancel.handle = OsirisTimers[i].handle;
+
+			Osiris_SendTimerEvent(&OsirisTimers[i], EVT_TIMERCANCEL, &ei);
+
+			mprintf((0, "OSIRIS TIMER: Cancelling Timer (%d/%d)\n", OsirisTimers[i].handle, i));
+			return;
+		}
+	}
+
+	if (OsirisTimers[i].timer_next_signal <= Gametime)
+	{
+		//this timer needs to be signaled
+		signal = true;
+
+		if (OsirisTimers[i].flags & OITF_REPEATCALL)
+		{
+			//this is a repeater
+			if (OsirisTimers[i].repeat_count != -1)
 			{
-				//object timer
-				obj = ObjGet(OsirisTimers[i].objhandle);
-				if (obj)
+				//it has a finite repeat
+				OsirisTimers[i].repeat_count--;
+				if (OsirisTimers[i].repeat_count <= 0)
 				{
-					//process this object timer
-					if (signal)
-						Osiris_CallEvent(obj, EVT_TIMER, &ei);
+					//remove the timer
+					kill = true;
+					OsirisTimers[i].repeat_count = 0;
 				}
 				else
 				{
-					//this object no longer exists, remove the timer
-					kill = true;
+					//adjust for next signal
+					OsirisTimers[i].timer_next_signal += OsirisTimers[i].timer_interval;
 				}
 			}
+			else
+			{
+				//infinite repeat
+				OsirisTimers[i].timer_next_signal += OsirisTimers[i].timer_interval;
+			}
+
+
+		}
+	}
+
+	if ((!((OsirisTimers[i].flags & OITF_REPEATCALL) && (OsirisTimers[i].repeat_count == -1))) &&
+		OsirisTimers[i].timer_end <= Gametime)
+	{
+
+		//this timer has expired, remove it
+		kill = true;
+		//signal timer
+		signal = true;
+	}
+
+	if (signal)
+	{
+		ei.evt_timer.game_time = Gametime;
+		ei.evt_timer.id = OsirisTimers[i].id;
+	}
+
+	if (Osiris_IsObjectTimer(&OsirisTimers[i]) && !ObjGet(OsirisTimers[i].objhandle))
+	{
+		//this object no longer exists, remove the timer
+		kill = true;
+	}
+	else if (signal)
+	{
+		Osiris_SendTimerEvent(&OsirisTimers[i], EVT_TIMER, &ei);
+	}
+
+	if (kill)
+		Osiris_FreeTimer(i);
+}
+
+//	Osiris_ProcessTimers
+//	Purpose:
+//		This function checks all timers currently running, if any need to be signaled it signals them.
+void Osiris_ProcessTimers(void)
+{
+	int i;
+
+	if (Osiris_timer_check_all)
+	{
+		for (i = 0; i < MAX_OSIRIS_TIMERS; i++)
+		{
+			if (OsirisTimers[i].flags & OITF_USED)
+				Osiris_TimerAddWork(i);
+		}
+
+		Osiris_timer_check_all = false;
+	}
 
-			if (kill)
-				OsirisTimers[i].flags &= ~OITF_USED;
+	//timers that are due
+	while (Osiris_timer_queue_size > 0 && OsirisTimers[Osiris_timer_queue[0]].due <= Gametime)
+	{
+		i = Osiris_timer_queue[0];
+		Osiris_TimerQueueRemove(i);
+		Osiris_TimerAddWork(i);
+	}
+
+	//timers whose detonator might have died
+	for (i = Osiris_timer_poll_list; i != -1; i = OsirisTimers[i].next_poll)
+		Osiris_TimerAddWork(i);
+
+	//timers whose object was deleted
+	for (int n = 0; n < Osiris_num_timer_orphans; n++)
+	{
+		i = Osiris_timer_orphans[n];
+		if (OsirisTimers[i].orphaned)
+		{
+			OsirisTimers[i].orphaned = false;
+			Osiris_TimerAddWork(i);
 		}
 	}
+	Osiris_num_timer_orphans = 0;
+
+	while (Osiris_num_timer_work > 0)
+	{
+		std::pop_heap(Osiris_timer_work, Osiris_timer_work + Osiris_num_timer_work, std::greater<int>());
+		i = Osiris_timer_work[--Osiris_num_timer_work];
+		OsirisTimers[i].in_work = false;
+
+		if (!(OsirisTimers[i].flags & OITF_USED))
+			continue;
+
+		Osiris_timer_current = i;
+
+		Osiris_TimerQueueRemove(i);
+		Osiris_ProcessTimer(i);
+
+		//requeue it for its next signal (unless an event already put a new timer in this slot)
+		if ((OsirisTimers[i].flags & OITF_USED) && OsirisTimers[i].queue_index == -1)
+			Osiris_TimerQueueInsert(i);
+	}
+
+	Osiris_timer_current = -1;
 }
 
 
@@ -2233,10 +2603,48 @@ void Osiris_ProcessTimers(void)
 //		Flushes all the timers
 void Osiris_ResetAllTimers(void)
 {
-	for (int i = 0; i < MAX_OSIRIS_TIMERS; i++)
+	int i;
+
+	for (i = 0; i < MAX_OSIRIS_TIMERS; i++)
 	{
 		OsirisTimers[i].flags = 0;
+		OsirisTimers[i].queue_index = -1;
+		OsirisTimers[i].in_work = false;
+		OsirisTimers[i].orphaned = false;
+
+		//an ascending list is already a heap
+		Osiris_timer_free[i] = i;
+	}
+
+	for (i = 0; i < OSIRIS_TIMER_HASH_SIZE; i++)
+	{
+		Osiris_timer_id_hash[i] = -1;
+		Osiris_timer_obj_hash[i] = -1;
 	}
+
+	Osiris_num_free_timers = MAX_OSIRIS_TIMERS;
+	Osiris_timer_queue_size = 0;
+	Osiris_num_timer_work = 0;
+	Osiris_num_timer_orphans = 0;
+	Osiris_timer_poll_list = -1;
+	Osiris_timer_check_all = false;
+}
+
+//	Osiris_InitTimers
+//	Purpose:
+//		Sets up the timer system, forgetting all the old handles
+void Osiris_InitTimers(void)
+{
+	for (int i = 0; i < MAX_OSIRIS_TIMERS; i++)
+	{
+		OsirisTimers[i].handle = 0;
+		OsirisTimers[i].handle_hashed = false;
+	}
+
+	for (int i = 0; i < OSIRIS_TIMER_HASH_SIZE; i++)
+		Osiris_timer_handle_hash[i] = -1;
+
+	Osiris_ResetAllTimers();
 }
 
 
@@ -2246,17 +2654,18 @@ void Osiris_ResetAllTimers(void)
 //	Returns an id to the timer, which can be used to cancel a timer. -1 on error.
 int Osiris_CreateTimer(tOSIRISTIMER* ot)
 {
-	//find an empty timer
+	//find an empty timer, lowest slot first
 	int i;
-	for (i = 0; i < MAX_OSIRIS_TIMERS; i++)
-	{
-		if (!(OsirisTimers[i].flags & OITF_USED))
-			break;
-	}
 
-	if (i >= MAX_OSIRIS_TIMERS)
+	if (Osiris_num_free_timers == 0)
 		return -1;//no more slots available
 
+	std::pop_heap(Osiris_timer_free, Osiris_timer_free + Osiris_num_free_timers, std::greater<int>());
+	i = Osiris_timer_free[--Osiris_num_free_timers];
+
+	//this slot's old handle is no longer valid
+	Osiris_TimerUnhashHandle(i);
+
 	//clear out the slots
 	OsirisTimers[i].flags = 0;
 	OsirisTimers[i].id = 0;
@@ -2313,6 +2722,17 @@ int Osiris_CreateTimer(tOSIRISTIMER* ot)
 
 	OsirisTimers[i].handle = handle;
 
+	Osiris_TimerHashHandle(i);
+	Osiris_LinkTimer(i);
+
+	//a timer for an object that's already gone is removed the next time it's looked at, and one
+	//created by an event gets looked at this frame if its slot hasn't been passed yet
+	if ((Osiris_timer_current != -1 && i > Osiris_timer_current) ||
+		(Osiris_IsObjectTimer(&OsirisTimers[i]) && !ObjGet(OsirisTimers[i].objhandle)))
+	{
+		Osiris_TimerCheckSoon(i);
+	}
+
 	return handle;
 }
 
@@ -2324,34 +2744,18 @@ void Osiris_CancelTimer(int handle)
 {
 	int slot;
 
-	slot = GET_SLOT(handle);
-
-	if (slot < 0 || slot >= MAX_OSIRIS_TIMERS)
-		return;
+	slot = Osiris_FindTimerHandle(handle);
 
-	if (OsirisTimers[slot].handle != handle)	//not the same timer
+	if (slot == -1)	//not the same timer
 		return;
 
-	OsirisTimers[slot].flags &= ~OITF_USED;
+	Osiris_FreeTimer(slot);
 
 	tOSIRISEventInfo ei;
 	ei.evt_timercancel.detonated = 0;
 	ei.evt_timercancel.handle = handle;
 
-	if (OsirisTimers[slot].flags & OITF_TRIGGERTIMER)
-	{
-		Osiris_CallTriggerEvent(OsirisTimers[slot].trignum, EVT_TIMERCANCEL, &ei);
-	}
-	else if (OsirisTimers[slot].flags & OITF_LEVELTIMER)
-	{
-		Osiris_CallLevelEvent(EVT_TIMERCANCEL, &ei);
-	}
-	else
-	{
-		object* obj = ObjGet(OsirisTimers[slot].objhandle);
-		if (obj)
-			Osiris_CallEvent(obj, EVT_TIMERCANCEL, &ei);
-	}
+	Osiris_SendTimerEvent(&OsirisTimers[slot], EVT_TIMERCANCEL, &ei);
 }
 
 //	Osiris_GetTimerHandle
@@ -2360,13 +2764,12 @@ void Osiris_CancelTimer(int handle)
 int Osiris_GetTimerHandle(int id)
 {
 	//Look for timer with this ID
-	for (int i = 0; i < MAX_OSIRIS_TIMERS; i++)
-	{
-		if ((OsirisTimers[i].flags & OITF_USED) && (OsirisTimers[i].id == id))
-			return OsirisTimers[i].handle;
-	}
+	int slot = Osiris_FindTimerID(id);
+
+	if (slot == -1)
+		return 0;
 
-	return 0;
+	return OsirisTimers[slot].handle;
 }
 
 //	Osiris_CancelTimer
@@ -2375,13 +2778,21 @@ int Osiris_GetTimerHandle(int id)
 void Osiris_CancelTimerID(int id)
 {
 	//Look for timer with this ID
-	for (int i = 0; i < MAX_OSIRIS_TIMERS; i++)
+	int slot = Osiris_FindTimerID(id);
+
+	if (slot != -1)
+		Osiris_CancelTimer(OsirisTimers[slot].handle);
+}
+
+//	Osiris_TimerObjectDeleted
+//	Purpose:
+//		Called when an object is deleted, so its timers get removed
+void Osiris_TimerObjectDeleted(int objhandle)
+{
+	for (int i = Osiris_timer_obj_hash[Osiris_TimerObjBucket(objhandle)]; i != -1; i = OsirisTimers[i].next_obj)
 	{
-		if ((OsirisTimers[i].flags & OITF_USED) && (OsirisTimers[i].id == id))
-		{
-			Osiris_CancelTimer(OsirisTimers[i].handle);
-			return;
-		}
+		if (OsirisTimers[i].objhandle == objhandle)
+			Osiris_TimerCheckSoon(i);
 	}
 }
 
@@ -2390,17 +2801,14 @@ void Osiris_CancelTimerID(int id)
 //		Returns true if the timer is valid
 ubyte Osiris_TimerExists(int handle)
 {
-	int id = GET_SLOT(handle);
+	int id = Osiris_FindTimerHandle(handle);
 
-	if (id < 0 || id >= MAX_OSIRIS_TIMERS)
+	if (id == -1)	//not the same timer
 		return false;
 
 	if (!(OsirisTimers[id].flags & OITF_USED))
 		return false;
 
-	if (OsirisTimers[id].handle != handle)	//not the same timer
-		return false;
-
 	return true;
 }
 
@@ -2410,22 +2818,30 @@ ubyte Osiris_TimerExists(int handle)
 //		Returns the amount of time remaining on the specified timer
 float Osiris_TimerTimeRemaining(int handle)
 {
-	int id = GET_SLOT(handle);
+	int id = Osiris_FindTimerHandle(handle);
 
-	if (id < 0 || id >= MAX_OSIRIS_TIMERS)
+	if (id == -1)	//not the same timer
 		return -1.0;
 
 	if (!(OsirisTimers[id].flags & OITF_USED))
 		return -1.0;
 
-	if (OsirisTimers[id].handle != handle)	//not the same timer
-		return -1.0;
-
 	return (OsirisTimers[id].timer_end - Gametime);
 }
 
 
-#define OSIRIS_SYSTEM_FILEVERSION	0x01
+//	Osiris_SetTimerEventHook
+//	Purpose:
+//		Sends timer events to hook instead of the scripts that own the timers, or back to the
+//	scripts if hook is NULL
+void Osiris_SetTimerEventHook(osiris_timer_hook hook)
+{
+	Osiris_timer_hook = hook;
+}
+
+
+#define OSIRIS_SYSTEM_FILEVERSION	0x02		// 0x02: only running timers are saved, with their slot
+#define OSIRIS_V1_TIMERS				64			// Timer slots in version 0x01 files
 //	Osiris_SaveSystemState
 //	Purpose:
 //		Saves the current state of the system (not the scripts!) to file
@@ -2445,11 +2861,20 @@ void Osiris_SaveSystemState(CFILE* file)
 	cf_WriteInt(file, Osiris_timer_counter);
 
 	//save out the timer state
+	int num_timers = 0;
+	for (i = 0; i < MAX_OSIRIS_TIMERS; i++)
+	{
+		if (OsirisTimers[i].flags & OITF_USED)
+			num_timers++;
+	}
+
+	cf_WriteInt(file, num_timers);
+
 	for (i = 0; i < MAX_OSIRIS_TIMERS; i++)
 	{
 		if (OsirisTimers[i].flags & OITF_USED) {
 			//write out information about this timer
-			cf_WriteByte(file, 1);	//timer exists
+			cf_WriteInt(file, i);
 			cf_WriteShort(file, OsirisTimers[i].flags);
 			cf_WriteInt(file, OsirisTimers[i].id);
 			cf_WriteInt(file, OsirisTimers[i].repeat_count);
@@ -2460,10 +2885,6 @@ void Osiris_SaveSystemState(CFILE* file)
 			cf_WriteInt(file, OsirisTimers[i].objhandle_detonator);
 			cf_WriteInt(file, OsirisTimers[i].handle);
 		}
-		else
-		{
-			cf_WriteByte(file, 0);
-		}
 	}
 
 	//auto-save script mallocs
@@ -2570,28 +2991,64 @@ bool Osiris_RestoreSystemState(CFILE* file)
 	Osiris_timer_counter = cf_ReadInt(file);
 
 	//restore timer state	
-	for (i = 0; i < MAX_OSIRIS_TIMERS; i++)
+	Osiris_InitTimers();
+
+	int num_timers = (version < 0x02) ? OSIRIS_V1_TIMERS : cf_ReadInt(file);
+	if (num_timers < 0 || num_timers > MAX_OSIRIS_TIMERS)
 	{
-		if (cf_ReadByte(file))
-		{
-			//timer is used
-			OsirisTimers[i].flags = cf_ReadShort(file);
-			OsirisTimers[i].id = cf_ReadInt(file);
-			OsirisTimers[i].repeat_count = cf_ReadInt(file);
-			OsirisTimers[i].timer_interval = cf_ReadFloat(file);
-			OsirisTimers[i].timer_next_signal = cf_ReadFloat(file);
-			OsirisTimers[i].timer_end = cf_ReadFloat(file);
-			OsirisTimers[i].objhandle = cf_ReadInt(file);
-			OsirisTimers[i].objhandle_detonator = cf_ReadInt(file);
-			OsirisTimers[i].handle = cf_ReadInt(file);
+		mprintf((0, "OSIRIS: Bad timer count %d\n", num_timers));
+		Osiris_InitTimers();
+		return false;
+	}
 
+	for (int n = 0; n < num_timers; n++)
+	{
+		if (version < 0x02)
+		{
+			//every slot was saved, with a byte saying if it was used
+			i = n;
+			if (!cf_ReadByte(file))
+				continue;
 		}
 		else
 		{
-			OsirisTimers[i].flags = 0;
+			i = cf_ReadInt(file);
+
+			//a slot out of range or saved twice means the file is bad
+			if (i < 0 || i >= MAX_OSIRIS_TIMERS || OsirisTimers[i].handle_hashed)
+			{
+				mprintf((0, "OSIRIS: Bad timer slot %d\n", i));
+				Osiris_InitTimers();
+				return false;
+			}
 		}
+
+		//timer is used
+		OsirisTimers[i].flags = cf_ReadShort(file);
+		OsirisTimers[i].id = cf_ReadInt(file);
+		OsirisTimers[i].repeat_count = cf_ReadInt(file);
+		OsirisTimers[i].timer_interval = cf_ReadFloat(file);
+		OsirisTimers[i].timer_next_signal = cf_ReadFloat(file);
+		OsirisTimers[i].timer_end = cf_ReadFloat(file);
+		OsirisTimers[i].objhandle = cf_ReadInt(file);
+		OsirisTimers[i].objhandle_detonator = cf_ReadInt(file);
+		OsirisTimers[i].handle = cf_ReadInt(file);
+
+		Osiris_TimerHashHandle(i);
+		Osiris_LinkTimer(i);
+	}
+
+	//rebuild the free slot heap, lowest first
+	Osiris_num_free_timers = 0;
+	for (i = 0; i < MAX_OSIRIS_TIMERS; i++)
+	{
+		if (!(OsirisTimers[i].flags & OITF_USED))
+			Osiris_timer_free[Osiris_num_free_timers++] = i;
 	}
 
+	//objects were restored too, so look at every timer once
+	Osiris_timer_check_all = true;
+
 	//restore auto-saved memory chunks
 	Osiris_RestoreMemoryChunks(file);
 
@@ -1901,7 +1901,7 @@ void PlayerSpewGuidebot(object* parent, int type, int id)
 	obj->movement_type = MT_PHYSICS;
 
 	ASSERT(obj != Player_object);
-	obj->type = OBJ_DEBRIS;
+	ObjSetType(obj, OBJ_DEBRIS);
 	SetObjectControlType(obj, CT_DEBRIS);	//become debris while exploding
 	obj->lifeleft = 5.0 + ((ps_rand() % 50) * .05);
 	obj->flags |= OF_USES_LIFELEFT;
@@ -2724,7 +2724,7 @@ void PlayerSwitchToObserver(int slot, int observer_mode, int piggy_objnum)
 	if (Demo_flags != DF_PLAYBACK)
 		PlayerSpewInventory(obj, false);
 
-	obj->type = OBJ_OBSERVER;
+	ObjSetType(obj, OBJ_OBSERVER);
 	obj->render_type = RT_NONE;
 
 	if (Demo_flags == DF_RECORDING)
@@ -2771,7 +2771,7 @@ void PlayerStopObserving(int slot)
 
 	object* obj = &Objects[Players[slot].objnum];
 
-	obj->type = OBJ_PLAYER;
+	ObjSetType(obj, OBJ_PLAYER);
 	Players[slot].piggy_objnum = -1;
 
 	InitPlayerNewShip(slot, INVRESET_ALL);
@@ -189,6 +189,9 @@ bool ObjectsAreRelated(int o1, int o2)
 
 bool Enable_omega_collions = false;
 
+// Types of object homing and electrical weapons can lock on to
+#define HOMING_TARGET_TYPES	(OBJ_TYPE_BIT(OBJ_PLAYER) | OBJ_TYPE_BIT(OBJ_ROBOT) | OBJ_TYPE_BIT(OBJ_BUILDING))
+
 // Picks out a target for an elecrical weapon to fire on
 void AquireElectricalTarget(object* obj)
 {
@@ -199,7 +202,7 @@ void AquireElectricalTarget(object* obj)
 
 	if (obj->mtype.phys_info.flags & PF_HOMING)
 	{
-		for (i = 0; i <= Highest_object_index; i++)
+		for (i = ObjFirstOfTypes(HOMING_TARGET_TYPES); i != -1; i = ObjNextOfTypes(HOMING_TARGET_TYPES, i))
 		{
 			hit_obj_ptr = &Objects[i];
 
@@ -734,7 +737,7 @@ object* HomingAquireTarget(object* obj)
 		{
 			obj->ctype.laser_info.last_track_time = Gametime;
 
-			for (i = 0; i <= Highest_object_index; i++)
+			for (i = ObjFirstOfTypes(HOMING_TARGET_TYPES); i != -1; i = ObjNextOfTypes(HOMING_TARGET_TYPES, i))
 			{
 				if (BOA_IsVisible(obj->roomnum, Objects[i].roomnum))
 				{
@@ -2665,7 +2668,7 @@ object* FindSpawnHomingTarget(object* obj)
 	int best_index = -1;
 	object* weapon_parent = ObjGet(obj->parent_handle);
 
-	for (i = 0; i <= Highest_object_index; i++)
+	for (i = ObjFirstOfTypes(HOMING_TARGET_TYPES); i != -1; i = ObjNextOfTypes(HOMING_TARGET_TYPES, i))
 	{
 		if ((i != OBJNUM(weapon_parent)) && ((Objects[i].type == OBJ_ROBOT) || (Objects[i].type == OBJ_PLAYER) || (Objects[i].type == OBJ_BUILDING && Objects[i].ai_info)))
 		{
@@ -629,7 +629,7 @@ int DemoReadHeader()
 			if ((Objects[j].type == OBJ_PLAYER) && (Objects[j].id != Player_num))
 			{
 				object* objp = &Objects[j];
-				objp->type = OBJ_GHOST;
+				ObjSetType(objp, OBJ_GHOST);
 				objp->movement_type = MT_NONE;
 				objp->render_type = RT_NONE;
 				SetObjectControlType(objp, CT_NONE);
@@ -46,6 +46,7 @@
 #include "multi_dll_mgr.h"
 #include "localization.h"
 #include "mem.h"
+#include "rtperformance.h"
 
 //	---------------------------------------------------------------------------
 //	Variables
@@ -232,6 +233,8 @@ extern float gamegauge_start_time;
 extern int gamegauge_total_frames;
 extern float gamegauge_total_time;
 extern short gamegauge_fpslog[GAMEGAUGE_MAX_LOG];
+extern bool Game_benchmark;
+extern char Game_benchmark_logfile[_MAX_PATH];
 
 //#endif
 
@@ -329,6 +332,13 @@ void MainLoop()
 			
 			cfclose(cfp);
 		}
+
+		if(Game_benchmark)
+		{
+			char benchfile[_MAX_PATH*2];
+			ddio_MakePath(benchfile,User_directory,Game_benchmark_logfile,NULL);
+			rtp_WriteBenchmark(benchfile);
+		}
 	}
 #if defined(OEM) 
 	if(!Dedicated_server)
@@ -50,6 +50,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "psrand.h"
+#include "objgrid.h"
 #include <algorithm>
 
 // If an objects size is bigger than this, we create size/threshold extra explosions
@@ -916,7 +917,7 @@ void DestroyObject(object* objp, float explosion_mag, int death_flags)
 	if (death_flags & DF_REMAINS)
 	{		//Make object do nothing
 		SetObjectControlType(objp, CT_NONE);
-		objp->type = OBJ_DEBRIS;		//do it won't do idle animation
+		ObjSetType(objp, OBJ_DEBRIS);		//do it won't do idle animation
 		objp->movement_type = MT_NONE;
 	}
 	else if (death_flags & DF_FADE_AWAY)
@@ -1161,7 +1162,7 @@ void DoGravityFieldEffect(object* obj)
 		}
 	}
 
-	for (i = 0; i <= Highest_object_index; i++)
+	for (i = ObjFirstLive(); i != -1; i = ObjNextLive(i))
 	{
 		hit_obj_ptr = &Objects[i];
 		if (!(hit_obj_ptr->type == OBJ_PLAYER || hit_obj_ptr->type == OBJ_ROBOT || hit_obj_ptr->type == OBJ_WEAPON || hit_obj_ptr->type == OBJ_POWERUP || hit_obj_ptr->type == OBJ_CLUTTER || (hit_obj_ptr->type == OBJ_BUILDING && hit_obj_ptr->ai_info)))
@@ -1364,9 +1365,16 @@ void DoConcussiveForce(object* explode_obj_ptr, int parent_handle, float player_
 		float damage;
 		int i;
 		object* hit_obj_ptr;
+		short near_list[MAX_OBJECTS];
+		int num_near;
 
-		for (i = 0; i <= Highest_object_index; i++)
+		// Only look at objects that could be within effect_distance
+		num_near = ObjGridQuerySphere(&explode_obj_ptr->pos, effect_distance, near_list, MAX_OBJECTS);
+
+		for (int n = 0; n < num_near; n++)
 		{
+			i = near_list[n];
+
 			//	Weapons used to be affected by badass explosions, but this introduces serious problems.
 			//	When a smart bomb blows up, if one of its children goes right towards a nearby wall, it will
 			//	blow up, blowing up all the children.  So I remove it.  MK, 09/11/94
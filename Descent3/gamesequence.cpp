@@ -38,6 +38,7 @@
 #include "SmallViews.h"
 #include "polymodel.h"
 #include "gametexture.h"
+#include "CFILE.H"
 #include "hud.h"
 #include "findintersection.h"
 #include "menu.h"
@@ -85,6 +86,7 @@
 #include "vclip.h"
 #include "bsp.h"
 #include "vibeinterface.h"
+#include "rtperformance.h"
 
 #include "args.h"
 void ResetHudMessages(void);
@@ -460,6 +462,7 @@ void StartLevelSounds();
 //#ifdef GAMEGAUGE
 extern float gamegauge_start_time;
 //#endif
+extern bool Game_benchmark;
 
 //Get rid of any viewer objects in the level
 void ClearViewerObjects()
@@ -671,6 +674,8 @@ void StartLevel()
 	//Start the clock
 	InitFrameTime();
 	gamegauge_start_time = timer_GetTime();
+	if (Game_benchmark)
+		rtp_StartBenchmark();
 	LoadLevelProgress(LOAD_PROGRESS_DONE, 0);
 }
 
@@ -1853,5 +1858,9 @@ void PageInAllData()
 			continue;
 		}
 	}
+
+	//Everything's paged in, so drop whatever prefetched data didn't get used
+	cf_EndPrefetch();
+
 	LoadLevelProgress(LOAD_PROGRESS_PREPARE, 0);
 }
@@ -239,6 +239,66 @@ void FreeStaticProceduralsForTexture(int handle)
 
 
 
+// Returns true if a procedural texture should be evaluated this frame
+static bool ProceduralIsDue(int handle, bool force)
+{
+	int do_eval = 1;
+
+	if (GameTextures[handle].procedural == NULL)
+		AllocateProceduralForTexture(handle);
+
+	if (GameTextures[handle].procedural->last_procedural_frame == FrameCount)
+		do_eval = 0;
+	if (timer_GetTime() < GameTextures[handle].procedural->last_evaluation_time + GameTextures[handle].procedural->evaluation_time)
+		do_eval = 0;
+
+	if (!force && !Detail_settings.Procedurals_enabled)
+	{
+		if (timer_GetTime() < GameTextures[handle].procedural->last_evaluation_time + 10.0)
+			do_eval = 0;
+	}
+
+	return do_eval != 0;
+}
+
+// Records that a procedural texture was just evaluated and flags its bitmap for upload
+static void ProceduralEvaluated(int handle)
+{
+	GameTextures[handle].procedural->last_procedural_frame = FrameCount;
+	GameTextures[handle].procedural->last_evaluation_time = timer_GetTime();
+	GameBitmaps[GameTextures[handle].procedural->procedural_bitmap].flags |= BF_CHANGED;
+}
+
+static int Proc_queue[MAX_TEXTURES];
+static int Num_proc_queue = 0;
+
+// Adds a texture to the ones evaluated by EvaluateQueuedProcedurals(), if it is a procedural
+// that GetTextureBitmap() would evaluate this frame
+void QueueProceduralTexture(int handle)
+{
+	if (!GameTextures[handle].used || !(GameTextures[handle].flags & TF_PROCEDURAL))
+		return;
+
+	if (Num_proc_queue >= MAX_TEXTURES || !ProceduralIsDue(handle, false))
+		return;
+
+	// So it can't be queued twice
+	GameTextures[handle].procedural->last_procedural_frame = FrameCount;
+
+	Proc_queue[Num_proc_queue++] = handle;
+}
+
+// Evaluates the queued procedurals together, in the order they were queued
+void EvaluateQueuedProcedurals()
+{
+	EvaluateProcedurals(Proc_queue, Num_proc_queue);
+
+	for (int i = 0; i < Num_proc_queue; i++)
+		ProceduralEvaluated(Proc_queue[i]);
+
+	Num_proc_queue = 0;
+}
+
 // Given a texture handle, returns that textures bitmap
 // If the texture is animated, returns framenum mod num_of_frames in the animation
 // Force is to force the evaluation of a procedural
@@ -292,32 +352,12 @@ int GetTextureBitmap(int handle, int framenum, bool force)
 
 	if (GameTextures[handle].flags & TF_PROCEDURAL)	// Do a procedural
 	{
-		int do_eval = 1;
-
-		if (GameTextures[handle].procedural == NULL)
-			AllocateProceduralForTexture(handle);
-
-		if (GameTextures[handle].procedural->last_procedural_frame == FrameCount)
-			do_eval = 0;
-		if (timer_GetTime() < GameTextures[handle].procedural->last_evaluation_time + GameTextures[handle].procedural->evaluation_time)
-			do_eval = 0;
-
-		if (!force && !Detail_settings.Procedurals_enabled)
-		{
-			if (timer_GetTime() < GameTextures[handle].procedural->last_evaluation_time + 10.0)
-				do_eval = 0;
-		}
-
-		if (do_eval)
+		if (ProceduralIsDue(handle, force))
 		{
 			EvaluateProcedural(handle);
-			GameTextures[handle].procedural->last_procedural_frame = FrameCount;
-			GameTextures[handle].procedural->last_evaluation_time = timer_GetTime();
-			src_bitmap = GameTextures[handle].procedural->procedural_bitmap;
-			GameBitmaps[src_bitmap].flags |= BF_CHANGED;
+			ProceduralEvaluated(handle);
 		}
-		else
-			src_bitmap = GameTextures[handle].procedural->procedural_bitmap;
+		src_bitmap = GameTextures[handle].procedural->procedural_bitmap;
 	}
 
 	return src_bitmap;
@@ -172,6 +172,14 @@ int FindTextureBitmapName (char *name);
 // If the texture is animated, returns framenum mod num_of_frames in the animation
 int GetTextureBitmap (int handle,int framenum,bool force=false);
 
+// Adds a texture to the ones evaluated by EvaluateQueuedProcedurals(), if it is a procedural
+// that GetTextureBitmap() would evaluate this frame.  GetTextureBitmap() won't evaluate it again
+// this frame.
+void QueueProceduralTexture (int handle);
+
+// Evaluates the queued procedurals together, spreading the work across the worker pool
+void EvaluateQueuedProcedurals ();
+
 // Given a filename, loads either the bitmap or vclip found in that file.  If type
 // is not NULL, sets it to 1 if file is animation, otherwise sets it to zero
 int LoadTextureImage (char *filename,int *type,int texture_size,int mipped,int pageable=0,int format=0);
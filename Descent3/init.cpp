@@ -91,6 +91,8 @@
 #include "debuggraph.h"
 #include "rocknride.h"
 #include "vibeinterface.h"
+#include "TaskSystem.h"
+#include "BOA.h"
 
 
 //Uncomment this to allow all languages
@@ -284,6 +286,12 @@ void PreInitD3Systems()
 		Mem_low_memory_mode = false;
 		Mem_superlow_memory_mode = false;
 	}
+	//Read hogs through stdio instead of mapping them into memory
+	if(FindArg("-nomaphogs"))
+		cf_SetLibraryMapping(false);
+	//Start the worker threads.  By default there's one per CPU, less one for the main thread.
+	int workerarg = FindArg("-workerthreads");
+	task_InitPool(workerarg ? atoi(GameArgs[workerarg+1]) : -1);
 	//For the client and the server, this turns off the bitmap exchange system.
 	if(FindArg("-nomultibmp"))
 		Use_file_xfer = 0;
@@ -432,6 +440,8 @@ void SaveGameSettings()
 
 extern bool Game_gauge_do_time_test;
 extern char Game_gauge_usefile[_MAX_PATH];
+extern bool Game_benchmark;
+extern char Game_benchmark_logfile[_MAX_PATH];
 
 /*
 	Read game variables from the registry
@@ -455,6 +465,20 @@ void LoadGameSettings()
 		strcpy(Game_gauge_usefile,GameArgs[tt_arg+1]);
 	}
 
+	int bench_arg = FindArg("-benchmark");
+	if(bench_arg)
+	{
+		//A time test that doesn't wait for the frame cap, and logs how long each system took every frame
+		Game_gauge_do_time_test = true;
+		Game_benchmark = true;
+		strcpy(Game_gauge_usefile,GameArgs[bench_arg+1]);
+		Min_allowed_frametime = 0;
+
+		int benchlog_arg = FindArg("-benchmarklog");
+		if(benchlog_arg)
+			strcpy(Game_benchmark_logfile,GameArgs[benchlog_arg+1]);
+	}
+
 	Detail_settings.Specular_lighting = false;
 	Detail_settings.Dynamic_lighting = true;
 	Detail_settings.Fast_headlight_on = true;
@@ -890,6 +914,17 @@ void InitIOSystems(bool editor)
 	// Setup temp directory
 	SetupTempDirectory();
 
+	// Setup the BOA cache.  Each instance has its own temp directory, so the cache goes somewhere
+	// else, where servers running out of the same directory (or given the same -boacachedir) share it.
+	int boa_arg = FindArg("-boacachedir");
+	if (boa_arg)
+		strcpy(BOA_cache_directory, GameArgs[boa_arg+1]);
+	else
+		ddio_MakePath(BOA_cache_directory, User_directory, "custom", "boa", NULL);
+	if (FindArg("-noboacache") || (!ddio_DirExists(BOA_cache_directory) && !ddio_CreateDir(BOA_cache_directory)))
+		BOA_cache_directory[0] = '\0';
+	mprintf((0,"BOA cache directory set to: \"%s\"\n",BOA_cache_directory));
+
 //	Initialize file system
 	INIT_MESSAGE(("Managing file system."));
 
@@ -1382,6 +1417,14 @@ bool CheckCdForValidity(int cd);
 	{
 		nw_InitNetworking();
 		nw_InitSockets(Gameport);
+
+		// -netsim <loss percent> <latency ms> makes every connection lossy and laggy
+		int netsim_arg = FindArg("-netsim");
+		if (netsim_arg)
+		{
+			float latency = atof(GameArgs[netsim_arg + 2]) / 1000.0f;
+			nw_SetLinkSimulation(atof(GameArgs[netsim_arg + 1]) / 100.0f, latency, latency / 2);
+		}
 		
 		int tcplogarg;
 		tcplogarg = FindArg("-tcplog");
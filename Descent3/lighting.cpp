@@ -35,6 +35,12 @@
 #include "dedicated_server.h"
 #include "objinfo.h"
 #include "Macros.h"
+#include "TaskSystem.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LIGHTING_SSE2
+#include <emmintrin.h>
+#endif
 
 #define NUM_DYNAMIC_CLASSES	7
 #define MAX_DYNAMIC_FACES	2000
@@ -85,6 +91,42 @@ int Num_destroyed_lights_this_frame = 0;
 int Destroyed_light_rooms_this_frame[MAX_DESTROYED_LIGHTS_PER_FRAME];
 int Destroyed_light_faces_this_frame[MAX_DESTROYED_LIGHTS_PER_FRAME];
 
+// A light that reaches part of a face's lightmap, waiting to be applied.  The position and
+// direction are in the face's frame of reference.
+struct light_job
+{
+	matrix facematrix;
+	vector pos;
+	vector direction;
+	float light_dist;
+	float red_scale, green_scale, blue_scale;
+	float dot_range;
+	ushort lmi_handle;
+	ubyte directional;
+	ubyte start_x, start_y, width, height;
+	short next;			// The next light on the same face, or -1
+};
+
+// The texels a set of jobs changed.  x2 and y2 are exclusive.
+struct light_job_rect
+{
+	int x1, y1, x2, y2;
+};
+
+#define MAX_LIGHT_JOBS	4096
+
+static light_job Light_jobs[MAX_LIGHT_JOBS];
+static int Num_light_jobs = 0;
+
+// The first and last job for each dynamic lightmap, or -1
+static short Light_job_first[MAX_DYNAMIC_LIGHTMAPS];
+static short Light_job_last[MAX_DYNAMIC_LIGHTMAPS];
+
+// The dynamic lightmaps that have jobs waiting, and what the jobs changed on each
+static short Light_job_maps[MAX_DYNAMIC_LIGHTMAPS];
+static light_job_rect Light_job_rects[MAX_DYNAMIC_LIGHTMAPS];
+static int Num_light_job_maps = 0;
+
 // Frees memory used by dynamic light structures
 void FreeLighting()
 {
@@ -132,6 +174,9 @@ void InitDynamicLighting()
 	for (i = 0; i < MAX_DYNAMIC_LIGHTMAPS; i++)
 		memset(&Dynamic_lightmaps[i], 0, sizeof(dynamic_lightmap));
 
+	for (i = 0; i < MAX_DYNAMIC_LIGHTMAPS; i++)
+		Light_job_first[i] = -1;
+
 	// Setup ubyte to float
 	for (i = 0; i < 256; i++)
 		Ubyte_to_float[i] = (float)i / 255.0;
@@ -198,6 +243,12 @@ int GetFreeDynamicLightmap(int w, int h)
 	Dynamic_lightmaps[n].mem_ptr = &Dynamic_lightmap_memory[Cur_dynamic_mem_ptr / 2];
 	ASSERT(Dynamic_lightmaps[n].mem_ptr);
 
+	// Nothing has changed yet
+	Dynamic_lightmaps[n].x1 = w;
+	Dynamic_lightmaps[n].y1 = h;
+	Dynamic_lightmaps[n].x2 = 0;
+	Dynamic_lightmaps[n].y2 = 0;
+
 	Cur_dynamic_mem_ptr += total;
 
 	return n;
@@ -255,11 +306,457 @@ void BlendLightingEdges(lightmap_info* lmi_ptr)
 
 }
 
+// Grows the area of a lightmap that has to be uploaded again.  x2 and y2 are exclusive.
+static void AddLightmapChangedRect(int lm_handle, int x1, int y1, int x2, int y2)
+{
+	bms_lightmap* lm = &GameLightmaps[lm_handle];
+
+	if (x1 < 0)
+		x1 = 0;
+	if (y1 < 0)
+		y1 = 0;
+	if (x2 > lm->width)
+		x2 = lm->width;
+	if (y2 > lm->height)
+		y2 = lm->height;
+
+	if (x1 >= x2 || y1 >= y2)
+		return;
+
+	if (!(lm->flags & LF_LIMITS))
+	{
+		lm->cx1 = x1;
+		lm->cy1 = y1;
+		lm->cx2 = x2;
+		lm->cy2 = y2;
+	}
+	else
+	{
+		if (x1 < lm->cx1)
+			lm->cx1 = x1;
+		if (y1 < lm->cy1)
+			lm->cy1 = y1;
+		if (x2 > lm->cx2)
+			lm->cx2 = x2;
+		if (y2 > lm->cy2)
+			lm->cy2 = y2;
+	}
+
+	lm->flags |= (LF_LIMITS | LF_CHANGED);
+}
+
+// Lights a single texel of a dynamic lightmap.  Returns the new texel.
+static inline ushort LightLightmapTexel(ushort lightmap_texel, vector* element_vec, vector* pos, float light_dist, float red_scale, float green_scale, float blue_scale, vector* light_direction, float dot_range)
+{
+	const int red_limit = 31;
+	const int green_limit = 31;
+	const int blue_limit = 31;
+
+	if (!(lightmap_texel & OPAQUE_FLAG))
+		return lightmap_texel;
+
+	float dist = vm_VectorDistanceQuick(element_vec, pos);
+	float scalar = 1.0 - (dist / light_dist);
+
+	if (light_direction)
+	{
+		vector lsubvec = *element_vec - *pos;
+		vm_NormalizeVectorFast(&lsubvec);
+		float dp = vm_DotProduct(&lsubvec, light_direction);
+		if (dp < dot_range)
+			return lightmap_texel;
+		else
+		{
+			float add_scale = (dp - dot_range) / (1.0 - dot_range);
+			scalar *= add_scale;
+		}
+	}
+
+	if (scalar <= 0)
+		return lightmap_texel;
+
+	int r = (lightmap_texel >> 10) & 0x1f;
+	int g = (lightmap_texel >> 5) & 0x1f;
+	int b = lightmap_texel & 0x1f;
+
+	if (red_scale < 0)
+	{
+		// we are subtracting light
+		r = max(0, r + (scalar * red_scale * 31));
+	}
+	else
+	{
+		// we are adding light
+		if (r < red_limit)
+			r = min(red_limit, r + (scalar * red_scale * 31));
+	}
+
+	if (green_scale < 0)
+	{
+		// we are subtracting light
+		g = max(0, g + (scalar * green_scale * 31));
+	}
+	else
+	{
+		// we are adding light
+		if (g < green_limit)
+			g = min(green_limit, g + (scalar * green_scale * 31));
+	}
+
+	if (blue_scale < 0)
+	{
+		// we are subtracting light
+		b = max(0, b + (scalar * blue_scale * 31));
+	}
+	else
+	{
+		if (b < blue_limit)
+			b = min(blue_limit, b + (scalar * blue_scale * 31));
+	}
+
+	return OPAQUE_FLAG | (r << 10) | (g << 5) | b;
+}
+
+// Lights a row of texels one at a time.  The first texel is at start and each one after it is
+// step further along.  Returns the number of texels that changed, and the first and last of them
+// in first_x and last_x.
+int LightLightmapRowScalar(ushort* texels, int width, vector* start, vector* step, vector* pos, float light_dist, float red_scale, float green_scale, float blue_scale, vector* light_direction, float dot_range, int* first_x, int* last_x)
+{
+	vector element_vec = *start;
+	int num_changed = 0;
+
+	for (int x = 0; x < width; x++, element_vec += *step)
+	{
+		ushort lightmap_texel = LightLightmapTexel(texels[x], &element_vec, pos, light_dist, red_scale, green_scale, blue_scale, light_direction, dot_range);
+
+		if (lightmap_texel == texels[x])
+			continue;
+
+		texels[x] = lightmap_texel;
+
+		if (!num_changed)
+			*first_x = x;
+		*last_x = x;
+		num_changed++;
+	}
+
+	return num_changed;
+}
+
+#ifdef LIGHTING_SSE2
+// Same as LightLightmapRowScalar, four texels at a time.  Every step is done in the same order
+// and precision as the scalar code so the results match it bit for bit.
+static int LightLightmapRowSSE2(ushort* texels, int width, vector* start, vector* step, vector* pos, float light_dist, float red_scale, float green_scale, float blue_scale, vector* light_direction, float dot_range, int* first_x, int* last_x)
+{
+	float elem_x[LIGHTMAP_MAX_ROW];
+	float elem_y[LIGHTMAP_MAX_ROW];
+	float elem_z[LIGHTMAP_MAX_ROW];
+	vector element_vec = *start;
+	int num_changed = 0;
+	int x;
+
+	ASSERT(width <= LIGHTMAP_MAX_ROW);
+
+	// Step along the row exactly the way the scalar code does, since a multiply would round differently
+	for (x = 0; x < width; x++, element_vec += *step)
+	{
+		elem_x[x] = element_vec.x;
+		elem_y[x] = element_vec.y;
+		elem_z[x] = element_vec.z;
+	}
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 limit = _mm_set1_ps(31.0f);
+	const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	const __m128i opaque = _mm_set1_epi32(OPAQUE_FLAG);
+	const __m128i component = _mm_set1_epi32(0x1f);
+	const __m128 pos_x = _mm_set1_ps(pos->x);
+	const __m128 pos_y = _mm_set1_ps(pos->y);
+	const __m128 pos_z = _mm_set1_ps(pos->z);
+	const __m128 dist_div = _mm_set1_ps(light_dist);
+	const __m128 scale_r = _mm_set1_ps(red_scale);
+	const __m128 scale_g = _mm_set1_ps(green_scale);
+	const __m128 scale_b = _mm_set1_ps(blue_scale);
+	const __m128 dot = _mm_set1_ps(dot_range);
+	const __m128d dot_div = _mm_set1_pd(1.0 - dot_range);
+	__m128 dir_x = zero, dir_y = zero, dir_z = zero;
+
+	if (light_direction)
+	{
+		dir_x = _mm_set1_ps(light_direction->x);
+		dir_y = _mm_set1_ps(light_direction->y);
+		dir_z = _mm_set1_ps(light_direction->z);
+	}
+
+	for (x = 0; x + 4 <= width; x += 4)
+	{
+		__m128i old_texels = _mm_unpacklo_epi16(_mm_loadl_epi64((__m128i*)&texels[x]), _mm_setzero_si128());
+		__m128 lit = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(old_texels, opaque), opaque));
+
+		if (!_mm_movemask_ps(lit))
+			continue;
+
+		// vm_VectorDistanceQuick
+		__m128 sub_x = _mm_sub_ps(_mm_loadu_ps(&elem_x[x]), pos_x);
+		__m128 sub_y = _mm_sub_ps(_mm_loadu_ps(&elem_y[x]), pos_y);
+		__m128 sub_z = _mm_sub_ps(_mm_loadu_ps(&elem_z[x]), pos_z);
+		__m128 a = _mm_and_ps(sub_x, abs_mask);
+		__m128 b = _mm_and_ps(sub_y, abs_mask);
+		__m128 c = _mm_and_ps(sub_z, abs_mask);
+		__m128 hi = _mm_max_ps(a, b);
+		__m128 lo = _mm_min_ps(a, b);
+		__m128 largest = _mm_max_ps(hi, c);
+		__m128 middle = _mm_max_ps(lo, _mm_min_ps(hi, c));
+		__m128 smallest = _mm_min_ps(lo, c);
+		__m128 bc = _mm_add_ps(_mm_mul_ps(middle, _mm_set1_ps(0.25f)), _mm_mul_ps(smallest, _mm_set1_ps(0.125f)));
+		__m128 dist = _mm_add_ps(_mm_add_ps(largest, bc), _mm_mul_ps(bc, _mm_set1_ps(0.5f)));
+
+		__m128 scalar = _mm_sub_ps(one, _mm_div_ps(dist, dist_div));
+
+		if (light_direction)
+		{
+			// vm_NormalizeVectorFast leaves a zero length vector at zero
+			__m128 nonzero = _mm_cmpneq_ps(dist, zero);
+			__m128 norm_x = _mm_and_ps(_mm_div_ps(sub_x, dist), nonzero);
+			__m128 norm_y = _mm_and_ps(_mm_div_ps(sub_y, dist), nonzero);
+			__m128 norm_z = _mm_and_ps(_mm_div_ps(sub_z, dist), nonzero);
+			__m128 dp = _mm_add_ps(_mm_add_ps(_mm_mul_ps(norm_x, dir_x), _mm_mul_ps(norm_y, dir_y)), _mm_mul_ps(norm_z, dir_z));
+
+			lit = _mm_and_ps(lit, _mm_cmpnlt_ps(dp, dot));
+
+			// The scalar code divides in double precision
+			__m128 num = _mm_sub_ps(dp, dot);
+			__m128 add_lo = _mm_cvtpd_ps(_mm_div_pd(_mm_cvtps_pd(num), dot_div));
+			__m128 add_hi = _mm_cvtpd_ps(_mm_div_pd(_mm_cvtps_pd(_mm_movehl_ps(num, num)), dot_div));
+
+			scalar = _mm_mul_ps(scalar, _mm_movelh_ps(add_lo, add_hi));
+		}
+
+		lit = _mm_and_ps(lit, _mm_cmpnle_ps(scalar, zero));
+
+		int lit_mask = _mm_movemask_ps(lit);
+		if (!lit_mask)
+			continue;
+
+		__m128 r = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(old_texels, 10), component));
+		__m128 g = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(old_texels, 5), component));
+		__m128 b_comp = _mm_cvtepi32_ps(_mm_and_si128(old_texels, component));
+
+		// Adding light can't go below zero and subtracting it can't go above 31, so clamping to
+		// both does what either branch of the scalar code would
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(scalar, scale_r), limit));
+		g = _mm_add_ps(g, _mm_mul_ps(_mm_mul_ps(scalar, scale_g), limit));
+		b_comp = _mm_add_ps(b_comp, _mm_mul_ps(_mm_mul_ps(scalar, scale_b), limit));
+
+		__m128i ir = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(r, zero), limit));
+		__m128i ig = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(g, zero), limit));
+		__m128i ib = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(b_comp, zero), limit));
+
+		__m128i new_texels = _mm_or_si128(_mm_or_si128(opaque, _mm_slli_epi32(ir, 10)), _mm_or_si128(_mm_slli_epi32(ig, 5), ib));
+
+		int result[4];
+		_mm_storeu_si128((__m128i*)result, new_texels);
+
+		for (int i = 0; i < 4; i++)
+		{
+			if (!(lit_mask & (1 << i)) || texels[x + i] == result[i])
+				continue;
+
+			texels[x + i] = result[i];
+
+			if (!num_changed)
+				*first_x = x + i;
+			*last_x = x + i;
+			num_changed++;
+		}
+	}
+
+	for (; x < width; x++)
+	{
+		element_vec.x = elem_x[x];
+		element_vec.y = elem_y[x];
+		element_vec.z = elem_z[x];
+
+		ushort lightmap_texel = LightLightmapTexel(texels[x], &element_vec, pos, light_dist, red_scale, green_scale, blue_scale, light_direction, dot_range);
+
+		if (lightmap_texel == texels[x])
+			continue;
+
+		texels[x] = lightmap_texel;
+
+		if (!num_changed)
+			*first_x = x;
+		*last_x = x;
+		num_changed++;
+	}
+
+	return num_changed;
+}
+#endif
+
+#ifdef LIGHTING_SSE2
+const char* Lightmap_row_kernel = "SSE2";
+#else
+const char* Lightmap_row_kernel = "scalar";
+#endif
+
+// Lights a row of texels with the fastest kernel we have
+int LightLightmapRow(ushort* texels, int width, vector* start, vector* step, vector* pos, float light_dist, float red_scale, float green_scale, float blue_scale, vector* light_direction, float dot_range, int* first_x, int* last_x)
+{
+#ifdef LIGHTING_SSE2
+	return LightLightmapRowSSE2(texels, width, start, step, pos, light_dist, red_scale, green_scale, blue_scale, light_direction, dot_range, first_x, last_x);
+#else
+	return LightLightmapRowScalar(texels, width, start, step, pos, light_dist, red_scale, green_scale, blue_scale, light_direction, dot_range, first_x, last_x);
+#endif
+}
+
+// Lights the rectangle of a face's lightmap that a light can reach, and grows changed to cover
+// the texels that actually changed.  Only touches the face's own texels, so faces can be lit in
+// parallel.
+static void LightLightmapRect(light_job* job, light_job_rect* changed)
+{
+	lightmap_info* lmi_ptr = &LightmapInfo[job->lmi_handle];
+	matrix* facematrix = &job->facematrix;
+	int start_x = job->start_x, start_y = job->start_y;
+	int width = job->width, height = job->height;
+	vector* light_direction = job->directional ? &job->direction : NULL;
+	int lm_handle = lmi_ptr->lm_handle;
+	ushort* dest_data = (ushort*)lm_data(lm_handle);
+	int lmw = lm_w(lm_handle);
+	vector base_vector = lmi_ptr->upper_left;
+	vector element_step = facematrix->rvec * lmi_ptr->xspacing;
+
+	base_vector -= (start_y * (facematrix->uvec * lmi_ptr->yspacing));
+	base_vector += (start_x * (facematrix->rvec * lmi_ptr->xspacing));
+
+	base_vector -= ((facematrix->uvec / 2) * lmi_ptr->yspacing);
+	base_vector += ((facematrix->rvec / 2) * lmi_ptr->xspacing);
+
+	int texel_num = ((start_y + lmi_ptr->y1) * lmw) + start_x + lmi_ptr->x1;
+	for (int y = 0; y < height; y++, base_vector -= (facematrix->uvec * lmi_ptr->yspacing), texel_num += lmw)
+	{
+		int first_x, last_x;
+
+		if (!LightLightmapRow(&dest_data[texel_num], width, &base_vector, &element_step, &job->pos, job->light_dist, job->red_scale, job->green_scale, job->blue_scale, light_direction, job->dot_range, &first_x, &last_x))
+			continue;
+
+		if (start_x + first_x < changed->x1)
+			changed->x1 = start_x + first_x;
+		if (start_x + last_x + 1 > changed->x2)
+			changed->x2 = start_x + last_x + 1;
+		if (start_y + y < changed->y1)
+			changed->y1 = start_y + y;
+		if (start_y + y + 1 > changed->y2)
+			changed->y2 = start_y + y + 1;
+	}
+}
+
+// Runs every job waiting on one dynamic lightmap, in the order they were queued.  Called from the
+// worker pool.
+static void DoLightJobsForMap(int index, void* parm)
+{
+	light_job_rect* changed = &Light_job_rects[index];
+
+	changed->x1 = changed->y1 = LIGHTMAP_MAX_ROW;
+	changed->x2 = changed->y2 = 0;
+
+	for (int n = Light_job_first[Light_job_maps[index]]; n != -1; n = Light_jobs[n].next)
+	{
+		// The face went away after it was lit
+		if (LightmapInfo[Light_jobs[n].lmi_handle].used == 0)
+			return;
+
+		LightLightmapRect(&Light_jobs[n], changed);
+	}
+}
+
+// Applies all the dynamic lights waiting to be applied.  The faces are spread across the worker
+// pool.  A face's lights are all applied by the same worker, in the order they were queued, so
+// the results are the same as lighting them one at a time.
+void DoDynamicLightingJobs()
+{
+	int i;
+
+	if (!Num_light_jobs)
+		return;
+
+	task_ParallelFor(Num_light_job_maps, DoLightJobsForMap, NULL);
+
+	// Now record what changed
+	for (i = 0; i < Num_light_job_maps; i++)
+	{
+		int dynamic_handle = Light_job_maps[i];
+		light_job_rect* changed = &Light_job_rects[i];
+		lightmap_info* lmi_ptr = &LightmapInfo[Light_jobs[Light_job_first[dynamic_handle]].lmi_handle];
+
+		Light_job_first[dynamic_handle] = -1;
+
+		if (changed->x1 >= changed->x2 || lmi_ptr->used == 0)
+			continue;
+
+		dynamic_lightmap* dlm = &Dynamic_lightmaps[dynamic_handle];
+
+		if (changed->x1 < dlm->x1)
+			dlm->x1 = changed->x1;
+		if (changed->y1 < dlm->y1)
+			dlm->y1 = changed->y1;
+		if (changed->x2 > dlm->x2)
+			dlm->x2 = changed->x2;
+		if (changed->y2 > dlm->y2)
+			dlm->y2 = changed->y2;
+
+		// The blended edges around the face can change too
+		AddLightmapChangedRect(lmi_ptr->lm_handle, lmi_ptr->x1 + changed->x1 - 1, lmi_ptr->y1 + changed->y1 - 1, lmi_ptr->x1 + changed->x2 + 1, lmi_ptr->y1 + changed->y2 + 1);
+	}
+
+	Num_light_jobs = 0;
+	Num_light_job_maps = 0;
+}
+
+// Queues a light to be applied to the rectangle of a face's lightmap that it can reach.  The face
+// must already have a dynamic lightmap.
+static void QueueLightJob(lightmap_info* lmi_ptr, matrix* facematrix, int start_x, int start_y, int width, int height, vector* pos, float light_dist, float red_scale, float green_scale, float blue_scale, vector* light_direction, float dot_range)
+{
+	if (Num_light_jobs == MAX_LIGHT_JOBS)
+		DoDynamicLightingJobs();
+
+	int n = Num_light_jobs++;
+	light_job* job = &Light_jobs[n];
+	int dynamic_handle = lmi_ptr->dynamic;
+
+	job->facematrix = *facematrix;
+	job->pos = *pos;
+	job->light_dist = light_dist;
+	job->red_scale = red_scale;
+	job->green_scale = green_scale;
+	job->blue_scale = blue_scale;
+	job->dot_range = dot_range;
+	job->lmi_handle = lmi_ptr - LightmapInfo;
+	job->directional = (light_direction != NULL);
+	if (light_direction)
+		job->direction = *light_direction;
+	job->start_x = start_x;
+	job->start_y = start_y;
+	job->width = width;
+	job->height = height;
+	job->next = -1;
+
+	if (Light_job_first[dynamic_handle] == -1)
+	{
+		Light_job_first[dynamic_handle] = n;
+		Light_job_maps[Num_light_job_maps++] = dynamic_handle;
+	}
+	else
+		Light_jobs[Light_job_last[dynamic_handle]].next = n;
+
+	Light_job_last[dynamic_handle] = n;
+}
 
 // Does lighting for the passed in external room
 void ApplyLightingToExternalRoom(vector* pos, int roomnum, float light_dist, float red_scale, float green_scale, float blue_scale, vector* light_direction, float dot_range)
 {
-	int i, lm_handle, t;
+	int i, t;
 	ushort* dest_data;
 	vector rad;
 	room* rp = &Rooms[roomnum];
@@ -268,10 +765,6 @@ void ApplyLightingToExternalRoom(vector* pos, int roomnum, float light_dist, flo
 	ushort lmilist[MAX_DYNAMIC_FACES];
 	int num_spoken_for = 0;
 
-	int red_limit = 31;
-	int green_limit = 31;
-	int blue_limit = 31;
-
 	rad.x = light_dist;
 	rad.y = light_dist;
 	rad.z = light_dist;
@@ -395,21 +888,6 @@ void ApplyLightingToExternalRoom(vector* pos, int roomnum, float light_dist, flo
 
 		if (lmi_ptr->dynamic != BAD_LM_INDEX)		// already lit, so just adjust, not start over
 		{
-			lm_handle = LightmapInfo[fp->lmi_handle].lm_handle;
-			dest_data = (ushort*)lm_data(lm_handle);
-
-			if (start_x + lmi_ptr->x1 < GameLightmaps[lm_handle].cx1)
-				GameLightmaps[lm_handle].cx1 = start_x + lmi_ptr->x1;
-			if (start_x + lmi_ptr->x1 + width > GameLightmaps[lm_handle].cx2)
-				GameLightmaps[lm_handle].cx2 = start_x + width + lmi_ptr->x1;
-
-			if (start_y + lmi_ptr->y1 < GameLightmaps[lm_handle].cy1)
-				GameLightmaps[lm_handle].cy1 = start_y + lmi_ptr->y1;
-			if (lmi_ptr->y1 + start_y + height > GameLightmaps[lm_handle].cy2)
-				GameLightmaps[lm_handle].cy2 = start_y + height + lmi_ptr->y1;
-
-			GameLightmaps[lm_handle].flags |= (LF_CHANGED | LF_LIMITS);
-
 			if (!(Lmi_spoken_for[fp->lmi_handle / 8] & (1 << (fp->lmi_handle % 8))))
 			{
 				lmilist[num_spoken_for] = fp->lmi_handle;
@@ -441,34 +919,9 @@ void ApplyLightingToExternalRoom(vector* pos, int roomnum, float light_dist, flo
 					dest_data[index] = src_data[((lmi_ptr->y1 + y) * lmw) + lmi_ptr->x1 + x];
 			}
 
-			dest_data = src_data;
-			lm_handle = LightmapInfo[fp->lmi_handle].lm_handle;
-
-			// Mark it as changed
+			// Remember the copy so the original can be restored
 			lmi_ptr->dynamic = dynamic_handle;
 
-			if (!(GameLightmaps[lm_handle].flags & LF_LIMITS))
-			{
-				GameLightmaps[lm_handle].cx1 = start_x + lmi_ptr->x1;
-				GameLightmaps[lm_handle].cx2 = start_x + width + lmi_ptr->x1;
-				GameLightmaps[lm_handle].cy1 = start_y + lmi_ptr->y1;
-				GameLightmaps[lm_handle].cy2 = start_y + height + lmi_ptr->y1;
-			}
-			else
-			{
-				if (start_x + lmi_ptr->x1 < GameLightmaps[lm_handle].cx1)
-					GameLightmaps[lm_handle].cx1 = start_x + lmi_ptr->x1;
-				if (start_x + lmi_ptr->x1 + width > GameLightmaps[lm_handle].cx2)
-					GameLightmaps[lm_handle].cx2 = start_x + width + lmi_ptr->x1;
-
-				if (start_y + lmi_ptr->y1 < GameLightmaps[lm_handle].cy1)
-					GameLightmaps[lm_handle].cy1 = start_y + lmi_ptr->y1;
-				if (lmi_ptr->y1 + start_y + height > GameLightmaps[lm_handle].cy2)
-					GameLightmaps[lm_handle].cy2 = start_y + height + lmi_ptr->y1;
-			}
-
-			GameLightmaps[lm_handle].flags |= (LF_LIMITS | LF_CHANGED);
-
 			Dynamic_face_list[Num_dynamic_faces].lmi_handle = fp->lmi_handle;
 			Num_dynamic_faces++;
 
@@ -480,96 +933,7 @@ void ApplyLightingToExternalRoom(vector* pos, int roomnum, float light_dist, flo
 			Edges_to_blend[Num_edges_to_blend++] = fp->lmi_handle;
 		}
 
-		vector element_vec;
-
-		base_vector -= (start_y * (facematrix.uvec * lmi_ptr->yspacing));
-		base_vector += (start_x * (facematrix.rvec * lmi_ptr->xspacing));
-
-		base_vector -= ((facematrix.uvec / 2) * lmi_ptr->yspacing);
-		base_vector += ((facematrix.rvec / 2) * lmi_ptr->xspacing);
-
-		// Go through and change each element of this lightmap
-		// SLOW!
-
-		int texel_num = ((start_y + lmi_ptr->y1) * lmw) + start_x + lmi_ptr->x1;
-		for (int y = 0; y < height; y++, base_vector -= (facematrix.uvec * lmi_ptr->yspacing), texel_num += lmw)
-		{
-			element_vec = base_vector;
-
-			for (int x = 0; x < width; x++, element_vec += (facematrix.rvec * lmi_ptr->xspacing))
-			{
-				int lightmap_texel_num = texel_num + x;
-
-				ushort lightmap_texel = dest_data[lightmap_texel_num];
-
-				if (!(lightmap_texel & OPAQUE_FLAG))
-					continue;
-
-				float dist = vm_VectorDistanceQuick(&element_vec, pos);
-				float scalar = 1.0 - (dist / light_dist);
-
-				if (light_direction)
-				{
-					vector lsubvec = element_vec - *pos;
-					vm_NormalizeVectorFast(&lsubvec);
-					float dp = vm_DotProduct(&lsubvec, light_direction);
-					if (dp < dot_range)
-					{
-						continue;
-					}
-					else
-					{
-
-						float add_scale = (dp - dot_range) / (1.0 - dot_range);
-						scalar *= add_scale;
-					}
-				}
-
-				if (scalar <= 0)
-					continue;
-
-				int r = (lightmap_texel >> 10) & 0x1f;
-				int g = (lightmap_texel >> 5) & 0x1f;
-				int b = lightmap_texel & 0x1f;
-
-				if (red_scale < 0)
-				{
-					// we are subtracting light
-					r = max(0, r + (scalar * red_scale * 31));
-				}
-				else
-				{
-					if (r < red_limit)
-						r = min(red_limit, r + (scalar * red_scale * 31));
-				}
-
-				if (green_scale < 0)
-				{
-					// we are subtracting light
-					g = max(0, g + (scalar * green_scale * 31));
-				}
-				else
-				{
-					if (g < green_limit)
-						g = min(green_limit, g + (scalar * green_scale * 31));
-				}
-
-				if (blue_scale < 0)
-				{
-					// we are subtracting light
-					b = max(0, b + (scalar * blue_scale * 31));
-				}
-				else
-				{
-					if (b < blue_limit)
-						b = min(blue_limit, b + (scalar * blue_scale * 31));
-				}
-
-				lightmap_texel = OPAQUE_FLAG | (r << 10) | (g << 5) | b;
-
-				dest_data[lightmap_texel_num] = lightmap_texel;
-			}
-		}
+		QueueLightJob(lmi_ptr, &facematrix, start_x, start_y, width, height, pos, light_dist, red_scale, green_scale, blue_scale, light_direction, dot_range);
 	}
 
 	for (i = 0; i < num_spoken_for; i++)
@@ -640,15 +1004,10 @@ void ApplyLightingToSubmodel(object* obj, poly_model* pm, bsp_info* sm, float li
 	vector rad;
 	int i, t;
 	int subnum = sm - pm->submodel;
-	int lm_handle;
 	ushort* dest_data;
 	ushort lmilist[MAX_DYNAMIC_FACES];
 	int num_spoken_for = 0;
 
-	int red_limit = 31;
-	int green_limit = 31;
-	int blue_limit = 31;
-
 	if (IsNonRenderableSubmodel(pm, subnum))
 		return;	// Don't do shells, frontfaces, etc
 
@@ -779,21 +1138,6 @@ void ApplyLightingToSubmodel(object* obj, poly_model* pm, bsp_info* sm, float li
 
 		if (lmi_ptr->dynamic != BAD_LM_INDEX)		// already lit, so just adjust, not start over
 		{
-			lm_handle = LightmapInfo[fp->lmi_handle].lm_handle;
-			dest_data = (ushort*)lm_data(lm_handle);
-
-			if (start_x + lmi_ptr->x1 < GameLightmaps[lm_handle].cx1)
-				GameLightmaps[lm_handle].cx1 = start_x + lmi_ptr->x1;
-			if (start_x + lmi_ptr->x1 + width > GameLightmaps[lm_handle].cx2)
-				GameLightmaps[lm_handle].cx2 = start_x + width + lmi_ptr->x1;
-
-			if (start_y + lmi_ptr->y1 < GameLightmaps[lm_handle].cy1)
-				GameLightmaps[lm_handle].cy1 = start_y + lmi_ptr->y1;
-			if (lmi_ptr->y1 + start_y + height > GameLightmaps[lm_handle].cy2)
-				GameLightmaps[lm_handle].cy2 = start_y + height + lmi_ptr->y1;
-
-			GameLightmaps[lm_handle].flags |= (LF_CHANGED | LF_LIMITS);
-
 			if (!(Lmi_spoken_for[fp->lmi_handle / 8] & (1 << (fp->lmi_handle % 8))))
 			{
 				lmilist[num_spoken_for] = fp->lmi_handle;
@@ -827,34 +1171,9 @@ void ApplyLightingToSubmodel(object* obj, poly_model* pm, bsp_info* sm, float li
 					dest_data[index] = src_data[((lmi_ptr->y1 + y) * lmw) + lmi_ptr->x1 + x];
 			}
 
-			dest_data = src_data;
-			lm_handle = LightmapInfo[fp->lmi_handle].lm_handle;
-
-			// Mark it as changed
+			// Remember the copy so the original can be restored
 			lmi_ptr->dynamic = dynamic_handle;
 
-			if (!(GameLightmaps[lm_handle].flags & LF_LIMITS))
-			{
-				GameLightmaps[lm_handle].cx1 = start_x + lmi_ptr->x1;
-				GameLightmaps[lm_handle].cx2 = start_x + width + lmi_ptr->x1;
-				GameLightmaps[lm_handle].cy1 = start_y + lmi_ptr->y1;
-				GameLightmaps[lm_handle].cy2 = start_y + height + lmi_ptr->y1;
-			}
-			else
-			{
-				if (start_x + lmi_ptr->x1 < GameLightmaps[lm_handle].cx1)
-					GameLightmaps[lm_handle].cx1 = start_x + lmi_ptr->x1;
-				if (start_x + lmi_ptr->x1 + width > GameLightmaps[lm_handle].cx2)
-					GameLightmaps[lm_handle].cx2 = start_x + width + lmi_ptr->x1;
-
-				if (start_y + lmi_ptr->y1 < GameLightmaps[lm_handle].cy1)
-					GameLightmaps[lm_handle].cy1 = start_y + lmi_ptr->y1;
-				if (lmi_ptr->y1 + start_y + height > GameLightmaps[lm_handle].cy2)
-					GameLightmaps[lm_handle].cy2 = start_y + height + lmi_ptr->y1;
-			}
-
-			GameLightmaps[lm_handle].flags |= (LF_LIMITS | LF_CHANGED);
-
 			Dynamic_face_list[Num_dynamic_faces].lmi_handle = fp->lmi_handle;
 			Num_dynamic_faces++;
 
@@ -866,91 +1185,7 @@ void ApplyLightingToSubmodel(object* obj, poly_model* pm, bsp_info* sm, float li
 			Edges_to_blend[Num_edges_to_blend++] = fp->lmi_handle;
 		}
 
-		vector element_vec;
-
-		base_vector -= (start_y * (facematrix.uvec * lmi_ptr->yspacing));
-		base_vector += (start_x * (facematrix.rvec * lmi_ptr->xspacing));
-
-		base_vector -= ((facematrix.uvec / 2) * lmi_ptr->yspacing);
-		base_vector += ((facematrix.rvec / 2) * lmi_ptr->xspacing);
-
-		// Go through and change each element of this lightmap
-		// SLOW!
-
-		int texel_num = ((start_y + lmi_ptr->y1) * lmw) + start_x + lmi_ptr->x1;
-		for (int y = 0; y < height; y++, base_vector -= (facematrix.uvec * lmi_ptr->yspacing), texel_num += lmw)
-		{
-			element_vec = base_vector;
-
-			for (int x = 0; x < width; x++, element_vec += (facematrix.rvec * lmi_ptr->xspacing))
-			{
-				int lightmap_texel_num = texel_num + x;
-
-				ushort lightmap_texel = dest_data[lightmap_texel_num];
-
-				if (!(lightmap_texel & OPAQUE_FLAG))
-					continue;
-
-				float dist = vm_VectorDistanceQuick(&element_vec, &light_pos);
-				float scalar = 1.0 - (dist / light_dist);
-
-				if (Use_light_direction)
-				{
-					vector lsubvec = element_vec - light_pos;
-					vm_NormalizeVectorFast(&lsubvec);
-					float dp = vm_DotProduct(&lsubvec, &light_dir);
-					if (dp < dot_range)
-						continue;
-					else
-					{
-
-						float add_scale = (dp - dot_range) / (1.0 - dot_range);
-						scalar *= add_scale;
-					}
-				}
-
-				if (scalar <= 0)
-					continue;
-
-				int r = (lightmap_texel >> 10) & 0x1f;
-				int g = (lightmap_texel >> 5) & 0x1f;
-				int b = lightmap_texel & 0x1f;
-
-				if (red_scale < 0)
-				{
-					r = max(0, r + (scalar * red_scale * 31));
-				}
-				else
-				{
-					if (r < red_limit)
-						r = min(red_limit, r + (scalar * red_scale * 31));
-				}
-
-				if (green_scale < 0)
-				{
-					g = max(0, g + (scalar * green_scale * 31));
-				}
-				else
-				{
-					if (g < green_limit)
-						g = min(green_limit, g + (scalar * green_scale * 31));
-				}
-
-				if (blue_scale < 0)
-				{
-					b = max(0, b + (scalar * blue_scale * 31));
-				}
-				else
-				{
-					if (b < blue_limit)
-						b = min(blue_limit, b + (scalar * blue_scale * 31));
-				}
-
-				lightmap_texel = OPAQUE_FLAG | (r << 10) | (g << 5) | b;
-
-				dest_data[lightmap_texel_num] = lightmap_texel;
-			}
-		}
+		QueueLightJob(lmi_ptr, &facematrix, start_x, start_y, width, height, &light_pos, light_dist, red_scale, green_scale, blue_scale, Use_light_direction ? &light_dir : NULL, dot_range);
 	}
 
 	for (i = 0; i < num_spoken_for; i++)
@@ -1134,7 +1369,7 @@ void ApplyLightingToRooms(vector* pos, int roomnum, float light_dist, float red_
 	ushort lmilist[MAX_DYNAMIC_FACES];
 	int num_spoken_for = 0;
 
-	int num_faces, i, t, lm_handle;
+	int num_faces, i, t;
 	ushort* dest_data;
 	int faces_misreported = 0;
 
@@ -1155,10 +1390,6 @@ void ApplyLightingToRooms(vector* pos, int roomnum, float light_dist, float red_
 	if (num_faces < 1)
 		return;
 
-	int red_limit = 31;
-	int green_limit = 31;
-	int blue_limit = 31;
-
 	for (i = 0; i < num_faces; i++)
 	{
 		room* rp = &Rooms[facelist[i].room_index];
@@ -1276,21 +1507,6 @@ void ApplyLightingToRooms(vector* pos, int roomnum, float light_dist, float red_
 
 		if (lmi_ptr->dynamic != BAD_LM_INDEX)		// already lit, so just adjust, not start over
 		{
-			lm_handle = LightmapInfo[fp->lmi_handle].lm_handle;
-			dest_data = (ushort*)lm_data(lm_handle);
-
-			if (start_x + lmi_ptr->x1 < GameLightmaps[lm_handle].cx1)
-				GameLightmaps[lm_handle].cx1 = start_x + lmi_ptr->x1;
-			if (start_x + lmi_ptr->x1 + width > GameLightmaps[lm_handle].cx2)
-				GameLightmaps[lm_handle].cx2 = start_x + width + lmi_ptr->x1;
-
-			if (start_y + lmi_ptr->y1 < GameLightmaps[lm_handle].cy1)
-				GameLightmaps[lm_handle].cy1 = start_y + lmi_ptr->y1;
-			if (lmi_ptr->y1 + start_y + height > GameLightmaps[lm_handle].cy2)
-				GameLightmaps[lm_handle].cy2 = start_y + height + lmi_ptr->y1;
-
-			GameLightmaps[lm_handle].flags |= (LF_CHANGED | LF_LIMITS);
-
 			if (!(Lmi_spoken_for[fp->lmi_handle / 8] & (1 << (fp->lmi_handle % 8))))
 			{
 				lmilist[num_spoken_for] = fp->lmi_handle;
@@ -1322,34 +1538,9 @@ void ApplyLightingToRooms(vector* pos, int roomnum, float light_dist, float red_
 					dest_data[index] = src_data[((lmi_ptr->y1 + y) * lmw) + lmi_ptr->x1 + x];
 			}
 
-			dest_data = src_data;
-			lm_handle = LightmapInfo[fp->lmi_handle].lm_handle;
-
-			// Mark it as changed
+			// Remember the copy so the original can be restored
 			lmi_ptr->dynamic = dynamic_handle;
 
-			if (!(GameLightmaps[lm_handle].flags & LF_LIMITS))
-			{
-				GameLightmaps[lm_handle].cx1 = start_x + lmi_ptr->x1;
-				GameLightmaps[lm_handle].cx2 = start_x + width + lmi_ptr->x1;
-				GameLightmaps[lm_handle].cy1 = start_y + lmi_ptr->y1;
-				GameLightmaps[lm_handle].cy2 = start_y + height + lmi_ptr->y1;
-			}
-			else
-			{
-				if (start_x + lmi_ptr->x1 < GameLightmaps[lm_handle].cx1)
-					GameLightmaps[lm_handle].cx1 = start_x + lmi_ptr->x1;
-				if (start_x + lmi_ptr->x1 + width > GameLightmaps[lm_handle].cx2)
-					GameLightmaps[lm_handle].cx2 = start_x + width + lmi_ptr->x1;
-
-				if (start_y + lmi_ptr->y1 < GameLightmaps[lm_handle].cy1)
-					GameLightmaps[lm_handle].cy1 = start_y + lmi_ptr->y1;
-				if (lmi_ptr->y1 + start_y + height > GameLightmaps[lm_handle].cy2)
-					GameLightmaps[lm_handle].cy2 = start_y + height + lmi_ptr->y1;
-			}
-
-			GameLightmaps[lm_handle].flags |= (LF_LIMITS | LF_CHANGED);
-
 			Dynamic_face_list[Num_dynamic_faces].lmi_handle = fp->lmi_handle;
 			Num_dynamic_faces++;
 
@@ -1363,96 +1554,7 @@ void ApplyLightingToRooms(vector* pos, int roomnum, float light_dist, float red_
 			Edges_to_blend[Num_edges_to_blend++] = fp->lmi_handle;
 		}
 
-		vector element_vec;
-
-		base_vector -= (start_y * (facematrix.uvec * lmi_ptr->yspacing));
-		base_vector += (start_x * (facematrix.rvec * lmi_ptr->xspacing));
-
-		base_vector -= ((facematrix.uvec / 2) * lmi_ptr->yspacing);
-		base_vector += ((facematrix.rvec / 2) * lmi_ptr->xspacing);
-
-		// Go through and change each element of this lightmap
-		// SLOW!
-
-		int texel_num = ((start_y + lmi_ptr->y1) * lmw) + start_x + lmi_ptr->x1;
-		for (int y = 0; y < height; y++, base_vector -= (facematrix.uvec * lmi_ptr->yspacing), texel_num += lmw)
-		{
-			element_vec = base_vector;
-
-			for (int x = 0; x < width; x++, element_vec += (facematrix.rvec * lmi_ptr->xspacing))
-			{
-				int lightmap_texel_num = texel_num + x;
-
-				ushort lightmap_texel = dest_data[lightmap_texel_num];
-
-				if (!(lightmap_texel & OPAQUE_FLAG))
-					continue;
-
-				float dist = vm_VectorDistanceQuick(&element_vec, pos);
-				float scalar = 1.0 - (dist / light_dist);
-
-				if (light_direction)
-				{
-					vector lsubvec = element_vec - *pos;
-					vm_NormalizeVectorFast(&lsubvec);
-					float dp = vm_DotProduct(&lsubvec, light_direction);
-					if (dp < dot_range)
-						continue;
-					else
-					{
-
-						float add_scale = (dp - dot_range) / (1.0 - dot_range);
-						scalar *= add_scale;
-					}
-				}
-
-				if (scalar <= 0)
-					continue;
-
-				int r = (lightmap_texel >> 10) & 0x1f;
-				int g = (lightmap_texel >> 5) & 0x1f;
-				int b = lightmap_texel & 0x1f;
-
-				if (red_scale < 0)
-				{
-					// we are subtracting light
-					r = max(0, r + (scalar * red_scale * 31));
-				}
-				else
-				{
-					// we are adding light
-					if (r < red_limit)
-						r = min(red_limit, r + (scalar * red_scale * 31));
-				}
-
-				if (green_scale < 0)
-				{
-					// we are subtracting light
-					g = max(0, g + (scalar * green_scale * 31));
-				}
-				else
-				{
-					// we are adding light
-					if (g < green_limit)
-						g = min(green_limit, g + (scalar * green_scale * 31));
-				}
-
-				if (blue_scale < 0)
-				{
-					// we are subtracting light
-					b = max(0, b + (scalar * blue_scale * 31));
-				}
-				else
-				{
-					if (b < blue_limit)
-						b = min(blue_limit, b + (scalar * blue_scale * 31));
-				}
-
-				lightmap_texel = OPAQUE_FLAG | (r << 10) | (g << 5) | b;
-
-				dest_data[lightmap_texel_num] = lightmap_texel;
-			}
-		}
+		QueueLightJob(lmi_ptr, &facematrix, start_x, start_y, width, height, pos, light_dist, red_scale, green_scale, blue_scale, light_direction, dot_range);
 	}
 
 	for (i = 0; i < num_spoken_for; i++)
@@ -1466,6 +1568,9 @@ void ApplyLightingToRooms(vector* pos, int roomnum, float light_dist, float red_
 // Blends all the edges that need blending for this frame
 void BlendAllLightingEdges()
 {
+	// The edges have to be blended from the lit faces
+	DoDynamicLightingJobs();
+
 	for (int i = 0; i < Num_edges_to_blend; i++)
 	{
 		if (LightmapInfo[Edges_to_blend[i]].used < 1)
@@ -1480,6 +1585,9 @@ void ClearDynamicLightmaps()
 {
 	int i;
 
+	// Anything still waiting has to be applied before it can be undone
+	DoDynamicLightingJobs();
+
 	// First clear dynamic lightmap list
 	for (i = 0; i < Num_dynamic_lightmaps; i++)
 		Dynamic_lightmaps[i].used = 0;
@@ -1521,23 +1629,25 @@ void ClearDynamicLightmaps()
 		int lm_handle = LightmapInfo[lmi_handle].lm_handle;
 		lightmap_info* lmi_ptr = &LightmapInfo[lmi_handle];
 
-		ushort* src_data = Dynamic_lightmaps[dynamic_handle].mem_ptr;
+		dynamic_lightmap* dlm = &Dynamic_lightmaps[dynamic_handle];
+		LightmapInfo[lmi_handle].dynamic = BAD_LMI_INDEX;
+
+		// Only put back the part the lights changed
+		if (dlm->x1 >= dlm->x2 || dlm->y1 >= dlm->y2)
+			continue;
+
+		ushort* src_data = dlm->mem_ptr;
 		ushort* dest_data = (ushort*)lm_data(lm_handle);
 
 		int lmw = lm_w(lm_handle);
 
-		dest_data += (lmi_ptr->y1 * lmw);
+		dest_data += ((lmi_ptr->y1 + dlm->y1) * lmw) + lmi_ptr->x1 + dlm->x1;
+		src_data += (dlm->y1 * lmi_ptr->width) + dlm->x1;
 
-		for (int y = 0; y < lmi_ptr->height; y++, dest_data += lmw)
-		{
-			for (int x = 0; x < lmi_ptr->width; x++)
-			{
-				dest_data[lmi_ptr->x1 + x] = src_data[y * lmi_ptr->width + x];
-			}
-		}
+		for (int y = dlm->y1; y < dlm->y2; y++, dest_data += lmw, src_data += lmi_ptr->width)
+			memcpy(dest_data, src_data, (dlm->x2 - dlm->x1) * sizeof(ushort));
 
-		GameLightmaps[lm_handle].flags |= (LF_LIMITS | LF_CHANGED);
-		LightmapInfo[lmi_handle].dynamic = BAD_LMI_INDEX;
+		AddLightmapChangedRect(lm_handle, lmi_ptr->x1 + dlm->x1 - 1, lmi_ptr->y1 + dlm->y1 - 1, lmi_ptr->x1 + dlm->x2 + 1, lmi_ptr->y1 + dlm->y2 + 1);
 	}
 
 
@@ -1567,7 +1677,7 @@ void ClearDynamicLightmaps()
 
 		data[subz * 128 + subx] = color;
 
-		GameLightmaps[whichmap].flags |= (LF_LIMITS | LF_CHANGED);
+		AddLightmapChangedRect(whichmap, subx, subz, subx + 1, subz + 1);
 	}
 
 	Num_dynamic_cells = 0;
@@ -1670,28 +1780,7 @@ void ApplyLightingToTerrain(vector* pos, int cellnum, float light_dist, float re
 			tseg->flags |= TF_DYNAMIC;
 			Num_dynamic_cells++;
 
-			if (GameLightmaps[whichmap].flags & LF_LIMITS)
-			{
-				if (subx < GameLightmaps[whichmap].cx1)
-					GameLightmaps[whichmap].cx1 = subx;
-				if (subx > GameLightmaps[whichmap].cx2)
-					GameLightmaps[whichmap].cx2 = subx;
-
-				if (subz < GameLightmaps[whichmap].cy1)
-					GameLightmaps[whichmap].cy1 = subz;
-				if (subz > GameLightmaps[whichmap].cy2)
-					GameLightmaps[whichmap].cy2 = subz;
-
-			}
-			else
-			{
-				GameLightmaps[whichmap].cx1 = subx;
-				GameLightmaps[whichmap].cx2 = subx + 1;
-				GameLightmaps[whichmap].cy1 = subz;
-				GameLightmaps[whichmap].cy2 = subz + 1;
-				GameLightmaps[whichmap].flags |= (LF_LIMITS | LF_CHANGED);
-			}
-
+			AddLightmapChangedRect(whichmap, subx, subz, subx + 1, subz + 1);
 		}
 
 		int r = tseg->r;
@@ -2284,28 +2373,8 @@ void DestroyLight(int roomnum, int facenum)
 		dest_data = (ushort*)lm_data(LightmapInfo[fp->lmi_handle].lm_handle);
 		int lm_handle = LightmapInfo[fp->lmi_handle].lm_handle;
 
-		if (!(GameLightmaps[lm_handle].flags & LF_LIMITS))
-		{
-			GameLightmaps[lm_handle].cx1 = start_x + lmi_ptr->x1;
-			GameLightmaps[lm_handle].cx2 = start_x + width + lmi_ptr->x1;
-			GameLightmaps[lm_handle].cy1 = start_y + lmi_ptr->y1;
-			GameLightmaps[lm_handle].cy2 = start_y + height + lmi_ptr->y1;
-		}
-		else
-		{
-			if (start_x + lmi_ptr->x1 < GameLightmaps[lm_handle].cx1)
-				GameLightmaps[lm_handle].cx1 = start_x + lmi_ptr->x1;
-			if (start_x + lmi_ptr->x1 + width > GameLightmaps[lm_handle].cx2)
-				GameLightmaps[lm_handle].cx2 = start_x + width + lmi_ptr->x1;
-
-			if (start_y + lmi_ptr->y1 < GameLightmaps[lm_handle].cy1)
-				GameLightmaps[lm_handle].cy1 = start_y + lmi_ptr->y1;
-			if (lmi_ptr->y1 + start_y + height > GameLightmaps[lm_handle].cy2)
-				GameLightmaps[lm_handle].cy2 = start_y + height + lmi_ptr->y1;
-		}
-
-
-		GameLightmaps[lm_handle].flags |= (LF_LIMITS | LF_CHANGED);
+		// The whole face gets its edges blended again below
+		AddLightmapChangedRect(lm_handle, lmi_ptr->x1 - 1, lmi_ptr->y1 - 1, lmi_ptr->x1 + xres + 1, lmi_ptr->y1 + yres + 1);
 
 		lmilist[num_spoken_for] = fp->lmi_handle;
 		Lmi_spoken_for[fp->lmi_handle / 8] |= (1 << (fp->lmi_handle % 8));
@@ -2393,6 +2462,10 @@ void AddToDestroyableLightList(int roomnum, int facenum)
 void DoDestroyedLightsForFrame()
 {
 	int i;
+
+	// These change the lightmaps directly, so finish any dynamic lighting first
+	DoDynamicLightingJobs();
+
 	for (i = 0; i < Num_destroyed_lights_this_frame; i++)
 	{
 		int roomnum = Destroyed_light_rooms_this_frame[i];
@@ -2402,4 +2475,3 @@ void DoDestroyedLightsForFrame()
 
 	Num_destroyed_lights_this_frame = 0;
 }
-
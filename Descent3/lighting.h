@@ -38,6 +38,7 @@ struct dynamic_lightmap
 {
 	ushort *mem_ptr;
 	ubyte used;
+	ubyte x1,y1,x2,y2;		// Texels of the face changed by lights this frame.  x2 and y2 are exclusive.
 };
 
 struct dynamic_face
@@ -68,6 +69,10 @@ void ApplyLightingToRooms (vector *,int,float,float,float,float,vector *light_di
 // Clears the used flag for the dynamic lightmaps
 void ClearDynamicLightmaps ();
 
+// Dynamic lights are gathered as they're applied, and the faces they touch are lit in parallel
+// when the lightmaps are needed.  This does all the lighting that is waiting.
+void DoDynamicLightingJobs ();
+
 // Changes the terrain shading to approximate lighting
 void ApplyLightingToTerrain (vector *pos,int cellnum,float light_dist,float red_scale,float green_scale,float blue_scale,vector *light_direction=NULL,float dot_range=0);
 
@@ -118,6 +123,20 @@ void DoDestroyedLightsForFrame ();
 // Blends all the edges that need blending for this frame
 void BlendAllLightingEdges ();
 
+// Widest row of texels in a lightmap
+#define LIGHTMAP_MAX_ROW	128
+
+// Lights a row of texels one at a time.  The first texel is at start and each one after it is
+// step further along.  Returns the number of texels that changed, and the first and last of them
+// in first_x and last_x.
+int LightLightmapRowScalar (ushort *texels,int width,vector *start,vector *step,vector *pos,float light_dist,float red_scale,float green_scale,float blue_scale,vector *light_direction,float dot_range,int *first_x,int *last_x);
+
+// Same as LightLightmapRowScalar, with the fastest kernel we have.  The results match it bit for bit.
+int LightLightmapRow (ushort *texels,int width,vector *start,vector *step,vector *pos,float light_dist,float red_scale,float green_scale,float blue_scale,vector *light_direction,float dot_range,int *first_x,int *last_x);
+
+// Name of the kernel LightLightmapRow() was built with, "SSE2" or "scalar"
+extern const char *Lightmap_row_kernel;
+
 
 #endif
 
@@ -106,6 +106,9 @@ static cmdLineArg d3ArgTable[] =
 
     {"gspyfile",       'S', "Specify a GameSpy config file."},
     {"timetest",       'T', "Run a demo benchmark."},
+    {"benchmark",      '\0', "Play a demo uncapped and log per-frame timings."},
+    {"benchmarklog",   '\0', "Specify the file benchmark timings are written to."},
+    {"netsim",         '\0', "Simulate packet loss (percent) and latency (ms)."},
     {"fastdemo",       'Q', "Run demos as fast as possible."},
     {"framecap",       'F', "Specify a framecap (for dedicated server)."},
 
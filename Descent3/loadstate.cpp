@@ -52,6 +52,7 @@
 #include "weather.h"
 #include "cockpit.h"
 #include "hud.h"
+#include "objgrid.h"
 
 void PageInAllData ();
 
@@ -710,6 +711,7 @@ int LGSObjects(CFILE *fp, int version)
 	Osiris_DisableCreateEvents();
 // we must reset some data before continuing.
 	InitBigObjects();
+	ObjGridInit();
 
 START_VERIFY_SAVEFILE(fp);
 	Marker_message = cf_ReadInt(fp);
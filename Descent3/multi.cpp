@@ -59,6 +59,7 @@
 #include "attach.h"
 #include "mission_download.h"
 #include "multi_world_state.h"
+#include "multi_snapshot.h"
 #include "ObjScript.h"
 #include "audiotaunts.h"
 #include "marker.h"
@@ -1095,7 +1096,7 @@ void MultiDoPlayer (ubyte *data)
 	if (observing)
 	{
 		obj->render_type=RT_NONE;
-		obj->type=OBJ_OBSERVER;
+		ObjSetType(obj,OBJ_OBSERVER);
 	}
 
 	if (slot==0)
@@ -1397,7 +1398,7 @@ void MultiMakePlayerGhost (int slot)
 
 	MULTI_ASSERT (obj->id==slot,NULL);	// Get Jason
 	
-	obj->type=OBJ_GHOST;
+	ObjSetType(obj,OBJ_GHOST);
 	obj->movement_type=MT_NONE;
 	obj->render_type=RT_NONE;
 	obj->mtype.phys_info.flags|=PF_NO_COLLIDE;
@@ -1419,7 +1420,7 @@ void MultiMakePlayerReal (int slot)
 	object *obj=&Objects[Players[slot].objnum];
 	MULTI_ASSERT (obj->id==slot,NULL);	// Get Jason
 
-	obj->type=OBJ_PLAYER;
+	ObjSetType(obj,OBJ_PLAYER);
 
 	if(Demo_flags==DF_RECORDING)
 	{
@@ -1783,13 +1784,6 @@ void MultiDoRobotPos (ubyte *data)
 	SKIP_HEADER (data,&count);
 	
 	ushort server_objnum=MultiGetUshort (data,&count);
-	ushort objectnum = Server_object_list[server_objnum];
-	if(objectnum==65535 || !(Objects[objectnum].flags & OF_SERVER_OBJECT))
-	{
-		mprintf((0,"Bad robotposition object number!\n"));
-		return;
-	}
-	object *obj=&Objects[objectnum];
 
 	vector pos;
 	matrix orient;
@@ -1820,18 +1814,30 @@ void MultiDoRobotPos (ubyte *data)
 	vel.x=((float)MultiGetShort (data,&count))/128.0;
 	vel.y=((float)MultiGetShort (data,&count))/128.0;
 	vel.z=((float)MultiGetShort (data,&count))/128.0;
-	obj->mtype.phys_info.velocity=vel;
+
+	MultiSetRobotPos (server_objnum,&pos,&orient,roomnum,&vel);
+}
+
+// Moves a robot to where the server says it is
+void MultiSetRobotPos (ushort server_objnum,vector *pos,matrix *orient,int roomnum,vector *vel)
+{
+	ushort objectnum = Server_object_list[server_objnum];
+	if(objectnum==65535 || !(Objects[objectnum].flags & OF_SERVER_OBJECT))
+	{
+		mprintf((0,"Bad robotposition object number!\n"));
+		return;
+	}
+	object *obj=&Objects[objectnum];
+
+	obj->mtype.phys_info.velocity=*vel;
 
 	obj->mtype.phys_info.flags &=~PF_NO_COLLIDE;
 	obj->render_type=RT_POLYOBJ;
 			
 	if(!(obj->flags & (OF_DEAD)) && obj->type!=OBJ_NONE)
 	{
-		ObjSetPos (obj,&pos,roomnum,&orient,false);
-
-
+		ObjSetPos (obj,pos,roomnum,orient,false);
 	}
-
 }
 
 
@@ -2047,6 +2053,8 @@ void MultiLeaveGame ()
 	ScoreAPIGameOver();
 	NetPlayers[Player_num].flags &=~NPF_CONNECTED;
 
+	MultiSnapClose();
+
 }
 
 // Releases a missile that belongs to a player
@@ -9036,6 +9044,14 @@ void MultiProcessData (ubyte *data,int len,int slot,network_address *from_addr)
 			ACCEPT_CONDITION (NETSEQ_PLAYING,NETSEQ_PLAYING);
 			MultiDoRobotPos(data);
 			break;
+		case MP_ROBOT_POS_DELTA:
+			ACCEPT_CONDITION (NETSEQ_PLAYING,NETSEQ_PLAYING);
+			MultiDoRobotPosDelta(data);
+			break;
+		case MP_ROBOT_POS_ACK:
+			ACCEPT_CONDITION (NETSEQ_PLAYING,NETSEQ_PLAYING);
+			MultiDoRobotPosAck(data,slot);
+			break;
 		case MP_ROBOT_FIRE:
 			ACCEPT_CONDITION (NETSEQ_PLAYING,NETSEQ_PLAYING);
 			MultiDoRobotFire(data);
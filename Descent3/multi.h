@@ -43,7 +43,9 @@ extern bool Multi_bail_ui_menu;
 //Patch 1.1!
 //#define MULTI_VERSION	6
 //Patch 1.3
-#define MULTI_VERSION	10
+//#define MULTI_VERSION	10
+//Delta compressed robot positions
+#define MULTI_VERSION	11
 #endif
 
 #define MULTI_PING_INTERVAL	3
@@ -172,6 +174,8 @@ extern bool Multi_bail_ui_menu;
 #define MP_MISSILE_RELEASE						121 // Informing about a guided missile being released from guided mode
 #define MP_STRIP_PLAYER							122 // Strips player of all weapons (but laser) and reduces energy to 0
 #define MP_REJECTED_CHECKSUM					123 // The server rejected the client checksum. This lets the client know.
+#define MP_ROBOT_POS_DELTA						124	// Delta compressed robot positions (see multi_snapshot.h)
+#define MP_ROBOT_POS_ACK						125	// Client is telling the server which robot position snapshots it got
 
 // Shield request defines
 #define MAX_SHIELD_REQUEST_TYPES	1
@@ -538,6 +542,9 @@ int MultiStuffRobotPosition (unsigned short objectnum,ubyte *data);
 //Handle robot position
 void MultiDoRobotPos (ubyte *data);
 
+//Moves a robot to where the server says it is
+void MultiSetRobotPos (ushort server_objnum,vector *pos,matrix *orient,int roomnum,vector *vel);
+
 //Handle robot (or any AI created) weapon fire
 int MultiSendRobotFireWeapon (unsigned short objectnum,vector *pos,vector *dir,unsigned short weaponnum);
 
@@ -25,6 +25,7 @@
 #include "Mission.h"
 #include "stringtable.h"
 #include "ship.h"
+#include "multi_snapshot.h"
 
 #define WEAPONS_LOAD_UPDATE_INTERVAL	2.0
 
@@ -369,7 +370,8 @@ void MultiDoClientFrame()
 				}
 			}
 
-			ubyte data[MAX_GAME_DATA_SIZE], count = 0, add_count = 0;
+			ubyte data[MAX_GAME_DATA_SIZE];
+			int count = 0, add_count = 0;
 
 			count = MultiStuffPosition(Player_num, data);
 
@@ -386,6 +388,9 @@ void MultiDoClientFrame()
 				count += add_count;
 			}
 
+			// Tell the server which robot snapshots we got, so it can send deltas against them
+			count += MultiSnapStuffAck(&data[count]);
+
 			ASSERT(count < MAX_GAME_DATA_SIZE);
 
 			if (Netgame.flags & NF_PEER_PEER)
@@ -456,6 +461,7 @@ void MultiStartClient(char* scriptname)
 
 	Netgame.local_role = LR_CLIENT;
 	Game_mode = GM_NETWORK;
+	MultiSnapInit();
 	SetGamemodeScript(scriptname);
 }
 
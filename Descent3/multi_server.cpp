@@ -41,6 +41,7 @@
 #include "damage.h"
 //#include "gamespy.h"
 #include "multi_world_state.h"
+#include "multi_snapshot.h"
 #include "ObjScript.h"
 #include "marker.h"
 #include "findintersection.h"
@@ -157,6 +158,7 @@ void MultiStartServer(int playing, char* scriptname, int dedicated_server_num_te
 	Netgame.local_role = LR_SERVER;
 	Netgame.server_sequence = 0;
 	Netgame.server_version = MULTI_VERSION;
+	MultiSnapInit();
 
 	Game_mode = GM_NETWORK;
 
@@ -439,9 +441,9 @@ void MultiClearPlayerMarkers(int slot)
 	int m1 = slot * 2;
 	int m2 = (slot * 2) + 1;
 
-	for (int i = 0; i <= Highest_object_index; i++)
+	for (int i = ObjFirstOfType(OBJ_MARKER); i != -1; i = ObjNextOfType(OBJ_MARKER, i))
 	{
-		if (Objects[i].type == OBJ_MARKER && (Objects[i].id == m1 || Objects[i].id == m2))
+		if (Objects[i].id == m1 || Objects[i].id == m2)
 		{
 			SetObjectDeadFlag(&Objects[i], true, false);
 		}
@@ -849,6 +851,7 @@ void MultiSendJoinObjects(int slot)
 	Num_changed_anim[slot] = 0;
 	Num_changed_turret[slot] = 0;
 	Num_changed_wb_anim[slot] = 0;
+	MultiSnapResetClient(slot);
 
 	// Count how many powerups/robots we have to send and make a list
 	for (i = 0; i < MAX_OBJECTS; i++)
@@ -1168,7 +1171,7 @@ void MultiSendWorldStates(int slot)
 	}
 
 	// Do object stuff
-	for (i = 0; i <= Highest_object_index; i++)
+	for (i = ObjFirstLive(); i != -1; i = ObjNextLive(i))
 	{
 		object* obj = &Objects[i];
 
@@ -1440,11 +1443,9 @@ void MultiCheckToRepositionPowerups()
 
 	int changed = 0;
 
-	for (i = 0; i <= Highest_object_index; i++)
+	for (i = ObjFirstOfType(OBJ_POWERUP); i != -1; i = ObjNextOfType(OBJ_POWERUP, i))
 	{
 		object* obj = &Objects[i];
-		if (obj->type != OBJ_POWERUP)
-			continue;
 
 		if (obj->id == invis_id)
 			continue;
@@ -1542,11 +1543,60 @@ void MultiCheckToRespawnPowerups()
 	}
 }
 
+// A player's position packet.  It's the same for everyone it goes to, so it only gets built once a
+// server frame, the first time someone needs it.
+struct multi_position_packet
+{
+	int frame;								// Multi_position_frame when this was built
+	int pos_count;							// Bytes of position info
+	int count;								// Bytes in data, including any fire and guided info
+	int fire_count;						// Bytes in fire_data
+	ubyte data[MAX_GAME_DATA_SIZE];
+	ubyte fire_data[MAX_GAME_DATA_SIZE];	// Fire info that gets sent reliably
+};
+
+static multi_position_packet Multi_position_packets[MAX_PLAYERS];
+static int Multi_position_frame = 0;			// Bumped every server frame
+
+// Returns the position packet for player slot, building it if it hasn't been yet this frame
+static multi_position_packet* MultiGetPositionPacket(int slot)
+{
+	multi_position_packet* pp = &Multi_position_packets[slot];
+
+	if (pp->frame == Multi_position_frame)
+		return pp;
+
+	pp->frame = Multi_position_frame;
+
+	int count = MultiStuffPosition(slot, pp->data);
+	pp->pos_count = count;
+
+	// Send firing if needed
+	if (Player_fire_packet[slot].fired_on_this_frame == PFP_FIRED)
+		count += MultiStuffPlayerFire(slot, &pp->data[count]);
+
+	// Add in guided stuff
+	if (Players[slot].guided_obj != NULL)
+		count += MultiStuffGuidedInfo(slot, &pp->data[count]);
+
+	ASSERT(count < MAX_GAME_DATA_SIZE);
+	pp->count = count;
+
+	if (Player_fire_packet[slot].fired_on_this_frame == PFP_FIRED_RELIABLE)
+		pp->fire_count = MultiStuffPlayerFire(slot, pp->fire_data);
+	else
+		pp->fire_count = 0;
+
+	return pp;
+}
+
 extern int Multi_occluded;
+int MultiGetPlayerViewRooms(int to_slot, int* src_rooms);
 // Sends out positional updates based on clients pps
 void MultiSendPositionalUpdates(int to_slot)
 {
-	ubyte data[MAX_GAME_DATA_SIZE];
+	int src_rooms[10], num_src_rooms = -1;
+	boa_vis_mask visible_mask, src_mask;
 
 	// Figure out if we should send positional updates to players
 	for (int i = 0; i < MAX_PLAYERS; i++)
@@ -1612,81 +1662,29 @@ void MultiSendPositionalUpdates(int to_slot)
 		//if (i==Player_num)	// Always send server position
 		//	send_position=1;
 
-		int num_src_to_check = 1;
-		int srcs[10];
-		srcs[0] = Players[to_slot].objnum;
-
-		// Check for guideds
-		if (Players[to_slot].guided_obj != NULL)
-			srcs[num_src_to_check++] = Players[to_slot].guided_obj - Objects;
-
-		if (Players[to_slot].small_dll_obj != -1)
+		// Which rooms the to_slot player is looking from is the same for every player, so only do it once
+		if (num_src_rooms == -1)
 		{
-			int objnum = Players[to_slot].small_dll_obj;
-			if (Objects[objnum].flags & OF_DEAD || Objects[objnum].type == OBJ_NONE)
-			{
-				Players[to_slot].small_dll_obj = -1;
-			}
-			else
-			{
-				srcs[num_src_to_check] = objnum;
-				num_src_to_check++;
-			}
+			num_src_rooms = MultiGetPlayerViewRooms(to_slot, src_rooms);
+			BOA_MakeVisibleMask(&visible_mask, src_rooms, num_src_rooms);
+			BOA_MakeRoomMask(&src_mask, src_rooms, num_src_rooms);
 		}
 
-		// See if there are any small views we need to send for
-		// Do left view
-		if (Players[to_slot].small_left_obj != -1)
-		{
-			int objnum = Players[to_slot].small_left_obj;
-			if (Objects[objnum].flags & OF_DEAD || Objects[objnum].type == OBJ_NONE || Objects[objnum].type == OBJ_WEAPON)
-			{
-				Players[to_slot].small_left_obj = -1;
-			}
-			else
-			{
-				srcs[num_src_to_check] = objnum;
-				num_src_to_check++;
-			}
-		}
+		if (BOA_IsRoomInMask(Objects[Players[i].objnum].roomnum, &visible_mask))
+			send_position = 1;
 
-		// Do right view
-		if (Players[to_slot].small_right_obj != -1)
+		if (Player_fire_packet[i].fired_on_this_frame != PFP_NO_FIRED)
 		{
-			int objnum = Players[to_slot].small_right_obj;
-			if ((Objects[objnum].flags & OF_DEAD) || (Objects[objnum].type == OBJ_NONE) || (Objects[objnum].type == OBJ_WEAPON))
+			timer_popped = 1;
+
+			if (Player_fire_packet[i].wb_index >= SECONDARY_INDEX)
 			{
-				Players[to_slot].small_right_obj = -1;
+				send_position = 1;
 			}
 			else
 			{
-				srcs[num_src_to_check] = objnum;
-				num_src_to_check++;
-			}
-		}
-
-		for (int t = 0; t < num_src_to_check; t++)
-		{
-			int room_a = Objects[srcs[t]].roomnum;
-			int room_b = Objects[Players[i].objnum].roomnum;
-
-			if (BOA_IsVisible(room_a, room_b))
-				send_position = 1;
-
-			if (Player_fire_packet[i].fired_on_this_frame != PFP_NO_FIRED)
-			{
-				timer_popped = 1;
-
-				if (Player_fire_packet[i].wb_index >= SECONDARY_INDEX)
-				{
+				if (BOA_IsVisibleToMask(Player_fire_packet[i].dest_roomnum, &src_mask))
 					send_position = 1;
-				}
-				else
-				{
-					if (BOA_IsVisible(Player_fire_packet[i].dest_roomnum, Objects[srcs[t]].roomnum))
-						send_position = 1;
-
-				}
 			}
 		}
 
@@ -1707,31 +1705,16 @@ void MultiSendPositionalUpdates(int to_slot)
 			{
 				Multi_visible_players[to_slot] |= (1 << i);
 
-				int count = MultiStuffPosition(i, data);
-				NetPlayers[to_slot].total_bytes_sent += count;
+				multi_position_packet* pp = MultiGetPositionPacket(i);
+				NetPlayers[to_slot].total_bytes_sent += pp->pos_count;
 
-				int add_count = 0;
-				// Send firing if needed
-				if (Player_fire_packet[i].fired_on_this_frame == PFP_FIRED)
-					add_count = MultiStuffPlayerFire(i, &data[count]);
-				count += add_count;
-				// Add in guided stuff
-				if (Players[i].guided_obj != NULL)
-				{
-					add_count = MultiStuffGuidedInfo(i, &data[count]);
-					count += add_count;
-				}
-
-				ASSERT(count < MAX_GAME_DATA_SIZE);
-
-				nw_Send(&NetPlayers[to_slot].addr, data, count, 0);
+				nw_Send(&NetPlayers[to_slot].addr, pp->data, pp->count, 0);
 
 				// TODO: SEND RELIABLE WEAPON FIRE HERE
 				if (Player_fire_packet[i].fired_on_this_frame == PFP_FIRED_RELIABLE)
 				{
 					//mprintf((0,"NEED TO SEND RELIABLE FIRE FOR %d\n",i));
-					count = MultiStuffPlayerFire(i, data);
-					nw_SendReliable(NetPlayers[to_slot].reliable_socket, data, count, true);
+					nw_SendReliable(NetPlayers[to_slot].reliable_socket, pp->fire_data, pp->fire_count, true);
 				}
 			}
 			else
@@ -1747,13 +1730,12 @@ void MultiSendPositionalUpdates(int to_slot)
 // Figures out which robots have moved since the last time this player slot was updated
 void MultiUpdateRobotMovedList(int slot)
 {
+	const unsigned int type_mask = OBJ_TYPE_BIT(OBJ_ROBOT) | OBJ_TYPE_BIT(OBJ_CLUTTER) | OBJ_TYPE_BIT(OBJ_BUILDING);
 	bool skip_this_obj = false;
 	//check for moved robots
-	for (int a = 0; a <= Highest_object_index; a++)
+	for (int a = ObjFirstOfTypes(type_mask); a != -1; a = ObjNextOfTypes(type_mask, a))
 	{
 		object* obj = &Objects[a];
-		if (obj->type == OBJ_NONE)
-			continue;
 
 		if (MultiIsValidMovedObject(obj))
 		{
@@ -1823,7 +1805,7 @@ void MultiDoNonVisGenericForSlot(int slot)
 
 
 	// Deal with non-vis objects
-	for (i = 0; i <= Highest_object_index; i++)
+	for (i = ObjFirstLive(); i != -1; i = ObjNextLive(i))
 	{
 		int objnum = i;
 		object* obj = &Objects[i];
@@ -1951,9 +1933,10 @@ void MultiDoNonVisGenericForSlot(int slot)
 
 }
 
-// Returns true or false based on whether or not the player can see this generic object in a multiplayer game
-// This takes into account markers, dll objects, and other stuff
-bool MultiIsGenericVisibleToPlayer(int test_objnum, int to_slot)
+// Gets the rooms a player is looking from: their ship, guided missile, and small views.
+// Small views of objects that are gone get turned off.
+// Returns the number of rooms
+int MultiGetPlayerViewRooms(int to_slot, int* src_rooms)
 {
 	int srcs[10], num_src_to_check = 1;
 
@@ -2007,13 +1990,29 @@ bool MultiIsGenericVisibleToPlayer(int test_objnum, int to_slot)
 	}
 
 	for (int t = 0; t < num_src_to_check; t++)
-	{
-		if (BOA_IsVisible(Objects[test_objnum].roomnum, Objects[srcs[t]].roomnum))
-			return true;
-	}
+		src_rooms[t] = Objects[srcs[t]].roomnum;
 
-	return false;
+	return num_src_to_check;
+}
+
+// Makes a mask of the rooms a player is looking from, for BOA_IsVisibleToMask()
+void MultiMakePlayerViewMask(int to_slot, boa_vis_mask* mask)
+{
+	int src_rooms[10];
+	int num_src_rooms = MultiGetPlayerViewRooms(to_slot, src_rooms);
+
+	BOA_MakeRoomMask(mask, src_rooms, num_src_rooms);
+}
+
+// Returns true or false based on whether or not the player can see this generic object in a multiplayer game
+// This takes into account markers, dll objects, and other stuff
+bool MultiIsGenericVisibleToPlayer(int test_objnum, int to_slot)
+{
+	boa_vis_mask mask;
+
+	MultiMakePlayerViewMask(to_slot, &mask);
 
+	return BOA_IsVisibleToMask(Objects[test_objnum].roomnum, &mask);
 }
 
 
@@ -2025,6 +2024,10 @@ void MultiDoServerRobotFrame(int slot)
 	int rcount = 0;
 	int m = 0;
 	ubyte rdata[MAX_GAME_DATA_SIZE];
+	boa_vis_mask view_mask;
+
+	// Everything below checks against the same view rooms, so work them out once
+	MultiMakePlayerViewMask(slot, &view_mask);
 
 	//send robot information for any robots that have moved.
 	for (m = 0; m < Num_moved_robots[slot]; m++)
@@ -2038,26 +2041,20 @@ void MultiDoServerRobotFrame(int slot)
 			continue;
 		}
 
-		if (MultiIsGenericVisibleToPlayer(objnum, slot))
+		if (BOA_IsVisibleToMask(Objects[objnum].roomnum, &view_mask))
 			send_position = 1;
 
 		if (send_position)
 		{
-			rcount = MultiStuffRobotPosition(objnum, rdata);
-			if (rcount > 0)
-			{
-				if (Multi_send_size[slot] + rcount >= MAX_GAME_DATA_SIZE)
-					MultiSendFullPacket(slot, 0);
-				memcpy(&Multi_send_buffer[slot][Multi_send_size[slot]], rdata, rcount);
-				Multi_send_size[slot] += rcount;
-			}
-
+			MultiSnapAddRobot(slot, objnum);
 			Objects[objnum].generic_sent_nonvis &= ~(1 << slot);
 		}
 		else
 			MultiSetupNonVisRobots(slot, &Objects[objnum]);
 	}
 
+	MultiSnapEndRobots(slot);
+
 	//clear the robot movement flag for this player
 	Num_moved_robots[slot] = 0;
 
@@ -2076,7 +2073,7 @@ void MultiDoServerRobotFrame(int slot)
 			continue;
 		}
 
-		if (MultiIsGenericVisibleToPlayer(objnum, slot))
+		if (BOA_IsVisibleToMask(Objects[objnum].roomnum, &view_mask))
 			send_position = 1;
 
 		if (send_position)
@@ -2108,7 +2105,7 @@ void MultiDoServerRobotFrame(int slot)
 			continue;
 		}
 
-		if (MultiIsGenericVisibleToPlayer(objnum, slot))
+		if (BOA_IsVisibleToMask(Objects[objnum].roomnum, &view_mask))
 			send_position = 1;
 
 		if (send_position)
@@ -2141,7 +2138,7 @@ void MultiDoServerRobotFrame(int slot)
 		}
 
 
-		if (MultiIsGenericVisibleToPlayer(objnum, slot))
+		if (BOA_IsVisibleToMask(Objects[objnum].roomnum, &view_mask))
 			send_position = 1;
 
 		if (send_position)
@@ -2283,6 +2280,12 @@ void MultiDoServerFrame()
 
 	Player_count = 1;
 
+	// Position packets built last frame are out of date
+	Multi_position_frame++;
+
+	// Send everything for this frame together
+	nw_BeginSendBatch();
+
 	// Send out data
 	for (i = 0; i < MAX_NET_PLAYERS; i++)
 	{
@@ -2433,6 +2436,8 @@ void MultiDoServerFrame()
 		}
 	}
 
+	nw_EndSendBatch();
+
 	for (i = 0; i < MAX_NET_PLAYERS; i++)
 		Player_fire_packet[i].fired_on_this_frame = PFP_NO_FIRED;
 
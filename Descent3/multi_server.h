@@ -17,6 +17,7 @@
 */
 
 #ifndef MULTI_SERVER_H
+#define MULTI_SERVER_H
 
 #include "pstypes.h"
 #include "multi.h"
@@ -0,0 +1,889 @@
+/*
+* Descent 3
+* Copyright (C) 2024 Parallax Software
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Delta compressed robot positions.
+//
+// A robot's state is quantized before it is sent (positions to 16ths of a unit like
+// MultiAddPositionData, velocities to 128ths like MP_ROBOT_POS, orientations to the three smallest
+// components of a quaternion), and both ends keep the quantized values, so a delta decodes to
+// exactly what the server had.  An encoded robot is:
+//
+//		object number		SNAP_OBJNUM_BITS
+//		baseline age		SNAP_AGE_BITS		0 for a full state, else how many ticks back the baseline is
+//		changed mask		SNAP_CHANGED_BITS
+//		position				if changed: a delta group
+//		orientation			if changed: 1 bit, then a delta group if the left out component is the
+//									same, else the component index and SNAP_QUAT_BITS for each other one
+//		velocity				if changed: a delta group
+//		room					if changed: 16 bits of room or cell number and 1 bit of terrain flag
+//
+// A delta group is a bit count followed by that many bits of each zigzag encoded difference.
+// A full state is a delta against all zeros.  The decoder reads the same number of bits whether or
+// not it has the baseline, so a robot it can't decode doesn't stop it decoding the rest.
+//
+// A tick can take more than one message (and packet), so messages are numbered within a tick and
+// the client acks each tick with a mask of the messages it got all of.
+
+#include <math.h>
+#include <string.h>
+
+#include "multi_snapshot.h"
+#include "multi_snapshot_internal.h"
+#include "multi.h"
+#include "object.h"
+#include "vecmat.h"
+#include "mono.h"
+#include "mem.h"
+#include "pserror.h"
+
+const multi_snap_state Snap_zero_state = {{0, 0, 0}, {0, 0, 0}, 0, 0, 0, {0, 0, 0}};
+
+static snap_server* Snap_servers[MAX_NET_PLAYERS];
+static snap_receiver* Snap_receiver = NULL;
+
+// Bit streams
+
+void SnapBitsInit(snap_bits* b, ubyte* data, int size)
+{
+	b->data = data;
+	b->size = size;
+	b->pos = 0;
+	b->overrun = false;
+}
+
+static void SnapWriteBits(snap_bits* b, uint value, int num_bits)
+{
+	while (num_bits > 0)
+	{
+		const int byte = b->pos >> 3;
+		const int shift = b->pos & 7;
+		int n = 8 - shift;
+		if (n > num_bits)
+			n = num_bits;
+
+		if (byte >= b->size)
+		{
+			b->overrun = true;
+			return;
+		}
+
+		if (shift == 0)
+			b->data[byte] = 0;
+
+		b->data[byte] |= (ubyte)((value & ((1 << n) - 1)) << shift);
+
+		value >>= n;
+		num_bits -= n;
+		b->pos += n;
+	}
+}
+
+static uint SnapReadBits(snap_bits* b, int num_bits)
+{
+	uint value = 0;
+	int done = 0;
+
+	while (num_bits > 0)
+	{
+		const int byte = b->pos >> 3;
+		const int shift = b->pos & 7;
+		int n = 8 - shift;
+		if (n > num_bits)
+			n = num_bits;
+
+		if (byte >= b->size)
+		{
+			b->overrun = true;
+			return 0;
+		}
+
+		value |= (uint)((b->data[byte] >> shift) & ((1 << n) - 1)) << done;
+
+		done += n;
+		num_bits -= n;
+		b->pos += n;
+	}
+
+	return value;
+}
+
+// Returns how many bytes have been used
+int SnapBitsBytes(const snap_bits* b)
+{
+	return (b->pos + 7) >> 3;
+}
+
+// Writes a bit count and then the zigzag encoded differences between from and to
+static void SnapWriteDeltas(snap_bits* b, const int* from, const int* to, int num)
+{
+	uint zigzag[3];
+	uint all = 0;
+	int i;
+
+	ASSERT(num <= 3);
+
+	for (i = 0; i < num; i++)
+	{
+		const int d = (int)((uint)to[i] - (uint)from[i]);
+		zigzag[i] = ((uint)d << 1) ^ (uint)(d >> 31);
+		all |= zigzag[i];
+	}
+
+	int num_bits = 0;
+	while (num_bits < 32 && (all >> num_bits))
+		num_bits++;
+
+	ASSERT(num_bits < (1 << SNAP_DELTA_COUNT_BITS));
+
+	SnapWriteBits(b, num_bits, SNAP_DELTA_COUNT_BITS);
+	for (i = 0; i < num; i++)
+		SnapWriteBits(b, zigzag[i], num_bits);
+}
+
+static void SnapReadDeltas(snap_bits* b, const int* from, int* to, int num)
+{
+	const int num_bits = SnapReadBits(b, SNAP_DELTA_COUNT_BITS);
+
+	for (int i = 0; i < num; i++)
+	{
+		const uint zigzag = SnapReadBits(b, num_bits);
+		const uint d = (zigzag >> 1) ^ (0 - (zigzag & 1));
+		to[i] = (int)((uint)from[i] + d);
+	}
+}
+
+// Quantizing
+
+static int SnapQuantize(float f, float scale, int limit)
+{
+	f = floorf(f * scale + 0.5f);
+
+	if (!(f > -limit))		// Catches NaNs too
+		return -limit;
+	if (f > limit)
+		return limit;
+
+	return (int)f;
+}
+
+static void SnapMatrixToState(const matrix* m, multi_snap_state* state)
+{
+	float q[4];		// x, y, z, w
+	const float trace = m->rvec.x + m->uvec.y + m->fvec.z;
+
+	if (trace > 0)
+	{
+		const float s = sqrtf(trace + 1.0f) * 2.0f;
+		q[0] = (m->fvec.y - m->uvec.z) / s;
+		q[1] = (m->rvec.z - m->fvec.x) / s;
+		q[2] = (m->uvec.x - m->rvec.y) / s;
+		q[3] = 0.25f * s;
+	}
+	else if (m->rvec.x > m->uvec.y && m->rvec.x > m->fvec.z)
+	{
+		const float s = sqrtf(1.0f + m->rvec.x - m->uvec.y - m->fvec.z) * 2.0f;
+		q[0] = 0.25f * s;
+		q[1] = (m->rvec.y + m->uvec.x) / s;
+		q[2] = (m->rvec.z + m->fvec.x) / s;
+		q[3] = (m->fvec.y - m->uvec.z) / s;
+	}
+	else if (m->uvec.y > m->fvec.z)
+	{
+		const float s = sqrtf(1.0f + m->uvec.y - m->rvec.x - m->fvec.z) * 2.0f;
+		q[0] = (m->rvec.y + m->uvec.x) / s;
+		q[1] = 0.25f * s;
+		q[2] = (m->uvec.z + m->fvec.y) / s;
+		q[3] = (m->rvec.z - m->fvec.x) / s;
+	}
+	else
+	{
+		const float s = sqrtf(1.0f + m->fvec.z - m->rvec.x - m->uvec.y) * 2.0f;
+		q[0] = (m->rvec.z + m->fvec.x) / s;
+		q[1] = (m->uvec.z + m->fvec.y) / s;
+		q[2] = 0.25f * s;
+		q[3] = (m->uvec.x - m->rvec.y) / s;
+	}
+
+	// Leave out the biggest component, and flip the quaternion so it's positive
+	int big = 0;
+	for (int i = 1; i < 4; i++)
+		if (fabsf(q[i]) > fabsf(q[big]))
+			big = i;
+
+	const float sign = (q[big] < 0) ? -1.0f : 1.0f;
+	int n = 0;
+
+	for (int i = 0; i < 4; i++)
+	{
+		if (i != big)
+			state->orient[n++] = (short)SnapQuantize(q[i] * sign, SNAP_QUAT_SCALE, SNAP_QUAT_MAX);
+	}
+
+	state->orient_index = big;
+}
+
+static void SnapStateToMatrix(const multi_snap_state* state, matrix* m)
+{
+	float q[4];
+	float sum = 0;
+	int n = 0;
+
+	for (int i = 0; i < 4; i++)
+	{
+		if (i == (state->orient_index & 3))
+			continue;
+
+		q[i] = state->orient[n++] / SNAP_QUAT_SCALE;
+		sum += q[i] * q[i];
+	}
+
+	q[state->orient_index & 3] = (sum < 1.0f) ? sqrtf(1.0f - sum) : 0.0f;
+
+	const float mag = sqrtf(sum + q[state->orient_index & 3] * q[state->orient_index & 3]);
+	for (int i = 0; i < 4; i++)
+		q[i] /= mag;
+
+	const float x = q[0], y = q[1], z = q[2], w = q[3];
+
+	m->rvec.x = 1 - 2 * (y * y + z * z);
+	m->rvec.y = 2 * (x * y - z * w);
+	m->rvec.z = 2 * (x * z + y * w);
+	m->uvec.x = 2 * (x * y + z * w);
+	m->uvec.y = 1 - 2 * (x * x + z * z);
+	m->uvec.z = 2 * (y * z - x * w);
+	m->fvec.x = 2 * (x * z - y * w);
+	m->fvec.y = 2 * (y * z + x * w);
+	m->fvec.z = 1 - 2 * (x * x + y * y);
+}
+
+void SnapMakeState(const vector* pos, const matrix* orient, const vector* vel, int roomnum, multi_snap_state* state)
+{
+	state->pos[0] = SnapQuantize(pos->x, SNAP_POS_SCALE, SNAP_POS_LIMIT);
+	state->pos[1] = SnapQuantize(pos->y, SNAP_POS_SCALE, SNAP_POS_LIMIT);
+	state->pos[2] = SnapQuantize(pos->z, SNAP_POS_SCALE, SNAP_POS_LIMIT);
+
+	SnapMatrixToState(orient, state);
+
+	state->vel[0] = (short)SnapQuantize(vel->x, SNAP_VEL_SCALE, SNAP_VEL_LIMIT);
+	state->vel[1] = (short)SnapQuantize(vel->y, SNAP_VEL_SCALE, SNAP_VEL_LIMIT);
+	state->vel[2] = (short)SnapQuantize(vel->z, SNAP_VEL_SCALE, SNAP_VEL_LIMIT);
+
+	if (ROOMNUM_OUTSIDE(roomnum))
+	{
+		state->roomnum = CELLNUM(roomnum);
+		state->terrain = 1;
+	}
+	else
+	{
+		state->roomnum = roomnum;
+		state->terrain = 0;
+	}
+}
+
+void SnapGetState(const multi_snap_state* state, vector* pos, matrix* orient, vector* vel, int* roomnum)
+{
+	pos->x = state->pos[0] / SNAP_POS_SCALE;
+	pos->y = state->pos[1] / SNAP_POS_SCALE;
+	pos->z = state->pos[2] / SNAP_POS_SCALE;
+
+	SnapStateToMatrix(state, orient);
+
+	vel->x = state->vel[0] / SNAP_VEL_SCALE;
+	vel->y = state->vel[1] / SNAP_VEL_SCALE;
+	vel->z = state->vel[2] / SNAP_VEL_SCALE;
+
+	*roomnum = state->terrain ? MAKE_ROOMNUM(state->roomnum) : state->roomnum;
+}
+
+bool SnapStatesEqual(const multi_snap_state* a, const multi_snap_state* b)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		if (a->pos[i] != b->pos[i] || a->orient[i] != b->orient[i] || a->vel[i] != b->vel[i])
+			return false;
+	}
+
+	return a->orient_index == b->orient_index && a->roomnum == b->roomnum && a->terrain == b->terrain;
+}
+
+// Encoding
+
+void SnapEncode(snap_bits* b, int objnum, int age, const multi_snap_state* base, const multi_snap_state* state)
+{
+	int from[3], to[3];
+	int changed = 0;
+	int i;
+
+	for (i = 0; i < 3; i++)
+	{
+		if (state->pos[i] != base->pos[i])
+			changed |= SNAP_CHANGED_POS;
+		if (state->orient[i] != base->orient[i])
+			changed |= SNAP_CHANGED_ORIENT;
+		if (state->vel[i] != base->vel[i])
+			changed |= SNAP_CHANGED_VEL;
+	}
+
+	if (state->orient_index != base->orient_index)
+		changed |= SNAP_CHANGED_ORIENT;
+	if (state->roomnum != base->roomnum || state->terrain != base->terrain)
+		changed |= SNAP_CHANGED_ROOM;
+
+	SnapWriteBits(b, objnum, SNAP_OBJNUM_BITS);
+	SnapWriteBits(b, age, SNAP_AGE_BITS);
+	SnapWriteBits(b, changed, SNAP_CHANGED_BITS);
+
+	if (changed & SNAP_CHANGED_POS)
+		SnapWriteDeltas(b, base->pos, state->pos, 3);
+
+	if (changed & SNAP_CHANGED_ORIENT)
+	{
+		if (state->orient_index == base->orient_index)
+		{
+			SnapWriteBits(b, 1, 1);
+			for (i = 0; i < 3; i++)
+			{
+				from[i] = base->orient[i];
+				to[i] = state->orient[i];
+			}
+			SnapWriteDeltas(b, from, to, 3);
+		}
+		else
+		{
+			SnapWriteBits(b, 0, 1);
+			SnapWriteBits(b, state->orient_index, 2);
+			for (i = 0; i < 3; i++)
+				SnapWriteBits(b, state->orient[i] + SNAP_QUAT_MAX + 1, SNAP_QUAT_BITS);
+		}
+	}
+
+	if (changed & SNAP_CHANGED_VEL)
+	{
+		for (i = 0; i < 3; i++)
+		{
+			from[i] = base->vel[i];
+			to[i] = state->vel[i];
+		}
+		SnapWriteDeltas(b, from, to, 3);
+	}
+
+	if (changed & SNAP_CHANGED_ROOM)
+	{
+		SnapWriteBits(b, state->roomnum, 16);
+		SnapWriteBits(b, state->terrain, 1);
+	}
+}
+
+// Reads the object number and baseline age of the next robot
+void SnapDecodeHeader(snap_bits* b, int* objnum, int* age)
+{
+	*objnum = SnapReadBits(b, SNAP_OBJNUM_BITS);
+	*age = SnapReadBits(b, SNAP_AGE_BITS);
+}
+
+// Reads the rest of a robot
+void SnapDecodeState(snap_bits* b, const multi_snap_state* base, multi_snap_state* state)
+{
+	int from[3], to[3];
+	int i;
+
+	*state = *base;
+
+	const int changed = SnapReadBits(b, SNAP_CHANGED_BITS);
+
+	if (changed & SNAP_CHANGED_POS)
+		SnapReadDeltas(b, base->pos, state->pos, 3);
+
+	if (changed & SNAP_CHANGED_ORIENT)
+	{
+		if (SnapReadBits(b, 1))
+		{
+			for (i = 0; i < 3; i++)
+				from[i] = base->orient[i];
+			SnapReadDeltas(b, from, to, 3);
+			for (i = 0; i < 3; i++)
+				state->orient[i] = (short)to[i];
+		}
+		else
+		{
+			state->orient_index = SnapReadBits(b, 2);
+			for (i = 0; i < 3; i++)
+				state->orient[i] = (short)((int)SnapReadBits(b, SNAP_QUAT_BITS) - (SNAP_QUAT_MAX + 1));
+		}
+	}
+
+	if (changed & SNAP_CHANGED_VEL)
+	{
+		for (i = 0; i < 3; i++)
+			from[i] = base->vel[i];
+		SnapReadDeltas(b, from, to, 3);
+		for (i = 0; i < 3; i++)
+			state->vel[i] = (short)to[i];
+	}
+
+	if (changed & SNAP_CHANGED_ROOM)
+	{
+		state->roomnum = SnapReadBits(b, 16);
+		state->terrain = SnapReadBits(b, 1);
+	}
+}
+
+// Server side
+
+void SnapServerReset(snap_server* sv)
+{
+	// Keep counting ticks from where we were, so acks from before the reset can't match anything
+	sv->in_tick = false;
+	sv->msg_open = false;
+
+	for (int i = 0; i < MULTI_SNAP_TICKS; i++)
+		sv->ticks[i].valid = false;
+
+	for (int i = 0; i < MAX_OBJECTS; i++)
+		sv->base_index[i] = -1;
+}
+
+void SnapServerBeginTick(snap_server* sv)
+{
+	sv->seq++;
+	sv->in_tick = true;
+
+	snap_tick* t = &sv->ticks[sv->seq & SNAP_TICK_MASK];
+	t->seq = sv->seq;
+	t->valid = true;
+	t->num_msgs = 0;
+	t->acked = 0;
+	t->count = 0;
+}
+
+// Returns the tick with objnum's baseline, or NULL if it doesn't have one
+static snap_tick* SnapServerBase(snap_server* sv, int objnum)
+{
+	const int index = sv->base_index[objnum];
+	if (index == -1)
+		return NULL;
+
+	const ushort base_seq = sv->base_seq[objnum];
+	snap_tick* t = &sv->ticks[base_seq & SNAP_TICK_MASK];
+
+	if (!t->valid || t->seq != base_seq || t->objnum[index] != objnum)
+		return NULL;
+
+	if (t->msgnum[index] >= SNAP_ACK_MESSAGES || !(t->acked & (1 << t->msgnum[index])))
+		return NULL;
+
+	return t;
+}
+
+// Starts a message that can take up to size bytes
+void SnapServerOpenMessage(snap_server* sv, int size)
+{
+	snap_tick* t = &sv->ticks[sv->seq & SNAP_TICK_MASK];
+	int count = 0;
+
+	ASSERT(size >= SNAP_HEADER_SIZE + SNAP_MAX_OBJECT_BYTES && size <= MAX_GAME_DATA_SIZE);
+
+	sv->msg_size_offset = START_DATA(MP_ROBOT_POS_DELTA, sv->msg, &count);
+	MultiAddUshort(sv->seq, sv->msg, &count);
+	MultiAddUbyte(t->num_msgs < 255 ? t->num_msgs : 255, sv->msg, &count);
+	MultiAddUbyte(0, sv->msg, &count);
+	t->num_msgs++;
+	ASSERT(count == SNAP_HEADER_SIZE);
+
+	SnapBitsInit(&sv->bits, sv->msg + SNAP_HEADER_SIZE, size - SNAP_HEADER_SIZE);
+	sv->msg_num = 0;
+	sv->msg_open = true;
+}
+
+// Returns true if another robot might not fit in the message
+bool SnapServerMessageFull(snap_server* sv)
+{
+	return (sv->bits.size - SnapBitsBytes(&sv->bits)) < SNAP_MAX_OBJECT_BYTES;
+}
+
+// Finishes the message and returns its size
+int SnapServerCloseMessage(snap_server* sv)
+{
+	const int count = SNAP_HEADER_SIZE + SnapBitsBytes(&sv->bits);
+
+	sv->msg[SNAP_HEADER_SIZE - 1] = sv->msg_num;
+	END_DATA(count, sv->msg, sv->msg_size_offset);
+	sv->msg_open = false;
+
+	return count;
+}
+
+void SnapServerAdd(snap_server* sv, int objnum, const multi_snap_state* state)
+{
+	ASSERT(sv->in_tick && sv->msg_open && !SnapServerMessageFull(sv));
+	ASSERT(objnum >= 0 && objnum < MAX_OBJECTS);
+
+	snap_tick* t = &sv->ticks[sv->seq & SNAP_TICK_MASK];
+	const multi_snap_state* base = &Snap_zero_state;
+	int age = 0;
+
+	snap_tick* base_tick = SnapServerBase(sv, objnum);
+	if (base_tick)
+	{
+		const ushort base_age = sv->seq - base_tick->seq;
+		if (base_age > 0 && base_age < MULTI_SNAP_TICKS)
+		{
+			base = &base_tick->state[sv->base_index[objnum]];
+			age = base_age;
+		}
+	}
+
+	SnapEncode(&sv->bits, objnum, age, base, state);
+	ASSERT(!sv->bits.overrun);
+	sv->msg_num++;
+
+	if (age)
+		sv->num_delta++;
+	else
+		sv->num_full++;
+
+	// Robots past the end just can't be baselines
+	if (t->count < MAX_CHANGED_OBJECTS)
+	{
+		t->objnum[t->count] = objnum;
+		t->msgnum[t->count] = t->num_msgs - 1;
+		t->state[t->count] = *state;
+		t->count++;
+	}
+}
+
+static void SnapServerAck(snap_server* sv, ushort seq, uint received)
+{
+	snap_tick* t = &sv->ticks[seq & SNAP_TICK_MASK];
+
+	if (!t->valid || t->seq != seq)
+		return;
+
+	// Not finished yet
+	if (sv->in_tick && seq == sv->seq)
+		return;
+
+	if (t->num_msgs < SNAP_ACK_MESSAGES)
+		received &= (1 << t->num_msgs) - 1;
+
+	const uint newly_acked = received & ~t->acked;
+	if (!newly_acked)
+		return;
+
+	t->acked |= newly_acked;
+
+	for (int i = 0; i < t->count; i++)
+	{
+		const int objnum = t->objnum[i];
+
+		if (t->msgnum[i] >= SNAP_ACK_MESSAGES || !(newly_acked & (1 << t->msgnum[i])))
+			continue;
+
+		if (!SnapServerBase(sv, objnum) || (short)(seq - sv->base_seq[objnum]) > 0)
+		{
+			sv->base_seq[objnum] = seq;
+			sv->base_index[objnum] = i;
+		}
+	}
+}
+
+void SnapServerParseAck(snap_server* sv, ubyte* data)
+{
+	int count = 0;
+
+	SKIP_HEADER(data, &count);
+
+	int num = MultiGetUbyte(data, &count);
+	if (num > SNAP_MAX_ACKS)
+		num = SNAP_MAX_ACKS;
+
+	for (int i = 0; i < num; i++)
+	{
+		ushort seq = MultiGetUshort(data, &count);
+		uint received = MultiGetUint(data, &count);
+		SnapServerAck(sv, seq, received);
+	}
+}
+
+// Client side
+
+// Decodes a message, calling apply for each robot.  Returns false if the message was bad.
+bool SnapReceive(snap_receiver* rv, ubyte* data, snap_apply_fn apply)
+{
+	int count = 1;
+	const int size = MultiGetShort(data, &count);
+
+	count = 0;
+	SKIP_HEADER(data, &count);
+	const ushort seq = MultiGetUshort(data, &count);
+	const int msgnum = MultiGetUbyte(data, &count);
+	const int num = MultiGetUbyte(data, &count);
+
+	if (size < count)
+		return false;
+
+	snap_received_tick* t = &rv->ticks[seq & SNAP_TICK_MASK];
+	if (!t->valid || t->seq != seq)
+	{
+		// A late message from a tick we've already moved past
+		if (t->valid && (short)(seq - t->seq) < 0)
+			return true;
+
+		t->seq = seq;
+		t->valid = true;
+		t->dirty = false;
+		t->received = 0;
+	}
+
+	bool have_all = true;
+
+	snap_bits b;
+	SnapBitsInit(&b, data + count, size - count);
+
+	for (int i = 0; i < num; i++)
+	{
+		int objnum, age;
+		SnapDecodeHeader(&b, &objnum, &age);
+
+		if (b.overrun || objnum >= MAX_OBJECTS)
+			return false;
+
+		const multi_snap_state* base = &Snap_zero_state;
+		bool have_base = true;
+
+		if (age)
+		{
+			const ushort base_seq = seq - age;
+			snap_received* r = &rv->objects[objnum][base_seq & SNAP_TICK_MASK];
+
+			if (r->valid && r->seq == base_seq)
+				base = &r->state;
+			else
+				have_base = false;
+		}
+
+		multi_snap_state state;
+		SnapDecodeState(&b, base, &state);
+
+		if (b.overrun)
+			return false;
+
+		// The server will find out we missed it from our ack
+		if (!have_base)
+		{
+			rv->num_missing++;
+			have_all = false;
+			continue;
+		}
+
+		snap_received* r = &rv->objects[objnum][seq & SNAP_TICK_MASK];
+		r->seq = seq;
+		r->valid = true;
+		r->state = state;
+
+		apply(objnum, &state);
+	}
+
+	if (have_all && msgnum < SNAP_ACK_MESSAGES)
+	{
+		t->received |= 1 << msgnum;
+		t->dirty = true;
+	}
+
+	return true;
+}
+
+int SnapStuffAck(snap_receiver* rv, ubyte* data)
+{
+	int num = 0;
+	int i;
+
+	for (i = 0; i < MULTI_SNAP_TICKS; i++)
+	{
+		if (rv->ticks[i].valid && rv->ticks[i].dirty)
+			num++;
+	}
+
+	if (num == 0)
+		return 0;
+
+	if (num > SNAP_MAX_ACKS)
+		num = SNAP_MAX_ACKS;
+
+	int count = 0;
+	int size_offset = START_DATA(MP_ROBOT_POS_ACK, data, &count);
+	MultiAddUbyte(num, data, &count);
+
+	for (i = 0; i < MULTI_SNAP_TICKS && num > 0; i++)
+	{
+		snap_received_tick* t = &rv->ticks[i];
+
+		if (t->valid && t->dirty)
+		{
+			MultiAddUshort(t->seq, data, &count);
+			MultiAddUint(t->received, data, &count);
+			t->dirty = false;
+			num--;
+		}
+	}
+
+	END_DATA(count, data, size_offset);
+	return count;
+}
+
+// Game interface
+
+// Sets up for a new game.  Call after the local role is set.
+void MultiSnapInit()
+{
+	MultiSnapClose();
+}
+
+// Frees everything when leaving a game
+void MultiSnapClose()
+{
+	for (int i = 0; i < MAX_NET_PLAYERS; i++)
+	{
+		if (Snap_servers[i])
+		{
+			mem_free(Snap_servers[i]);
+			Snap_servers[i] = NULL;
+		}
+	}
+
+	if (Snap_receiver)
+	{
+		mem_free(Snap_receiver);
+		Snap_receiver = NULL;
+	}
+}
+
+// Forgets the baselines for a client that is joining
+void MultiSnapResetClient(int slot)
+{
+	ASSERT(slot >= 0 && slot < MAX_NET_PLAYERS);
+
+	if (!Snap_servers[slot])
+	{
+		Snap_servers[slot] = (snap_server*)mem_malloc(sizeof(snap_server));
+		memset(Snap_servers[slot], 0, sizeof(snap_server));
+	}
+
+	SnapServerReset(Snap_servers[slot]);
+}
+
+// Puts the message being built for slot into its send buffer
+static void MultiSnapSendMessage(int slot)
+{
+	snap_server* sv = Snap_servers[slot];
+	const int count = SnapServerCloseMessage(sv);
+
+	ASSERT(Multi_send_size[slot] + count < MAX_GAME_DATA_SIZE);
+
+	memcpy(&Multi_send_buffer[slot][Multi_send_size[slot]], sv->msg, count);
+	Multi_send_size[slot] += count;
+}
+
+// Adds a robot's position to the snapshot being sent to slot this frame
+void MultiSnapAddRobot(int slot, int objnum)
+{
+	object* obj = &Objects[objnum];
+
+	ASSERT(obj->flags & OF_CLIENT_KNOWS);
+
+	if (!Snap_servers[slot])
+		MultiSnapResetClient(slot);
+
+	snap_server* sv = Snap_servers[slot];
+
+	if (!sv->in_tick)
+		SnapServerBeginTick(sv);
+
+	if (sv->msg_open && SnapServerMessageFull(sv))
+		MultiSnapSendMessage(slot);
+
+	if (!sv->msg_open)
+	{
+		if (MAX_GAME_DATA_SIZE - 1 - Multi_send_size[slot] < SNAP_HEADER_SIZE + SNAP_MAX_OBJECT_BYTES)
+			MultiSendFullPacket(slot, 0);
+
+		SnapServerOpenMessage(sv, MAX_GAME_DATA_SIZE - 1 - Multi_send_size[slot]);
+	}
+
+	multi_snap_state state;
+	SnapMakeState(&obj->pos, &obj->orient, &obj->mtype.phys_info.velocity, obj->roomnum, &state);
+	SnapServerAdd(sv, objnum, &state);
+}
+
+// Finishes the snapshot being sent to slot this frame, if any
+void MultiSnapEndRobots(int slot)
+{
+	snap_server* sv = Snap_servers[slot];
+
+	if (!sv)
+		return;
+
+	if (sv->msg_open)
+		MultiSnapSendMessage(slot);
+
+	sv->in_tick = false;
+}
+
+static void MultiSnapApply(int objnum, const multi_snap_state* state)
+{
+	vector pos, vel;
+	matrix orient;
+	int roomnum;
+
+	SnapGetState(state, &pos, &orient, &vel, &roomnum);
+	MultiSetRobotPos(objnum, &pos, &orient, roomnum, &vel);
+}
+
+// Handles a snapshot of robot positions
+void MultiDoRobotPosDelta(ubyte* data)
+{
+	if (!Snap_receiver)
+	{
+		Snap_receiver = (snap_receiver*)mem_malloc(sizeof(snap_receiver));
+		memset(Snap_receiver, 0, sizeof(snap_receiver));
+	}
+
+	if (!SnapReceive(Snap_receiver, data, MultiSnapApply))
+		mprintf((0, "Bad robot snapshot!\n"));
+}
+
+// Adds an ack for any snapshots received since the last one to data
+int MultiSnapStuffAck(ubyte* data)
+{
+	if (!Snap_receiver)
+		return 0;
+
+	return SnapStuffAck(Snap_receiver, data);
+}
+
+// Handles a client's snapshot acks
+void MultiDoRobotPosAck(ubyte* data, int slot)
+{
+	if (Netgame.local_role != LR_SERVER)
+		return;
+
+	if (slot < 0 || slot >= MAX_NET_PLAYERS || !Snap_servers[slot])
+		return;
+
+	SnapServerParseAck(Snap_servers[slot], data);
+}
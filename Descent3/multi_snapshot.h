@@ -0,0 +1,66 @@
+/*
+* Descent 3
+* Copyright (C) 2024 Parallax Software
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MULTI_SNAPSHOT_H
+#define MULTI_SNAPSHOT_H
+
+#include "pstypes.h"
+
+// Delta compressed robot positions.
+//
+// Every time the server sends robot positions to a client it starts a new snapshot tick.  Each
+// robot in the tick is sent as a bit packed delta against a state of that robot the client has
+// told us it received (its baseline), or as a full state if there isn't one.  The client acks the
+// messages it got in each tick, and only robots in acked messages are used as baselines.  A
+// baseline older than MULTI_SNAP_TICKS ticks is never used, so a client that stops acking just
+// gets full states.
+
+#define MULTI_SNAP_TICKS	16		// Must be a power of 2
+
+// Sets up for a new game.  Call after the local role is set.
+void MultiSnapInit();
+
+// Frees everything when leaving a game
+void MultiSnapClose();
+
+// Forgets the baselines for a client that is joining
+// Server only
+void MultiSnapResetClient(int slot);
+
+// Adds a robot's position to the snapshot being sent to slot this frame
+// Server only
+void MultiSnapAddRobot(int slot, int objnum);
+
+// Finishes the snapshot being sent to slot this frame, if any
+// Server only
+void MultiSnapEndRobots(int slot);
+
+// Handles a snapshot of robot positions
+// Client only
+void MultiDoRobotPosDelta(ubyte* data);
+
+// Adds an ack for any snapshots received since the last one to data.  Returns the number of bytes
+// added, which is 0 if there is nothing new to ack.
+// Client only
+int MultiSnapStuffAck(ubyte* data);
+
+// Handles a client's snapshot acks
+// Server only
+void MultiDoRobotPosAck(ubyte* data, int slot);
+
+#endif
@@ -0,0 +1,171 @@
+/*
+* Descent 3
+* Copyright (C) 2024 Parallax Software
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MULTI_SNAPSHOT_INTERNAL_H
+#define MULTI_SNAPSHOT_INTERNAL_H
+
+// The robot snapshot encoder and decoder, and the server and client state they work on.  The
+// game only goes through multi_snapshot.h; this is for the code that tests them.
+
+#include "pstypes.h"
+#include "vecmat_external.h"
+#include "multi_snapshot.h"
+#include "multi.h"
+#include "multi_server.h"
+#include "object_external_struct.h"
+
+#define SNAP_OBJNUM_BITS		11
+#define SNAP_AGE_BITS			4
+#define SNAP_CHANGED_BITS		4
+#define SNAP_DELTA_COUNT_BITS	5			// Bit count in front of a delta group
+#define SNAP_QUAT_BITS			11
+#define SNAP_QUAT_MAX			((1 << (SNAP_QUAT_BITS - 1)) - 1)
+#define SNAP_QUAT_SCALE			(SNAP_QUAT_MAX / 0.70710678f)
+#define SNAP_POS_SCALE			16.0f
+#define SNAP_POS_LIMIT			(1 << 29)	// Keeps position deltas in 31 bits
+#define SNAP_VEL_SCALE			128.0f
+#define SNAP_VEL_LIMIT			32767
+
+#define SNAP_CHANGED_POS		1
+#define SNAP_CHANGED_ORIENT	2
+#define SNAP_CHANGED_VEL		4
+#define SNAP_CHANGED_ROOM		8
+
+#define SNAP_MAX_OBJECT_BYTES	32			// Most an encoded robot can take (it's 232 bits)
+#define SNAP_HEADER_SIZE		7			// Message header, tick, message number and number of robots
+#define SNAP_MAX_ACKS			8			// Ticks acked in one message
+#define SNAP_ACK_MESSAGES		32			// Messages in a tick that can be acked
+#define SNAP_TICK_MASK			(MULTI_SNAP_TICKS - 1)
+
+#if (MAX_OBJECTS > (1 << SNAP_OBJNUM_BITS))
+#error SNAP_OBJNUM_BITS is too small for MAX_OBJECTS
+#endif
+
+#if (MULTI_SNAP_TICKS != (1 << SNAP_AGE_BITS))
+#error SNAP_AGE_BITS does not match MULTI_SNAP_TICKS
+#endif
+
+// A quantized robot state
+struct multi_snap_state
+{
+	int pos[3];					// Position in 16ths of a unit
+	short orient[3];			// The three smallest quaternion components
+	ubyte orient_index;		// Which component was left out
+	ubyte terrain;				// 1 if roomnum is a terrain cell
+	ushort roomnum;
+	short vel[3];				// Velocity in 128ths of a unit per second
+};
+
+extern const multi_snap_state Snap_zero_state;
+
+// A bit stream, for reading or writing
+struct snap_bits
+{
+	ubyte* data;
+	int size;					// In bytes
+	int pos;						// In bits
+	bool overrun;				// Tried to go past the end
+};
+
+// Robots sent to a client in one tick
+struct snap_tick
+{
+	ushort seq;
+	bool valid;
+	int num_msgs;
+	uint acked;					// Messages the client got, whose robots can be baselines
+	int count;
+	ushort objnum[MAX_CHANGED_OBJECTS];
+	ubyte msgnum[MAX_CHANGED_OBJECTS];
+	multi_snap_state state[MAX_CHANGED_OBJECTS];
+};
+
+// What the server knows about one client
+struct snap_server
+{
+	ushort seq;									// Tick being sent, or the last one
+	bool in_tick;
+	snap_tick ticks[MULTI_SNAP_TICKS];
+	ushort base_seq[MAX_OBJECTS];			// Newest acked tick each object was in
+	short base_index[MAX_OBJECTS];		// Where the object is in that tick, -1 for none
+
+	// Message being built
+	ubyte msg[MAX_GAME_DATA_SIZE];
+	snap_bits bits;
+	int msg_size_offset;
+	int msg_num;
+	bool msg_open;
+
+	int num_full, num_delta;
+};
+
+// Ticks a client has received
+struct snap_received_tick
+{
+	ushort seq;
+	bool valid;
+	bool dirty;					// Needs acking
+	uint received;				// Messages we decoded all of
+};
+
+// A robot state a client has received
+struct snap_received
+{
+	ushort seq;
+	bool valid;
+	multi_snap_state state;
+};
+
+// What a client knows
+struct snap_receiver
+{
+	snap_received_tick ticks[MULTI_SNAP_TICKS];
+	snap_received objects[MAX_OBJECTS][MULTI_SNAP_TICKS];
+	int num_missing;			// Robots we couldn't decode because we didn't have their baseline
+};
+
+typedef void (*snap_apply_fn)(int objnum, const multi_snap_state* state);
+
+// Bit streams
+void SnapBitsInit(snap_bits* b, ubyte* data, int size);
+int SnapBitsBytes(const snap_bits* b);
+
+// Quantizing
+void SnapMakeState(const vector* pos, const matrix* orient, const vector* vel, int roomnum, multi_snap_state* state);
+void SnapGetState(const multi_snap_state* state, vector* pos, matrix* orient, vector* vel, int* roomnum);
+bool SnapStatesEqual(const multi_snap_state* a, const multi_snap_state* b);
+
+// Encoding
+void SnapEncode(snap_bits* b, int objnum, int age, const multi_snap_state* base, const multi_snap_state* state);
+void SnapDecodeHeader(snap_bits* b, int* objnum, int* age);
+void SnapDecodeState(snap_bits* b, const multi_snap_state* base, multi_snap_state* state);
+
+// Server side
+void SnapServerReset(snap_server* sv);
+void SnapServerBeginTick(snap_server* sv);
+void SnapServerOpenMessage(snap_server* sv, int size);
+bool SnapServerMessageFull(snap_server* sv);
+int SnapServerCloseMessage(snap_server* sv);
+void SnapServerAdd(snap_server* sv, int objnum, const multi_snap_state* state);
+void SnapServerParseAck(snap_server* sv, ubyte* data);
+
+// Client side
+bool SnapReceive(snap_receiver* rv, ubyte* data, snap_apply_fn apply);
+int SnapStuffAck(snap_receiver* rv, ubyte* data);
+
+#endif
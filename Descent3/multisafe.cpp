@@ -1829,7 +1829,7 @@ void msafe_CallFunction(ubyte type, msafe_struct* mstruct)
 	{
 		object* objp = ObjGet(mstruct->objhandle);
 		if (objp)
-			objp->type = mstruct->type;
+			ObjSetType(objp, mstruct->type);
 		else
 			return;
 	}
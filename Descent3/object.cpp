@@ -71,6 +71,7 @@
 #include "levelgoal.h"
 #include "psrand.h"
 #include "vibeinterface.h"
+#include "objgrid.h"
 
 #ifdef EDITOR
 #include "editor\d3edit.h"
@@ -200,23 +201,15 @@ void obj_goto_prev_viewer()
 
 object* obj_find_first_of_type(int type)
 {
-	for (int i = 0; i <= Highest_object_index; i++)
-		if (Objects[i].type == type)
-			return (&Objects[i]);
+	int objnum = ObjFirstOfType(type);
 
-	return NULL;
+	return (objnum != -1) ? &Objects[objnum] : NULL;
 }
 
 
 int obj_return_num_of_type(int type)
 {
-	int count = 0;
-
-	for (int i = 0; i <= Highest_object_index; i++)
-		if (Objects[i].type == type)
-			count++;
-
-	return (count);
+	return ObjNumOfType(type);
 }
 
 
@@ -224,8 +217,8 @@ int obj_return_num_of_typeid(int type, int id)
 {
 	int count = 0;
 
-	for (int i = 0; i <= Highest_object_index; i++)
-		if (Objects[i].type == type && Objects[i].id == id)
+	for (int i = ObjFirstOfType(type); i != -1; i = ObjNextOfType(type, i))
+		if (Objects[i].id == id)
 			count++;
 
 	return (count);
@@ -310,6 +303,9 @@ void ResetObjectList()
 	//Say no big objects
 	InitBigObjects();
 
+	//Empty the object grid
+	ObjGridInit();
+
 	ObjResetPositionHistory();
 }
 
@@ -382,6 +378,8 @@ void ObjLink(int objnum, int roomnum)
 	ASSERT(Objects[0].prev != 0);
 	if (Objects[0].prev == 0)
 		Objects[0].prev = -1;
+
+	ObjGridLink(objnum);
 }
 
 void ObjUnlink(int objnum)
@@ -395,6 +393,8 @@ void ObjUnlink(int objnum)
 		BigObjRemove(objnum);
 	}
 
+	ObjGridUnlink(objnum);
+
 	if (OBJECT_OUTSIDE(obj))
 	{
 		// zar: room hasn't been assigned yet? why is this being unlinked???
@@ -436,7 +436,220 @@ void ObjUnlink(int objnum)
 }
 
 //-----------------------------------------------------------------------------
-//	Scan the object list, freeing down to num_used objects
+//	Live object lists
+//
+//	Every allocated object is on the live list, and every object with a type is on the list for
+//	that type.  The lists are kept in object number order, so walking one visits objects in the
+//	same order as a loop from 0 to Highest_object_index, without the holes.
+
+static short Obj_live_list[MAX_OBJECTS];
+static short Obj_live_pos[MAX_OBJECTS];						// Where each object is on the live list, or -1
+static int Obj_num_live = 0;
+
+static short Obj_type_list[MAX_OBJECT_TYPES][MAX_OBJECTS];
+static short Obj_type_pos[MAX_OBJECTS];						// Where each object is on its type's list, or -1
+static ubyte Obj_listed_type[MAX_OBJECTS];					// Which type list each object is on
+static int Obj_num_of_type[MAX_OBJECT_TYPES];
+
+// Adds objnum to a sorted list
+static void ObjListInsert(short* list, int* num, short* pos, int objnum)
+{
+	int lo = 0, hi = *num;
+
+	// New objects usually go on the end
+	if (hi && list[hi - 1] > objnum)
+	{
+		while (lo < hi)
+		{
+			int mid = (lo + hi) / 2;
+			if (list[mid] < objnum)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+	}
+	else
+		lo = hi;
+
+	for (int i = *num; i > lo; i--)
+	{
+		list[i] = list[i - 1];
+		pos[list[i]] = i;
+	}
+
+	list[lo] = objnum;
+	pos[objnum] = lo;
+	(*num)++;
+}
+
+// Takes objnum off a sorted list
+static void ObjListRemove(short* list, int* num, short* pos, int objnum)
+{
+	int p = pos[objnum];
+
+	if (p == -1)
+		return;
+
+	ASSERT(list[p] == objnum);
+
+	(*num)--;
+	for (int i = p; i < *num; i++)
+	{
+		list[i] = list[i + 1];
+		pos[list[i]] = i;
+	}
+
+	pos[objnum] = -1;
+}
+
+// Returns the first object on a sorted list after objnum, which may not be on the list any more
+static int ObjListNext(const short* list, int num, const short* pos, int objnum, bool on_list)
+{
+	int lo, hi;
+
+	if (on_list)
+	{
+		lo = pos[objnum] + 1;
+	}
+	else
+	{
+		lo = 0;
+		hi = num;
+		while (lo < hi)
+		{
+			int mid = (lo + hi) / 2;
+			if (list[mid] <= objnum)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+	}
+
+	return (lo < num) ? list[lo] : -1;
+}
+
+// Moves an object to the list for its current type
+static void ObjUpdateTypeList(int objnum)
+{
+	int type = Objects[objnum].type;
+
+	if ((Obj_type_pos[objnum] != -1) && (Obj_listed_type[objnum] == type))
+		return;
+
+	if (Obj_type_pos[objnum] != -1)
+		ObjListRemove(Obj_type_list[Obj_listed_type[objnum]], &Obj_num_of_type[Obj_listed_type[objnum]], Obj_type_pos, objnum);
+
+	if ((type != OBJ_NONE) && (Obj_live_pos[objnum] != -1))
+	{
+		ASSERT(type < MAX_OBJECT_TYPES);
+		ObjListInsert(Obj_type_list[type], &Obj_num_of_type[type], Obj_type_pos, objnum);
+		Obj_listed_type[objnum] = type;
+	}
+}
+
+// Rebuilds the lists from the object types
+static void ObjResetLiveLists()
+{
+	int i;
+
+	Obj_num_live = 0;
+	for (i = 0; i < MAX_OBJECT_TYPES; i++)
+		Obj_num_of_type[i] = 0;
+
+	for (i = 0; i < MAX_OBJECTS; i++)
+	{
+		Obj_type_pos[i] = -1;
+
+		if (Objects[i].type == OBJ_NONE)
+		{
+			Obj_live_pos[i] = -1;
+			continue;
+		}
+
+		Obj_live_pos[i] = Obj_num_live;
+		Obj_live_list[Obj_num_live++] = i;
+		ObjUpdateTypeList(i);
+	}
+}
+
+// Returns the lowest numbered object in use, or -1 if there are none
+int ObjFirstLive()
+{
+	return Obj_num_live ? Obj_live_list[0] : -1;
+}
+
+// Returns the next object in use after objnum, or -1.  Objects created or deleted along the way
+// are handled the same as in a loop over Objects[].
+int ObjNextLive(int objnum)
+{
+	return ObjListNext(Obj_live_list, Obj_num_live, Obj_live_pos, objnum, Obj_live_pos[objnum] != -1);
+}
+
+// Returns the lowest numbered object of the given type, or -1
+int ObjFirstOfType(int type)
+{
+	ASSERT(type >= 0 && type < MAX_OBJECT_TYPES);
+
+	return Obj_num_of_type[type] ? Obj_type_list[type][0] : -1;
+}
+
+// Returns the next object of the given type after objnum, or -1
+int ObjNextOfType(int type, int objnum)
+{
+	bool on_list = (Obj_type_pos[objnum] != -1) && (Obj_listed_type[objnum] == type);
+
+	return ObjListNext(Obj_type_list[type], Obj_num_of_type[type], Obj_type_pos, objnum, on_list);
+}
+
+// Returns the lowest numbered object whose type is in type_mask (a bit for each type), or -1
+int ObjFirstOfTypes(unsigned int type_mask)
+{
+	int first = -1;
+
+	for (int type = 0; type_mask; type++, type_mask >>= 1)
+	{
+		if ((type_mask & 1) && Obj_num_of_type[type] && ((first == -1) || (Obj_type_list[type][0] < first)))
+			first = Obj_type_list[type][0];
+	}
+
+	return first;
+}
+
+// Returns the next object after objnum whose type is in type_mask, or -1
+int ObjNextOfTypes(unsigned int type_mask, int objnum)
+{
+	int next = -1;
+
+	for (int type = 0; type_mask; type++, type_mask >>= 1)
+	{
+		if (type_mask & 1)
+		{
+			int n = ObjNextOfType(type, objnum);
+			if ((n != -1) && ((next == -1) || (n < next)))
+				next = n;
+		}
+	}
+
+	return next;
+}
+
+// Returns how many objects there are of the given type
+int ObjNumOfType(int type)
+{
+	ASSERT(type >= 0 && type < MAX_OBJECT_TYPES);
+
+	return Obj_num_of_type[type];
+}
+
+// Changes an object's type, keeping the type lists up to date
+void ObjSetType(object* obj, int type)
+{
+	obj->type = type;
+	ObjUpdateTypeList(OBJNUM(obj));
+}
+
+//-----------------------------------------------------------------------------
+//	Scan the live objects, freeing down to num_used objects
 //	Returns number of slots freed.
 int FreeObjectSlots(int num_used)
 {
@@ -445,13 +658,15 @@ int FreeObjectSlots(int num_used)
 	int	num_already_free, num_to_free, original_num_to_free;
 
 	olind = 0;
-	num_already_free = MAX_OBJECTS - Highest_object_index - 1;
+	num_already_free = MAX_OBJECTS - Obj_num_live;
 
 	if (MAX_OBJECTS - num_already_free < num_used)
 		return 0;
 
-	for (i = 0; i <= Highest_object_index; i++)
+	for (int l = 0; l < Obj_num_live; l++)
 	{
+		i = Obj_live_list[l];
+
 		if (Objects[i].flags & OF_DEAD)
 		{
 			num_already_free++;
@@ -463,9 +678,6 @@ int FreeObjectSlots(int num_used)
 			switch (Objects[i].type)
 			{
 			case OBJ_NONE:
-				num_already_free++;
-				if (MAX_OBJECTS - num_already_free < num_used)
-					return 0;
 				break;
 			case OBJ_WALL:
 				Int3();		//	This is curious.  What is an object that is a wall?
@@ -540,6 +752,9 @@ int ObjAllocate(void)
 
 	objnum = free_obj_list[Num_objects++];
 
+	ObjListInsert(Obj_live_list, &Obj_num_live, Obj_live_pos, objnum);
+	ASSERT(Obj_num_live == Num_objects);
+
 	if (objnum > Highest_object_index)
 	{
 		Highest_object_index = objnum;
@@ -564,8 +779,10 @@ void ObjFree(int objnum)
 	free_obj_list[--Num_objects] = objnum;
 	ASSERT(Num_objects >= 0);
 
-	if (objnum == Highest_object_index)
-		while (Objects[--Highest_object_index].type == OBJ_NONE);
+	ObjListRemove(Obj_live_list, &Obj_num_live, Obj_live_pos, objnum);
+	ObjUpdateTypeList(objnum);
+
+	Highest_object_index = Obj_num_live ? Obj_live_list[Obj_num_live - 1] : -1;
 }
 
 
@@ -602,6 +819,8 @@ void ObjSetAABB(object* obj)
 
 		obj->max_xyz = obj->pos + object_rad;
 	}
+
+	ObjGridUpdate(OBJNUM(obj));
 }
 
 //-----------------------------------------------------------------------------
@@ -652,6 +871,8 @@ int ObjCreate(ubyte type, ushort id, int roomnum, vector* pos, const matrix* ori
 		return -1;
 	}
 
+	ObjUpdateTypeList(objnum);
+
 #ifdef _DEBUG
 	if (print_object_info)
 	{
@@ -762,7 +983,7 @@ void ObjReInitPositionHistory(void)
 {
 	ObjResetPositionHistory();
 
-	for (int i = 0; i <= Highest_object_index; i++)
+	for (int i = ObjFirstLive(); i != -1; i = ObjNextLive(i))
 	{
 		if (Objects[i].type != OBJ_NONE)
 		{
@@ -945,6 +1166,9 @@ void ObjDelete(int objnum)
 		obj->lighting_info = NULL;
 	}
 
+	//Remove any script timers for this object
+	Osiris_TimerObjectDeleted(obj->handle);
+
 	ObjFree(objnum);
 }
 
@@ -954,7 +1178,7 @@ void FreeAllObjects()
 {
 	int objnum;
 
-	for (objnum = 0; objnum <= Highest_object_index; objnum++)
+	for (objnum = ObjFirstLive(); objnum != -1; objnum = ObjNextLive(objnum))
 		if (Objects[objnum].type != OBJ_NONE)
 		{
 			Objects[objnum].flags |= OF_SERVER_SAYS_DELETE;
@@ -971,11 +1195,10 @@ void ObjDeleteDead()
 	object* objp;
 	int		local_dead_player_object = -1;
 
-	// Move all objects
-	objp = Objects;
-
-	for (int i = 0; i <= Highest_object_index; i++)
+	for (int i = ObjFirstLive(); i != -1; i = ObjNextLive(i))
 	{
+		objp = &Objects[i];
+
 		if ((objp->type != OBJ_NONE) && (objp->flags & OF_DEAD))
 		{
 			if (objp->flags & OF_INFORM_DESTROY_TO_LG)
@@ -1068,7 +1291,6 @@ void ObjDeleteDead()
 				ObjDelete(i);
 			}
 		}
-		objp++;
 	}
 
 	// Delete our visual effects
@@ -1659,10 +1881,12 @@ void ObjDoEffects(object* obj)
 //Check passed-through faces for triggers, etc.
 void ObjCheckTriggers(object* objp)
 {
-	for (int i = 0; i < Fvi_num_recorded_faces; i++)
+	fvi_context *fvi = fvi_GetThreadContext();
+
+	for (int i = 0; i < fvi->num_recorded_faces; i++)
 	{
-		int roomnum = Fvi_recorded_faces[i].room_index;
-		int facenum = Fvi_recorded_faces[i].face_index;
+		int roomnum = fvi->recorded_faces[i].room_index;
+		int facenum = fvi->recorded_faces[i].face_index;
 
 		CheckTrigger(roomnum, facenum, objp, TT_PASS_THROUGH);
 	}
@@ -2024,8 +2248,13 @@ void ObjDoFrameAll()
 	Physics_NumLinked = 0;
 
 	//Process each object
-	for (i = 0, objp = Objects; i <= Highest_object_index; i++, objp++)
+	for (i = ObjFirstLive(); i != -1; i = ObjNextLive(i))
 	{
+		objp = &Objects[i];
+
+		// Catch types changed without ObjSetType()
+		ObjUpdateTypeList(i);
+
 		if ((objp->type != OBJ_NONE) && (!(objp->flags & OF_DEAD)))
 		{
 			RTP_STARTINCTIME(obj_do_frm);
@@ -2180,7 +2409,7 @@ void DoSpecialPlayerStuff(object* objp)
 
 
 //Builds the free object list by scanning the list of free objects & adding unused ones to the list
-//Also sets Highest_object_index
+//Also sets Highest_object_index and rebuilds the live object lists
 void ResetFreeObjects()
 {
 	int i;
@@ -2192,6 +2421,8 @@ void ResetFreeObjects()
 			free_obj_list[--Num_objects] = i;
 		else if (Highest_object_index == -1)
 			Highest_object_index = i;
+
+	ObjResetLiveLists();
 }
 
 
@@ -2601,7 +2832,7 @@ void ObjGhostObject(int objnum)
 		return;
 
 	obj->dummy_type = obj->type;
-	obj->type = OBJ_DUMMY;
+	ObjSetType(obj, OBJ_DUMMY);
 }
 
 //Restores a ghosted object back to it's old type
@@ -2626,6 +2857,6 @@ void ObjUnGhostObject(int objnum)
 		mprintf((0, "UnGhosting Object in that is currently in a player's inventory!\n"));
 	}
 
-	obj->type = obj->dummy_type;
+	ObjSetType(obj, obj->dummy_type);
 	obj->dummy_type = OBJ_NONE;
 }
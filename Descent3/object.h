@@ -149,9 +149,29 @@ void ObjDelete(int objnum);
 void ResetObjectList();
 
 //Builds the free object list by scanning the list of free objects & adding unused ones to the list
-//Also sets Highest_object_index
+//Also sets Highest_object_index and rebuilds the live object lists
 void ResetFreeObjects();
 
+// Live object lists, for looping over the objects in use without the holes:
+//		for (objnum = ObjFirstLive(); objnum != -1; objnum = ObjNextLive(objnum))
+//		for (objnum = ObjFirstOfType(OBJ_ROBOT); objnum != -1; objnum = ObjNextOfType(OBJ_ROBOT, objnum))
+// Objects are visited in object number order, and it's safe to create and delete objects in the
+// loop, with the same results as a loop from 0 to Highest_object_index.
+int ObjFirstLive();
+int ObjNextLive(int objnum);
+int ObjFirstOfType(int type);
+int ObjNextOfType(int type, int objnum);
+int ObjNumOfType(int type);
+
+// Same as above for objects of any of the types in a mask made with OBJ_TYPE_BIT()
+#define OBJ_TYPE_BIT(type)	(1 << (type))
+int ObjFirstOfTypes(unsigned int type_mask);
+int ObjNextOfTypes(unsigned int type_mask, int objnum);
+
+// Changes the type of an object that's in use.  Use this instead of setting obj->type so the
+// type lists stay right.
+void ObjSetType(object *obj, int type);
+
 // Frees all the objects that are currently in use
 void FreeAllObjects();
 
@@ -0,0 +1,266 @@
+/*
+* Descent 3
+* Copyright (C) 2024 Parallax Software
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Spatial hash of object positions for area queries.
+//
+// Each cell is OBJ_GRID_CELL_SIZE on a side, and cells are hashed into a fixed number of buckets,
+// so the grid covers the whole world without caring where the mine or terrain is.  A bucket is a
+// doubly linked list of objects, like the room object lists.  Hash collisions only mean a query
+// looks at a few extra objects.
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#include "objgrid.h"
+#include "object.h"
+#include "polymodel.h"
+#include "pserror.h"
+
+#define OBJ_GRID_BUCKETS			4096							// Must be a power of 2
+#define OBJ_GRID_LARGE				OBJ_GRID_BUCKETS			// Bucket number of the list of large objects
+#define OBJ_GRID_MAX_QUERY_CELLS	256							// Bigger queries look at every bucket
+
+static short Obj_grid_head[OBJ_GRID_BUCKETS + 1];
+static short Obj_grid_next[MAX_OBJECTS];
+static short Obj_grid_prev[MAX_OBJECTS];
+static short Obj_grid_bucket[MAX_OBJECTS];						// -1 if the object isn't in the grid
+static unsigned int Obj_grid_link_order[MAX_OBJECTS];
+static unsigned int Obj_grid_link_count = 0;
+
+static inline int ObjGridCell(float f)
+{
+	return (int)floorf(f * (1.0f / OBJ_GRID_CELL_SIZE));
+}
+
+static inline int ObjGridHash(int x, int y, int z)
+{
+	return ((x * 73856093) ^ (y * 19349663) ^ (z * 83492791)) & (OBJ_GRID_BUCKETS - 1);
+}
+
+// Returns how far from its position an object can reach
+static float ObjGridExtent(const object *obj)
+{
+	float extent = obj->size;
+	float d;
+
+	d = obj->max_xyz.x - obj->pos.x; if (d > extent) extent = d;
+	d = obj->max_xyz.y - obj->pos.y; if (d > extent) extent = d;
+	d = obj->max_xyz.z - obj->pos.z; if (d > extent) extent = d;
+	d = obj->pos.x - obj->min_xyz.x; if (d > extent) extent = d;
+	d = obj->pos.y - obj->min_xyz.y; if (d > extent) extent = d;
+	d = obj->pos.z - obj->min_xyz.z; if (d > extent) extent = d;
+
+	if (obj->flags & OF_POLYGON_OBJECT)
+	{
+		d = Poly_models[obj->rtype.pobj_info.model_num].wall_size + vm_GetMagnitude((vector *)&obj->wall_sphere_offset);
+		if (d > extent) extent = d;
+	}
+
+	return extent;
+}
+
+// Returns the bucket an object belongs in
+static int ObjGridBucket(const object *obj)
+{
+	if (obj->type == OBJ_ROOM || !(ObjGridExtent(obj) <= OBJ_GRID_MAX_EXTENT))
+		return OBJ_GRID_LARGE;
+
+	return ObjGridHash(ObjGridCell(obj->pos.x), ObjGridCell(obj->pos.y), ObjGridCell(obj->pos.z));
+}
+
+static void ObjGridRemove(int objnum)
+{
+	int bucket = Obj_grid_bucket[objnum];
+
+	if (bucket == -1)
+		return;
+
+	if (Obj_grid_prev[objnum] == -1)
+		Obj_grid_head[bucket] = Obj_grid_next[objnum];
+	else
+		Obj_grid_next[Obj_grid_prev[objnum]] = Obj_grid_next[objnum];
+
+	if (Obj_grid_next[objnum] != -1)
+		Obj_grid_prev[Obj_grid_next[objnum]] = Obj_grid_prev[objnum];
+
+	Obj_grid_bucket[objnum] = -1;
+}
+
+static void ObjGridInsert(int objnum, int bucket)
+{
+	Obj_grid_prev[objnum] = -1;
+	Obj_grid_next[objnum] = Obj_grid_head[bucket];
+
+	if (Obj_grid_head[bucket] != -1)
+		Obj_grid_prev[Obj_grid_head[bucket]] = objnum;
+
+	Obj_grid_head[bucket] = objnum;
+	Obj_grid_bucket[objnum] = bucket;
+}
+
+// Clears the grid.  Called when the object lists are reset.
+void ObjGridInit(void)
+{
+	int i;
+
+	for (i = 0; i <= OBJ_GRID_BUCKETS; i++)
+		Obj_grid_head[i] = -1;
+
+	for (i = 0; i < MAX_OBJECTS; i++)
+	{
+		Obj_grid_next[i] = Obj_grid_prev[i] = -1;
+		Obj_grid_bucket[i] = -1;
+		Obj_grid_link_order[i] = 0;
+	}
+
+	Obj_grid_link_count = 0;
+}
+
+// Adds an object that was just linked into a room or terrain cell
+void ObjGridLink(int objnum)
+{
+	ASSERT(objnum >= 0 && objnum < MAX_OBJECTS);
+
+	// Lists that were cleared by hand can leave an object behind, so don't assume it's gone
+	ObjGridRemove(objnum);
+	ObjGridInsert(objnum, ObjGridBucket(&Objects[objnum]));
+
+	Obj_grid_link_order[objnum] = ++Obj_grid_link_count;
+}
+
+// Removes an object that is being unlinked
+void ObjGridUnlink(int objnum)
+{
+	ASSERT(objnum >= 0 && objnum < MAX_OBJECTS);
+
+	ObjGridRemove(objnum);
+}
+
+// Moves an object to the cell for its current position and bounding box
+void ObjGridUpdate(int objnum)
+{
+	ASSERT(objnum >= 0 && objnum < MAX_OBJECTS);
+
+	// Not linked yet
+	if (Obj_grid_bucket[objnum] == -1)
+		return;
+
+	int bucket = ObjGridBucket(&Objects[objnum]);
+
+	if (bucket != Obj_grid_bucket[objnum])
+	{
+		ObjGridRemove(objnum);
+		ObjGridInsert(objnum, bucket);
+	}
+}
+
+// Returns the order objects were linked in
+unsigned int ObjGridLinkOrder(int objnum)
+{
+	return Obj_grid_link_order[objnum];
+}
+
+// Returns how many grid cells a query of the given box looks at
+int ObjGridQueryCells(const vector *min_xyz, const vector *max_xyz)
+{
+	const float x = (float)(ObjGridCell(max_xyz->x + OBJ_GRID_MAX_EXTENT) - ObjGridCell(min_xyz->x - OBJ_GRID_MAX_EXTENT) + 1);
+	const float y = (float)(ObjGridCell(max_xyz->y + OBJ_GRID_MAX_EXTENT) - ObjGridCell(min_xyz->y - OBJ_GRID_MAX_EXTENT) + 1);
+	const float z = (float)(ObjGridCell(max_xyz->z + OBJ_GRID_MAX_EXTENT) - ObjGridCell(min_xyz->z - OBJ_GRID_MAX_EXTENT) + 1);
+	const float num_cells = x * y * z;
+
+	return (num_cells < 1.0e9f) ? (int)num_cells : 1000000000;
+}
+
+// Fills list with every object that could reach into the given box, in object number order
+int ObjGridQueryBox(const vector *min_xyz, const vector *max_xyz, short *list, int max_elements)
+{
+	short found[MAX_OBJECTS];
+	int buckets[OBJ_GRID_MAX_QUERY_CELLS];
+	int num_buckets = 0;
+	int num_found = 0;
+	int i;
+
+	// Small objects can reach into the box from this far outside it
+	vector lo = *min_xyz;
+	vector hi = *max_xyz;
+
+	lo.x -= OBJ_GRID_MAX_EXTENT; lo.y -= OBJ_GRID_MAX_EXTENT; lo.z -= OBJ_GRID_MAX_EXTENT;
+	hi.x += OBJ_GRID_MAX_EXTENT; hi.y += OBJ_GRID_MAX_EXTENT; hi.z += OBJ_GRID_MAX_EXTENT;
+
+	const int x0 = ObjGridCell(lo.x), x1 = ObjGridCell(hi.x);
+	const int y0 = ObjGridCell(lo.y), y1 = ObjGridCell(hi.y);
+	const int z0 = ObjGridCell(lo.z), z1 = ObjGridCell(hi.z);
+	const float num_cells = (float)(x1 - x0 + 1) * (float)(y1 - y0 + 1) * (float)(z1 - z0 + 1);
+
+	const bool scan_all = !(num_cells <= OBJ_GRID_MAX_QUERY_CELLS);
+
+	if (!scan_all)
+	{
+		for (int x = x0; x <= x1; x++)
+			for (int y = y0; y <= y1; y++)
+				for (int z = z0; z <= z1; z++)
+					buckets[num_buckets++] = ObjGridHash(x, y, z);
+
+		// Different cells can share a bucket
+		std::sort(buckets, buckets + num_buckets);
+		num_buckets = std::unique(buckets, buckets + num_buckets) - buckets;
+	}
+
+	const int num_scan = scan_all ? OBJ_GRID_BUCKETS : num_buckets;
+
+	for (i = 0; i < num_scan; i++)
+	{
+		const int bucket = scan_all ? i : buckets[i];
+
+		for (int objnum = Obj_grid_head[bucket]; objnum != -1; objnum = Obj_grid_next[objnum])
+		{
+			const vector *pos = &Objects[objnum].pos;
+
+			if (pos->x >= lo.x && pos->x <= hi.x &&
+				 pos->y >= lo.y && pos->y <= hi.y &&
+				 pos->z >= lo.z && pos->z <= hi.z)
+			{
+				found[num_found++] = objnum;
+			}
+		}
+	}
+
+	for (int objnum = Obj_grid_head[OBJ_GRID_LARGE]; objnum != -1; objnum = Obj_grid_next[objnum])
+		found[num_found++] = objnum;
+
+	std::sort(found, found + num_found);
+
+	if (num_found > max_elements)
+		num_found = max_elements;
+
+	memcpy(list, found, num_found * sizeof(short));
+
+	return num_found;
+}
+
+// Same as above for the box around a sphere
+int ObjGridQuerySphere(const vector *pos, float rad, short *list, int max_elements)
+{
+	vector min_xyz, max_xyz;
+
+	min_xyz.x = pos->x - rad; min_xyz.y = pos->y - rad; min_xyz.z = pos->z - rad;
+	max_xyz.x = pos->x + rad; max_xyz.y = pos->y + rad; max_xyz.z = pos->z + rad;
+
+	return ObjGridQueryBox(&min_xyz, &max_xyz, list, max_elements);
+}
@@ -0,0 +1,60 @@
+/*
+* Descent 3
+* Copyright (C) 2024 Parallax Software
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _OBJGRID_H
+#define _OBJGRID_H
+
+#include "vecmat.h"
+
+// A uniform grid over the positions of every linked object, mine and terrain alike, so area
+// queries don't have to scan the whole object list.  Objects are added by ObjLink(), moved by
+// ObjSetAABB() and removed by ObjUnlink().  Objects that reach more than OBJ_GRID_MAX_EXTENT
+// from their position (by size, bounding box or wall sphere) are kept on a separate list that
+// every query returns.
+
+#define OBJ_GRID_CELL_SIZE		32.0f
+#define OBJ_GRID_MAX_EXTENT	32.0f
+
+// Clears the grid.  Called when the object lists are reset.
+void ObjGridInit(void);
+
+// Adds an object that was just linked into a room or terrain cell
+void ObjGridLink(int objnum);
+
+// Removes an object that is being unlinked
+void ObjGridUnlink(int objnum);
+
+// Moves an object to the cell for its current position and bounding box
+void ObjGridUpdate(int objnum);
+
+// Returns the order objects were linked in.  A room's (or terrain cell's) object list runs from
+// the highest value to the lowest.
+unsigned int ObjGridLinkOrder(int objnum);
+
+// Returns how many grid cells a query of the given box looks at
+int ObjGridQueryCells(const vector *min_xyz, const vector *max_xyz);
+
+// Fills list with every object whose position, size, bounding box or wall sphere could reach
+// into the given box, in object number order.  It can also return objects that don't, so
+// callers still do their own tests.  Returns the number of objects.
+int ObjGridQueryBox(const vector *min_xyz, const vector *max_xyz, short *list, int max_elements);
+
+// Same as above for the box around a sphere
+int ObjGridQuerySphere(const vector *pos, float rad, short *list, int max_elements);
+
+#endif
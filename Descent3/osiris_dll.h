@@ -153,6 +153,33 @@ void Osiris_ResetAllTimers(void);
 //		Cancels a timer thats in use, given it's ID
 void Osiris_CancelTimer(int handle);
 
+//	Osiris_TimerObjectDeleted
+//	Purpose:
+//		Called when an object is deleted, so its timers get removed
+void Osiris_TimerObjectDeleted(int objhandle);
+
+//	Osiris_InitTimers
+//	Purpose:
+//		Sets up the timer system, forgetting all the old handles
+void Osiris_InitTimers(void);
+
+//	Osiris_GetTimerHandle
+//	Purpose:
+//		Gets the handle for the timer with the specified id
+int Osiris_GetTimerHandle(int id);
+
+//	Osiris_CancelTimerID
+//	Purpose:
+//		Cancels a timer given its ID
+void Osiris_CancelTimerID(int id);
+
+//	Osiris_SetTimerEventHook
+//	Purpose:
+//		Sends timer events to hook instead of the scripts that own the timers, or back to the
+//	scripts if hook is NULL
+typedef void (*osiris_timer_hook)(int handle, int event, tOSIRISEventInfo *ei);
+void Osiris_SetTimerEventHook(osiris_timer_hook hook);
+
 //	Osiris_TimerExists
 //	Purpose:
 //		Returns true if the timer is valid
@@ -17,6 +17,7 @@
 */
 
 #include "procedurals.h"
+#include "procedurals_internal.h"
 #include "bitmap.h"
 #include "gr.h"
 #include "gametexture.h"
@@ -30,9 +31,19 @@
 #include <math.h>
 #include <memory.h>
 #include "psrand.h"
+#include "TaskSystem.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PROCEDURALS_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef PROCEDURALS_SSE2
+const char* Proc_kernels = "SSE2";
+#else
+const char* Proc_kernels = "scalar";
+#endif
 
-#define BRIGHT_COLOR	254
-#define PROC_SIZE	128
 #define TABSIZE          256
 #define TABMASK          (TABSIZE-1)
 #define PERM(x)          perm[(x)&TABMASK]
@@ -54,6 +65,17 @@ ubyte WaterProcTableLo[NUM_WATER_SHADES][256];
 char* ProcNames[] = { "None","Line Lightning","Sphere lightning","Straight","Rising Embers","Random Embers","Spinners","Roamers","Fountain","Cone","Fall Right","Fall Left","END" };
 char* WaterProcNames[] = { "None","Height blob","Sine Blob","Random Raindrops","Random Blobdrops","END" };
 static ubyte* ProcDestData;
+
+#define MAX_PROC_BATCH	64
+
+// A texture being evaluated by EvaluateProcedurals()
+struct proc_eval
+{
+	int handle;
+	ushort* dest_data;		// the procedural bitmap
+	ushort* src_data;			// water only, the texture's own bitmap
+	int thickness;				// water only, how fast the waves die out this time
+};
 int pholdrand = 1;
 
 inline int prand()
@@ -132,49 +154,12 @@ float GradNoise(float x, float y)
 	return LERP(wy, vy0, vy1);
 }
 
-extern ubyte EasterEgg;
-int Easter_egg_handle = -1;
-// Goes through our array and clears the slots out
-void InitProcedurals()
+// Builds the tables that shade lit water
+void InitWaterProcTables()
 {
 	int t;
 	int i;
 
-	// Load easter egg bitmap
-	Easter_egg_handle = bm_AllocLoadFileBitmap("FreakyEye.ogf", 0);
-	if (Easter_egg_handle == -1)
-	{
-		mprintf((0, "Failed to load easter egg!\n"));
-	}
-	for (i = 0; i < MAX_PROC_ELEMENTS; i++)
-	{
-		DynamicProcElements[i].type = PROC_NONE;
-		Proc_free_list[i] = i;
-	}
-
-	Num_proc_elements = 0;
-
-	// Init our fade table
-	for (i = 0; i < 32768; i++)
-	{
-		int r = (i >> 10) & 0x1f;
-		int g = (i >> 5) & 0x1f;
-		int b = (i) & 0x1f;
-		r = __max(0, r - 1);
-		g = __max(0, g - 1);
-		b = __max(0, b - 1);
-		ProcFadeTable[i] = OPAQUE_FLAG | (r << 10) | (g << 5) | b;
-	}
-
-	// Init our palette
-	for (i = 0; i < 128; i++)
-	{
-		float fr = (float)i / 127.0;
-		int ib = fr * 31.0;
-		int ig = fr * 16.0;
-		DefaultProcPalette[i] = OPAQUE_FLAG | (ig << 5) | (ib);
-	}
-
 	// Do lower part of table
 	for (i = 0; i < (NUM_WATER_SHADES); i++)
 	{
@@ -236,6 +221,51 @@ void InitProcedurals()
 			}
 		}
 	}
+}
+
+extern ubyte EasterEgg;
+int Easter_egg_handle = -1;
+// Goes through our array and clears the slots out
+void InitProcedurals()
+{
+	int i;
+
+	// Load easter egg bitmap
+	Easter_egg_handle = bm_AllocLoadFileBitmap("FreakyEye.ogf", 0);
+	if (Easter_egg_handle == -1)
+	{
+		mprintf((0, "Failed to load easter egg!\n"));
+	}
+	for (i = 0; i < MAX_PROC_ELEMENTS; i++)
+	{
+		DynamicProcElements[i].type = PROC_NONE;
+		Proc_free_list[i] = i;
+	}
+
+	Num_proc_elements = 0;
+
+	// Init our fade table
+	for (i = 0; i < 32768; i++)
+	{
+		int r = (i >> 10) & 0x1f;
+		int g = (i >> 5) & 0x1f;
+		int b = (i) & 0x1f;
+		r = __max(0, r - 1);
+		g = __max(0, g - 1);
+		b = __max(0, b - 1);
+		ProcFadeTable[i] = OPAQUE_FLAG | (r << 10) | (g << 5) | b;
+	}
+
+	// Init our palette
+	for (i = 0; i < 128; i++)
+	{
+		float fr = (float)i / 127.0;
+		int ib = fr * 31.0;
+		int ig = fr * 16.0;
+		DefaultProcPalette[i] = OPAQUE_FLAG | (ig << 5) | (ib);
+	}
+
+	InitWaterProcTables();
 
 	/*for (i=0;i<NUM_WATER_SHADES;i++)
 	{
@@ -358,15 +388,10 @@ void DrawProceduralLine(int x1, int y1, int x2, int y2, ubyte color)
 	}
 }
 
-// Fades an entire bitmap one step closer to black
-void FadeProcTexture(int tex_handle)
+// Fades a fire buffer by fadeval
+void FadeProcDataScalar(ubyte* src_data, int fadeval)
 {
 	int total = PROC_SIZE * PROC_SIZE;
-	ubyte* src_data = ProcDestData;
-	int fadeval;
-	fadeval = 255 - GameTextures[tex_handle].procedural->heat;
-	fadeval >>= 3;
-	fadeval++;
 
 	for (int i = 0; i < total; i++, src_data++)
 	{
@@ -381,6 +406,46 @@ void FadeProcTexture(int tex_handle)
 	}
 }
 
+#ifdef PROCEDURALS_SSE2
+// Same as above, 16 pixels at a time.  fadeval is never more than 32, so a saturating subtract
+// does the same thing.
+static void FadeProcDataSSE2(ubyte* src_data, int fadeval)
+{
+	__m128i fade = _mm_set1_epi8((char)fadeval);
+
+	for (int i = 0; i < PROC_SIZE * PROC_SIZE; i += 16)
+	{
+		__m128i pix = _mm_loadu_si128((__m128i*)(src_data + i));
+		_mm_storeu_si128((__m128i*)(src_data + i), _mm_subs_epu8(pix, fade));
+	}
+}
+#endif
+
+void FadeProcData(ubyte* src_data, int fadeval)
+{
+#ifdef PROCEDURALS_SSE2
+	FadeProcDataSSE2(src_data, fadeval);
+#else
+	FadeProcDataScalar(src_data, fadeval);
+#endif
+}
+
+// Returns how much a fire texture fades each time it is evaluated
+static int ProcFadeValue(int tex_handle)
+{
+	int fadeval;
+	fadeval = 255 - GameTextures[tex_handle].procedural->heat;
+	fadeval >>= 3;
+	fadeval++;
+	return fadeval;
+}
+
+// Fades an entire bitmap one step closer to black
+void FadeProcTexture(int tex_handle)
+{
+	FadeProcData(ProcDestData, ProcFadeValue(tex_handle));
+}
+
 // Heats an entire bitmap 
 void HeatProcTexture(int tex_handle)
 {
@@ -398,12 +463,10 @@ void HeatProcTexture(int tex_handle)
 	}
 }
 
-// Fades and entire bitmap one step closer to black
-void BlendProcTexture(int tex_handle)
+// Averages each pixel of a fire buffer with its neighbours to the left, right and below
+void BlendProcDataScalar(ubyte* src_data, ubyte* dest_data)
 {
-	int total = PROC_SIZE * PROC_SIZE;
-	ubyte* src_data = (ubyte*)GameTextures[tex_handle].procedural->proc1;
-	ubyte* dest_data = (ubyte*)GameTextures[tex_handle].procedural->proc2;
+	int total;
 	ubyte* start_data = src_data;
 
 	for (int i = 0; i < PROC_SIZE; i++)
@@ -438,6 +501,67 @@ void BlendProcTexture(int tex_handle)
 	}
 }
 
+// Does one pixel of the blend, wrapping at the edges
+static inline ubyte BlendProcPixel(const ubyte* row, const ubyte* downrow, int t)
+{
+	int total = row[t];
+	total += row[(t + 1) & (PROC_SIZE - 1)];
+	total += row[(t - 1) & (PROC_SIZE - 1)];
+	total += downrow[t];
+	return total >> 2;
+}
+
+#ifdef PROCEDURALS_SSE2
+// Same as above, 16 pixels at a time away from the left and right edges
+static void BlendProcDataSSE2(ubyte* src_data, ubyte* dest_data)
+{
+	__m128i zero = _mm_setzero_si128();
+
+	for (int i = 0; i < PROC_SIZE; i++)
+	{
+		const ubyte* row = src_data + i * PROC_SIZE;
+		const ubyte* downrow = src_data + ((i + 1) & (PROC_SIZE - 1)) * PROC_SIZE;
+		ubyte* dest_row = dest_data + i * PROC_SIZE;
+		int t;
+
+		dest_row[0] = BlendProcPixel(row, downrow, 0);
+
+		for (t = 1; t + 16 <= PROC_SIZE - 1; t += 16)
+		{
+			__m128i center = _mm_loadu_si128((__m128i*)(row + t));
+			__m128i right = _mm_loadu_si128((__m128i*)(row + t + 1));
+			__m128i left = _mm_loadu_si128((__m128i*)(row + t - 1));
+			__m128i below = _mm_loadu_si128((__m128i*)(downrow + t));
+
+			__m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(center, zero), _mm_unpacklo_epi8(right, zero)),
+												_mm_add_epi16(_mm_unpacklo_epi8(left, zero), _mm_unpacklo_epi8(below, zero)));
+			__m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(center, zero), _mm_unpackhi_epi8(right, zero)),
+												_mm_add_epi16(_mm_unpackhi_epi8(left, zero), _mm_unpackhi_epi8(below, zero)));
+
+			_mm_storeu_si128((__m128i*)(dest_row + t), _mm_packus_epi16(_mm_srli_epi16(lo, 2), _mm_srli_epi16(hi, 2)));
+		}
+
+		for (; t < PROC_SIZE; t++)
+			dest_row[t] = BlendProcPixel(row, downrow, t);
+	}
+}
+#endif
+
+void BlendProcData(ubyte* src_data, ubyte* dest_data)
+{
+#ifdef PROCEDURALS_SSE2
+	BlendProcDataSSE2(src_data, dest_data);
+#else
+	BlendProcDataScalar(src_data, dest_data);
+#endif
+}
+
+// Blends proc1 of a fire texture into proc2
+void BlendProcTexture(int tex_handle)
+{
+	BlendProcData((ubyte*)GameTextures[tex_handle].procedural->proc1, (ubyte*)GameTextures[tex_handle].procedural->proc2);
+}
+
 // Draws lightning into a bitmap
 void AddProcLightning(int x1, int y1, int x2, int y2, ubyte color, static_proc_element* proc)
 {
@@ -946,35 +1070,12 @@ void DoDynamicFallLeft(int handle, dynamic_proc_element* proc)
 	}
 }
 
-void CalcWater2(int handle, int density)
+// Does the edges of the water height field, where the neighbours wrap around
+static void CalcWater2Edges(short* oldptr, short* newptr, int density)
 {
 	int newh;
-	int count = PROC_SIZE + 1;
-	proc_struct* procedural = GameTextures[handle].procedural;
-
-	short* newptr = (short*)procedural->proc2;
-	short* oldptr = (short*)procedural->proc1;
-
+	int count;
 	int x, y;
-
-	// Do main block
-	for (y = 1; y < (PROC_SIZE - 1); y++, count += 2)
-	{
-		for (x = 1; x < PROC_SIZE - 1; x++, count++)
-		{
-			newh = ((oldptr[count + PROC_SIZE]
-				+ oldptr[count - PROC_SIZE]
-				+ oldptr[count + 1]
-				+ oldptr[count - 1]
-				+ oldptr[count - PROC_SIZE - 1]
-				+ oldptr[count - PROC_SIZE + 1]
-				+ oldptr[count + PROC_SIZE - 1]
-				+ oldptr[count + PROC_SIZE + 1]
-				) >> 2)
-				- newptr[count];
-			newptr[count] = newh - (newh >> density);
-		}
-	}
 	int up, down, left, right;
 	count = 0;
 	for (y = 0; y < PROC_SIZE; y++)
@@ -1022,15 +1123,10 @@ void CalcWater2(int handle, int density)
 	}
 }
 
-void CalcWater(int handle, int density)
+void CalcWater2DataScalar(short* oldptr, short* newptr, int density)
 {
 	int newh;
 	int count = PROC_SIZE + 1;
-	proc_struct* procedural = GameTextures[handle].procedural;
-
-	short* newptr = (short*)procedural->proc2;
-	short* oldptr = (short*)procedural->proc1;
-
 	int x, y;
 
 	// Do main block
@@ -1042,11 +1138,23 @@ void CalcWater(int handle, int density)
 				+ oldptr[count - PROC_SIZE]
 				+ oldptr[count + 1]
 				+ oldptr[count - 1]
-				) >> 1)
+				+ oldptr[count - PROC_SIZE - 1]
+				+ oldptr[count - PROC_SIZE + 1]
+				+ oldptr[count + PROC_SIZE - 1]
+				+ oldptr[count + PROC_SIZE + 1]
+				) >> 2)
 				- newptr[count];
 			newptr[count] = newh - (newh >> density);
 		}
 	}
+	CalcWater2Edges(oldptr, newptr, density);
+}
+
+static void CalcWaterEdges(short* oldptr, short* newptr, int density)
+{
+	int newh;
+	int count;
+	int x, y;
 	int up, down, left, right;
 	count = 0;
 	for (y = 0; y < PROC_SIZE; y++)
@@ -1090,16 +1198,187 @@ void CalcWater(int handle, int density)
 	}
 }
 
-void DrawWaterNoLight(int handle)
+void CalcWaterDataScalar(short* oldptr, short* newptr, int density)
+{
+	int newh;
+	int count = PROC_SIZE + 1;
+	int x, y;
+
+	// Do main block
+	for (y = 1; y < (PROC_SIZE - 1); y++, count += 2)
+	{
+		for (x = 1; x < PROC_SIZE - 1; x++, count++)
+		{
+			newh = ((oldptr[count + PROC_SIZE]
+				+ oldptr[count - PROC_SIZE]
+				+ oldptr[count + 1]
+				+ oldptr[count - 1]
+				) >> 1)
+				- newptr[count];
+			newptr[count] = newh - (newh >> density);
+		}
+	}
+	CalcWaterEdges(oldptr, newptr, density);
+}
+
+#ifdef PROCEDURALS_SSE2
+// Sign extends the low or high four shorts of v to ints
+#define WATER_LO32(v) _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16)
+#define WATER_HI32(v) _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16)
+
+// Finishes four heights the way the scalar code does, returning them truncated to shorts but
+// still sign extended, so packing them can't saturate
+static inline __m128i WaterDampen(__m128i sum, __m128i old_new, __m128i density)
+{
+	__m128i newh = _mm_sub_epi32(sum, old_new);
+	newh = _mm_sub_epi32(newh, _mm_sra_epi32(newh, density));
+	return _mm_srai_epi32(_mm_slli_epi32(newh, 16), 16);
+}
+
+// Interior of CalcWater2, eight heights at a time.  The sums don't fit in shorts, so the math is
+// done on ints.
+static void CalcWater2DataSSE2(short* oldptr, short* newptr, int density)
+{
+	__m128i shift = _mm_cvtsi32_si128(density);
+
+	for (int y = 1; y < PROC_SIZE - 1; y++)
+	{
+		int x;
+
+		for (x = 1; x + 8 <= PROC_SIZE - 1; x += 8)
+		{
+			int count = y * PROC_SIZE + x;
+			__m128i n[8];
+
+			n[0] = _mm_loadu_si128((__m128i*)(oldptr + count + PROC_SIZE));
+			n[1] = _mm_loadu_si128((__m128i*)(oldptr + count - PROC_SIZE));
+			n[2] = _mm_loadu_si128((__m128i*)(oldptr + count + 1));
+			n[3] = _mm_loadu_si128((__m128i*)(oldptr + count - 1));
+			n[4] = _mm_loadu_si128((__m128i*)(oldptr + count - PROC_SIZE - 1));
+			n[5] = _mm_loadu_si128((__m128i*)(oldptr + count - PROC_SIZE + 1));
+			n[6] = _mm_loadu_si128((__m128i*)(oldptr + count + PROC_SIZE - 1));
+			n[7] = _mm_loadu_si128((__m128i*)(oldptr + count + PROC_SIZE + 1));
+
+			__m128i lo = WATER_LO32(n[0]);
+			__m128i hi = WATER_HI32(n[0]);
+
+			for (int i = 1; i < 8; i++)
+			{
+				lo = _mm_add_epi32(lo, WATER_LO32(n[i]));
+				hi = _mm_add_epi32(hi, WATER_HI32(n[i]));
+			}
+
+			__m128i cur = _mm_loadu_si128((__m128i*)(newptr + count));
+			lo = WaterDampen(_mm_srai_epi32(lo, 2), WATER_LO32(cur), shift);
+			hi = WaterDampen(_mm_srai_epi32(hi, 2), WATER_HI32(cur), shift);
+			_mm_storeu_si128((__m128i*)(newptr + count), _mm_packs_epi32(lo, hi));
+		}
+
+		for (; x < PROC_SIZE - 1; x++)
+		{
+			int count = y * PROC_SIZE + x;
+			int newh = ((oldptr[count + PROC_SIZE]
+				+ oldptr[count - PROC_SIZE]
+				+ oldptr[count + 1]
+				+ oldptr[count - 1]
+				+ oldptr[count - PROC_SIZE - 1]
+				+ oldptr[count - PROC_SIZE + 1]
+				+ oldptr[count + PROC_SIZE - 1]
+				+ oldptr[count + PROC_SIZE + 1]
+				) >> 2)
+				- newptr[count];
+			newptr[count] = newh - (newh >> density);
+		}
+	}
+
+	CalcWater2Edges(oldptr, newptr, density);
+}
+
+// Interior of CalcWater, eight heights at a time
+static void CalcWaterDataSSE2(short* oldptr, short* newptr, int density)
+{
+	__m128i shift = _mm_cvtsi32_si128(density);
+
+	for (int y = 1; y < PROC_SIZE - 1; y++)
+	{
+		int x;
+
+		for (x = 1; x + 8 <= PROC_SIZE - 1; x += 8)
+		{
+			int count = y * PROC_SIZE + x;
+			__m128i down = _mm_loadu_si128((__m128i*)(oldptr + count + PROC_SIZE));
+			__m128i up = _mm_loadu_si128((__m128i*)(oldptr + count - PROC_SIZE));
+			__m128i right = _mm_loadu_si128((__m128i*)(oldptr + count + 1));
+			__m128i left = _mm_loadu_si128((__m128i*)(oldptr + count - 1));
+			__m128i cur = _mm_loadu_si128((__m128i*)(newptr + count));
+
+			__m128i lo = _mm_add_epi32(_mm_add_epi32(WATER_LO32(down), WATER_LO32(up)), _mm_add_epi32(WATER_LO32(right), WATER_LO32(left)));
+			__m128i hi = _mm_add_epi32(_mm_add_epi32(WATER_HI32(down), WATER_HI32(up)), _mm_add_epi32(WATER_HI32(right), WATER_HI32(left)));
+
+			lo = WaterDampen(_mm_srai_epi32(lo, 1), WATER_LO32(cur), shift);
+			hi = WaterDampen(_mm_srai_epi32(hi, 1), WATER_HI32(cur), shift);
+			_mm_storeu_si128((__m128i*)(newptr + count), _mm_packs_epi32(lo, hi));
+		}
+
+		for (; x < PROC_SIZE - 1; x++)
+		{
+			int count = y * PROC_SIZE + x;
+			int newh = ((oldptr[count + PROC_SIZE]
+				+ oldptr[count - PROC_SIZE]
+				+ oldptr[count + 1]
+				+ oldptr[count - 1]
+				) >> 1)
+				- newptr[count];
+			newptr[count] = newh - (newh >> density);
+		}
+	}
+
+	CalcWaterEdges(oldptr, newptr, density);
+}
+#endif
+
+// The SIMD shifts don't wrap the count like the scalar ones do, so odd densities use the scalar code
+void CalcWater2Data(short* oldptr, short* newptr, int density)
+{
+#ifdef PROCEDURALS_SSE2
+	if (density >= 0 && density < 32)
+	{
+		CalcWater2DataSSE2(oldptr, newptr, density);
+		return;
+	}
+#endif
+	CalcWater2DataScalar(oldptr, newptr, density);
+}
+
+void CalcWaterData(short* oldptr, short* newptr, int density)
+{
+#ifdef PROCEDURALS_SSE2
+	if (density >= 0 && density < 32)
+	{
+		CalcWaterDataSSE2(oldptr, newptr, density);
+		return;
+	}
+#endif
+	CalcWaterDataScalar(oldptr, newptr, density);
+}
+
+void CalcWater2(int handle, int density)
+{
+	proc_struct* procedural = GameTextures[handle].procedural;
+	CalcWater2Data((short*)procedural->proc1, (short*)procedural->proc2, density);
+}
+
+void CalcWater(int handle, int density)
+{
+	proc_struct* procedural = GameTextures[handle].procedural;
+	CalcWaterData((short*)procedural->proc1, (short*)procedural->proc2, density);
+}
+
+static void DrawWaterNoLightData(short* ptr, ushort* src_data, ushort* dest_data)
 {
 	int dx, dy;
 	int x, y;
 	int offset = 0;
-	proc_struct* procedural = GameTextures[handle].procedural;
-	int dest_bitmap = procedural->procedural_bitmap;
-	ushort* dest_data = (ushort*)bm_data(dest_bitmap, 0);
-	ushort* src_data = (ushort*)bm_data(GameTextures[handle].bm_handle, 0);
-	short* ptr = (short*)procedural->proc1;
 	for (y = 0; y < PROC_SIZE; y++)
 	{
 		for (x = 0; x < PROC_SIZE; x++, offset++)
@@ -1125,66 +1404,170 @@ void DrawWaterNoLight(int handle)
 	}
 }
 
-void DrawWaterWithLight(int handle, int lightval)
+void DrawWaterNoLight(int handle)
+{
+	proc_struct* procedural = GameTextures[handle].procedural;
+	DrawWaterNoLightData((short*)procedural->proc1, (ushort*)bm_data(GameTextures[handle].bm_handle, 0), (ushort*)bm_data(procedural->procedural_bitmap, 0));
+}
+
+// Gets the offsets of the pixels above and below the ones in row y
+static inline void WaterRowChange(int y, int* ychange, int* ychange2)
+{
+	if (y == PROC_SIZE - 1)
+	{
+		*ychange = PROC_SIZE;
+		*ychange2 = ((PROC_SIZE - 1) * PROC_SIZE);
+	}
+	else if (y == 0)
+	{
+		*ychange = -((PROC_SIZE - 1) * PROC_SIZE);
+		*ychange2 = -PROC_SIZE;
+	}
+	else
+	{
+		*ychange = PROC_SIZE;
+		*ychange2 = -PROC_SIZE;
+	}
+}
+
+// Shades one pixel of lit water
+static inline ushort WaterLitPixel(short* ptr, ushort* src_data, int offset, int x, int y, int ychange, int ychange2, int lightval)
 {
 	int dx, dy;
-	int x, y;
 	ushort c;
+
+	if (x == PROC_SIZE - 1)
+		dx = ptr[offset - 1] - ptr[offset - (PROC_SIZE - 1)];
+	else if (x == 0)
+		dx = ptr[offset + (PROC_SIZE - 1)] - ptr[offset + 1];
+	else
+		dx = ptr[offset - 1] - ptr[offset + 1];
+	dy = ptr[offset - ychange] - ptr[offset - ychange2];
+
+	int yoffset = (y + (dy >> 3));
+	int xoffset = (x + (dx >> 3));
+	yoffset &= (PROC_SIZE - 1);
+	xoffset &= (PROC_SIZE - 1);
+	c = src_data[yoffset * PROC_SIZE + xoffset];
+	int l = (NUM_WATER_SHADES / 2) - (dx >> lightval);
+	if (l > (NUM_WATER_SHADES - 1))
+		l = NUM_WATER_SHADES - 1;
+	if (l < 0)
+		l = 0;
+	c &= ~OPAQUE_FLAG;
+
+	return WaterProcTableHi[l][c >> 8] + WaterProcTableLo[l][c & 0xFF];
+}
+
+void DrawWaterWithLightDataScalar(short* ptr, ushort* src_data, ushort* dest_data, int lightval)
+{
 	int offset = 0;
-	proc_struct* procedural = GameTextures[handle].procedural;
-	int dest_bitmap = procedural->procedural_bitmap;
-	ushort* dest_data = (ushort*)bm_data(dest_bitmap, 0);
-	ushort* src_data = (ushort*)bm_data(GameTextures[handle].bm_handle, 0);
-	short* ptr = (short*)procedural->proc1;
-	for (y = 0; y < PROC_SIZE; y++)
+
+	for (int y = 0; y < PROC_SIZE; y++)
 	{
 		int ychange, ychange2;
-		if (y == PROC_SIZE - 1)
-		{
-			ychange = PROC_SIZE;
-			ychange2 = ((PROC_SIZE - 1) * PROC_SIZE);
-		}
-		else if (y == 0)
-		{
-			ychange = -((PROC_SIZE - 1) * PROC_SIZE);
-			ychange2 = -PROC_SIZE;
-		}
-		else
-		{
-			ychange = PROC_SIZE;
-			ychange2 = -PROC_SIZE;
-		}
+		WaterRowChange(y, &ychange, &ychange2);
 
-		for (x = 0; x < PROC_SIZE; x++, offset++)
+		for (int x = 0; x < PROC_SIZE; x++, offset++)
+			dest_data[offset] = WaterLitPixel(ptr, src_data, offset, x, y, ychange, ychange2, lightval);
+	}
+}
+
+#ifdef PROCEDURALS_SSE2
+// Works out the source pixel and shade for eight pixels at a time away from the left and right
+// edges, then looks them up
+static void DrawWaterWithLightDataSSE2(short* ptr, ushort* src_data, ushort* dest_data, int lightval)
+{
+	__m128i shift = _mm_cvtsi32_si128(lightval);
+	__m128i half_shades = _mm_set1_epi32(NUM_WATER_SHADES / 2);
+	__m128i max_shade = _mm_set1_epi16(NUM_WATER_SHADES - 1);
+	__m128i mask = _mm_set1_epi32(PROC_SIZE - 1);
+	__m128i zero = _mm_setzero_si128();
+	__m128i xstep = _mm_set1_epi32(4);
+	short src_offsets[8], shades[8];
+
+	for (int y = 0; y < PROC_SIZE; y++)
+	{
+		int ychange, ychange2;
+		int offset = y * PROC_SIZE;
+		int x;
+
+		WaterRowChange(y, &ychange, &ychange2);
+
+		__m128i yvec = _mm_set1_epi32(y);
+
+		dest_data[offset] = WaterLitPixel(ptr, src_data, offset, 0, y, ychange, ychange2, lightval);
+
+		for (x = 1; x + 8 <= PROC_SIZE - 1; x += 8)
 		{
-			if (x == PROC_SIZE - 1)
-				dx = ptr[offset - 1] - ptr[offset - (PROC_SIZE - 1)];
-			else if (x == 0)
-				dx = ptr[offset + (PROC_SIZE - 1)] - ptr[offset + 1];
-			else
-				dx = ptr[offset - 1] - ptr[offset + 1];
-			dy = ptr[offset - ychange] - ptr[offset - ychange2];
-
-			int yoffset = (y + (dy >> 3));
-			int xoffset = (x + (dx >> 3));
-			yoffset &= (PROC_SIZE - 1);
-			xoffset &= (PROC_SIZE - 1);
-			ASSERT(yoffset >= 0);
-			ASSERT(xoffset >= 0);
-			c = src_data[yoffset * PROC_SIZE + xoffset];
-			int l = (NUM_WATER_SHADES / 2) - (dx >> lightval);
-			if (l > (NUM_WATER_SHADES - 1))
-				l = NUM_WATER_SHADES - 1;
-			if (l < 0)
-				l = 0;
-			c &= ~OPAQUE_FLAG;
-
-			c = WaterProcTableHi[l][c >> 8] + WaterProcTableLo[l][c & 0xFF];
-
-			dest_data[offset] = c;
+			int o = offset + x;
+			__m128i left = _mm_loadu_si128((__m128i*)(ptr + o - 1));
+			__m128i right = _mm_loadu_si128((__m128i*)(ptr + o + 1));
+			__m128i up = _mm_loadu_si128((__m128i*)(ptr + o - ychange));
+			__m128i down = _mm_loadu_si128((__m128i*)(ptr + o - ychange2));
+			__m128i xvec = _mm_setr_epi32(x, x + 1, x + 2, x + 3);
+			__m128i index[2], shade[2];
+
+			for (int half = 0; half < 2; half++)
+			{
+				__m128i dx, dy;
+
+				if (half == 0)
+				{
+					dx = _mm_sub_epi32(WATER_LO32(left), WATER_LO32(right));
+					dy = _mm_sub_epi32(WATER_LO32(up), WATER_LO32(down));
+				}
+				else
+				{
+					dx = _mm_sub_epi32(WATER_HI32(left), WATER_HI32(right));
+					dy = _mm_sub_epi32(WATER_HI32(up), WATER_HI32(down));
+				}
+
+				__m128i xoffset = _mm_and_si128(_mm_add_epi32(xvec, _mm_srai_epi32(dx, 3)), mask);
+				__m128i yoffset = _mm_and_si128(_mm_add_epi32(yvec, _mm_srai_epi32(dy, 3)), mask);
+				index[half] = _mm_or_si128(_mm_slli_epi32(yoffset, 7), xoffset);		// yoffset * PROC_SIZE + xoffset
+				shade[half] = _mm_sub_epi32(half_shades, _mm_sra_epi32(dx, shift));
+
+				xvec = _mm_add_epi32(xvec, xstep);
+			}
+
+			// Saturating to shorts doesn't change where the shade gets clamped to
+			__m128i l = _mm_packs_epi32(shade[0], shade[1]);
+			l = _mm_min_epi16(_mm_max_epi16(l, zero), max_shade);
+
+			_mm_storeu_si128((__m128i*)src_offsets, _mm_packs_epi32(index[0], index[1]));
+			_mm_storeu_si128((__m128i*)shades, l);
+
+			for (int i = 0; i < 8; i++)
+			{
+				ushort c = src_data[src_offsets[i]] & ~OPAQUE_FLAG;
+				dest_data[o + i] = WaterProcTableHi[shades[i]][c >> 8] + WaterProcTableLo[shades[i]][c & 0xFF];
+			}
 		}
+
+		for (; x < PROC_SIZE; x++)
+			dest_data[offset + x] = WaterLitPixel(ptr, src_data, offset + x, x, y, ychange, ychange2, lightval);
 	}
 }
+#endif
+
+void DrawWaterWithLightData(short* ptr, ushort* src_data, ushort* dest_data, int lightval)
+{
+#ifdef PROCEDURALS_SSE2
+	if (lightval >= 0 && lightval < 32)
+	{
+		DrawWaterWithLightDataSSE2(ptr, src_data, dest_data, lightval);
+		return;
+	}
+#endif
+	DrawWaterWithLightDataScalar(ptr, src_data, dest_data, lightval);
+}
+
+void DrawWaterWithLight(int handle, int lightval)
+{
+	proc_struct* procedural = GameTextures[handle].procedural;
+	DrawWaterWithLightData((short*)procedural->proc1, (ushort*)bm_data(GameTextures[handle].bm_handle, 0), (ushort*)bm_data(procedural->procedural_bitmap, 0), lightval);
+}
 
 void AddProcHeightBlob(static_proc_element* proc, int handle)
 {
@@ -1323,14 +1706,13 @@ void AllocateMemoryForWaterProcedural(int handle)
 	procedural->memory_type = PROC_MEMORY_TYPE_WATER;
 }
 
-// Does a water effect for this texture
-void EvaluateWaterProcedural(int handle)
+// Adds this frame's water elements and works out how thick the water is.  The elements use the
+// shared random numbers, so this has to be done on the main thread in evaluation order.
+static void StartWaterProcedural(proc_eval* ev)
 {
+	int handle = ev->handle;
 	proc_struct* procedural = GameTextures[handle].procedural;
-	if (procedural->memory_type != PROC_MEMORY_TYPE_WATER)
-		AllocateMemoryForWaterProcedural(handle);
 
-	int dest_bitmap = procedural->procedural_bitmap;
 	for (int i = 0; i < procedural->num_static_elements; i++)
 	{
 		static_proc_element* proc = &procedural->static_proc_elements[i];
@@ -1381,11 +1763,6 @@ void EvaluateWaterProcedural(int handle)
 		EasterEgg = 0;
 	}
 
-	// Calculate the water on the current texture
-	if (!procedural->light)
-		DrawWaterNoLight(handle);
-	else
-		DrawWaterWithLight(handle, procedural->light - 1);
 	int thickness = procedural->thickness;
 	if (procedural->osc_time > 0)
 	{
@@ -1415,7 +1792,22 @@ void EvaluateWaterProcedural(int handle)
 		}
 	}
 
-	CalcWater(handle, thickness);
+	ev->thickness = thickness;
+}
+
+// Draws the water and moves the waves along.  Only touches this texture, so it can be done on a
+// worker thread.
+static void FinishWaterProcedural(proc_eval* ev)
+{
+	proc_struct* procedural = GameTextures[ev->handle].procedural;
+
+	// Calculate the water on the current texture
+	if (!procedural->light)
+		DrawWaterNoLightData((short*)procedural->proc1, ev->src_data, ev->dest_data);
+	else
+		DrawWaterWithLightData((short*)procedural->proc1, ev->src_data, ev->dest_data, procedural->light - 1);
+
+	CalcWaterData((short*)procedural->proc1, (short*)procedural->proc2, ev->thickness);
 	// Swap for next time
 	short* temp = (short*)procedural->proc1;
 	procedural->proc1 = procedural->proc2;
@@ -1441,18 +1833,21 @@ void AllocateMemoryForFireProcedural(int handle)
 	procedural->memory_type = PROC_MEMORY_TYPE_FIRE;
 }
 
-void EvaluateFireProcedural(int handle)
+// Fades the current texture.  Can be done on a worker thread.
+static void FadeFireProcedural(proc_eval* ev)
 {
+	FadeProcData((ubyte*)GameTextures[ev->handle].procedural->proc1, ProcFadeValue(ev->handle));
+	//HeatProcTexture (handle);
+}
+
+// Draws this frame's fire elements.  They use the shared random numbers and element list, so this
+// has to be done on the main thread in evaluation order.
+static void StartFireProcedural(proc_eval* ev)
+{
+	int handle = ev->handle;
 	proc_struct* procedural = GameTextures[handle].procedural;
 
-	int dest_bitmap = procedural->procedural_bitmap;
-	if (procedural->memory_type != PROC_MEMORY_TYPE_FIRE)
-		AllocateMemoryForFireProcedural(handle);
-	
 	ProcDestData = (ubyte*)procedural->proc1;
-	// fade and the current texture
-	FadeProcTexture(handle);
-	//HeatProcTexture (handle);
 	// Do the static procedurals first
 	
 	for (int i = 0; i < procedural->num_static_elements; i++)
@@ -1531,16 +1926,22 @@ void EvaluateFireProcedural(int handle)
 		}
 		proc_num = DynamicProcElements[proc_num].next;
 	}
+}
+
+// Blends the texture and draws it into the bitmap.  Can be done on a worker thread.
+static void FinishFireProcedural(proc_eval* ev)
+{
+	proc_struct* procedural = GameTextures[ev->handle].procedural;
 
 	// blend the current texture
-	BlendProcTexture(handle);
-	ProcDestData = (ubyte*)procedural->proc2;
+	BlendProcData((ubyte*)procedural->proc1, (ubyte*)procedural->proc2);
+	ubyte* src = (ubyte*)procedural->proc2;
 	int total = PROC_SIZE * PROC_SIZE;
-	ushort* data = bm_data(dest_bitmap, 0);
+	ushort* data = ev->dest_data;
 	ushort* pal = procedural->palette;
-	for (int i = 0; i < total; i++, data++, ProcDestData++)
+	for (int i = 0; i < total; i++, data++, src++)
 	{
-		*data = pal[*ProcDestData];
+		*data = pal[*src];
 	}
 
 	// Swap for next time
@@ -1549,8 +1950,9 @@ void EvaluateFireProcedural(int handle)
 	procedural->proc2 = temp;
 }
 
-// Does a procedural for this texture
-void EvaluateProcedural(int handle)
+// Gets a texture ready to evaluate, allocating its buffers and paging in its bitmaps.  Returns
+// false if it can't be evaluated.
+static bool SetupProcEval(int handle, proc_eval* ev)
 {
 	proc_struct* procedural = GameTextures[handle].procedural;
 
@@ -1558,11 +1960,85 @@ void EvaluateProcedural(int handle)
 	if (bm_w(dest_bitmap, 0) != PROC_SIZE)
 	{
 		mprintf((0, "Couldn't evaluate procedural because its not %d x %d!\n", PROC_SIZE, PROC_SIZE));
-		return;
+		return false;
 	}
 
+	ev->handle = handle;
+	ev->dest_data = bm_data(dest_bitmap, 0);
+	ev->src_data = NULL;
+	ev->thickness = 0;
+
 	if (GameTextures[handle].flags & TF_WATER_PROCEDURAL)
-		EvaluateWaterProcedural(handle);
+	{
+		if (procedural->memory_type != PROC_MEMORY_TYPE_WATER)
+			AllocateMemoryForWaterProcedural(handle);
+		ev->src_data = bm_data(GameTextures[handle].bm_handle, 0);
+	}
 	else
-		EvaluateFireProcedural(handle);
+	{
+		if (procedural->memory_type != PROC_MEMORY_TYPE_FIRE)
+			AllocateMemoryForFireProcedural(handle);
+	}
+
+	return true;
+}
+
+static void FadeProcWorker(int index, void* parm)
+{
+	proc_eval* ev = &((proc_eval*)parm)[index];
+
+	if (!(GameTextures[ev->handle].flags & TF_WATER_PROCEDURAL))
+		FadeFireProcedural(ev);
+}
+
+static void FinishProcWorker(int index, void* parm)
+{
+	proc_eval* ev = &((proc_eval*)parm)[index];
+
+	if (GameTextures[ev->handle].flags & TF_WATER_PROCEDURAL)
+		FinishWaterProcedural(ev);
+	else
+		FinishFireProcedural(ev);
+}
+
+// Does the procedurals for a list of textures.  The per pixel work is spread across the worker
+// pool, and the elements are added in list order, so the results are the same as evaluating the
+// textures one at a time.  A texture can only be in the list once.
+void EvaluateProcedurals(const int* handles, int num)
+{
+	static proc_eval evals[MAX_PROC_BATCH];
+
+	while (num > 0)
+	{
+		int batch = (num < MAX_PROC_BATCH) ? num : MAX_PROC_BATCH;
+		int n = 0;
+		int i;
+
+		for (i = 0; i < batch; i++)
+		{
+			if (SetupProcEval(handles[i], &evals[n]))
+				n++;
+		}
+
+		handles += batch;
+		num -= batch;
+
+		task_ParallelFor(n, FadeProcWorker, evals);
+
+		for (i = 0; i < n; i++)
+		{
+			if (GameTextures[evals[i].handle].flags & TF_WATER_PROCEDURAL)
+				StartWaterProcedural(&evals[i]);
+			else
+				StartFireProcedural(&evals[i]);
+		}
+
+		task_ParallelFor(n, FinishProcWorker, evals);
+	}
+}
+
+// Does a procedural for this texture
+void EvaluateProcedural(int handle)
+{
+	EvaluateProcedurals(&handle, 1);
 }
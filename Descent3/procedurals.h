@@ -88,6 +88,11 @@ void ClearAllProceduralsFromTexture (int texnum);
 // Does a procedural for this texture
 void EvaluateProcedural (int texnum);
 
+// Does the procedurals for a list of textures, spreading the work across the worker pool.  The
+// results are the same as calling EvaluateProcedural() on each in order.  A texture can only be
+// in the list once.
+void EvaluateProcedurals (const int *handles,int num);
+
 // Returns the next free procelement
 int ProcElementAllocate ();
 
@@ -0,0 +1,55 @@
+/*
+* Descent 3
+* Copyright (C) 2024 Parallax Software
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROCEDURALS_INTERNAL_H
+#define PROCEDURALS_INTERNAL_H
+
+// The per-buffer kernels that water and fire procedurals are built from.  The game only goes
+// through procedurals.h; this is for the code that tests them.  Each kernel has a scalar version
+// and one that uses the fastest code we have, and the two give the same results bit for bit.
+
+#include "pstypes.h"
+
+#define BRIGHT_COLOR	254
+#define PROC_SIZE	128			// Procedural buffers are PROC_SIZE by PROC_SIZE
+
+// Builds the tables that shade lit water
+void InitWaterProcTables();
+
+// Fades a fire buffer by fadeval
+void FadeProcDataScalar(ubyte *src_data,int fadeval);
+void FadeProcData(ubyte *src_data,int fadeval);
+
+// Averages each pixel of a fire buffer with its neighbours to the left, right and below
+void BlendProcDataScalar(ubyte *src_data,ubyte *dest_data);
+void BlendProcData(ubyte *src_data,ubyte *dest_data);
+
+// Moves the waves of a water height field on a frame
+void CalcWaterDataScalar(short *oldptr,short *newptr,int density);
+void CalcWaterData(short *oldptr,short *newptr,int density);
+void CalcWater2DataScalar(short *oldptr,short *newptr,int density);
+void CalcWater2Data(short *oldptr,short *newptr,int density);
+
+// Draws a texture through a water height field, shaded by the slope of the waves
+void DrawWaterWithLightDataScalar(short *ptr,ushort *src_data,ushort *dest_data,int lightval);
+void DrawWaterWithLightData(short *ptr,ushort *src_data,ushort *dest_data,int lightval);
+
+// Name of the kernels the fast versions were built with, "SSE2" or "scalar"
+extern const char *Proc_kernels;
+
+#endif
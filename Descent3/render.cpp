@@ -532,6 +532,7 @@ void MakePointsFromMinMax(vector* corners, vector* minp, vector* maxp)
 // Rotates all the points in a room
 void RotateRoomPoints(room* rp, vector* world_vecs)
 {
+	static vector deformed_vecs[MAX_VERTS_PER_ROOM];
 	int i;
 	// Jig the vertices a bit if being deformed
 	if (Viewer_object->effect_info && (Viewer_object->effect_info->type_flags & EF_DEFORM))
@@ -543,18 +544,14 @@ void RotateRoomPoints(room* rp, vector* world_vecs)
 			val *= Viewer_object->effect_info->deform_time;
 			vec += Global_alter_vec * (Viewer_object->effect_info->deform_range * val);
 
-			g3_RotatePoint(&World_point_buffer[rp->wpb_index + i], &vec);
-			g3_ProjectPoint(&World_point_buffer[rp->wpb_index + i]);
-		}
-	}
-	else
-	{
-		for (i = 0; i < rp->num_verts; i++)
-		{
-			g3_RotatePoint(&World_point_buffer[rp->wpb_index + i], &world_vecs[i]);
-			g3_ProjectPoint(&World_point_buffer[rp->wpb_index + i]);
+			deformed_vecs[i] = vec;
 		}
+		world_vecs = deformed_vecs;
 	}
+
+	// The portal checks need every point projected straight away
+	g3_RotatePointArray(&World_point_buffer[rp->wpb_index], world_vecs, rp->num_verts);
+	g3_ProjectPointArray(&World_point_buffer[rp->wpb_index], rp->num_verts);
 }
 
 // Given a vector, reflects that vector off of a mirror vector
@@ -3920,6 +3917,33 @@ void RenderRoomOutline(room* rp)
 	}
 }
 
+// Evaluates the procedural textures on the faces about to be rendered all at once, so the work
+// can be spread across the worker pool.  Faces are visited in the order they will be drawn.
+static void EvaluateVisibleProcedurals()
+{
+	for (int nn = N_render_rooms - 1; nn >= 0; nn--)
+	{
+		int roomnum = Render_list[nn];
+		if (roomnum == -1)
+			continue;
+
+		room* rp = &Rooms[roomnum];
+		face* fp = &rp->faces[0];
+		for (int i = 0; i < rp->num_faces; i++, fp++)
+		{
+			if (!(fp->flags & FF_VISIBLE) || !FaceIsRenderable(rp, fp))
+				continue;
+
+			if ((fp->flags & FF_DESTROYED) && (GameTextures[fp->tmap].flags & TF_DESTROYABLE))
+				QueueProceduralTexture(GameTextures[fp->tmap].destroy_handle);
+			else
+				QueueProceduralTexture(fp->tmap);
+		}
+	}
+
+	EvaluateQueuedProcedurals();
+}
+
 //Draws the mine, starting at a the specified room
 //The rendering surface must be set up, and g3_StartFrame() must have been called
 //Parameters:	viewer_roomnum - what room the viewer is in
@@ -3989,6 +4013,9 @@ void RenderMine(int viewer_roomnum, int flag_automap, int called_from_terrain)
 			rend_SetZValues(0, 5000);
 	}
 
+	// Get the procedurals done before anything needs them
+	EvaluateVisibleProcedurals();
+
 	// First render mirrored rooms
 	RenderMirrorRooms();
 
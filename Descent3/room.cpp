@@ -313,6 +313,8 @@ void FreeRoom(room* rp)
 		rp->num_bbf_regions = 0;
 	}
 
+	fvi_FreeRoomBVH(ROOMNUM(rp));
+
 	BNode_FreeRoom(rp);
 
 	if (rp->volume_lights)
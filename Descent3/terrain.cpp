@@ -1168,6 +1168,7 @@ void UpdateSingleTerrainLightmap(int which)
 	int i, t;
 
 	GameLightmaps[TerrainLightmaps[which]].flags |= LF_CHANGED;
+	GameLightmaps[TerrainLightmaps[which]].flags &= ~LF_LIMITS;
 
 	int sx = (which % 2) * 128;
 	int sz = (which / 2) * 128;
@@ -2058,6 +2058,8 @@ void RotateTerrainList(int cellcount, bool from_automap)
 {
 	int lod, simplemul, edgecount;
 	int i, n[200], t, k, cx, cz;
+	g3Point* code_list[256];
+	int num_code = 0;
 	vector camlight = Terrain_sky.lightsource;
 	vm_NormalizeVector(&camlight);
 	// Reset all modified y values for the corners of each cell
@@ -2125,10 +2127,19 @@ void RotateTerrainList(int cellcount, bool from_automap)
 					World_point_buffer[n[k]].p3_vec += jitterVec;
 					World_point_buffer[n[k]].p3_vecPreRot += jitterVec;
 				}
-				g3_CodePoint(&World_point_buffer[n[k]]);
+
+				// Code the points in batches
+				code_list[num_code++] = &World_point_buffer[n[k]];
+				if (num_code == 256)
+				{
+					g3_CodePointList(num_code, code_list);
+					num_code = 0;
+				}
 			}
 		}
 	}
+
+	g3_CodePointList(num_code, code_list);
 }
 
 // Puts a 1 in upperleft,lowerright if those triangles are visible
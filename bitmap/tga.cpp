@@ -29,6 +29,7 @@
 #include <stdlib.h>
 
 ubyte* Tga_file_data = NULL;
+bool Tga_file_data_mapped = false;	//Tga_file_data points into a mapped hog, so don't free it
 int Fake_pos = 0;
 int Bad_tga = 0;
 int Fake_file_size = 0;
@@ -416,14 +417,19 @@ int bm_tga_alloc_file(CFILE* infile, char* name, int format)
 
 		cfseek(infile, savepos, SEEK_SET);
 
-		Tga_file_data = (ubyte*)mem_malloc(numleft);
-		ASSERT(Tga_file_data != NULL);
+		//If the file is in a mapped hog, parse it right where it is
+		Tga_file_data = (ubyte*)cf_GetDataPointer(infile);
+		Tga_file_data_mapped = (Tga_file_data != NULL);
+		if (!Tga_file_data_mapped)
+		{
+			Tga_file_data = (ubyte*)mem_malloc(numleft);
+			ASSERT(Tga_file_data != NULL);
+			cf_ReadBytes((ubyte*)Tga_file_data, numleft, infile);
+		}
 		Fake_pos = 0;
 		Bad_tga = 0;
 		Fake_file_size = numleft;
 
-		cf_ReadBytes((ubyte*)Tga_file_data, numleft, infile);
-
 		read_ok = bm_tga_read_outrage_compressed16(infile, n, num_mips, image_type);
 	}
 
@@ -436,8 +442,10 @@ int bm_tga_alloc_file(CFILE* infile, char* name, int format)
 
 	if (Tga_file_data != NULL)
 	{
-		mem_free(Tga_file_data);
+		if (!Tga_file_data_mapped)
+			mem_free(Tga_file_data);
 		Tga_file_data = NULL;
+		Tga_file_data_mapped = false;
 		cfseek(infile, savepos + Fake_pos, SEEK_SET);
 	}
 
@@ -578,14 +586,19 @@ int bm_page_in_file(int n)
 
 		cfseek(infile, savepos, SEEK_SET);
 
-		Tga_file_data = (ubyte*)mem_malloc(numleft);
-		ASSERT(Tga_file_data != NULL);
+		//If the file is in a mapped hog, parse it right where it is
+		Tga_file_data = (ubyte*)cf_GetDataPointer(infile);
+		Tga_file_data_mapped = (Tga_file_data != NULL);
+		if (!Tga_file_data_mapped)
+		{
+			Tga_file_data = (ubyte*)mem_malloc(numleft);
+			ASSERT(Tga_file_data != NULL);
+			cf_ReadBytes((ubyte*)Tga_file_data, numleft, infile);
+		}
 		Fake_pos = 0;
 		Bad_tga = 0;
 		Fake_file_size = numleft;
 
-		cf_ReadBytes((ubyte*)Tga_file_data, numleft, infile);
-
 		bm_tga_read_outrage_compressed16(infile, n, num_mips, image_type);
 	}
 
@@ -598,8 +611,10 @@ int bm_page_in_file(int n)
 
 	if (Tga_file_data != NULL)
 	{
-		mem_free(Tga_file_data);
+		if (!Tga_file_data_mapped)
+			mem_free(Tga_file_data);
 		Tga_file_data = NULL;
+		Tga_file_data_mapped = false;
 		cfseek(infile, savepos + Fake_pos, SEEK_SET);
 	}
 
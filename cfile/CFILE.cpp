@@ -23,6 +23,8 @@
 #include <errno.h>
 #include <ctype.h>
 #include <stdint.h>
+#include <atomic>
+#include <future>
 #ifndef __LINUX__
 //Non-Linux Build Includes
 #include <io.h>
@@ -37,6 +39,7 @@
 #include "CFILE.H"
 #include "hogfile.h"		//info about library file
 #include "mem.h"
+#include "TaskSystem.h"
 
 //Library structures
 struct library_entry
@@ -46,6 +49,7 @@ struct library_entry
 	int		length;					//length of this file
 	uint	timestamp;				//time and date of file
 	int		flags;					//misc flags
+	int		prefetch_job;			//index into Prefetch_jobs, or -1 if this file isn't being prefetched
 };
 
 struct library 
@@ -56,6 +60,8 @@ struct library
 	library			*next;
 	int				handle;				//indentifier for this lib
 	FILE			*file;				//pointer to file for this lib, if no one using it
+	const ubyte		*map;				//the whole lib file, if it's memory-mapped
+	int				map_length;			//size of the mapping
 };
 
 //entry in extension->path table
@@ -80,6 +86,50 @@ ext_entry extensions[MAX_EXTENSIONS];
 int N_extensions;
 library *Libraries=NULL;
 int lib_handle=0;
+bool Cfile_map_libraries=true;
+
+//Size of the read-ahead buffer for files that aren't memory-mapped.  Reads at least this big skip the buffer.
+#define CF_READ_BUFFER_SIZE	16384
+
+//Counts of the OS-level file operations done for reading
+int Cfile_num_reads=0;
+int Cfile_num_seeks=0;
+int Cfile_bytes_read=0;
+
+//entry in the index of all files in the open libraries
+struct lib_index_entry
+{
+	library			*lib;		//NULL if this slot is empty
+	library_entry	*entry;
+};
+
+//Hash table of every file in every open library, so finding a file doesn't have to search each
+//library in turn.  Rebuilt whenever a library is opened or closed.
+lib_index_entry *Lib_index=NULL;
+int Lib_index_size=0;			//number of slots; always a power of 2
+
+//States of a prefetch job
+#define PFS_WAITING		0		//not started yet
+#define PFS_READING		1		//a worker is reading it
+#define PFS_DONE		2		//data is ready to be used
+#define PFS_TAKEN		3		//opened (or cancelled), so the job has nothing more to do with the data
+
+//A file being read in the background by cf_PrefetchFiles()
+struct prefetch_job
+{
+	std::atomic<int>	state;		//one of the PFS_ values
+	library				*lib;
+	library_entry		*entry;
+	ubyte					*buffer;		//where to read the file to, or NULL if the library is mapped
+};
+
+//Most memory to hold prefetched files in at once
+#define MAX_PREFETCH_BYTES	(64*1024*1024)
+
+prefetch_job *Prefetch_jobs=NULL;
+int Num_prefetch_jobs=0;
+std::future<void> Prefetch_future;
+
 void cf_Close();
 //Structure thrown on disk error
 cfile_error cfe;
@@ -94,6 +144,74 @@ void ThrowCFileError(int type,CFILE *file,char *msg)
 	throw &cfe;
 }
 
+//Case-insensitive hash of a filename, for the library index
+static uint hash_lib_filename(const char *name)
+{
+	uint hash = 2166136261u;
+	while (*name)
+	{
+		hash ^= (ubyte)tolower(*name++);
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+//Rebuilds the library index from the list of open libraries
+static void build_library_index()
+{
+	library *lib;
+	int nfiles = 0, size, i;
+	uint slot;
+	if (Lib_index)
+	{
+		mem_free(Lib_index);
+		Lib_index = NULL;
+		Lib_index_size = 0;
+	}
+	for (lib = Libraries; lib; lib = lib->next)
+		nfiles += lib->nfiles;
+	if (!nfiles)
+		return;
+	//Keep the table no more than half full so probe runs stay short
+	for (size = 16; size < nfiles * 2; size <<= 1)
+		;
+	Lib_index = (lib_index_entry *) mem_malloc(sizeof(lib_index_entry) * size);
+	if (!Lib_index)
+		Error("Out of memory in build_library_index()");
+	memset(Lib_index, 0, sizeof(lib_index_entry) * size);
+	Lib_index_size = size;
+	//Libraries is in search order, and each name is inserted in that order, so the first 
+	//entry found for a name is the one that would have been found by searching the libraries
+	for (lib = Libraries; lib; lib = lib->next)
+	{
+		for (i = 0; i < lib->nfiles; i++)
+		{
+			slot = hash_lib_filename(lib->entries[i].name) & (size - 1);
+			while (Lib_index[slot].lib)
+				slot = (slot + 1) & (size - 1);
+			Lib_index[slot].lib = lib;
+			Lib_index[slot].entry = &lib->entries[i];
+		}
+	}
+}
+
+//Looks up a file in the library index
+//Parameters:	filename - the name of the file, without a path
+//				libhandle - the library to look in, or -1 to use the first library that has the file
+//Returns:		the index entry, or NULL if the file isn't in a library
+static lib_index_entry *find_in_library_index(const char *filename, int libhandle)
+{
+	uint slot, mask = Lib_index_size - 1;
+	if (!Lib_index)
+		return NULL;
+	for (slot = hash_lib_filename(filename) & mask; Lib_index[slot].lib; slot = (slot + 1) & mask)
+	{
+		if (((libhandle == -1) || (Lib_index[slot].lib->handle == libhandle)) && !stricmp(filename, Lib_index[slot].entry->name))
+			return &Lib_index[slot];
+	}
+	return NULL;
+}
+
 //Opens a HOG file.  Future calls to cfopen(), etc. will look in this HOG.
 //Parameters:  libname - the path & filename of the HOG file 
 //NOTE:	libname must be valid for the entire execution of the program.  Therefore, it should either
@@ -151,8 +269,6 @@ int cf_OpenLibrary(const char *libname)
 		mem_free(lib);
 		return 0;
 	}
-	lib->next = Libraries;
-	Libraries = lib;
 	//set data offset of first file
 	offset = header.file_data_offset;
 	//Go to index start
@@ -164,6 +280,8 @@ int cf_OpenLibrary(const char *libname)
 		if (!ReadHogEntry(fp, &entry)) 
 		{
 			fclose(fp);
+			mem_free(lib->entries);
+			mem_free(lib);
 			return 0;
 		}
 		//Make sure files are in order
@@ -174,12 +292,35 @@ int cf_OpenLibrary(const char *libname)
 		lib->entries[i].length = entry.len;
 		lib->entries[i].offset = offset;
 		lib->entries[i].timestamp  = entry.timestamp;
+		lib->entries[i].prefetch_job = -1;
 		offset += lib->entries[i].length;
 	}
+	//Map the whole library if we can, so its files can be read straight out of memory
+	lib->map = NULL;
+	lib->map_length = 0;
+	if (Cfile_map_libraries)
+	{
+		lib->map = ddio_MapFile(libname, &lib->map_length);
+		if (lib->map && (lib->map_length < offset))	//file is short, so don't trust the mapping
+		{
+			ddio_UnmapFile(lib->map, lib->map_length);
+			lib->map = NULL;
+		}
+	}
+	//The mapping doesn't need the file to stay open
+	if (lib->map)
+	{
+		fclose(fp);
+		fp = NULL;
+	}
 	//assign a handle
 	lib->handle = ++lib_handle;
 	//Save the file pointer
 	lib->file = fp;
+	//Add to the front of the search list
+	lib->next = Libraries;
+	Libraries = lib;
+	build_library_index();
 	//Sucess.  Return the handle
 	return lib->handle;
 }
@@ -189,6 +330,7 @@ int cf_OpenLibrary(const char *libname)
 void cf_CloseLibrary(int handle)
 {
 	library *lib,*prev=NULL;
+	cf_EndPrefetch();
 	for (lib=Libraries;lib;prev=lib,lib=lib->next) 
 	{
 		if (lib->handle == handle) 
@@ -199,8 +341,11 @@ void cf_CloseLibrary(int handle)
 				Libraries = lib->next;
 			if (lib->file)
 				fclose(lib->file);
+			if (lib->map)
+				ddio_UnmapFile(lib->map, lib->map_length);
 			mem_free(lib->entries);
 			mem_free(lib);
+			build_library_index();
 			return; //sucessful close
 		}
 	}
@@ -210,13 +355,244 @@ void cf_CloseLibrary(int handle)
 void cf_Close()
 {
 	library *next;
+	cf_EndPrefetch();
 	while (Libraries) 
 	{
 		next = Libraries->next;
+		if (Libraries->map)
+			ddio_UnmapFile(Libraries->map, Libraries->map_length);
 		mem_free(Libraries->entries);
 		mem_free(Libraries);
 		Libraries = next;
 	}
+	build_library_index();
+}
+
+//Sets whether libraries opened from now on are memory-mapped
+void cf_SetLibraryMapping(bool enable)
+{
+	Cfile_map_libraries = enable;
+}
+
+//Makes a CFILE for a file in a library
+//Parameters:	lib - the library the file is in
+//				entry - the file's entry in the library
+//Returns:		the CFILE handle, or NULL if the library couldn't be opened
+static CFILE *open_lib_entry(library *lib, library_entry *entry)
+{
+	CFILE *cfile;
+	FILE *fp = NULL;
+	ubyte *prefetched = NULL;
+	int r;
+	//If the file's being prefetched, take the data if it's ready, or stop the prefetch if it hasn't started
+	if (entry->prefetch_job != -1)
+	{
+		prefetch_job *job = &Prefetch_jobs[entry->prefetch_job];
+		int state = PFS_DONE;
+		if (job->state.compare_exchange_strong(state, PFS_TAKEN))
+		{
+			prefetched = job->buffer;
+			job->buffer = NULL;
+			entry->prefetch_job = -1;
+		}
+		else if (state == PFS_WAITING)
+		{
+			if (job->state.compare_exchange_strong(state, PFS_TAKEN))
+				entry->prefetch_job = -1;
+		}
+	}
+	//Files in a mapped library are read from memory, and don't need a FILE.  Neither do prefetched files.
+	if (!lib->map && !prefetched)
+	{
+		//See if there's an available FILE
+		if (lib->file) 
+		{
+			fp = lib->file;
+			lib->file = NULL;
+		}
+		else 
+		{
+			fp = fopen(lib->name,"rb");
+			if (!fp) 
+			{
+				mprintf((1,"Error opening library <%s> when opening file <%s>; errno=%d.",lib->name,entry->name,errno));
+				Int3();
+				return NULL;
+			}
+		}
+	}
+	cfile = (CFILE *) mem_malloc(sizeof(*cfile));
+	if (!cfile)
+		Error("Out of memory in open_file_in_lib()");
+	cfile->name = entry->name;
+	cfile->file = fp;
+	cfile->lib_handle = lib->handle;
+	cfile->size = entry->length;
+	cfile->lib_offset = entry->offset;
+	cfile->position = 0;
+	cfile->flags = 0;
+	cfile->data = lib->map ? (lib->map + entry->offset) : NULL;
+	cfile->buffer = NULL;
+	cfile->buf_start = 0;
+	cfile->buf_len = 0;
+	if (prefetched)
+	{
+		//The file owns the prefetched data now, and reads it like a mapped file
+		cfile->data = prefetched;
+		cfile->buffer = prefetched;
+	}
+	if (fp)
+	{
+		r = fseek(fp,cfile->lib_offset,SEEK_SET);
+		ASSERT(r == 0);
+		Cfile_num_seeks++;
+	}
+	return cfile;
+}
+
+//Tells if cfopen() would find a file in one of the search directories before it looked in the
+//libraries.  Only uses the C library, so it doesn't try other cases of the name like cfopen() does on Linux.
+static bool file_in_search_dirs(const char *filename)
+{
+	char path[_MAX_PATH*2];
+	const char *ext = strrchr(filename, '.');
+	int i;
+	for (i = 0; i < N_extensions; i++) 
+	{
+		if (ext && !strnicmp(extensions[i].ext, ext+1, _MAX_EXT))
+		{
+			ddio_MakePath(path, paths[extensions[i].pathnum].path, filename, NULL);
+			FILE *fp = fopen(path, "rb");
+			if (fp)
+			{
+				fclose(fp);
+				return true;
+			}
+		}
+	}
+	for (i = 0; i < N_paths; i++) 
+	{
+		if (!paths[i].specific) 
+		{
+			ddio_MakePath(path, paths[i].path, filename, NULL);
+			FILE *fp = fopen(path, "rb");
+			if (fp)
+			{
+				fclose(fp);
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+//Reads one file for cf_PrefetchFiles().  Runs on a worker thread, so it can only use the C library.
+static void prefetch_file(int index, void *parm)
+{
+	prefetch_job *job = &Prefetch_jobs[index];
+	int state = PFS_WAITING;
+	if (!job->state.compare_exchange_strong(state, PFS_READING))
+		return;	//already opened, so there's no point
+	//A loose file is opened instead of the library one, so don't read the library one
+	if (file_in_search_dirs(job->entry->name))
+	{
+		job->state = PFS_TAKEN;
+		return;
+	}
+	if (job->lib->map)
+	{
+		//Touch every page, so the OS reads them in now instead of when the file is parsed
+		const volatile ubyte *p = job->lib->map + job->entry->offset;
+		const volatile ubyte *end = p + job->entry->length;
+		ubyte sum = 0;
+		for (; p < end; p += 4096)
+			sum += *p;
+		(void)sum;
+	}
+	else
+	{
+		//Libraries share one FILE between their open files, so open our own
+		FILE *fp = fopen(job->lib->name, "rb");
+		bool ok = false;
+		if (fp)
+		{
+			ok = (fseek(fp, job->entry->offset, SEEK_SET) == 0) && 
+				(fread(job->buffer, 1, job->entry->length, fp) == (size_t)job->entry->length);
+			fclose(fp);
+		}
+		if (!ok)
+		{
+			//Leave the data alone, so the file gets read normally when it's opened
+			job->state = PFS_TAKEN;
+			return;
+		}
+	}
+	job->state = PFS_DONE;
+}
+
+//Starts reading a list of files into memory in the background, so opening them later doesn't have
+//to wait on the disk.  Only files in libraries are prefetched; others are skipped.
+void cf_PrefetchFiles(const char **names, int num)
+{
+	int i, n, bytes = 0;
+	cf_EndPrefetch();
+	if (num <= 0)
+		return;
+	Prefetch_jobs = new prefetch_job[num];
+	for (i = 0, n = 0; i < num; i++) 
+	{
+		//Find the library entry cfopen() would get if there's no loose copy of the file.  The
+		//workers check for loose copies, so nothing here touches the disk.
+		char path[_MAX_PATH*2], fname[_MAX_PATH*2], ext[_MAX_EXT];
+		ddio_SplitPath(names[i], path, fname, ext);
+		if (strlen(path))
+			continue;
+		lib_index_entry *ie = find_in_library_index(names[i], -1);
+		if (!ie || (ie->entry->prefetch_job != -1) || (ie->entry->length <= 0))
+			continue;
+		prefetch_job *job = &Prefetch_jobs[n];
+		job->lib = ie->lib;
+		job->entry = ie->entry;
+		job->buffer = NULL;
+		if (!ie->lib->map)
+		{
+			if (bytes + ie->entry->length > MAX_PREFETCH_BYTES)
+				continue;
+			job->buffer = (ubyte *) mem_malloc(ie->entry->length);
+			if (!job->buffer)
+				continue;
+			bytes += ie->entry->length;
+		}
+		job->state = PFS_WAITING;
+		ie->entry->prefetch_job = n++;
+	}
+	Num_prefetch_jobs = n;
+	//Fan the reads out over the worker threads, without holding up the caller
+	Prefetch_future = std::async(std::launch::async, [n]() { task_ParallelFor(n, prefetch_file, NULL); });
+}
+
+//Waits for the prefetch started by cf_PrefetchFiles() to finish, and frees whatever data wasn't used
+void cf_EndPrefetch()
+{
+	if (!Prefetch_jobs)
+		return;
+	if (Prefetch_future.valid())
+		Prefetch_future.wait();
+	int used = 0;
+	for (int i = 0; i < Num_prefetch_jobs; i++) 
+	{
+		prefetch_job *job = &Prefetch_jobs[i];
+		if (job->entry->prefetch_job == i)
+			job->entry->prefetch_job = -1;
+		else
+			used++;
+		if (job->buffer)
+			mem_free(job->buffer);
+	}
+	mprintf((0,"Prefetched %d files, %d of them were used.\n",Num_prefetch_jobs,used));
+	delete[] Prefetch_jobs;
+	Prefetch_jobs = NULL;
+	Num_prefetch_jobs = 0;
 }
 
 //Specify a directory to look in for files
@@ -267,148 +643,22 @@ CFILE *cf_OpenFileInLibrary(const char *filename,int libhandle)
 	if(libhandle<=0)
 		return NULL;
 
-	library *lib;
-	CFILE *cfile;
-	lib = Libraries;
-
-	// find the library that we want to use
-	while (lib) 
-	{
-		if(lib->handle==libhandle)
-			break;
-		lib = lib->next;
-	}
-
-	if(NULL==lib)
-	{
-		// couldn't find the library handle
-		return NULL;
-	}
-
-	// now do a binary search for the file entry
-	int i;
-	int first = 0,last = lib->nfiles-1,c,found=0;
-
-	for (;;)
-	{
-		i = (first + last) / 2;
-		c = stricmp(filename, lib->entries[i].name);	//compare to current
-		if (c == 0) //found it
-		{
-			found = 1;
-			break;
-		}
-		if (first >= last)	//exhausted search
-			break;
-		if (c > 0)			//search key after check key
-			first = i + 1;
-		else				//search key before check key
-			last = i - 1;
-	}
-
-	if(!found)
-		return NULL;	// file not in library
+	// find the file in the given library
+	lib_index_entry *ie = find_in_library_index(filename,libhandle);
+	if(!ie)
+		return NULL;	// file not in library (or no such library)
 
 	// open the file for reading
-  	FILE *fp;
-  	int r;
-	//See if there's an available FILE
-	if (lib->file) 
-	{
-		fp = lib->file;
-		lib->file = NULL;
-	}
-	else 
-	{
-	  	fp = fopen(lib->name,"rb");
-  		if (!fp) 
-		{
-			mprintf((1,"Error opening library <%s> when opening file <%s>; errno=%d.",lib->name,filename,errno));
-  			Int3();
-  			return NULL;
-	  	}
-	}
-
-  	cfile = (CFILE *)mem_malloc(sizeof(*cfile));
-  	if (!cfile)
-  		Error("Out of memory in open_file_in_lib()");
-  	cfile->name = lib->entries[i].name;
-  	cfile->file = fp;
-	cfile->lib_handle = lib->handle;
-  	cfile->size = lib->entries[i].length;
-  	cfile->lib_offset = lib->entries[i].offset;
-  	cfile->position = 0;
-  	cfile->flags = 0;
-  	r = fseek(fp,cfile->lib_offset,SEEK_SET);
-  	ASSERT(r == 0);
-  	return cfile;
+	return open_lib_entry(ie->lib,ie->entry);
 }
 
 //searches through the open HOG files, and opens a file if it finds it in any of the libs
 CFILE *open_file_in_lib(const char *filename)
 {
-	library *lib;
-	CFILE *cfile;
-	lib = Libraries;
-	while (lib) 
-	{
-		int i;
-		//Do binary search for the file
-		int first = 0, last = lib->nfiles-1, c,found=0;
-		for (;;)
-		{
-			i = (first + last) / 2;
-			c = stricmp(filename, lib->entries[i].name);	//compare to current
-			if (c == 0) //found it
-			{
-				found = 1;
-				break;
-			}
-			if (first >= last)	//exhausted search
-				break;
-			if (c > 0)				//search key after check key
-				first = i + 1;
-			else						//search key before check key
-				last = i - 1;
-		}
-
-		if (found) 
-		{
-  			FILE *fp;
-  			int r;
-			//See if there's an available FILE
-			if (lib->file) 
-			{
-				fp = lib->file;
-				lib->file = NULL;
-			}
-			else 
-			{
-	  			fp = fopen(lib->name,"rb");
-  				if (!fp) 
-				{
-					mprintf((1,"Error opening library <%s> when opening file <%s>; errno=%d.",lib->name,filename,errno));
-  					Int3();
-  					return NULL;
-	  			}
-			}
-  			cfile = (CFILE *) mem_malloc(sizeof(*cfile));
-  			if (!cfile)
-  				Error("Out of memory in open_file_in_lib()");
-  			cfile->name = lib->entries[i].name;
-  			cfile->file = fp;
-			cfile->lib_handle = lib->handle;
-  			cfile->size = lib->entries[i].length;
-  			cfile->lib_offset = lib->entries[i].offset;
-  			cfile->position = 0;
-  			cfile->flags = 0;
-  			r = fseek(fp,cfile->lib_offset,SEEK_SET);
-  			ASSERT(r == 0);
-  			return cfile;
-		}
-		lib = lib->next;
-	}
-	return NULL;
+	lib_index_entry *ie = find_in_library_index(filename,-1);
+	if (!ie)
+		return NULL;
+	return open_lib_entry(ie->lib,ie->entry);
 }
 
 #ifdef __LINUX__
@@ -706,6 +956,10 @@ CFILE *open_file_in_directory(const char *filename,const char *mode,const char *
 		cfile->lib_offset = 0;		//0 means on disk, not in HOG
 		cfile->position = 0;
 		cfile->flags=0;
+		cfile->data=NULL;
+		cfile->buffer=NULL;
+		cfile->buf_start=0;
+		cfile->buf_len=0;
 		return cfile;
 	}else
 	{
@@ -733,6 +987,10 @@ CFILE *open_file_in_directory(const char *filename,const char *mode,const char *
 			cfile->lib_offset = 0;		//0 means on disk, not in HOG
 			cfile->position = 0;
 			cfile->flags=0;
+			cfile->data=NULL;
+			cfile->buffer=NULL;
+			cfile->buf_start=0;
+			cfile->buf_len=0;
 			return cfile;
 		}
 	}
@@ -754,6 +1012,10 @@ CFILE *open_file_in_directory(const char *filename,const char *mode,const char *
 		cfile->lib_offset = 0; //0 means on disk, not in HOG
 		cfile->position = 0;
 		cfile->flags=0;
+		cfile->data=NULL;
+		cfile->buffer=NULL;
+		cfile->buf_start=0;
+		cfile->buf_len=0;
 		return cfile;
 	}
 #endif
@@ -852,23 +1114,53 @@ void cfclose( CFILE * cfp )
 	//free the name, if allocated
 	if (!cfp->lib_offset)
 		mem_free(cfp->name);
+	if (cfp->buffer)
+		mem_free(cfp->buffer);
 	//free the cfile struct
 	mem_free(cfp);
 }
 
+//Refills the read-ahead buffer of a file that's read through stdio, starting at the current position.
+//The file's read position is always at the end of the buffer, so this only works when the buffer is used up.
+//Returns the number of bytes now in the buffer
+static int cf_FillBuffer(CFILE *cfp)
+{
+	int len;
+	ASSERT(cfp->position == cfp->buf_start + cfp->buf_len);
+	if (!cfp->buffer) 
+	{
+		//small files don't need a whole buffer
+		cfp->buffer = (ubyte *) mem_malloc((cfp->size < CF_READ_BUFFER_SIZE) ? cfp->size : CF_READ_BUFFER_SIZE);
+		if (!cfp->buffer)
+			Error("Out of memory in cf_FillBuffer()");
+	}
+	len = cfp->size - cfp->position;
+	if (len > CF_READ_BUFFER_SIZE)
+		len = CF_READ_BUFFER_SIZE;
+	cfp->buf_start = cfp->position;
+	cfp->buf_len = (len > 0) ? fread(cfp->buffer, 1, len, cfp->file) : 0;
+	Cfile_num_reads++;
+	Cfile_bytes_read += cfp->buf_len;
+	return cfp->buf_len;
+}
+
+//Returns the byte at the current position without moving past it, or EOF
+static int cf_PeekByte(CFILE *cfp)
+{
+	if (cfp->position >= cfp->size)
+		return EOF;
+	if (cfp->data)
+		return cfp->data[cfp->position];
+	if ((cfp->position == cfp->buf_start + cfp->buf_len) && !cf_FillBuffer(cfp))
+		return EOF;
+	return cfp->buffer[cfp->position - cfp->buf_start];
+}
+
 //Just like stdio fgetc(), except works on a CFILE
 //Returns a char or EOF
 int cfgetc( CFILE * cfp )
 {
-	int c;
-	static unsigned char ch[3] = "\0\0";
-	if (cfp->position >= cfp->size ) return EOF;
-	
-	fread(ch,sizeof(char),1,cfp->file);
-	c = ch[0];
-	//c = getc( cfp->file );
-	if(cfeof(cfp))
-		c = EOF;
+	int c = cf_PeekByte(cfp);
 	if (c != EOF) 
 	{
 		cfp->position++;
@@ -881,18 +1173,8 @@ int cfgetc( CFILE * cfp )
 				c = '\n';
 			else if (c == 13) //check for CR/LF pair
 			{					
-				fread(ch,sizeof(char),1,cfp->file);
-				int cc = ch[0];
-				if (!cfeof(cfp)) 
-				{
-					if (cc == 10)					//line feed?
-						cfp->position++;			//..yes, so swallow it
-					else
-					{
-						//ungetc(cc,cfp->file);	//..no, so put it back
-						fseek(cfp->file,-1,SEEK_CUR);
-					}
-				}
+				if (cf_PeekByte(cfp) == 10)		//line feed?
+					cfp->position++;				//..yes, so swallow it
 				c = '\n';							//return CR or CR/LF pair as newline
 			}
 		}
@@ -917,8 +1199,26 @@ int cfseek( CFILE *cfp, long int offset, int where )
 		default:
 			return 1;
 	}	
+	//Mapped files can seek anywhere fseek() could, without touching the disk
+	if (cfp->data)
+	{
+		if (cfp->lib_offset + goal_position < 0)
+			return -1;
+		cfp->position = goal_position;
+		return 0;
+	}
+	//Seeking within the read buffer doesn't need to touch the file
+	if (!(cfp->flags & CF_WRITING) && (goal_position >= cfp->buf_start) && (goal_position <= cfp->buf_start + cfp->buf_len))
+	{
+		cfp->position = goal_position;
+		return 0;
+	}
 	c = fseek( cfp->file, cfp->lib_offset + goal_position, SEEK_SET );
 	cfp->position = ftell(cfp->file) - cfp->lib_offset;
+	Cfile_num_seeks++;
+	//The buffer is now empty, at the new file position
+	cfp->buf_start = cfp->position;
+	cfp->buf_len = 0;
 	return c;
 }
 
@@ -934,6 +1234,22 @@ int cfeof(CFILE *cfp)
 	return (cfp->position >= cfp->size );
 }
 
+//Gets the number of reads & seeks the CFILE system has made on the OS, and the number of bytes read
+void cf_GetIOStats(int *reads, int *seeks, int *bytes)
+{
+	*reads = Cfile_num_reads;
+	*seeks = Cfile_num_seeks;
+	*bytes = Cfile_bytes_read;
+}
+
+//Returns a pointer to the current position of a file in a memory-mapped library, or NULL
+const ubyte *cf_GetDataPointer(CFILE *cfp)
+{
+	if (!cfp->data)
+		return NULL;
+	return cfp->data + cfp->position;
+}
+
 // Tells if the file exists
 // Returns non-zero if file exists.  Also tells if the file is on disk
 //	or in a hog -  See return values in cfile.h
@@ -962,15 +1278,46 @@ int cfexist( const char * filename )
 //Throws an exception of type (cfile_error *) if the OS returns an error on read
 int cf_ReadBytes(ubyte *buf, int count, CFILE *cfp)
 {
-	int i;
+	int i, left;
 	char *error_msg = eof_error;		//default error
 	ASSERT(! (cfp->flags & CF_TEXT));
 	if (cfp->position + count <= cfp->size) {
-		i = fread ( buf, 1, count, cfp->file );
-		if (i == count) {
+		if (cfp->data) {
+			memcpy(buf, cfp->data + cfp->position, count);
+			cfp->position += count;
+			return count;
+		}
+		//Take what we can from the read buffer
+		left = count;
+		i = cfp->buf_start + cfp->buf_len - cfp->position;
+		if (i > 0) {
+			if (i > left)
+				i = left;
+			memcpy(buf, cfp->buffer + (cfp->position - cfp->buf_start), i);
+			cfp->position += i;
+			buf += i;
+			left -= i;
+		}
+		if (left == 0)
+			return count;
+		//Big reads go straight into the caller's buffer, and small ones refill the read buffer
+		if (left >= CF_READ_BUFFER_SIZE) {
+			i = fread ( buf, 1, left, cfp->file );
+			Cfile_num_reads++;
+			Cfile_bytes_read += i;
 			cfp->position += i;
-			return i;
+			cfp->buf_start = cfp->position;
+			cfp->buf_len = 0;
 		}
+		else {
+			i = cf_FillBuffer(cfp);
+			if (i > left)
+				i = left;
+			memcpy(buf, cfp->buffer, i);
+			cfp->position += i;
+		}
+		if (i == left)
+			return count;
 		//if not EOF, then get the error message
 		if (! feof(cfp->file))
 			error_msg = strerror(errno);
@@ -1287,14 +1634,28 @@ void cf_ChangeFileAttributes (const char *name,int attr)
 //	rewinds cfile position
 void cf_Rewind(CFILE *fp)
 {
-	if (fp->lib_offset) 
+	if (fp->data)
+	{
+		//mapped, so there's no FILE to rewind
+	}
+	else if (!(fp->flags & CF_WRITING) && (fp->buf_start == 0))
 	{
-		int r = fseek(fp->file,fp->lib_offset,SEEK_SET);
-		ASSERT(r==0);
+		//the start of the file is still in the read buffer
 	}
 	else 
 	{
-		rewind(fp->file);
+		if (fp->lib_offset) 
+		{
+			int r = fseek(fp->file,fp->lib_offset,SEEK_SET);
+			ASSERT(r==0);
+		}
+		else 
+		{
+			rewind(fp->file);
+		}
+		Cfile_num_seeks++;
+		fp->buf_start = 0;
+		fp->buf_len = 0;
 	}
 	fp->position = 0;
 }
@@ -1403,6 +1764,17 @@ bool cf_LibraryFindFirst(int handle,const char *wildcard,char *buffer)
 	cfile_search_wildcard[255] = '\0';
 	cfile_search_ispattern = (bool)(PSGlobHasPattern(cfile_search_wildcard)!=0);
 	cfile_search_curr_index = 0;
+
+	//a plain filename can only match one entry, so just look it up
+	if(!cfile_search_ispattern)
+	{
+		lib_index_entry *ie = find_in_library_index(cfile_search_wildcard,handle);
+		cfile_search_curr_index = cfile_search_library->nfiles;
+		if(!ie)
+			return false;
+		strcpy(buffer,ie->entry->name);
+		return true;
+	}
 		
 	while(cfile_search_curr_index<cfile_search_library->nfiles)
 	{
@@ -1468,59 +1840,17 @@ void cf_LibraryFindClose(void)
 // returns hog cfile info, using a library handle opened via cf_OpenLibrary.
 bool cf_ReadHogFileEntry(int libr, const char *filename, tHogFileEntry *entry, int *fileoffset)
 {
-	//searches through the open HOG files, and opens a file if it finds it in any of the libs
-	library *lib;
-
-	lib = Libraries;
-
-	while (lib) 
-	{
-		int i;
-
-		if (lib->handle == libr || libr == -1) 
-		{
-			//Do binary search for the file
-			int first = 0, last = lib->nfiles-1, c,found=0;
-			do 
-			{
-				i = (first + last) / 2;
-				c = stricmp(filename,lib->entries[i].name);	//compare to current
-		
-				if (c == 0) //found it
-				{
-					found = 1;
-					break;
-				}
-
-				if (first >= last)	//exhausted search
-					break;
-
-				if (c > 0)				//search key after check key
-					first = i+1;
-				else						//search key before check key
-					last = i-1;
-
-			} while (1);
-	
-			if (found) 
-			{
-				strcpy(entry->name, lib->entries[i].name);
-				entry->len = lib->entries[i].length;
-				entry->flags = lib->entries[i].flags;
-				entry->timestamp = lib->entries[i].timestamp;
-				*fileoffset = lib->entries[i].offset;
-				return true;
-			}
-			else if (lib->handle == libr) 
-			{
-				break;
-			}
-		}
-
-		lib = lib->next;
-	}
+	//searches through the open HOG files, or just the given one
+	lib_index_entry *ie = find_in_library_index(filename,libr);
+	if (!ie)
+		return false;
 
-	return false;
+	strcpy(entry->name, ie->entry->name);
+	entry->len = ie->entry->length;
+	entry->flags = ie->entry->flags;
+	entry->timestamp = ie->entry->timestamp;
+	*fileoffset = ie->entry->offset;
+	return true;
 }
 
 
@@ -70,6 +70,7 @@
 #include <fcntl.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include <utime.h>
 #include <glob.h>
 #include <string.h>
@@ -140,6 +141,36 @@ int ddio_GetFileLength(FILE* filePtr)
   return size;
 }
 
+// maps a whole file read-only into memory
+const ubyte *ddio_MapFile(const char *filename, int *length)
+{
+  struct stat info;
+  void *data;
+  int filedes = open(filename, O_RDONLY);
+  if (filedes == -1)
+    return NULL;
+
+  if (fstat(filedes, &info) || info.st_size == 0){
+    close(filedes);
+    return NULL;
+  }
+
+  // the mapping stays valid after the descriptor is closed
+  data = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, filedes, 0);
+  close(filedes);
+  if (data == MAP_FAILED)
+    return NULL;
+
+  *length = info.st_size;
+  return (const ubyte *)data;
+}
+
+void ddio_UnmapFile(const ubyte *data, int length)
+{
+  if (data)
+    munmap((void *)data, length);
+}
+
 // Split a pathname into its component parts
 void ddio_SplitPath(const char* srcPath, char* path, char* filename, char* ext)
 {
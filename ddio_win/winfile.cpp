@@ -81,6 +81,45 @@ int	ddio_GetFileLength(FILE* filePtr)
 	return (filelength(fileno(filePtr)));
 }
 
+//	maps a whole file read-only into memory
+const ubyte *ddio_MapFile(const char *filename, int *length)
+{
+	HANDLE filehandle,maphandle;
+	DWORD size;
+	void *data;
+
+	filehandle = CreateFile(filename,GENERIC_READ,FILE_SHARE_READ,NULL,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,NULL);
+	if (filehandle == INVALID_HANDLE_VALUE)
+		return NULL;
+
+	size = GetFileSize(filehandle,NULL);
+	if (size == 0 || size == INVALID_FILE_SIZE)
+	{
+		CloseHandle(filehandle);
+		return NULL;
+	}
+
+	maphandle = CreateFileMapping(filehandle,NULL,PAGE_READONLY,0,0,NULL);
+	CloseHandle(filehandle);
+	if (maphandle == NULL)
+		return NULL;
+
+	//The view holds a reference to the mapping object, so the handle can go now
+	data = MapViewOfFile(maphandle,FILE_MAP_READ,0,0,0);
+	CloseHandle(maphandle);
+	if (data == NULL)
+		return NULL;
+
+	*length = (int)size;
+	return (const ubyte *)data;
+}
+
+void ddio_UnmapFile(const ubyte *data, int length)
+{
+	if (data)
+		UnmapViewOfFile(data);
+}
+
 // Split a pathname into its component parts
 void ddio_SplitPath(const char* srcPath, char* path, char* filename, char* ext)
 {
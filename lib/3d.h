@@ -162,9 +162,16 @@ g3Codes g3_CheckCodes(int nv,g3Point **pointlist);
 //rotates a point. returns codes.  does not check if already rotated
 ubyte g3_RotatePoint(g3Point *dest,vector *src);
 
+//rotates and codes an array of points.  dest[i] is the rotated src[i].  the points are not 
+//projected.  same results as g3_RotatePoint() on each, but faster for big arrays
+void g3_RotatePointArray(g3Point *dest,vector *src,int num);
+
 //projects a point
 void g3_ProjectPoint(g3Point *point);
 
+//projects an array of points.  same results as g3_ProjectPoint() on each
+void g3_ProjectPointArray(g3Point *points,int num);
+
 //calculate the depth of a point - returns the z coord of the rotated point
 float g3_CalcPointDepth(vector *pnt);
 
@@ -174,6 +181,9 @@ void g3_Point2Vec(vector *v,short sx,short sy);
 //code a point.  fills in the p3_codes field of the point, and returns the codes
 ubyte g3_CodePoint(g3Point *point);
 
+//codes a list of points.  same results as g3_CodePoint() on each
+void g3_CodePointList(int nv,g3Point **pointlist);
+
 //delta rotation functions
 vector *g3_RotateDeltaX(vector *dest,float dx);
 vector *g3_RotateDeltaY(vector *dest,float dy);
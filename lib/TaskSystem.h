@@ -131,6 +131,25 @@ public:
 };
 
 
+//	Worker thread pool, for spreading work that doesn't touch shared state across CPUs.
+//	Code run on the pool must not call mem_malloc/mem_free (the heap isn't serialized),
+//	mprintf or anything else that isn't thread-safe.
+
+//	starts the worker threads.  num_threads==-1 picks one per CPU, less one for the main thread.
+//	With no worker threads, everything runs on the calling thread.
+void task_InitPool(int num_threads=-1);
+
+//	stops the worker threads.
+void task_ClosePool();
+
+//	returns the number of worker threads, not counting whoever calls task_ParallelFor
+int task_GetNumWorkers();
+
+//	calls func(index,parm) once for every index from 0 to count-1, spread across the worker
+//	threads and the calling thread.  Returns when every call is done.  Can be called from a worker.
+void task_ParallelFor(int count, void (*func)(int index, void *parm), void *parm);
+
+
 
 #endif
 
@@ -180,6 +180,12 @@ bool ddio_DirExists(const char* path);
 //  get a file length of a FILE
 int	ddio_GetFileLength(FILE* filePtr);
 
+//	maps a whole file read-only into memory.  Returns a pointer to the first byte, or NULL
+//	if the file couldn't be mapped (or is empty).  length is filled in with the mapping size.
+//	The mapping must be released with ddio_UnmapFile.
+const ubyte *ddio_MapFile(const char *filename, int *length);
+void ddio_UnmapFile(const ubyte *data, int length);
+
 //	check if two files are different
 //	This pathname is *RELATIVE* not fully qualified
 bool ddio_FileDiff(const char* fileNameA, const char* fileNameB);
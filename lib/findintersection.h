@@ -375,6 +375,115 @@ typedef struct fvi_query
 	float frametime;
 } fvi_query;
 
+// Face/Room list for some fvi call(s)
+typedef struct fvi_face_room_list
+{
+	ushort face_index;
+	ushort room_index;
+} fvi_face_room_list;
+
+#define MAX_RECORDED_FACES 200
+
+#define MAX_CELLS_VISITED (TERRAIN_DEPTH * TERRAIN_WIDTH)   // Maximum terrain cells visited in one fvi call
+#define MAX_FVI_INSTANCE_DEPTH 30
+
+// Saved polygon model collision transform
+typedef struct fvi_instance
+{
+	matrix m;
+	vector p;
+	vector p0;
+	vector p1;
+	vector fvec;
+	vector uvec;
+} fvi_instance;
+
+// Working state for fvi queries.  A query only touches the context it is handed, so threads can
+// run queries at the same time as long as each one has its own context.  This is big (the terrain
+// visit lists alone are over 256K), so get one from fvi_CreateContext() instead of the stack.
+typedef struct fvi_context
+{
+	// Bit fields for quick 'already-checked' checking
+	unsigned char visit_list[MAX_ROOMS/8 + 1];
+	unsigned char terrain_visit_list[(TERRAIN_DEPTH * TERRAIN_WIDTH)/8 + 1];
+	unsigned char terrain_obj_visit_list[(TERRAIN_DEPTH * TERRAIN_WIDTH)/8 + 1];
+
+	// The number rooms and terrain cells that this fvi call visited.
+	int num_rooms_visited;
+	int num_cells_visited;
+	int num_cells_obj_visited;
+
+	// Unordered list of rooms and terrain cells that this fvi call visited.
+	ushort rooms_visited[MAX_ROOMS];
+	ushort cells_visited[MAX_CELLS_VISITED];
+	ushort cells_obj_visited[MAX_CELLS_VISITED];
+
+	// A terrain check always does a full check, so we only have to do it once
+	bool check_terrain;
+	bool zero_rad;
+
+	// Wall and animation collision spheres of the moving object
+	float wall_sphere_rad;
+	vector wall_sphere_offset;
+	vector wall_sphere_p0;
+	vector wall_sphere_p1;
+
+	float anim_sphere_rad;
+	vector anim_sphere_offset;
+	vector anim_sphere_p0;
+	vector anim_sphere_p1;
+
+	// The query being run and where its results go
+	fvi_info *hit_data_ptr;
+	fvi_query *query_ptr;
+
+	// Best collision's distance
+	float collision_dist;
+
+	// AABBs for the movement
+	vector max_xyz;
+	vector min_xyz;
+	vector movement_delta;
+	vector wall_max_xyz;
+	vector wall_min_xyz;
+
+	int curobj;
+	int moveobj;
+
+	// Faces passed through by FQ_RECORD queries
+	fvi_face_room_list recorded_faces[MAX_RECORDED_FACES];
+	int num_recorded_faces;
+
+	// Polygon model collision (newstyle_fi.cpp)
+	matrix view_matrix;
+	vector view_position;
+	vector move_fvec;
+	vector move_uvec;
+	bool do_orient;
+	bool f_normal;
+	bool check_param;
+	float hit_param;
+	vector ns_min_xyz;
+	vector ns_max_xyz;
+	int instance_depth;
+	fvi_instance instance_stack[MAX_FVI_INSTANCE_DEPTH];
+
+	// Set by fvi_FindIntersectionBatch.  Faces of batch_room whose bit is clear can't be hit by
+	// the current query and are skipped.
+	int batch_room;
+	const uint *batch_face_bits;
+} fvi_context;
+
+// Allocates a cleared context.  Safe to call from any thread.
+fvi_context *fvi_CreateContext(void);
+
+// Frees a context from fvi_CreateContext()
+void fvi_DestroyContext(fvi_context *ctx);
+
+// Returns the calling thread's own context.  This is what fvi_FindIntersection uses when it
+// isn't given one.
+fvi_context *fvi_GetThreadContext(void);
+
 //Find out if a vector intersects with anything.
 //Fills in hit_data, an fvi_info structure (see above).
 //Parms:
@@ -385,20 +494,16 @@ typedef struct fvi_query
 //  ingore_obj_list	NULL, or ptr to a list of objnums to ignore, terminated with -1
 //  check_obj_flag	determines whether collisions with objects are checked
 //Returns the hit_data->hit_type
-extern int fvi_FindIntersection(fvi_query *fq,fvi_info *hit_data,  bool no_subdivision = false);
+extern int fvi_FindIntersection(fvi_context *ctx, fvi_query *fq, fvi_info *hit_data, bool no_subdivision = false);
 
-// Face/Room list for some fvi call(s)
-typedef struct fvi_face_room_list
-{
-	ushort face_index;
-	ushort room_index;
-} fvi_face_room_list;
-
-#define MAX_RECORDED_FACES 200
+// Same as above, using the calling thread's context
+extern int fvi_FindIntersection(fvi_query *fq,fvi_info *hit_data,  bool no_subdivision = false);
 
-// Recorded face list
-extern fvi_face_room_list Fvi_recorded_faces[MAX_RECORDED_FACES];
-extern int Fvi_num_recorded_faces;
+// Runs a set of independent queries, leaving each result in the matching hit_data entry.  Queries
+// that start in the same room are run together and share the work of culling that room's faces.
+// The results are the same as calling fvi_FindIntersection for each query.  FQ_RECORD queries
+// aren't allowed, since their recorded face lists would depend on the order.
+extern void fvi_FindIntersectionBatch(int num_queries, fvi_query *fq, fvi_info *hit_data);
 
 // Generates a list of faces(with corresponding room numbers) within a given distance to a position.
 // Return value is the number of faces in the list
@@ -421,13 +526,7 @@ extern int FVI_room_counter;
 
 bool fvi_QuickRoomCheck(vector *pos, room *cur_room, bool try_again = false);
 
-extern fvi_info * fvi_hit_data_ptr;
-extern fvi_query * fvi_query_ptr;
-extern float fvi_collision_dist;
-extern int fvi_curobj;
-extern int fvi_moveobj;
-
-bool PolyCollideObject(object *obj);
+bool PolyCollideObject(fvi_context *ctx, object *obj);
 
 bool BBoxPlaneIntersection(bool fast_exit, vector *collision_point, vector *collision_normal, object *obj, vector *new_pos, int nv, vector **vertex_ptr_list, vector *face_normal, matrix *orient);
 
@@ -436,6 +535,56 @@ extern int check_vector_to_sphere_1(vector *intp, float *col_dist, const vector
 extern int check_line_to_face(vector *newp, vector *colp, float *col_dist, vector *wall_norm,const vector *p0,const vector *p1, vector *face_normal, vector **vertex_ptr_list, const int nv,const float rad);
 extern void InitFVI(void);
 
+// Room face BVH node.  Nodes are stored depth first, so an interior node's first child is the
+// node right after it.
+typedef struct fvi_bvh_node
+{
+	vector min_xyz;
+	vector max_xyz;
+	ushort first;		// Leaf: first item.  Interior: index of the second child.
+	ushort count;		// Leaf: number of items.  Interior: 0.
+} fvi_bvh_node;
+
+// Bounding volume hierarchy over a room's faces, built from its bbf regions.  A slot is a
+// face's position in the room's bbf lists (region 0's faces, then region 1's, ...), which is
+// the order fvi has always checked faces in.  Items are the slots in leaf order.
+typedef struct fvi_room_bvh
+{
+	int num_faces;				// Room's face count when this was built
+	int num_slots;
+	int num_nodes;
+	fvi_bvh_node *nodes;
+
+	short *slot_face;			// Face of each slot
+	short *slot_region;		// bbf region of each slot
+
+	// Per item face bounds, one array per component
+	float *min_x, *min_y, *min_z;
+	float *max_x, *max_y, *max_z;
+	ushort *item_slot;
+	ubyte *item_sector;		// bbf_list_sector of the item's region
+} fvi_room_bvh;
+
+// Largest slot bit field fvi_QueryRoomBVH() can fill in
+#define FVI_BVH_SLOT_WORDS ((MAX_FACES_PER_ROOM + 31) / 32)
+
+// When false, fvi goes back to walking every bbf region (for comparing the two)
+extern bool FVI_use_room_bvh;
+
+// Builds the face BVHs for every room.  Called by ComputeAABB() once the bbf regions are done.
+void fvi_BuildRoomBVHs(void);
+
+// Frees the face BVH for one room
+void fvi_FreeRoomBVH(int roomnum);
+
+// Returns the room's face BVH, or NULL if it doesn't have an up-to-date one
+const fvi_room_bvh *fvi_GetRoomBVH(int roomnum);
+
+// Sets the bit in slot_bits for every slot whose face box overlaps the given box and whose region
+// passes the sector mask.  slot_bits needs (num_slots + 31) / 32 words and is not cleared first.
+// Returns the number of bits set.
+int fvi_QueryRoomBVH(const fvi_room_bvh *bvh, const vector *min_xyz, const vector *max_xyz, ubyte msector, uint *slot_bits);
+
 // Types of supported collisions
 #ifdef NED_PHYSICS
 #define RESULT_NOTHING						0
@@ -309,6 +309,10 @@ void nw_InitSockets(ushort port);
 // Connects a client to a server
 void nw_ConnectToServer(SOCKET *socket, network_address *server_addr);
 
+// Sets up a reliable socket to a peer at a known address, skipping the connect handshake.
+// Returns INVALID_SOCKET if there are no free sockets.
+SOCKET nw_OpenReliableSocket(network_address *addr);
+
 // Returns internet address format from string address format...ie "204.243.217.14"
 // turns into 1414829242
 unsigned long nw_GetHostAddressFromNumbers (char *str);
@@ -337,9 +341,6 @@ int nw_Send( network_address * who_to, void * data, int len, int flags );
 void nw_ReceiveFromSocket();
 
 
-// routine to "free" a packet buffer
-void nw_FreePacket( int id );
-
 // nw_Recieve will call the above function to read data out of the socket.  It will then determine
 // which of the buffers we should use and pass to the routine which called us
 int nw_Receive( void * data, network_address *from_addr );
@@ -455,6 +456,17 @@ int nw_RegisterCallback(NetworkReceiveCallback nfp, ubyte id);
 NetworkReceiveCallback nw_UnRegisterCallback(ubyte id);
 int nw_SendWithID(ubyte id,ubyte *data,int len,network_address *who_to);
 int nw_DoReceiveCallbacks(void);
+
+// Queues UDP packets sent after this instead of sending them right away.  Calls can be nested.
+void nw_BeginSendBatch();
+
+// Sends the packets queued since the matching nw_BeginSendBatch()
+void nw_EndSendBatch();
+
+// Drops the given fraction of outgoing packets and holds the rest back for latency seconds plus
+// up to jitter more, to try out bad connections.  Pass all 0 to turn it off.
+void nw_SetLinkSimulation(float loss, float latency, float jitter);
+
 void nw_HandleConnectResponse(ubyte *data,int len,network_address *server_addr);
 int nw_RegisterCallback(NetworkReceiveCallback nfp, ubyte id);
 void nw_HandleUnreliableData(ubyte *data,int len,network_address *from_addr);
@@ -209,16 +209,63 @@ struct renderer_lfb
 	int bytes_per_row;
 };
 
+// Reasons a batch of polygons was sent to the card, indexes tRendererStats::batch_flushes
+#define RBF_TEXTURE		0	// Texture binding or texture parameters changed
+#define RBF_SHADER		1	// A different draw shader was needed
+#define RBF_STATE		2	// Blend, depth, or other render state changed
+#define RBF_FULL		3	// The batch ran out of room
+#define RBF_FRAME		4	// End of frame, screen clear or readback
+#define RBF_EXTERNAL	5	// Another draw path needed the card
+#define NUM_RBF_REASONS	6
+
 struct tRendererStats
 {
 	int poly_count;
 	int vert_count;
 	int texture_uploads;
+	int batch_count;	// draw calls used to submit the polygons above
+	int batch_flushes[NUM_RBF_REASONS];
 };
 
 // returns rendering statistics for the frame
 void rend_GetStatistics(tRendererStats *stats);
 
+// Command types recorded by the null renderer
+#define RCMD_START_FRAME	0	// value is the clear flags
+#define RCMD_FLIP			1
+#define RCMD_DRAW_POLYGON	2	// count is the vertex count, value the bitmap handle
+#define RCMD_DRAW_MESH		3	// count is the vertex count, value the primary bitmap handle
+#define RCMD_DRAW_LINE		4
+#define RCMD_CLEAR			5	// value is the clear color, or -1 for a zbuffer clear
+#define RCMD_FILL_RECT		6	// value is the fill color
+#define RCMD_SET_STATE		7	// state is one of the RSTATE_ values below, value the new setting
+
+// States tracked by RCMD_SET_STATE
+#define RSTATE_TEXTURE_TYPE	0
+#define RSTATE_LIGHTING		1
+#define RSTATE_COLOR_MODEL	2
+#define RSTATE_ALPHA_TYPE	3
+#define RSTATE_ALPHA_VALUE	4
+#define RSTATE_ZBUFFER		5
+#define RSTATE_ZWRITE		6
+#define RSTATE_WRAP_TYPE	7
+#define RSTATE_FILTERING	8
+#define RSTATE_OVERLAY_TYPE	9
+#define RSTATE_OVERLAY_MAP	10
+#define RSTATE_FLAT_COLOR	11
+
+struct rend_command
+{
+	ubyte type;
+	ubyte state;
+	ushort count;
+	int value;
+};
+
+// Gets the commands recorded during the last full frame and returns how many there are.
+// Only the null renderer records commands, other renderers return 0.
+int rend_GetCommandLog(const rend_command **commands);
+
 void rend_SetTextureType (texture_type);
 
 // Given a handle to a bitmap and nv point vertices, draws a 3D polygon
@@ -23,8 +23,7 @@
 #define USE_RTP
 #endif
 
-#if defined(__LINUX__) || defined(MACINTOSH)
-//#if defined(__LINUX__)
+#if defined(MACINTOSH)
 	#ifdef USE_RTP
 		#undef USE_RTP	//no rtp for now
 	#endif
@@ -84,6 +83,10 @@ typedef struct{
 	int	texture_uploads;
 	int polys_drawn;
 	int fvi_calls;
+	int pose_cache_hits;
+	int pose_cache_misses;
+	int ai_vis_batch_hits;
+	int ai_vis_batch_misses;
 	float frame_time;							//how long the frame took.  A float because it's already calc'd so we might as well save it
 }tRTFrameInfo;
 
@@ -257,6 +260,23 @@ void rtp_RecordFrame
 */
 void rtp_RecordFrame(void);
 
+/*
+void rtp_StartBenchmark
+	Starts recording every frame until rtp_WriteBenchmark is called.  Unlike rtp_StartLog
+	there is no limit on how many frames are kept
+*/
+void rtp_StartBenchmark(void);
+
+/*
+bool rtp_WriteBenchmark
+	Stops a benchmark started with rtp_StartBenchmark and writes out every frame it recorded,
+	followed by the min, average, percentiles and max of each counter.  Times are written in
+	milliseconds.  If filename ends in .json everything goes into one JSON file, otherwise the
+	frames are written as CSV and the summary goes next to it in <name>_summary.csv
+	Returns false if nothing could be written
+*/
+bool rtp_WriteBenchmark(const char *filename);
+
 /*
 INT64 rtp_GetClock
 	Returns the current hi-resolution clock value...no checking for overflow
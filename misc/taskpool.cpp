@@ -0,0 +1,168 @@
+/*
+* Descent 3: Piccu Engine
+* Copyright (C) 2024 SaladBadger
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+#include <deque>
+#include <algorithm>
+
+#include "TaskSystem.h"
+
+#define MAX_TASK_WORKERS	15
+
+//A task_ParallelFor call in progress
+struct tParallelJob
+{
+	void (*func)(int index, void *parm);
+	void *parm;
+	int count;
+	std::atomic<int> next;			//next index to hand out
+	std::atomic<int> finished;		//number of indices that have been run
+	int users;							//workers running indices of this job.  Protected by Task_mutex
+};
+
+static std::vector<std::thread> Task_workers;
+static std::deque<tParallelJob *> Task_jobs;		//jobs that still have indices to hand out
+static std::mutex Task_mutex;
+static std::condition_variable Task_wake;			//signaled when a job is queued, or the pool is closing
+static std::condition_variable Task_done;			//signaled when a worker stops running a job
+static bool Task_quit = false;
+static bool Task_exit_registered = false;
+
+//Runs indices of a job until they've all been handed out
+static void task_RunJob(tParallelJob *job)
+{
+	int i, done = 0;
+	while ((i = job->next++) < job->count)
+	{
+		job->func(i, job->parm);
+		done++;
+	}
+	if (done)
+		job->finished += done;
+}
+
+static void task_WorkerThread()
+{
+	std::unique_lock<std::mutex> lock(Task_mutex);
+	for (;;)
+	{
+		Task_wake.wait(lock, [] { return Task_quit || !Task_jobs.empty(); });
+		if (Task_quit)
+			return;
+
+		tParallelJob *job = Task_jobs.front();
+		//Once every index has been handed out there's nothing left for anyone to pick up
+		if (job->next >= job->count)
+		{
+			Task_jobs.pop_front();
+			continue;
+		}
+
+		job->users++;
+		lock.unlock();
+		task_RunJob(job);
+		lock.lock();
+		job->users--;
+		Task_done.notify_all();
+	}
+}
+
+//	starts the worker threads.  num_threads==-1 picks one per CPU, less one for the main thread.
+void task_InitPool(int num_threads)
+{
+	if (!Task_workers.empty())
+		task_ClosePool();
+
+	if (num_threads < 0)
+		num_threads = (int)std::thread::hardware_concurrency() - 1;
+	if (num_threads > MAX_TASK_WORKERS)
+		num_threads = MAX_TASK_WORKERS;
+
+	Task_quit = false;
+	for (int i = 0; i < num_threads; i++)
+		Task_workers.emplace_back(task_WorkerThread);
+
+	//The threads have to be joined before the static thread list goes away
+	if (!Task_exit_registered)
+	{
+		atexit(task_ClosePool);
+		Task_exit_registered = true;
+	}
+}
+
+//	stops the worker threads.
+void task_ClosePool()
+{
+	{
+		std::lock_guard<std::mutex> lock(Task_mutex);
+		Task_quit = true;
+	}
+	Task_wake.notify_all();
+	for (std::thread &worker : Task_workers)
+		worker.join();
+	Task_workers.clear();
+}
+
+//	returns the number of worker threads
+int task_GetNumWorkers()
+{
+	return (int)Task_workers.size();
+}
+
+//	calls func(index,parm) for every index from 0 to count-1, spread across the pool
+void task_ParallelFor(int count, void (*func)(int index, void *parm), void *parm)
+{
+	if (count <= 0)
+		return;
+
+	if (Task_workers.empty() || count == 1)
+	{
+		for (int i = 0; i < count; i++)
+			func(i, parm);
+		return;
+	}
+
+	tParallelJob job;
+	job.func = func;
+	job.parm = parm;
+	job.count = count;
+	job.next = 0;
+	job.finished = 0;
+	job.users = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(Task_mutex);
+		Task_jobs.push_back(&job);
+	}
+	Task_wake.notify_all();
+
+	//Help out rather than sit idle
+	task_RunJob(&job);
+
+	//Wait for the workers to finish their indices, and make sure none of them can still see the job
+	std::unique_lock<std::mutex> lock(Task_mutex);
+	Task_done.wait(lock, [&job] { return (job.finished == job.count) && (job.users == 0); });
+	std::deque<tParallelJob *>::iterator it = std::find(Task_jobs.begin(), Task_jobs.end(), &job);
+	if (it != Task_jobs.end())
+		Task_jobs.erase(it);
+}
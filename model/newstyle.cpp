@@ -954,149 +954,65 @@ void BuildModelAngleMatrix( matrix *mat, angle ang,vector *axis);
 void StartLightInstance (vector *,matrix *);
 void DoneLightInstance();
 
+static vector Deformed_model_points[MAX_POLYGON_VECS];
+
 // Rotates all of the points of a submodel, plus supplies color info 
 void RotateModelPoints (poly_model *pm,bsp_info *sm)
 {
+	vector *verts=sm->verts;
 
-	// Figure out lighting
-	if (Polymodel_light_type==POLYMODEL_LIGHTING_STATIC)
+	// Jig the points if deforming
+	if ((Polymodel_use_effect && (Polymodel_effect.type & PEF_DEFORM)) || (sm->flags & SOF_JITTER))
 	{
-		if ((Polymodel_use_effect && (Polymodel_effect.type & PEF_DEFORM)) || (sm->flags & SOF_JITTER))
+		for (int i=0;i<sm->nverts;i++)
 		{
-			for (int i=0;i<sm->nverts;i++)
-			{
-				vector vec=sm->verts[i];
-				
-				float val=((ps_rand()%1000)-500.0)/500.0;
-				vec*=1.0+(Polymodel_effect.deform_range*val);
+			vector vec=sm->verts[i];
+			
+			float val=((ps_rand()%1000)-500.0)/500.0;
+			vec*=1.0+(Polymodel_effect.deform_range*val);
 
-				g3_RotatePoint(&Robot_points[i],&vec);
-			}
-		}
-		else
-		{
-			for (int i=0;i<sm->nverts;i++)
-				g3_RotatePoint(&Robot_points[i],&sm->verts[i]);
+			Deformed_model_points[i]=vec;
 		}
+		verts=Deformed_model_points;
 	}
-	else if (Polymodel_light_type==POLYMODEL_LIGHTING_LIGHTMAP)
-	{
-		if ((Polymodel_use_effect && (Polymodel_effect.type & PEF_DEFORM)) || (sm->flags & SOF_JITTER))
-		{
-			for (int i=0;i<sm->nverts;i++)
-			{
-				vector vec=sm->verts[i];
-				float val=((ps_rand()%1000)-500.0)/500.0;
-				vec*=1.0+(Polymodel_effect.deform_range*val);
 
-				g3_RotatePoint(&Robot_points[i],&vec);
+	g3_RotatePointArray(Robot_points,verts,sm->nverts);
 
-				Robot_points[i].p3_r=1.0;
-				Robot_points[i].p3_g=1.0;
-				Robot_points[i].p3_b=1.0;
-			}	
-		}
-		else
+	// Figure out lighting
+	if (Polymodel_light_type==POLYMODEL_LIGHTING_LIGHTMAP)
+	{
+		for (int i=0;i<sm->nverts;i++)
 		{
-			for (int i=0;i<sm->nverts;i++)
-			{
-				g3_RotatePoint(&Robot_points[i],&sm->verts[i]);
-				Robot_points[i].p3_r=1.0;
-				Robot_points[i].p3_g=1.0;
-				Robot_points[i].p3_b=1.0;
-			}
+			Robot_points[i].p3_r=1.0;
+			Robot_points[i].p3_g=1.0;
+			Robot_points[i].p3_b=1.0;
 		}
 	}
 	else if (Polymodel_light_type==POLYMODEL_LIGHTING_GOURAUD)
 	{
 		if (Polymodel_use_effect && Polymodel_effect.type & PEF_COLOR)
 		{	
-			if ((Polymodel_use_effect && (Polymodel_effect.type & PEF_DEFORM)) || (sm->flags & SOF_JITTER))
+			for (int i=0;i<sm->nverts;i++)
 			{
-				for (int i=0;i<sm->nverts;i++)
-				{
-					vector vec=sm->verts[i];
-					float val=((ps_rand()%1000)-500.0)/500.0;
-					vec*=1.0+(Polymodel_effect.deform_range*val);
-
-					g3_RotatePoint(&Robot_points[i],&vec);
-
-					vector normvec=sm->vertnorms[i];
-					val=(-vm_DotProduct (Polymodel_light_direction,&normvec)+1.0)/2;
+				vector normvec=sm->vertnorms[i];
+				float val=(-vm_DotProduct (Polymodel_light_direction,&normvec)+1.0)/2;
 					
-					Robot_points[i].p3_r=Polymodel_effect.r*val*Polylighting_static_red;
-					Robot_points[i].p3_g=Polymodel_effect.g*val*Polylighting_static_green;
-					Robot_points[i].p3_b=Polymodel_effect.b*val*Polylighting_static_blue;
-				}
-			}
-			else
-			{
-				if ((Polymodel_use_effect && (Polymodel_effect.type & PEF_DEFORM)) || (sm->flags & SOF_JITTER))
-				{
-					for (int i=0;i<sm->nverts;i++)
-					{
-						vector vec=sm->verts[i];
-						float val=((ps_rand()%1000)-500.0)/500.0;
-						vec*=1.0+(Polymodel_effect.deform_range*val);
-
-						g3_RotatePoint(&Robot_points[i],&vec);
-
-						vector normvec=sm->vertnorms[i];
-						val=(-vm_DotProduct (Polymodel_light_direction,&normvec)+1.0)/2;
-							
-						Robot_points[i].p3_r=Polymodel_effect.r*val*Polylighting_static_red;
-						Robot_points[i].p3_g=Polymodel_effect.g*val*Polylighting_static_green;
-						Robot_points[i].p3_b=Polymodel_effect.b*val*Polylighting_static_blue;
-					}
-				}
-				else
-				{
-					for (int i=0;i<sm->nverts;i++)
-					{
-						g3_RotatePoint(&Robot_points[i],&sm->verts[i]);
-						vector normvec=sm->vertnorms[i];
-						float val=(-vm_DotProduct (Polymodel_light_direction,&normvec)+1.0)/2;
-							
-						Robot_points[i].p3_r=Polymodel_effect.r*val*Polylighting_static_red;
-						Robot_points[i].p3_g=Polymodel_effect.g*val*Polylighting_static_green;
-						Robot_points[i].p3_b=Polymodel_effect.b*val*Polylighting_static_blue;
-					}
-				}
+				Robot_points[i].p3_r=Polymodel_effect.r*val*Polylighting_static_red;
+				Robot_points[i].p3_g=Polymodel_effect.g*val*Polylighting_static_green;
+				Robot_points[i].p3_b=Polymodel_effect.b*val*Polylighting_static_blue;
 			}
 		}
 		else
 		{
-			if ((Polymodel_use_effect && (Polymodel_effect.type & PEF_DEFORM)) || (sm->flags & SOF_JITTER))
-			{
-				for (int i=0;i<sm->nverts;i++)
-				{
-					vector vec=sm->verts[i];
-					float val=((ps_rand()%1000)-500.0)/500.0;
-					vec*=1.0+(Polymodel_effect.deform_range*val);
-
-					g3_RotatePoint(&Robot_points[i],&vec);
-					vector normvec=sm->vertnorms[i];
-					val=(-vm_DotProduct (Polymodel_light_direction,&normvec)+1.0)/2;
-							
-					Robot_points[i].p3_r=val*Polylighting_static_red;
-					Robot_points[i].p3_g=val*Polylighting_static_green;
-					Robot_points[i].p3_b=val*Polylighting_static_blue;
-				}
-			}
-			else
+			for (int i=0;i<sm->nverts;i++)
 			{
-				for (int i=0;i<sm->nverts;i++)
-				{
-					g3_RotatePoint(&Robot_points[i],&sm->verts[i]);
-					vector normvec=sm->vertnorms[i];
-					float val=(-vm_DotProduct (Polymodel_light_direction,&normvec)+1.0)/2;
+				vector normvec=sm->vertnorms[i];
+				float val=(-vm_DotProduct (Polymodel_light_direction,&normvec)+1.0)/2;
 			
-					Robot_points[i].p3_r=val*Polylighting_static_red;
-					Robot_points[i].p3_g=val*Polylighting_static_green;
-					Robot_points[i].p3_b=val*Polylighting_static_blue;
-				}
+				Robot_points[i].p3_r=val*Polylighting_static_red;
+				Robot_points[i].p3_g=val*Polylighting_static_green;
+				Robot_points[i].p3_b=val*Polylighting_static_blue;
 			}
-		
 		}
 	}
 
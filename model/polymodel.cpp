@@ -33,6 +33,7 @@
 #include <string.h>
 #include "robotfire.h"
 #include "mem.h"
+#include "rtperformance.h"
 
 int Num_poly_models=0;
 poly_model Poly_models[MAX_POLY_MODELS];
@@ -74,6 +75,37 @@ lightmap_object *Polylighting_lightmap_object;
 
 vector *Polymodel_light_direction,Polymodel_fog_plane,Polymodel_specular_pos,Polymodel_fog_portal_vert,Polymodel_bump_pos;
 
+// Cache of submodel poses, so a pose that is set more than once (to draw an object, find its gun
+// points and collide with it) is only worked out once.  A pose only depends on the model, the
+// normalized times, the submodels being set and, for models with auto-rotators, Gametime.
+#define POSE_CACHE_SIZE		128		// Must be a power of 2
+
+typedef struct
+{
+	bool used;
+	bool uses_gametime;						// The model has auto-rotators
+	int model_num;
+	uint subobj_flags;
+	float gametime;
+	uint have_orient;							// Submodels whose orient has been worked out
+	float normalized_time[MAX_SUBOBJECTS];
+	angvec angs[MAX_SUBOBJECTS];
+	vector mod_pos[MAX_SUBOBJECTS];
+	matrix orient[MAX_SUBOBJECTS];		// Transposed rotation of each submodel
+} pose_cache_entry;
+
+static pose_cache_entry Pose_cache[POSE_CACHE_SIZE];
+
+// Forgets the cached poses of a model
+static void PoseCacheFlushModel (int model_num)
+{
+	for (int i=0;i<POSE_CACHE_SIZE;i++)
+	{
+		if (Pose_cache[i].model_num==model_num)
+			Pose_cache[i].used=false;
+	}
+}
+
 int findtextbmpname = 0;
 int findtextname = 0;
 
@@ -156,6 +188,8 @@ int AllocPolyModel ()
 void FreePolymodelData (int i)
 {
 	int t;
+
+	PoseCacheFlushModel (i);
 	
 	for (t=0;t<Poly_models[i].n_models;t++)
 	{
@@ -772,6 +806,9 @@ int ReadNewModelFile (int polynum,CFILE *infile)
 	int timed=0;
 
 	ASSERT (pm->new_style);
+
+	// Any poses cached for whatever was in this slot are no good now
+	PoseCacheFlushModel (polynum);
 	
 	id = cf_ReadInt(infile);
 
@@ -2476,22 +2513,120 @@ void SetModelAnglesAndPosTimed (poly_model *po,float *normalized_time,uint subob
 	}
 }
 
-// Sets the position and rotation of a polymodel.  Used for rendering and collision detection
-void SetModelAnglesAndPos (poly_model *po,float *normalized_time,uint subobj_flags)
+// Returns which cache entry a pose goes in
+static int PoseCacheSlot (int model_num,float *normalized_time,int n_models,uint subobj_flags)
+{
+	uint hash=(model_num*2654435761u) ^ subobj_flags;
+
+	for (int i=0;i<n_models;i++)
+	{
+		uint bits;
+		memcpy (&bits,&normalized_time[i],sizeof(bits));
+		hash=(hash ^ bits)*16777619u;
+	}
+
+	return (hash ^ (hash>>16)) & (POSE_CACHE_SIZE-1);
+}
+
+// Sets the position and rotation of a polymodel, using the pose cache if it can.  Returns the
+// cache entry for the pose, or NULL if the pose can't be cached.
+static pose_cache_entry *SetModelPose (poly_model *po,float *normalized_time,uint subobj_flags)
 {
+	int model_num=po-Poly_models;
+	int i;
+
 	ASSERT (!(po->flags & PMF_NOT_RESIDENT));
 
+	if (!(po->flags & PMF_TIMED))
+	{
+		// Without times, or without keyframed angles, some angles are left as they were
+		if (!normalized_time || po->num_key_angles<=0)
+		{
+			SetModelAngles(po,normalized_time);
+			SetModelInterpPos (po,normalized_time);
+			return NULL;
+		}
 
-	if (po->flags & PMF_TIMED)
+		// Untimed models always set every submodel
+		subobj_flags=0xFFFFFFFF;
+	}
+	else if (!normalized_time)
 	{
 		SetModelAnglesAndPosTimed(po,normalized_time,subobj_flags);
-		return;
+		return NULL;
 	}
+
+	pose_cache_entry *pc=&Pose_cache[PoseCacheSlot (model_num,normalized_time,po->n_models,subobj_flags)];
+
+	if (pc->used && pc->model_num==model_num && pc->subobj_flags==subobj_flags &&
+		 (!pc->uses_gametime || pc->gametime==Gametime) &&
+		 !memcmp (pc->normalized_time,normalized_time,po->n_models*sizeof(float)))
+	{
+		for (i=0;i<po->n_models;i++)
+		{
+			if (subobj_flags & (1<<i))
+			{
+				po->submodel[i].angs=pc->angs[i];
+				po->submodel[i].mod_pos=pc->mod_pos[i];
+			}
+		}
+
+		RTP_INCRVALUE(pose_cache_hits,1);
+		return pc;
+	}
+
+	RTP_INCRVALUE(pose_cache_misses,1);
+
+	if (po->flags & PMF_TIMED)
+		SetModelAnglesAndPosTimed(po,normalized_time,subobj_flags);
 	else
 	{
 		SetModelAngles(po,normalized_time);
 		SetModelInterpPos (po,normalized_time);
+	}
 
+	pc->used=true;
+	pc->uses_gametime=false;
+	pc->model_num=model_num;
+	pc->subobj_flags=subobj_flags;
+	pc->gametime=Gametime;
+	pc->have_orient=0;
+	memcpy (pc->normalized_time,normalized_time,po->n_models*sizeof(float));
+
+	for (i=0;i<po->n_models;i++)
+	{
+		if (po->submodel[i].flags & SOF_ROTATE)
+			pc->uses_gametime=true;
+
+		pc->angs[i]=po->submodel[i].angs;
+		pc->mod_pos[i]=po->submodel[i].mod_pos;
+	}
+
+	return pc;
+}
+
+// Sets the position and rotation of a polymodel.  Used for rendering and collision detection
+void SetModelAnglesAndPos (poly_model *po,float *normalized_time,uint subobj_flags)
+{
+	SetModelPose (po,normalized_time,subobj_flags);
+}
+
+// Gets the transposed rotation of a submodel from its current angles
+static void GetSubmodelOrient (matrix *m,poly_model *pm,pose_cache_entry *pc,int mn)
+{
+	if (pc && (pc->have_orient & (1<<mn)))
+	{
+		*m=pc->orient[mn];
+		return;
+	}
+
+	vm_AnglesToMatrix(m, pm->submodel[mn].angs.p,pm->submodel[mn].angs.h, pm->submodel[mn].angs.b);
+	vm_TransposeMatrix(m);
+
+	if (pc)
+	{
+		pc->orient[mn]=*m;
+		pc->have_orient|=(1<<mn);
 	}
 }
 
@@ -2952,7 +3087,7 @@ void GetPolyModelPointInWorld (vector *dest,poly_model *pm, vector *wpos, matrix
 	for (i=0;i<MAX_SUBOBJECTS;i++)
 		normalized_time[i]=0.0;
 
-	SetModelAnglesAndPos (pm,normalized_time);
+	pose_cache_entry *pc=SetModelPose (pm,normalized_time,0xFFFFFFFF);
 	
 	vector pnt    = *pos;
 	int mn     = subnum;
@@ -2968,8 +3103,7 @@ void GetPolyModelPointInWorld (vector *dest,poly_model *pm, vector *wpos, matrix
 	{
 		vector tpnt;
 
-		vm_AnglesToMatrix(&m, pm->submodel[mn].angs.p,pm->submodel[mn].angs.h, pm->submodel[mn].angs.b);
-		vm_TransposeMatrix(&m);
+		GetSubmodelOrient (&m,pm,pc,mn);
 
 		tpnt    = pnt * m;
 
@@ -3001,7 +3135,7 @@ void GetPolyModelPointInWorld (vector *dest,poly_model *pm, vector *wpos, matrix
 	if (!pm->new_style)
 		return;
 
-	SetModelAnglesAndPos (pm,normalized_time);
+	pose_cache_entry *pc=SetModelPose (pm,normalized_time,0xFFFFFFFF);
 	
 	vector pnt    = *pos;
 	int mn     = subnum;
@@ -3017,8 +3151,7 @@ void GetPolyModelPointInWorld (vector *dest,poly_model *pm, vector *wpos, matrix
 	{
 		vector tpnt;
 
-		vm_AnglesToMatrix(&m, pm->submodel[mn].angs.p,pm->submodel[mn].angs.h, pm->submodel[mn].angs.b);
-		vm_TransposeMatrix(&m);
+		GetSubmodelOrient (&m,pm,pc,mn);
 
 		tpnt    = pnt * m;
 
@@ -161,12 +161,7 @@ typedef struct network_packet_buffer
 	ubyte		data[MAX_PACKET_SIZE];
 } network_packet_buffer;
 
-#define MAX_PACKET_BUFFERS		96
-
-static network_packet_buffer Packet_buffers[MAX_PACKET_BUFFERS];		// buffer to hold packets sent to us
-static short Packet_free_list[MAX_PACKET_BUFFERS];							// contains id's of free packet buffers
-static int Num_packet_buffers;
-static int Largest_packet_index = 0;
+#define MAX_PACKET_BUFFERS		128		// Must be a power of 2
 
 int Uncompressed_outgoing_data_len = 0;
 int Compressed_outgoing_data_len = 0;
@@ -194,11 +189,12 @@ int Net_connect_sequence = R_NET_SEQUENCE_NONE;
 // PACKET BUFFERING FUNCTIONS
 //
 
-// a sequence number of -1 will indicate that this packet is not valid
+// Buffered packets are kept in a ring, oldest first, so adding and removing one doesn't have to
+// search the buffers
 network_packet_buffer Psnet_buffers[MAX_PACKET_BUFFERS];
 int Psnet_seq_number = 0;
-int Psnet_lowest_id = 0;
-int Psnet_highest_id = 0;
+int Psnet_head = 0;		// Index of the oldest packet
+int Psnet_count = 0;		// Number of packets in the ring
 
 
 //Reliable UDP stuff
@@ -218,13 +214,6 @@ typedef struct
 }reliable_header;
 
 #define RELIABLE_PACKET_HEADER_ONLY_SIZE (sizeof(reliable_header)-NETBUFFERSIZE)
-#define MAX_PING_HISTORY	10
-
-typedef struct
-{
-	ubyte buffer[NETBUFFERSIZE];
-
-}reliable_net_sendbuffer;
 
 typedef struct
 {
@@ -246,37 +235,743 @@ unsigned int serverconn = UINT_MAX;
 #pragma pack()
 #endif
 
+#define RELIABLE_RECV_SLOTS		256					// Receive ring size.  Must be a power of 2 bigger than MAXNETBUFFERS.
+#define RELIABLE_MIN_SEND_SLOTS	64						// Must be a power of 2
+#define RELIABLE_MAX_SEND_SLOTS	1024					// Most packets that can wait to be acked or sent
+#define RELIABLE_MAX_IN_FLIGHT	(MAXNETBUFFERS-2)	// How far past the oldest unacked packet the peer will buffer
+#define RELIABLE_INITIAL_CWND		16
+#define RELIABLE_MIN_CWND			8
+#define RELIABLE_MAX_RTO			(NETRETRYTIME*4)
+#define RELIABLE_RTO_GRANULARITY	.01f
+#define RELIABLE_DUP_THRESH		3						// Later packets acked before we call one lost
+#define RELIABLE_SACK_BITS			32
+#define RELIABLE_SACK_SIZE			10						// Ack data with the receive base and mask after the sequence
+
+// Flags for a packet in the send window
+#define RSF_QUEUED	1		// Holds a packet that hasn't been acked
+#define RSF_SENT		2		// Has been sent at least once
+#define RSF_LOST		4		// Needs to be sent again
+
+typedef struct
+{
+	float timesent;					// When it was last sent
+	unsigned int send_order;		// Which send of the socket it was last sent in
+	short send_len;
+	ubyte flags;
+	ubyte skips;						// Acks for packets sent after it since it was last sent
+	ubyte buffer[NETBUFFERSIZE];
+}reliable_send_slot;
+
 typedef struct
 {
 	
-	float timesent[MAXNETBUFFERS];
-	short send_len[MAXNETBUFFERS];
-	short recv_len[MAXNETBUFFERS];
+	short recv_len[RELIABLE_RECV_SLOTS];
 	float last_packet_received;								//For a given connection, this is the last packet we received
 	float last_packet_sent;
-	float pings[MAX_PING_HISTORY];
-	unsigned int num_ping_samples;
-	float mean_ping;
 	float last_sent;												//The last time we sent a packet (used for NAGLE emulation)
-	int waiting_packet_number;									//Which packet has data in it that is waiting for the interval to send
+	bool waiting_packet;											//The newest packet is waiting for the interval to send, to collect more data
+
+	//Round trip time, estimated the way TCP does it
+	unsigned int num_rtt_samples;
+	float srtt;														//Smoothed round trip time
+	float rttvar;													//Round trip time variation
+	float rto;														//How long we wait for an ack before sending again
+	int backoff;													//How many times in a row rto has run out, doubling it each time
+
+	//Congestion control
+	float cwnd;														//How many packets can be in flight
+	float ssthresh;												//cwnd grows by a packet an ack below this, and a packet a window above it
+	int pipe;														//Packets sent that haven't been acked or lost
+	int num_lost;													//Packets waiting to be sent again
+	unsigned short recover;										//Losses before this sequence number are part of the last slowdown
+	unsigned int send_count;									//Packets sent, counting resends
 
 	ushort status;													//Status of this connection
 	unsigned short oursequence;								//This is the next sequence number the application is expecting
-	unsigned short theirsequence;								//This is the next sequence number the peer is expecting
-	unsigned short rsequence[MAXNETBUFFERS];				//This is the sequence number of the given packet
+	unsigned short theirsequence;								//This is the sequence number the next new packet gets
+	unsigned short send_base;									//The oldest packet that hasn't been acked
+	unsigned short send_next;									//The next packet that has never been sent
+	unsigned short rsequence[RELIABLE_RECV_SLOTS];		//This is the sequence number of the given packet
 
-	ubyte ping_pos;
-	
 	network_address	net_addr;								//A D3 network address structure
 	network_protocol connection_type;						//IPX, IP, modem, etc.
-	reliable_net_rcvbuffer  *rbuffers[MAXNETBUFFERS];
+	reliable_net_rcvbuffer  *rbuffers[RELIABLE_RECV_SLOTS];	//Indexed by sequence number
 	SOCKADDR addr;													//SOCKADDR of our peer
-	reliable_net_sendbuffer *sbuffers[MAXNETBUFFERS];	//This is an array of pointers for quick sorting
-	unsigned short ssequence[MAXNETBUFFERS];				//This is the sequence number of the given packet
+	reliable_send_slot *sslots;								//Ring of packets from send_base to theirsequence, indexed by sequence number
+	int num_sslots;
 	ubyte send_urgent;
 }reliable_socket;
 
 reliable_socket reliable_sockets[MAXRELIABLESOCKETS];
+
+// ------------------------------------------------------------------------------------------------------
+// LINK SIMULATION
+//
+// When it's on, nw_SendWithID() drops some packets and holds the rest back for a while before
+// really sending them, so loss and lag can be tried out over loopback.
+
+#define NW_SIM_MAX_PACKETS		256
+
+typedef struct
+{
+	float due;									// When it gets sent
+	unsigned int order;						// Packets due at the same time go in the order they were sent
+	network_address to;
+	int len;
+	ubyte data[1500];							// Includes the id byte
+}nw_sim_packet;
+
+static nw_sim_packet *Nw_sim_packets = NULL;
+static int Nw_sim_num_packets = 0;
+static unsigned int Nw_sim_order = 0;
+static float Nw_sim_loss = 0;					// Fraction of packets dropped
+static float Nw_sim_latency = 0;				// Seconds every packet is held
+static float Nw_sim_jitter = 0;				// Most extra seconds a packet is held
+static bool Nw_sim_sending = false;			// Sending a held packet for real
+static unsigned int Nw_sim_seed = 1;			// Own random numbers, so the game's ps_rand() sequence doesn't change
+
+// Returns a random number from 0 to 1
+static float nw_SimRand()
+{
+	Nw_sim_seed = Nw_sim_seed * 1103515245 + 12345;
+	return (float)((Nw_sim_seed >> 16) & 0x7fff) / 32767.0f;
+}
+
+// Drops or holds a packet from nw_SendWithID().  data starts with the id byte.
+static int nw_SimQueuePacket(ubyte *data, int len, network_address *who_to)
+{
+	if (nw_SimRand() < Nw_sim_loss)
+		return 1;
+
+	if (Nw_sim_num_packets == NW_SIM_MAX_PACKETS)
+	{
+		mprintf((0, "Link simulation queue full, dropping packet\n"));
+		return 1;
+	}
+
+	nw_sim_packet *packet = &Nw_sim_packets[Nw_sim_num_packets++];
+
+	packet->due = timer_GetTime() + Nw_sim_latency + Nw_sim_jitter * nw_SimRand();
+	packet->order = Nw_sim_order++;
+	packet->to = *who_to;
+	packet->len = len;
+	memcpy(packet->data, data, len);
+
+	return 1;
+}
+
+// Sends the held packets that are due, oldest first
+static void nw_SimFlush()
+{
+	static nw_sim_packet packet;
+	static bool flushing = false;
+
+	if (!Nw_sim_packets || flushing)
+		return;
+
+	flushing = true;
+
+	for (;;)
+	{
+		float now = timer_GetTime();
+		int next = -1;
+
+		for (int i = 0; i < Nw_sim_num_packets; i++)
+		{
+			nw_sim_packet *packet = &Nw_sim_packets[i];
+
+			if ((packet->due <= now) && ((next == -1) || (packet->due < Nw_sim_packets[next].due) ||
+				((packet->due == Nw_sim_packets[next].due) && ((int)(packet->order - Nw_sim_packets[next].order) < 0))))
+				next = i;
+		}
+
+		if (next == -1)
+			break;
+
+		// Sending it can hold more packets, so take it out of the queue first
+		packet = Nw_sim_packets[next];
+		Nw_sim_packets[next] = Nw_sim_packets[--Nw_sim_num_packets];
+
+		Nw_sim_sending = true;
+		nw_SendWithID(packet.data[0], packet.data + 1, packet.len - 1, &packet.to);
+		Nw_sim_sending = false;
+	}
+
+	flushing = false;
+}
+
+// Drops the given fraction of outgoing packets and holds the rest for latency seconds plus up to
+// jitter more.  All 0 turns the simulation off, throwing away anything being held.
+void nw_SetLinkSimulation(float loss, float latency, float jitter)
+{
+	Nw_sim_loss = loss;
+	Nw_sim_latency = latency;
+	Nw_sim_jitter = jitter;
+
+	if ((loss > 0) || (latency > 0) || (jitter > 0))
+	{
+		if (!Nw_sim_packets)
+		{
+			Nw_sim_packets = (nw_sim_packet *)mem_malloc(NW_SIM_MAX_PACKETS * sizeof(nw_sim_packet));
+			Nw_sim_num_packets = 0;
+			Nw_sim_seed = 1;
+		}
+		mprintf((0, "Simulating %.0f%% packet loss and %.0f-%.0fms latency\n", loss * 100, latency * 1000, (latency + jitter) * 1000));
+	}
+	else if (Nw_sim_packets)
+	{
+		mem_free(Nw_sim_packets);
+		Nw_sim_packets = NULL;
+		Nw_sim_num_packets = 0;
+	}
+}
+
+// ------------------------------------------------------------------------------------------------------
+// RELIABLE SOCKET TIMERS
+//
+// Each connected reliable socket is in a queue ordered by when it next needs work (a resend, a
+// delayed packet, a heartbeat or a timeout), so nw_ReliableResend() only looks at the ones that
+// are due.  A socket can be queued earlier than it needs to be; it's just looked at and queued again.
+
+static int Reliable_timer_queue[MAXRELIABLESOCKETS];		// Heap of socket numbers ordered by due time
+static int Reliable_timer_queue_size = 0;
+static int Reliable_timer_index[MAXRELIABLESOCKETS];		// Where each socket is in the queue, or -1
+static float Reliable_timer_due[MAXRELIABLESOCKETS];
+
+static void nw_ReliableTimerSet(int pos, int sockid)
+{
+	Reliable_timer_queue[pos] = sockid;
+	Reliable_timer_index[sockid] = pos;
+}
+
+static void nw_ReliableTimerSiftUp(int pos)
+{
+	int sockid = Reliable_timer_queue[pos];
+
+	while (pos > 0)
+	{
+		int parent = (pos - 1) / 2;
+		if (Reliable_timer_due[Reliable_timer_queue[parent]] <= Reliable_timer_due[sockid])
+			break;
+
+		nw_ReliableTimerSet(pos, Reliable_timer_queue[parent]);
+		pos = parent;
+	}
+
+	nw_ReliableTimerSet(pos, sockid);
+}
+
+static void nw_ReliableTimerSiftDown(int pos)
+{
+	int sockid = Reliable_timer_queue[pos];
+
+	for (;;)
+	{
+		int child = pos * 2 + 1;
+		if (child >= Reliable_timer_queue_size)
+			break;
+
+		if ((child + 1 < Reliable_timer_queue_size) && (Reliable_timer_due[Reliable_timer_queue[child + 1]] < Reliable_timer_due[Reliable_timer_queue[child]]))
+			child++;
+
+		if (Reliable_timer_due[sockid] <= Reliable_timer_due[Reliable_timer_queue[child]])
+			break;
+
+		nw_ReliableTimerSet(pos, Reliable_timer_queue[child]);
+		pos = child;
+	}
+
+	nw_ReliableTimerSet(pos, sockid);
+}
+
+static void nw_ReliableTimerRemove(int sockid)
+{
+	int pos = Reliable_timer_index[sockid];
+
+	if (pos == -1)
+		return;
+
+	Reliable_timer_index[sockid] = -1;
+
+	int last = Reliable_timer_queue[--Reliable_timer_queue_size];
+	if (pos == Reliable_timer_queue_size)
+		return;
+
+	nw_ReliableTimerSet(pos, last);
+	nw_ReliableTimerSiftUp(pos);
+	nw_ReliableTimerSiftDown(Reliable_timer_index[last]);
+}
+
+// Makes sure a socket gets worked on by the given time
+static void nw_ScheduleReliable(int sockid, float when)
+{
+	if (Reliable_timer_index[sockid] == -1)
+	{
+		Reliable_timer_due[sockid] = when;
+		nw_ReliableTimerSet(Reliable_timer_queue_size++, sockid);
+		nw_ReliableTimerSiftUp(Reliable_timer_queue_size - 1);
+	}
+	else if (when < Reliable_timer_due[sockid])
+	{
+		Reliable_timer_due[sockid] = when;
+		nw_ReliableTimerSiftUp(Reliable_timer_index[sockid]);
+	}
+}
+
+// ------------------------------------------------------------------------------------------------------
+// RELIABLE SEND WINDOW
+//
+// Every packet stays in the socket's send window until the peer acks it.  Acks carry the peer's
+// first missing sequence number and a mask of the packets it has after that, so one lost ack
+// doesn't cost a resend and holes get filled in without waiting for a timeout.  The round trip
+// time is estimated the way TCP does it, and a congestion window limits how many packets are in
+// flight, shrinking when packets are lost and growing as they're acked.
+
+// Returns true if seq is in [first,last) allowing for wrap around
+static inline bool nw_SeqInRange(unsigned short seq, unsigned short first, unsigned short last)
+{
+	return (unsigned short)(seq - first) < (unsigned short)(last - first);
+}
+
+static inline reliable_send_slot *nw_SendSlot(reliable_socket *rsocket, unsigned short seq)
+{
+	return &rsocket->sslots[seq & (rsocket->num_sslots - 1)];
+}
+
+// Fills in the address to send to a reliable socket's peer
+static void nw_ReliableAddress(reliable_socket *rsocket, network_address *send_address)
+{
+	memset(send_address,0,sizeof(network_address));
+	send_address->connection_type = rsocket->connection_type;
+
+	if(NP_TCP==rsocket->connection_type)
+	{
+		SOCKADDR_IN *inaddr = (SOCKADDR_IN *)&rsocket->addr;
+		memcpy(send_address->address,&inaddr->sin_addr, 4);
+		send_address->port = htons(inaddr->sin_port);
+		send_address->connection_type = NP_TCP;
+	}
+    #if __SUPPORT_IPX
+	else if(NP_IPX==rsocket->connection_type)
+	{
+		SOCKADDR_IPX *ipxaddr = (SOCKADDR_IPX *)&rsocket->addr;
+		#if (defined(WIN32) || defined(MACINTOSH))
+		memcpy(send_address->address,ipxaddr->sa_nodenum, 6);
+		memcpy(send_address->net_id,ipxaddr->sa_netnum, 4);				
+		send_address->port = htons(ipxaddr->sa_socket);
+		#else
+		memcpy(send_address->address,ipxaddr->sipx_node, 6);
+		memcpy(send_address->net_id,&ipxaddr->sipx_network, 4);				
+		send_address->port = htons(ipxaddr->sipx_port);
+		#endif
+		send_address->connection_type = NP_IPX;
+	}
+    #endif
+}
+
+// Sets up the send window and round trip estimate for a new connection
+static void nw_InitReliableState(reliable_socket *rsocket)
+{
+	rsocket->num_rtt_samples = 0;
+	rsocket->srtt = 0;
+	rsocket->rttvar = 0;
+	rsocket->rto = NETRETRYTIME;
+	rsocket->backoff = 0;
+
+	rsocket->cwnd = RELIABLE_INITIAL_CWND;
+	rsocket->ssthresh = RELIABLE_MAX_IN_FLIGHT;
+	rsocket->pipe = 0;
+	rsocket->num_lost = 0;
+	rsocket->send_count = 0;
+	rsocket->waiting_packet = false;
+
+	rsocket->send_base = rsocket->theirsequence;
+	rsocket->send_next = rsocket->theirsequence;
+	rsocket->recover = rsocket->theirsequence;
+}
+
+// Frees the packets a reliable socket is holding
+static void nw_FreeReliableBuffers(reliable_socket *rsocket)
+{
+	for(int i=0;i<RELIABLE_RECV_SLOTS;i++)
+	{
+		if(rsocket->rbuffers[i])
+		{
+			mem_free(rsocket->rbuffers[i]);
+			rsocket->rbuffers[i] = NULL;
+		}
+	}
+
+	if(rsocket->sslots)
+	{
+		mem_free(rsocket->sslots);
+		rsocket->sslots = NULL;
+		rsocket->num_sslots = 0;
+	}
+}
+
+// Doubles the size of the send window.  Returns false if it's as big as it gets.
+static bool nw_GrowSendWindow(reliable_socket *rsocket)
+{
+	int num_sslots = rsocket->num_sslots ? (rsocket->num_sslots * 2) : RELIABLE_MIN_SEND_SLOTS;
+
+	if (num_sslots > RELIABLE_MAX_SEND_SLOTS)
+		return false;
+
+	reliable_send_slot *sslots = (reliable_send_slot *)mem_malloc(num_sslots * sizeof(reliable_send_slot));
+	if (!sslots)
+		return false;
+
+	for (int i = 0; i < num_sslots; i++)
+		sslots[i].flags = 0;
+
+	for (unsigned short seq = rsocket->send_base; seq != rsocket->theirsequence; seq++)
+		sslots[seq & (num_sslots - 1)] = *nw_SendSlot(rsocket, seq);
+
+	if (rsocket->sslots)
+		mem_free(rsocket->sslots);
+
+	rsocket->sslots = sslots;
+	rsocket->num_sslots = num_sslots;
+
+	return true;
+}
+
+// Adds a round trip time sample
+static void nw_UpdateRTT(reliable_socket *rsocket, float rtt)
+{
+	if (rsocket->num_rtt_samples == 0)
+	{
+		rsocket->srtt = rtt;
+		rsocket->rttvar = rtt / 2;
+	}
+	else
+	{
+		float err = rsocket->srtt - rtt;
+		rsocket->rttvar = (rsocket->rttvar * .75f) + (((err < 0) ? -err : err) * .25f);
+		rsocket->srtt = (rsocket->srtt * .875f) + (rtt * .125f);
+	}
+	rsocket->num_rtt_samples++;
+
+	float rto = rsocket->rttvar * 4;
+	if (rto < RELIABLE_RTO_GRANULARITY)
+		rto = RELIABLE_RTO_GRANULARITY;
+	rto += rsocket->srtt;
+
+	if (rto < MIN_NET_RETRYTIME)
+		rto = MIN_NET_RETRYTIME;
+	else if (rto > RELIABLE_MAX_RTO)
+		rto = RELIABLE_MAX_RTO;
+
+	rsocket->rto = rto;
+}
+
+// Returns how long to wait for an ack before sending a packet again
+static inline float nw_ReliableRTO(reliable_socket *rsocket)
+{
+	float rto = rsocket->rto;
+
+	for (int i = 0; (i < rsocket->backoff) && (rto < RELIABLE_MAX_RTO); i++)
+		rto *= 2;
+
+	return (rto < RELIABLE_MAX_RTO) ? rto : RELIABLE_MAX_RTO;
+}
+
+// Sends a packet in the send window, for the first time or again
+static void nw_ReliableSendPacket(reliable_socket *rsocket, unsigned short seq)
+{
+	reliable_send_slot *slot = nw_SendSlot(rsocket, seq);
+	reliable_header send_header;
+	network_address send_address;
+	int len = RELIABLE_PACKET_HEADER_ONLY_SIZE+slot->send_len;
+	float now = timer_GetTime();
+
+	ASSERT(slot->flags & RSF_QUEUED);
+
+	nw_ReliableAddress(rsocket, &send_address);
+
+	send_header.type = RNT_DATA;
+	send_header.compressed = 0;
+	send_header.seq = INTEL_SHORT(seq);
+	send_header.data_len = INTEL_SHORT(slot->send_len);
+	send_header.send_time = INTEL_FLOAT(now);
+	memcpy(send_header.data,slot->buffer,slot->send_len);
+
+	if (slot->flags & RSF_SENT)
+	{
+		if(NP_TCP==send_address.connection_type)
+		{
+			NetStatistics.tcp_total_packets_sent--;//decrement because we are going to inc
+													// in nw_SendWithID
+			NetStatistics.tcp_total_bytes_sent -= len;//see above
+			NetStatistics.tcp_total_packets_resent++;
+			NetStatistics.tcp_total_bytes_resent += len;						
+		}
+        #if __SUPPORT_IPX
+		else if(NP_IPX==send_address.connection_type)
+		{
+			NetStatistics.spx_total_packets_sent--;//decrement because we are going to inc
+													// in nw_SendWithID
+			NetStatistics.spx_total_bytes_sent -= len;//see above
+			NetStatistics.spx_total_packets_resent++;
+			NetStatistics.spx_total_bytes_resent += len;						
+		}
+        #endif
+	}
+
+	//mprintf((0,"Sending reliable packet! Sequence %d\n",seq));
+	nw_SendWithID(NWT_RELIABLE,(ubyte *)&send_header,len,&send_address);
+
+	if (slot->flags & RSF_LOST)
+		rsocket->num_lost--;
+
+	slot->flags = (slot->flags & ~RSF_LOST) | RSF_SENT;
+	slot->timesent = now;
+	slot->send_order = ++rsocket->send_count;
+	slot->skips = 0;
+
+	rsocket->pipe++;
+	rsocket->last_packet_sent = now;
+}
+
+// Sends lost packets again, then new ones, as far as the congestion window allows
+static void nw_ReliableTransmit(int sockid)
+{
+	reliable_socket *rsocket = &reliable_sockets[sockid];
+	float now = timer_GetTime();
+	bool sent = false;
+
+	// Urgent data doesn't wait to collect more
+	if (rsocket->send_urgent)
+	{
+		rsocket->waiting_packet = false;
+		rsocket->send_urgent = 0;
+	}
+
+	while (rsocket->pipe < (int)rsocket->cwnd)
+	{
+		if (rsocket->num_lost)
+		{
+			unsigned short seq;
+			for (seq = rsocket->send_base; seq != rsocket->send_next; seq++)
+			{
+				if (nw_SendSlot(rsocket, seq)->flags & RSF_LOST)
+					break;
+			}
+			ASSERT(seq != rsocket->send_next);
+
+			nw_ReliableSendPacket(rsocket, seq);
+			sent = true;
+			continue;
+		}
+
+		if (rsocket->send_next == rsocket->theirsequence)
+			break;
+
+		// Don't get further ahead of the oldest unacked packet than the peer can buffer
+		if ((unsigned short)(rsocket->send_next - rsocket->send_base) >= RELIABLE_MAX_IN_FLIGHT)
+			break;
+
+		// The newest packet waits a little to collect more data, unless the link is fast
+		if (rsocket->waiting_packet && ((unsigned short)(rsocket->send_next + 1) == rsocket->theirsequence))
+		{
+			bool fast = (rsocket->num_rtt_samples > 0) && (rsocket->srtt < R_NET_PACKET_QUEUE_TIME);
+
+			if (!fast && ((now - rsocket->last_sent) < R_NET_PACKET_QUEUE_TIME))
+			{
+				nw_ScheduleReliable(sockid, rsocket->last_sent + R_NET_PACKET_QUEUE_TIME);
+				break;
+			}
+
+			//mprintf((0,"Sending delayed packet...\n"));
+			rsocket->waiting_packet = false;
+			rsocket->last_sent = now;
+		}
+
+		nw_ReliableSendPacket(rsocket, rsocket->send_next++);
+		sent = true;
+	}
+
+	if (sent)
+		nw_ScheduleReliable(sockid, now + nw_ReliableRTO(rsocket));
+}
+
+// Slows down after losing packets, once per window
+static void nw_ReliableCongestion(reliable_socket *rsocket, unsigned short seq, bool timeout)
+{
+	if ((short)(unsigned short)(seq - rsocket->recover) < 0)
+		return;
+
+	int flight = rsocket->pipe + rsocket->num_lost;
+
+	rsocket->ssthresh = (float)(flight / 2);
+	if (rsocket->ssthresh < RELIABLE_MIN_CWND)
+		rsocket->ssthresh = RELIABLE_MIN_CWND;
+
+	rsocket->cwnd = timeout ? RELIABLE_MIN_CWND : rsocket->ssthresh;
+	rsocket->recover = rsocket->send_next;
+}
+
+// Acks a packet in the send window.  Returns the order it was last sent in, or 0 if it was
+// already acked.
+static unsigned int nw_ReliableAckPacket(reliable_socket *rsocket, unsigned short seq)
+{
+	if (!nw_SeqInRange(seq, rsocket->send_base, rsocket->send_next))
+		return 0;
+
+	reliable_send_slot *slot = nw_SendSlot(rsocket, seq);
+
+	if (!(slot->flags & RSF_QUEUED))
+		return 0;
+
+	//mprintf((0,"Received ACK %d\n",seq));
+	if (slot->flags & RSF_LOST)
+		rsocket->num_lost--;
+	else
+		rsocket->pipe--;
+
+	slot->flags = 0;
+
+	// Grow the window by a packet an ack while starting up, then by a packet a window
+	if (rsocket->cwnd < rsocket->ssthresh)
+		rsocket->cwnd += 1;
+	else
+		rsocket->cwnd += 1 / rsocket->cwnd;
+
+	if (rsocket->cwnd > RELIABLE_MAX_IN_FLIGHT)
+		rsocket->cwnd = RELIABLE_MAX_IN_FLIGHT;
+
+	return slot->send_order;
+}
+
+// Handles an ack from the peer of a connected reliable socket
+static void nw_ReliableHandleAck(int sockid, reliable_header *ack_header, int len)
+{
+	reliable_socket *rsocket = &reliable_sockets[sockid];
+	unsigned int latest_order = 0, order;
+	unsigned int sig;
+	unsigned short seq;
+	float rtt = timer_GetTime() - INTEL_FLOAT(ack_header->send_time);
+
+	//Update ping time
+	if ((rtt >= 0) && (rtt < NETTIMEOUT))
+		nw_UpdateRTT(rsocket, rtt);
+
+	if (!rsocket->sslots || (len < (int)(RELIABLE_PACKET_HEADER_ONLY_SIZE+sizeof(unsigned int))))
+		return;
+
+	memcpy(&sig,ack_header->data,sizeof(unsigned int));
+	sig = INTEL_INT(sig);
+
+	order = nw_ReliableAckPacket(rsocket, (unsigned short)sig);
+	if (order > latest_order)
+		latest_order = order;
+
+	// Newer acks also say what else the peer has
+	if ((INTEL_SHORT(ack_header->data_len) >= RELIABLE_SACK_SIZE) && (len >= (int)(RELIABLE_PACKET_HEADER_ONLY_SIZE+RELIABLE_SACK_SIZE)))
+	{
+		unsigned short base;
+		unsigned int mask;
+
+		memcpy(&base,ack_header->data+4,sizeof(unsigned short));
+		memcpy(&mask,ack_header->data+6,sizeof(unsigned int));
+		base = INTEL_SHORT(base);
+		mask = INTEL_INT(mask);
+
+		// Everything before base has arrived
+		if (nw_SeqInRange(base, rsocket->send_base + 1, rsocket->send_next + 1))
+		{
+			for (seq = rsocket->send_base; seq != base; seq++)
+			{
+				order = nw_ReliableAckPacket(rsocket, seq);
+				if (order > latest_order)
+					latest_order = order;
+			}
+		}
+
+		for (int i = 0; i < RELIABLE_SACK_BITS; i++)
+		{
+			if (mask & (1u << i))
+			{
+				order = nw_ReliableAckPacket(rsocket, base + 1 + i);
+				if (order > latest_order)
+					latest_order = order;
+			}
+		}
+	}
+
+	if (!latest_order)
+		return;
+
+	// Something new got through, so stop backing off
+	rsocket->backoff = 0;
+
+	// Packets sent before one that was just acked are probably lost once enough later ones are acked
+	for (seq = rsocket->send_base; seq != rsocket->send_next; seq++)
+	{
+		reliable_send_slot *slot = nw_SendSlot(rsocket, seq);
+
+		if (((slot->flags & (RSF_QUEUED|RSF_LOST)) != RSF_QUEUED) || (slot->send_order > latest_order))
+			continue;
+
+		if (++slot->skips >= RELIABLE_DUP_THRESH)
+		{
+			slot->flags |= RSF_LOST;
+			rsocket->pipe--;
+			rsocket->num_lost++;
+			nw_ReliableCongestion(rsocket, seq, false);
+		}
+	}
+
+	while ((rsocket->send_base != rsocket->send_next) && !(nw_SendSlot(rsocket, rsocket->send_base)->flags & RSF_QUEUED))
+		rsocket->send_base++;
+
+	nw_ReliableTransmit(sockid);
+}
+
+// Returns true if a reliable socket has the packet with the given sequence number waiting to be read
+static inline bool nw_ReliableHasPacket(reliable_socket *rsocket, unsigned short seq)
+{
+	int slot = seq & (RELIABLE_RECV_SLOTS - 1);
+	return (rsocket->rbuffers[slot] != NULL) && (rsocket->rsequence[slot] == seq);
+}
+
+// Acks a data packet, saying which other packets we have too
+static void nw_ReliableSendSack(reliable_socket *rsocket, unsigned short seq, float time_sent)
+{
+	reliable_header ack_header;
+	network_address send_address;
+	unsigned short base = rsocket->oursequence;
+	unsigned int mask = 0;
+	unsigned int sig = seq;
+
+	// Everything before the first packet we don't have has been received
+	while (nw_ReliableHasPacket(rsocket, base) && ((unsigned short)(base - rsocket->oursequence) < MAXNETBUFFERS))
+		base++;
+
+	for (int i = 0; i < RELIABLE_SACK_BITS; i++)
+	{
+		if (nw_ReliableHasPacket(rsocket, base + 1 + i))
+			mask |= (1u << i);
+	}
+
+	ack_header.type = RNT_ACK;
+	ack_header.compressed = 0;
+	ack_header.seq = 0;
+	ack_header.data_len = INTEL_SHORT((short) RELIABLE_SACK_SIZE);
+	ack_header.send_time = INTEL_FLOAT(time_sent);
+
+	sig = INTEL_INT(sig);
+	base = INTEL_SHORT(base);
+	mask = INTEL_INT(mask);
+	memcpy(ack_header.data,&sig,sizeof(unsigned int));
+	memcpy(ack_header.data+4,&base,sizeof(unsigned short));
+	memcpy(ack_header.data+6,&mask,sizeof(unsigned int));
+
+	nw_ReliableAddress(rsocket, &send_address);
+	nw_SendWithID(NWT_RELIABLE,(ubyte *)&ack_header,RELIABLE_PACKET_HEADER_ONLY_SIZE+RELIABLE_SACK_SIZE,&send_address);
+}
+
 //*******************************
 
 void CloseNetworking()
@@ -914,15 +1609,6 @@ void nw_HandleUnreliableData(ubyte *data,int len,network_address *from_addr)
 }
 
 
-// routine to "free" a packet buffer
-void nw_FreePacket( int id )
-{
-	Packet_buffers[id].sequence_number = -1;
-	Packet_free_list[ --Num_packet_buffers ] = (short)id;
-	if ( Largest_packet_index == id)
-		while ((--Largest_packet_index>0) && (Packet_buffers[Largest_packet_index].sequence_number == -1 ));
-}
-
 // nw_Recieve will call the above function to read data out of the socket.  It will then determine
 // which of the buffers we should use and pass to the routine which called us
 int nw_Receive( void * data, network_address *from_addr )
@@ -997,18 +1683,16 @@ int nw_ReceiveReliable(SOCKET socketid, ubyte *buffer, int max_len)
 	//If the buffer position is the position we are waiting for, fill in 
 	//the buffer we received in the call to this function and return true			
 
-	for(i=0;i<MAXNETBUFFERS;i++)
+	if(nw_ReliableHasPacket(rsocket,rsocket->oursequence))
 	{
-		if((rsocket->rsequence[i]==rsocket->oursequence)&&(rsocket->rbuffers[i]))
-		{
-			memcpy(buffer,rsocket->rbuffers[i]->buffer,rsocket->recv_len[i]);
-			mem_free(rsocket->rbuffers[i]);
-			rsocket->rbuffers[i] = NULL;
-			rsocket->rsequence[i] = 0;
-			//mprintf((0,"Found packet for upper layer in nw_ReceiveReliable() %d bytes. seq:%d.\n",rsocket->recv_len[i],rsocket->oursequence));
-			rsocket->oursequence++;
-			return rsocket->recv_len[i];
-		}
+		i = rsocket->oursequence & (RELIABLE_RECV_SLOTS-1);
+		memcpy(buffer,rsocket->rbuffers[i]->buffer,rsocket->recv_len[i]);
+		mem_free(rsocket->rbuffers[i]);
+		rsocket->rbuffers[i] = NULL;
+		rsocket->rsequence[i] = 0;
+		//mprintf((0,"Found packet for upper layer in nw_ReceiveReliable() %d bytes. seq:%d.\n",rsocket->recv_len[i],rsocket->oursequence));
+		rsocket->oursequence++;
+		return rsocket->recv_len[i];
 	}
 
 	return 0;
@@ -1060,6 +1744,7 @@ int nw_CheckListenSocket(network_address *from_addr)
 		if(reliable_sockets[i].status==RNF_CONNECTING)
 		{
 			reliable_sockets[i].status = RNF_CONNECTED;
+			nw_ScheduleReliable(i, timer_GetTime());
 			//memcpy(from_addr,&reliable_sockets[i].addr,sizeof(SOCKADDR));
 			mprintf((0,"New reliable connection in nw_CheckListenSocket().\n"));
 			
@@ -1111,12 +1796,7 @@ int nw_CheckListenSocket(network_address *from_addr)
 
 int nw_SendReliable(unsigned int socketid, ubyte *data, int length,bool urgent )
 {
-	int i;
-	int bytesout;
-	int use_buffer = -1;
 	reliable_socket *rsocket;
-	reliable_header send_header;
-	int send_this_packet=1;
 
 	if(length==0)
 	{
@@ -1140,7 +1820,7 @@ int nw_SendReliable(unsigned int socketid, ubyte *data, int length,bool urgent )
 		#endif
 	}
 
-	ASSERT(length<sizeof(reliable_header));
+	ASSERT(length<=NETBUFFERSIZE);
 	//nw_WorkReliable();
 	nw_DoReceiveCallbacks();
 	
@@ -1159,125 +1839,73 @@ int nw_SendReliable(unsigned int socketid, ubyte *data, int length,bool urgent )
 	}
 	if(urgent)
 		rsocket->send_urgent = 1;
-	//See if there is a packet waiting to be sent
-	if(-1 != rsocket->waiting_packet_number)
-	{
-		int pnum = rsocket->waiting_packet_number;
-		ASSERT(rsocket->sbuffers[pnum]);
-		//See if there's room for this data
-		if(sizeof(reliable_net_sendbuffer) < (rsocket->send_len[pnum]+length))
-		{
-			//Send the previous packet, then use the normal code to generate a new packet
-			mprintf((0,"Pending reliable packet buffer full, sending packet now.\n"));
-			rsocket->waiting_packet_number = -1;
-
-			use_buffer = pnum;
-			network_address send_address;
-			memset(&send_address,0,sizeof(network_address));
-			
-			memcpy(send_header.data,rsocket->sbuffers[pnum],rsocket->send_len[pnum]);
-			send_header.data_len = INTEL_SHORT(rsocket->send_len[pnum]);
-			send_header.type = RNT_DATA;
-			send_header.send_time = INTEL_FLOAT(timer_GetTime());
-
-			send_address.connection_type = rsocket->connection_type;
 
-			if(NP_TCP==rsocket->connection_type)
-			{
-				SOCKADDR_IN *inaddr = (SOCKADDR_IN *)&rsocket->addr;
-				memcpy(send_address.address,&inaddr->sin_addr, 4);
-				send_address.port = htons(inaddr->sin_port);
-				send_address.connection_type = NP_TCP;
-			}
-
-            #if __SUPPORT_IPX
-			else if(NP_IPX==rsocket->connection_type)
-			{
-				SOCKADDR_IPX *ipxaddr = (SOCKADDR_IPX *)&rsocket->addr;
-				#if (defined(WIN32) || defined(MACINTOSH))
-				memcpy(send_address.address,ipxaddr->sa_nodenum, 6);
-				memcpy(send_address.net_id,ipxaddr->sa_netnum, 4);				
-				send_address.port = htons(ipxaddr->sa_socket);
-				#else
-				memcpy(send_address.address,ipxaddr->sipx_node, 6);
-				memcpy(send_address.net_id,&ipxaddr->sipx_network, 4);
-				send_address.port = htons(ipxaddr->sipx_port);
-				#endif
-				send_address.connection_type = NP_IPX;
-			}
-            #endif
+	//See if there is a packet waiting to be sent that this will fit in
+	if(rsocket->waiting_packet)
+	{
+		reliable_send_slot *slot = nw_SendSlot(rsocket, rsocket->theirsequence-1);
 
-			//mprintf((0,"Sending reliable packet! Sequence %d\n",send_header.seq));
-			bytesout = nw_SendWithID(NWT_RELIABLE,(ubyte *)&send_header,RELIABLE_PACKET_HEADER_ONLY_SIZE+rsocket->send_len[use_buffer],&send_address);					
-				
-			if((bytesout==SOCKET_ERROR)&&(WSAEWOULDBLOCK==WSAGetLastError()))
-			{
-				//This will cause it to try to send again next frame. (or sooner)
-				rsocket->timesent[use_buffer] = timer_GetTime()-(NETRETRYTIME*4);
-			}
-			else
-			{
-				rsocket->timesent[use_buffer] = timer_GetTime();
-			}			
-		}
-		else
+		if((slot->send_len+length) <= NETBUFFERSIZE)
 		{
 			//tack this data on the end of the previous packet
 			//mprintf((0,"Appending to delayed packet...\n"));
-			ASSERT(rsocket->sbuffers[pnum]);
-			memcpy(rsocket->sbuffers[pnum]->buffer+rsocket->send_len[pnum],data,length);
-			//int msize = mem_size(rsocket->sbuffers[pnum]);
-			rsocket->send_len[pnum] += length;
-			return length;
+			memcpy(slot->buffer+slot->send_len,data,length);
+			slot->send_len += length;
 
+			if(urgent)
+				nw_ReliableTransmit(socketid);
+			return length;
 		}
+
+		//Send the previous packet as soon as we can, and start a new one
+		mprintf((0,"Pending reliable packet buffer full, sending packet now.\n"));
+		rsocket->waiting_packet = false;
 	}
 	
-	//Add the new packet to the sending list and send it.
-	for(i=0;i<MAXNETBUFFERS;i++)
+	//Add the new packet to the send window
+	if(((unsigned short)(rsocket->theirsequence - rsocket->send_base) >= rsocket->num_sslots) && !nw_GrowSendWindow(rsocket))
 	{
-		use_buffer = -1;
-		if(NULL==rsocket->sbuffers[i])
-		{
-			//mprintf((0,"Sending in nw_SendReliable() %d bytes seq=%d.\n",length,rsocket->theirsequence));
-			
-			rsocket->send_len[i] = length;
-			rsocket->sbuffers[i] = (reliable_net_sendbuffer *)mem_malloc(sizeof(reliable_net_sendbuffer));
-		
-			memcpy(rsocket->sbuffers[i]->buffer,data,length);	
+		mprintf((0,"Can't send packet because a buffer overflow nw_SendReliable(). socket = %d\n",socketid));
+		rsocket->status = RNF_BROKEN;
 
-			send_header.seq = INTEL_SHORT(rsocket->theirsequence);
-			rsocket->ssequence[i] = rsocket->theirsequence;
-						
-			use_buffer = i;
-			rsocket->waiting_packet_number = i;		
-			
-			rsocket->theirsequence++;
-			return length;
-		}		
+		//Error ("Couldn't send packet because of buffer overflow!");
+
+		//Int3();
+		return 0;
 	}
-	mprintf((0,"Can't send packet because a buffer overflow nw_SendReliable(). socket = %d\n",socketid));
-	rsocket->status = RNF_BROKEN;
-	
-	for(i=0;i<MAXNETBUFFERS;i++)
+
+	//mprintf((0,"Sending in nw_SendReliable() %d bytes seq=%d.\n",length,rsocket->theirsequence));
+	reliable_send_slot *slot = nw_SendSlot(rsocket, rsocket->theirsequence);
+
+	memcpy(slot->buffer,data,length);
+	slot->send_len = length;
+	slot->flags = RSF_QUEUED;
+	slot->skips = 0;
+
+	rsocket->theirsequence++;
+	rsocket->waiting_packet = true;
+
+	nw_ReliableTransmit(socketid);
+	return length;
+}
+
+// Empties the reliable socket timer queue, then queues every socket that's in use
+static void nw_InitReliableTimers()
+{
+	Reliable_timer_queue_size = 0;
+
+	for(int i=0;i<MAXRELIABLESOCKETS;i++)
 	{
-		if(rsocket->sbuffers[i])
-		{
-			mprintf((0,"Buffer %d: %d,%d,%d,%d,%d,%d\n",i,rsocket->sbuffers[i]->buffer[0],rsocket->sbuffers[i]->buffer[1],
-														rsocket->sbuffers[i]->buffer[2],rsocket->sbuffers[i]->buffer[3],
-														rsocket->sbuffers[i]->buffer[4],rsocket->sbuffers[i]->buffer[5]));
-		}
+		Reliable_timer_index[i] = -1;
+		if(reliable_sockets[i].status != RNF_UNUSED)
+			nw_ScheduleReliable(i, timer_GetTime());
 	}
-	
-	//Error ("Couldn't send packet because of buffer overflow!");
-
-	//Int3();
-	return 0;
 }
 
 int nw_InitReliableSocket()
 {
 	nw_RegisterCallback((NetworkReceiveCallback)nw_WorkReliable,NWT_RELIABLE);
+	nw_InitReliableTimers();
 	return 1;
 }
 void nw_SendReliableAck(SOCKADDR *raddr,unsigned int sig, network_protocol link_type,float time_sent)
@@ -1345,12 +1973,9 @@ void nw_DoNetworkIdle(void)
 void nw_WorkReliable(ubyte * data,int len,network_address *naddr)
 {
 	int i;
-	int rcode = -1;
 	short max_len = NETBUFFERSIZE;
 	static reliable_header rcv_buff;
 	static SOCKADDR rcv_addr;
-	int bytesin = 0;
-	int addrlen = sizeof(SOCKADDR);
 	unsigned int rcvid;//The id of who we actually received a packet from, as opposed to socketid parm
 
 	if(NP_TCP==naddr->connection_type)
@@ -1436,6 +2061,11 @@ void nw_WorkReliable(ubyte * data,int len,network_address *naddr)
 	network_protocol link_type = naddr->connection_type;
 	network_address d3_rcv_addr;
 	memcpy(&d3_rcv_addr,naddr,sizeof(network_address));
+	if((len<0) || (len>(int)sizeof(reliable_header)))
+	{
+		mprintf((0,"Received a %d byte reliable packet, which is too big.\n",len));
+		return;
+	}
 	memcpy((ubyte *)&rcv_buff,data,len);
 	SOCKADDR_IN *rcvaddr,*rsockaddr;
 
@@ -1472,13 +2102,12 @@ void nw_WorkReliable(ubyte * data,int len,network_address *naddr)
 						reliable_sockets[i].connection_type=link_type;
 						memcpy(&reliable_sockets[i].net_addr,naddr,sizeof(network_address));
 						memcpy(&reliable_sockets[i].addr,&rcv_addr,sizeof(SOCKADDR));
-						reliable_sockets[i].ping_pos = 0;
-						reliable_sockets[i].num_ping_samples = 0;
+						nw_InitReliableState(&reliable_sockets[i]);
 						reliable_sockets[i].status = RNF_LIMBO;
 						reliable_sockets[i].last_packet_received = timer_GetTime();
 						reliable_sockets[i].last_sent = timer_GetTime();
-						reliable_sockets[i].waiting_packet_number = -1;
 						reliable_sockets[i].send_urgent = 0;
+						nw_ScheduleReliable(i, timer_GetTime());
 
 						rsocket = &reliable_sockets[i];
 						rcvaddr = (SOCKADDR_IN *)&rcv_addr;
@@ -1536,6 +2165,7 @@ void nw_WorkReliable(ubyte * data,int len,network_address *naddr)
 							if(*acknum == (~CONNECTSEQ & 0xffff))
 							{
 								rsocket->status = RNF_CONNECTED;
+								nw_ScheduleReliable(rcvid, timer_GetTime());
 								mprintf((0,"Got ACK for IAMHERE!\n"));
 							}
 							continue;
@@ -1552,6 +2182,7 @@ void nw_WorkReliable(ubyte * data,int len,network_address *naddr)
 				if((rcv_buff.type==RNT_DATA)&&(serverconn!= UINT_MAX))
 				{
 					rsocket->status = RNF_CONNECTED;
+					nw_ScheduleReliable(rcvid, timer_GetTime());
 				}
 				else
 				{
@@ -1570,43 +2201,8 @@ void nw_WorkReliable(ubyte * data,int len,network_address *naddr)
 			}
 			if(rcv_buff.type == RNT_ACK)
 			{
-				//Update ping time
-				rsocket->num_ping_samples++;
-				
-				rsocket->pings[rsocket->ping_pos] = rsocket->last_packet_received - INTEL_FLOAT(rcv_buff.send_time);
-				//mprintf((0,"ping time: %f\n",rsocket->pings[rsocket->ping_pos]));
-				if(rsocket->num_ping_samples>=MAX_PING_HISTORY)
-				{
-					float sort_ping[MAX_PING_HISTORY];
-					for(int a=0;a<MAX_PING_HISTORY;a++)
-						sort_ping[a] = rsocket->pings[a];
-
-					qsort(sort_ping,MAX_PING_HISTORY,sizeof(float),nw_PingCompare);
-					rsocket->mean_ping = ((sort_ping[MAX_PING_HISTORY/2]+sort_ping[(MAX_PING_HISTORY/2)+1]))/2;
-					//mprintf_at((2,i+1,0,"Ping: %f  ",rsocket->mean_ping));
-
-				}
-				rsocket->ping_pos++;
-				if(rsocket->ping_pos>=MAX_PING_HISTORY)
-				{
-					rsocket->ping_pos=0;				
-				}
-				for(i=0;i<MAXNETBUFFERS;i++)
-				{
-					unsigned int *acksig = (unsigned int *)&rcv_buff.data;
-					*acksig = INTEL_INT(*acksig);
-					if(rsocket)
-						if(rsocket->sbuffers[i])
-							if(rsocket->ssequence[i]==*acksig)
-							{
-								//mprintf((0,"Received ACK %d\n",*acksig));
-								mem_free(rsocket->sbuffers[i]);
-								rsocket->sbuffers[i] = NULL;	
-								rsocket->ssequence[i] = 0;
-							}
-				}
-				//remove that packet from the send buffer
-				rsocket->last_packet_received = timer_GetTime();
+				//remove the packets it acks from the send buffer
+				nw_ReliableHandleAck(rcvid, &rcv_buff, len);
 				continue;
 			}
 
@@ -1619,67 +2215,48 @@ void nw_WorkReliable(ubyte * data,int len,network_address *naddr)
 			if(rcv_buff.type == RNT_DATA)
 			{
 				
-				//If the data is out of order by >= MAXNETBUFFERS-1 ignore that packet for now
-				int seqdelta;
-				seqdelta = INTEL_SHORT(rcv_buff.seq) - rsocket->oursequence;
-				if(seqdelta<0) seqdelta = seqdelta*-1;
-				if(seqdelta>=MAXNETBUFFERS-1)
+				unsigned short seq = INTEL_SHORT(rcv_buff.seq);
+				unsigned short seqdelta = seq - rsocket->oursequence;
+
+				if(seqdelta >= 0x8000)
+				{
+					//We already have it, so the ack must have been lost.  Ack it again.
+					mprintf((0,"Received old packet with seq of %d\n",seq));
+				}
+				else if(seqdelta>=MAXNETBUFFERS-1)
 				{
+					//If the data is out of order by >= MAXNETBUFFERS-1 ignore that packet for now
 					mprintf((0,"Received reliable packet out of order!\n"));
 					//It's out of order, so we won't ack it, which will mean we will get it again soon.
 					continue;
 				}
-				//else move data into the proper buffer position
-				int savepacket=1;
-				
-				if(rsocket->oursequence < (0xffff - (MAXNETBUFFERS-1)))
+				else if(nw_ReliableHasPacket(rsocket,seq))
 				{
-					if (rsocket->oursequence > INTEL_SHORT(rcv_buff.seq))
-					{
-						mprintf((0,"Received old packet with seq of %d\n",INTEL_SHORT(rcv_buff.seq)));
-						savepacket = 0;
-					}
-
+					//Received duplicate packet!
+					mprintf((0,"Received duplicate packet!\n"));
 				}
 				else
 				{
-					//Sequence is high, so prepare for wrap around
-					if( ((unsigned short)(INTEL_SHORT(rcv_buff.seq) + rsocket->oursequence)) > (MAXNETBUFFERS-1))
-					{
-						mprintf((0,"Received old packet with seq of %d\n",INTEL_SHORT(rcv_buff.seq)));
-						savepacket = 0;	
-					}
+					//move data into the proper buffer position
+					int slot = seq & (RELIABLE_RECV_SLOTS-1);
+					int data_len = INTEL_SHORT(rcv_buff.data_len);
+
+					ASSERT(rsocket->rbuffers[slot]==NULL);
+
+					//mprintf((0,"Got good data seq: %d\n",seq));
+					if(data_len>max_len) 
+						data_len = max_len;
+					else if(data_len<0)
+						data_len = 0;
+
+					rsocket->recv_len[slot] = data_len;
+					rsocket->rbuffers[slot] = (reliable_net_rcvbuffer *)mem_malloc(sizeof(reliable_net_rcvbuffer));
+					memcpy(rsocket->rbuffers[slot]->buffer,rcv_buff.data,data_len);	
+					rsocket->rsequence[slot] = seq;
+					//mprintf((0,"Adding packet to receive buffer in nw_ReceiveReliable().\n"));
 				}
 
-				for(i=0;i<MAXNETBUFFERS;i++)
-				{
-					if( (NULL!=rsocket->rbuffers[i]) && (rsocket->rsequence[i] == INTEL_SHORT(rcv_buff.seq)))
-					{
-						//Received duplicate packet!
-						mprintf((0,"Received duplicate packet!\n"));
-						savepacket = 0;
-					}
-				}
-				if(savepacket)
-				{
-					for(i=0;i<MAXNETBUFFERS;i++)
-					{
-						if(NULL==rsocket->rbuffers[i])
-						{
-							//mprintf((0,"Got good data seq: %d\n",rcv_buff.seq));
-							if(INTEL_SHORT(rcv_buff.data_len)>max_len) 
-								rsocket->recv_len[i] = max_len;//INTEL_SHORT(rcv_buff.data_len);
-							else 
-								rsocket->recv_len[i] = INTEL_SHORT(rcv_buff.data_len); 
-							rsocket->rbuffers[i] = (reliable_net_rcvbuffer *)mem_malloc(sizeof(reliable_net_rcvbuffer));
-							memcpy(rsocket->rbuffers[i]->buffer,rcv_buff.data,rsocket->recv_len[i]);	
-							rsocket->rsequence[i] = INTEL_SHORT(rcv_buff.seq);
-							//mprintf((0,"Adding packet to receive buffer in nw_ReceiveReliable().\n"));
-							break;
-						}
-					}
-				}
-				nw_SendReliableAck(&rsocket->addr,INTEL_SHORT(rcv_buff.seq),link_type,INTEL_FLOAT(rcv_buff.send_time));		
+				nw_ReliableSendSack(rsocket,seq,INTEL_FLOAT(rcv_buff.send_time));
 			}
 			
 		}
@@ -1741,7 +2318,7 @@ void nw_HandleConnectResponse(ubyte *data,int len,network_address *server_addr)
 						reliable_sockets[i].status = RNF_LIMBO;
 						Net_connect_socket_id = i;
 						reliable_sockets[i].last_sent = timer_GetTime();
-						reliable_sockets[i].waiting_packet_number = -1;
+						nw_InitReliableState(&reliable_sockets[i]);
 						mprintf((0,"Succesfully connected to server in nw_ConnectToServer().\n"));
 						//Now send I_AM_HERE packet
 						conn_header.type = RNT_I_AM_HERE;
@@ -1765,6 +2342,7 @@ void nw_HandleConnectResponse(ubyte *data,int len,network_address *server_addr)
 							return;
 						}
 						reliable_sockets[i].last_packet_sent = timer_GetTime();
+						nw_ScheduleReliable(i, timer_GetTime());
 						/*
 						float f;
 						f = timer_GetTime();
@@ -1886,6 +2464,40 @@ void nw_ConnectToServer(SOCKET *socket, network_address *server_addr)
 
 }
 
+// Sets up a reliable socket to a peer whose address is already known, without the connect
+// handshake.  Returns the socket, or INVALID_SOCKET if there isn't a free one.
+SOCKET nw_OpenReliableSocket(network_address *addr)
+{
+	if(Use_DirectPlay || (addr->connection_type!=NP_TCP))
+		return INVALID_SOCKET;
+
+	for(int i=1;i<MAXRELIABLESOCKETS;i++)
+	{
+		if(reliable_sockets[i].status==RNF_UNUSED)
+		{
+			reliable_socket *rsocket = &reliable_sockets[i];
+			SOCKADDR_IN *inaddr = (SOCKADDR_IN *)&rsocket->addr;
+
+			memset(rsocket,0,sizeof(reliable_socket));
+			rsocket->connection_type = NP_TCP;
+			memcpy(&rsocket->net_addr,addr,sizeof(network_address));
+			memcpy(&inaddr->sin_addr,addr->address,4);
+			inaddr->sin_port = htons(addr->port);
+
+			nw_InitReliableState(rsocket);
+			rsocket->status = RNF_CONNECTED;
+			rsocket->last_packet_received = timer_GetTime();
+			rsocket->last_packet_sent = timer_GetTime();
+			rsocket->last_sent = timer_GetTime();
+			nw_ScheduleReliable(i, timer_GetTime());
+			return i;
+		}
+	}
+
+	mprintf((0,"Out of reliable socket space in nw_OpenReliableSocket().\n"));
+	return INVALID_SOCKET;
+}
+
 void nw_CloseSocket( SOCKET *sockp )
 {
 	reliable_header diss_conn_header;
@@ -1910,22 +2522,7 @@ void nw_CloseSocket( SOCKET *sockp )
 	}
 	mprintf((0,"Closing socket %d\n",*sockp));
 	//Go through every buffer and "free it up(tm)"
-	int i;
-	for(i=0;i<MAXNETBUFFERS;i++)
-	{
-		if(reliable_sockets[*sockp].rbuffers[i])
-		{
-			mem_free(reliable_sockets[*sockp].rbuffers[i]);
-			reliable_sockets[*sockp].rbuffers[i] = NULL;
-			reliable_sockets[*sockp].rsequence[i] = 0;
-		}
-		if(reliable_sockets[*sockp].sbuffers[i])
-		{
-			mem_free(reliable_sockets[*sockp].sbuffers[i]);
-			reliable_sockets[*sockp].sbuffers[i] = NULL;
-			reliable_sockets[*sockp].rsequence[i] = 0;
-		}
-	}
+	nw_FreeReliableBuffers(&reliable_sockets[*sockp]);
 	diss_conn_header.type = RNT_DISCONNECT;
 	diss_conn_header.seq = INTEL_SHORT((short) (CONNECTSEQ));
 	diss_conn_header.data_len = 0;
@@ -1963,6 +2560,7 @@ void nw_CloseSocket( SOCKET *sockp )
 	
 	memset(&reliable_sockets[*sockp],0,sizeof(reliable_socket));
 	reliable_sockets[*sockp].status = RNF_UNUSED;
+	nw_ReliableTimerRemove(*sockp);
 	
 }
 
@@ -2100,89 +2698,73 @@ void nw_psnet_buffer_init()
 		Psnet_buffers[idx].sequence_number = -1;
 	}
 
-	// initialize the sequence #
+	// initialize the sequence # and empty the ring
 	Psnet_seq_number = 0;
-	Psnet_lowest_id = -1;
-	Psnet_highest_id = -1;
+	Psnet_head = 0;
+	Psnet_count = 0;
 }
 
 // buffer a packet (maintain order!)
 void nw_psnet_buffer_packet(ubyte *data, int length, network_address *from)
 {
 	int idx;
-	int found_buf = 0;
-	
-	// find the first empty packet
-	for(idx=0;idx<MAX_PACKET_BUFFERS;idx++)
+
+	if((length < 0) || (length > MAX_PACKET_SIZE))
 	{
-		if(Psnet_buffers[idx].sequence_number == -1){
-			found_buf = 1;
-			break;
-		}
+		mprintf((0,"WARNING - Dropping %d byte packet in psnet\n",length));
+		return;
 	}
 
-	// if we didn't find the buffer, report an overrun
-	if(!found_buf)
+	// if the ring is full, report an overrun
+	if(Psnet_count == MAX_PACKET_BUFFERS)
 	{
 		mprintf((0,"WARNING - Buffer overrun in psnet\n"));
-	} 
-	else 
-	{
-		// copy in the data
-		memcpy(Psnet_buffers[idx].data,data,length);
-		Psnet_buffers[idx].len = length;
-		memcpy(&Psnet_buffers[idx].from_addr,from,sizeof(network_address));
-		Psnet_buffers[idx].sequence_number = Psnet_seq_number;
-		
-		// keep track of the highest id#
-		Psnet_highest_id = Psnet_seq_number++;
-
-		// set the lowest id# for the first time
-		if(Psnet_lowest_id == -1)
-		{
-			Psnet_lowest_id = Psnet_highest_id;
-		}
+		return;
 	}
+
+	idx = (Psnet_head + Psnet_count) & (MAX_PACKET_BUFFERS - 1);
+
+	// copy in the data
+	memcpy(Psnet_buffers[idx].data,data,length);
+	Psnet_buffers[idx].len = length;
+	memcpy(&Psnet_buffers[idx].from_addr,from,sizeof(network_address));
+	Psnet_buffers[idx].sequence_number = Psnet_seq_number++;
+
+	Psnet_count++;
+}
+
+// removes the oldest packet from the ring
+static void nw_psnet_buffer_pop()
+{
+	Psnet_buffers[Psnet_head].sequence_number = -1;
+	Psnet_head = (Psnet_head + 1) & (MAX_PACKET_BUFFERS - 1);
+	Psnet_count--;
 }
 
 
 // get the index of the next packet in order!
 int nw_psnet_buffer_get_next_by_dpid(ubyte *data, int *length, unsigned long dpid)
 {	
-	int idx;
-	int found_buf = 0;
+	int idx = Psnet_head;
+	unsigned long *thisid;
 
 	// if there are no buffers, do nothing
-	if((Psnet_lowest_id == -1) || (Psnet_lowest_id > Psnet_highest_id))
+	if(Psnet_count == 0)
 	{
 		return 0;
 	}
 
-	// search until we find the lowest packet index id#
-	for(idx=0;idx<MAX_PACKET_BUFFERS;idx++)
-	{
-		unsigned long *thisid;
-		thisid = (unsigned long *) &Psnet_buffers[idx].from_addr.address;
-		// if we found the buffer
-		if((Psnet_buffers[idx].sequence_number == Psnet_lowest_id)&&(dpid==*thisid))
-		{
-			found_buf = 1;
-			break;
-		}
-	}
-
-	if(!found_buf)
+	// only the oldest packet can be read, and only if it's from dpid
+	thisid = (unsigned long *) &Psnet_buffers[idx].from_addr.address;
+	if(dpid != *thisid)
 		return 0;
 	
 	// copy out the buffer data
 	memcpy(data,Psnet_buffers[idx].data,Psnet_buffers[idx].len);
 	*length = Psnet_buffers[idx].len;
 	
-	// now we need to cleanup the packet list
-
 	// mark the buffer as free
-	Psnet_buffers[idx].sequence_number = -1;
-	Psnet_lowest_id++;
+	nw_psnet_buffer_pop();
 
 	return 1;
 }
@@ -2191,39 +2773,21 @@ int nw_psnet_buffer_get_next_by_dpid(ubyte *data, int *length, unsigned long dpi
 // get the index of the next packet in order!
 int nw_psnet_buffer_get_next(ubyte *data, int *length, network_address *from)
 {	
-	int idx;
-	int found_buf = 0;
+	int idx = Psnet_head;
 
 	// if there are no buffers, do nothing
-	if((Psnet_lowest_id == -1) || (Psnet_lowest_id > Psnet_highest_id))
+	if(Psnet_count == 0)
 	{
 		return 0;
 	}
 
-	// search until we find the lowest packet index id#
-	for(idx=0;idx<MAX_PACKET_BUFFERS;idx++)
-	{
-		// if we found the buffer
-		if(Psnet_buffers[idx].sequence_number == Psnet_lowest_id)
-		{
-			found_buf = 1;
-			break;
-		}
-	}
-
-	// at this point, we should _always_ have found the buffer
-	ASSERT(found_buf);
-	
 	// copy out the buffer data
 	memcpy(data,Psnet_buffers[idx].data,Psnet_buffers[idx].len);
 	*length = Psnet_buffers[idx].len;
 	memcpy(from,&Psnet_buffers[idx].from_addr,sizeof(network_address));
 
-	// now we need to cleanup the packet list
-
 	// mark the buffer as free
-	Psnet_buffers[idx].sequence_number = -1;
-	Psnet_lowest_id++;
+	nw_psnet_buffer_pop();
 
 	return 1;
 }
@@ -2612,6 +3176,180 @@ NetworkReceiveCallback nw_UnRegisterCallback(ubyte id)
 	return nfp;
 }
 
+// ------------------------------------------------------------------------------------------------------
+// BATCHED SOCKET I/O
+//
+// On Linux, datagrams are read with recvmmsg() and the packets queued between nw_BeginSendBatch()
+// and nw_EndSendBatch() are sent with sendmmsg(), so a frame's worth of packets takes a few system
+// calls instead of one for each packet.  Elsewhere the same functions fall back to recvfrom() and
+// sendto() for each packet.
+
+#if defined(__LINUX__) && !MACOSX
+#define NW_USE_MMSG
+#endif
+
+#define NW_MAX_DATAGRAM_SIZE	1500
+#define NW_BATCH_SIZE			64
+
+typedef struct nw_datagram
+{
+	SOCKADDR_IN addr;
+	int len;
+	ubyte data[NW_MAX_DATAGRAM_SIZE];
+} nw_datagram;
+
+static nw_datagram Nw_receive_batch[NW_BATCH_SIZE];
+static bool Nw_receiving = false;
+
+static nw_datagram Nw_send_batch[NW_BATCH_SIZE];
+static int Nw_send_batch_count = 0;
+static int Nw_send_batch_depth = 0;
+
+// Reads as many datagrams as will fit in batch from sock.  Returns the number read, which is less
+// than NW_BATCH_SIZE if the socket was emptied.
+static int nw_ReceiveBatch(SOCKET sock, nw_datagram *batch)
+{
+	int num;
+
+#ifdef NW_USE_MMSG
+	struct mmsghdr msgs[NW_BATCH_SIZE];
+	struct iovec iovs[NW_BATCH_SIZE];
+
+	memset(msgs, 0, sizeof(msgs));
+	for (int i = 0; i < NW_BATCH_SIZE; i++)
+	{
+		iovs[i].iov_base = batch[i].data;
+		iovs[i].iov_len = NW_MAX_DATAGRAM_SIZE;
+		msgs[i].msg_hdr.msg_name = &batch[i].addr;
+		msgs[i].msg_hdr.msg_namelen = sizeof(SOCKADDR_IN);
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	num = recvmmsg(sock, msgs, NW_BATCH_SIZE, MSG_DONTWAIT, NULL);
+	if (num == SOCKET_ERROR)
+	{
+		int x = WSAGetLastError();
+		if (x != WSAEWOULDBLOCK)
+		{
+			mprintf((0, "Read error on IP socket.  Winsock error %d \n", x));
+		}
+		return 0;
+	}
+
+	for (int i = 0; i < num; i++)
+		batch[i].len = msgs[i].msg_len;
+#else
+	for (num = 0; num < NW_BATCH_SIZE; num++)
+	{
+		socklen_t from_len = sizeof(SOCKADDR_IN);
+		int read_len = recvfrom(sock, (char *)batch[num].data, NW_MAX_DATAGRAM_SIZE, 0, (SOCKADDR *)&batch[num].addr, &from_len);
+
+		if (read_len == SOCKET_ERROR)
+		{
+			int x = WSAGetLastError();
+			if (x != WSAEWOULDBLOCK)
+			{
+				mprintf((0, "Read error on IP socket.  Winsock error %d \n", x));
+			}
+			break;
+		}
+		batch[num].len = read_len;
+	}
+#endif
+
+	return num;
+}
+
+// Sends the first num datagrams in batch on sock.  Packets the socket has no room for are dropped,
+// the same as nw_SendWithID() does.  Returns the number sent.
+static int nw_SendBatch(SOCKET sock, nw_datagram *batch, int num)
+{
+	int sent = 0;
+
+#ifdef NW_USE_MMSG
+	struct mmsghdr msgs[NW_BATCH_SIZE];
+	struct iovec iovs[NW_BATCH_SIZE];
+
+	ASSERT(num <= NW_BATCH_SIZE);
+
+	memset(msgs, 0, sizeof(mmsghdr) * num);
+	for (int i = 0; i < num; i++)
+	{
+		iovs[i].iov_base = batch[i].data;
+		iovs[i].iov_len = batch[i].len;
+		msgs[i].msg_hdr.msg_name = &batch[i].addr;
+		msgs[i].msg_hdr.msg_namelen = sizeof(SOCKADDR_IN);
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	int i = 0;
+	while (i < num)
+	{
+		int ret = sendmmsg(sock, &msgs[i], num - i, MSG_DONTWAIT);
+
+		if (ret == SOCKET_ERROR)
+		{
+			int lasterr = WSAGetLastError();
+			if (lasterr == WSAEWOULDBLOCK)
+				break;
+
+			// Skip the packet that failed and carry on with the rest
+			mprintf((0, "Couldn't send data (%d)!\n", lasterr));
+			i++;
+			continue;
+		}
+
+		i += ret;
+		sent += ret;
+	}
+#else
+	for (int i = 0; i < num; i++)
+	{
+		int ret = sendto(sock, (char *)batch[i].data, batch[i].len, 0, (SOCKADDR *)&batch[i].addr, sizeof(SOCKADDR_IN));
+
+		if (ret != SOCKET_ERROR)
+		{
+			sent++;
+			continue;
+		}
+
+		int lasterr = WSAGetLastError();
+		if (lasterr == WSAEWOULDBLOCK)
+			break;
+
+		mprintf((0, "Couldn't send data (%d)!\n", lasterr));
+	}
+#endif
+
+	return sent;
+}
+
+// Sends everything queued since nw_BeginSendBatch()
+static void nw_FlushSendBatch()
+{
+	if (Nw_send_batch_count && Sockets_initted && TCP_active)
+		nw_SendBatch(TCP_socket, Nw_send_batch, Nw_send_batch_count);
+
+	Nw_send_batch_count = 0;
+}
+
+// Queues UDP packets sent after this instead of sending them right away.  Calls can be nested.
+void nw_BeginSendBatch()
+{
+	Nw_send_batch_depth++;
+}
+
+// Sends the packets queued since the matching nw_BeginSendBatch()
+void nw_EndSendBatch()
+{
+	ASSERT(Nw_send_batch_depth > 0);
+
+	if (--Nw_send_batch_depth == 0)
+		nw_FlushSendBatch();
+}
+
 int nw_SendWithID(ubyte id,ubyte *data,int len,network_address *who_to)
 {
 	ubyte packet_data[1500];
@@ -2631,6 +3369,7 @@ int nw_SendWithID(ubyte id,ubyte *data,int len,network_address *who_to)
 	ASSERT(data);
 	ASSERT(len);
 	ASSERT(who_to);
+	ASSERT(len < NW_MAX_DATAGRAM_SIZE);
 
 	timeval timeout = {0,0};
 	
@@ -2647,6 +3386,9 @@ int nw_SendWithID(ubyte id,ubyte *data,int len,network_address *who_to)
 		return dp_DirectPlaySend(who_to,(ubyte *)data,len,false);
 	#endif
 
+	if(Nw_sim_packets && !Nw_sim_sending)
+		return nw_SimQueuePacket(packet_data,len,who_to);
+
 	//mprintf((1, "network: type %d\n", who_to->connection_type));
 	//send_sock = *Unreliable_socket;
 	switch ( who_to->connection_type ) 
@@ -2733,6 +3475,25 @@ int nw_SendWithID(ubyte id,ubyte *data,int len,network_address *who_to)
 	send_len = len;
 	send_data = (ubyte *)packet_data;
 
+	// Queue UDP packets while a batch is open.  They're dropped when they're sent if the socket
+	// is full, instead of here.
+	if (Nw_send_batch_depth && (who_to->connection_type == NP_TCP))
+	{
+		if (Nw_send_batch_count == NW_BATCH_SIZE)
+			nw_FlushSendBatch();
+
+		nw_datagram *dgram = &Nw_send_batch[Nw_send_batch_count++];
+
+		memset(&dgram->addr, 0, sizeof(SOCKADDR_IN));
+		dgram->addr.sin_family = AF_INET;
+		memcpy(&dgram->addr.sin_addr.s_addr, iaddr, 4);
+		dgram->addr.sin_port = htons(port);
+
+		memcpy(dgram->data, send_data, send_len);
+		dgram->len = send_len;
+
+		return 1;
+	}
 
 	FD_ZERO(&wfds);
 	FD_SET( send_sock, &wfds );
@@ -2807,79 +3568,70 @@ int nw_DoReceiveCallbacks(void)
 {
     #if __SUPPORT_IPX
 	SOCKADDR_IPX ipx_addr;			// IPX socket structure
-    #endif
-	SOCKADDR_IN ip_addr;				// UDP/TCP socket structure		
 	socklen_t		read_len, from_len;
-	network_address	from_addr;
-
 	ubyte packet_data[1500];
+    #endif
+	network_address	from_addr;
+	int num_read, i;
 
+	nw_SimFlush();
 	nw_ReliableResend();
 
+	// The packets are read into a shared batch, so a callback that sends reliable data (which
+	// comes back here) leaves the socket to the call that's already reading it
+	if (Nw_receiving)
+		return 0;
+
+	Nw_receiving = true;
+
 	while ( TCP_active ) 
 	{
-		// check if there is any data on the socket to be read.  The amount of data that can be 
-		// atomically read is stored in len.
-		
-#if 0
-		fd_set	rfds;
-		FD_ZERO(&rfds);
-		FD_SET( TCP_socket, &rfds );
-		timeout.tv_sec = 0;
-		timeout.tv_usec = 0;
+		// get a batch of data off the socket and process it
+		num_read = nw_ReceiveBatch(TCP_socket, Nw_receive_batch);
 
-		timeval	timeout;
-		if ( select( TCP_socket+1, &rfds, NULL, NULL, &timeout) == SOCKET_ERROR) 
+		for (i = 0; i < num_read; i++)
 		{
-			mprintf((0, "Error %d doing a socket select on IP read\n", WSAGetLastError()));
-			break;
-		}
+			nw_datagram *dgram = &Nw_receive_batch[i];
+			ubyte *packet_data = dgram->data;
 
-		// if the read file descriptor is not set, then bail!
-		if ( !FD_ISSET(TCP_socket, &rfds ) )
-			break;
-#endif
-		// get data off the socket and process
-		from_len = sizeof(SOCKADDR_IN);
-		read_len = recvfrom( TCP_socket, (char *)packet_data,1500, 0,  (SOCKADDR*)&ip_addr, &from_len );
-		
-		if ( read_len == SOCKET_ERROR ) 
-		{
-			int x = WSAGetLastError();
-			if(x!=WSAEWOULDBLOCK)
-			{
-				mprintf((0, "Read error on IP socket.  Winsock error %d \n", x));
-			}
-			break;
-		}
-		memset(&from_addr, 0x00, sizeof(network_address));
-		from_addr.connection_type = NP_TCP;
-		from_addr.port = ntohs( ip_addr.sin_port );
-		
-		#ifdef WIN32
-		memcpy(from_addr.address, &ip_addr.sin_addr.S_un.S_addr, 4);
-		#else
-		memcpy(from_addr.address, &ip_addr.sin_addr.s_addr, 4);
-		#endif
-		ubyte packet_id = (packet_data[0] & 0x0f);
-		if(Netcallbacks[packet_id])
-		{
-			//mprintf((0,"Calling network callback for id %d.\n",packet_id));
-			int rlen = read_len-1;
-			if(packet_id==NWT_UNRELIABLE)
-			{
-				NetStatistics.udp_total_packets_rec++;
-				NetStatistics.udp_total_bytes_rec+=rlen;
-			}else if(packet_id==NWT_RELIABLE)
+			if (dgram->len < 1)
+				continue;
+
+			memset(&from_addr, 0x00, sizeof(network_address));
+			from_addr.connection_type = NP_TCP;
+			from_addr.port = ntohs( dgram->addr.sin_port );
+			
+			#ifdef WIN32
+			memcpy(from_addr.address, &dgram->addr.sin_addr.S_un.S_addr, 4);
+			#else
+			memcpy(from_addr.address, &dgram->addr.sin_addr.s_addr, 4);
+			#endif
+			ubyte packet_id = (packet_data[0] & 0x0f);
+			if(Netcallbacks[packet_id])
 			{
-				NetStatistics.tcp_total_packets_rec++;
-				NetStatistics.tcp_total_bytes_rec+=rlen;
+				//mprintf((0,"Calling network callback for id %d.\n",packet_id));
+				int rlen = dgram->len-1;
+				if(packet_id==NWT_UNRELIABLE)
+				{
+					NetStatistics.udp_total_packets_rec++;
+					NetStatistics.udp_total_bytes_rec+=rlen;
+				}else if(packet_id==NWT_RELIABLE)
+				{
+					NetStatistics.tcp_total_packets_rec++;
+					NetStatistics.tcp_total_bytes_rec+=rlen;
+				}
+				
+				Netcallbacks[packet_id](packet_data+1,rlen,&from_addr);
 			}
-			
-			Netcallbacks[packet_id](packet_data+1,rlen,&from_addr);
 		}
+
+		// A short batch means the socket is empty
+		if (num_read < NW_BATCH_SIZE)
+			break;
 	}
 
+	Nw_receiving = false;
+
     #if __SUPPORT_IPX
 	while ( IPX_active )
 	{
@@ -2948,219 +3700,152 @@ int nw_DoReceiveCallbacks(void)
 
 
 //Resend any unack'd packets and send any buffered packets, heartbeats, etc.
-void nw_ReliableResend(void)
+// Does whatever a reliable socket needs done now, then queues it for the next time it needs work
+static void nw_ReliableWork(int j)
 {
-	int i,j;
-	int rcode = -1;
-	short max_len = NETBUFFERSIZE;
-	static reliable_header rcv_buff;
-	static SOCKADDR rcv_addr;
-	int bytesin = 0;
-	int addrlen = sizeof(SOCKADDR);	
-	reliable_socket *rsocket = NULL;
-	//Go through each reliable socket that is connected and do any needed work.
-	for(j=0;j<MAXRELIABLESOCKETS;j++)
-	{
-		rsocket=&reliable_sockets[j];
+	reliable_socket *rsocket = &reliable_sockets[j];
+	float now = timer_GetTime();
+	unsigned short seq;
 
-		if(serverconn== UINT_MAX)
+	if(serverconn== UINT_MAX)
+	{
+		if(rsocket->status==RNF_LIMBO)
 		{
-			if(rsocket->status==RNF_LIMBO)
-				if((timer_GetTime() - rsocket->last_packet_received)>NETTIMEOUT)
-				{
-					mprintf((0,"Reliable (but in limbo) socket (%d) timed out in nw_WorkReliable().\n",j));
-					memset(rsocket,0,sizeof(reliable_socket));
-					rsocket->status = RNF_UNUSED;//Won't work if this is an outgoing connection.
-				}
+			if((now - rsocket->last_packet_received)>NETTIMEOUT)
+			{
+				mprintf((0,"Reliable (but in limbo) socket (%d) timed out in nw_WorkReliable().\n",j));
+				nw_FreeReliableBuffers(rsocket);
+				memset(rsocket,0,sizeof(reliable_socket));
+				rsocket->status = RNF_UNUSED;//Won't work if this is an outgoing connection.
+				return;
+			}
+			nw_ScheduleReliable(j, rsocket->last_packet_received + NETTIMEOUT);
 		}
-		else
+	}
+	else
+	{
+		if(rsocket->status==RNF_LIMBO)
 		{
-			if((rsocket->status==RNF_LIMBO)&&((timer_GetTime() - first_sent_iamhere)>NETTIMEOUT))
+			if((now - first_sent_iamhere)>NETTIMEOUT)
 			{
 				rsocket->status = RNF_BROKEN;
 				mprintf((0,"Reliable socket (%d) timed out in nw_WorkReliable().\n",j));
+				return;
 			}
+			nw_ScheduleReliable(j, first_sent_iamhere + NETTIMEOUT);
 		}
-		
-		if(rsocket->status==RNF_CONNECTED)
+	}
+	
+	if(rsocket->status!=RNF_CONNECTED)
+		return;
+
+	//Anything that hasn't been acked in time is lost
+	float rto = nw_ReliableRTO(rsocket);
+	bool timed_out = false;
+
+	for(seq=rsocket->send_base;seq!=rsocket->send_next;seq++)
+	{
+		reliable_send_slot *slot = nw_SendSlot(rsocket, seq);
+
+		if(((slot->flags & (RSF_QUEUED|RSF_LOST)) == RSF_QUEUED) && ((now - slot->timesent) >= rto))
 		{
-			float retry_packet_time;
-			if((rsocket->mean_ping==0) || (rsocket->mean_ping > (NETRETRYTIME*4)))
-			{
-				retry_packet_time = NETRETRYTIME;
-			}
-			else
+			//mprintf((0,"Resending reliable packet in nw_WorkReliable().\n"));
+			slot->flags |= RSF_LOST;
+			rsocket->pipe--;
+			rsocket->num_lost++;
+
+			if(!timed_out)
 			{
-				if(rsocket->mean_ping<MIN_NET_RETRYTIME)
-				{
-					retry_packet_time = (float)MIN_NET_RETRYTIME;
-					//mprintf((0,"Using retransmission time of %f\n",retry_packet_time));
-				}
-				else 
-				{
-					retry_packet_time = ((float)(float)rsocket->mean_ping * (float)1.25);
-					//mprintf((0,"Using retransmission time of %f\n",retry_packet_time));
-				}
+				nw_ReliableCongestion(rsocket, seq, true);
+				timed_out = true;
 			}
-			//Iterate through send buffers.  
-			for(i=0;i<MAXNETBUFFERS;i++)
-			{
-				if( 
-					( (i==rsocket->waiting_packet_number) 
-					&& ( (((timer_GetTime() - rsocket->last_sent) > R_NET_PACKET_QUEUE_TIME)) || ((rsocket->mean_ping>0)&&(rsocket->mean_ping<R_NET_PACKET_QUEUE_TIME)) || rsocket->send_urgent ) 
-					)
-					|| ( (rsocket->sbuffers[i]) && ((timer_GetTime() - rsocket->timesent[i]) >= retry_packet_time) )
-				  ) //Send again
-				{
-					
-					if(i==rsocket->waiting_packet_number)
-					{
-						rsocket->waiting_packet_number = -1;
-						rsocket->last_sent = timer_GetTime();
-						//mprintf((0,"Sending delayed packet...\n"));
-					}
-					reliable_header send_header;
-					//mprintf((0,"Resending reliable packet in nw_WorkReliable().\n"));
-					send_header.send_time = INTEL_FLOAT(timer_GetTime());
-					send_header.seq = INTEL_SHORT(rsocket->ssequence[i]);
-					memcpy(send_header.data,rsocket->sbuffers[i]->buffer,rsocket->send_len[i]);
-					send_header.data_len = INTEL_SHORT(rsocket->send_len[i]);
-					send_header.type = RNT_DATA;
-					
-					network_address send_address;
-					memset(&send_address,0,sizeof(network_address));
-					
-					send_address.connection_type = rsocket->connection_type;					
-					
-					if(NP_TCP==send_address.connection_type)
-					{
-						SOCKADDR_IN *inaddr = (SOCKADDR_IN *)&rsocket->addr;
-						memcpy(send_address.address,&inaddr->sin_addr, 4);
-						send_address.port = htons(inaddr->sin_port);
-						send_address.connection_type = NP_TCP;
-
-						int len = RELIABLE_PACKET_HEADER_ONLY_SIZE+rsocket->send_len[i];
-						NetStatistics.tcp_total_packets_sent--;//decrement because we are going to inc
-																// in nw_SendWithID
-						NetStatistics.tcp_total_bytes_sent -= len;//see above
-						NetStatistics.tcp_total_packets_resent++;
-						NetStatistics.tcp_total_bytes_resent += len;						
-					}
+		}
+	}
 
-                    #if __SUPPORT_IPX
-					else if(NP_IPX==send_address.connection_type)
-					{
-						SOCKADDR_IPX *ipxaddr = (SOCKADDR_IPX *)&rsocket->addr;
-						#if (defined(WIN32) || defined(MACINTOSH))
-						memcpy(send_address.address,ipxaddr->sa_nodenum, 6);
-						memcpy(send_address.net_id,ipxaddr->sa_netnum, 4);				
-						send_address.port = htons(ipxaddr->sa_socket);
-						#else
-						memcpy(send_address.address,ipxaddr->sipx_node, 6);
-						memcpy(send_address.net_id,&ipxaddr->sipx_network, 4);				
-						send_address.port = htons(ipxaddr->sipx_port);
-						#endif
-						send_address.connection_type = NP_IPX;
-
-						int len = RELIABLE_PACKET_HEADER_ONLY_SIZE+rsocket->send_len[i];
-						NetStatistics.spx_total_packets_sent--;//decrement because we are going to inc
-																// in nw_SendWithID
-						NetStatistics.spx_total_bytes_sent -= len;//see above
-						NetStatistics.spx_total_packets_resent++;
-						NetStatistics.spx_total_bytes_resent += len;						
-					}
-                    #endif
+	//Wait longer next time, like TCP
+	if(timed_out)
+		rsocket->backoff++;
 
-					//mprintf((0,"Resending reliable packet! Sequence %d\n",send_header.seq));
-					rcode = nw_SendWithID(NWT_RELIABLE,(ubyte *)&send_header,RELIABLE_PACKET_HEADER_ONLY_SIZE+rsocket->send_len[i],&send_address);
-					
-					if((rcode==SOCKET_ERROR)&&(WSAEWOULDBLOCK==WSAGetLastError()))
-					{
-						//The packet didn't get sent, flag it to try again next frame
-						rsocket->timesent[i] = timer_GetTime()-(NETRETRYTIME*4);
-					}
-					else
-					{
-						rsocket->last_packet_sent = timer_GetTime();
-						rsocket->timesent[i] = timer_GetTime();
-					}
-					
-				}
-			}
-			//We've sent all the packets, now we go out of urgent mode.
-			rsocket->send_urgent = 0;
-			if((rsocket->status==RNF_CONNECTED) && ((timer_GetTime() - rsocket->last_packet_sent)>NETHEARTBEATTIME))
-			{
-				reliable_header send_header;
-				//mprintf((0,"Resending reliable packet in nw_WorkReliable().\n"));
-				send_header.send_time = INTEL_FLOAT(timer_GetTime());
-				send_header.seq = INTEL_SHORT((short)0);
-				send_header.data_len = INTEL_SHORT((short)0);
-				send_header.type = RNT_HEARTBEAT;
-
-				rcode = -1;
-				network_address send_address;
-				memset(&send_address,0,sizeof(network_address));
-				
-				send_address.connection_type = rsocket->connection_type;					
-				
-				if(NP_TCP==send_address.connection_type)
-				{
-					SOCKADDR_IN *inaddr = (SOCKADDR_IN *)&rsocket->addr;
-					memcpy(send_address.address,&inaddr->sin_addr, 4);
-					send_address.port = htons(inaddr->sin_port);
-					send_address.connection_type = NP_TCP;
-
-					int len = RELIABLE_PACKET_HEADER_ONLY_SIZE+rsocket->send_len[i];
-					NetStatistics.tcp_total_packets_sent--;//decrement because we are going to inc
-																// in nw_SendWithID
-					NetStatistics.tcp_total_bytes_sent -= len;//see above
-					NetStatistics.tcp_total_packets_resent++;
-					NetStatistics.tcp_total_bytes_resent += len;						
-				}
+	//Send whatever the congestion window allows
+	nw_ReliableTransmit(j);
 
-                #if __SUPPORT_IPX
-				else if(NP_IPX==send_address.connection_type)
-				{
-					SOCKADDR_IPX *ipxaddr = (SOCKADDR_IPX *)&rsocket->addr;
-					#if (defined(WIN32) || defined(MACINTOSH))
-					memcpy(send_address.address,ipxaddr->sa_nodenum, 6);
-					memcpy(send_address.net_id,ipxaddr->sa_netnum, 4);				
-					send_address.port = htons(ipxaddr->sa_socket);
-					#else
-					memcpy(send_address.address,ipxaddr->sipx_node, 6);
-					memcpy(send_address.net_id,&ipxaddr->sipx_network, 4);				
-					send_address.port = htons(ipxaddr->sipx_port);
-					#endif
-					send_address.connection_type = NP_IPX;
-
-					int len = RELIABLE_PACKET_HEADER_ONLY_SIZE+rsocket->send_len[i];
-					NetStatistics.spx_total_packets_sent--;//decrement because we are going to inc
-																// in nw_SendWithID
-					NetStatistics.spx_total_bytes_sent -= len;//see above
-					NetStatistics.spx_total_packets_resent++;
-					NetStatistics.spx_total_bytes_resent += len;						
-				}
-                #endif
+	if((now - rsocket->last_packet_sent)>NETHEARTBEATTIME)
+	{
+		reliable_header send_header;
+		network_address send_address;
+		int len = RELIABLE_PACKET_HEADER_ONLY_SIZE;
 
-				rcode = nw_SendWithID(NWT_RELIABLE,(ubyte *)&send_header,RELIABLE_PACKET_HEADER_ONLY_SIZE,&send_address);
-				
+		send_header.send_time = INTEL_FLOAT(now);
+		send_header.seq = INTEL_SHORT((short)0);
+		send_header.data_len = INTEL_SHORT((short)0);
+		send_header.type = RNT_HEARTBEAT;
 
-				if((rcode!=SOCKET_ERROR)&&(WSAEWOULDBLOCK!=WSAGetLastError()))
-				{
-					//It must have been sent
-					rsocket->last_packet_sent = timer_GetTime();
-				}
-			}
+		nw_ReliableAddress(rsocket, &send_address);
 
-			if((rsocket->status==RNF_CONNECTED) && ((timer_GetTime() - rsocket->last_packet_received)>NETTIMEOUT))
-			{
-				//This socket is hosed.....inform someone?
-				mprintf((0,"Reliable Socket (%d) timed out in nw_WorkReliable().\n",j));
-				rsocket->status = RNF_BROKEN;
-			}
+		if(NP_TCP==send_address.connection_type)
+		{
+			NetStatistics.tcp_total_packets_sent--;//decrement because we are going to inc
+													// in nw_SendWithID
+			NetStatistics.tcp_total_bytes_sent -= len;//see above
+			NetStatistics.tcp_total_packets_resent++;
+			NetStatistics.tcp_total_bytes_resent += len;						
+		}
+        #if __SUPPORT_IPX
+		else if(NP_IPX==send_address.connection_type)
+		{
+			NetStatistics.spx_total_packets_sent--;//decrement because we are going to inc
+													// in nw_SendWithID
+			NetStatistics.spx_total_bytes_sent -= len;//see above
+			NetStatistics.spx_total_packets_resent++;
+			NetStatistics.spx_total_bytes_resent += len;						
 		}
+        #endif
+
+		nw_SendWithID(NWT_RELIABLE,(ubyte *)&send_header,len,&send_address);
+		rsocket->last_packet_sent = now;
+	}
+
+	if((now - rsocket->last_packet_received)>NETTIMEOUT)
+	{
+		//This socket is hosed.....inform someone?
+		mprintf((0,"Reliable Socket (%d) timed out in nw_WorkReliable().\n",j));
+		rsocket->status = RNF_BROKEN;
+		return;
+	}
+
+	//Work out when we next need to look at it
+	float next = rsocket->last_packet_sent + NETHEARTBEATTIME;
+
+	if((rsocket->last_packet_received + NETTIMEOUT) < next)
+		next = rsocket->last_packet_received + NETTIMEOUT;
+
+	for(seq=rsocket->send_base;seq!=rsocket->send_next;seq++)
+	{
+		reliable_send_slot *slot = nw_SendSlot(rsocket, seq);
+
+		if(((slot->flags & (RSF_QUEUED|RSF_LOST)) == RSF_QUEUED) && ((slot->timesent + rto) < next))
+			next = slot->timesent + rto;
+	}
+
+	nw_ScheduleReliable(j, next);
+}
+
+void nw_ReliableResend(void)
+{
+	int due[MAXRELIABLESOCKETS];
+	int num_due = 0;
+	float now = timer_GetTime();
+
+	//Take every socket that's due out of the queue first, so one that queues itself for now
+	//waits until next time
+	while(Reliable_timer_queue_size && (Reliable_timer_due[Reliable_timer_queue[0]] <= now))
+	{
+		due[num_due] = Reliable_timer_queue[0];
+		nw_ReliableTimerRemove(due[num_due++]);
 	}
+
+	for(int i=0;i<num_due;i++)
+		nw_ReliableWork(due[i]);
 }
 
 // fills in the buffer with network stats
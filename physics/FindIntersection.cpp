@@ -856,6 +856,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <memory>
+#include <algorithm>
 #include "mono.h"
 #include "findintersection.h"
 #include "pserror.h"
@@ -883,6 +885,7 @@
 // Debug performance includes (do nothing in final release)
 #ifndef NED_PHYSICS
 #include "rtperformance.h"
+#include "objgrid.h"
 #endif
 
 int FVI_counter;
@@ -892,86 +895,55 @@ int FVI_room_counter;
 // Defines and globals for fvi_FindIntersection
 //------------------------------------------------------------------------------------------
 
-#define MAX_CELLS_VISITED (TERRAIN_DEPTH * TERRAIN_WIDTH)   // Maximum terrain cells visited in one fvi call
-
 bool FVI_always_check_ceiling = false;
 
 //This doesn't really belong here, but I don't know where else to put it.
 float Ceiling_height = MAX_TERRAIN_HEIGHT;
 
-// Bit fields for quick 'already-checked' checking
-unsigned char fvi_visit_list[MAX_ROOMS/8 + 1];										// This bit-field provides a fast check if a mine segment has been visited
-unsigned char fvi_terrain_visit_list[(TERRAIN_DEPTH * TERRAIN_WIDTH)/8 + 1]; // This bit-field provides a fast check if a terrain segment has been visited
-unsigned char fvi_terrain_obj_visit_list[(TERRAIN_DEPTH * TERRAIN_WIDTH)/8 + 1]; // This bit-field provides a fast check if a terrain segment has been visited
-
-// The number rooms and terrain cells that this fvi call visited.
-int fvi_num_rooms_visited;
-int fvi_num_cells_visited;
-int fvi_num_cells_obj_visited;
-
-// Should we do a terrain check.  This flag exists because if we do a terrain check, it always does a full check. So,
-// we only have to do it once.
-bool f_check_terrain;
-bool fvi_zero_rad;
-
-// Unordered list of rooms and terrain cells that this fvi call visited.
-//DAJ changed to ushorts to save memory 
-ushort fvi_rooms_visited[MAX_ROOMS];				// This should be a small number (100 to 1000)
-ushort fvi_cells_visited[MAX_CELLS_VISITED];		// Use this so that we do not have to use 256x256 elements
-ushort fvi_cells_obj_visited[MAX_CELLS_VISITED];
-
-// Fvi wall collision stuff
-float fvi_wall_sphere_rad;
-vector fvi_wall_sphere_offset;
-vector fvi_wall_sphere_p0;
-vector fvi_wall_sphere_p1;
-
-float fvi_anim_sphere_rad;
-vector fvi_anim_sphere_offset;
-vector fvi_anim_sphere_p0;
-vector fvi_anim_sphere_p1;
-
-// Fvi information pointers.  
-fvi_info * fvi_hit_data_ptr;
-fvi_query * fvi_query_ptr;
-
-// Best collision's distance
-float fvi_collision_dist;
-
-// AABB for the movement
-vector fvi_max_xyz;
-vector fvi_min_xyz;
-vector fvi_movement_delta;
-
-// AABB for the movement
-vector fvi_wall_max_xyz;
-vector fvi_wall_min_xyz;
-
-// CHRISHACK -- Do we still need this????
-int fvi_curobj;
-int fvi_moveobj;
-
-// Recorded faces
-fvi_face_room_list Fvi_recorded_faces[MAX_RECORDED_FACES];
-int Fvi_num_recorded_faces = 0;
+// The context used by queries that don't pass one in, one per thread.  Created the first time
+// the thread does a query and freed when the thread exits.
+static thread_local std::unique_ptr<fvi_context> Fvi_thread_context;
 
 //------------------------------------------------------------------------------------------
 // Some function def's
 //------------------------------------------------------------------------------------------
 
-int do_fvi_terrain();
-int fvi_room(int room_index, int from_portal, int room_obj = -1);
-void do_fvi_rooms(int initial_room_index);
+int do_fvi_terrain(fvi_context *ctx);
+int fvi_room(fvi_context *ctx, int room_index, int from_portal, int room_obj = -1);
+void do_fvi_rooms(fvi_context *ctx, int initial_room_index);
 
 //------------------------------------------------------------------------------------------
 // FVI FUNCTIONS
 //------------------------------------------------------------------------------------------
 
+// Allocates a cleared fvi context.  Safe to call from any thread.
+fvi_context *fvi_CreateContext(void)
+{
+	return new fvi_context();
+}
+
+// Frees a context from fvi_CreateContext()
+void fvi_DestroyContext(fvi_context *ctx)
+{
+	delete ctx;
+}
+
+// Returns the calling thread's own context, creating it if need be
+fvi_context *fvi_GetThreadContext(void)
+{
+	if (!Fvi_thread_context)
+		Fvi_thread_context.reset(fvi_CreateContext());
+
+	return Fvi_thread_context.get();
+}
+
 void InitFVI(void) 
 {
-	memset(fvi_terrain_visit_list, 0, (TERRAIN_DEPTH * TERRAIN_WIDTH)/8 + 1);
-	memset(fvi_terrain_obj_visit_list, 0, (TERRAIN_DEPTH * TERRAIN_WIDTH)/8 + 1);
-	memset(fvi_visit_list, 0, MAX_ROOMS/8 + 1);
+	fvi_context *ctx = fvi_GetThreadContext();
+
+	memset(ctx->terrain_visit_list, 0, (TERRAIN_DEPTH * TERRAIN_WIDTH)/8 + 1);
+	memset(ctx->terrain_obj_visit_list, 0, (TERRAIN_DEPTH * TERRAIN_WIDTH)/8 + 1);
+	memset(ctx->visit_list, 0, MAX_ROOMS/8 + 1);
 }
 
 //find the point on the specified plane where the line intersects
@@ -1733,13 +1705,13 @@ bool check_line_to_line(float *t1,float *t2,vector *p1,vector *v1,vector *p2,vec
 
 //determine if a vector intersects with an object
 //if no intersects, returns 0, else fills in intp and returns dist
-int check_vector_to_object(vector *intp, float *col_dist, vector *p0,vector *p1,float rad,object *still_obj,object *fvi_obj)
+int check_vector_to_object(fvi_context *ctx, vector *intp, float *col_dist, vector *p0,vector *p1,float rad,object *still_obj,object *fvi_obj)
 {
 	float still_size;
 	vector still_pos = still_obj->pos;
 	float total_size;
 
-	int fvi_objnum = fvi_query_ptr->thisobjnum;
+	int fvi_objnum = ctx->query_ptr->thisobjnum;
 
 	if((still_obj->flags & OF_POLYGON_OBJECT) &&
 		 still_obj->type != OBJ_POWERUP &&
@@ -1806,58 +1778,58 @@ int check_vector_to_object(vector *intp, float *col_dist, vector *p0,vector *p1,
 	return check_vector_to_sphere_1(intp, col_dist, p0, p1, &still_pos ,total_size, false, true);
 }
 
-inline void compute_movement_AABB(void)
+inline void compute_movement_AABB(fvi_context *ctx)
 {
-	const vector delta_movement = fvi_hit_data_ptr->hit_pnt - *fvi_query_ptr->p0;
+	const vector delta_movement = ctx->hit_data_ptr->hit_pnt - *ctx->query_ptr->p0;
 
-	fvi_min_xyz = fvi_max_xyz = *fvi_query_ptr->p0;
+	ctx->min_xyz = ctx->max_xyz = *ctx->query_ptr->p0;
 
 	if(delta_movement.x > 0.0f)
-		fvi_max_xyz.x += delta_movement.x;
+		ctx->max_xyz.x += delta_movement.x;
 	else
-		fvi_min_xyz.x += delta_movement.x;
+		ctx->min_xyz.x += delta_movement.x;
 
 	if(delta_movement.y > 0.0f)
-		fvi_max_xyz.y += delta_movement.y;
+		ctx->max_xyz.y += delta_movement.y;
 	else
-		fvi_min_xyz.y += delta_movement.y;
+		ctx->min_xyz.y += delta_movement.y;
 
 	if(delta_movement.z > 0.0f)
-		fvi_max_xyz.z += delta_movement.z;
+		ctx->max_xyz.z += delta_movement.z;
 	else
-		fvi_min_xyz.z += delta_movement.z;
+		ctx->min_xyz.z += delta_movement.z;
 
-	fvi_wall_min_xyz = fvi_min_xyz;
-	fvi_wall_max_xyz = fvi_max_xyz;
+	ctx->wall_min_xyz = ctx->min_xyz;
+	ctx->wall_max_xyz = ctx->max_xyz;
 
-	if(!fvi_zero_rad)
+	if(!ctx->zero_rad)
 	{
-		if(fvi_query_ptr->thisobjnum < 0)
+		if(ctx->query_ptr->thisobjnum < 0)
 		{
 			vector offset_vec;
 
-			offset_vec.x = fvi_query_ptr->rad;
-			offset_vec.y = fvi_query_ptr->rad;
-			offset_vec.z = fvi_query_ptr->rad;
+			offset_vec.x = ctx->query_ptr->rad;
+			offset_vec.y = ctx->query_ptr->rad;
+			offset_vec.z = ctx->query_ptr->rad;
 
-			fvi_min_xyz -= offset_vec;
-			fvi_max_xyz += offset_vec;
+			ctx->min_xyz -= offset_vec;
+			ctx->max_xyz += offset_vec;
 			
-			fvi_wall_min_xyz = fvi_min_xyz;
-			fvi_wall_max_xyz = fvi_max_xyz;
+			ctx->wall_min_xyz = ctx->min_xyz;
+			ctx->wall_max_xyz = ctx->max_xyz;
 		}
 		else
 		{
-			vector max_offset = Objects[fvi_query_ptr->thisobjnum].max_xyz - Objects[fvi_query_ptr->thisobjnum].pos;
-			vector min_offset = Objects[fvi_query_ptr->thisobjnum].min_xyz - Objects[fvi_query_ptr->thisobjnum].pos;
+			vector max_offset = Objects[ctx->query_ptr->thisobjnum].max_xyz - Objects[ctx->query_ptr->thisobjnum].pos;
+			vector min_offset = Objects[ctx->query_ptr->thisobjnum].min_xyz - Objects[ctx->query_ptr->thisobjnum].pos;
 
-			fvi_max_xyz += max_offset;
-			fvi_min_xyz += min_offset;
+			ctx->max_xyz += max_offset;
+			ctx->min_xyz += min_offset;
 
-//			if(!(Objects[fvi_query_ptr->thisobjnum].mtype.phys_info.flags & PF_POINT_COLLIDE_WALLS))
+//			if(!(Objects[ctx->query_ptr->thisobjnum].mtype.phys_info.flags & PF_POINT_COLLIDE_WALLS))
 			{
-				fvi_wall_min_xyz = fvi_min_xyz;
-				fvi_wall_max_xyz = fvi_max_xyz;
+				ctx->wall_min_xyz = ctx->min_xyz;
+				ctx->wall_max_xyz = ctx->max_xyz;
 			}
 		}
 	}
@@ -1877,16 +1849,16 @@ inline bool object_object_AABB(object *obj1, object *obj2)
 	return overlap;
 }
 
-inline bool object_movement_AABB(object *obj)
+inline bool object_movement_AABB(fvi_context *ctx, object *obj)
 {
 	bool overlap = true;
 
-	if(obj->max_xyz.x < fvi_min_xyz.x  ||
-      fvi_max_xyz.x  < obj->min_xyz.x ||
-      obj->max_xyz.z < fvi_min_xyz.z  ||
-      fvi_max_xyz.z  < obj->min_xyz.z ||
-      obj->max_xyz.y < fvi_min_xyz.y  ||
-      fvi_max_xyz.y  < obj->min_xyz.y) overlap = false;
+	if(obj->max_xyz.x < ctx->min_xyz.x  ||
+      ctx->max_xyz.x  < obj->min_xyz.x ||
+      obj->max_xyz.z < ctx->min_xyz.z  ||
+      ctx->max_xyz.z  < obj->min_xyz.z ||
+      obj->max_xyz.y < ctx->min_xyz.y  ||
+      ctx->max_xyz.y  < obj->min_xyz.y) overlap = false;
 
 	return overlap;
 }
@@ -1905,16 +1877,16 @@ inline bool object_room_AABB(object *obj, face *room_face)
 	return overlap;
 }
 
-inline bool room_movement_AABB(face *room_face)
+inline bool room_movement_AABB(fvi_context *ctx, face *room_face)
 {
 	bool overlap = true;
 
-	if(fvi_wall_max_xyz.y        < room_face->min_xyz.y  ||
-      room_face->max_xyz.y < fvi_wall_min_xyz.y         ||
-		fvi_wall_max_xyz.x        < room_face->min_xyz.x  ||
-      room_face->max_xyz.x < fvi_wall_min_xyz.x         ||
-      fvi_wall_max_xyz.z        < room_face->min_xyz.z  ||
-      room_face->max_xyz.z < fvi_wall_min_xyz.z) overlap = false;
+	if(ctx->wall_max_xyz.y        < room_face->min_xyz.y  ||
+      room_face->max_xyz.y < ctx->wall_min_xyz.y         ||
+		ctx->wall_max_xyz.x        < room_face->min_xyz.x  ||
+      room_face->max_xyz.x < ctx->wall_min_xyz.x         ||
+      ctx->wall_max_xyz.z        < room_face->min_xyz.z  ||
+      room_face->max_xyz.z < ctx->wall_min_xyz.z) overlap = false;
 		
 	return overlap;
 }
@@ -1933,6 +1905,104 @@ inline bool room_manual_AABB(const face *room_face, const vector *min_xyz, const
 	return overlap;
 }
 
+// Returns the first set slot after the given one, or -1 when there are no more
+static inline int fvi_NextBVHSlot(const uint *slot_bits, int num_words, int slot)
+{
+	slot++;
+
+	int word = slot >> 5;
+	if (word >= num_words)
+		return -1;
+
+	uint bits = slot_bits[word] & (~0u << (slot & 31));
+	while (!bits)
+	{
+		if (++word >= num_words)
+			return -1;
+		bits = slot_bits[word];
+	}
+
+	slot = word << 5;
+	while (!(bits & 1))
+	{
+		bits >>= 1;
+		slot++;
+	}
+
+	return slot;
+}
+
+// Returns true if a bbf region passes the sector mask and its box touches the given box
+static inline bool region_manual_AABB(const room *cur_room, int region, ubyte msector, const vector *min_xyz, const vector *max_xyz)
+{
+	const ubyte bbf_val = cur_room->bbf_list_sector[region];
+	const vector *region_min = &cur_room->bbf_list_min_xyz[region];
+	const vector *region_max = &cur_room->bbf_list_max_xyz[region];
+
+	if((bbf_val & msector) != bbf_val)
+		return false;
+
+	if(region_min->x > max_xyz->x  ||
+		region_min->y > max_xyz->y  ||
+		region_min->z > max_xyz->z  || 
+		region_max->x < min_xyz->x  ||
+		region_max->y < min_xyz->y  ||
+		region_max->z < min_xyz->z) 
+		return false;
+
+	return true;
+}
+
+// Fills face_list with the room's faces whose boxes touch the given box, in bbf list order.  Only
+// for callers that use one box for the whole room.  Returns the number of faces.
+static int fvi_RoomFacesInBox(int roomnum, const vector *min_xyz, const vector *max_xyz, ubyte msector, short *face_list)
+{
+	const room *cur_room = &Rooms[roomnum];
+	const fvi_room_bvh *bvh = FVI_use_room_bvh ? fvi_GetRoomBVH(roomnum) : NULL;
+	int num_faces = 0;
+
+	if (bvh)
+	{
+		uint slot_bits[FVI_BVH_SLOT_WORDS];
+		const int num_words = (bvh->num_slots + 31) >> 5;
+		int cur_region = -1;
+		bool f_region_ok = false;
+
+		memset(slot_bits, 0, num_words * sizeof(uint));
+		fvi_QueryRoomBVH(bvh, min_xyz, max_xyz, msector, slot_bits);
+
+		for (int slot = fvi_NextBVHSlot(slot_bits, num_words, -1); slot >= 0; slot = fvi_NextBVHSlot(slot_bits, num_words, slot))
+		{
+			if (bvh->slot_region[slot] != cur_region)
+			{
+				cur_region = bvh->slot_region[slot];
+				f_region_ok = region_manual_AABB(cur_room, cur_region, msector, min_xyz, max_xyz);
+			}
+
+			if (f_region_ok)
+				face_list[num_faces++] = bvh->slot_face[slot];
+		}
+
+		return num_faces;
+	}
+
+	for (int region = 0; region < cur_room->num_bbf_regions; region++)
+	{
+		if (!region_manual_AABB(cur_room, region, msector, min_xyz, max_xyz))
+			continue;
+
+		for (int j = 0; j < cur_room->num_bbf[region]; j++)
+		{
+			int i = cur_room->bbf_list[region][j];
+
+			if (room_manual_AABB(&cur_room->faces[i], min_xyz, max_xyz)) 
+				face_list[num_faces++] = i;
+		}
+	}
+
+	return num_faces;
+}
+
 #define MAX_QUICK_ROOMS 20
 
 // Returns the number of faces that are approximately within the specified radius
@@ -1945,6 +2015,7 @@ int fvi_QuickDistFaceList(int init_room_index, vector *pos, float rad, fvi_face_
 	int highest_next_room_index;
 	int cur_next_room_index;
 	int i;
+	fvi_context *ctx = fvi_GetThreadContext();
 
 	//ASSERT(quick_fr_list != NULL);
 	ASSERT(pos != NULL);
@@ -1967,9 +2038,9 @@ int fvi_QuickDistFaceList(int init_room_index, vector *pos, float rad, fvi_face_
 	cur_next_room_index = 0;
 
 	// Use standard fvi list_array / bool list 
-	fvi_visit_list[init_room_index >> 3] |= 0x01 << (init_room_index % 8);
-	fvi_rooms_visited[0] = init_room_index;
-	fvi_num_rooms_visited = 1;
+	ctx->visit_list[init_room_index >> 3] |= 0x01 << (init_room_index % 8);
+	ctx->rooms_visited[0] = init_room_index;
+	ctx->num_rooms_visited = 1;
 
 	while(num_faces < max_elements && cur_next_room_index <= highest_next_room_index)
 	{
@@ -2003,91 +2074,61 @@ int fvi_QuickDistFaceList(int init_room_index, vector *pos, float rad, fvi_face_
 			msector |= 0x20;
 		}
 
-		const short num_bbf_regions = cur_room->num_bbf_regions;
-		short *num_faces_ptr = cur_room->num_bbf;
-		ubyte *bbf_val = cur_room->bbf_list_sector;
-		vector *region_min = cur_room->bbf_list_min_xyz;
-		vector *region_max = cur_room->bbf_list_max_xyz;
-		short **bbf_list_ptr = cur_room->bbf_list;
+		short room_faces[MAX_FACES_PER_ROOM];
+		const int num_room_faces = fvi_RoomFacesInBox(ROOMNUM(cur_room), &min_xyz, &max_xyz, msector, room_faces);
 
 		// Do the actual wall collsion stuff here!
-		for (int test1 = 0; test1 < num_bbf_regions; test1++)
+		for (int test1 = 0; test1 < num_room_faces; test1++)
 		{
-			if(((*bbf_val) & msector) == (*bbf_val))
+			int portal_num;
+			int connect_room;
+
+			i = room_faces[test1];
+
+			if (quick_fr_list != NULL)
 			{
-				if(region_min->x > max_xyz.x  ||
-					region_min->y > max_xyz.y  ||
-					region_min->z > max_xyz.z  || 
-					region_max->x < min_xyz.x  ||
-					region_max->y < min_xyz.y  ||
-					region_max->z < min_xyz.z) 
-					goto skip_region;
-				
-				short *cur_face_index_ptr = *bbf_list_ptr;
-				
-				for (int sort_list_cur = 0; sort_list_cur < (*num_faces_ptr); sort_list_cur++)
+				if(num_faces < max_elements)
 				{
-					i = *cur_face_index_ptr;
-					cur_face_index_ptr++;
+					quick_fr_list[num_faces].face_index = i;
+					quick_fr_list[num_faces].room_index = ROOMNUM(cur_room);
+					num_faces++;
+				}
+				else
+					break;
+			}
+			else
+				num_faces++;
 
-					int portal_num;
-					int connect_room;
+			cur_room->faces[i].flags|=FF_TOUCHED;
 
-					if (!room_manual_AABB(&cur_room->faces[i], &min_xyz, &max_xyz)) 
-						continue;
-				
-					if (quick_fr_list != NULL)
-					{
-						if(num_faces < max_elements)
-						{
-							quick_fr_list[num_faces].face_index = i;
-							quick_fr_list[num_faces].room_index = ROOMNUM(cur_room);
-							num_faces++;
-						}
-						else
-							break;
-					}
-					else
-						num_faces++;
+			portal_num = cur_room->faces[i].portal_num;
+			if(portal_num >= 0)
+			{
+				connect_room = cur_room->portals[portal_num].croom;
 
-					cur_room->faces[i].flags|=FF_TOUCHED;
+				// If the conect_room is not a terrain cell and we still have a slot in the next room list...
+				if(connect_room >= 0 && highest_next_room_index + 1 < MAX_QUICK_ROOMS)
+				{
+					ASSERT(Rooms[connect_room].used);
 
-					portal_num = cur_room->faces[i].portal_num;
-					if(portal_num >= 0)
+					if ((ctx->visit_list[connect_room >> 3] & (0x01 << ((connect_room) % 8))) == 0) 
 					{
-						connect_room = cur_room->portals[portal_num].croom;
-
-						// If the conect_room is not a terrain cell and we still have a slot in the next room list...
-						if(connect_room >= 0 && highest_next_room_index + 1 < MAX_QUICK_ROOMS)
-						{
-							ASSERT(Rooms[connect_room].used);
-
-							if ((fvi_visit_list[connect_room >> 3] & (0x01 << ((connect_room) % 8))) == 0) 
-							{
-								fvi_visit_list[connect_room >> 3] |= 0x01 << (connect_room % 8);
-								fvi_rooms_visited[fvi_num_rooms_visited++] = connect_room;
+						ctx->visit_list[connect_room >> 3] |= 0x01 << (connect_room % 8);
+						ctx->rooms_visited[ctx->num_rooms_visited++] = connect_room;
 
-								next_rooms[++highest_next_room_index] = connect_room;
-							}
-						}
+						next_rooms[++highest_next_room_index] = connect_room;
 					}
 				}
 			}
-skip_region: ;
-			num_faces_ptr++;
-			bbf_val++;
-			region_max++;
-			region_min++;
-			bbf_list_ptr++;
 		}
 
 		cur_next_room_index++;
 	}
 	
 	// Cleans up the boolean room visit list
-	for(i = 0; i < fvi_num_rooms_visited; i++)
+	for(i = 0; i < ctx->num_rooms_visited; i++)
 	{
-		fvi_visit_list[fvi_rooms_visited[i] >> 3] = 0;
+		ctx->visit_list[ctx->rooms_visited[i] >> 3] = 0;
 	}
 
 	return num_faces;
@@ -2153,21 +2194,63 @@ int fvi_QuickDistCellList(int init_cell_index, vector *pos, float rad, int *quic
 	return num_cells;
 }
 
+// Areas that touch more object grid cells than this walk the room and terrain cell object lists instead
+#define FVI_GRID_MAX_CELLS 64
+
+// An object found with the object grid, with the order the room or cell lists would have found it in
+struct fvi_grid_obj
+{
+	int order;					// Index in the visited room list, or terrain cell number
+	unsigned int link;		// ObjGridLinkOrder() -- room and cell lists run from highest to lowest
+	short objnum;
+};
+
+static bool fvi_grid_obj_before(const fvi_grid_obj &a, const fvi_grid_obj &b)
+{
+	if (a.order != b.order)
+		return a.order < b.order;
+
+	return a.link > b.link;
+}
+
+// Returns where a room is in ctx->rooms_visited, or -1 if it wasn't visited
+static int fvi_visited_index(const fvi_context *ctx, int roomnum)
+{
+	if (ROOMNUM_OUTSIDE(roomnum) || !(ctx->visit_list[roomnum >> 3] & (0x01 << (roomnum % 8))))
+		return -1;
+
+	for (int i = 0; i < ctx->num_rooms_visited; i++)
+	{
+		if (ctx->rooms_visited[i] == roomnum)
+			return i;
+	}
+
+	return -1;
+}
+
 int fvi_QuickDistObjectList(vector *pos, int init_room_index, float rad, short *object_index_list, int max_elements, bool f_lightmap_only, bool f_only_players_and_ais, bool f_include_non_collide_objects, bool f_stop_at_closed_doors)
 {
 	int num_objects = 0;
 	int x;	//, y;
 	vector delta;
+	fvi_context *ctx = fvi_GetThreadContext();
+	short grid_list[MAX_OBJECTS];
+	fvi_grid_obj found[MAX_OBJECTS];
+	int num_grid, num_found = 0;
+	bool f_use_grid;
 
 	// Quick volume
 	delta.x = delta.y = delta.z = rad;
-	fvi_min_xyz = fvi_max_xyz = *pos;
+	ctx->min_xyz = ctx->max_xyz = *pos;
+
+	ctx->min_xyz -= delta;
+	ctx->max_xyz += delta;
 
-	fvi_min_xyz -= delta;
-	fvi_max_xyz += delta;
+	ctx->wall_min_xyz = ctx->min_xyz;
+	ctx->wall_max_xyz = ctx->max_xyz;
 
-	fvi_wall_min_xyz = fvi_min_xyz;
-	fvi_wall_max_xyz = fvi_max_xyz;
+	// Small areas get their objects from the object grid instead of the room and cell lists
+	f_use_grid = (ObjGridQueryCells(&ctx->min_xyz, &ctx->max_xyz) <= FVI_GRID_MAX_CELLS);
 
 	if(ROOMNUM_OUTSIDE(init_room_index))
 	{
@@ -2198,40 +2281,85 @@ int fvi_QuickDistObjectList(vector *pos, int init_room_index, float rad, short *
 		cur_node = TERRAIN_WIDTH * ystart + xstart;
 		next_y_delta = TERRAIN_WIDTH - (xend - xstart) - 1;
 
-		for(ycounter = ystart; ycounter <= yend; ycounter++) 
+		if(f_use_grid)
 		{
-			for(xcounter = xstart; xcounter <= xend; xcounter++) 
+			num_grid = ObjGridQueryBox(&ctx->min_xyz, &ctx->max_xyz, grid_list, MAX_OBJECTS);
+
+			for(x = 0; x < num_grid; x++)
 			{
-				// Do object stuff
-				int cur_obj_index = Terrain_seg[cur_node].objects;
-				
-				while(cur_obj_index > -1)
+				object *obj = &Objects[grid_list[x]];
+
+				if(!ROOMNUM_OUTSIDE(obj->roomnum))
+					continue;
+
+				int cellnum = CELLNUM(obj->roomnum);
+				xcounter = cellnum % TERRAIN_WIDTH;
+				ycounter = cellnum / TERRAIN_WIDTH;
+
+				if(xcounter < xstart || xcounter > xend || ycounter < ystart || ycounter > yend)
+					continue;
+
+				if((f_include_non_collide_objects) || CollisionRayResult[obj->type] != RESULT_NOTHING)
 				{
-					if(num_objects >= max_elements) break;
+					if(!f_only_players_and_ais || obj->type == OBJ_PLAYER || obj->ai_info)
+					{
+						if(!(f_lightmap_only && (obj->lighting_render_type!=LRT_LIGHTMAPS) && obj->type != OBJ_ROOM))
+						{
+							if(object_movement_AABB(ctx, obj) && !(obj->flags & OF_BIG_OBJECT)) 
+							{
+								found[num_found].order = cellnum;
+								found[num_found].link = ObjGridLinkOrder(grid_list[x]);
+								found[num_found].objnum = grid_list[x];
+								num_found++;
+							}
+						}
+					}
+				}
+			}
+
+			// Same order as walking the cells
+			std::sort(found, found + num_found, fvi_grid_obj_before);
 
-					if((f_include_non_collide_objects) || CollisionRayResult[Objects[cur_obj_index].type] != RESULT_NOTHING)
+			for(x = 0; x < num_found && num_objects < max_elements; x++)
+				object_index_list[num_objects++] = found[x].objnum;
+		}
+		else
+		{
+			for(ycounter = ystart; ycounter <= yend; ycounter++) 
+			{
+				for(xcounter = xstart; xcounter <= xend; xcounter++) 
+				{
+					// Do object stuff
+					int cur_obj_index = Terrain_seg[cur_node].objects;
+					
+					while(cur_obj_index > -1)
 					{
-						if(!f_only_players_and_ais || Objects[cur_obj_index].type == OBJ_PLAYER || Objects[cur_obj_index].ai_info)
+						if(num_objects >= max_elements) break;
+
+						if((f_include_non_collide_objects) || CollisionRayResult[Objects[cur_obj_index].type] != RESULT_NOTHING)
 						{
-							if(!(f_lightmap_only && (Objects[cur_obj_index].lighting_render_type!=LRT_LIGHTMAPS) && Objects[cur_obj_index].type != OBJ_ROOM))
+							if(!f_only_players_and_ais || Objects[cur_obj_index].type == OBJ_PLAYER || Objects[cur_obj_index].ai_info)
 							{
-								if(object_movement_AABB(&Objects[cur_obj_index]) && !(Objects[cur_obj_index].flags & OF_BIG_OBJECT)) 
+								if(!(f_lightmap_only && (Objects[cur_obj_index].lighting_render_type!=LRT_LIGHTMAPS) && Objects[cur_obj_index].type != OBJ_ROOM))
 								{
-									object_index_list[num_objects++] = cur_obj_index;
-									ASSERT(num_objects < 0 || num_objects <= max_elements);
+									if(object_movement_AABB(ctx, &Objects[cur_obj_index]) && !(Objects[cur_obj_index].flags & OF_BIG_OBJECT)) 
+									{
+										object_index_list[num_objects++] = cur_obj_index;
+										ASSERT(num_objects < 0 || num_objects <= max_elements);
+									}
 								}
 							}
 						}
+
+						cur_obj_index = Objects[cur_obj_index].next;
 					}
 
-					cur_obj_index = Objects[cur_obj_index].next;
+					if(num_objects >= max_elements) break;
+					cur_node += 1;
 				}
-
 				if(num_objects >= max_elements) break;
-				cur_node += 1;
+				cur_node += next_y_delta;
 			}
-			if(num_objects >= max_elements) break;
-			cur_node += next_y_delta;
 		}
 
 		// Do big object stuff
@@ -2245,7 +2373,7 @@ int fvi_QuickDistObjectList(vector *pos, int init_room_index, float rad, short *
 				{
 					if(!(f_lightmap_only && (Objects[BigObjectList[x]].lighting_render_type!=LRT_LIGHTMAPS) && Objects[BigObjectList[x]].type != OBJ_ROOM))
 					{
-						if(object_movement_AABB(&Objects[BigObjectList[x]])) 
+						if(object_movement_AABB(ctx, &Objects[BigObjectList[x]])) 
 						{
 							object_index_list[num_objects++] = BigObjectList[x];
 							ASSERT(num_objects < 0 || num_objects <= max_elements);
@@ -2273,16 +2401,16 @@ int fvi_QuickDistObjectList(vector *pos, int init_room_index, float rad, short *
 		cur_next_room_index = 0;
 
 		// Use standard fvi list_array / bool list 
-		fvi_visit_list[init_room_index >> 3] |= 0x01 << (init_room_index % 8);
-		fvi_rooms_visited[0] = init_room_index;
-		fvi_num_rooms_visited = 1;
+		ctx->visit_list[init_room_index >> 3] |= 0x01 << (init_room_index % 8);
+		ctx->rooms_visited[0] = init_room_index;
+		ctx->num_rooms_visited = 1;
 
 		while(num_objects <= max_elements && cur_next_room_index <= highest_next_room_index)
 		{
 			cur_room = &Rooms[next_rooms[cur_next_room_index]];
 				
 			// Do object stuff
-			int cur_obj_index = cur_room->objects;
+			int cur_obj_index = f_use_grid ? -1 : cur_room->objects;
 			
 			while(cur_obj_index > -1)
 			{
@@ -2293,7 +2421,7 @@ int fvi_QuickDistObjectList(vector *pos, int init_room_index, float rad, short *
 					{
 						if(!(f_lightmap_only && (Objects[cur_obj_index].lighting_render_type!=LRT_LIGHTMAPS)))
 						{
-							if(object_movement_AABB(&Objects[cur_obj_index])) 
+							if(object_movement_AABB(ctx, &Objects[cur_obj_index])) 
 							{
 								object_index_list[num_objects++] = cur_obj_index;
 								ASSERT(num_objects < 0 || num_objects <= max_elements);
@@ -2329,7 +2457,7 @@ int fvi_QuickDistObjectList(vector *pos, int init_room_index, float rad, short *
 
   				i = cur_room->portals[x].portal_face;
 
-  				if (!room_movement_AABB(&cur_room->faces[i])) continue;
+  				if (!room_movement_AABB(ctx, &cur_room->faces[i])) continue;
   			
   				portal_num = cur_room->faces[i].portal_num;
   				connect_room = cur_room->portals[portal_num].croom;
@@ -2339,10 +2467,10 @@ int fvi_QuickDistObjectList(vector *pos, int init_room_index, float rad, short *
   				{
   					ASSERT(Rooms[connect_room].used);
 
-  					if ((fvi_visit_list[connect_room >> 3] & (0x01 << ((connect_room) % 8))) == 0) 
+  					if ((ctx->visit_list[connect_room >> 3] & (0x01 << ((connect_room) % 8))) == 0) 
   					{
-  						fvi_visit_list[connect_room >> 3] |= 0x01 << (connect_room % 8);
-  						fvi_rooms_visited[fvi_num_rooms_visited++] = connect_room;
+  						ctx->visit_list[connect_room >> 3] |= 0x01 << (connect_room % 8);
+  						ctx->rooms_visited[ctx->num_rooms_visited++] = connect_room;
 
 						ASSERT(highest_next_room_index + 1 >= 0 && highest_next_room_index + 1 < MAX_QUICK_ROOMS);
   						next_rooms[++highest_next_room_index] = connect_room;
@@ -2354,11 +2482,48 @@ skip_room_prop:
 
 			cur_next_room_index++;
 		}
+
+		if(f_use_grid)
+		{
+			num_grid = ObjGridQueryBox(&ctx->min_xyz, &ctx->max_xyz, grid_list, MAX_OBJECTS);
+
+			for(x = 0; x < num_grid; x++)
+			{
+				object *obj = &Objects[grid_list[x]];
+				int visited_index = fvi_visited_index(ctx, obj->roomnum);
+
+				if(visited_index == -1)
+					continue;
+
+				if((f_include_non_collide_objects) || CollisionRayResult[obj->type] != RESULT_NOTHING)
+				{
+					if(!f_only_players_and_ais || obj->type == OBJ_PLAYER || obj->ai_info)
+					{
+						if(!(f_lightmap_only && (obj->lighting_render_type!=LRT_LIGHTMAPS)))
+						{
+							if(object_movement_AABB(ctx, obj)) 
+							{
+								found[num_found].order = visited_index;
+								found[num_found].link = ObjGridLinkOrder(grid_list[x]);
+								found[num_found].objnum = grid_list[x];
+								num_found++;
+							}
+						}
+					}
+				}
+			}
+
+			// Same order as walking the rooms
+			std::sort(found, found + num_found, fvi_grid_obj_before);
+
+			for(x = 0; x < num_found && num_objects < max_elements; x++)
+				object_index_list[num_objects++] = found[x].objnum;
+		}
 		
 		// Cleans up the boolean room visit list
-		for(i = 0; i < fvi_num_rooms_visited; i++)
+		for(i = 0; i < ctx->num_rooms_visited; i++)
 		{
-			fvi_visit_list[fvi_rooms_visited[i] >> 3] = 0;
+			ctx->visit_list[ctx->rooms_visited[i] >> 3] = 0;
 		}
 	}
 
@@ -2430,82 +2595,53 @@ bool fvi_QuickRoomCheck(vector *pos, room *cur_room, bool try_again)
 		msector |= 0x20;
 	}
 
-	const short num_bbf_regions = cur_room->num_bbf_regions;
-	short *num_faces_ptr = cur_room->num_bbf;
-	ubyte *bbf_val = cur_room->bbf_list_sector;
-	vector *region_min = cur_room->bbf_list_min_xyz;
-	vector *region_max = cur_room->bbf_list_max_xyz;
-	short **bbf_list_ptr = cur_room->bbf_list;
+	short room_faces[MAX_FACES_PER_ROOM];
+	const int num_room_faces = fvi_RoomFacesInBox(ROOMNUM(cur_room), &min_xyz, &max_xyz, msector, room_faces);
 
 	// Do the actual wall collsion stuff here!
-	for (int test1 = 0; test1 < num_bbf_regions; test1++)
+	for (int test1 = 0; test1 < num_room_faces; test1++)
 	{
-		if(((*bbf_val) & msector) == (*bbf_val))
-		{
-			if(region_min->x > max_xyz.x  ||
-				region_min->y > max_xyz.y  ||
-				region_min->z > max_xyz.z  || 
-				region_max->x < min_xyz.x  ||
-				region_max->y < min_xyz.y  ||
-				region_max->z < min_xyz.z) 
-				goto skip_region;
-			
-			short *cur_face_index_ptr = *bbf_list_ptr;
-			
-			for (int sort_list_cur = 0; sort_list_cur < (*num_faces_ptr); sort_list_cur++)
-			{
-				i = *cur_face_index_ptr;
-				cur_face_index_ptr++;
+		vector face_normal;
+		vector *vertex_ptr_list[MAX_VERTS_PER_FACE];
+		int face_hit_type;
+		vector wall_norm;
+		short count;
+		bool f_backface;
 
-				vector face_normal;
-				vector *vertex_ptr_list[MAX_VERTS_PER_FACE];
-				int face_hit_type;
-				vector wall_norm;
-				short count;
-				bool f_backface;
+		i = room_faces[test1];
 
-				if (cur_room->faces[i].flags & FF_NOT_SHELL)
-					continue;
+		if (cur_room->faces[i].flags & FF_NOT_SHELL)
+			continue;
 
-				if (!room_manual_AABB(&cur_room->faces[i], &min_xyz, &max_xyz)) continue;
+		f_backface = false;
 
-				f_backface = false;
-
-				for (count = 0; count < cur_room->faces[i].num_verts; count++)
-					vertex_ptr_list[count] = &cur_room->verts[cur_room->faces[i].face_verts[count]];
+		for (count = 0; count < cur_room->faces[i].num_verts; count++)
+			vertex_ptr_list[count] = &cur_room->verts[cur_room->faces[i].face_verts[count]];
 
-				face_normal = cur_room->faces[i].normal;
-									
-				face_hit_type = check_line_to_face(&hit_point, &colp, &cur_dist, &wall_norm, pos, &new_pos, &face_normal, vertex_ptr_list, cur_room->faces[i].num_verts, 0.0);
-				if (!face_hit_type)
-				{
-					face_normal *= -1.0f;
-					for (count = 0; count < cur_room->faces[i].num_verts; count++)
-						vertex_ptr_list[cur_room->faces[i].num_verts - count - 1] = &cur_room->verts[cur_room->faces[i].face_verts[count]];
+		face_normal = cur_room->faces[i].normal;
+							
+		face_hit_type = check_line_to_face(&hit_point, &colp, &cur_dist, &wall_norm, pos, &new_pos, &face_normal, vertex_ptr_list, cur_room->faces[i].num_verts, 0.0);
+		if (!face_hit_type)
+		{
+			face_normal *= -1.0f;
+			for (count = 0; count < cur_room->faces[i].num_verts; count++)
+				vertex_ptr_list[cur_room->faces[i].num_verts - count - 1] = &cur_room->verts[cur_room->faces[i].face_verts[count]];
 
-					face_hit_type = check_line_to_face(&hit_point, &colp, &cur_dist, &wall_norm, pos, &new_pos, &face_normal, vertex_ptr_list, cur_room->faces[i].num_verts, 0.0);
-					f_backface = true;
-				}
+			face_hit_type = check_line_to_face(&hit_point, &colp, &cur_dist, &wall_norm, pos, &new_pos, &face_normal, vertex_ptr_list, cur_room->faces[i].num_verts, 0.0);
+			f_backface = true;
+		}
 
-				// If we hit the face...
-				if (face_hit_type) 
-				{    
-					if ((cur_dist <= closest_hit_distance && !f_backface) || (cur_dist < closest_hit_distance && f_backface)) 
-					{
-						closest_hit_distance = cur_dist; 
-													
-						if(f_backface) closest_hit_type = HIT_BACKFACE;
-						else closest_hit_type = HIT_WALL;
-					}
-				}
+		// If we hit the face...
+		if (face_hit_type) 
+		{    
+			if ((cur_dist <= closest_hit_distance && !f_backface) || (cur_dist < closest_hit_distance && f_backface)) 
+			{
+				closest_hit_distance = cur_dist; 
+											
+				if(f_backface) closest_hit_type = HIT_BACKFACE;
+				else closest_hit_type = HIT_WALL;
 			}
 		}
-skip_region: ;
-		num_faces_ptr++;
-		bbf_val++;
-		region_max++;
-		region_min++;
-		bbf_list_ptr++;
 	}
 	
 	if(closest_hit_type != HIT_WALL) 
@@ -2540,7 +2676,7 @@ inline bool is_long_xz_ray(fvi_query *fq)
 	}
 }
 
-void check_ceiling()
+void check_ceiling(fvi_context *ctx)
 {
 	vector hit_point;
 	float cur_dist;
@@ -2553,7 +2689,7 @@ void check_ceiling()
 	vector colp;
 
 	// Bail early if hitpnt is not high enough
-	if(fvi_query_ptr->rad + fvi_hit_data_ptr->hit_pnt.y < CEILING_HEIGHT) return;
+	if(ctx->query_ptr->rad + ctx->hit_data_ptr->hit_pnt.y < CEILING_HEIGHT) return;
 
 	vlist[0].x = 0.0;
 	vlist[0].y = CEILING_HEIGHT;
@@ -2574,49 +2710,49 @@ void check_ceiling()
 	vertex_ptr_list[3] = &vlist[3];
 					
 	// Did we hit this face?
-	face_hit_type = check_line_to_face(&hit_point, &colp, &cur_dist, &wall_norm, fvi_query_ptr->p0, &fvi_hit_data_ptr->hit_pnt, &face_normal, vertex_ptr_list, 4, fvi_query_ptr->rad);
+	face_hit_type = check_line_to_face(&hit_point, &colp, &cur_dist, &wall_norm, ctx->query_ptr->p0, &ctx->hit_data_ptr->hit_pnt, &face_normal, vertex_ptr_list, 4, ctx->query_ptr->rad);
 
 	if (face_hit_type) 
 	{    
-		if (cur_dist <= fvi_collision_dist) 
+		if (cur_dist <= ctx->collision_dist) 
 		{
-			if((cur_dist < fvi_collision_dist) || !(fvi_query_ptr->flags & FQ_MULTI_POINT))
+			if((cur_dist < ctx->collision_dist) || !(ctx->query_ptr->flags & FQ_MULTI_POINT))
 			{
-				fvi_hit_data_ptr->num_hits = 0;
+				ctx->hit_data_ptr->num_hits = 0;
 
-				fvi_hit_data_ptr->hit_pnt = hit_point;
-				fvi_collision_dist = cur_dist; 
-				compute_movement_AABB();
+				ctx->hit_data_ptr->hit_pnt = hit_point;
+				ctx->collision_dist = cur_dist; 
+				compute_movement_AABB(ctx);
 			}
-			else if(fvi_hit_data_ptr->num_hits == MAX_HITS)
+			else if(ctx->hit_data_ptr->num_hits == MAX_HITS)
 			{
 				goto ignore_hit;
 			}
 
-			fvi_hit_data_ptr->hit_type[fvi_hit_data_ptr->num_hits] = HIT_CEILING;
-			fvi_hit_data_ptr->hit_wallnorm[fvi_hit_data_ptr->num_hits] = wall_norm;	
-			// fvi_hit_data_ptr->hit_seg = -1; -- set in the fvi_FindIntersection function
-			fvi_hit_data_ptr->hit_object[fvi_hit_data_ptr->num_hits] = -1;
-			fvi_hit_data_ptr->hit_face[fvi_hit_data_ptr->num_hits] =  0;
-			fvi_hit_data_ptr->hit_face_room[fvi_hit_data_ptr->num_hits] = 0;
-			fvi_hit_data_ptr->hit_face_pnt[fvi_hit_data_ptr->num_hits] = colp;
+			ctx->hit_data_ptr->hit_type[ctx->hit_data_ptr->num_hits] = HIT_CEILING;
+			ctx->hit_data_ptr->hit_wallnorm[ctx->hit_data_ptr->num_hits] = wall_norm;	
+			// ctx->hit_data_ptr->hit_seg = -1; -- set in the fvi_FindIntersection function
+			ctx->hit_data_ptr->hit_object[ctx->hit_data_ptr->num_hits] = -1;
+			ctx->hit_data_ptr->hit_face[ctx->hit_data_ptr->num_hits] =  0;
+			ctx->hit_data_ptr->hit_face_room[ctx->hit_data_ptr->num_hits] = 0;
+			ctx->hit_data_ptr->hit_face_pnt[ctx->hit_data_ptr->num_hits] = colp;
 
-			fvi_hit_data_ptr->num_hits++;
+			ctx->hit_data_ptr->num_hits++;
 		}
 	}
 ignore_hit: ;
 }
 
-void make_trigger_face_list(int last_sim_faces)
+void make_trigger_face_list(fvi_context *ctx, int last_sim_faces)
 {
 	int num_real_collisions;
 	int x;
 
 	num_real_collisions = last_sim_faces;
 
-	ASSERT(Fvi_num_recorded_faces <= MAX_RECORDED_FACES);
+	ASSERT(ctx->num_recorded_faces <= MAX_RECORDED_FACES);
 
-	for(x = last_sim_faces; x < Fvi_num_recorded_faces; x++)
+	for(x = last_sim_faces; x < ctx->num_recorded_faces; x++)
 	{
 		vector face_normal;
 		vector *vertex_ptr_list[MAX_VERTS_PER_FACE];
@@ -2625,43 +2761,43 @@ void make_trigger_face_list(int last_sim_faces)
 		vector colp;
 		vector hit_point;
 		short count;
-		room *cur_room = &Rooms[Fvi_recorded_faces[x].room_index];
-		int i = Fvi_recorded_faces[x].face_index;
+		room *cur_room = &Rooms[ctx->recorded_faces[x].room_index];
+		int i = ctx->recorded_faces[x].face_index;
 		float cur_dist;
 
 
 		for (count = 0; count < cur_room->faces[i].num_verts; count++)
 			vertex_ptr_list[count] = &cur_room->verts[cur_room->faces[i].face_verts[count]];
 
-//		mprintf((0, "FVI:In trigger %f to %f crossed %f\n", fvi_query_ptr->p0->z, fvi_hit_data_ptr->hit_pnt.z, vertex_ptr_list[0]->z));
+//		mprintf((0, "FVI:In trigger %f to %f crossed %f\n", ctx->query_ptr->p0->z, ctx->hit_data_ptr->hit_pnt.z, vertex_ptr_list[0]->z));
 
 		face_normal = cur_room->faces[i].normal;
 
-		face_hit_type = check_line_to_face(&hit_point, &colp, &cur_dist, &wall_norm, fvi_query_ptr->p0, &fvi_hit_data_ptr->hit_pnt, &face_normal, vertex_ptr_list, cur_room->faces[i].num_verts, 0.0f);
+		face_hit_type = check_line_to_face(&hit_point, &colp, &cur_dist, &wall_norm, ctx->query_ptr->p0, &ctx->hit_data_ptr->hit_pnt, &face_normal, vertex_ptr_list, cur_room->faces[i].num_verts, 0.0f);
 
 		if(face_hit_type)
 		{
 //			mprintf((0, "FVI:hit trigger\n"));
-			Fvi_recorded_faces[num_real_collisions].face_index = i;
-			Fvi_recorded_faces[num_real_collisions++].room_index = Fvi_recorded_faces[x].room_index;
+			ctx->recorded_faces[num_real_collisions].face_index = i;
+			ctx->recorded_faces[num_real_collisions++].room_index = ctx->recorded_faces[x].room_index;
 		}
 	}
 
-	if(!ROOMNUM_OUTSIDE(fvi_query_ptr->startroom) && !ROOMNUM_OUTSIDE(fvi_hit_data_ptr->hit_room))
+	if(!ROOMNUM_OUTSIDE(ctx->query_ptr->startroom) && !ROOMNUM_OUTSIDE(ctx->hit_data_ptr->hit_room))
 	{
 		int i;
 		
-		for(i = 0; i < Rooms[fvi_query_ptr->startroom].num_portals; i++)
+		for(i = 0; i < Rooms[ctx->query_ptr->startroom].num_portals; i++)
 		{
-			if(Rooms[fvi_query_ptr->startroom].portals[i].croom == fvi_hit_data_ptr->hit_room)
+			if(Rooms[ctx->query_ptr->startroom].portals[i].croom == ctx->hit_data_ptr->hit_room)
 			{
 				int j;
 				bool f_found = false;
 
 				for(j = 0; j < num_real_collisions; j++)
 				{
-					if(Fvi_recorded_faces[j].face_index == Rooms[fvi_query_ptr->startroom].portals[i].portal_face && 
-						Fvi_recorded_faces[j].room_index == fvi_query_ptr->startroom)
+					if(ctx->recorded_faces[j].face_index == Rooms[ctx->query_ptr->startroom].portals[i].portal_face && 
+						ctx->recorded_faces[j].room_index == ctx->query_ptr->startroom)
 					{
 						f_found = true;
 						break;
@@ -2670,17 +2806,17 @@ void make_trigger_face_list(int last_sim_faces)
 
 				if(!f_found)
 				{
-					Fvi_recorded_faces[num_real_collisions].face_index = Rooms[fvi_query_ptr->startroom].portals[i].portal_face;
-					Fvi_recorded_faces[num_real_collisions++].room_index = fvi_query_ptr->startroom;
+					ctx->recorded_faces[num_real_collisions].face_index = Rooms[ctx->query_ptr->startroom].portals[i].portal_face;
+					ctx->recorded_faces[num_real_collisions++].room_index = ctx->query_ptr->startroom;
 				}
 			}
 		}
 	}
 
-	Fvi_num_recorded_faces = num_real_collisions;
+	ctx->num_recorded_faces = num_real_collisions;
 }
 
-void fvi_rooms_objs(void);
+void fvi_rooms_objs(fvi_context *ctx);
 
 //Find out if a vector intersects with anything.
 //Fills in hit_data, an fvi_info structure (see header file).
@@ -2696,7 +2832,7 @@ void fvi_rooms_objs(void);
 extern bool Tracking_FVI;
 #endif
 
-int fvi_FindIntersection(fvi_query *fq,fvi_info *hit_data, bool no_subdivision)
+int fvi_FindIntersection(fvi_context *ctx, fvi_query *fq, fvi_info *hit_data, bool no_subdivision)
 {
 	int i;
 	object *this_obj;
@@ -2727,9 +2863,9 @@ int fvi_FindIntersection(fvi_query *fq,fvi_info *hit_data, bool no_subdivision)
 	FVI_counter++;
 	/////////////////////////////////////////
 
-	// Setup our globals
-	fvi_hit_data_ptr = hit_data;
-	fvi_query_ptr = fq;
+	// Setup the context
+	ctx->hit_data_ptr = hit_data;
+	ctx->query_ptr = fq;
 
 	if(fq->thisobjnum >= 0)
 		this_obj = &Objects[fq->thisobjnum];
@@ -2737,9 +2873,9 @@ int fvi_FindIntersection(fvi_query *fq,fvi_info *hit_data, bool no_subdivision)
 		this_obj = NULL;
 
 	if(fq->rad == 0.0f)
-		fvi_zero_rad = true;
+		ctx->zero_rad = true;
 	else
-		fvi_zero_rad = false;
+		ctx->zero_rad = false;
 
 	ASSERT(fq != NULL && hit_data != NULL);
 	
@@ -2747,15 +2883,15 @@ int fvi_FindIntersection(fvi_query *fq,fvi_info *hit_data, bool no_subdivision)
 	ASSERT(_finite(fq->p1->y) != 0); // Caller wants to go to infinity!  -- Not FVI's fault.
 	ASSERT(_finite(fq->p1->z) != 0); // Caller wants to go to infinity!  -- Not FVI's fault.
 
-	fvi_movement_delta = *fq->p1 - *fq->p0;
+	ctx->movement_delta = *fq->p1 - *fq->p0;
 
 	// mprintf((0, "FVI:----New search----\n"));
 	// mprintf((0, "FVI: P0 is %f, %f, %f\n", XYZ(fq->p0)));
 	if(fq->flags & FQ_NEW_RECORD_LIST) 
 	{
-		Fvi_num_recorded_faces = 0;
+		ctx->num_recorded_faces = 0;
 	}
-	last_sim_trigger_faces = Fvi_num_recorded_faces;
+	last_sim_trigger_faces = ctx->num_recorded_faces;
 
 	if((this_obj) &&
 		(this_obj->flags & OF_POLYGON_OBJECT) &&
@@ -2768,60 +2904,60 @@ int fvi_FindIntersection(fvi_query *fq,fvi_info *hit_data, bool no_subdivision)
 	{
 		if(this_obj->mtype.phys_info.flags & PF_POINT_COLLIDE_WALLS)
 		{
-			fvi_wall_sphere_rad = 0.0f;
-			fvi_wall_sphere_offset = Zero_vector;
-			fvi_wall_sphere_p0 = *fq->p0;
-			fvi_wall_sphere_p1 = *fq->p1;
+			ctx->wall_sphere_rad = 0.0f;
+			ctx->wall_sphere_offset = Zero_vector;
+			ctx->wall_sphere_p0 = *fq->p0;
+			ctx->wall_sphere_p1 = *fq->p1;
 		}
 		else
 		{
-			fvi_wall_sphere_rad = Poly_models[this_obj->rtype.pobj_info.model_num].wall_size;
-			fvi_wall_sphere_offset = this_obj->wall_sphere_offset;
-			fvi_wall_sphere_p0 = *fq->p0 + fvi_wall_sphere_offset;
-			fvi_wall_sphere_p1 = *fq->p1 + fvi_wall_sphere_offset;
+			ctx->wall_sphere_rad = Poly_models[this_obj->rtype.pobj_info.model_num].wall_size;
+			ctx->wall_sphere_offset = this_obj->wall_sphere_offset;
+			ctx->wall_sphere_p0 = *fq->p0 + ctx->wall_sphere_offset;
+			ctx->wall_sphere_p1 = *fq->p1 + ctx->wall_sphere_offset;
 		}
 
-		fvi_anim_sphere_rad = Poly_models[this_obj->rtype.pobj_info.model_num].anim_size;
-		fvi_anim_sphere_offset = this_obj->anim_sphere_offset;
-		fvi_anim_sphere_p0 = *fq->p0 + fvi_anim_sphere_offset;
-		fvi_anim_sphere_p1 = *fq->p1 + fvi_anim_sphere_offset;
+		ctx->anim_sphere_rad = Poly_models[this_obj->rtype.pobj_info.model_num].anim_size;
+		ctx->anim_sphere_offset = this_obj->anim_sphere_offset;
+		ctx->anim_sphere_p0 = *fq->p0 + ctx->anim_sphere_offset;
+		ctx->anim_sphere_p1 = *fq->p1 + ctx->anim_sphere_offset;
 	}
 	else
 	{
 		if((this_obj) && this_obj->type == OBJ_PLAYER && fq->rad == this_obj->size)
 		{
-			fvi_wall_sphere_rad = fq->rad * PLAYER_SIZE_SCALAR;
+			ctx->wall_sphere_rad = fq->rad * PLAYER_SIZE_SCALAR;
 			if(Players[this_obj->id].flags & (PLAYER_FLAGS_DEAD | PLAYER_FLAGS_DYING))
-				fvi_wall_sphere_rad *= 0.5f;
-			fvi_wall_sphere_offset = Zero_vector;
-			fvi_wall_sphere_p0 = *fq->p0;
-			fvi_wall_sphere_p1 = *fq->p1;
+				ctx->wall_sphere_rad *= 0.5f;
+			ctx->wall_sphere_offset = Zero_vector;
+			ctx->wall_sphere_p0 = *fq->p0;
+			ctx->wall_sphere_p1 = *fq->p1;
 		}
 		else if((this_obj) && this_obj->mtype.phys_info.flags & PF_POINT_COLLIDE_WALLS)
 		{
-			fvi_wall_sphere_rad = 0.0f;
-			fvi_wall_sphere_offset = Zero_vector;
-			fvi_wall_sphere_p0 = *fq->p0;
-			fvi_wall_sphere_p1 = *fq->p1;
+			ctx->wall_sphere_rad = 0.0f;
+			ctx->wall_sphere_offset = Zero_vector;
+			ctx->wall_sphere_p0 = *fq->p0;
+			ctx->wall_sphere_p1 = *fq->p1;
 		}
 		else
 		{
-			fvi_wall_sphere_rad = fq->rad;
-			fvi_wall_sphere_offset = Zero_vector;
-			fvi_wall_sphere_p0 = *fq->p0;
-			fvi_wall_sphere_p1 = *fq->p1;
+			ctx->wall_sphere_rad = fq->rad;
+			ctx->wall_sphere_offset = Zero_vector;
+			ctx->wall_sphere_p0 = *fq->p0;
+			ctx->wall_sphere_p1 = *fq->p1;
 		}
 
-		fvi_anim_sphere_rad = fq->rad;
-		fvi_anim_sphere_offset = Zero_vector;
-		fvi_anim_sphere_p0 = *fq->p0;
-		fvi_anim_sphere_p1 = *fq->p1;
+		ctx->anim_sphere_rad = fq->rad;
+		ctx->anim_sphere_offset = Zero_vector;
+		ctx->anim_sphere_p0 = *fq->p0;
+		ctx->anim_sphere_p1 = *fq->p1;
 	}
 
-	fvi_num_rooms_visited = 0;
-	fvi_num_cells_visited = 0;
-	fvi_num_cells_obj_visited = 0;
-	f_check_terrain = true;
+	ctx->num_rooms_visited = 0;
+	ctx->num_cells_visited = 0;
+	ctx->num_cells_obj_visited = 0;
+	ctx->check_terrain = true;
 	
 	// Initially assume we will hit the endpoint -- Do not compute the end segment unless we actually have no collisions
 	hit_data->hit_pnt				= *fq->p1;
@@ -2833,10 +2969,10 @@ int fvi_FindIntersection(fvi_query *fq,fvi_info *hit_data, bool no_subdivision)
 	hit_data->hit_object[0]		= -1;
 	
 	hit_data->n_rooms				= 0;	
-	fvi_collision_dist			= vm_VectorDistance(fq->p0, fq->p1) + 0.0000001f;
+	ctx->collision_dist			= vm_VectorDistance(fq->p0, fq->p1) + 0.0000001f;
 
 	// Computes a axis-aligned bounding-box that encompasses the area
-	compute_movement_AABB();
+	compute_movement_AABB(ctx);
 
 	if (ROOMNUM_OUTSIDE(fq->startroom)) 
 	{
@@ -2877,7 +3013,7 @@ int fvi_FindIntersection(fvi_query *fq,fvi_info *hit_data, bool no_subdivision)
 				fvi_new_query.startroom = GetTerrainRoomFromPos(&new_p0);
 				
 //				mprintf((0, "S %d F %f,%f,%f to %f,%f,%f\n", i, XYZ(&new_p0), XYZ(&new_p1)));
-				s_hit_type = fvi_FindIntersection(&fvi_new_query, &fvi_new_hit_data, true);
+				s_hit_type = fvi_FindIntersection(ctx, &fvi_new_query, &fvi_new_hit_data, true);
 
 				fvi_new_query.flags &= (~FQ_NEW_RECORD_LIST);
 
@@ -2898,7 +3034,7 @@ int fvi_FindIntersection(fvi_query *fq,fvi_info *hit_data, bool no_subdivision)
 			if(s_hit_type == HIT_NONE)
 			{
 				new_p1 = *save_fvi_query_ptr->p1;
-				s_hit_type = fvi_FindIntersection(&fvi_new_query, &fvi_new_hit_data, true);
+				s_hit_type = fvi_FindIntersection(ctx, &fvi_new_query, &fvi_new_hit_data, true);
 			}
 
 			hit_data = save_fvi_hit_data_ptr;
@@ -2911,25 +3047,25 @@ int fvi_FindIntersection(fvi_query *fq,fvi_info *hit_data, bool no_subdivision)
 			return hit_data->hit_type[0];
 		}
 		else
-			do_fvi_terrain();
+			do_fvi_terrain(ctx);
 	} 
 	else 
 	{
 		ASSERT(!(Rooms[fq->startroom].flags & RF_EXTERNAL)); // If we hit this, it is not FVI's fault
 		                                                    // The caller to fvi has a bug
 		FVI_room_counter++;
-		//do_fvi_rooms(fq->startroom);
-		fvi_room(fq->startroom, -1);
+		//do_fvi_rooms(ctx, fq->startroom);
+		fvi_room(ctx, fq->startroom, -1);
 
-		ASSERT(fvi_num_rooms_visited >= 1);
+		ASSERT(ctx->num_rooms_visited >= 1);
 	}
 
 	//Check objects in rooms we visited
-	fvi_rooms_objs();
+	fvi_rooms_objs(ctx);
 
 	if(FVI_always_check_ceiling && (fq->flags & FQ_CHECK_CEILING)) 
 	{
-		check_ceiling();
+		check_ceiling(ctx);
 	}
 	
 	// Determine hit seg.
@@ -2937,12 +3073,12 @@ int fvi_FindIntersection(fvi_query *fq,fvi_info *hit_data, bool no_subdivision)
 	// Only do this if not running radiosity
 	if (!(fq->flags & FQ_NO_RELINK))
 	{
-		if(fvi_num_rooms_visited == 1 && fvi_num_cells_visited == 0)
+		if(ctx->num_rooms_visited == 1 && ctx->num_cells_visited == 0)
 		{
-			hit_data->hit_room = fvi_rooms_visited[0];
+			hit_data->hit_room = ctx->rooms_visited[0];
 		}
 		else if((hit_data->hit_type[0] == HIT_WALL || hit_data->hit_type[0] == HIT_TERRAIN) && 
-			     (fvi_zero_rad || (fvi_query_ptr->thisobjnum >= 0 && (Objects[fvi_query_ptr->thisobjnum].mtype.phys_info.flags & PF_POINT_COLLIDE_WALLS))) &&
+			     (ctx->zero_rad || (ctx->query_ptr->thisobjnum >= 0 && (Objects[ctx->query_ptr->thisobjnum].mtype.phys_info.flags & PF_POINT_COLLIDE_WALLS))) &&
 				  (ROOMNUM_OUTSIDE(hit_data->hit_face_room[0]) || !(Rooms[hit_data->hit_face_room[0]].flags & RF_EXTERNAL)))
 		{
 			hit_data->hit_room = hit_data->hit_face_room[0];
@@ -2951,24 +3087,24 @@ int fvi_FindIntersection(fvi_query *fq,fvi_info *hit_data, bool no_subdivision)
 		{
 			bool f_found_room = false;
 		
-			for(i = 0; i < fvi_num_rooms_visited && !f_found_room; i++)
+			for(i = 0; i < ctx->num_rooms_visited && !f_found_room; i++)
 			{
-				if(!(Rooms[fvi_rooms_visited[i]].flags & RF_EXTERNAL))
-					if(fvi_QuickRoomCheck(&hit_data->hit_pnt, &Rooms[fvi_rooms_visited[i]]))
+				if(!(Rooms[ctx->rooms_visited[i]].flags & RF_EXTERNAL))
+					if(fvi_QuickRoomCheck(&hit_data->hit_pnt, &Rooms[ctx->rooms_visited[i]]))
 					{
 						f_found_room = true;
-						hit_data->hit_room	= fvi_rooms_visited[i];
+						hit_data->hit_room	= ctx->rooms_visited[i];
 					}
 			}
 
-			if(!f_found_room && fvi_num_cells_visited >= 1)
+			if(!f_found_room && ctx->num_cells_visited >= 1)
 			{
 				// We must be outside
 
 				// Check the ceiling too
 				if(!FVI_always_check_ceiling && (fq->flags & FQ_CHECK_CEILING)) 
 				{
-					check_ceiling();
+					check_ceiling(ctx);
 				}
 			
 				// Determine if we are within the valid terrain bounds
@@ -2981,13 +3117,13 @@ int fvi_FindIntersection(fvi_query *fq,fvi_info *hit_data, bool no_subdivision)
 			else if(!f_found_room)
 			{
 	//				mprintf((0, "Attempting to patch\n"));
-				for(i = 0; i < fvi_num_rooms_visited && !f_found_room; i++)
+				for(i = 0; i < ctx->num_rooms_visited && !f_found_room; i++)
 				{
-					if(!(Rooms[fvi_rooms_visited[i]].flags & RF_EXTERNAL))
-						if(fvi_QuickRoomCheck(&hit_data->hit_pnt, &Rooms[fvi_rooms_visited[i]]), true)
+					if(!(Rooms[ctx->rooms_visited[i]].flags & RF_EXTERNAL))
+						if(fvi_QuickRoomCheck(&hit_data->hit_pnt, &Rooms[ctx->rooms_visited[i]]), true)
 						{
 							f_found_room = true;
-							hit_data->hit_room	= fvi_rooms_visited[i];
+							hit_data->hit_room	= ctx->rooms_visited[i];
 							ASSERT(!(Rooms[hit_data->hit_room].flags & RF_EXTERNAL));
 			//				break;
 						}
@@ -3004,27 +3140,27 @@ int fvi_FindIntersection(fvi_query *fq,fvi_info *hit_data, bool no_subdivision)
 	}
 
 	// Clean up the visit list bits
-	for(i = 0; i < fvi_num_cells_visited; i++)
+	for(i = 0; i < ctx->num_cells_visited; i++)
 	{
-		fvi_terrain_visit_list[fvi_cells_visited[i] >> 3] = 0;
+		ctx->terrain_visit_list[ctx->cells_visited[i] >> 3] = 0;
 	}
 
-	for(i = 0; i < fvi_num_cells_obj_visited; i++)
+	for(i = 0; i < ctx->num_cells_obj_visited; i++)
 	{
-		fvi_terrain_obj_visit_list[fvi_cells_obj_visited[i] >> 3] = 0;
+		ctx->terrain_obj_visit_list[ctx->cells_obj_visited[i] >> 3] = 0;
 	}
 
-	for(i = 0; i < fvi_num_rooms_visited; i++)
+	for(i = 0; i < ctx->num_rooms_visited; i++)
 	{
-		fvi_visit_list[fvi_rooms_visited[i] >> 3] = 0;
+		ctx->visit_list[ctx->rooms_visited[i] >> 3] = 0;
 	}
 
-	if(fvi_query_ptr->flags & FQ_RECORD)
+	if(ctx->query_ptr->flags & FQ_RECORD)
 	{
-		make_trigger_face_list(last_sim_trigger_faces);
+		make_trigger_face_list(ctx, last_sim_trigger_faces);
 	}
 
-	hit_data->hit_dist = fvi_collision_dist;
+	hit_data->hit_dist = ctx->collision_dist;
 
 	// Return the hit type
 #ifdef USE_RTP
@@ -3033,6 +3169,236 @@ int fvi_FindIntersection(fvi_query *fq,fvi_info *hit_data, bool no_subdivision)
 	return hit_data->hit_type[0];
 }
 
+int fvi_FindIntersection(fvi_query *fq, fvi_info *hit_data, bool no_subdivision)
+{
+	return fvi_FindIntersection(fvi_GetThreadContext(), fq, hit_data, no_subdivision);
+}
+
+#define FVI_BATCH_CHUNK				256		// Queries sorted by start room at a time
+#define FVI_BATCH_WIDTH				8			// Rays culled against a room's faces together
+#define FVI_BATCH_FACE_WORDS		((MAX_FACES_PER_ROOM + 31) / 32)
+#define FVI_BATCH_PLANE_EPSILON	0.05f		// Slop for the plane tests, which round differently from check_line_to_face
+
+// Returns true if fvi_room_face() checks the walls with the query's own endpoints and a radius no
+// bigger than fq->rad.  Otherwise it uses the model's wall sphere.
+static bool fvi_batch_plain_wall_sphere(const fvi_query *fq)
+{
+	if (fq->thisobjnum < 0)
+		return true;
+
+	const object *this_obj = &Objects[fq->thisobjnum];
+
+	if (!(this_obj->flags & OF_POLYGON_OBJECT) || (this_obj->mtype.phys_info.flags & PF_POINT_COLLIDE_WALLS))
+		return true;
+
+	if (fq->rad != this_obj->size)
+		return true;
+
+	return (this_obj->type == OBJ_WEAPON || this_obj->type == OBJ_POWERUP || this_obj->type == OBJ_DEBRIS || this_obj->type == OBJ_ROOM);
+}
+
+// For up to FVI_BATCH_WIDTH rays starting in the same room, clears the face bits of every
+// non-portal face a ray can't hit.  A ray can only hit a face if it moves toward the face's plane
+// from in front of it and ends within its radius of the plane (or the same from behind, for
+// FQ_BACKFACE).  The hit point only ever moves back toward p0, so this holds for the whole query.
+static void fvi_batch_cull_faces(int roomnum, fvi_query **fq, int num_rays, uint face_bits[][FVI_BATCH_FACE_WORDS])
+{
+	const room *cur_room = &Rooms[roomnum];
+	float p0x[FVI_BATCH_WIDTH], p0y[FVI_BATCH_WIDTH], p0z[FVI_BATCH_WIDTH];
+	float p1x[FVI_BATCH_WIDTH], p1y[FVI_BATCH_WIDTH], p1z[FVI_BATCH_WIDTH];
+	float rad[FVI_BATCH_WIDTH];
+	int backface[FVI_BATCH_WIDTH];
+	int hit[FVI_BATCH_WIDTH];
+	vector min_xyz, max_xyz;
+	int k;
+
+	min_xyz = max_xyz = *fq[0]->p0;
+
+	for (k = 0; k < num_rays; k++)
+	{
+		const vector *p0 = fq[k]->p0;
+		const vector *p1 = fq[k]->p1;
+		vector min_offset, max_offset;
+
+		p0x[k] = p0->x; p0y[k] = p0->y; p0z[k] = p0->z;
+		p1x[k] = p1->x; p1y[k] = p1->y; p1z[k] = p1->z;
+		rad[k] = fq[k]->rad + FVI_BATCH_PLANE_EPSILON;
+		backface[k] = (fq[k]->flags & FQ_BACKFACE) ? 1 : 0;
+
+		// Grow the box the same way compute_movement_AABB() does, plus some slop
+		if (fq[k]->rad == 0.0f)
+		{
+			min_offset = max_offset = Zero_vector;
+		}
+		else if (fq[k]->thisobjnum < 0)
+		{
+			max_offset.x = max_offset.y = max_offset.z = fq[k]->rad;
+			min_offset = -max_offset;
+		}
+		else
+		{
+			const object *this_obj = &Objects[fq[k]->thisobjnum];
+			max_offset = this_obj->max_xyz - this_obj->pos;
+			min_offset = this_obj->min_xyz - this_obj->pos;
+		}
+
+		min_offset.x -= FVI_BATCH_PLANE_EPSILON; min_offset.y -= FVI_BATCH_PLANE_EPSILON; min_offset.z -= FVI_BATCH_PLANE_EPSILON;
+		max_offset.x += FVI_BATCH_PLANE_EPSILON; max_offset.y += FVI_BATCH_PLANE_EPSILON; max_offset.z += FVI_BATCH_PLANE_EPSILON;
+
+		const vector lo = {(p0->x < p1->x ? p0->x : p1->x) + min_offset.x, (p0->y < p1->y ? p0->y : p1->y) + min_offset.y, (p0->z < p1->z ? p0->z : p1->z) + min_offset.z};
+		const vector hi = {(p0->x > p1->x ? p0->x : p1->x) + max_offset.x, (p0->y > p1->y ? p0->y : p1->y) + max_offset.y, (p0->z > p1->z ? p0->z : p1->z) + max_offset.z};
+
+		if (lo.x < min_xyz.x) min_xyz.x = lo.x;
+		if (lo.y < min_xyz.y) min_xyz.y = lo.y;
+		if (lo.z < min_xyz.z) min_xyz.z = lo.z;
+		if (hi.x > max_xyz.x) max_xyz.x = hi.x;
+		if (hi.y > max_xyz.y) max_xyz.y = hi.y;
+		if (hi.z > max_xyz.z) max_xyz.z = hi.z;
+	}
+
+	const int num_words = (cur_room->num_faces + 31) >> 5;
+
+	for (k = 0; k < num_rays; k++)
+		memset(face_bits[k], 0, num_words * sizeof(uint));
+
+	// Each ray's own box is inside this one, so every face it could reach is in the list
+	ubyte msector = 0;
+
+	if(min_xyz.x <= cur_room->bbf_min_xyz.x) msector |= 0x01;
+	if(min_xyz.y <= cur_room->bbf_min_xyz.y) msector |= 0x02;
+	if(min_xyz.z <= cur_room->bbf_min_xyz.z) msector |= 0x04;
+	if(max_xyz.x >= cur_room->bbf_max_xyz.x) msector |= 0x08;
+	if(max_xyz.y >= cur_room->bbf_max_xyz.y) msector |= 0x10;
+	if(max_xyz.z >= cur_room->bbf_max_xyz.z) msector |= 0x20;
+
+	short room_faces[MAX_FACES_PER_ROOM];
+	const int num_room_faces = fvi_RoomFacesInBox(roomnum, &min_xyz, &max_xyz, msector, room_faces);
+
+	for (int f = 0; f < num_room_faces; f++)
+	{
+		const int i = room_faces[f];
+		const face *fp = &cur_room->faces[i];
+		const uint bit = 1 << (i & 31);
+
+		// Portals add rooms to the search without being hit, so they always stay
+		if (fp->portal_num >= 0)
+		{
+			for (k = 0; k < num_rays; k++)
+				face_bits[k][i >> 5] |= bit;
+			continue;
+		}
+
+		// The plane's offset along the normal, over every vertex since faces aren't quite flat
+		const vector n = fp->normal;
+		float cmin = n * cur_room->verts[fp->face_verts[0]];
+		float cmax = cmin;
+
+		for (int v = 1; v < fp->num_verts; v++)
+		{
+			const float c = n * cur_room->verts[fp->face_verts[v]];
+			if (c < cmin) cmin = c;
+			if (c > cmax) cmax = c;
+		}
+
+		// Straight line code over the rays, so it vectorizes
+		for (k = 0; k < num_rays; k++)
+		{
+			const float a0 = n.x * p0x[k] + n.y * p0y[k] + n.z * p0z[k];
+			const float a1 = n.x * p1x[k] + n.y * p1y[k] + n.z * p1z[k];
+
+			const int front = (a1 < a0 + FVI_BATCH_PLANE_EPSILON) & (cmin <= a0 + FVI_BATCH_PLANE_EPSILON) & (cmax > a1 - rad[k]);
+			const int back = backface[k] & (a1 > a0 - FVI_BATCH_PLANE_EPSILON) & (cmax >= a0 - FVI_BATCH_PLANE_EPSILON) & (cmin < a1 + rad[k]);
+
+			hit[k] = front | back;
+		}
+
+		for (k = 0; k < num_rays; k++)
+		{
+			if (hit[k])
+				face_bits[k][i >> 5] |= bit;
+		}
+	}
+}
+
+// Runs a set of independent queries, leaving each result in the matching hit_data entry
+void fvi_FindIntersectionBatch(int num_queries, fvi_query *fq, fvi_info *hit_data)
+{
+	fvi_context *ctx = fvi_GetThreadContext();
+	int order[FVI_BATCH_CHUNK];
+	uint face_bits[FVI_BATCH_WIDTH][FVI_BATCH_FACE_WORDS];
+	fvi_query *cull_fq[FVI_BATCH_WIDTH];
+	int cull_index[FVI_BATCH_WIDTH];
+
+	for (int chunk = 0; chunk < num_queries; chunk += FVI_BATCH_CHUNK)
+	{
+		const int num_chunk = (num_queries - chunk < FVI_BATCH_CHUNK) ? (num_queries - chunk) : FVI_BATCH_CHUNK;
+		int i;
+
+		// Group the queries by start room, keeping the caller's order within a room
+		for (i = 0; i < num_chunk; i++)
+		{
+			ASSERT(!(fq[chunk + i].flags & FQ_RECORD));
+			order[i] = chunk + i;
+		}
+
+		std::sort(order, order + num_chunk, [fq](int a, int b)
+		{
+			return (fq[a].startroom != fq[b].startroom) ? (fq[a].startroom < fq[b].startroom) : (a < b);
+		});
+
+		i = 0;
+		while (i < num_chunk)
+		{
+			const int startroom = fq[order[i]].startroom;
+			const bool f_cull = (startroom >= 0 && !ROOMNUM_OUTSIDE(startroom) && !(Rooms[startroom].flags & RF_EXTERNAL));
+			int num_cull = 0;
+			int end = i;
+
+			// Take the next few rays from this room
+			while (end < num_chunk && fq[order[end]].startroom == startroom && end - i < FVI_BATCH_WIDTH)
+			{
+				fvi_query *q = &fq[order[end]];
+
+				if (f_cull && !(q->flags & FQ_IGNORE_WALLS) && fvi_batch_plain_wall_sphere(q))
+				{
+					cull_index[num_cull] = order[end];
+					cull_fq[num_cull++] = q;
+				}
+				end++;
+			}
+
+			if (num_cull > 1)
+				fvi_batch_cull_faces(startroom, cull_fq, num_cull, face_bits);
+			else
+				num_cull = 0;
+
+			for (int j = i; j < end; j++)
+			{
+				const int index = order[j];
+				int k;
+
+				for (k = 0; k < num_cull; k++)
+				{
+					if (cull_index[k] == index)
+						break;
+				}
+
+				if (k < num_cull)
+				{
+					ctx->batch_room = startroom;
+					ctx->batch_face_bits = face_bits[k];
+				}
+
+				fvi_FindIntersection(ctx, &fq[index], &hit_data[index]);
+
+				ctx->batch_face_bits = NULL;
+			}
+
+			i = end;
+		}
+	}
+}
+
 int obj_in_list(int objnum,int *obj_list)
 {
 	int t;
@@ -3431,7 +3797,7 @@ bool BBoxPlaneIntersection(bool fast_exit, vector *collision_point, vector *coll
 
 	for(i = 0; i < 8; i++)
 	{
-		collidable[i] = true;//(PointSpeed(&Objects[fvi_query_ptr->thisobjnum], &verts[i], orient, rotvel, velocity).y < 0.0);
+		collidable[i] = true;//(PointSpeed(&Objects[ctx->query_ptr->thisobjnum], &verts[i], orient, rotvel, velocity).y < 0.0);
 	}
 
 	// Get Ground intersection points
@@ -3505,18 +3871,18 @@ int object_intersects_wall(object *objp)
 	return 0;
 }
 
-void check_hit_obj(int objnum)
+void check_hit_obj(fvi_context *ctx, int objnum)
 {
 	vector hit_point;
 	float cur_dist;
 	const object *obj = &Objects[objnum];
 	bool f_x = false;
 	int collision_type;
-	int m_obj_index =  fvi_query_ptr->thisobjnum;
+	int m_obj_index =  ctx->query_ptr->thisobjnum;
 	object *m_obj = &Objects[m_obj_index];
 
-	if (!(fvi_query_ptr->flags & FQ_CHECK_OBJS) && (obj->type != OBJ_ROOM)) return;
-	if((fvi_query_ptr->flags & (FQ_IGNORE_EXTERNAL_ROOMS)) && (obj->type == OBJ_ROOM)) return;
+	if (!(ctx->query_ptr->flags & FQ_CHECK_OBJS) && (obj->type != OBJ_ROOM)) return;
+	if((ctx->query_ptr->flags & (FQ_IGNORE_EXTERNAL_ROOMS)) && (obj->type == OBJ_ROOM)) return;
 
 	if(obj->flags & OF_NO_OBJECT_COLLISIONS)
 		return;
@@ -3533,7 +3899,7 @@ void check_hit_obj(int objnum)
 				if(!(m_obj_index  > -1) && (CollisionRayResult[obj->type] == RESULT_NOTHING))
 					return;
 				
-				if(object_movement_AABB(&Objects[objnum])) 
+				if(object_movement_AABB(ctx, &Objects[objnum])) 
 				{
 					#ifndef NED_PHYSICS
 					#ifdef _DEBUG
@@ -3551,7 +3917,7 @@ void check_hit_obj(int objnum)
 					#endif
 					#endif
 
-					if(fvi_query_ptr->ignore_obj_list == NULL || !obj_in_list(objnum, fvi_query_ptr->ignore_obj_list)) 
+					if(ctx->query_ptr->ignore_obj_list == NULL || !obj_in_list(objnum, ctx->query_ptr->ignore_obj_list)) 
 					{
 						if(!ObjectsAreRelated( objnum, m_obj_index )) 
 						{
@@ -3561,19 +3927,19 @@ void check_hit_obj(int objnum)
 								switch(obj->type)
 								{
 									case OBJ_ROOM:
-										if(fvi_query_ptr->flags & FQ_EXTERNAL_ROOMS_AS_SPHERE)
+										if(ctx->query_ptr->flags & FQ_EXTERNAL_ROOMS_AS_SPHERE)
 											collision_type = RESULT_CHECK_SPHERE_SPHERE;
 										else
 											collision_type = RESULT_CHECK_SPHERE_ROOM;
 										break;
 									case OBJ_PLAYER:
-										if(fvi_query_ptr->flags & FQ_PLAYERS_AS_SPHERE)
+										if(ctx->query_ptr->flags & FQ_PLAYERS_AS_SPHERE)
 											collision_type = RESULT_CHECK_SPHERE_SPHERE;
 										else
 											collision_type = RESULT_CHECK_SPHERE_POLY;
 										break;
 									case OBJ_ROBOT:
-										if(fvi_query_ptr->flags & FQ_ROBOTS_AS_SPHERE)
+										if(ctx->query_ptr->flags & FQ_ROBOTS_AS_SPHERE)
 											collision_type = RESULT_CHECK_SPHERE_SPHERE;
 										else
 											collision_type = RESULT_CHECK_SPHERE_POLY;
@@ -3613,37 +3979,37 @@ void check_hit_obj(int objnum)
 								}
 							}
 
-							if (fvi_query_ptr->flags & FQ_IGNORE_NON_LIGHTMAP_OBJECTS)
+							if (ctx->query_ptr->flags & FQ_IGNORE_NON_LIGHTMAP_OBJECTS)
 								if (obj->lighting_render_type!=LRT_LIGHTMAPS && obj->type != OBJ_ROOM)
 									return;
 
-							if (fvi_query_ptr->flags & FQ_IGNORE_POWERUPS)
+							if (ctx->query_ptr->flags & FQ_IGNORE_POWERUPS)
 								if (obj->type == OBJ_POWERUP)
 									return;
 
-							if (fvi_query_ptr->flags & FQ_IGNORE_WEAPONS)
+							if (ctx->query_ptr->flags & FQ_IGNORE_WEAPONS)
 								if (obj->type == OBJ_WEAPON || obj->type == OBJ_FIREBALL || obj->type == OBJ_SHARD || obj->type == OBJ_SHOCKWAVE)
 									return;
 
-							if (fvi_query_ptr->flags & FQ_IGNORE_MOVING_OBJECTS)
+							if (ctx->query_ptr->flags & FQ_IGNORE_MOVING_OBJECTS)
 								if (obj->movement_type == MT_PHYSICS || obj->movement_type == MT_WALKING)
 									return;
 
 							if(obj->type != OBJ_ROOM)
 							{
-								if (fvi_query_ptr->flags & FQ_ONLY_PLAYER_OBJ)
+								if (ctx->query_ptr->flags & FQ_ONLY_PLAYER_OBJ)
 									if (obj->type != OBJ_PLAYER)
 										return;
 
-								if (fvi_query_ptr->flags & FQ_ONLY_DOOR_OBJ)
+								if (ctx->query_ptr->flags & FQ_ONLY_DOOR_OBJ)
 									if (obj->type != OBJ_DOOR)
 										return;
 							}
 
 
-							if (obj->type==OBJ_PLAYER && (fvi_query_ptr->flags & FQ_PLAYERS_AS_SPHERE))
+							if (obj->type==OBJ_PLAYER && (ctx->query_ptr->flags & FQ_PLAYERS_AS_SPHERE))
 								collision_type = RESULT_CHECK_SPHERE_SPHERE;
-							if (obj->type==OBJ_ROBOT && (fvi_query_ptr->flags & FQ_ROBOTS_AS_SPHERE))
+							if (obj->type==OBJ_ROBOT && (ctx->query_ptr->flags & FQ_ROBOTS_AS_SPHERE))
 								collision_type = RESULT_CHECK_SPHERE_SPHERE;
 								
 							switch(collision_type)
@@ -3653,7 +4019,7 @@ void check_hit_obj(int objnum)
 								{
 									ASSERT(obj->type == OBJ_ROOM);
 									
-									fvi_room(obj->id, -1, objnum);
+									fvi_room(ctx, obj->id, -1, objnum);
 								}
 								break;
 
@@ -3668,17 +4034,17 @@ void check_hit_obj(int objnum)
 										goto sphere_sphere;
 
 //									pos = obj->pos + obj->anim_sphere_offset;
-//									dist = vm_VectorDistance(&pos, &fvi_anim_sphere_p0);
+//									dist = vm_VectorDistance(&pos, &ctx->anim_sphere_p0);
 //									size = Poly_models[obj->rtype.pobj_info.model_num].anim_size; 
 
-//									if((dist <= size + fvi_anim_sphere_rad)
-//										|| check_vector_to_object(&hit_point, &cur_dist, &fvi_anim_sphere_p0,&fvi_anim_sphere_p1, fvi_anim_sphere_rad, &Objects[objnum], &Objects[fvi_query_ptr->thisobjnum])
+//									if((dist <= size + ctx->anim_sphere_rad)
+//										|| check_vector_to_object(ctx, &hit_point, &cur_dist, &ctx->anim_sphere_p0,&ctx->anim_sphere_p1, ctx->anim_sphere_rad, &Objects[objnum], &Objects[ctx->query_ptr->thisobjnum])
 //									{									
-										fvi_curobj = objnum;
-										fvi_moveobj = m_obj_index;
-										if(PolyCollideObject(&Objects[objnum]))
+										ctx->curobj = objnum;
+										ctx->moveobj = m_obj_index;
+										if(PolyCollideObject(ctx, &Objects[objnum]))
 										{
-											compute_movement_AABB();
+											compute_movement_AABB(ctx);
 										}
 //									}
 								} 
@@ -3691,16 +4057,16 @@ void check_hit_obj(int objnum)
 										goto sphere_sphere;
 
 									// Save the Fvi information pointers.  
-									fvi_info *temp_fvi_hit_data_ptr = fvi_hit_data_ptr;
-									fvi_query *temp_fvi_query_ptr = fvi_query_ptr;
+									fvi_info *temp_fvi_hit_data_ptr = ctx->hit_data_ptr;
+									fvi_query *temp_fvi_query_ptr = ctx->query_ptr;
 									fvi_info hit_info;
 									fvi_query fq;
-									float saved_dist = fvi_collision_dist;
+									float saved_dist = ctx->collision_dist;
 
-									vector relative_pos = obj->pos + (*fvi_query_ptr->p0 - *fvi_query_ptr->p1);
+									vector relative_pos = obj->pos + (*ctx->query_ptr->p0 - *ctx->query_ptr->p1);
 									
-									fvi_hit_data_ptr = &hit_info;
-									fvi_query_ptr = &fq;
+									ctx->hit_data_ptr = &hit_info;
+									ctx->query_ptr = &fq;
 
 									fq.p0						= &Objects[objnum].pos;
 									fq.p1						= &relative_pos;
@@ -3711,41 +4077,41 @@ void check_hit_obj(int objnum)
 									hit_info.num_hits    = 0;
 									hit_info.hit_type[0] = HIT_NONE;
 
-									fvi_curobj = m_obj_index;
-									fvi_moveobj = objnum;
-									PolyCollideObject(&Objects[temp_fvi_query_ptr->thisobjnum]);
+									ctx->curobj = m_obj_index;
+									ctx->moveobj = objnum;
+									PolyCollideObject(ctx, &Objects[temp_fvi_query_ptr->thisobjnum]);
 
-									fvi_hit_data_ptr = temp_fvi_hit_data_ptr;
-									fvi_query_ptr = temp_fvi_query_ptr;
+									ctx->hit_data_ptr = temp_fvi_hit_data_ptr;
+									ctx->query_ptr = temp_fvi_query_ptr;
 
 									if(hit_info.hit_type[0] != HIT_NONE)
 									{
 										int counter;
 
-										if(saved_dist != fvi_collision_dist)
+										if(saved_dist != ctx->collision_dist)
 										{
-											fvi_hit_data_ptr->hit_pnt = m_obj->pos + (obj->pos - hit_info.hit_pnt); 
-											compute_movement_AABB();
+											ctx->hit_data_ptr->hit_pnt = m_obj->pos + (obj->pos - hit_info.hit_pnt); 
+											compute_movement_AABB(ctx);
 										}
 
-										fvi_hit_data_ptr->num_hits = 0;
+										ctx->hit_data_ptr->num_hits = 0;
 
 										for(counter = 0; counter < hit_info.num_hits; counter++)
 										{
-											fvi_hit_data_ptr->hit_type[fvi_hit_data_ptr->num_hits]      = HIT_OBJECT;
-											fvi_hit_data_ptr->hit_object[fvi_hit_data_ptr->num_hits]    = objnum; 
-											fvi_hit_data_ptr->hit_face_pnt[fvi_hit_data_ptr->num_hits]  = fvi_hit_data_ptr->hit_pnt + (hit_info.hit_face_pnt[counter] - m_obj->pos);
-											fvi_hit_data_ptr->hit_wallnorm[fvi_hit_data_ptr->num_hits]  = -hit_info.hit_wallnorm[counter];
-											fvi_hit_data_ptr->hit_subobject[0]									= hit_info.hit_subobject[0];
-											fvi_hit_data_ptr->hit_face[0]									      = hit_info.hit_face[0];
-											fvi_hit_data_ptr->hit_subobj_fvec	                   		= hit_info.hit_subobj_fvec;
-											fvi_hit_data_ptr->hit_subobj_uvec	                   		= hit_info.hit_subobj_uvec;
-											fvi_hit_data_ptr->hit_subobj_pos										= hit_info.hit_subobj_pos;
-
-											fvi_hit_data_ptr->num_hits++;
+											ctx->hit_data_ptr->hit_type[ctx->hit_data_ptr->num_hits]      = HIT_OBJECT;
+											ctx->hit_data_ptr->hit_object[ctx->hit_data_ptr->num_hits]    = objnum; 
+											ctx->hit_data_ptr->hit_face_pnt[ctx->hit_data_ptr->num_hits]  = ctx->hit_data_ptr->hit_pnt + (hit_info.hit_face_pnt[counter] - m_obj->pos);
+											ctx->hit_data_ptr->hit_wallnorm[ctx->hit_data_ptr->num_hits]  = -hit_info.hit_wallnorm[counter];
+											ctx->hit_data_ptr->hit_subobject[0]									= hit_info.hit_subobject[0];
+											ctx->hit_data_ptr->hit_face[0]									      = hit_info.hit_face[0];
+											ctx->hit_data_ptr->hit_subobj_fvec	                   		= hit_info.hit_subobj_fvec;
+											ctx->hit_data_ptr->hit_subobj_uvec	                   		= hit_info.hit_subobj_uvec;
+											ctx->hit_data_ptr->hit_subobj_pos										= hit_info.hit_subobj_pos;
+
+											ctx->hit_data_ptr->num_hits++;
 										}
 
-										ASSERT(!(fvi_hit_data_ptr->num_hits > 1 && !(fvi_query_ptr->flags & FQ_MULTI_POINT)));
+										ASSERT(!(ctx->hit_data_ptr->num_hits > 1 && !(ctx->query_ptr->flags & FQ_MULTI_POINT)));
 									}
 								} 
 								break;
@@ -3755,11 +4121,11 @@ void check_hit_obj(int objnum)
 								case RESULT_CHECK_SPHERE_BBOX:
 								case RESULT_CHECK_BBOX_SPHERE: 
 								{
-sphere_sphere:					if(check_vector_to_object(&hit_point, &cur_dist, &fvi_anim_sphere_p0, &fvi_anim_sphere_p1, fvi_anim_sphere_rad, &Objects[objnum], &Objects[m_obj_index]))
+sphere_sphere:					if(check_vector_to_object(ctx, &hit_point, &cur_dist, &ctx->anim_sphere_p0, &ctx->anim_sphere_p1, ctx->anim_sphere_rad, &Objects[objnum], &Objects[m_obj_index]))
 									{
 									//	hit_point 
 
-										if (cur_dist < fvi_collision_dist) 
+										if (cur_dist < ctx->collision_dist) 
 										{
 
 											vector pos_hit;
@@ -3783,18 +4149,18 @@ sphere_sphere:					if(check_vector_to_object(&hit_point, &cur_dist, &fvi_anim_sp
 												hit_obj_size = obj->size;
 											}
 
-											pos_hit = hit_obj_pos + pos_hit * (hit_obj_size / (hit_obj_size + fvi_anim_sphere_rad));
-											ASSERT(hit_obj_size + fvi_anim_sphere_rad > 0.0f);
+											pos_hit = hit_obj_pos + pos_hit * (hit_obj_size / (hit_obj_size + ctx->anim_sphere_rad));
+											ASSERT(hit_obj_size + ctx->anim_sphere_rad > 0.0f);
 
-											fvi_collision_dist			=	cur_dist; 
-											fvi_hit_data_ptr->hit_pnt  =	hit_point - fvi_anim_sphere_offset; 
-											compute_movement_AABB();
-											fvi_hit_data_ptr->num_hits = 1;
+											ctx->collision_dist			=	cur_dist; 
+											ctx->hit_data_ptr->hit_pnt  =	hit_point - ctx->anim_sphere_offset; 
+											compute_movement_AABB(ctx);
+											ctx->hit_data_ptr->num_hits = 1;
 
-											fvi_hit_data_ptr->hit_object[0]	 =	objnum; 
-											fvi_hit_data_ptr->hit_type[0]		 =	HIT_OBJECT;
-											fvi_hit_data_ptr->hit_face_pnt[0] = pos_hit;
-											fvi_hit_data_ptr->hit_wallnorm[0] = (pos_hit - hit_obj_pos)/hit_obj_size;
+											ctx->hit_data_ptr->hit_object[0]	 =	objnum; 
+											ctx->hit_data_ptr->hit_type[0]		 =	HIT_OBJECT;
+											ctx->hit_data_ptr->hit_face_pnt[0] = pos_hit;
+											ctx->hit_data_ptr->hit_wallnorm[0] = (pos_hit - hit_obj_pos)/hit_obj_size;
 											ASSERT(hit_obj_size > 0.0f);
 
 											ASSERT(objnum != -1);
@@ -3875,18 +4241,18 @@ sphere_sphere:					if(check_vector_to_object(&hit_point, &cur_dist, &fvi_anim_sp
 		#endif
 	}
 
-	ASSERT(!(fvi_hit_data_ptr->num_hits > 1 && !(fvi_query_ptr->flags & FQ_MULTI_POINT)));
+	ASSERT(!(ctx->hit_data_ptr->num_hits > 1 && !(ctx->query_ptr->flags & FQ_MULTI_POINT)));
 }
 
 
 
 /*	// Check each terrain cell
-	for(i = 0; i < fvi_num_cells_visited; i++)
+	for(i = 0; i < ctx->num_cells_visited; i++)
 	{
 		int j_start;
 		int j_end;
 
-		start_node = GetColTerrainSegFromTerrainSeg(fvi_cells_visited[i]);
+		start_node = GetColTerrainSegFromTerrainSeg(ctx->cells_visited[i]);
 		ASSERT(start_node != -1);
 
 		if(start_node%COL_TERRAIN_WIDTH) j_start = -1;
@@ -3922,7 +4288,7 @@ sphere_sphere:					if(check_vector_to_object(&hit_point, &cur_dist, &fvi_anim_sp
 					for (objnum = Col_terrain_seg[cur_col_node].objects; objnum != -1; objnum = Objects[objnum].next)
 					{
 						if(!(Objects[objnum].flags & OF_BIG_OBJECT))
-							check_hit_obj(objnum);
+							check_hit_obj(ctx, objnum);
 					}
 				}
 			}
@@ -3933,7 +4299,7 @@ sphere_sphere:					if(check_vector_to_object(&hit_point, &cur_dist, &fvi_anim_sp
 #define MAX_BBOX_GROUND_TOLERANCE 0.0001
 
 /*
-void DoLinearApprox(vector *collision_point, vector *collision_normal, float *hit_dist, float *hit_interval, vector *movement_dir, vector *p0, object *obj, int nv, vector **vertex_ptr_list, vector *face_normal)
+void DoLinearApprox(fvi_context *ctx, vector *collision_point, vector *collision_normal, float *hit_dist, float *hit_interval, vector *movement_dir, vector *p0, object *obj, int nv, vector **vertex_ptr_list, vector *face_normal)
 {
 	vector end_pos;
 	bool hit;
@@ -3941,13 +4307,13 @@ void DoLinearApprox(vector *collision_point, vector *collision_normal, float *hi
 	*hit_interval /= 2.0f;
 	end_pos = *p0 + ((*hit_interval + *hit_dist)* *movement_dir);
 
-	float frametime = fvi_query_ptr->frametime * ((*hit_interval + *hit_dist)/vm_VectorDistance(fvi_query_ptr->p0, fvi_query_ptr->p1));
-	matrix orient = *fvi_query_ptr->o_orient;
-	vector rotvel = *fvi_query_ptr->o_rotvel; 
-	vector rotforce = *fvi_query_ptr->o_rotthrust;
-	angle turnroll = *fvi_query_ptr->o_turnroll;
-	//vector thrust = *fvi_query_ptr->o_thrust;
-	vector velocity = *fvi_query_ptr->o_velocity;
+	float frametime = ctx->query_ptr->frametime * ((*hit_interval + *hit_dist)/vm_VectorDistance(ctx->query_ptr->p0, ctx->query_ptr->p1));
+	matrix orient = *ctx->query_ptr->o_orient;
+	vector rotvel = *ctx->query_ptr->o_rotvel; 
+	vector rotforce = *ctx->query_ptr->o_rotthrust;
+	angle turnroll = *ctx->query_ptr->o_turnroll;
+	//vector thrust = *ctx->query_ptr->o_thrust;
+	vector velocity = *ctx->query_ptr->o_velocity;
 	//vector movement_pos;
 	//vector movement_vec;
 	//vector test;
@@ -3955,8 +4321,8 @@ void DoLinearApprox(vector *collision_point, vector *collision_normal, float *hi
 	float sim_time_remaining = frametime;
 	float old_sim_time_remaining = frametime;
 
-	PhysicsDoSimRot(&Objects[fvi_query_ptr->thisobjnum], frametime, &orient, &rotforce, &rotvel, &turnroll);
-//	PhysicsDoSimLinear(&Objects[fvi_query_ptr->thisobjnum], &Objects[fvi_query_ptr->thisobjnum].pos, &thrust, &velocity, &movement_vec, &movement_pos, frametime);
+	PhysicsDoSimRot(&Objects[ctx->query_ptr->thisobjnum], frametime, &orient, &rotforce, &rotvel, &turnroll);
+//	PhysicsDoSimLinear(&Objects[ctx->query_ptr->thisobjnum], &Objects[ctx->query_ptr->thisobjnum].pos, &thrust, &velocity, &movement_vec, &movement_pos, frametime);
 
 
 	vector moved_vec_n;
@@ -3975,7 +4341,7 @@ void DoLinearApprox(vector *collision_point, vector *collision_normal, float *hi
 	}
 
 	// Compute more results of this simulation
-	attempted_dist = vm_VectorDistance(fvi_query_ptr->p0, fvi_query_ptr->p1);
+	attempted_dist = vm_VectorDistance(ctx->query_ptr->p0, ctx->query_ptr->p1);
 	sim_time_remaining = sim_time_remaining * ((attempted_dist - actual_dist) / attempted_dist);
 	float moved_time = old_sim_time_remaining - sim_time_remaining;
 
@@ -3993,11 +4359,11 @@ void DoLinearApprox(vector *collision_point, vector *collision_normal, float *hi
 
 	if(old_sim_time_remaining > 0.0) 
 	{
-		velocity = fvi_hit_data_ptr->hit_velocity * (moved_time / old_sim_time_remaining) + velocity * (sim_time_remaining / old_sim_time_remaining);
+		velocity = ctx->hit_data_ptr->hit_velocity * (moved_time / old_sim_time_remaining) + velocity * (sim_time_remaining / old_sim_time_remaining);
 	}
 	else
 	{
-		velocity = fvi_hit_data_ptr->hit_velocity;
+		velocity = ctx->hit_data_ptr->hit_velocity;
 	}
 
 	hit = BBoxPlaneIntersection(false, collision_point, collision_normal, obj, &end_pos, nv, vertex_ptr_list, face_normal, &orient, &rotvel, &velocity);
@@ -4008,21 +4374,21 @@ void DoLinearApprox(vector *collision_point, vector *collision_normal, float *hi
 	}
 	else
 	{
-		fvi_hit_data_ptr->hit_pnt = end_pos;
-		fvi_hit_data_ptr->hit_turnroll = turnroll;
-		fvi_hit_data_ptr->hit_orient = orient;
-		fvi_hit_data_ptr->hit_rotvel = rotvel;
+		ctx->hit_data_ptr->hit_pnt = end_pos;
+		ctx->hit_data_ptr->hit_turnroll = turnroll;
+		ctx->hit_data_ptr->hit_orient = orient;
+		ctx->hit_data_ptr->hit_rotvel = rotvel;
 	}
 
 	if(*hit_interval > MAX_BBOX_GROUND_TOLERANCE)
-		DoLinearApprox(collision_point, collision_normal, hit_dist, hit_interval, movement_dir, p0, obj, nv, vertex_ptr_list, face_normal);
+		DoLinearApprox(ctx, collision_point, collision_normal, hit_dist, hit_interval, movement_dir, p0, obj, nv, vertex_ptr_list, face_normal);
 
 	return;
 }
 */
 // checks for collisions within a given terrain node (fvi_sub minus the recursiveness).
 // If f_check_local_nodes is set, it will look in surrounding nodes.
-inline void check_terrain_node(int cur_node, bool f_check_local_nodes, bool f_check_ground) 
+inline void check_terrain_node(fvi_context *ctx, int cur_node, bool f_check_local_nodes, bool f_check_ground) 
 {
 	vector hit_point;
 	float cur_dist;
@@ -4039,38 +4405,38 @@ inline void check_terrain_node(int cur_node, bool f_check_local_nodes, bool f_ch
 	bool f_check_next_ground;
 	object *this_obj;
 
-	if(fvi_query_ptr->thisobjnum >= 0)
-		this_obj = &Objects[fvi_query_ptr->thisobjnum];
+	if(ctx->query_ptr->thisobjnum >= 0)
+		this_obj = &Objects[ctx->query_ptr->thisobjnum];
 	else
 		this_obj = NULL;
 
 	// Object checks
-	if((fvi_terrain_obj_visit_list[cur_node >> 3] & (0x01 << (cur_node % 8))) == 0)
+	if((ctx->terrain_obj_visit_list[cur_node >> 3] & (0x01 << (cur_node % 8))) == 0)
 	{
 		ASSERT(cur_node >= 0 && cur_node < TERRAIN_WIDTH * TERRAIN_DEPTH);
-		ASSERT(fvi_num_cells_obj_visited < MAX_CELLS_VISITED);
-		fvi_terrain_obj_visit_list[cur_node >> 3] |= 0x01 << (cur_node % 8);
-		fvi_cells_obj_visited[fvi_num_cells_obj_visited] = cur_node;
-		fvi_num_cells_obj_visited++;
+		ASSERT(ctx->num_cells_obj_visited < MAX_CELLS_VISITED);
+		ctx->terrain_obj_visit_list[cur_node >> 3] |= 0x01 << (cur_node % 8);
+		ctx->cells_obj_visited[ctx->num_cells_obj_visited] = cur_node;
+		ctx->num_cells_obj_visited++;
 		
-		if(fvi_query_ptr->flags & FQ_CHECK_OBJS)
+		if(ctx->query_ptr->flags & FQ_CHECK_OBJS)
 		{
 			for (objnum = Terrain_seg[cur_node].objects; objnum != -1; objnum = Objects[objnum].next)
 			{
 				ASSERT(objnum != -1);
 				if(!(Objects[objnum].flags & OF_BIG_OBJECT))
-					check_hit_obj(objnum);
+					check_hit_obj(ctx, objnum);
 			}
 		}
 		else
 		{
 
-			if(!(fvi_query_ptr->flags & FQ_IGNORE_EXTERNAL_ROOMS))
+			if(!(ctx->query_ptr->flags & FQ_IGNORE_EXTERNAL_ROOMS))
 				for (objnum = Terrain_seg[cur_node].objects; objnum != -1; objnum = Objects[objnum].next)
 				{
 					ASSERT(objnum != -1);
 					if((Objects[objnum].type == OBJ_ROOM) && !(Objects[objnum].flags & OF_BIG_OBJECT))
-						check_hit_obj(objnum);
+						check_hit_obj(ctx, objnum);
 				}
 		}
 	}
@@ -4082,18 +4448,18 @@ inline void check_terrain_node(int cur_node, bool f_check_local_nodes, bool f_ch
 		int lod_z = (cur_node/TERRAIN_WIDTH)>>2;
 
 		ASSERT(cur_node >= 0 && cur_node < TERRAIN_WIDTH * TERRAIN_DEPTH);
-		ASSERT((fvi_terrain_visit_list[cur_node >> 3] & (0x01 << (cur_node % 8))) == 0);
-		ASSERT(fvi_num_cells_visited < MAX_CELLS_VISITED);
+		ASSERT((ctx->terrain_visit_list[cur_node >> 3] & (0x01 << (cur_node % 8))) == 0);
+		ASSERT(ctx->num_cells_visited < MAX_CELLS_VISITED);
 
 		// Mark the current node as visited
-		fvi_terrain_visit_list[cur_node >> 3] |= 0x01 << (cur_node % 8);
-		fvi_cells_visited[fvi_num_cells_visited] = cur_node;
-		fvi_num_cells_visited++;
+		ctx->terrain_visit_list[cur_node >> 3] |= 0x01 << (cur_node % 8);
+		ctx->cells_visited[ctx->num_cells_visited] = cur_node;
+		ctx->num_cells_visited++;
 
-		if(((float)Terrain_max_height_int[6][lod_z*(TERRAIN_WIDTH>>2)+lod_x] * TERRAIN_HEIGHT_INCREMENT + fvi_query_ptr->rad >= fvi_query_ptr->p0->y ||
-			 (float)Terrain_max_height_int[6][lod_z*(TERRAIN_WIDTH>>2)+lod_x] * TERRAIN_HEIGHT_INCREMENT + fvi_query_ptr->rad >= fvi_query_ptr->p1->y) &&
+		if(((float)Terrain_max_height_int[6][lod_z*(TERRAIN_WIDTH>>2)+lod_x] * TERRAIN_HEIGHT_INCREMENT + ctx->query_ptr->rad >= ctx->query_ptr->p0->y ||
+			 (float)Terrain_max_height_int[6][lod_z*(TERRAIN_WIDTH>>2)+lod_x] * TERRAIN_HEIGHT_INCREMENT + ctx->query_ptr->rad >= ctx->query_ptr->p1->y) &&
  	      !(Terrain_seg[cur_node].flags & TF_INVISIBLE) &&
-			!(fvi_query_ptr->flags & (FQ_IGNORE_WALLS | FQ_IGNORE_TERRAIN)))
+			!(ctx->query_ptr->flags & (FQ_IGNORE_WALLS | FQ_IGNORE_TERRAIN)))
 		{
 
 			// check this node for ground collision
@@ -4168,22 +4534,22 @@ inline void check_terrain_node(int cur_node, bool f_check_local_nodes, bool f_ch
 				}
 				
 				// Did we hit this face?
-				if((fvi_query_ptr->thisobjnum >= 0) &&
-					(Objects[fvi_query_ptr->thisobjnum].mtype.phys_info.flags & PF_POINT_COLLIDE_WALLS))
+				if((ctx->query_ptr->thisobjnum >= 0) &&
+					(Objects[ctx->query_ptr->thisobjnum].mtype.phys_info.flags & PF_POINT_COLLIDE_WALLS))
 				{
-					face_hit_type = check_line_to_face(&hit_point, &colp, &cur_dist, &wall_norm, fvi_query_ptr->p0, &fvi_hit_data_ptr->hit_pnt, &face_normal, vertex_ptr_list, 3, 0.0f);
+					face_hit_type = check_line_to_face(&hit_point, &colp, &cur_dist, &wall_norm, ctx->query_ptr->p0, &ctx->hit_data_ptr->hit_pnt, &face_normal, vertex_ptr_list, 3, 0.0f);
 				}
 				else if((this_obj) && (this_obj->flags & OF_POLYGON_OBJECT))
 				{
-					face_hit_type = check_line_to_face(&hit_point, &colp, &cur_dist, &wall_norm, &fvi_wall_sphere_p0, &fvi_wall_sphere_p1, &face_normal, vertex_ptr_list, 3, fvi_wall_sphere_rad);
-					hit_point -= fvi_wall_sphere_offset;
+					face_hit_type = check_line_to_face(&hit_point, &colp, &cur_dist, &wall_norm, &ctx->wall_sphere_p0, &ctx->wall_sphere_p1, &face_normal, vertex_ptr_list, 3, ctx->wall_sphere_rad);
+					hit_point -= ctx->wall_sphere_offset;
 				}
 				else
 				{
-					face_hit_type = check_line_to_face(&hit_point, &colp, &cur_dist, &wall_norm, fvi_query_ptr->p0, &fvi_hit_data_ptr->hit_pnt, &face_normal, vertex_ptr_list, 3, fvi_query_ptr->rad);
+					face_hit_type = check_line_to_face(&hit_point, &colp, &cur_dist, &wall_norm, ctx->query_ptr->p0, &ctx->hit_data_ptr->hit_pnt, &face_normal, vertex_ptr_list, 3, ctx->query_ptr->rad);
 				}
 
-//				if(Objects[fvi_query_ptr->thisobjnum].type == OBJ_CLUTTER) mprintf((0, "Y = %f\n", Objects[fvi_query_ptr->thisobjnum].pos.y));
+//				if(Objects[ctx->query_ptr->thisobjnum].type == OBJ_CLUTTER) mprintf((0, "Y = %f\n", Objects[ctx->query_ptr->thisobjnum].pos.y));
 //
 				
 
@@ -4191,49 +4557,49 @@ inline void check_terrain_node(int cur_node, bool f_check_local_nodes, bool f_ch
 				// false and all other times with true for fast exit.
 /*				if(this_obj && this_obj->type == OBJ_CLUTTER)
 				{
-					if(!BBoxPlaneIntersection(true, &fvi_hit_data_ptr->hit_face_pnt[0], &fvi_hit_data_ptr->hit_wallnorm[0], &Objects[fvi_query_ptr->thisobjnum], fvi_query_ptr->p0, 3, vertex_ptr_list, &face_normal, fvi_query_ptr->o_orient, fvi_query_ptr->o_rotvel, fvi_query_ptr->o_velocity))
+					if(!BBoxPlaneIntersection(true, &ctx->hit_data_ptr->hit_face_pnt[0], &ctx->hit_data_ptr->hit_wallnorm[0], &Objects[ctx->query_ptr->thisobjnum], ctx->query_ptr->p0, 3, vertex_ptr_list, &face_normal, ctx->query_ptr->o_orient, ctx->query_ptr->o_rotvel, ctx->query_ptr->o_velocity))
 						ASSERT(1);
 
-					if(fvi_hit_data_ptr->hit_type[0] == HIT_NONE && 
-						BBoxPlaneIntersection(false, &fvi_hit_data_ptr->hit_face_pnt[0], &fvi_hit_data_ptr->hit_wallnorm[0], &Objects[fvi_query_ptr->thisobjnum], &fvi_hit_data_ptr->hit_pnt, 3, vertex_ptr_list, &face_normal, &fvi_hit_data_ptr->hit_orient, &fvi_hit_data_ptr->hit_rotvel, &fvi_hit_data_ptr->hit_velocity))
+					if(ctx->hit_data_ptr->hit_type[0] == HIT_NONE && 
+						BBoxPlaneIntersection(false, &ctx->hit_data_ptr->hit_face_pnt[0], &ctx->hit_data_ptr->hit_wallnorm[0], &Objects[ctx->query_ptr->thisobjnum], &ctx->hit_data_ptr->hit_pnt, 3, vertex_ptr_list, &face_normal, &ctx->hit_data_ptr->hit_orient, &ctx->hit_data_ptr->hit_rotvel, &ctx->hit_data_ptr->hit_velocity))
 					{
 						float hit_dist = 0.0;
 						float hit_interval;
 						vector movement_dir;
 
-						if(!BBoxPlaneIntersection(false, &fvi_hit_data_ptr->hit_face_pnt[0], &fvi_hit_data_ptr->hit_wallnorm[0], &Objects[fvi_query_ptr->thisobjnum], fvi_query_ptr->p0, 3, vertex_ptr_list, &face_normal, fvi_query_ptr->o_orient, fvi_query_ptr->o_rotvel, fvi_query_ptr->o_velocity))
+						if(!BBoxPlaneIntersection(false, &ctx->hit_data_ptr->hit_face_pnt[0], &ctx->hit_data_ptr->hit_wallnorm[0], &Objects[ctx->query_ptr->thisobjnum], ctx->query_ptr->p0, 3, vertex_ptr_list, &face_normal, ctx->query_ptr->o_orient, ctx->query_ptr->o_rotvel, ctx->query_ptr->o_velocity))
 						{
-							movement_dir = fvi_hit_data_ptr->hit_pnt - *fvi_query_ptr->p0;
+							movement_dir = ctx->hit_data_ptr->hit_pnt - *ctx->query_ptr->p0;
 							hit_interval = vm_NormalizeVector(&movement_dir);
 
-							DoLinearApprox(&fvi_hit_data_ptr->hit_face_pnt[0], &fvi_hit_data_ptr->hit_wallnorm[0], &hit_dist, &hit_interval, &movement_dir, fvi_query_ptr->p0, &Objects[fvi_query_ptr->thisobjnum], 3, vertex_ptr_list, &face_normal);
+							DoLinearApprox(ctx, &ctx->hit_data_ptr->hit_face_pnt[0], &ctx->hit_data_ptr->hit_wallnorm[0], &hit_dist, &hit_interval, &movement_dir, ctx->query_ptr->p0, &Objects[ctx->query_ptr->thisobjnum], 3, vertex_ptr_list, &face_normal);
 
-							fvi_collision_dist = hit_dist; 
+							ctx->collision_dist = hit_dist; 
 						}	
 						else
 						{
-							fvi_hit_data_ptr->hit_orient = *fvi_query_ptr->o_orient;
-							fvi_hit_data_ptr->hit_rotvel = *fvi_query_ptr->o_rotvel;
-							fvi_hit_data_ptr->hit_turnroll = *fvi_query_ptr->o_turnroll;
-							fvi_hit_data_ptr->hit_pnt = *fvi_query_ptr->p0;
+							ctx->hit_data_ptr->hit_orient = *ctx->query_ptr->o_orient;
+							ctx->hit_data_ptr->hit_rotvel = *ctx->query_ptr->o_rotvel;
+							ctx->hit_data_ptr->hit_turnroll = *ctx->query_ptr->o_turnroll;
+							ctx->hit_data_ptr->hit_pnt = *ctx->query_ptr->p0;
 
-							fvi_collision_dist = 0.0;
+							ctx->collision_dist = 0.0;
 							movement_dir = Zero_vector;
 							hit_dist = 0.0f;
 						}
 
-						fvi_hit_data_ptr->hit_type[0] = HIT_TERRAIN;
-						fvi_hit_data_ptr->hit_wallnorm[0].x = 0.0;	
-						fvi_hit_data_ptr->hit_wallnorm[0].y = 1.0;	
-						fvi_hit_data_ptr->hit_wallnorm[0].z = 0.0;	
-						// fvi_hit_data_ptr->hit_seg = -1; -- set in the fvi_FindIntersection function
-//						fvi_hit_data_ptr->hit_pnt = *fvi_query_ptr->p0 + hit_dist*movement_dir;
-						fvi_hit_data_ptr->hit_face[0] =  i;
-						fvi_hit_data_ptr->hit_face_room[0] = cur_node;
-	//					fvi_hit_data_ptr->hit_side_pnt = fvi_hit_data_ptr->hit_pnt;
-	//					fvi_hit_data_ptr->hit_side_pnt.y = fvi_query_ptr->p0->y - Objects[fvi_query_ptr->thisobjnum].size;
+						ctx->hit_data_ptr->hit_type[0] = HIT_TERRAIN;
+						ctx->hit_data_ptr->hit_wallnorm[0].x = 0.0;	
+						ctx->hit_data_ptr->hit_wallnorm[0].y = 1.0;	
+						ctx->hit_data_ptr->hit_wallnorm[0].z = 0.0;	
+						// ctx->hit_data_ptr->hit_seg = -1; -- set in the fvi_FindIntersection function
+//						ctx->hit_data_ptr->hit_pnt = *ctx->query_ptr->p0 + hit_dist*movement_dir;
+						ctx->hit_data_ptr->hit_face[0] =  i;
+						ctx->hit_data_ptr->hit_face_room[0] = cur_node;
+	//					ctx->hit_data_ptr->hit_side_pnt = ctx->hit_data_ptr->hit_pnt;
+	//					ctx->hit_data_ptr->hit_side_pnt.y = ctx->query_ptr->p0->y - Objects[ctx->query_ptr->thisobjnum].size;
 						
-//						if(!BBoxPlaneIntersection(true, &fvi_hit_data_ptr->hit_face_pnt[0], &fvi_hit_data_ptr->hit_wallnorm[0], &Objects[fvi_query_ptr->thisobjnum], &fvi_hit_data_ptr->hit_pnt, 3, vertex_ptr_list, &face_normal, &fvi_hit_data_ptr->hit_orient, &fvi_hit_data_ptr->hit_rotvel, &fvi_hit_data_ptr->hit_rotvel))
+//						if(!BBoxPlaneIntersection(true, &ctx->hit_data_ptr->hit_face_pnt[0], &ctx->hit_data_ptr->hit_wallnorm[0], &Objects[ctx->query_ptr->thisobjnum], &ctx->hit_data_ptr->hit_pnt, 3, vertex_ptr_list, &face_normal, &ctx->hit_data_ptr->hit_orient, &ctx->hit_data_ptr->hit_rotvel, &ctx->hit_data_ptr->hit_rotvel))
 //							ASSERT(1);
 
 						goto ignore_hit;
@@ -4243,30 +4609,30 @@ inline void check_terrain_node(int cur_node, bool f_check_local_nodes, bool f_ch
 				// If we hit the face...
 				if (face_hit_type) 
 				{    
-					if (cur_dist <= fvi_collision_dist) 
+					if (cur_dist <= ctx->collision_dist) 
 					{
-						if((cur_dist < fvi_collision_dist) || !(fvi_query_ptr->flags & FQ_MULTI_POINT))
+						if((cur_dist < ctx->collision_dist) || !(ctx->query_ptr->flags & FQ_MULTI_POINT))
 						{
-							fvi_hit_data_ptr->num_hits = 0;
+							ctx->hit_data_ptr->num_hits = 0;
 
-							fvi_collision_dist = cur_dist; 
-							fvi_hit_data_ptr->hit_pnt = hit_point;
-							compute_movement_AABB();
+							ctx->collision_dist = cur_dist; 
+							ctx->hit_data_ptr->hit_pnt = hit_point;
+							compute_movement_AABB(ctx);
 						}
-						else if(fvi_hit_data_ptr->num_hits == MAX_HITS)
+						else if(ctx->hit_data_ptr->num_hits == MAX_HITS)
 						{
 							goto ignore_hit;
 						}
 						
-						fvi_hit_data_ptr->hit_object[fvi_hit_data_ptr->num_hits] = -1;
-						fvi_hit_data_ptr->hit_type[fvi_hit_data_ptr->num_hits] = HIT_TERRAIN;
-						fvi_hit_data_ptr->hit_wallnorm[fvi_hit_data_ptr->num_hits] = wall_norm;	
-						// fvi_hit_data_ptr->hit_seg = -1; -- set in the fvi_FindIntersection function
-						fvi_hit_data_ptr->hit_face[fvi_hit_data_ptr->num_hits] =  i;
-						fvi_hit_data_ptr->hit_face_room[fvi_hit_data_ptr->num_hits] = (MAKE_ROOMNUM(cur_node));
-						fvi_hit_data_ptr->hit_face_pnt[fvi_hit_data_ptr->num_hits] = colp;
-
-						fvi_hit_data_ptr->num_hits++;
+						ctx->hit_data_ptr->hit_object[ctx->hit_data_ptr->num_hits] = -1;
+						ctx->hit_data_ptr->hit_type[ctx->hit_data_ptr->num_hits] = HIT_TERRAIN;
+						ctx->hit_data_ptr->hit_wallnorm[ctx->hit_data_ptr->num_hits] = wall_norm;	
+						// ctx->hit_data_ptr->hit_seg = -1; -- set in the fvi_FindIntersection function
+						ctx->hit_data_ptr->hit_face[ctx->hit_data_ptr->num_hits] =  i;
+						ctx->hit_data_ptr->hit_face_room[ctx->hit_data_ptr->num_hits] = (MAKE_ROOMNUM(cur_node));
+						ctx->hit_data_ptr->hit_face_pnt[ctx->hit_data_ptr->num_hits] = colp;
+
+						ctx->hit_data_ptr->num_hits++;
 					}
 				}
 ignore_hit: ;
@@ -4280,10 +4646,10 @@ ignore_hit: ;
 		int next_y_delta;
 
 		// Check worst-case collisions.  This includes all nodes within a radius edge of the current node
-		tercheck_x = check_x = fvi_query_ptr->rad/TERRAIN_SIZE + 1;
-		tercheck_y = check_y = fvi_query_ptr->rad/TERRAIN_SIZE + 1;
+		tercheck_x = check_x = ctx->query_ptr->rad/TERRAIN_SIZE + 1;
+		tercheck_y = check_y = ctx->query_ptr->rad/TERRAIN_SIZE + 1;
 
-		if(fvi_query_ptr->flags & FQ_CHECK_OBJS)
+		if(ctx->query_ptr->flags & FQ_CHECK_OBJS)
 		{
 			check_x += CELLS_PER_COL_CELL; 
 			check_y += CELLS_PER_COL_CELL; 
@@ -4313,7 +4679,7 @@ ignore_hit: ;
 			for(xcounter = xstart; xcounter <= xend; xcounter++) 
 			{
 
-				if((fvi_terrain_visit_list[new_node >> 3] & (0x01 << (new_node % 8))) == 0) 
+				if((ctx->terrain_visit_list[new_node >> 3] & (0x01 << (new_node % 8))) == 0) 
 				{
 
 					f_check_next_ground = false;				
@@ -4326,7 +4692,7 @@ ignore_hit: ;
 						}
 					}
 					
-					check_terrain_node(new_node, false, f_check_next_ground);
+					check_terrain_node(ctx, new_node, false, f_check_next_ground);
 				}
 
 				new_node += 1;
@@ -4340,16 +4706,16 @@ ignore_hit: ;
 }
 
 /*
-inline void check_square_node(int x, int y, int width)
+inline void check_square_node(fvi_context *ctx, int x, int y, int width)
 {
 	// check local nodes for any collision type, but no recursion for them :)
 	int next_y_delta;
 
 	// Check worst-case collisions.  This includes all nodes within a radius edge of the current node
-	tercheck_x = check_x = fvi_query_ptr->rad/TERRAIN_SIZE + 1;
-	tercheck_y = check_y = fvi_query_ptr->rad/TERRAIN_SIZE + 1;
+	tercheck_x = check_x = ctx->query_ptr->rad/TERRAIN_SIZE + 1;
+	tercheck_y = check_y = ctx->query_ptr->rad/TERRAIN_SIZE + 1;
 
-		if(fvi_query_ptr->flags & FQ_CHECK_OBJS)
+		if(ctx->query_ptr->flags & FQ_CHECK_OBJS)
 		{
 			check_x += CELLS_PER_COL_CELL; 
 			check_y += CELLS_PER_COL_CELL; 
@@ -4379,7 +4745,7 @@ inline void check_square_node(int x, int y, int width)
 			for(xcounter = xstart; xcounter <= xend; xcounter++) 
 			{
 
-				if((fvi_terrain_visit_list[new_node >> 3] & (0x01 << (new_node % 8))) == 0) 
+				if((ctx->terrain_visit_list[new_node >> 3] & (0x01 << (new_node % 8))) == 0) 
 				{
 
 					f_check_next_ground = false;				
@@ -4392,9 +4758,9 @@ inline void check_square_node(int x, int y, int width)
 						}
 					}
 					
-//					if(!((fvi_terrain_obj_visit_list[new_node >> 3] & (0x01 << (new_node % 8))) != 0))
-					if(!((fvi_terrain_visit_list[new_node >> 3] & (0x01 << (new_node % 8))) != 0))
-						check_terrain_node(new_node, false, f_check_next_ground);
+//					if(!((ctx->terrain_obj_visit_list[new_node >> 3] & (0x01 << (new_node % 8))) != 0))
+					if(!((ctx->terrain_visit_list[new_node >> 3] & (0x01 << (new_node % 8))) != 0))
+						check_terrain_node(ctx, new_node, false, f_check_next_ground);
 				}
 
 				new_node += 1;
@@ -4406,65 +4772,65 @@ inline void check_square_node(int x, int y, int width)
 }
 */
 
-int do_fvi_terrain() {
+int do_fvi_terrain(fvi_context *ctx) {
 	int x1, x2, y1, y2, x, y, delta_y, delta_x, change_x, change_y, length, cur_node, error_term, i;
 
 	int new_x, new_y;
 	int counter;
-	int delta_ter_check = fvi_query_ptr->rad/TERRAIN_SIZE + 1;
-	int delta_check = fvi_query_ptr->rad/TERRAIN_SIZE + CELLS_PER_COL_CELL + 1;
+	int delta_ter_check = ctx->query_ptr->rad/TERRAIN_SIZE + 1;
+	int delta_check = ctx->query_ptr->rad/TERRAIN_SIZE + CELLS_PER_COL_CELL + 1;
 
 
 	// This is the only time we will check the terrain
-	f_check_terrain = false;
+	ctx->check_terrain = false;
 
 	// We need to know the endpoint
-	fvi_hit_data_ptr->hit_room = GetTerrainRoomFromPos(&fvi_hit_data_ptr->hit_pnt);
+	ctx->hit_data_ptr->hit_room = GetTerrainRoomFromPos(&ctx->hit_data_ptr->hit_pnt);
 
 	// End point is out of bounds, so clip it.
-	if(fvi_hit_data_ptr->hit_room == -1)
+	if(ctx->hit_data_ptr->hit_room == -1)
 	{	
 		float delta = 1.0;
-		vector movement = fvi_hit_data_ptr->hit_pnt - *fvi_query_ptr->p0;
+		vector movement = ctx->hit_data_ptr->hit_pnt - *ctx->query_ptr->p0;
 		
-		if(fvi_hit_data_ptr->hit_pnt.x < (fvi_query_ptr->rad + 0.000001))
+		if(ctx->hit_data_ptr->hit_pnt.x < (ctx->query_ptr->rad + 0.000001))
 		{
-			delta = (fvi_query_ptr->p0->x - (fvi_query_ptr->rad + 0.000001))/(-movement.x);
+			delta = (ctx->query_ptr->p0->x - (ctx->query_ptr->rad + 0.000001))/(-movement.x);
 		}
-		else if(fvi_hit_data_ptr->hit_pnt.x > (float)((TERRAIN_WIDTH - 1) * TERRAIN_SIZE) - (fvi_query_ptr->rad + 0.000001))
+		else if(ctx->hit_data_ptr->hit_pnt.x > (float)((TERRAIN_WIDTH - 1) * TERRAIN_SIZE) - (ctx->query_ptr->rad + 0.000001))
 		{
-			delta = ((float)((TERRAIN_WIDTH - 1) * TERRAIN_SIZE) - (fvi_query_ptr->rad + 0.000001) - fvi_query_ptr->p0->x)/(movement.x);
+			delta = ((float)((TERRAIN_WIDTH - 1) * TERRAIN_SIZE) - (ctx->query_ptr->rad + 0.000001) - ctx->query_ptr->p0->x)/(movement.x);
 		}
 
-		if(fvi_hit_data_ptr->hit_pnt.z < (fvi_query_ptr->rad + 0.000001))
+		if(ctx->hit_data_ptr->hit_pnt.z < (ctx->query_ptr->rad + 0.000001))
 		{
-			if((fvi_query_ptr->p0->z - (fvi_query_ptr->rad + 0.000001))/(-movement.z) < delta) delta = (fvi_query_ptr->p0->z - (fvi_query_ptr->rad + 0.000001))/(-movement.z);
+			if((ctx->query_ptr->p0->z - (ctx->query_ptr->rad + 0.000001))/(-movement.z) < delta) delta = (ctx->query_ptr->p0->z - (ctx->query_ptr->rad + 0.000001))/(-movement.z);
 		}
-		else if(fvi_hit_data_ptr->hit_pnt.z > (float)((TERRAIN_DEPTH - 1) * TERRAIN_SIZE) - (fvi_query_ptr->rad + 0.000001))
+		else if(ctx->hit_data_ptr->hit_pnt.z > (float)((TERRAIN_DEPTH - 1) * TERRAIN_SIZE) - (ctx->query_ptr->rad + 0.000001))
 		{
-			if(((float)((TERRAIN_DEPTH - 1) * TERRAIN_SIZE) - (fvi_query_ptr->rad + 0.000001) - fvi_query_ptr->p0->z)/(movement.z) < delta)
-				delta = ((float)((TERRAIN_DEPTH - 1) * TERRAIN_SIZE) - (fvi_query_ptr->rad + 0.000001) - fvi_query_ptr->p0->z)/(movement.z);
+			if(((float)((TERRAIN_DEPTH - 1) * TERRAIN_SIZE) - (ctx->query_ptr->rad + 0.000001) - ctx->query_ptr->p0->z)/(movement.z) < delta)
+				delta = ((float)((TERRAIN_DEPTH - 1) * TERRAIN_SIZE) - (ctx->query_ptr->rad + 0.000001) - ctx->query_ptr->p0->z)/(movement.z);
 		}
 
-		fvi_hit_data_ptr->hit_pnt = *fvi_query_ptr->p0 + delta * movement;
-		fvi_collision_dist = vm_VectorDistance(&fvi_hit_data_ptr->hit_pnt, fvi_query_ptr->p0);
+		ctx->hit_data_ptr->hit_pnt = *ctx->query_ptr->p0 + delta * movement;
+		ctx->collision_dist = vm_VectorDistance(&ctx->hit_data_ptr->hit_pnt, ctx->query_ptr->p0);
 
-		fvi_hit_data_ptr->hit_room = GetTerrainRoomFromPos(&fvi_hit_data_ptr->hit_pnt);
+		ctx->hit_data_ptr->hit_room = GetTerrainRoomFromPos(&ctx->hit_data_ptr->hit_pnt);
 		
-		fvi_hit_data_ptr->hit_type[0] = HIT_OUT_OF_TERRAIN_BOUNDS;
+		ctx->hit_data_ptr->hit_type[0] = HIT_OUT_OF_TERRAIN_BOUNDS;
 		
-		compute_movement_AABB();
+		compute_movement_AABB(ctx);
 
-		if(fvi_hit_data_ptr->hit_room == -1)
-			return fvi_hit_data_ptr->hit_type[0];
+		if(ctx->hit_data_ptr->hit_room == -1)
+			return ctx->hit_data_ptr->hit_type[0];
 	}
 
 	// Determine the start end end nodes
-	x1 = CELLNUM(fvi_query_ptr->startroom)%TERRAIN_WIDTH;
-	y1 = CELLNUM(fvi_query_ptr->startroom)/TERRAIN_WIDTH;
+	x1 = CELLNUM(ctx->query_ptr->startroom)%TERRAIN_WIDTH;
+	y1 = CELLNUM(ctx->query_ptr->startroom)/TERRAIN_WIDTH;
 	
-	x2 = CELLNUM(fvi_hit_data_ptr->hit_room)%TERRAIN_WIDTH;
-	y2 = CELLNUM(fvi_hit_data_ptr->hit_room)/TERRAIN_WIDTH;
+	x2 = CELLNUM(ctx->hit_data_ptr->hit_room)%TERRAIN_WIDTH;
+	y2 = CELLNUM(ctx->hit_data_ptr->hit_room)/TERRAIN_WIDTH;
 
 	x = x1;
 	y = y1;
@@ -4474,12 +4840,12 @@ int do_fvi_terrain() {
 	delta_y = y2 - y1;
 
 	// check the current node for collsions (if we are done, return)
-	check_terrain_node(CELLNUM(fvi_query_ptr->startroom), true, true);
+	check_terrain_node(ctx, CELLNUM(ctx->query_ptr->startroom), true, true);
 	if(delta_x == 0 && delta_y == 0) goto check_big_objs;
 
 	// check the end node
 	cur_node = y1*TERRAIN_DEPTH + x2;
-	check_terrain_node(cur_node, true, (fvi_terrain_visit_list[cur_node >> 3] & (0x01 << (cur_node % 8))) == 0);
+	check_terrain_node(ctx, cur_node, true, (ctx->terrain_visit_list[cur_node >> 3] & (0x01 << (cur_node % 8))) == 0);
 
 	// Do a Breshenham line algorithm
 	if(delta_x < 0) {
@@ -4515,7 +4881,7 @@ int do_fvi_terrain() {
 			}
 
 			if(y >= TERRAIN_DEPTH || y < 0 || x < 0 || x >= TERRAIN_WIDTH) {
-				fvi_hit_data_ptr->hit_type[0] = HIT_OUT_OF_TERRAIN_BOUNDS;
+				ctx->hit_data_ptr->hit_type[0] = HIT_OUT_OF_TERRAIN_BOUNDS;
 				goto check_big_objs;
 			}
 
@@ -4534,11 +4900,11 @@ int do_fvi_terrain() {
 				// Check the current node for collisions -- chrishack -- This can be made iterative
 				cur_node = y*TERRAIN_DEPTH + new_x;
 
-				if((fvi_terrain_visit_list[cur_node >> 3] & (0x01 << (cur_node % 8))) == 0) 
+				if((ctx->terrain_visit_list[cur_node >> 3] & (0x01 << (cur_node % 8))) == 0) 
 					if(counter < -delta_ter_check || counter > delta_ter_check)
-						check_terrain_node(cur_node, false, false);
+						check_terrain_node(ctx, cur_node, false, false);
 					else
-						check_terrain_node(cur_node, false, true);
+						check_terrain_node(ctx, cur_node, false, true);
 			}
 
 			i++;
@@ -4557,7 +4923,7 @@ int do_fvi_terrain() {
 			}
 
 			if(y >= TERRAIN_DEPTH || y < 0 || x < 0 || x >= TERRAIN_WIDTH) {
-				fvi_hit_data_ptr->hit_type[0] = HIT_OUT_OF_TERRAIN_BOUNDS;
+				ctx->hit_data_ptr->hit_type[0] = HIT_OUT_OF_TERRAIN_BOUNDS;
 				goto check_big_objs;
 			}
 
@@ -4575,11 +4941,11 @@ int do_fvi_terrain() {
 				// Check the current node for collisions -- chrishack -- This can be made iterative
 				cur_node = new_y*TERRAIN_DEPTH + x;
 
-				if((fvi_terrain_visit_list[cur_node >> 3] & (0x01 << (cur_node % 8))) == 0) 
+				if((ctx->terrain_visit_list[cur_node >> 3] & (0x01 << (cur_node % 8))) == 0) 
 					if(counter < -delta_ter_check || counter > delta_ter_check)
-						check_terrain_node(cur_node, false, false);
+						check_terrain_node(ctx, cur_node, false, false);
 					else
-						check_terrain_node(cur_node, false, true);
+						check_terrain_node(ctx, cur_node, false, true);
 			}
 
 			i++;
@@ -4589,52 +4955,82 @@ int do_fvi_terrain() {
 	ASSERT(x == x2 && y == y2);
 
 check_big_objs: 	// Check Big objects
-	if(fvi_query_ptr->flags & FQ_CHECK_OBJS)
+	if(ctx->query_ptr->flags & FQ_CHECK_OBJS)
 	{
 		for(i = 0; i < Num_big_objects; i++)
 		{
 			ASSERT(BigObjectList[i] >= 0);
-			check_hit_obj(BigObjectList[i]);
+			check_hit_obj(ctx, BigObjectList[i]);
 	//		mprintf((0, "CHecking BIG %d\n", i));
 		}
 	}
 	else
 	{
-		if(!(fvi_query_ptr->flags & FQ_IGNORE_EXTERNAL_ROOMS))
+		if(!(ctx->query_ptr->flags & FQ_IGNORE_EXTERNAL_ROOMS))
 			for(i = 0; i < Num_big_objects; i++)
 			{
 				if(Objects[BigObjectList[i]].type == OBJ_ROOM)
-					check_hit_obj(BigObjectList[i]);
+					check_hit_obj(ctx, BigObjectList[i]);
 		//		mprintf((0, "CHecking BIG %d\n", i));
 			}
 	}
 
-	return fvi_hit_data_ptr->hit_type[0];
+	return ctx->hit_data_ptr->hit_type[0];
 }
 
 // NOTE: CHRIS increased MAX_NEXT_PORTALS because radiosity rays tend to hit more portals
 // than in game stuff.  It has no performance effect; so, I should be fine.
 #define MAX_NEXT_PORTALS 50
 
-void fvi_rooms_objs(void)
+void fvi_rooms_objs(fvi_context *ctx)
 {
 	int objnum;
 	int i;
 	room *cur_room;
 
 	//first, see if vector hit any objects in this segment
-	if (!(fvi_query_ptr->flags & FQ_CHECK_OBJS)) return;
+	if (!(ctx->query_ptr->flags & FQ_CHECK_OBJS)) return;
+
+	// Short moves check the objects from the object grid, in the order the room lists would give them
+	if (ObjGridQueryCells(&ctx->min_xyz, &ctx->max_xyz) <= FVI_GRID_MAX_CELLS)
+	{
+		short grid_list[MAX_OBJECTS];
+		fvi_grid_obj found[MAX_OBJECTS];
+		int num_grid, num_found = 0;
+
+		num_grid = ObjGridQueryBox(&ctx->min_xyz, &ctx->max_xyz, grid_list, MAX_OBJECTS);
+
+		for(i = 0; i < num_grid; i++)
+		{
+			int visited_index = fvi_visited_index(ctx, Objects[grid_list[i]].roomnum);
+
+			if(visited_index == -1)
+				continue;
+
+			found[num_found].order = visited_index;
+			found[num_found].link = ObjGridLinkOrder(grid_list[i]);
+			found[num_found].objnum = grid_list[i];
+			num_found++;
+		}
+
+		std::sort(found, found + num_found, fvi_grid_obj_before);
+
+		for(i = 0; i < num_found; i++)
+			check_hit_obj(ctx, found[i].objnum);
+
+		return;
+	}
 	
-	for(i = 0; i < fvi_num_rooms_visited; i++)
+	for(i = 0; i < ctx->num_rooms_visited; i++)
 	{
-		cur_room = &Rooms[fvi_rooms_visited[i]];
-		ASSERT((fvi_visit_list[ROOMNUM(cur_room) >> 3] & (0x01 << (ROOMNUM(cur_room) % 8))) != 0);
+		cur_room = &Rooms[ctx->rooms_visited[i]];
+		ASSERT((ctx->visit_list[ROOMNUM(cur_room) >> 3] & (0x01 << (ROOMNUM(cur_room) % 8))) != 0);
 		ASSERT(ROOMNUM(cur_room) >= 0 && ROOMNUM(cur_room) <= Highest_room_index && cur_room->used);
 
 		for (objnum = cur_room->objects; objnum != -1; objnum = Objects[objnum].next)
 		{
 			ASSERT(objnum != -1);
-			check_hit_obj(objnum);
+			check_hit_obj(ctx, objnum);
 		}
 	}
 }
@@ -4695,10 +5091,220 @@ bool PhysPastPortal(const room *rp,portal *pp)
 }
 
 
-int fvi_room(int room_index, int from_portal, int room_obj) 
+// Returns true if the movement can touch any face in the given bbf region
+static inline bool fvi_room_region(fvi_context *ctx, const room *cur_room, int region, ubyte msector)
+{
+	const ubyte bbf_val = cur_room->bbf_list_sector[region];
+	const vector *region_min = &cur_room->bbf_list_min_xyz[region];
+	const vector *region_max = &cur_room->bbf_list_max_xyz[region];
+
+	if((bbf_val & msector) != bbf_val)
+		return false;
+
+	if(region_min->x > ctx->wall_max_xyz.x  ||
+		region_min->y > ctx->wall_max_xyz.y  ||
+		region_min->z > ctx->wall_max_xyz.z  || 
+		region_max->x < ctx->wall_min_xyz.x  ||
+		region_max->y < ctx->wall_min_xyz.y  ||
+		region_max->z < ctx->wall_min_xyz.z) 
+		return false;
+	
+	if(ctx->zero_rad && FastVectorBBox((float *)region_min, (float *)region_max, (float *)ctx->query_ptr->p0, (float *)&ctx->movement_delta) == false) 
+		return false;
+
+	return true;
+}
+
+// Checks the movement against one face of a room, adding any portal it can pass through to
+// next_portals.  Returns false if the rest of the face's bbf region should be skipped.
+static bool fvi_room_face(fvi_context *ctx, const room *cur_room, int room_index, short i, int from_portal, int room_obj, object *this_obj, int *next_portals, int *num_next_portals)
 {
+	vector face_normal;
+	vector *vertex_ptr_list[MAX_VERTS_PER_FACE];
+	int face_hit_type;
+	vector wall_norm;
+	vector colp;
+	short count;
+	int portal_num;
+	int next_portal_index;
 	vector hit_point;				// where we hit
 	float cur_dist;				// distance to hit point
+	bool f_backface;
+	int face_info;
+	face *cur_face;
+
+	// fvi_FindIntersectionBatch already showed that this ray can't hit the face
+	if (ctx->batch_face_bits && room_index == ctx->batch_room && !(ctx->batch_face_bits[i >> 5] & (1 << (i & 31))))
+		return true;
+
+	cur_face = &cur_room->faces[i];
+	
+	const vector *cf_max = &cur_face->max_xyz;
+	const vector *cf_min = &cur_face->min_xyz;
+
+	if(cf_min->x > ctx->wall_max_xyz.x  ||
+		cf_min->y > ctx->wall_max_xyz.y  ||
+		cf_min->z > ctx->wall_max_xyz.z  ||
+		cf_max->x < ctx->wall_min_xyz.x  ||
+		cf_max->y < ctx->wall_min_xyz.y  ||
+		cf_max->z < ctx->wall_min_xyz.z) return true;
+
+	if (ctx->zero_rad && FastVectorBBox((float *)cf_min, (float *)cf_max, (float *)ctx->query_ptr->p0, (float *)&ctx->movement_delta) == false) return true;
+
+	portal_num = cur_face->portal_num;
+	if(portal_num >= 0 && portal_num == from_portal) return true;
+
+	face_info = GetFacePhysicsFlags(cur_room, cur_face);
+	if(face_info == FPT_IGNORE) return true;
+
+	f_backface = false;
+
+	for (count = 0; count < cur_face->num_verts; count++)
+		vertex_ptr_list[count] = &cur_room->verts[cur_face->face_verts[count]];
+
+	face_normal = cur_face->normal;
+
+	// Add the portal if we are within a AABB of it.
+	if((face_info & FPF_PORTAL)) 
+	{
+		if((ctx->query_ptr->flags & FQ_RECORD) && (face_info & FPF_RECORD))
+		{
+			ASSERT(ctx->num_recorded_faces < MAX_RECORDED_FACES);
+			if(ctx->num_recorded_faces < MAX_RECORDED_FACES)
+			{
+				ctx->recorded_faces[ctx->num_recorded_faces].face_index = i;
+				ctx->recorded_faces[ctx->num_recorded_faces++].room_index = room_index;
+			}
+		}
+
+		// If we can cross a portal, add it to the next portal list if it is not already there
+		if(!(face_info & FPF_SOLID) && !(ctx->query_ptr->flags & FQ_SOLID_PORTALS))
+		{
+			bool f_add_next_portal = true;
+
+			for(next_portal_index = 0; next_portal_index < (*num_next_portals); next_portal_index++)
+			{
+				if(next_portals[next_portal_index] == portal_num) 
+				{
+					f_add_next_portal = false;
+					break;
+				}
+			}
+
+			if (f_add_next_portal)
+			{
+				ASSERT((*num_next_portals) < MAX_NEXT_PORTALS);
+				next_portals[(*num_next_portals)++] = portal_num;
+			}
+		}
+
+		if((ctx->query_ptr->flags & FQ_IGNORE_RENDER_THROUGH_PORTALS) && (PhysPastPortal(cur_room, &cur_room->portals[portal_num])))
+		{
+			bool f_add_next_portal = true;
+
+			for(next_portal_index = 0; next_portal_index < (*num_next_portals); next_portal_index++)
+			{
+				if(next_portals[next_portal_index] == portal_num) 
+				{
+					f_add_next_portal = false;
+					break;
+				}
+			}
+
+			if (f_add_next_portal)
+			{
+				ASSERT((*num_next_portals) < MAX_NEXT_PORTALS);
+				next_portals[(*num_next_portals)++] = portal_num;
+			}
+
+			return true;
+		}
+	}
+
+	// Did we hit this face?
+	if((this_obj) &&
+		(this_obj->mtype.phys_info.flags & PF_POINT_COLLIDE_WALLS))
+	{
+		face_hit_type = check_line_to_face(&hit_point, &colp, &cur_dist, &wall_norm, ctx->query_ptr->p0, &ctx->hit_data_ptr->hit_pnt, &face_normal, vertex_ptr_list, cur_face->num_verts, 0.0f);
+	}
+	else if((this_obj) && (this_obj->flags & OF_POLYGON_OBJECT))
+	{
+		face_hit_type = check_line_to_face(&hit_point, &colp, &cur_dist, &wall_norm, &ctx->wall_sphere_p0, &ctx->wall_sphere_p1, &face_normal, vertex_ptr_list, cur_face->num_verts, ctx->wall_sphere_rad);
+		hit_point -= ctx->wall_sphere_offset;
+	}
+	else
+	{
+		face_hit_type = check_line_to_face(&hit_point, &colp, &cur_dist, &wall_norm, ctx->query_ptr->p0, &ctx->hit_data_ptr->hit_pnt, &face_normal, vertex_ptr_list, cur_face->num_verts, ctx->query_ptr->rad);
+	}
+
+	if ((((ctx->query_ptr->flags & FQ_OBJ_BACKFACE) && (cur_room->flags & RF_EXTERNAL)) || ((ctx->query_ptr->flags & FQ_BACKFACE) && !(cur_room->flags & RF_EXTERNAL))) && (!face_hit_type))
+	{
+		face_normal *= -1.0f;
+		for (count = 0; count < cur_face->num_verts; count++)
+			vertex_ptr_list[cur_face->num_verts - count - 1] = &cur_room->verts[cur_face->face_verts[count]];
+
+		face_hit_type = check_line_to_face(&hit_point, &colp, &cur_dist, &wall_norm, ctx->query_ptr->p0, &ctx->hit_data_ptr->hit_pnt, &face_normal, vertex_ptr_list, cur_face->num_verts, ctx->query_ptr->rad);
+		f_backface = true;
+	}
+
+	if(face_hit_type && (face_info & FPF_TRANSPARENT) && (ctx->query_ptr->flags & FQ_TRANSPOINT) && CheckTransparentPoint(&colp, cur_room, i))
+	{
+		// Go through the hole
+		face_hit_type = HIT_NONE;
+	}
+
+	// If we hit the face...
+	if (face_hit_type) 
+	{    
+		if((ctx->query_ptr->flags & FQ_RECORD) && 
+			(face_info & FPF_RECORD) && 
+			(ctx->num_recorded_faces == 0 //[ISB] Can get here with 0 faces recorded. 
+			|| !(ctx->recorded_faces[ctx->num_recorded_faces - 1].face_index == i && 
+			  ctx->recorded_faces[ctx->num_recorded_faces - 1].room_index == room_index)))
+		{
+			ASSERT(ctx->num_recorded_faces < MAX_RECORDED_FACES);
+			if(ctx->num_recorded_faces < MAX_RECORDED_FACES)
+			{
+				ctx->recorded_faces[ctx->num_recorded_faces].face_index = i;
+				ctx->recorded_faces[ctx->num_recorded_faces++].room_index = room_index;
+			}
+		}
+
+		if (cur_dist <= ctx->collision_dist && (face_info & (FPF_SOLID | FPF_TRANSPARENT))) 
+		{
+			
+			if((cur_dist < ctx->collision_dist) || !(ctx->query_ptr->flags & FQ_MULTI_POINT))
+			{
+				ctx->hit_data_ptr->num_hits = 0;
+
+				ctx->collision_dist = cur_dist; 
+				ctx->hit_data_ptr->hit_pnt = hit_point;
+				compute_movement_AABB(ctx);
+			}
+			else if(ctx->hit_data_ptr->num_hits == MAX_HITS)
+			{
+				return false;
+			}
+
+			if(f_backface) ctx->hit_data_ptr->hit_type[ctx->hit_data_ptr->num_hits] = HIT_BACKFACE;
+			else ctx->hit_data_ptr->hit_type[ctx->hit_data_ptr->num_hits] = HIT_WALL;
+
+			ctx->hit_data_ptr->hit_wallnorm[ctx->hit_data_ptr->num_hits] = wall_norm;	
+			// ctx->hit_data_ptr->hit_seg = -1; -- set in the fvi_FindIntersection function
+			ctx->hit_data_ptr->hit_object[ctx->hit_data_ptr->num_hits] = room_obj;
+			ctx->hit_data_ptr->hit_face[ctx->hit_data_ptr->num_hits] =  i;				
+			ctx->hit_data_ptr->hit_face_room[ctx->hit_data_ptr->num_hits] = room_index;	// Segment of the best hit
+			ctx->hit_data_ptr->hit_face_pnt[ctx->hit_data_ptr->num_hits] = colp;
+
+			ctx->hit_data_ptr->num_hits++;
+		}
+	}
+
+	return true;
+}
+
+int fvi_room(fvi_context *ctx, int room_index, int from_portal, int room_obj) 
+{
 	const room *cur_room = &Rooms[room_index];
 	short i;
 	int next_portals[MAX_NEXT_PORTALS];
@@ -4711,50 +5317,50 @@ int fvi_room(int room_index, int from_portal, int room_obj)
 	object *this_obj;
 	ubyte msector = 0;
 
-	if(fvi_min_xyz.x <= cur_room->bbf_min_xyz.x)
+	if(ctx->min_xyz.x <= cur_room->bbf_min_xyz.x)
 	{
 		msector |= 0x01;
 	}
-	if(fvi_min_xyz.y <= cur_room->bbf_min_xyz.y)
+	if(ctx->min_xyz.y <= cur_room->bbf_min_xyz.y)
 	{
 		msector |= 0x02;
 	}
-	if(fvi_min_xyz.z <= cur_room->bbf_min_xyz.z)
+	if(ctx->min_xyz.z <= cur_room->bbf_min_xyz.z)
 	{
 		msector |= 0x04;
 	}
-	if(fvi_max_xyz.x >= cur_room->bbf_max_xyz.x)
+	if(ctx->max_xyz.x >= cur_room->bbf_max_xyz.x)
 	{
 		msector |= 0x08;
 	}
-	if(fvi_max_xyz.y >= cur_room->bbf_max_xyz.y)
+	if(ctx->max_xyz.y >= cur_room->bbf_max_xyz.y)
 	{
 		msector |= 0x10;
 	}
-	if(fvi_max_xyz.z >= cur_room->bbf_max_xyz.z)
+	if(ctx->max_xyz.z >= cur_room->bbf_max_xyz.z)
 	{
 		msector |= 0x20;
 	}
 
-	if(fvi_query_ptr->thisobjnum >= 0)
-		this_obj = &Objects[fvi_query_ptr->thisobjnum];
+	if(ctx->query_ptr->thisobjnum >= 0)
+		this_obj = &Objects[ctx->query_ptr->thisobjnum];
 	else
 		this_obj = NULL;
 
 	ASSERT(room_index >= 0 && room_index <= Highest_room_index);
 	ASSERT(Rooms[room_index].used);
-	ASSERT((fvi_visit_list[room_index >> 3] & (0x01 << (room_index % 8))) == 0);
+	ASSERT((ctx->visit_list[room_index >> 3] & (0x01 << (room_index % 8))) == 0);
 
 	if(!(cur_room->flags & RF_EXTERNAL))
 	{
-		fvi_visit_list[room_index >> 3] |= 0x01 << (room_index % 8);
-		fvi_rooms_visited[fvi_num_rooms_visited] = room_index;
-		fvi_num_rooms_visited++;
+		ctx->visit_list[room_index >> 3] |= 0x01 << (room_index % 8);
+		ctx->rooms_visited[ctx->num_rooms_visited] = room_index;
+		ctx->num_rooms_visited++;
 
-		ASSERT(fvi_num_rooms_visited <= MAX_ROOMS);
+		ASSERT(ctx->num_rooms_visited <= MAX_ROOMS);
 	}
 
-	if(fvi_query_ptr->flags & FQ_IGNORE_WALLS) 
+	if(ctx->query_ptr->flags & FQ_IGNORE_WALLS) 
 	{
 		vector face_normal;
 		vector *vertex_ptr_list[MAX_VERTS_PER_FACE];
@@ -4770,7 +5376,7 @@ int fvi_room(int room_index, int from_portal, int room_obj)
   			portal_num = cur_room->faces[i].portal_num;
 
 //			if ((msector & cur_room->faces[i].sector) != cur_room->faces[i].sector) continue;
-  			if (!room_movement_AABB(&cur_room->faces[i])) continue;
+  			if (!room_movement_AABB(ctx, &cur_room->faces[i])) continue;
   			
   			face_info = GetFacePhysicsFlags(cur_room, &cur_room->faces[i]);
   			if(face_info == FPT_IGNORE) continue;
@@ -4788,7 +5394,7 @@ int fvi_room(int room_index, int from_portal, int room_obj)
   			if((face_info & FPF_PORTAL)) 
   			{
   				// If we can cross a portal, add it to the next portal list if it is not already there
-  				if(!(face_info & FPF_SOLID) && !(fvi_query_ptr->flags & FQ_SOLID_PORTALS))
+  				if(!(face_info & FPF_SOLID) && !(ctx->query_ptr->flags & FQ_SOLID_PORTALS))
   				{
   					bool f_add_next_portal;
   					
@@ -4804,13 +5410,13 @@ int fvi_room(int room_index, int from_portal, int room_obj)
   						ASSERT(num_next_portals < MAX_NEXT_PORTALS);
   						next_portals[num_next_portals++] = portal_num;
 
-						if((fvi_query_ptr->flags & FQ_RECORD) && (face_info & FPF_RECORD))
+						if((ctx->query_ptr->flags & FQ_RECORD) && (face_info & FPF_RECORD))
 						{
-							ASSERT(Fvi_num_recorded_faces < MAX_RECORDED_FACES);
-							if(Fvi_num_recorded_faces < MAX_RECORDED_FACES)
+							ASSERT(ctx->num_recorded_faces < MAX_RECORDED_FACES);
+							if(ctx->num_recorded_faces < MAX_RECORDED_FACES)
 							{
-								Fvi_recorded_faces[Fvi_num_recorded_faces].face_index = i;
-								Fvi_recorded_faces[Fvi_num_recorded_faces++].room_index = room_index;
+								ctx->recorded_faces[ctx->num_recorded_faces].face_index = i;
+								ctx->recorded_faces[ctx->num_recorded_faces++].room_index = room_index;
 							}
 						}
   					}
@@ -4820,216 +5426,64 @@ int fvi_room(int room_index, int from_portal, int room_obj)
 	}
 	else
 	{
-		const short num_bbf_regions = cur_room->num_bbf_regions;
-		short *num_faces_ptr = cur_room->num_bbf;
-		ubyte *bbf_val = cur_room->bbf_list_sector;
-		vector *region_min = cur_room->bbf_list_min_xyz;
-		vector *region_max = cur_room->bbf_list_max_xyz;
-		short **bbf_list_ptr = cur_room->bbf_list;
+		const fvi_room_bvh *bvh = FVI_use_room_bvh ? fvi_GetRoomBVH(room_index) : NULL;
 
 		// Do the actual wall collsion stuff here!
-		for (int test1 = 0; test1 < num_bbf_regions; test1++)
+		if (bvh)
 		{
-			if(((*bbf_val) & msector) == (*bbf_val))
+			// Get the faces near the movement from the BVH, then check them in the same order
+			// as the region walk below.
+			uint slot_bits[FVI_BVH_SLOT_WORDS];
+			const int num_words = (bvh->num_slots + 31) >> 5;
+			vector query_min = ctx->wall_min_xyz;
+			vector query_max = ctx->wall_max_xyz;
+			int cur_region = -1;
+			bool f_region_ok = false;
+
+			memset(slot_bits, 0, num_words * sizeof(uint));
+			fvi_QueryRoomBVH(bvh, &query_min, &query_max, msector, slot_bits);
+
+			for (int slot = fvi_NextBVHSlot(slot_bits, num_words, -1); slot >= 0; slot = fvi_NextBVHSlot(slot_bits, num_words, slot))
 			{
-				if(region_min->x > fvi_wall_max_xyz.x  ||
-					region_min->y > fvi_wall_max_xyz.y  ||
-					region_min->z > fvi_wall_max_xyz.z  || 
-					region_max->x < fvi_wall_min_xyz.x  ||
-					region_max->y < fvi_wall_min_xyz.y  ||
-					region_max->z < fvi_wall_min_xyz.z) 
-					goto skip_region;
-				
-				if(fvi_zero_rad && FastVectorBBox((float *)region_min, (float *)region_max, (float *)fvi_query_ptr->p0, (float *)&fvi_movement_delta) == false) 
-					goto skip_region;
-				
-				short *cur_face_index_ptr = *bbf_list_ptr;
-				
-				for (int sort_list_cur = 0; sort_list_cur < (*num_faces_ptr); sort_list_cur++)
+				if (bvh->slot_region[slot] != cur_region)
 				{
-					vector face_normal;
-					vector *vertex_ptr_list[MAX_VERTS_PER_FACE];
-					int face_hit_type;
-					vector wall_norm;
-					vector colp;
-					short count;
-					bool f_backface;
-					int face_info;
-					face *cur_face;
-
-					i = *cur_face_index_ptr;
-					cur_face = &cur_room->faces[*cur_face_index_ptr];
-					cur_face_index_ptr++;
-					
-					const vector *cf_max = &cur_face->max_xyz;
-					const vector *cf_min = &cur_face->min_xyz;
-
-					if(cf_min->x > fvi_wall_max_xyz.x  ||
-						cf_min->y > fvi_wall_max_xyz.y  ||
-						cf_min->z > fvi_wall_max_xyz.z  ||
-						cf_max->x < fvi_wall_min_xyz.x  ||
-						cf_max->y < fvi_wall_min_xyz.y  ||
-						cf_max->z < fvi_wall_min_xyz.z) continue;
-
-					if (fvi_zero_rad && FastVectorBBox((float *)cf_min, (float *)cf_max, (float *)fvi_query_ptr->p0, (float *)&fvi_movement_delta) == false) continue;
-
-					portal_num = cur_face->portal_num;
-					if(portal_num >= 0 && portal_num == from_portal) continue;
-
-					face_info = GetFacePhysicsFlags(cur_room, cur_face);
-					if(face_info == FPT_IGNORE) continue;
-
-					f_backface = false;
-
-					for (count = 0; count < cur_face->num_verts; count++)
-						vertex_ptr_list[count] = &cur_room->verts[cur_face->face_verts[count]];
-
-					face_normal = cur_face->normal;
-
-					// Add the portal if we are within a AABB of it.
-					if((face_info & FPF_PORTAL)) 
-					{
-						if((fvi_query_ptr->flags & FQ_RECORD) && (face_info & FPF_RECORD))
-						{
-							ASSERT(Fvi_num_recorded_faces < MAX_RECORDED_FACES);
-							if(Fvi_num_recorded_faces < MAX_RECORDED_FACES)
-							{
-								Fvi_recorded_faces[Fvi_num_recorded_faces].face_index = i;
-								Fvi_recorded_faces[Fvi_num_recorded_faces++].room_index = room_index;
-							}
-						}
-
-						// If we can cross a portal, add it to the next portal list if it is not already there
-						if(!(face_info & FPF_SOLID) && !(fvi_query_ptr->flags & FQ_SOLID_PORTALS))
-						{
-							bool f_add_next_portal = true;
-
-							for(next_portal_index = 0; next_portal_index < num_next_portals; next_portal_index++)
-							{
-								if(next_portals[next_portal_index] == portal_num) 
-								{
-									f_add_next_portal = false;
-									break;
-								}
-							}
-
-							if (f_add_next_portal)
-							{
-								ASSERT(num_next_portals < MAX_NEXT_PORTALS);
-								next_portals[num_next_portals++] = portal_num;
-							}
-						}
-
-						if((fvi_query_ptr->flags & FQ_IGNORE_RENDER_THROUGH_PORTALS) && (PhysPastPortal(cur_room, &cur_room->portals[portal_num])))
-						{
-							bool f_add_next_portal = true;
-
-							for(next_portal_index = 0; next_portal_index < num_next_portals; next_portal_index++)
-							{
-								if(next_portals[next_portal_index] == portal_num) 
-								{
-									f_add_next_portal = false;
-									break;
-								}
-							}
-
-							if (f_add_next_portal)
-							{
-								ASSERT(num_next_portals < MAX_NEXT_PORTALS);
-								next_portals[num_next_portals++] = portal_num;
-							}
-
-							continue;
-						}
-					}
-
-					// Did we hit this face?
-					if((this_obj) &&
-						(this_obj->mtype.phys_info.flags & PF_POINT_COLLIDE_WALLS))
-					{
-						face_hit_type = check_line_to_face(&hit_point, &colp, &cur_dist, &wall_norm, fvi_query_ptr->p0, &fvi_hit_data_ptr->hit_pnt, &face_normal, vertex_ptr_list, cur_face->num_verts, 0.0f);
-					}
-					else if((this_obj) && (this_obj->flags & OF_POLYGON_OBJECT))
-					{
-						face_hit_type = check_line_to_face(&hit_point, &colp, &cur_dist, &wall_norm, &fvi_wall_sphere_p0, &fvi_wall_sphere_p1, &face_normal, vertex_ptr_list, cur_face->num_verts, fvi_wall_sphere_rad);
-						hit_point -= fvi_wall_sphere_offset;
-					}
-					else
-					{
-						face_hit_type = check_line_to_face(&hit_point, &colp, &cur_dist, &wall_norm, fvi_query_ptr->p0, &fvi_hit_data_ptr->hit_pnt, &face_normal, vertex_ptr_list, cur_face->num_verts, fvi_query_ptr->rad);
-					}
-
-					if ((((fvi_query_ptr->flags & FQ_OBJ_BACKFACE) && (cur_room->flags & RF_EXTERNAL)) || ((fvi_query_ptr->flags & FQ_BACKFACE) && !(cur_room->flags & RF_EXTERNAL))) && (!face_hit_type))
-					{
-						face_normal *= -1.0f;
-						for (count = 0; count < cur_face->num_verts; count++)
-							vertex_ptr_list[cur_face->num_verts - count - 1] = &cur_room->verts[cur_face->face_verts[count]];
-
-						face_hit_type = check_line_to_face(&hit_point, &colp, &cur_dist, &wall_norm, fvi_query_ptr->p0, &fvi_hit_data_ptr->hit_pnt, &face_normal, vertex_ptr_list, cur_face->num_verts, fvi_query_ptr->rad);
-						f_backface = true;
-					}
-
-					if(face_hit_type && (face_info & FPF_TRANSPARENT) && (fvi_query_ptr->flags & FQ_TRANSPOINT) && CheckTransparentPoint(&colp, cur_room, i))
-					{
-						// Go through the hole
-						face_hit_type = HIT_NONE;
-					}
+					cur_region = bvh->slot_region[slot];
+					f_region_ok = fvi_room_region(ctx, cur_room, cur_region, msector);
+				}
 
-					// If we hit the face...
-					if (face_hit_type) 
-					{    
-						if((fvi_query_ptr->flags & FQ_RECORD) && 
-							(face_info & FPF_RECORD) && 
-							(Fvi_num_recorded_faces == 0 //[ISB] Can get here with 0 faces recorded. 
-							|| !(Fvi_recorded_faces[Fvi_num_recorded_faces - 1].face_index == i && 
-							  Fvi_recorded_faces[Fvi_num_recorded_faces - 1].room_index == room_index)))
-						{
-							ASSERT(Fvi_num_recorded_faces < MAX_RECORDED_FACES);
-							if(Fvi_num_recorded_faces < MAX_RECORDED_FACES)
-							{
-								Fvi_recorded_faces[Fvi_num_recorded_faces].face_index = i;
-								Fvi_recorded_faces[Fvi_num_recorded_faces++].room_index = room_index;
-							}
-						}
+				if (!f_region_ok)
+					continue;
 
-						if (cur_dist <= fvi_collision_dist && (face_info & (FPF_SOLID | FPF_TRANSPARENT))) 
-						{
-							
-							if((cur_dist < fvi_collision_dist) || !(fvi_query_ptr->flags & FQ_MULTI_POINT))
-							{
-								fvi_hit_data_ptr->num_hits = 0;
+				if (!fvi_room_face(ctx, cur_room, room_index, bvh->slot_face[slot], from_portal, room_obj, this_obj, next_portals, &num_next_portals))
+					f_region_ok = false;
 
-								fvi_collision_dist = cur_dist; 
-								fvi_hit_data_ptr->hit_pnt = hit_point;
-								compute_movement_AABB();
-							}
-							else if(fvi_hit_data_ptr->num_hits == MAX_HITS)
-							{
-								goto ignore_hit;
-							}
-
-							if(f_backface) fvi_hit_data_ptr->hit_type[fvi_hit_data_ptr->num_hits] = HIT_BACKFACE;
-							else fvi_hit_data_ptr->hit_type[fvi_hit_data_ptr->num_hits] = HIT_WALL;
+				// A hit shrinks the movement box.  If it ever ends up outside the box we asked
+				// the BVH about, ask again so that no face gets missed.
+				if (ctx->wall_min_xyz.x < query_min.x || ctx->wall_min_xyz.y < query_min.y || ctx->wall_min_xyz.z < query_min.z ||
+					 ctx->wall_max_xyz.x > query_max.x || ctx->wall_max_xyz.y > query_max.y || ctx->wall_max_xyz.z > query_max.z)
+				{
+					query_min = ctx->wall_min_xyz;
+					query_max = ctx->wall_max_xyz;
+					fvi_QueryRoomBVH(bvh, &query_min, &query_max, msector, slot_bits);
+				}
+			}
+		}
+		else
+		{
+			for (int region = 0; region < cur_room->num_bbf_regions; region++)
+			{
+				if (!fvi_room_region(ctx, cur_room, region, msector))
+					continue;
 
-							fvi_hit_data_ptr->hit_wallnorm[fvi_hit_data_ptr->num_hits] = wall_norm;	
-							// fvi_hit_data_ptr->hit_seg = -1; -- set in the fvi_FindIntersection function
-							fvi_hit_data_ptr->hit_object[fvi_hit_data_ptr->num_hits] = room_obj;
-							fvi_hit_data_ptr->hit_face[fvi_hit_data_ptr->num_hits] =  i;				
-							fvi_hit_data_ptr->hit_face_room[fvi_hit_data_ptr->num_hits] = room_index;	// Segment of the best hit
-							fvi_hit_data_ptr->hit_face_pnt[fvi_hit_data_ptr->num_hits] = colp;
+				const short *face_list = cur_room->bbf_list[region];
+				const int num_faces = cur_room->num_bbf[region];
 
-							fvi_hit_data_ptr->num_hits++;
-						}
-					}
+				for (int sort_list_cur = 0; sort_list_cur < num_faces; sort_list_cur++)
+				{
+					if (!fvi_room_face(ctx, cur_room, room_index, face_list[sort_list_cur], from_portal, room_obj, this_obj, next_portals, &num_next_portals))
+						break;
 				}
 			}
-skip_region: ;
-ignore_hit: ;
-			num_faces_ptr++;
-			bbf_val++;
-			region_max++;
-			region_min++;
-			bbf_list_ptr++;
 		}
 	}
 //repeated: ;
@@ -5054,11 +5508,11 @@ ignore_hit: ;
 			new_normal = col_normal[0];
 		}
 
-		fvi_hit_data_ptr->hit_pnt = fvi_hit_data_ptr->hit_pnt - (fvi_query_ptr->rad * (new_normal));
+		ctx->hit_data_ptr->hit_pnt = ctx->hit_data_ptr->hit_pnt - (ctx->query_ptr->rad * (new_normal));
 	}
 */
 
-	if(!(fvi_query_ptr->flags & FQ_SOLID_PORTALS))
+	if(!(ctx->query_ptr->flags & FQ_SOLID_PORTALS))
 	{
 		// Accounts for doors that leave a 
 		for(i = 0; i < cur_room->num_portals; i++)
@@ -5097,21 +5551,21 @@ ignore_hit: ;
 
 			if(!(Rooms[connect_room].flags & RF_EXTERNAL))
 			{
-				if ((fvi_visit_list[connect_room >> 3] & (0x01 << ((connect_room) % 8))) == 0) 
+				if ((ctx->visit_list[connect_room >> 3] & (0x01 << ((connect_room) % 8))) == 0) 
 				{
   					//mprintf((0, "A portal %d to room %d,from room %d,with %d cportal\n", portal_num, cur_room->portals[portal_num].croom, room_index, cur_room->portals[portal_num].cportal));
-					fvi_room(connect_room, cur_room->portals[portal_num].cportal);
+					fvi_room(ctx, connect_room, cur_room->portals[portal_num].cportal);
 				}
 			}
-			else if(f_check_terrain)
+			else if(ctx->check_terrain)
 			{
-				fvi_info hit_data_terrain = *fvi_hit_data_ptr;
-				fvi_query query_terrain = *fvi_query_ptr;
-				fvi_info *temp_hit_data = fvi_hit_data_ptr;
-				fvi_query *temp_query = fvi_query_ptr;
+				fvi_info hit_data_terrain = *ctx->hit_data_ptr;
+				fvi_query query_terrain = *ctx->query_ptr;
+				fvi_info *temp_hit_data = ctx->hit_data_ptr;
+				fvi_query *temp_query = ctx->query_ptr;
 
-				fvi_hit_data_ptr = &hit_data_terrain;
-				fvi_query_ptr = &query_terrain;
+				ctx->hit_data_ptr = &hit_data_terrain;
+				ctx->query_ptr = &query_terrain;
 
 				query_terrain.startroom = GetTerrainRoomFromPos(query_terrain.p0);
 
@@ -5124,7 +5578,7 @@ ignore_hit: ;
 					hit_data_terrain.hit_type[0] = HIT_OUT_OF_TERRAIN_BOUNDS;
 
 				// Find the hit data!!!
-				do_fvi_terrain();
+				do_fvi_terrain(ctx);
 
 				// This is quick, so do it here.
 				hit_data_terrain.hit_room	= GetTerrainRoomFromPos(&hit_data_terrain.hit_pnt);
@@ -5132,19 +5586,19 @@ ignore_hit: ;
 					hit_data_terrain.hit_type[0] = HIT_OUT_OF_TERRAIN_BOUNDS;
 
 				// Reset the fvi global pointers to handle in mine stuff.
-				fvi_hit_data_ptr = temp_hit_data;
-				fvi_query_ptr = temp_query;
+				ctx->hit_data_ptr = temp_hit_data;
+				ctx->query_ptr = temp_query;
 
 				// Make sure we register the hit
-				if(hit_data_terrain.hit_type != HIT_NONE) *fvi_hit_data_ptr = hit_data_terrain;
+				if(hit_data_terrain.hit_type != HIT_NONE) *ctx->hit_data_ptr = hit_data_terrain;
 			}
 		}
 	}
 
 //quit_looking:
 
-	ASSERT(!(fvi_hit_data_ptr->hit_type[0] == HIT_OBJECT && fvi_hit_data_ptr->hit_object[0] == -1));
+	ASSERT(!(ctx->hit_data_ptr->hit_type[0] == HIT_OBJECT && ctx->hit_data_ptr->hit_object[0] == -1));
 
-	return fvi_hit_data_ptr->hit_type[0];
+	return ctx->hit_data_ptr->hit_type[0];
 }
 
@@ -0,0 +1,310 @@
+/*
+* Descent 3
+* Copyright (C) 2024 Parallax Software
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Per-room face bounding volume hierarchies for fvi.
+//
+// fvi used to find the faces near a movement by walking every bbf region of a room, and then
+// every face of each region whose box it touched.  The BVH finds the same faces without looking
+// at the far away ones.  Callers still check the faces in bbf list order, so the results are
+// exactly what the region walk gives.
+
+#include <algorithm>
+
+#include "findintersection.h"
+#include "room.h"
+#include "mem.h"
+#include "pserror.h"
+
+// Most faces in one leaf
+#define BVH_LEAF_SIZE 8
+
+// Deepest traversal stack needed.  Leaves split at the median, so the tree is balanced.
+#define BVH_STACK_DEPTH 32
+
+bool FVI_use_room_bvh = true;
+
+static fvi_room_bvh *Room_bvh[MAX_ROOMS];
+
+// Scratch space used while building one room
+typedef struct
+{
+	const room *rp;
+	fvi_room_bvh *bvh;
+	ushort *items;			// Slots, reordered as the tree is built
+	vector *centers;		// Center of each slot's face box
+} bvh_build;
+
+// Grows a box to hold a face's box
+static inline void bvh_AddBox(vector *min_xyz, vector *max_xyz, const face *fp)
+{
+	if (fp->min_xyz.x < min_xyz->x) min_xyz->x = fp->min_xyz.x;
+	if (fp->min_xyz.y < min_xyz->y) min_xyz->y = fp->min_xyz.y;
+	if (fp->min_xyz.z < min_xyz->z) min_xyz->z = fp->min_xyz.z;
+	if (fp->max_xyz.x > max_xyz->x) max_xyz->x = fp->max_xyz.x;
+	if (fp->max_xyz.y > max_xyz->y) max_xyz->y = fp->max_xyz.y;
+	if (fp->max_xyz.z > max_xyz->z) max_xyz->z = fp->max_xyz.z;
+}
+
+// Builds the subtree over items first to first+count-1.  Returns the subtree's node index.
+static int bvh_BuildNode(bvh_build *b, int first, int count)
+{
+	fvi_room_bvh *bvh = b->bvh;
+	int node_index = bvh->num_nodes++;
+	fvi_bvh_node *node = &bvh->nodes[node_index];
+	vector cmin, cmax;
+	int i;
+
+	node->min_xyz.x = node->min_xyz.y = node->min_xyz.z = 9999999.0f;
+	node->max_xyz.x = node->max_xyz.y = node->max_xyz.z = -9999999.0f;
+	cmin = node->min_xyz;
+	cmax = node->max_xyz;
+
+	for (i = first; i < first + count; i++)
+	{
+		const vector *c = &b->centers[b->items[i]];
+
+		bvh_AddBox(&node->min_xyz, &node->max_xyz, &b->rp->faces[bvh->slot_face[b->items[i]]]);
+
+		if (c->x < cmin.x) cmin.x = c->x;
+		if (c->y < cmin.y) cmin.y = c->y;
+		if (c->z < cmin.z) cmin.z = c->z;
+		if (c->x > cmax.x) cmax.x = c->x;
+		if (c->y > cmax.y) cmax.y = c->y;
+		if (c->z > cmax.z) cmax.z = c->z;
+	}
+
+	if (count <= BVH_LEAF_SIZE)
+	{
+		node->first = first;
+		node->count = count;
+		return node_index;
+	}
+
+	// Split at the median face center along the longest axis
+	vector extent = cmax - cmin;
+	int axis = 0;
+	if (extent.y > extent.x) axis = 1;
+	if (extent.z > ((axis == 0) ? extent.x : extent.y)) axis = 2;
+
+	const vector *centers = b->centers;
+	int half = count / 2;
+
+	std::nth_element(b->items + first, b->items + first + half, b->items + first + count, [centers, axis](ushort a, ushort c)
+	{
+		const float *ca = &centers[a].x;
+		const float *cc = &centers[c].x;
+
+		if (ca[axis] != cc[axis])
+			return ca[axis] < cc[axis];
+		return a < c;
+	});
+
+	node->count = 0;
+	bvh_BuildNode(b, first, half);
+	int second = bvh_BuildNode(b, first + half, count - half);
+
+	node->first = second;
+
+	return node_index;
+}
+
+// Builds the face BVH for one room from its bbf regions.  Returns NULL if the room has none.
+static fvi_room_bvh *bvh_BuildRoom(const room *rp)
+{
+	int num_slots = 0;
+	int max_nodes;
+	int i, j;
+
+	for (i = 0; i < rp->num_bbf_regions; i++)
+		num_slots += rp->num_bbf[i];
+
+	if (num_slots == 0 || num_slots > MAX_FACES_PER_ROOM)
+		return NULL;
+
+	// Median splits leave at least half a leaf's worth in every leaf, which bounds the node count
+	max_nodes = (num_slots / (BVH_LEAF_SIZE / 2)) * 2 + 1;
+
+	// One block for the whole thing, biggest alignment first
+	int size = sizeof(fvi_room_bvh) +
+		max_nodes * sizeof(fvi_bvh_node) +
+		num_slots * (6 * sizeof(float) + 3 * sizeof(short) + sizeof(ubyte));
+
+	ubyte *mem = (ubyte *)mem_malloc(size);
+	fvi_room_bvh *bvh = (fvi_room_bvh *)mem;
+	mem += sizeof(fvi_room_bvh);
+
+	bvh->num_faces = rp->num_faces;
+	bvh->num_slots = num_slots;
+	bvh->num_nodes = 0;
+	bvh->nodes = (fvi_bvh_node *)mem; mem += max_nodes * sizeof(fvi_bvh_node);
+	bvh->min_x = (float *)mem; mem += num_slots * sizeof(float);
+	bvh->min_y = (float *)mem; mem += num_slots * sizeof(float);
+	bvh->min_z = (float *)mem; mem += num_slots * sizeof(float);
+	bvh->max_x = (float *)mem; mem += num_slots * sizeof(float);
+	bvh->max_y = (float *)mem; mem += num_slots * sizeof(float);
+	bvh->max_z = (float *)mem; mem += num_slots * sizeof(float);
+	bvh->slot_face = (short *)mem; mem += num_slots * sizeof(short);
+	bvh->slot_region = (short *)mem; mem += num_slots * sizeof(short);
+	bvh->item_slot = (ushort *)mem; mem += num_slots * sizeof(ushort);
+	bvh->item_sector = (ubyte *)mem;
+
+	// Slots go in bbf list order
+	int slot = 0;
+	for (i = 0; i < rp->num_bbf_regions; i++)
+	{
+		for (j = 0; j < rp->num_bbf[i]; j++)
+		{
+			bvh->slot_face[slot] = rp->bbf_list[i][j];
+			bvh->slot_region[slot] = i;
+			slot++;
+		}
+	}
+
+	bvh_build b;
+	b.rp = rp;
+	b.bvh = bvh;
+	b.items = bvh->item_slot;
+	b.centers = (vector *)mem_malloc(num_slots * sizeof(vector));
+
+	for (i = 0; i < num_slots; i++)
+	{
+		const face *fp = &rp->faces[bvh->slot_face[i]];
+
+		b.items[i] = i;
+		b.centers[i] = (fp->min_xyz + fp->max_xyz) / 2.0f;
+	}
+
+	bvh_BuildNode(&b, 0, num_slots);
+	ASSERT(bvh->num_nodes <= max_nodes);
+
+	mem_free(b.centers);
+
+	// Lay out the face bounds in leaf order, so a leaf test walks memory in a straight line
+	for (i = 0; i < num_slots; i++)
+	{
+		const face *fp = &rp->faces[bvh->slot_face[bvh->item_slot[i]]];
+
+		bvh->min_x[i] = fp->min_xyz.x;
+		bvh->min_y[i] = fp->min_xyz.y;
+		bvh->min_z[i] = fp->min_xyz.z;
+		bvh->max_x[i] = fp->max_xyz.x;
+		bvh->max_y[i] = fp->max_xyz.y;
+		bvh->max_z[i] = fp->max_xyz.z;
+		bvh->item_sector[i] = rp->bbf_list_sector[bvh->slot_region[bvh->item_slot[i]]];
+	}
+
+	return bvh;
+}
+
+// Frees the face BVH for one room
+void fvi_FreeRoomBVH(int roomnum)
+{
+	if (roomnum < 0 || roomnum >= MAX_ROOMS)
+		return;
+
+	if (Room_bvh[roomnum])
+	{
+		mem_free(Room_bvh[roomnum]);
+		Room_bvh[roomnum] = NULL;
+	}
+}
+
+// Builds the face BVHs for every room.  Called by ComputeAABB() once the bbf regions are done.
+void fvi_BuildRoomBVHs(void)
+{
+	int i;
+
+	for (i = 0; i < MAX_ROOMS; i++)
+	{
+		fvi_FreeRoomBVH(i);
+
+		if (i <= Highest_room_index && Rooms[i].used)
+			Room_bvh[i] = bvh_BuildRoom(&Rooms[i]);
+	}
+}
+
+// Returns the room's face BVH, or NULL if it doesn't have an up-to-date one
+const fvi_room_bvh *fvi_GetRoomBVH(int roomnum)
+{
+	fvi_room_bvh *bvh = Room_bvh[roomnum];
+
+	// The editor can add and remove faces without redoing the AABBs
+	if (bvh && bvh->num_faces != Rooms[roomnum].num_faces)
+		return NULL;
+
+	return bvh;
+}
+
+// Sets the bit in slot_bits for every slot whose face box overlaps the given box and whose region
+// passes the sector mask.  Returns the number of bits set.
+int fvi_QueryRoomBVH(const fvi_room_bvh *bvh, const vector *min_xyz, const vector *max_xyz, ubyte msector, uint *slot_bits)
+{
+	const fvi_bvh_node *nodes = bvh->nodes;
+	int stack[BVH_STACK_DEPTH];
+	int sp = 0;
+	int node_index = 0;
+	int num_found = 0;
+
+	const float qmin_x = min_xyz->x, qmin_y = min_xyz->y, qmin_z = min_xyz->z;
+	const float qmax_x = max_xyz->x, qmax_y = max_xyz->y, qmax_z = max_xyz->z;
+
+	for (;;)
+	{
+		const fvi_bvh_node *node = &nodes[node_index];
+
+		if (node->min_xyz.x > qmax_x || node->min_xyz.y > qmax_y || node->min_xyz.z > qmax_z ||
+			 node->max_xyz.x < qmin_x || node->max_xyz.y < qmin_y || node->max_xyz.z < qmin_z)
+		{
+			// Missed this subtree
+		}
+		else if (node->count)
+		{
+			int end = node->first + node->count;
+
+			for (int i = node->first; i < end; i++)
+			{
+				// Same tests, in the same order, as the region walk does for each face
+				if (bvh->min_x[i] > qmax_x || bvh->min_y[i] > qmax_y || bvh->min_z[i] > qmax_z ||
+					 bvh->max_x[i] < qmin_x || bvh->max_y[i] < qmin_y || bvh->max_z[i] < qmin_z)
+					continue;
+
+				ubyte sector = bvh->item_sector[i];
+				if ((sector & msector) != sector)
+					continue;
+
+				int slot = bvh->item_slot[i];
+				slot_bits[slot >> 5] |= 1u << (slot & 31);
+				num_found++;
+			}
+		}
+		else
+		{
+			ASSERT(sp < BVH_STACK_DEPTH);
+			stack[sp++] = node->first;
+			node_index++;
+			continue;
+		}
+
+		if (sp == 0)
+			break;
+
+		node_index = stack[--sp];
+	}
+
+	return num_found;
+}
@@ -812,7 +812,7 @@ void PhysicsDoSimLinear(const object& obj, const vector& pos, const vector& forc
 void do_physics_sim(object *obj)
 {
 	//Since we might not call FVI, set this here
-	Fvi_num_recorded_faces = 0;
+	fvi_GetThreadContext()->num_recorded_faces = 0;
 
 	int n_ignore_objs = 0;											// The number of ignored objects
 	int ignore_obj_list[MAX_IGNORE_OBJS+1];					// List of ignored objects
@@ -2486,7 +2486,7 @@ bool PhysValidateGroundPath(object *obj, vector *s, int sroom, vector *e, int er
 void do_walking_sim(object *obj)
 {
 	//Since we might not call FVI, set this here
-	Fvi_num_recorded_faces = 0;
+	fvi_GetThreadContext()->num_recorded_faces = 0;
 
 	int n_ignore_objs = 0;											// The number of ignored objects
 	int ignore_obj_list[MAX_IGNORE_OBJS+1];					// List of ignored objects
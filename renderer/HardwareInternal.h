@@ -50,6 +50,10 @@ extern float gTransformViewPort[4][4];
 extern float gTransformProjection[4][4];
 extern float gTransformModelView[4][4];
 extern float gTransformFull[4][4];
+
+// Name of the kernels the point array functions were built with, "SSE2" or "scalar"
+extern const char *Point_array_kernels;
+
 void g3_UpdateFullTransform();
 void g3_ForceTransformRefresh(void);
 
@@ -16,33 +16,25 @@
 * You should have received a copy of the GNU General Public License
 * along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
+#include <string.h>
 #include "gl_local.h"
+#include "gl_mesh.h"
 
-//The number of vertex attributes the legacy code used. 
-constexpr int NUM_LEGACY_VERTEX_ATTRIBS = 4;
 //The count of vertices that each buffer will store
 constexpr int NUM_VERTS_PER_BUFFER = 32000;
-
-struct color_array
-{
-	float r, g, b, a;
-};
-
-struct tex_array
-{
-	float s, t, r, w;
-};
-
-vector GL_verts[100];
-color_array GL_colors[100];
-tex_array GL_tex_coords[100];
-tex_array GL_tex_coords2[100];
+//Polygons are drawn as fans, so there are at most three indices for every vertex
+constexpr int NUM_INDICES_PER_BUFFER = NUM_VERTS_PER_BUFFER * 3;
+//The most vertices that will be queued before a batch is drawn. Must fit in a ushort index.
+constexpr int MAX_BATCH_VERTS = 4096;
+constexpr int MAX_BATCH_INDICES = MAX_BATCH_VERTS * 3;
 
 float OpenGL_Alpha_factor = 1.0f;
 float Alpha_multiplier = 1.0f;
 
 int OpenGL_polys_drawn;
 int OpenGL_verts_processed;
+int OpenGL_batches_drawn;
+int OpenGL_batch_flushes[NUM_RBF_REASONS];
 
 int Overlay_map = -1;
 int Bump_map = 0;
@@ -52,13 +44,19 @@ float Z_bias = 0.0f;
 
 bool OpenGL_blending_on = true;
 
-static GLuint drawbuffer;
-static size_t drawbufferoffsets[NUM_LEGACY_VERTEX_ATTRIBS];
-//The next committed vertex is where to start writing vertex data to the buffer
-static GLuint nextcommittedvertex; 
+static GLuint drawbuffer, drawindexbuffer;
+//The next committed vertex and index are where to start writing data to the buffers.
+//When the buffers fill up they're orphaned and writing starts from the beginning again.
+static int nextcommittedvertex, nextcommittedindex;
 static ShaderProgram drawshaders[4];
+//Shader used by the polygons in the current batch, or -1 if it has to be bound again
 static int lastdrawshader = -1;
 
+//Polygons queued up by rend_DrawPolygon3D that haven't been drawn yet.
+static RendDynamicVertex batchverts[MAX_BATCH_VERTS];
+static ushort batchindices[MAX_BATCH_INDICES];
+static int numbatchverts, numbatchindices;
+
 static GLuint drawvao;
 
 void GL_UseDrawVAO(void)
@@ -66,22 +64,54 @@ void GL_UseDrawVAO(void)
 	glBindVertexArray(drawvao);
 }
 
-int GL_CopyVertices(int numvertices)
+//Copies the current batch into the ring buffers and draws it with one call.
+void GL_FlushDrawBatch(int reason)
 {
+	//Whoever is flushing may be about to bind another program
+	lastdrawshader = -1;
+
+	if (numbatchindices == 0)
+	{
+		numbatchverts = 0;
+		return;
+	}
+
 	glBindBuffer(GL_ARRAY_BUFFER, drawbuffer);
-	if (nextcommittedvertex + numvertices > NUM_VERTS_PER_BUFFER)
-		nextcommittedvertex = 0;
+	if (nextcommittedvertex + numbatchverts > NUM_VERTS_PER_BUFFER || nextcommittedindex + numbatchindices > NUM_INDICES_PER_BUFFER)
+	{
+		//Orphan the old storage, the driver will keep it around until the draws using it are done.
+		glBufferData(GL_ARRAY_BUFFER, NUM_VERTS_PER_BUFFER * sizeof(RendDynamicVertex), nullptr, GL_STREAM_DRAW);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, NUM_INDICES_PER_BUFFER * sizeof(ushort), nullptr, GL_STREAM_DRAW);
+		nextcommittedvertex = nextcommittedindex = 0;
+	}
 
-	int startoffset = nextcommittedvertex;
+	//Nothing is ever written over a range that's been drawn from since the last orphan, so the map doesn't need to wait on the card.
+	GLbitfield mapflags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+	void* dest = glMapBufferRange(GL_ARRAY_BUFFER, nextcommittedvertex * sizeof(RendDynamicVertex), numbatchverts * sizeof(RendDynamicVertex), mapflags);
+	if (dest)
+	{
+		memcpy(dest, batchverts, numbatchverts * sizeof(RendDynamicVertex));
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+	}
 
-	glBufferSubData(GL_ARRAY_BUFFER, drawbufferoffsets[0] + startoffset * sizeof(vector), numvertices * sizeof(vector), GL_verts);
-	glBufferSubData(GL_ARRAY_BUFFER, drawbufferoffsets[1] + startoffset * sizeof(color_array), numvertices * sizeof(color_array), GL_colors);
-	glBufferSubData(GL_ARRAY_BUFFER, drawbufferoffsets[2] + startoffset * sizeof(tex_array), numvertices * sizeof(tex_array), GL_tex_coords);
-	glBufferSubData(GL_ARRAY_BUFFER, drawbufferoffsets[3] + startoffset * sizeof(tex_array), numvertices * sizeof(tex_array), GL_tex_coords2);
+	//The index buffer is part of the draw VAO's state, which is always bound when drawing polygons.
+	dest = glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, nextcommittedindex * sizeof(ushort), numbatchindices * sizeof(ushort), mapflags);
+	if (dest)
+	{
+		memcpy(dest, batchindices, numbatchindices * sizeof(ushort));
+		glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+	}
+
+	glDrawElementsBaseVertex(GL_TRIANGLES, numbatchindices, GL_UNSIGNED_SHORT, (const void*)(nextcommittedindex * sizeof(ushort)), nextcommittedvertex);
+
+	nextcommittedvertex += numbatchverts;
+	nextcommittedindex += numbatchindices;
+	numbatchverts = numbatchindices = 0;
 
-	nextcommittedvertex += numvertices;
+	OpenGL_batches_drawn++;
+	OpenGL_batch_flushes[reason]++;
 
-	return startoffset;
+	CHECK_ERROR(10)
 }
 
 void opengl_SetDrawDefaults(void)
@@ -99,45 +129,38 @@ void opengl_SetDrawDefaults(void)
 	drawshaders[3].AttachSourcePreprocess(genericVertexBody, genericFragBody, true, false, true);
 
 	lastdrawshader = -1;
+	numbatchverts = numbatchindices = 0;
+
+	//Init VAO and vertex state
+	glGenVertexArrays(1, &drawvao);
+	glBindVertexArray(drawvao);
 
 	//Init draw buffers
 	glGenBuffers(1, &drawbuffer);
 	glBindBuffer(GL_ARRAY_BUFFER, drawbuffer);
-	size_t buffersize = NUM_VERTS_PER_BUFFER * (sizeof(vector) + sizeof(color_array) + sizeof(tex_array) * 2);
-	glBufferData(GL_ARRAY_BUFFER, buffersize, nullptr, GL_DYNAMIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, NUM_VERTS_PER_BUFFER * sizeof(RendDynamicVertex), nullptr, GL_STREAM_DRAW);
 
-	//Init VAO and vertex state
-	glGenVertexArrays(1, &drawvao);
-	glBindVertexArray(drawvao);
+	glGenBuffers(1, &drawindexbuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, drawindexbuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, NUM_INDICES_PER_BUFFER * sizeof(ushort), nullptr, GL_STREAM_DRAW);
 
-	size_t offset = 0;
+	nextcommittedvertex = nextcommittedindex = 0;
 
 	//attrib 0: position
-	drawbufferoffsets[0] = offset;
 	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-	offset += sizeof(vector) * NUM_VERTS_PER_BUFFER;
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(RendDynamicVertex), (const void*)offsetof(RendDynamicVertex, position));
 
 	//attrib 1: color
-	drawbufferoffsets[1] = offset;
-	//glBufferData(GL_ARRAY_BUFFER, NUM_VERTS_PER_BUFFER * sizeof(color_array), nullptr, GL_DYNAMIC_DRAW);
 	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 0, (const void*)offset);
-	offset += sizeof(color_array) * NUM_VERTS_PER_BUFFER;
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(RendDynamicVertex), (const void*)offsetof(RendDynamicVertex, color));
 
 	//attrib 2: uv
-	drawbufferoffsets[2] = offset;
-	//glBufferData(GL_ARRAY_BUFFER, NUM_VERTS_PER_BUFFER * sizeof(tex_array), nullptr, GL_DYNAMIC_DRAW);
 	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, 0, (const void*)offset);
-	offset += sizeof(tex_array) * NUM_VERTS_PER_BUFFER;
+	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(RendDynamicVertex), (const void*)offsetof(RendDynamicVertex, uv));
 
 	//attrib 3: uv 2
-	drawbufferoffsets[3] = offset;
-	//glBufferData(GL_ARRAY_BUFFER, NUM_VERTS_PER_BUFFER * sizeof(tex_array), nullptr, GL_DYNAMIC_DRAW);
 	glEnableVertexAttribArray(3);
-	glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 0, (const void*)offset);
-	offset += sizeof(tex_array) * NUM_VERTS_PER_BUFFER;
+	glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(RendDynamicVertex), (const void*)offsetof(RendDynamicVertex, uv2));
 
 	/*glEnableClientState(GL_VERTEX_ARRAY);
 	glEnableClientState(GL_COLOR_ARRAY);
@@ -160,19 +183,24 @@ void opengl_SetDrawDefaults(void)
 
 void GL_SelectDrawShader()
 {
-	//TODO: This will bind excessively because I don't know if the previous shader was overridden by something.
-	//This should probably be cleaned up
+	int shader;
 	if (OpenGL_state.cur_alpha_type == AT_SPECULAR)
-		drawshaders[3].Use();
+		shader = 3;
 	else if (OpenGL_state.cur_texture_quality == 0)
-		drawshaders[0].Use();
-	else if (OpenGL_state.cur_texture_quality != 0)
-	{
-		if (Overlay_type != OT_NONE)
-			drawshaders[2].Use();
-		else
-			drawshaders[1].Use();
-	}
+		shader = 0;
+	else if (Overlay_type != OT_NONE)
+		shader = 2;
+	else
+		shader = 1;
+
+	//Anything else that changes the program flushes the batch first, which resets lastdrawshader,
+	//so the program only needs to be bound when starting a new batch.
+	if (shader == lastdrawshader)
+		return;
+
+	GL_FlushDrawBatch(RBF_SHADER);
+	drawshaders[shader].Use();
+	lastdrawshader = shader;
 }
 
 // Takes nv vertices and draws the 3D polygon defined by those vertices.
@@ -201,8 +229,6 @@ void rend_DrawPolygon3D(int handle, g3Point** p, int nv, int map_type)
 	float xscalar = 1;
 	float yscalar = 1;
 
-	GL_SelectDrawShader();
-
 	int x_add = OpenGL_state.clip_x1;
 	int y_add = OpenGL_state.clip_y1;
 
@@ -237,17 +263,30 @@ void rend_DrawPolygon3D(int handle, g3Point** p, int nv, int map_type)
 		}
 	}
 
+	//Done after the textures, since changing those will have already drawn the old batch
+	GL_SelectDrawShader();
+
 	float alpha = Alpha_multiplier * OpenGL_Alpha_factor;
 
-	vector* vertp = &GL_verts[0];
-	tex_array* texp = &GL_tex_coords[0];
-	tex_array* texp2 = &GL_tex_coords2[0];
-	color_array* colorp = &GL_colors[0];
+	int numindices = nv > 2 ? (nv - 2) * 3 : 0;
+	if (numbatchverts + nv > MAX_BATCH_VERTS || numbatchindices + numindices > MAX_BATCH_INDICES)
+	{
+		//Flushing forgets the shader, but it's still the one in use
+		int shader = lastdrawshader;
+		GL_FlushDrawBatch(RBF_FULL);
+		lastdrawshader = shader;
+	}
+
+	RendDynamicVertex* vert = &batchverts[numbatchverts];
 
 	// Specify our coordinates
-	for (i = 0; i < nv; i++, vertp++, texp++, colorp++, texp2++)
+	for (i = 0; i < nv; i++, vert++)
 	{
 		pnt = p[i];
+		vector* vertp = &vert->position;
+		color_array* colorp = &vert->color;
+		tex_array* texp = &vert->uv;
+		tex_array* texp2 = &vert->uv2;
 
 		if (OpenGL_state.cur_alpha_type & ATF_VERTEX)
 		{
@@ -327,144 +366,19 @@ void rend_DrawPolygon3D(int handle, g3Point** p, int nv, int map_type)
 		vertp->z = -z;
 	}
 
-	// And draw!
-	int offset = GL_CopyVertices(nv);
-	glDrawArrays(GL_TRIANGLE_FAN, offset, nv);
-	OpenGL_polys_drawn++;
-	OpenGL_verts_processed += nv;
-
-	CHECK_ERROR(10)
-}
-
-// Takes nv vertices and draws the 2D polygon defined by those vertices.
-// Uses bitmap "handle" as a texture
-void rend_DrawPolygon2D(int handle, g3Point** p, int nv)
-{
-	ASSERT(nv < 100);
-	ASSERT(Overlay_type == OT_NONE);
-
-	rend_DrawPolygon3D(handle, p, nv, MAP_TYPE_BITMAP);
-}
-
-// draws a scaled 2d bitmap to our buffer
-void rend_DrawScaledBitmap(int x1, int y1, int x2, int y2,
-	int bm, float u0, float v0, float u1, float v1, int color, float* alphas)
-{
-	g3Point* ptr_pnts[4];
-	g3Point pnts[4];
-	float r, g, b;
-	if (color != -1)
+	// Queue the fan as triangles, it'll be drawn when something changes state
+	ushort* index = &batchindices[numbatchindices];
+	for (i = 2; i < nv; i++)
 	{
-		r = GR_COLOR_RED(color) / 255.0;
-		g = GR_COLOR_GREEN(color) / 255.0;
-		b = GR_COLOR_BLUE(color) / 255.0;
+		*index++ = numbatchverts;
+		*index++ = numbatchverts + i - 1;
+		*index++ = numbatchverts + i;
 	}
-	for (int i = 0; i < 4; i++)
-	{
-		if (color == -1)
-			pnts[i].p3_l = 1.0;
-		else
-		{
-			pnts[i].p3_r = r;
-			pnts[i].p3_g = g;
-			pnts[i].p3_b = b;
-		}
-		if (alphas)
-		{
-			pnts[i].p3_a = alphas[i];
-		}
-
-		pnts[i].p3_z = 1.0f;
-		pnts[i].p3_flags = PF_PROJECTED;
-	}
-
-	pnts[0].p3_sx = x1;
-	pnts[0].p3_sy = y1;
-	pnts[0].p3_u = u0;
-	pnts[0].p3_v = v0;
-	pnts[1].p3_sx = x2;
-	pnts[1].p3_sy = y1;
-	pnts[1].p3_u = u1;
-	pnts[1].p3_v = v0;
-	pnts[2].p3_sx = x2;
-	pnts[2].p3_sy = y2;
-	pnts[2].p3_u = u1;
-	pnts[2].p3_v = v1;
-	pnts[3].p3_sx = x1;
-	pnts[3].p3_sy = y2;
-	pnts[3].p3_u = u0;
-	pnts[3].p3_v = v1;
-	ptr_pnts[0] = &pnts[0];
-	ptr_pnts[1] = &pnts[1];
-	ptr_pnts[2] = &pnts[2];
-	ptr_pnts[3] = &pnts[3];
-	rend_SetTextureType(TT_LINEAR);
-	rend_DrawPolygon2D(bm, ptr_pnts, 4);
-}
-
-void rend_DrawScaledBitmapWithZ(int x1, int y1, int x2, int y2,
-	int bm, float u0, float v0, float u1, float v1, float zval, int color, float* alphas)
-{
-	g3Point* ptr_pnts[4];
-	g3Point pnts[4];
-	float r, g, b;
-
-	if (color != -1)
-	{
-		r = GR_COLOR_RED(color) / 255.0;
-		g = GR_COLOR_GREEN(color) / 255.0;
-		b = GR_COLOR_BLUE(color) / 255.0;
-	}
-
-	for (int i = 0; i < 4; i++)
-	{
-		if (color == -1)
-			pnts[i].p3_l = 1.0;
-		else
-		{
-			pnts[i].p3_r = r;
-			pnts[i].p3_g = g;
-			pnts[i].p3_b = b;
-		}
 
-		if (alphas)
-		{
-			pnts[i].p3_a = alphas[i];
-		}
-
-		pnts[i].p3_z = zval;
-		pnts[i].p3_flags = PF_PROJECTED;
-	}
-
-
-
-	pnts[0].p3_sx = x1;
-	pnts[0].p3_sy = y1;
-	pnts[0].p3_u = u0;
-	pnts[0].p3_v = v0;
-
-	pnts[1].p3_sx = x2;
-	pnts[1].p3_sy = y1;
-	pnts[1].p3_u = u1;
-	pnts[1].p3_v = v0;
-
-	pnts[2].p3_sx = x2;
-	pnts[2].p3_sy = y2;
-	pnts[2].p3_u = u1;
-	pnts[2].p3_v = v1;
-
-	pnts[3].p3_sx = x1;
-	pnts[3].p3_sy = y2;
-	pnts[3].p3_u = u0;
-	pnts[3].p3_v = v1;
-
-	ptr_pnts[0] = &pnts[0];
-	ptr_pnts[1] = &pnts[1];
-	ptr_pnts[2] = &pnts[2];
-	ptr_pnts[3] = &pnts[3];
-
-	rend_SetTextureType(TT_LINEAR);
-	rend_DrawPolygon3D(bm, ptr_pnts, 4);
+	numbatchverts += nv;
+	numbatchindices += numindices;
+	OpenGL_polys_drawn++;
+	OpenGL_verts_processed += nv;
 }
 
 // Fills a rectangle on the display
@@ -480,6 +394,7 @@ void rend_FillRect(ddgr_color color, int x1, int y1, int x2, int y2)
 	x1 += OpenGL_state.clip_x1;
 	y1 += OpenGL_state.clip_y1;
 
+	GL_FlushDrawBatch(RBF_FRAME);
 	glEnable(GL_SCISSOR_TEST);
 	glScissor(x1, OpenGL_state.screen_height - (height + y1), width, height);
 	glClearColor((float)r / 255.0, (float)g / 255.0, (float)b / 255.0, 0);
@@ -510,6 +425,7 @@ void rend_SetPixel(ddgr_color color, int x, int y)
 ddgr_color rend_GetPixel(int x, int y)
 {
 	ddgr_color color[4];
+	GL_FlushDrawBatch(RBF_FRAME);
 	glReadPixels(x, (OpenGL_state.screen_height - 1) - y, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, (GLvoid*)color);
 	return color[0];
 }
@@ -522,36 +438,6 @@ void rend_DrawCircle(int x, int y, int rad)
 {
 }
 
-// Sets up a font character to draw.  We draw our fonts as pieces of textures
-void rend_DrawFontCharacter(int bm_handle, int x1, int y1, int x2, int y2, float u, float v, float w, float h)
-{
-	g3Point* ptr_pnts[4];
-	g3Point pnts[4];
-	for (int i = 0; i < 4; i++)
-	{
-		pnts[i].p3_z = 1;	// Make REALLY close!
-		pnts[i].p3_flags = PF_PROJECTED;
-		ptr_pnts[i] = &pnts[i];
-	}
-	pnts[0].p3_sx = x1;
-	pnts[0].p3_sy = y1;
-	pnts[0].p3_u = u;
-	pnts[0].p3_v = v;
-	pnts[1].p3_sx = x2;
-	pnts[1].p3_sy = y1;
-	pnts[1].p3_u = u + w;
-	pnts[1].p3_v = v;
-	pnts[2].p3_sx = x2;
-	pnts[2].p3_sy = y2;
-	pnts[2].p3_u = u + w;
-	pnts[2].p3_v = v + h;
-	pnts[3].p3_sx = x1;
-	pnts[3].p3_sy = y2;
-	pnts[3].p3_u = u;
-	pnts[3].p3_v = v + h;
-	rend_DrawPolygon2D(bm_handle, ptr_pnts, 4);
-}
-
 // Draws a line
 void rend_DrawLine(int x1, int y1, int x2, int y2)
 {
@@ -872,102 +758,3 @@ void rend_ReleaseLFBLock(renderer_lfb* lfb)
 void rend_DrawLFBBitmap(int sx, int sy, int w, int h, int dx, int dy, ushort* data, int rowsize)
 {
 }
-
-//	given a chunked bitmap, renders it.
-void rend_DrawChunkedBitmap(chunked_bitmap* chunk, int x, int y, ubyte alpha)
-{
-	int* bm_array = chunk->bm_array;
-	int w = chunk->w;
-	int h = chunk->h;
-	int piece_w = bm_w(bm_array[0], 0);
-	int piece_h = bm_h(bm_array[0], 0);
-	int screen_w, screen_h;
-	int i, t;
-	rend_SetZBufferState(0);
-	rend_GetProjectionParameters(&screen_w, &screen_h);
-	for (i = 0; i < h; i++)
-	{
-		for (t = 0; t < w; t++)
-		{
-			int dx = x + (piece_w * t);
-			int dy = y + (piece_h * i);
-			int dw, dh;
-			if ((dx + piece_w) > screen_w)
-				dw = piece_w - ((dx + piece_w) - screen_w);
-			else
-				dw = piece_w;
-			if ((dy + piece_h) > screen_h)
-				dh = piece_h - ((dy + piece_h) - screen_h);
-			else
-				dh = piece_h;
-
-			float u2 = (float)dw / (float)piece_w;
-			float v2 = (float)dh / (float)piece_h;
-			rend_DrawSimpleBitmap(bm_array[i * w + t], dx, dy);
-		}
-	}
-	rend_SetZBufferState(1);
-}
-
-//	given a chunked bitmap, renders it.scaled
-void rend_DrawScaledChunkedBitmap(chunked_bitmap* chunk, int x, int y, int neww, int newh, ubyte alpha)
-{
-	int* bm_array = chunk->bm_array;
-	int w = chunk->w;
-	int h = chunk->h;
-	int piece_w;
-	int piece_h;
-	int screen_w, screen_h;
-	int i, t;
-
-	float scalew, scaleh;
-
-	scalew = ((float)neww) / ((float)chunk->pw);
-	scaleh = ((float)newh) / ((float)chunk->ph);
-	piece_w = scalew * ((float)bm_w(bm_array[0], 0));
-	piece_h = scaleh * ((float)bm_h(bm_array[0], 0));
-	rend_GetProjectionParameters(&screen_w, &screen_h);
-	rend_SetOverlayType(OT_NONE);
-	rend_SetLighting(LS_NONE);
-	rend_SetColorModel(CM_MONO);
-	rend_SetZBufferState(0);
-	rend_SetAlphaType(AT_CONSTANT_TEXTURE);
-	rend_SetAlphaValue(alpha);
-	rend_SetWrapType(WT_WRAP);
-	for (i = 0; i < h; i++)
-	{
-		for (t = 0; t < w; t++)
-		{
-			int dx = x + (piece_w * t);
-			int dy = y + (piece_h * i);
-			int dw, dh;
-			if ((dx + piece_w) > screen_w)
-				dw = piece_w - ((dx + piece_w) - screen_w);
-			else
-				dw = piece_w;
-			if ((dy + piece_h) > screen_h)
-				dh = piece_h - ((dy + piece_h) - screen_h);
-			else
-				dh = piece_h;
-
-			float u2 = (float)dw / (float)piece_w;
-			float v2 = (float)dh / (float)piece_h;
-			rend_DrawScaledBitmap(dx, dy, dx + dw, dy + dh, bm_array[i * w + t], 0, 0, u2, v2);
-
-		}
-	}
-	rend_SetZBufferState(1);
-}
-
-// Draws a simple bitmap at the specified x,y location
-void rend_DrawSimpleBitmap(int bm_handle, int x, int y)
-{
-	rend_SetAlphaType(AT_CONSTANT_TEXTURE);
-	rend_SetAlphaValue(255);
-	rend_SetLighting(LS_NONE);
-	rend_SetColorModel(CM_MONO);
-	rend_SetOverlayType(OT_NONE);
-	rend_SetFiltering(0);
-	rend_DrawScaledBitmap(x, y, x + bm_w(bm_handle, 0), y + bm_h(bm_handle, 0), bm_handle, 0, 0, 1, 1);
-	rend_SetFiltering(1);
-}
@@ -76,6 +76,9 @@ int opengl_MakeTextureObject(int tn)
 {
 	int num = Cur_texture_object_num;
 
+	//Binds a new texture, so anything queued has to go first
+	GL_FlushDrawBatch(RBF_TEXTURE);
+
 	Cur_texture_object_num++;
 
 	if (texture_name_list[num] == 0)
@@ -171,6 +174,8 @@ int opengl_MakeBitmapCurrent(int handle, int map_type, int tn)
 
 	if (OpenGL_last_bound[tn] != texnum)
 	{
+		GL_FlushDrawBatch(RBF_TEXTURE);
+
 		if (UseMultitexture && Last_texel_unit_set != tn)
 		{
 			glActiveTexture(GL_TEXTURE0 + tn);
@@ -205,6 +210,8 @@ void opengl_MakeWrapTypeCurrent(int handle, int map_type, int tn)
 	if (uwrap == dest_wrap)
 		return;
 
+	GL_FlushDrawBatch(RBF_TEXTURE);
+
 	if (UseMultitexture && Last_texel_unit_set != tn)
 	{
 		glActiveTexture(GL_TEXTURE0 + tn);
@@ -269,6 +276,8 @@ void opengl_MakeFilterTypeCurrent(int handle, int map_type, int tn)
 
 	if (magf == dest_filter && mmip == dest_mip)
 		return;
+
+	GL_FlushDrawBatch(RBF_TEXTURE);
 	if (UseMultitexture && Last_texel_unit_set != tn)
 	{
 		glActiveTexture(GL_TEXTURE0 + tn);
@@ -551,6 +560,9 @@ void opengl_TranslateBitmapToOpenGL(int texnum, int bm_handle, int map_type, int
 	int w, h;
 	int size;
 
+	//Queued polygons may still be using the old contents
+	GL_FlushDrawBatch(RBF_TEXTURE);
+
 	if (UseMultitexture && Last_texel_unit_set != tn)
 	{
 		glActiveTexture(GL_TEXTURE0 + tn);
@@ -592,6 +604,53 @@ void opengl_TranslateBitmapToOpenGL(int texnum, int bm_handle, int map_type, int
 
 	int i;
 
+	// If we know which part of a lightmap changed, only send that
+	if (map_type == MAP_TYPE_LIGHTMAP && replace && (GameLightmaps[bm_handle].flags & LF_LIMITS))
+	{
+		bms_lightmap* lm = &GameLightmaps[bm_handle];
+		int x1 = lm->cx1, y1 = lm->cy1;
+		int x2 = lm->cx2, y2 = lm->cy2;
+
+		if (x2 > w)
+			x2 = w;
+		if (y2 > h)
+			y2 = h;
+
+		if (x2 > x1 && y2 > y1)
+		{
+			if (OpenGL_packed_pixels)
+			{
+				ushort* dest_data = opengl_packed_Upload_data;
+
+				for (int y = y1; y < y2; y++)
+				{
+					for (int x = x1; x < x2; x++)
+						*dest_data++ = opengl_packed_Translate_table[bm_ptr[y * w + x]];
+				}
+
+				glTexSubImage2D(GL_TEXTURE_2D, 0, x1, y1, x2 - x1, y2 - y1, GL_RGBA, GL_UNSIGNED_SHORT_5_5_5_1, opengl_packed_Upload_data);
+			}
+			else
+			{
+				uint* dest_data = opengl_Upload_data;
+
+				for (int y = y1; y < y2; y++)
+				{
+					for (int x = x1; x < x2; x++)
+						*dest_data++ = opengl_Translate_table[bm_ptr[y * w + x]];
+				}
+
+				glTexSubImage2D(GL_TEXTURE_2D, 0, x1, y1, x2 - x1, y2 - y1, GL_RGBA, GL_UNSIGNED_BYTE, opengl_Upload_data);
+			}
+		}
+
+		lm->flags &= ~LF_LIMITS;
+
+		CHECK_ERROR(6)
+			OpenGL_uploads++;
+		return;
+	}
+
 	if (OpenGL_packed_pixels)
 	{
 		if (map_type == MAP_TYPE_LIGHTMAP)
@@ -103,6 +103,8 @@ extern bool OpenGL_blending_on;
 extern bool OpenGL_multitexture_state;
 extern int OpenGL_polys_drawn;
 extern int OpenGL_verts_processed;
+extern int OpenGL_batches_drawn;
+extern int OpenGL_batch_flushes[NUM_RBF_REASONS];
 
 void opengl_SetDrawDefaults(void);
 void rend_SetLightingState(light_state state);
@@ -112,6 +114,9 @@ void opengl_SetMultitextureBlendMode(bool state);
 void opengl_DrawFlatPolygon3D(g3Point** p, int nv);
 //Call to ensure that the draw VAO is always ready to go when changing VAOs.
 void GL_UseDrawVAO(void);
+//Draws any polygons rend_DrawPolygon3D has queued up. Must be called before changing
+//any GL state that the queued polygons depend on. reason is one of the RBF_ values.
+void GL_FlushDrawBatch(int reason);
 
 //gl_framebuffer.cpp
 class Framebuffer
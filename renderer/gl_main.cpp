@@ -257,6 +257,8 @@ int rend_SetPreferredState(renderer_preferred_state* pref_state)
 
 void rend_StartFrame(int x1, int y1, int x2, int y2, int clear_flags)
 {
+	GL_FlushDrawBatch(RBF_FRAME);
+
 	if (clear_flags & RF_CLEAR_ZBUFFER)
 	{
 		glClear(GL_DEPTH_BUFFER_BIT);
@@ -270,10 +272,14 @@ void rend_StartFrame(int x1, int y1, int x2, int y2, int clear_flags)
 static int OpenGL_last_frame_polys_drawn = 0;
 static int OpenGL_last_frame_verts_processed = 0;
 static int OpenGL_last_uploaded = 0;
+static int OpenGL_last_frame_batches_drawn = 0;
+static int OpenGL_last_frame_batch_flushes[NUM_RBF_REASONS];
 
 // Flips the screen
 void rend_Flip(void)
 {
+	GL_FlushDrawBatch(RBF_FRAME);
+
 #ifndef NDEBUG
 	GLenum err = glGetError();
 	if (err != GL_NO_ERROR)
@@ -290,6 +296,7 @@ void rend_Flip(void)
 	mprintf_at((1, 1, 0, "Uploads=%d    Polys=%d   Verts=%d   ", OpenGL_uploads, OpenGL_polys_drawn, OpenGL_verts_processed));
 	mprintf_at((1, 2, 0, "Sets= 0:%d   1:%d   2:%d   3:%d   ", OpenGL_sets_this_frame[0], OpenGL_sets_this_frame[1], OpenGL_sets_this_frame[2], OpenGL_sets_this_frame[3]));
 	mprintf_at((1, 3, 0, "Sets= 4:%d   5:%d  ", OpenGL_sets_this_frame[4], OpenGL_sets_this_frame[5]));
+	mprintf_at((1, 4, 0, "Batches=%d   ", OpenGL_batches_drawn));
 	for (i = 0; i < 10; i++)
 	{
 		OpenGL_sets_this_frame[i] = 0;
@@ -299,10 +306,14 @@ void rend_Flip(void)
 	OpenGL_last_frame_polys_drawn = OpenGL_polys_drawn;
 	OpenGL_last_frame_verts_processed = OpenGL_verts_processed;
 	OpenGL_last_uploaded = OpenGL_uploads;
+	OpenGL_last_frame_batches_drawn = OpenGL_batches_drawn;
+	memcpy(OpenGL_last_frame_batch_flushes, OpenGL_batch_flushes, sizeof(OpenGL_batch_flushes));
 
 	OpenGL_uploads = 0;
 	OpenGL_polys_drawn = 0;
 	OpenGL_verts_processed = 0;
+	OpenGL_batches_drawn = 0;
+	memset(OpenGL_batch_flushes, 0, sizeof(OpenGL_batch_flushes));
 
 	if (OpenGL_preferred_state.gamma == 1.0)
 		framebuffers[framebuffer_current_draw].BlitToRaw(0, framebuffer_blit_x, framebuffer_blit_y, framebuffer_blit_w, framebuffer_blit_h);
@@ -350,6 +361,7 @@ void rend_Flip(void)
 
 void rend_EndFrame(void)
 {
+	GL_FlushDrawBatch(RBF_FRAME);
 }
 
 
@@ -370,6 +382,7 @@ bool opengl_CheckExtension(char* extName)
 
 void opengl_SetGammaValue(float val)
 {
+	GL_FlushDrawBatch(RBF_EXTERNAL);
 	blitshader.Use();
 
 	glUniform1f(blitshader_gamma, 1.f / val);
@@ -520,6 +533,7 @@ void rend_SetZBufferState(sbyte state)
 	if (state == OpenGL_state.cur_zbuffer_state)
 		return;	// No redundant state setting
 
+	GL_FlushDrawBatch(RBF_STATE);
 	OpenGL_sets_this_frame[5]++;
 	OpenGL_state.cur_zbuffer_state = state;
 
@@ -565,6 +579,7 @@ void rend_ClearScreen(ddgr_color color)
 	int g = (color >> 8 & 0xFF);
 	int b = (color & 0xFF);
 
+	GL_FlushDrawBatch(RBF_FRAME);
 	glClearColor((float)r / 255.0f, (float)g / 255.0f, (float)b / 255.0f, 0);
 
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -573,6 +588,7 @@ void rend_ClearScreen(ddgr_color color)
 // Clears the zbuffer for the screen
 void rend_ClearZBuffer(void)
 {
+	GL_FlushDrawBatch(RBF_FRAME);
 	glClear(GL_DEPTH_BUFFER_BIT);
 }
 
@@ -699,6 +715,8 @@ void rend_SetAlphaType(sbyte atype)
 {
 	if (atype == OpenGL_state.cur_alpha_type)
 		return;		// don't set it redundantly
+
+	GL_FlushDrawBatch(RBF_STATE);
 	if (UseMultitexture && Last_texel_unit_set != 0)
 	{
 		glActiveTexture(GL_TEXTURE0 + 0);
@@ -815,6 +833,7 @@ void rend_SetZBias(float z_bias)
 // Enables/disables writes the depth buffer
 void rend_SetZBufferWriteMask(int state)
 {
+	GL_FlushDrawBatch(RBF_STATE);
 	OpenGL_sets_this_frame[5]++;
 	if (state)
 	{
@@ -852,6 +871,7 @@ float rend_GetAspectRatio(void)
 // This helps reduce z buffer artifacts
 void rend_SetCoplanarPolygonOffset(float factor)
 {
+	GL_FlushDrawBatch(RBF_STATE);
 	if (factor == 0.0f)
 	{
 		glDisable(GL_POLYGON_OFFSET_FILL);
@@ -920,6 +940,8 @@ void rend_GetStatistics(tRendererStats* stats)
 		stats->poly_count = OpenGL_last_frame_polys_drawn;
 		stats->vert_count = OpenGL_last_frame_verts_processed;
 		stats->texture_uploads = OpenGL_last_uploaded;
+		stats->batch_count = OpenGL_last_frame_batches_drawn;
+		memcpy(stats->batch_flushes, OpenGL_last_frame_batch_flushes, sizeof(stats->batch_flushes));
 	}
 	else
 	{
@@ -927,6 +949,13 @@ void rend_GetStatistics(tRendererStats* stats)
 	}
 }
 
+// Draw commands are only recorded by the null renderer
+int rend_GetCommandLog(const rend_command** commands)
+{
+	*commands = nullptr;
+	return 0;
+}
+
 // Tells the software renderer whether or not to use mipping
 void rend_SetMipState(sbyte mipstate)
 {
@@ -974,6 +1003,7 @@ void rend_Screenshot(int bm_handle)
 
 	dest_data = bm_data(bm_handle, 0);
 
+	GL_FlushDrawBatch(RBF_FRAME);
 	glReadPixels(0, 0, OpenGL_state.screen_width, OpenGL_state.screen_height, GL_RGBA, GL_UNSIGNED_BYTE, (GLvoid*)temp_data);
 
 	for (i = 0; i < h; i++)
@@ -995,6 +1025,7 @@ void rend_Screenshot(int bm_handle)
 
 void opengl_UpdateFramebuffer(void)
 {
+	GL_FlushDrawBatch(RBF_EXTERNAL);
 	for (int i = 0; i < NUM_FBOS; i++)
 	{
 		framebuffers[i].Update(OpenGL_state.screen_width, OpenGL_state.screen_height, OpenGL_preferred_state.antialised);
@@ -1010,6 +1041,7 @@ void opengl_UpdateFramebuffer(void)
 
 void opengl_CloseFramebuffer(void)
 {
+	GL_FlushDrawBatch(RBF_EXTERNAL);
 	for (int i = 0; i < NUM_FBOS; i++)
 	{
 		framebuffers[i].Destroy();
@@ -1023,10 +1055,12 @@ void opengl_CloseFramebuffer(void)
 //shader test
 void rend_UseShaderTest(void)
 {
+	GL_FlushDrawBatch(RBF_EXTERNAL);
 	testshader.Use();
 }
 
 void rend_EndShaderTest(void)
 {
+	GL_FlushDrawBatch(RBF_EXTERNAL);
 	glUseProgram(0);
 }
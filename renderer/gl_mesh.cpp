@@ -173,6 +173,7 @@ void MeshBuilder::Destroy()
 
 void MeshBuilder::Draw() const
 {
+	GL_FlushDrawBatch(RBF_EXTERNAL);
 	glBindVertexArray(m_handle);
 	if (m_indexhandle)
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexhandle);
@@ -22,6 +22,26 @@
 #include "pstypes.h"
 #include "vecmat.h"
 
+struct color_array
+{
+	float r, g, b, a;
+};
+
+struct tex_array
+{
+	float s, t, r, w;
+};
+
+//Vertex written by the immediate draw functions every frame.
+//Keeps the projective texture coordinates of the old separate arrays in one interleaved stream.
+struct RendDynamicVertex
+{
+	vector position;
+	color_array color;
+	tex_array uv;
+	tex_array uv2;
+};
+
 struct RendVertex
 {
 	vector position;
@@ -17,6 +17,7 @@
 */
 #include <string.h>
 #include <string>
+#include "gl_local.h"
 #include "gl_shader.h"
 #include "pserror.h"
 
@@ -53,6 +54,7 @@ void rend_UpdateCommon(float* projection, float* modelview)
 	memcpy(newblock.projection, projection, sizeof(newblock.projection));
 	memcpy(newblock.modelview, modelview, sizeof(newblock.modelview));
 
+	GL_FlushDrawBatch(RBF_STATE);
 	glBindBuffer(GL_COPY_WRITE_BUFFER, commonbuffername);
 	glBufferSubData(GL_COPY_WRITE_BUFFER, 0, sizeof(CommonBlock), &newblock);
 
@@ -67,6 +69,7 @@ void GL_UpdateLegacyBlock(float* projection, float* modelview)
 	memcpy(newblock.projection, projection, sizeof(newblock.projection));
 	memcpy(newblock.modelview, modelview, sizeof(newblock.modelview));
 
+	GL_FlushDrawBatch(RBF_STATE);
 	glBindBuffer(GL_COPY_WRITE_BUFFER, legacycommonbuffername);
 	glBufferSubData(GL_COPY_WRITE_BUFFER, 0, sizeof(CommonBlock), &newblock);
 
@@ -0,0 +1,798 @@
+/*
+* Descent 3: Piccu Engine
+* Copyright (C) 2024 SaladBadger
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//Headless renderer. Nothing is drawn, but every frame's draws and state changes are recorded
+//into a command log, and the statistics are kept the same way the OpenGL renderer keeps them,
+//so the game can be run and profiled on machines without a graphics card.
+//Built instead of the OpenGL renderer when D3_NULL_RENDERER is enabled.
+
+#include <string.h>
+#include <vector>
+#include "3d.h"
+#include "renderer.h"
+#include "bitmap.h"
+#include "lightmap.h"
+#include "pserror.h"
+#include "mono.h"
+#include "gl_mesh.h"
+
+//Should match the size of the OpenGL renderer's batches, so batch counts can be compared
+constexpr int MAX_BATCH_VERTS = 4096;
+constexpr int MAX_BATCH_INDICES = MAX_BATCH_VERTS * 3;
+//Past this many commands a frame, further commands are dropped from the log
+constexpr int MAX_LOGGED_COMMANDS = 1 << 20;
+
+bool UseHardware = true;
+bool StateLimited;
+bool NoLightmaps;
+bool UseMultitexture;
+renderer_type Renderer_type = RENDERER_NONE;
+
+int Overlay_map = -1;
+int Bump_map = 0;
+int Bumpmap_ready = 0;
+ubyte Overlay_type = OT_NONE;
+float Z_bias = 0.0f;
+
+static bool NullRend_initted;
+static renderer_preferred_state NullRend_preferred_state;
+static rendering_state NullRend_state;
+static float NullRend_alpha_factor = 1.0f;
+static char Renderer_error_message[256];
+
+//Statistics for the frame being drawn, and the last frame flipped
+static tRendererStats NullRend_frame_stats, NullRend_last_frame_stats;
+
+//The commands for the frame being drawn, and the last frame flipped
+static std::vector<rend_command> NullRend_commands, NullRend_last_commands;
+
+//Size of the batch the OpenGL renderer would have queued up, and the shader it was using
+static int NullRend_batch_verts, NullRend_batch_indices;
+static int NullRend_batch_shader = -1;
+
+//Texture "cache". 0 means the bitmap was never uploaded, otherwise it's the wrap type + 1
+static ubyte NullRend_bitmap_states[MAX_BITMAPS];
+static ubyte NullRend_lightmap_states[MAX_LIGHTMAPS];
+static int NullRend_last_bound[2];
+
+extern bool Force_one_texture;
+
+static void NullRend_AddCommand(int type, int state, int count, int value)
+{
+	if (NullRend_commands.size() >= MAX_LOGGED_COMMANDS)
+		return;
+
+	rend_command cmd;
+	cmd.type = type;
+	cmd.state = state;
+	cmd.count = count > 65535 ? 65535 : count;
+	cmd.value = value;
+	NullRend_commands.push_back(cmd);
+}
+
+static void NullRend_LogState(int state, int value)
+{
+	NullRend_AddCommand(RCMD_SET_STATE, state, 0, value);
+}
+
+//Ends the batch the OpenGL renderer would have been building. Empty batches aren't counted, same as GL_FlushDrawBatch.
+static void NullRend_FlushBatch(int reason)
+{
+	NullRend_batch_shader = -1;
+
+	if (NullRend_batch_indices == 0)
+	{
+		NullRend_batch_verts = 0;
+		return;
+	}
+
+	NullRend_batch_verts = NullRend_batch_indices = 0;
+	NullRend_frame_stats.batch_count++;
+	NullRend_frame_stats.batch_flushes[reason]++;
+}
+
+//Marks a bitmap as uploaded and bound, counting the uploads and texture changes the OpenGL renderer would make
+static void NullRend_MakeBitmapCurrent(int handle, int map_type, int tn)
+{
+	ubyte* state;
+	wrap_type dest_wrap = tn == 1 ? WT_CLAMP : NullRend_state.cur_wrap_type;
+	int bindid;
+
+	if (map_type == MAP_TYPE_LIGHTMAP)
+	{
+		state = &NullRend_lightmap_states[handle];
+		if (*state == 0 || (GameLightmaps[handle].flags & LF_CHANGED))
+		{
+			GameLightmaps[handle].flags &= ~(LF_CHANGED | LF_BRAND_NEW);
+			NullRend_frame_stats.texture_uploads++;
+		}
+		bindid = -2 - handle;
+	}
+	else
+	{
+		if (Force_one_texture)
+			handle = 0;
+
+		state = &NullRend_bitmap_states[handle];
+		if (*state == 0 || (GameBitmaps[handle].flags & BF_CHANGED))
+		{
+			GameBitmaps[handle].flags &= ~(BF_CHANGED | BF_BRAND_NEW);
+			NullRend_frame_stats.texture_uploads++;
+		}
+		bindid = handle;
+	}
+
+	//New textures start out clamped
+	if (*state == 0)
+		*state = WT_CLAMP + 1;
+
+	if (NullRend_last_bound[tn] != bindid)
+	{
+		NullRend_FlushBatch(RBF_TEXTURE);
+		NullRend_last_bound[tn] = bindid;
+	}
+
+	if (*state != dest_wrap + 1)
+	{
+		NullRend_FlushBatch(RBF_TEXTURE);
+		*state = dest_wrap + 1;
+	}
+}
+
+static void NullRend_ClearCache(void)
+{
+	memset(NullRend_bitmap_states, 0, sizeof(NullRend_bitmap_states));
+	memset(NullRend_lightmap_states, 0, sizeof(NullRend_lightmap_states));
+	NullRend_last_bound[0] = NullRend_last_bound[1] = -1;
+}
+
+static void NullRend_SetScreenSize(void)
+{
+	NullRend_state.screen_width = NullRend_preferred_state.width;
+	NullRend_state.screen_height = NullRend_preferred_state.height;
+	NullRend_state.view_width = NullRend_preferred_state.window_width;
+	NullRend_state.view_height = NullRend_preferred_state.window_height;
+}
+
+// Init our renderer
+int rend_Init(renderer_type state, oeApplication* app, renderer_preferred_state* pref_state)
+{
+	rend_SetRendererType(state);
+	if (NullRend_initted)
+		return 1;
+
+	mprintf((0, "Initializing null renderer\n"));
+
+	NullRend_initted = true;
+	NullRend_preferred_state = *pref_state;
+
+	//Same defaults as the OpenGL renderer
+	memset(&NullRend_state, 0, sizeof(NullRend_state));
+	NullRend_state.cur_color = 0x00FFFFFF;
+	NullRend_state.cur_bilinear_state = -1;
+	NullRend_state.cur_zbuffer_state = -1;
+	NullRend_state.cur_texture_quality = -1;
+	NullRend_state.cur_light_state = LS_GOURAUD;
+	NullRend_state.cur_color_model = CM_MONO;
+	NullRend_state.cur_mip_state = -1;
+	NullRend_state.cur_alpha_type = AT_TEXTURE;
+	NullRend_state.gamma_value = pref_state->gamma;
+	NullRend_SetScreenSize();
+	NullRend_state.initted = 1;
+
+	NullRend_ClearCache();
+	NullRend_batch_verts = NullRend_batch_indices = 0;
+	NullRend_batch_shader = -1;
+
+	memset(&NullRend_frame_stats, 0, sizeof(NullRend_frame_stats));
+	memset(&NullRend_last_frame_stats, 0, sizeof(NullRend_last_frame_stats));
+	NullRend_commands.clear();
+	NullRend_last_commands.clear();
+
+	return 1;
+}
+
+void rend_Close(void)
+{
+	if (!NullRend_initted)
+		return;
+
+	NullRend_commands.clear();
+	NullRend_commands.shrink_to_fit();
+	NullRend_last_commands.clear();
+	NullRend_last_commands.shrink_to_fit();
+
+	NullRend_state.initted = 0;
+	NullRend_initted = false;
+}
+
+// Sets some global preferences for the renderer
+int rend_SetPreferredState(renderer_preferred_state* pref_state)
+{
+	NullRend_preferred_state = *pref_state;
+	if (NullRend_state.initted)
+	{
+		NullRend_SetScreenSize();
+		NullRend_state.gamma_value = pref_state->gamma;
+	}
+
+	return 1;
+}
+
+void rend_SetRendererType(renderer_type state)
+{
+	//Keep whatever the game asked for, so it takes the same code paths it would with a real renderer
+	Renderer_type = state;
+}
+
+void rend_StartFrame(int x1, int y1, int x2, int y2, int clear_flags)
+{
+	NullRend_FlushBatch(RBF_FRAME);
+
+	NullRend_state.clip_x1 = x1;
+	NullRend_state.clip_y1 = y1;
+	NullRend_state.clip_x2 = x2;
+	NullRend_state.clip_y2 = y2;
+
+	NullRend_AddCommand(RCMD_START_FRAME, 0, 0, clear_flags);
+}
+
+void rend_EndFrame(void)
+{
+	NullRend_FlushBatch(RBF_FRAME);
+}
+
+// Flips the screen
+void rend_Flip(void)
+{
+	NullRend_FlushBatch(RBF_FRAME);
+	NullRend_AddCommand(RCMD_FLIP, 0, 0, 0);
+
+	NullRend_last_frame_stats = NullRend_frame_stats;
+	memset(&NullRend_frame_stats, 0, sizeof(NullRend_frame_stats));
+
+	NullRend_last_commands.swap(NullRend_commands);
+	NullRend_commands.clear();
+}
+
+// returns rendering statistics for the frame
+void rend_GetStatistics(tRendererStats* stats)
+{
+	if (NullRend_initted)
+		*stats = NullRend_last_frame_stats;
+	else
+		memset(stats, 0, sizeof(tRendererStats));
+}
+
+// Gets the commands recorded during the last full frame and returns how many there are.
+int rend_GetCommandLog(const rend_command** commands)
+{
+	*commands = NullRend_last_commands.data();
+	return NullRend_last_commands.size();
+}
+
+// Takes nv vertices and draws the 3D polygon defined by those vertices.
+// Uses bitmap "handle" as a texture
+void rend_DrawPolygon3D(int handle, g3Point** p, int nv, int map_type)
+{
+	ASSERT(nv < 100);
+
+	if (NullRend_state.cur_texture_quality != 0)
+	{
+		NullRend_MakeBitmapCurrent(handle, map_type, 0);
+		if (Overlay_type != OT_NONE)
+			NullRend_MakeBitmapCurrent(Overlay_map, MAP_TYPE_LIGHTMAP, 1);
+	}
+
+	//Same shader selection as GL_SelectDrawShader
+	int shader;
+	if (NullRend_state.cur_alpha_type == AT_SPECULAR)
+		shader = 3;
+	else if (NullRend_state.cur_texture_quality == 0)
+		shader = 0;
+	else if (Overlay_type != OT_NONE)
+		shader = 2;
+	else
+		shader = 1;
+
+	if (shader != NullRend_batch_shader)
+	{
+		NullRend_FlushBatch(RBF_SHADER);
+		NullRend_batch_shader = shader;
+	}
+
+	int numindices = nv > 2 ? (nv - 2) * 3 : 0;
+	if (NullRend_batch_verts + nv > MAX_BATCH_VERTS || NullRend_batch_indices + numindices > MAX_BATCH_INDICES)
+	{
+		NullRend_FlushBatch(RBF_FULL);
+		NullRend_batch_shader = shader;
+	}
+
+	NullRend_batch_verts += nv;
+	NullRend_batch_indices += numindices;
+	NullRend_frame_stats.poly_count++;
+	NullRend_frame_stats.vert_count += nv;
+
+	NullRend_AddCommand(RCMD_DRAW_POLYGON, map_type, nv, handle);
+}
+
+void rend_SetFlatColor(ddgr_color color)
+{
+	if (color != NullRend_state.cur_color)
+		NullRend_LogState(RSTATE_FLAT_COLOR, color);
+	NullRend_state.cur_color = color;
+}
+
+// Sets the fog state to TRUE or FALSE
+void rend_SetFogState(sbyte state)
+{
+	NullRend_state.cur_fog_state = state;
+}
+
+// Sets the near and far plane of fog
+void rend_SetFogBorders(float nearz, float farz)
+{
+	NullRend_state.cur_fog_start = nearz;
+	NullRend_state.cur_fog_end = farz;
+}
+
+// Sets the color of fog
+void rend_SetFogColor(ddgr_color color)
+{
+	NullRend_state.cur_fog_color = color;
+}
+
+void rend_SetLighting(light_state state)
+{
+	if (state == LS_PHONG)
+		state = LS_GOURAUD;
+	if (state == NullRend_state.cur_light_state)
+		return;
+
+	NullRend_state.cur_light_state = state;
+	NullRend_LogState(RSTATE_LIGHTING, state);
+}
+
+void rend_SetColorModel(color_model state)
+{
+	if (state == NullRend_state.cur_color_model)
+		return;
+
+	NullRend_state.cur_color_model = state;
+	NullRend_LogState(RSTATE_COLOR_MODEL, state);
+}
+
+void rend_SetTextureType(texture_type state)
+{
+	if (state == NullRend_state.cur_texture_type)
+		return;
+
+	NullRend_state.cur_texture_quality = state == TT_FLAT ? 0 : 2;
+	NullRend_state.cur_texture_type = state;
+	NullRend_LogState(RSTATE_TEXTURE_TYPE, state);
+}
+
+// Sets the state of bilinear filtering for our textures
+void rend_SetFiltering(sbyte state)
+{
+	if (state != NullRend_state.cur_bilinear_state)
+		NullRend_LogState(RSTATE_FILTERING, state);
+	NullRend_state.cur_bilinear_state = state;
+}
+
+// Tells the software renderer whether or not to use mipping
+void rend_SetMipState(sbyte mipstate)
+{
+	NullRend_state.cur_mip_state = mipstate;
+}
+
+// Sets the state of z-buffering to on or off
+void rend_SetZBufferState(sbyte state)
+{
+	if (state == NullRend_state.cur_zbuffer_state)
+		return;
+
+	NullRend_FlushBatch(RBF_STATE);
+	NullRend_state.cur_zbuffer_state = state;
+	NullRend_LogState(RSTATE_ZBUFFER, state);
+}
+
+// Sets the near and far planes for z buffer
+void rend_SetZValues(float nearz, float farz)
+{
+	NullRend_state.cur_near_z = nearz;
+	NullRend_state.cur_far_z = farz;
+}
+
+// Enables/disables writes the depth buffer
+void rend_SetZBufferWriteMask(int state)
+{
+	//The OpenGL renderer doesn't filter these, so neither do the stats
+	NullRend_FlushBatch(RBF_STATE);
+	NullRend_LogState(RSTATE_ZWRITE, state);
+}
+
+void rend_SetZBias(float z_bias)
+{
+	Z_bias = z_bias;
+}
+
+// Sets a bitmap as a overlay map to rendered on top of the next texture map
+// a -1 value indicates no overlay map
+void rend_SetOverlayMap(int handle)
+{
+	if (handle != Overlay_map)
+		NullRend_LogState(RSTATE_OVERLAY_MAP, handle);
+	Overlay_map = handle;
+}
+
+void rend_SetOverlayType(ubyte type)
+{
+	if (type != Overlay_type)
+		NullRend_LogState(RSTATE_OVERLAY_TYPE, type);
+	Overlay_type = type;
+}
+
+void rend_SetAlphaType(sbyte atype)
+{
+	if (atype == NullRend_state.cur_alpha_type)
+		return;
+
+	NullRend_FlushBatch(RBF_STATE);
+
+	if (atype == AT_ALWAYS || atype == AT_TEXTURE)
+		rend_SetAlphaValue(255);
+	else if (atype == AT_SPECULAR)
+	{
+		NullRend_state.cur_texture_quality = 2;
+		NullRend_state.cur_texture_type = TT_PERSPECTIVE;
+	}
+
+	NullRend_state.cur_alpha_type = atype;
+	NullRend_LogState(RSTATE_ALPHA_TYPE, atype);
+}
+
+// Sets the alpha value for constant alpha
+void rend_SetAlphaValue(ubyte val)
+{
+	if (val != NullRend_state.cur_alpha)
+		NullRend_LogState(RSTATE_ALPHA_VALUE, val);
+	NullRend_state.cur_alpha = val;
+}
+
+// Sets the overall alpha scale factor (all alpha values are scaled by this value)
+// usefull for motion blur effect
+void rend_SetAlphaFactor(float val)
+{
+	if (val < 0.0f) val = 0.0f;
+	if (val > 1.0f) val = 1.0f;
+	NullRend_alpha_factor = val;
+}
+
+// Returns the current Alpha factor
+float rend_GetAlphaFactor(void)
+{
+	return NullRend_alpha_factor;
+}
+
+// Sets the texture wrapping type
+void rend_SetWrapType(wrap_type val)
+{
+	if (val != NullRend_state.cur_wrap_type)
+		NullRend_LogState(RSTATE_WRAP_TYPE, val);
+	NullRend_state.cur_wrap_type = val;
+}
+
+// Sets the hardware bias level for coplanar polygons
+void rend_SetCoplanarPolygonOffset(float factor)
+{
+	NullRend_FlushBatch(RBF_STATE);
+}
+
+// Sets where the software renderer should write to
+void rend_SetSoftwareParameters(float aspect, int width, int height, int pitch, ubyte* framebuffer)
+{
+}
+
+// Sets the argb characteristics of the font characters.  color1 is the upper left and proceeds clockwise
+void rend_SetCharacterParameters(ddgr_color color1, ddgr_color color2, ddgr_color color3, ddgr_color color4)
+{
+}
+
+// Clears the display to a specified color
+void rend_ClearScreen(ddgr_color color)
+{
+	NullRend_FlushBatch(RBF_FRAME);
+	NullRend_AddCommand(RCMD_CLEAR, 0, 0, color);
+}
+
+// Clears the zbuffer for the screen
+void rend_ClearZBuffer(void)
+{
+	NullRend_FlushBatch(RBF_FRAME);
+	NullRend_AddCommand(RCMD_CLEAR, 0, 0, -1);
+}
+
+// Fills a rectangle on the display
+void rend_FillRect(ddgr_color color, int x1, int y1, int x2, int y2)
+{
+	NullRend_FlushBatch(RBF_FRAME);
+	NullRend_AddCommand(RCMD_FILL_RECT, 0, 0, color);
+}
+
+// Sets a pixel on the display
+void rend_SetPixel(ddgr_color color, int x, int y)
+{
+}
+
+// Gets a pixel from the display. There's no display, so it's always black
+ddgr_color rend_GetPixel(int x, int y)
+{
+	NullRend_FlushBatch(RBF_FRAME);
+	return 0;
+}
+
+void rend_FillCircle(ddgr_color col, int x, int y, int rad)
+{
+}
+
+void rend_DrawCircle(int x, int y, int rad)
+{
+}
+
+// Draws a line
+void rend_DrawLine(int x1, int y1, int x2, int y2)
+{
+	NullRend_AddCommand(RCMD_DRAW_LINE, 0, 2, 0);
+}
+
+// Draws a line using the states of the renderer
+void rend_DrawSpecialLine(g3Point* p0, g3Point* p1)
+{
+	NullRend_AddCommand(RCMD_DRAW_LINE, 0, 2, 0);
+}
+
+// Gets a pointer to a linear frame buffer
+void rend_GetLFBLock(renderer_lfb* lfb)
+{
+}
+
+// Releases an lfb lock
+void rend_ReleaseLFBLock(renderer_lfb* lfb)
+{
+}
+
+// Given a source x,y and width,height, draws any sized bitmap into the renderer lfb
+void rend_DrawLFBBitmap(int sx, int sy, int w, int h, int dx, int dy, ushort* data, int rowsize)
+{
+}
+
+// Takes a screenshot of the current frame and puts it into the handle passed
+void rend_Screenshot(int bm_handle)
+{
+	NullRend_FlushBatch(RBF_FRAME);
+	memset(bm_data(bm_handle, 0), 0, bm_w(bm_handle, 0) * bm_h(bm_handle, 0) * sizeof(ushort));
+}
+
+// Returns the aspect ratio of the physical screen
+void rend_GetProjectionParameters(int* width, int* height)
+{
+	*width = NullRend_state.clip_x2 - NullRend_state.clip_x1;
+	*height = NullRend_state.clip_y2 - NullRend_state.clip_y1;
+}
+
+void rend_GetProjectionScreenParameters(int& screenLX, int& screenTY, int& screenW, int& screenH)
+{
+	screenLX = NullRend_state.clip_x1;
+	screenTY = NullRend_state.clip_y1;
+	screenW = NullRend_state.clip_x2 - NullRend_state.clip_x1 + 1;
+	screenH = NullRend_state.clip_y2 - NullRend_state.clip_y1 + 1;
+}
+
+// Returns the aspect ratio of the physical screen
+float rend_GetAspectRatio(void)
+{
+	return (float)((3.0f * NullRend_state.screen_width) / (4.0f * NullRend_state.screen_height));
+}
+
+// Fills in the passed in pointer with the current rendering state
+void rend_GetRenderState(rendering_state* rstate)
+{
+	memcpy(rstate, &NullRend_state, sizeof(rendering_state));
+}
+
+// Retrieves an error message
+char* rend_GetErrorMessage()
+{
+	return (char*)Renderer_error_message;
+}
+
+// Sets an error message
+void rend_SetErrorMessage(char* str)
+{
+	ASSERT(strlen(str) < 256);
+	strcpy(Renderer_error_message, str);
+}
+
+// Returns 1 if there is mid video memory, 2 if there is low vid memory, or 0 if there is large vid memory
+int rend_LowVidMem(void)
+{
+	return 0;
+}
+
+// Returns 1 if the renderer supports bumpmapping
+int rend_SupportsBumpmapping(void)
+{
+	return 0;
+}
+
+// Sets a bumpmap to be rendered, or turns off bumpmapping altogether
+void rend_SetBumpmapReadyState(int state, int map)
+{
+}
+
+// Preuploads a texture to the video card
+void rend_PreUploadTextureToCard(int handle, int map_type)
+{
+}
+
+// Frees an uploaded texture from the video card
+void rend_FreePreUploadedTexture(int handle, int map_type)
+{
+}
+
+void rend_ResetCache(void)
+{
+	mprintf((0, "Resetting texture cache!\n"));
+	NullRend_ClearCache();
+}
+
+// returns the direct draw object
+void* rend_RetrieveDirectDrawObj(void** frontsurf, void** backsurf)
+{
+	*frontsurf = NULL;
+	*backsurf = NULL;
+	return NULL;
+}
+
+// Takes a bitmap and blits it to the screen using linear frame buffer stuff
+void rend_CopyBitmapToFramebuffer(int bm_handle, int x, int y)
+{
+	rend_DrawSimpleBitmap(bm_handle, x, y);
+}
+
+// Gets a renderer ready for a framebuffer copy, or stops a framebuffer copy
+void rend_SetFrameBufferCopyState(bool state)
+{
+}
+
+void rend_UpdateCommon(float* projection, float* modelview)
+{
+	NullRend_FlushBatch(RBF_EXTERNAL);
+}
+
+void rend_UseShaderTest(void)
+{
+	NullRend_FlushBatch(RBF_EXTERNAL);
+}
+
+void rend_EndShaderTest(void)
+{
+	NullRend_FlushBatch(RBF_EXTERNAL);
+}
+
+void rend_TransformSetToPassthru(void)
+{
+}
+
+void rend_TransformSetViewport(int lx, int ty, int width, int height)
+{
+}
+
+void rend_TransformSetProjection(float trans[4][4])
+{
+}
+
+void rend_TransformSetModelView(float trans[4][4])
+{
+}
+
+//Meshes only keep their batch ranges, there's nothing to upload the vertices to.
+MeshBuilder::MeshBuilder()
+{
+	m_handle = m_verthandle = m_indexhandle = 0;
+}
+
+void MeshBuilder::UpdateLastBatch()
+{
+	if (m_interactions.empty())
+		return;
+
+	MeshBatch& lastbatch = m_interactions.back();
+	lastbatch.vertexcount = m_vertices.size() - lastbatch.vertexoffset;
+	lastbatch.indexcount = m_indicies.size() - lastbatch.indexoffset;
+}
+
+void MeshBuilder::StartBatchSolid()
+{
+	StartBatchTwoTex(-1, -1);
+}
+
+void MeshBuilder::StartBatchOneTex(int handle)
+{
+	StartBatchTwoTex(handle, -1);
+}
+
+void MeshBuilder::StartBatchTwoTex(int handle, int handle2)
+{
+	UpdateLastBatch();
+
+	MeshBatch batch;
+	batch.primaryhandle = handle;
+	batch.secondaryhandle = handle2;
+	batch.vertexoffset = m_vertices.size();
+	batch.vertexcount = 0;
+	batch.indexoffset = m_indicies.size();
+	batch.indexcount = 0;
+	m_interactions.push_back(batch);
+}
+
+void MeshBuilder::SetVertices(int numverts, RendVertex* vertices)
+{
+	m_vertices.insert(m_vertices.end(), vertices, vertices + numverts);
+}
+
+void MeshBuilder::SetIndicies(int numindices, short* indicies)
+{
+	m_indicies.insert(m_indicies.end(), indicies, indicies + numindices);
+}
+
+void MeshBuilder::Build()
+{
+	UpdateLastBatch();
+
+	m_handle = 1;
+	m_indexhandle = m_indicies.empty() ? 0 : 1;
+
+	m_vertices.clear();
+	m_indicies.clear();
+}
+
+void MeshBuilder::Destroy()
+{
+	m_handle = m_verthandle = m_indexhandle = 0;
+
+	m_vertices.clear();
+	m_indicies.clear();
+	m_interactions.clear();
+}
+
+void MeshBuilder::Draw() const
+{
+	NullRend_FlushBatch(RBF_EXTERNAL);
+
+	for (const MeshBatch& batch : m_interactions)
+	{
+		if (batch.primaryhandle >= 0)
+			NullRend_MakeBitmapCurrent(batch.primaryhandle, MAP_TYPE_BITMAP, 0);
+		if (batch.secondaryhandle >= 0)
+			NullRend_MakeBitmapCurrent(batch.secondaryhandle, MAP_TYPE_LIGHTMAP, 1);
+
+		NullRend_AddCommand(RCMD_DRAW_MESH, 0, m_indexhandle ? batch.indexcount : batch.vertexcount, batch.primaryhandle);
+	}
+}
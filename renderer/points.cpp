@@ -19,6 +19,17 @@
 #include "HardwareInternal.h"
 #include <string.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define POINTS_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef POINTS_SSE2
+const char *Point_array_kernels = "SSE2";
+#else
+const char *Point_array_kernels = "scalar";
+#endif
+
 extern vector Clip_plane_point;
 //code a point.  fills in the p3_codes field of the point, and returns the codes
 ubyte g3_CodePoint(g3Point *p)
@@ -91,6 +102,181 @@ void g3_ProjectPoint(g3Point *p)
 	p->p3_flags |= PF_PROJECTED;
 }
 
+#ifdef POINTS_SSE2
+//codes four rotated points at once.  does the same compares as g3_CodePoint(), in the same order,
+//so the codes come out the same
+static inline void CodePoints4(__m128 x,__m128 y,__m128 z,ubyte *codes)
+{
+	__m128 neg_z = _mm_xor_ps(z,_mm_set1_ps(-0.0f));
+
+	int right_mask = _mm_movemask_ps(_mm_cmpgt_ps(x,z));
+	int top_mask = _mm_movemask_ps(_mm_cmpgt_ps(y,z));
+	int left_mask = _mm_movemask_ps(_mm_cmplt_ps(x,neg_z));
+	int bot_mask = _mm_movemask_ps(_mm_cmplt_ps(y,neg_z));
+	int behind_mask = _mm_movemask_ps(_mm_cmplt_ps(z,_mm_setzero_ps()));
+	int far_mask = _mm_movemask_ps(_mm_cmpgt_ps(z,_mm_set1_ps(Far_clip_z)));
+	int custom_mask = 0;
+
+	if (Clip_custom)
+	{
+		__m128 vx = _mm_div_ps(_mm_sub_ps(x,_mm_set1_ps(Clip_plane_point.x)),_mm_set1_ps(Matrix_scale.x));
+		__m128 vy = _mm_div_ps(_mm_sub_ps(y,_mm_set1_ps(Clip_plane_point.y)),_mm_set1_ps(Matrix_scale.y));
+		__m128 vz = _mm_div_ps(_mm_sub_ps(z,_mm_set1_ps(Clip_plane_point.z)),_mm_set1_ps(Matrix_scale.z));
+
+		__m128 dp = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx,_mm_set1_ps(Clip_plane.x)),_mm_mul_ps(vy,_mm_set1_ps(Clip_plane.y))),_mm_mul_ps(vz,_mm_set1_ps(Clip_plane.z)));
+		custom_mask = _mm_movemask_ps(_mm_cmplt_ps(dp,_mm_set1_ps(-0.005f)));
+	}
+
+	for (int i=0;i<4;i++)
+	{
+		ubyte cc=0;
+
+		if (right_mask & (1<<i))
+			cc |= CC_OFF_RIGHT;
+		if (top_mask & (1<<i))
+			cc |= CC_OFF_TOP;
+		if (left_mask & (1<<i))
+			cc |= CC_OFF_LEFT;
+		if (bot_mask & (1<<i))
+			cc |= CC_OFF_BOT;
+		if (behind_mask & (1<<i))
+			cc |= CC_BEHIND;
+		if (far_mask & (1<<i))
+			cc |= CC_OFF_FAR;
+		if (custom_mask & (1<<i))
+			cc |= CC_OFF_CUSTOM;
+
+		codes[i] = cc;
+	}
+}
+#endif
+
+//rotates and codes an array of points, four at a time.  dest[i] is the rotated src[i].  the
+//points are not projected.  gives the same results as calling g3_RotatePoint() on each.
+void g3_RotatePointArray(g3Point *dest,vector *src,int num)
+{
+	int i=0;
+
+#ifdef POINTS_SSE2
+	__m128 view_x = _mm_set1_ps(View_position.x);
+	__m128 view_y = _mm_set1_ps(View_position.y);
+	__m128 view_z = _mm_set1_ps(View_position.z);
+
+	__m128 rvec_x = _mm_set1_ps(View_matrix.rvec.x), rvec_y = _mm_set1_ps(View_matrix.rvec.y), rvec_z = _mm_set1_ps(View_matrix.rvec.z);
+	__m128 uvec_x = _mm_set1_ps(View_matrix.uvec.x), uvec_y = _mm_set1_ps(View_matrix.uvec.y), uvec_z = _mm_set1_ps(View_matrix.uvec.z);
+	__m128 fvec_x = _mm_set1_ps(View_matrix.fvec.x), fvec_y = _mm_set1_ps(View_matrix.fvec.y), fvec_z = _mm_set1_ps(View_matrix.fvec.z);
+
+	for (;i+4<=num;i+=4)
+	{
+		vector *s = &src[i];
+		float rot_x[4],rot_y[4],rot_z[4];
+		ubyte codes[4];
+
+		// Offset from the viewer, with x, y and z in separate registers
+		__m128 x = _mm_sub_ps(_mm_setr_ps(s[0].x,s[1].x,s[2].x,s[3].x),view_x);
+		__m128 y = _mm_sub_ps(_mm_setr_ps(s[0].y,s[1].y,s[2].y,s[3].y),view_y);
+		__m128 z = _mm_sub_ps(_mm_setr_ps(s[0].z,s[1].z,s[2].z,s[3].z),view_z);
+
+		// Rotate by the view matrix
+		__m128 rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x,rvec_x),_mm_mul_ps(y,rvec_y)),_mm_mul_ps(z,rvec_z));
+		__m128 ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x,uvec_x),_mm_mul_ps(y,uvec_y)),_mm_mul_ps(z,uvec_z));
+		__m128 rz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x,fvec_x),_mm_mul_ps(y,fvec_y)),_mm_mul_ps(z,fvec_z));
+
+		CodePoints4(rx,ry,rz,codes);
+
+		_mm_storeu_ps(rot_x,rx);
+		_mm_storeu_ps(rot_y,ry);
+		_mm_storeu_ps(rot_z,rz);
+
+		for (int t=0;t<4;t++)
+		{
+			g3Point *p = &dest[i+t];
+
+			p->p3_vecPreRot = s[t];
+			p->p3_x = rot_x[t];
+			p->p3_y = rot_y[t];
+			p->p3_z = rot_z[t];
+			p->p3_flags = PF_ORIGPOINT;
+			p->p3_codes = codes[t];
+		}
+	}
+#endif
+
+	for (;i<num;i++)
+		g3_RotatePoint(&dest[i],&src[i]);
+}
+
+//codes a list of points that have already been rotated, four at a time.  gives the same
+//results as calling g3_CodePoint() on each.
+void g3_CodePointList(int nv,g3Point **pointlist)
+{
+	int i=0;
+
+#ifdef POINTS_SSE2
+	for (;i+4<=nv;i+=4)
+	{
+		g3Point **p = &pointlist[i];
+		ubyte codes[4];
+
+		__m128 x = _mm_setr_ps(p[0]->p3_x,p[1]->p3_x,p[2]->p3_x,p[3]->p3_x);
+		__m128 y = _mm_setr_ps(p[0]->p3_y,p[1]->p3_y,p[2]->p3_y,p[3]->p3_y);
+		__m128 z = _mm_setr_ps(p[0]->p3_z,p[1]->p3_z,p[2]->p3_z,p[3]->p3_z);
+
+		CodePoints4(x,y,z,codes);
+
+		for (int t=0;t<4;t++)
+			p[t]->p3_codes = codes[t];
+	}
+#endif
+
+	for (;i<nv;i++)
+		g3_CodePoint(pointlist[i]);
+}
+
+//projects an array of points, four at a time.  gives the same results as calling
+//g3_ProjectPoint() on each.
+void g3_ProjectPointArray(g3Point *points,int num)
+{
+	int i=0;
+
+#ifdef POINTS_SSE2
+	__m128 w2 = _mm_set1_ps(Window_w2);
+	__m128 h2 = _mm_set1_ps(Window_h2);
+	__m128d one = _mm_set1_pd(1.0);
+
+	for (;i+4<=num;i+=4)
+	{
+		g3Point *p = &points[i];
+		float sx[4],sy[4];
+
+		__m128 x = _mm_setr_ps(p[0].p3_x,p[1].p3_x,p[2].p3_x,p[3].p3_x);
+		__m128 y = _mm_setr_ps(p[0].p3_y,p[1].p3_y,p[2].p3_y,p[3].p3_y);
+		__m128 z = _mm_setr_ps(p[0].p3_z,p[1].p3_z,p[2].p3_z,p[3].p3_z);
+
+		// 1/z is done in double like g3_ProjectPoint() does it
+		__m128 one_over_z_lo = _mm_cvtpd_ps(_mm_div_pd(one,_mm_cvtps_pd(z)));
+		__m128 one_over_z_hi = _mm_cvtpd_ps(_mm_div_pd(one,_mm_cvtps_pd(_mm_movehl_ps(z,z))));
+		__m128 one_over_z = _mm_movelh_ps(one_over_z_lo,one_over_z_hi);
+
+		_mm_storeu_ps(sx,_mm_add_ps(w2,_mm_mul_ps(x,_mm_mul_ps(w2,one_over_z))));
+		_mm_storeu_ps(sy,_mm_sub_ps(h2,_mm_mul_ps(y,_mm_mul_ps(h2,one_over_z))));
+
+		for (int t=0;t<4;t++)
+		{
+			if (p[t].p3_flags & PF_PROJECTED || p[t].p3_codes & CC_BEHIND)
+				continue;
+
+			p[t].p3_sx = sx[t];
+			p[t].p3_sy = sy[t];
+			p[t].p3_flags |= PF_PROJECTED;
+		}
+	}
+#endif
+
+	for (;i<num;i++)
+		g3_ProjectPoint(&points[i]);
+}
+
 //from a 2d point, compute the vector through that point
 void g3_Point2Vec(vector *v,short sx,short sy)
 {
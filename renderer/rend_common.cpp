@@ -0,0 +1,286 @@
+/*
+* Descent 3: Piccu Engine
+* Copyright (C) 2024 Parallax Software
+* Copyright (C) 2024 SaladBadger
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//Bitmap and font drawing built on top of rend_DrawPolygon3D.
+//Shared by every renderer backend, so nothing in here may touch the graphics API directly.
+
+#include "3d.h"
+#include "renderer.h"
+#include "bitmap.h"
+#include "pserror.h"
+
+// Takes nv vertices and draws the 2D polygon defined by those vertices.
+// Uses bitmap "handle" as a texture
+void rend_DrawPolygon2D(int handle, g3Point** p, int nv)
+{
+	ASSERT(nv < 100);
+	ASSERT(Overlay_type == OT_NONE);
+
+	rend_DrawPolygon3D(handle, p, nv, MAP_TYPE_BITMAP);
+}
+
+// draws a scaled 2d bitmap to our buffer
+void rend_DrawScaledBitmap(int x1, int y1, int x2, int y2,
+	int bm, float u0, float v0, float u1, float v1, int color, float* alphas)
+{
+	g3Point* ptr_pnts[4];
+	g3Point pnts[4];
+	float r, g, b;
+	if (color != -1)
+	{
+		r = GR_COLOR_RED(color) / 255.0;
+		g = GR_COLOR_GREEN(color) / 255.0;
+		b = GR_COLOR_BLUE(color) / 255.0;
+	}
+	for (int i = 0; i < 4; i++)
+	{
+		if (color == -1)
+			pnts[i].p3_l = 1.0;
+		else
+		{
+			pnts[i].p3_r = r;
+			pnts[i].p3_g = g;
+			pnts[i].p3_b = b;
+		}
+		if (alphas)
+		{
+			pnts[i].p3_a = alphas[i];
+		}
+
+		pnts[i].p3_z = 1.0f;
+		pnts[i].p3_flags = PF_PROJECTED;
+	}
+
+	pnts[0].p3_sx = x1;
+	pnts[0].p3_sy = y1;
+	pnts[0].p3_u = u0;
+	pnts[0].p3_v = v0;
+	pnts[1].p3_sx = x2;
+	pnts[1].p3_sy = y1;
+	pnts[1].p3_u = u1;
+	pnts[1].p3_v = v0;
+	pnts[2].p3_sx = x2;
+	pnts[2].p3_sy = y2;
+	pnts[2].p3_u = u1;
+	pnts[2].p3_v = v1;
+	pnts[3].p3_sx = x1;
+	pnts[3].p3_sy = y2;
+	pnts[3].p3_u = u0;
+	pnts[3].p3_v = v1;
+	ptr_pnts[0] = &pnts[0];
+	ptr_pnts[1] = &pnts[1];
+	ptr_pnts[2] = &pnts[2];
+	ptr_pnts[3] = &pnts[3];
+	rend_SetTextureType(TT_LINEAR);
+	rend_DrawPolygon2D(bm, ptr_pnts, 4);
+}
+
+void rend_DrawScaledBitmapWithZ(int x1, int y1, int x2, int y2,
+	int bm, float u0, float v0, float u1, float v1, float zval, int color, float* alphas)
+{
+	g3Point* ptr_pnts[4];
+	g3Point pnts[4];
+	float r, g, b;
+
+	if (color != -1)
+	{
+		r = GR_COLOR_RED(color) / 255.0;
+		g = GR_COLOR_GREEN(color) / 255.0;
+		b = GR_COLOR_BLUE(color) / 255.0;
+	}
+
+	for (int i = 0; i < 4; i++)
+	{
+		if (color == -1)
+			pnts[i].p3_l = 1.0;
+		else
+		{
+			pnts[i].p3_r = r;
+			pnts[i].p3_g = g;
+			pnts[i].p3_b = b;
+		}
+
+		if (alphas)
+		{
+			pnts[i].p3_a = alphas[i];
+		}
+
+		pnts[i].p3_z = zval;
+		pnts[i].p3_flags = PF_PROJECTED;
+	}
+
+
+
+	pnts[0].p3_sx = x1;
+	pnts[0].p3_sy = y1;
+	pnts[0].p3_u = u0;
+	pnts[0].p3_v = v0;
+
+	pnts[1].p3_sx = x2;
+	pnts[1].p3_sy = y1;
+	pnts[1].p3_u = u1;
+	pnts[1].p3_v = v0;
+
+	pnts[2].p3_sx = x2;
+	pnts[2].p3_sy = y2;
+	pnts[2].p3_u = u1;
+	pnts[2].p3_v = v1;
+
+	pnts[3].p3_sx = x1;
+	pnts[3].p3_sy = y2;
+	pnts[3].p3_u = u0;
+	pnts[3].p3_v = v1;
+
+	ptr_pnts[0] = &pnts[0];
+	ptr_pnts[1] = &pnts[1];
+	ptr_pnts[2] = &pnts[2];
+	ptr_pnts[3] = &pnts[3];
+
+	rend_SetTextureType(TT_LINEAR);
+	rend_DrawPolygon3D(bm, ptr_pnts, 4);
+}
+
+// Sets up a font character to draw.  We draw our fonts as pieces of textures
+void rend_DrawFontCharacter(int bm_handle, int x1, int y1, int x2, int y2, float u, float v, float w, float h)
+{
+	g3Point* ptr_pnts[4];
+	g3Point pnts[4];
+	for (int i = 0; i < 4; i++)
+	{
+		pnts[i].p3_z = 1;	// Make REALLY close!
+		pnts[i].p3_flags = PF_PROJECTED;
+		ptr_pnts[i] = &pnts[i];
+	}
+	pnts[0].p3_sx = x1;
+	pnts[0].p3_sy = y1;
+	pnts[0].p3_u = u;
+	pnts[0].p3_v = v;
+	pnts[1].p3_sx = x2;
+	pnts[1].p3_sy = y1;
+	pnts[1].p3_u = u + w;
+	pnts[1].p3_v = v;
+	pnts[2].p3_sx = x2;
+	pnts[2].p3_sy = y2;
+	pnts[2].p3_u = u + w;
+	pnts[2].p3_v = v + h;
+	pnts[3].p3_sx = x1;
+	pnts[3].p3_sy = y2;
+	pnts[3].p3_u = u;
+	pnts[3].p3_v = v + h;
+	rend_DrawPolygon2D(bm_handle, ptr_pnts, 4);
+}
+
+//	given a chunked bitmap, renders it.
+void rend_DrawChunkedBitmap(chunked_bitmap* chunk, int x, int y, ubyte alpha)
+{
+	int* bm_array = chunk->bm_array;
+	int w = chunk->w;
+	int h = chunk->h;
+	int piece_w = bm_w(bm_array[0], 0);
+	int piece_h = bm_h(bm_array[0], 0);
+	int screen_w, screen_h;
+	int i, t;
+	rend_SetZBufferState(0);
+	rend_GetProjectionParameters(&screen_w, &screen_h);
+	for (i = 0; i < h; i++)
+	{
+		for (t = 0; t < w; t++)
+		{
+			int dx = x + (piece_w * t);
+			int dy = y + (piece_h * i);
+			int dw, dh;
+			if ((dx + piece_w) > screen_w)
+				dw = piece_w - ((dx + piece_w) - screen_w);
+			else
+				dw = piece_w;
+			if ((dy + piece_h) > screen_h)
+				dh = piece_h - ((dy + piece_h) - screen_h);
+			else
+				dh = piece_h;
+
+			float u2 = (float)dw / (float)piece_w;
+			float v2 = (float)dh / (float)piece_h;
+			rend_DrawSimpleBitmap(bm_array[i * w + t], dx, dy);
+		}
+	}
+	rend_SetZBufferState(1);
+}
+
+//	given a chunked bitmap, renders it.scaled
+void rend_DrawScaledChunkedBitmap(chunked_bitmap* chunk, int x, int y, int neww, int newh, ubyte alpha)
+{
+	int* bm_array = chunk->bm_array;
+	int w = chunk->w;
+	int h = chunk->h;
+	int piece_w;
+	int piece_h;
+	int screen_w, screen_h;
+	int i, t;
+
+	float scalew, scaleh;
+
+	scalew = ((float)neww) / ((float)chunk->pw);
+	scaleh = ((float)newh) / ((float)chunk->ph);
+	piece_w = scalew * ((float)bm_w(bm_array[0], 0));
+	piece_h = scaleh * ((float)bm_h(bm_array[0], 0));
+	rend_GetProjectionParameters(&screen_w, &screen_h);
+	rend_SetOverlayType(OT_NONE);
+	rend_SetLighting(LS_NONE);
+	rend_SetColorModel(CM_MONO);
+	rend_SetZBufferState(0);
+	rend_SetAlphaType(AT_CONSTANT_TEXTURE);
+	rend_SetAlphaValue(alpha);
+	rend_SetWrapType(WT_WRAP);
+	for (i = 0; i < h; i++)
+	{
+		for (t = 0; t < w; t++)
+		{
+			int dx = x + (piece_w * t);
+			int dy = y + (piece_h * i);
+			int dw, dh;
+			if ((dx + piece_w) > screen_w)
+				dw = piece_w - ((dx + piece_w) - screen_w);
+			else
+				dw = piece_w;
+			if ((dy + piece_h) > screen_h)
+				dh = piece_h - ((dy + piece_h) - screen_h);
+			else
+				dh = piece_h;
+
+			float u2 = (float)dw / (float)piece_w;
+			float v2 = (float)dh / (float)piece_h;
+			rend_DrawScaledBitmap(dx, dy, dx + dw, dy + dh, bm_array[i * w + t], 0, 0, u2, v2);
+
+		}
+	}
+	rend_SetZBufferState(1);
+}
+
+// Draws a simple bitmap at the specified x,y location
+void rend_DrawSimpleBitmap(int bm_handle, int x, int y)
+{
+	rend_SetAlphaType(AT_CONSTANT_TEXTURE);
+	rend_SetAlphaValue(255);
+	rend_SetLighting(LS_NONE);
+	rend_SetColorModel(CM_MONO);
+	rend_SetOverlayType(OT_NONE);
+	rend_SetFiltering(0);
+	rend_DrawScaledBitmap(x, y, x + bm_w(bm_handle, 0), y + bm_h(bm_handle, 0), bm_handle, 0, 0, 1, 1);
+	rend_SetFiltering(1);
+}
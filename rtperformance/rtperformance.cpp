@@ -55,6 +55,7 @@
 
 
 #if defined(WIN32)
+#define NOMINMAX
 #include <windows.h>
 #endif
 
@@ -69,6 +70,13 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stddef.h>
+#include <vector>
+#include <algorithm>
+
+#if defined(__LINUX__)
+#include <chrono>
+#endif
 
 
 float rtp_startlog_time;
@@ -87,6 +95,73 @@ unsigned char Runtime_performance_enabled = 0;
 tRTFrameInfo RTP_SingleFrame;
 #ifdef USE_RTP
 tRTFrameInfo RTP_FrameBuffer[MAX_RTP_SAMPLES];
+
+// frames recorded since rtp_StartBenchmark, these aren't limited to MAX_RTP_SAMPLES
+bool Runtime_performance_benchmark = false;
+std::vector<tRTFrameInfo> RTP_BenchmarkFrames;
+
+// Counters written out by a benchmark
+#define RTPF_CLOCK	0	// INT64 clock time, written in milliseconds
+#define RTPF_INT	1
+#define RTPF_SECONDS	2	// float time in seconds, written in milliseconds
+
+typedef struct
+{
+	const char *name;
+	int offset;
+	int type;
+}tRTPField;
+
+#define RTP_FIELD(member,type) {#member,offsetof(tRTFrameInfo,member),type}
+
+tRTPField RTP_BenchmarkFields[] = 
+{
+	RTP_FIELD(frame_time,RTPF_SECONDS),
+	RTP_FIELD(renderframe_time,RTPF_CLOCK),
+	RTP_FIELD(multiframe_time,RTPF_CLOCK),
+	RTP_FIELD(musicframe_time,RTPF_CLOCK),
+	RTP_FIELD(ambsound_frame_time,RTPF_CLOCK),
+	RTP_FIELD(weatherframe_time,RTPF_CLOCK),
+	RTP_FIELD(playerframe_time,RTPF_CLOCK),
+	RTP_FIELD(doorframe_time,RTPF_CLOCK),
+	RTP_FIELD(levelgoal_time,RTPF_CLOCK),
+	RTP_FIELD(matcenframe_time,RTPF_CLOCK),
+	RTP_FIELD(objframe_time,RTPF_CLOCK),
+	RTP_FIELD(aiframeall_time,RTPF_CLOCK),
+	RTP_FIELD(processkeys_time,RTPF_CLOCK),
+	RTP_FIELD(normalevent_time,RTPF_CLOCK),
+	RTP_FIELD(ct_flying_time,RTPF_CLOCK),
+	RTP_FIELD(ct_aidoframe_time,RTPF_CLOCK),
+	RTP_FIELD(ct_weaponframe_time,RTPF_CLOCK),
+	RTP_FIELD(ct_explosionframe_time,RTPF_CLOCK),
+	RTP_FIELD(ct_debrisframe_time,RTPF_CLOCK),
+	RTP_FIELD(ct_splinterframe_time,RTPF_CLOCK),
+	RTP_FIELD(mt_physicsframe_time,RTPF_CLOCK),
+	RTP_FIELD(mt_walkingframe_time,RTPF_CLOCK),
+	RTP_FIELD(mt_shockwave_time,RTPF_CLOCK),
+	RTP_FIELD(obj_doeffect_time,RTPF_CLOCK),
+	RTP_FIELD(obj_move_player_time,RTPF_CLOCK),
+	RTP_FIELD(obj_d3xint_time,RTPF_CLOCK),
+	RTP_FIELD(obj_objlight_time,RTPF_CLOCK),
+	RTP_FIELD(cycle_anim,RTPF_CLOCK),
+	RTP_FIELD(vis_eff_move,RTPF_CLOCK),
+	RTP_FIELD(phys_link,RTPF_CLOCK),
+	RTP_FIELD(obj_do_frm,RTPF_CLOCK),
+	RTP_FIELD(fvi_time,RTPF_CLOCK),
+	RTP_FIELD(texture_uploads,RTPF_INT),
+	RTP_FIELD(polys_drawn,RTPF_INT),
+	RTP_FIELD(fvi_calls,RTPF_INT),
+	RTP_FIELD(pose_cache_hits,RTPF_INT),
+	RTP_FIELD(pose_cache_misses,RTPF_INT),
+	RTP_FIELD(ai_vis_batch_hits,RTPF_INT),
+	RTP_FIELD(ai_vis_batch_misses,RTPF_INT),
+};
+
+#define NUM_RTP_BENCHMARK_FIELDS	((int)(sizeof(RTP_BenchmarkFields)/sizeof(tRTPField)))
+
+// Percentiles written in a benchmark's summary
+int RTP_BenchmarkPercentiles[] = {50,90,95,99};
+#define NUM_RTP_PERCENTILES	((int)(sizeof(RTP_BenchmarkPercentiles)/sizeof(int)))
 #endif
 
 
@@ -104,7 +179,7 @@ void rtp_WriteBufferLog(void)
 	unsigned int counter;
 	char buffer[4096];
 
-	Num_frames = min(Runtime_performance_counter,MAX_RTP_SAMPLES);
+	Num_frames = (Runtime_performance_counter < MAX_RTP_SAMPLES) ? Runtime_performance_counter : MAX_RTP_SAMPLES;
 
 	// Open the log file for writing
 	ddio_MakePath(buffer,User_directory,"D3Performance.txt",NULL);	
@@ -113,7 +188,7 @@ void rtp_WriteBufferLog(void)
 	if(file){
 		mprintf((0,"RTP: Recording Log\n"));
 
-		strcpy(buffer,"FrameNum,FrameTime,RenderFrameTime,MultiFrameTime,MusicFrameTime,AmbientSoundTime,WeatherFrameTime,PlayerFrameTime,DoorwayFrameTime,LevelGoalFrameTime,MatCenFrameTime,ObjectFrameTime,AIFrameAllTime,ProcessKeysTime,REN:NumTexturesUploaded,REN:PolysDrawn,OBJ:CT_FlyingTime,OBJ:CT_AIDoFrameTime,OBJ:CT_WeaponFrameTime,OBJ:CT_ExplosionFrameTime,OBJ:CT_DebrisFrameTime,OBJ:CT_SplinterFrameTime,OBJ:MT_PhsyicsFrameTime,OBJ:MT_WalkingFrame,OBJ:MT_ShockWaveTime,OBJ:DoEffectTime,OBJ:MovePlayerTime,OBJ:D3XIntervalTime,OBJ:ObjLightTime,FRAME:NormalEventTime,AnimCycle,VisEffectMoveAll,DoPhysLinkedFrame,ObjDoFrame,NumFVICalls,FVITime");
+		strcpy(buffer,"FrameNum,FrameTime,RenderFrameTime,MultiFrameTime,MusicFrameTime,AmbientSoundTime,WeatherFrameTime,PlayerFrameTime,DoorwayFrameTime,LevelGoalFrameTime,MatCenFrameTime,ObjectFrameTime,AIFrameAllTime,ProcessKeysTime,REN:NumTexturesUploaded,REN:PolysDrawn,OBJ:CT_FlyingTime,OBJ:CT_AIDoFrameTime,OBJ:CT_WeaponFrameTime,OBJ:CT_ExplosionFrameTime,OBJ:CT_DebrisFrameTime,OBJ:CT_SplinterFrameTime,OBJ:MT_PhsyicsFrameTime,OBJ:MT_WalkingFrame,OBJ:MT_ShockWaveTime,OBJ:DoEffectTime,OBJ:MovePlayerTime,OBJ:D3XIntervalTime,OBJ:ObjLightTime,FRAME:NormalEventTime,AnimCycle,VisEffectMoveAll,DoPhysLinkedFrame,ObjDoFrame,NumFVICalls,FVITime,NumPoseCacheHits,NumPoseCacheMisses,NumAIVisBatchHits,NumAIVisBatchMisses");
 		cf_WriteString(file,buffer);
 
 		// Loop through all the frames, and write out the data for each frame
@@ -183,13 +258,14 @@ void rtp_WriteBufferLog(void)
 			RTP_CLOCKSECONDS(fi->obj_do_frm,obj_do_frm);
 			RTP_CLOCKSECONDS(fi->fvi_time,fvi_time);
 
-			sprintf(buffer,"%d,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%d,%d,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f %d %f",(int)fi->frame_num,fi->frame_time,
+			sprintf(buffer,"%d,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%d,%d,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%d,%f,%d,%d,%d,%d",(int)fi->frame_num,fi->frame_time,
 				renderframe_time,multiframe_time,musicframe_time,ambsound_frame_time,weatherframe_time,
 				playerframe_time,doorframe_time,levelgoal_time,matcenframe_time,objframe_time,aiframeall_time,
 				processkeys_time,fi->texture_uploads,fi->polys_drawn,ct_flying_time,ct_aidoframe_time,ct_weaponframe_time,
 				ct_explosionframe_time,ct_debrisframe_time,ct_splinterframe_time,mt_physicsframe_time,mt_walkingframe_time,
 				mt_shockwave_time,obj_doeffect_time,obj_move_player_time,obj_d3xint_time,obj_objlight_time,normalevent_time,cycle_anim,
-				vis_eff_move,phys_link,obj_do_frm,fi->fvi_calls,fi->fvi_time);
+				vis_eff_move,phys_link,obj_do_frm,fi->fvi_calls,fvi_time,fi->pose_cache_hits,fi->pose_cache_misses,
+				fi->ai_vis_batch_hits,fi->ai_vis_batch_misses);
 			
 			
 			cf_WriteString(file,buffer);
@@ -202,6 +278,208 @@ void rtp_WriteBufferLog(void)
 #endif
 }
 
+#ifdef USE_RTP
+// returns the value of a field of a frame, with times converted to milliseconds
+double rtp_GetFieldValue(tRTFrameInfo *fi,tRTPField *field)
+{
+	ubyte *data = (ubyte *)fi + field->offset;
+
+	switch(field->type){
+	case RTPF_CLOCK:
+		return ((double)*(INT64 *)data)*1000.0/((double)Runtime_performance_clockfreq);
+	case RTPF_SECONDS:
+		return *(float *)data * 1000.0;
+	default:
+		return *(int *)data;
+	}
+}
+
+// writes a value of a field, so counts don't get written with decimals
+void rtp_WriteFieldValue(CFILE *file,tRTPField *field,double value)
+{
+	if(field->type==RTPF_INT)
+		cfprintf(file,"%d",(int)value);
+	else
+		cfprintf(file,"%.4f",value);
+}
+
+typedef struct
+{
+	double min,max,avg;
+	double percentiles[NUM_RTP_PERCENTILES];
+}tRTPFieldSummary;
+
+// Works out the min, max, average and percentiles of a field over all the recorded frames
+void rtp_SummarizeField(tRTPField *field,tRTPFieldSummary *summary)
+{
+	int num_frames = RTP_BenchmarkFrames.size();
+	std::vector<double> values(num_frames);
+	double total = 0;
+	int i;
+
+	for(i=0;i<num_frames;i++){
+		values[i] = rtp_GetFieldValue(&RTP_BenchmarkFrames[i],field);
+		total += values[i];
+	}
+	std::sort(values.begin(),values.end());
+
+	summary->min = values[0];
+	summary->max = values[num_frames-1];
+	summary->avg = total/num_frames;
+
+	// nearest rank
+	for(i=0;i<NUM_RTP_PERCENTILES;i++){
+		int rank = (RTP_BenchmarkPercentiles[i]*num_frames+99)/100;
+		summary->percentiles[i] = values[(rank > 0) ? (rank - 1) : 0];
+	}
+}
+
+void rtp_WriteBenchmarkJSON(CFILE *file)
+{
+	int num_frames = RTP_BenchmarkFrames.size();
+	int i,f;
+
+	cfprintf(file,"{\n\t\"num_frames\": %d,\n\t\"summary\": {\n",num_frames);
+	for(f=0;f<NUM_RTP_BENCHMARK_FIELDS;f++){
+		tRTPField *field = &RTP_BenchmarkFields[f];
+		tRTPFieldSummary summary;
+		rtp_SummarizeField(field,&summary);
+
+		cfprintf(file,"\t\t\"%s\": {\"min\": %.4f, \"avg\": %.4f",field->name,summary.min,summary.avg);
+		for(i=0;i<NUM_RTP_PERCENTILES;i++)
+			cfprintf(file,", \"p%d\": %.4f",RTP_BenchmarkPercentiles[i],summary.percentiles[i]);
+		cfprintf(file,", \"max\": %.4f}%s\n",summary.max,(f<NUM_RTP_BENCHMARK_FIELDS-1)?",":"");
+	}
+	cfprintf(file,"\t},\n\t\"frames\": [\n");
+
+	for(i=0;i<num_frames;i++){
+		tRTFrameInfo *fi = &RTP_BenchmarkFrames[i];
+		cfprintf(file,"\t\t{\"frame_num\": %d",(int)fi->frame_num);
+		for(f=0;f<NUM_RTP_BENCHMARK_FIELDS;f++){
+			cfprintf(file,", \"%s\": ",RTP_BenchmarkFields[f].name);
+			rtp_WriteFieldValue(file,&RTP_BenchmarkFields[f],rtp_GetFieldValue(fi,&RTP_BenchmarkFields[f]));
+		}
+		cfprintf(file,"}%s\n",(i<num_frames-1)?",":"");
+	}
+	cfprintf(file,"\t]\n}\n");
+}
+
+void rtp_WriteBenchmarkCSV(CFILE *file)
+{
+	int num_frames = RTP_BenchmarkFrames.size();
+	int i,f;
+
+	cfprintf(file,"frame_num");
+	for(f=0;f<NUM_RTP_BENCHMARK_FIELDS;f++)
+		cfprintf(file,",%s",RTP_BenchmarkFields[f].name);
+	cfprintf(file,"\n");
+
+	for(i=0;i<num_frames;i++){
+		tRTFrameInfo *fi = &RTP_BenchmarkFrames[i];
+		cfprintf(file,"%d",(int)fi->frame_num);
+		for(f=0;f<NUM_RTP_BENCHMARK_FIELDS;f++){
+			cfprintf(file,",");
+			rtp_WriteFieldValue(file,&RTP_BenchmarkFields[f],rtp_GetFieldValue(fi,&RTP_BenchmarkFields[f]));
+		}
+		cfprintf(file,"\n");
+	}
+}
+
+void rtp_WriteBenchmarkSummaryCSV(CFILE *file)
+{
+	int i,f;
+
+	cfprintf(file,"counter,min,avg");
+	for(i=0;i<NUM_RTP_PERCENTILES;i++)
+		cfprintf(file,",p%d",RTP_BenchmarkPercentiles[i]);
+	cfprintf(file,",max\n");
+
+	for(f=0;f<NUM_RTP_BENCHMARK_FIELDS;f++){
+		tRTPFieldSummary summary;
+		rtp_SummarizeField(&RTP_BenchmarkFields[f],&summary);
+
+		cfprintf(file,"%s,%.4f,%.4f",RTP_BenchmarkFields[f].name,summary.min,summary.avg);
+		for(i=0;i<NUM_RTP_PERCENTILES;i++)
+			cfprintf(file,",%.4f",summary.percentiles[i]);
+		cfprintf(file,",%.4f\n",summary.max);
+	}
+}
+#endif
+
+/*
+void rtp_StartBenchmark
+	Starts recording every frame until rtp_WriteBenchmark is called.  Unlike rtp_StartLog
+	there is no limit on how many frames are kept
+*/
+void rtp_StartBenchmark(void)
+{
+#ifdef USE_RTP
+	mprintf((0,"RTP: Starting Benchmark\n"));
+	RTP_BenchmarkFrames.clear();
+	RTP_BenchmarkFrames.reserve(MAX_RTP_SAMPLES);
+	Runtime_performance_benchmark = true;
+	Runtime_performance_enabled = 1;
+	memset(&RTP_SingleFrame,0,sizeof(tRTFrameInfo));
+	rtp_startlog_time = timer_GetTime();
+#endif
+}
+
+/*
+bool rtp_WriteBenchmark
+	Stops a benchmark started with rtp_StartBenchmark and writes out every frame it recorded,
+	followed by the min, average, percentiles and max of each counter.
+	Returns false if nothing could be written
+*/
+bool rtp_WriteBenchmark(const char *filename)
+{
+#ifdef USE_RTP
+	Runtime_performance_enabled = 0;
+	Runtime_performance_benchmark = false;
+
+	if(RTP_BenchmarkFrames.empty()){
+		mprintf((0,"RTP: No benchmark frames were recorded\n"));
+		return false;
+	}
+
+	mprintf((0,"RTP: Writing benchmark of %d frames over %f seconds\n",(int)RTP_BenchmarkFrames.size(),timer_GetTime()-rtp_startlog_time));
+
+	const char *ext = strrchr(filename,'.');
+	bool json = (ext && !stricmp(ext,".json"));
+
+	CFILE *file = cfopen(filename,"wt");
+	if(!file){
+		mprintf((0,"RTP: Unable to open %s for writing\n",filename));
+		return false;
+	}
+
+	if(json){
+		rtp_WriteBenchmarkJSON(file);
+		cfclose(file);
+	}else{
+		rtp_WriteBenchmarkCSV(file);
+		cfclose(file);
+
+		char summaryname[_MAX_PATH*2];
+		int baselen = ext?(ext-filename):strlen(filename);
+		snprintf(summaryname,sizeof(summaryname),"%.*s_summary.csv",baselen,filename);
+
+		file = cfopen(summaryname,"wt");
+		if(file){
+			rtp_WriteBenchmarkSummaryCSV(file);
+			cfclose(file);
+		}else
+			mprintf((0,"RTP: Unable to open %s for writing\n",summaryname));
+	}
+
+	RTP_BenchmarkFrames.clear();
+	RTP_BenchmarkFrames.shrink_to_fit();
+	return true;
+#else
+	mprintf((0,"RTP: Benchmarks need a build with USE_RTP\n"));
+	return false;
+#endif
+}
+
 /*
 void rtp_RecordFrame
 	Calling this will record the data of the frame into the internal log, and prepare for
@@ -210,7 +488,12 @@ void rtp_RecordFrame
 void rtp_RecordFrame(void)
 {
 #ifdef USE_RTP
-	if ( Runtime_performance_enabled ){
+	if ( Runtime_performance_enabled && Runtime_performance_benchmark ){
+		RTP_SingleFrame.frame_num = Runtime_performance_frame_counter;
+		RTP_BenchmarkFrames.push_back(RTP_SingleFrame);
+		memset(&RTP_SingleFrame,0,sizeof(tRTFrameInfo));
+	}
+	else if ( Runtime_performance_enabled ){
 		//	do our saving of information
 		// --------------------------------
 
@@ -255,6 +538,8 @@ void rtp_Init(void)
 
 	#ifdef MACINTOSH
 		Runtime_performance_clockfreq = 1000000;	//micoseconds
+	#elif defined(__LINUX__)
+		Runtime_performance_clockfreq = 1000000000;	//nanoseconds
 	#else
 	LARGE_INTEGER freq;
 	if(!QueryPerformanceFrequency(&freq)) {
@@ -279,7 +564,7 @@ void rtp_Close
 void rtp_Close(void)
 {
 #ifdef USE_RTP
-	if (Runtime_performance_enabled) {
+	if (Runtime_performance_enabled && !Runtime_performance_benchmark) {
 		// Save the log out, since it was currently logging
 		rtp_StopLog();
 	}
@@ -316,6 +601,7 @@ void rtp_StartLog(void)
 {
 #ifdef USE_RTP
 	mprintf((0,"RTP: Starting Log\n"));
+	Runtime_performance_benchmark = false;
 	Runtime_performance_counter = 0;
 	Runtime_performance_enabled = 1;
 	memset(&RTP_SingleFrame,0,sizeof(tRTFrameInfo));
@@ -380,6 +666,8 @@ INT64 rtp_GetClock(void)
 		// Get the current time in microseconds
 		Microseconds((UnsignedWide*)(&currentTimeUI));
 		return currentTimeUI;
+	#elif defined(__LINUX__)
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
 	#else
 		LARGE_INTEGER t;
 		QueryPerformanceCounter(&t);
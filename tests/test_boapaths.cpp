@@ -0,0 +1,248 @@
+/*
+* Descent 3
+* Copyright (C) 2024 Parallax Software
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Builds random mines and finds the next room between every pair of rooms with FindPath() one
+// pair at a time and with the path trees on the worker pool, and checks BOA_Array comes out the
+// same.  The mines have rooms that aren't used, one way portals, tied costs, terrain regions and
+// sometimes a negative cost, which makes the path trees fall back on FindPath().
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+#include "tests.h"
+#include "BOA.h"
+#include "room.h"
+#include "terrain.h"
+#include "TaskSystem.h"
+#include "mem.h"
+#include "psrand.h"
+
+#define BOA_TEST_MAX_ROOMS		120
+#define BOA_TEST_REGIONS		3		// Terrain regions 1 and 2 are connected to the mine
+#define BOA_TEST_WORKERS		3
+
+extern bool BOA_f_making_boa;
+
+void clear_BOA();
+void compute_next_segs(bool f_serial);
+
+static unsigned short Serial_array[MAX_ROOMS + MAX_BOA_TERRAIN_REGIONS][MAX_ROOMS + MAX_BOA_TERRAIN_REGIONS];
+
+// Makes a random mine with num_rooms rooms.  Portal costs are small whole numbers if f_ties is
+// set, so lots of paths cost the same.
+static void boa_BuildMine(int num_rooms, bool f_ties, bool f_terrain)
+{
+	int i, j, n;
+
+	Highest_room_index = num_rooms - 1;
+
+	for (i = 0; i < num_rooms; i++)
+	{
+		room *rp = &Rooms[i];
+
+		rp->used = (ps_rand() % 10) != 0;
+		rp->flags = (f_terrain && (ps_rand() % 8) == 0) ? RF_EXTERNAL : 0;
+		rp->num_portals = 0;
+		rp->portals = (portal *)mem_malloc(MAX_PATH_PORTALS * sizeof(portal));
+		rp->faces = (face *)mem_malloc(MAX_PATH_PORTALS * sizeof(face));
+		memset(rp->portals, 0, MAX_PATH_PORTALS * sizeof(portal));
+		memset(rp->faces, 0, MAX_PATH_PORTALS * sizeof(face));
+	}
+
+	int num_links = num_rooms * (1 + ps_rand() % 8) / 2;
+
+	for (n = 0; n < num_links; n++)
+	{
+		int a = ps_rand() % num_rooms;
+		int b = ps_rand() % num_rooms;
+
+		if (a == b || !Rooms[a].used || !Rooms[b].used)
+			continue;
+		if (Rooms[a].num_portals >= MAX_PATH_PORTALS - 1 || Rooms[b].num_portals >= MAX_PATH_PORTALS - 1)
+			continue;
+		if ((Rooms[a].flags & RF_EXTERNAL) && (Rooms[b].flags & RF_EXTERNAL))
+			continue;
+
+		int pa = Rooms[a].num_portals++;
+		int pb = Rooms[b].num_portals++;
+		portal *ap = &Rooms[a].portals[pa];
+		portal *bp = &Rooms[b].portals[pb];
+
+		ap->croom = b;
+		ap->cportal = pb;
+		ap->portal_face = pa;
+		bp->croom = a;
+		bp->cportal = pa;
+		bp->portal_face = pb;
+
+		// Some portals can only be gone through one way
+		if ((ps_rand() % 15) == 0)
+			ap->flags |= PF_BLOCK;
+
+		// Path points are over terrain cell 1 or 2, which are in the regions with the same numbers
+		ap->path_pnt.x = (1 + ps_rand() % 2) * TERRAIN_SIZE + 1.0f;
+		ap->path_pnt.z = 1.0f;
+		bp->path_pnt.x = (1 + ps_rand() % 2) * TERRAIN_SIZE + 1.0f;
+		bp->path_pnt.z = 1.0f;
+	}
+
+	// Connect the terrain regions to the rooms with portals to the outside, like
+	// compute_terrain_region_info() does
+	BOA_num_terrain_regions = f_terrain ? BOA_TEST_REGIONS : 0;
+
+	for (i = 0; i < MAX_BOA_TERRAIN_REGIONS; i++)
+		BOA_num_connect[i] = 0;
+
+	for (i = 0; i < BOA_TEST_REGIONS; i++)
+		Terrain_seg[i].flags = (Terrain_seg[i].flags & ~TFM_REGION_MASK) | (i << 5);
+
+	if (f_terrain)
+	{
+		for (i = 0; i < num_rooms; i++)
+		{
+			if (!Rooms[i].used || (Rooms[i].flags & RF_EXTERNAL))
+				continue;
+
+			for (j = 0; j < Rooms[i].num_portals; j++)
+			{
+				if (!(Rooms[Rooms[i].portals[j].croom].flags & RF_EXTERNAL))
+					continue;
+
+				int region = TERRAIN_REGION(GetTerrainCellFromPos(&Rooms[i].portals[j].path_pnt));
+				if (BOA_num_connect[region] < MAX_PATH_PORTALS)
+				{
+					BOA_connect[region][BOA_num_connect[region]].roomnum = i;
+					BOA_connect[region][BOA_num_connect[region]].portal = j;
+					BOA_num_connect[region]++;
+				}
+			}
+		}
+	}
+
+	for (i = 0; i < MAX_ROOMS + MAX_BOA_TERRAIN_REGIONS; i++)
+	{
+		for (j = 0; j < MAX_PATH_PORTALS; j++)
+			BOA_cost_array[i][j] = 0.5f + (f_ties ? (float)(ps_rand() % 4) : (float)(ps_rand() % 1000) / 7.0f);
+	}
+
+	for (i = num_rooms; i < num_rooms + MAX_BOA_TERRAIN_REGIONS; i++)
+	{
+		for (j = 0; j < MAX_PATH_PORTALS; j++)
+			BOA_cost_array[i][j] = 100000.0f;
+	}
+
+	// Sometimes give a one way portal a negative cost.  It's the only portal between its two rooms,
+	// so there's no way back through it and no loop costs less than nothing.
+	if ((ps_rand() % 4) == 0)
+	{
+		for (n = 0; n < 100; n++)
+		{
+			int a = ps_rand() % num_rooms;
+
+			if (!Rooms[a].used || (Rooms[a].flags & RF_EXTERNAL) || Rooms[a].num_portals == 0)
+				continue;
+
+			int p = ps_rand() % Rooms[a].num_portals;
+			int b = Rooms[a].portals[p].croom;
+			int links = 0;
+
+			if ((Rooms[b].flags & RF_EXTERNAL) || (Rooms[a].portals[p].flags & PF_BLOCK))
+				continue;
+
+			for (j = 0; j < Rooms[a].num_portals; j++)
+				links += (Rooms[a].portals[j].croom == b);
+
+			if (links == 1)
+			{
+				Rooms[b].portals[Rooms[a].portals[p].cportal].flags |= PF_BLOCK;
+				BOA_cost_array[a][p] = -1.0f;
+				break;
+			}
+		}
+	}
+}
+
+static void boa_FreeMine()
+{
+	for (int i = 0; i <= Highest_room_index; i++)
+	{
+		mem_free(Rooms[i].portals);
+		mem_free(Rooms[i].faces);
+		Rooms[i].portals = NULL;
+		Rooms[i].faces = NULL;
+		Rooms[i].num_portals = 0;
+		Rooms[i].used = 0;
+		Rooms[i].flags = 0;
+	}
+
+	Highest_room_index = -1;
+}
+
+int test_BOAPaths(int count)
+{
+	int failures = 0;
+	double serial_time = 0.0, tree_time = 0.0;
+	int n;
+
+	printf("BOA path test: %d random mines\n\n", count);
+
+	task_InitPool(BOA_TEST_WORKERS);
+	ps_srand(1);
+
+	BOA_f_making_boa = true;
+
+	for (n = 0; n < count; n++)
+	{
+		int num_rooms = 2 + ps_rand() % (((n % 10) == 0) ? BOA_TEST_MAX_ROOMS - 1 : 40);
+		bool f_ties = (n & 1) != 0;
+		bool f_terrain = (n % 3) == 0;
+
+		boa_BuildMine(num_rooms, f_ties, f_terrain);
+
+		clear_BOA();
+		BOA_num_terrain_regions = f_terrain ? BOA_TEST_REGIONS : 0;
+		auto start = std::chrono::steady_clock::now();
+		compute_next_segs(true);
+		serial_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		memcpy(Serial_array, BOA_Array, sizeof(Serial_array));
+
+		clear_BOA();
+		BOA_num_terrain_regions = f_terrain ? BOA_TEST_REGIONS : 0;
+		start = std::chrono::steady_clock::now();
+		compute_next_segs(false);
+		tree_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		if (memcmp(Serial_array, BOA_Array, sizeof(Serial_array)))
+		{
+			if (failures < 20)
+				printf("Mismatch in mine %d: %d rooms, %s costs, %s\n", n, num_rooms, f_ties ? "tied" : "random", f_terrain ? "terrain" : "no terrain");
+			failures++;
+		}
+
+		boa_FreeMine();
+	}
+
+	BOA_f_making_boa = false;
+	task_ClosePool();
+
+	printf("%d mines, %d mismatches\n", count, failures);
+	printf("FindPath: %.3f s, path trees: %.3f s\n", serial_time, tree_time);
+
+	return failures;
+}
@@ -0,0 +1,333 @@
+/*
+* Descent 3
+* Copyright (C) 2024 Parallax Software
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Writes a file laid out like a level, chunks of ints, vertices, faces and names with some
+// chunks that get skipped, and reads it back a value at a time the way LoadLevel() does.  Checks
+// every value comes back right, and times reading through cfile against reading each value
+// straight from stdio, which is what cfile did before it had a read buffer.
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+#include "tests.h"
+#include "CFILE.H"
+#include "psrand.h"
+
+#define CFILE_TEST_NAME		"./cfiletest.dat"
+#define CFILE_TEST_PASSES	5
+
+typedef enum
+{
+	CFT_WRITE,			// Write the values with cfile
+	CFT_CFILE,			// Read them back with cfile
+	CFT_STDIO,			// Read them back with stdio, one call a value
+} cfile_test_mode;
+
+static cfile_test_mode Cft_mode;
+static CFILE *Cft_cfile;
+static FILE *Cft_stdio;
+static int Cft_mismatches;
+static int Cft_stdio_calls;
+
+static void cft_Int(int val)
+{
+	int got = 0;
+
+	if (Cft_mode == CFT_WRITE)
+	{
+		cf_WriteInt(Cft_cfile, val);
+		return;
+	}
+
+	if (Cft_mode == CFT_CFILE)
+		got = cf_ReadInt(Cft_cfile);
+	else
+	{
+		fread(&got, sizeof(got), 1, Cft_stdio);
+		Cft_stdio_calls++;
+	}
+
+	Cft_mismatches += (got != val);
+}
+
+static void cft_Short(short val)
+{
+	short got = 0;
+
+	if (Cft_mode == CFT_WRITE)
+	{
+		cf_WriteShort(Cft_cfile, val);
+		return;
+	}
+
+	if (Cft_mode == CFT_CFILE)
+		got = cf_ReadShort(Cft_cfile);
+	else
+	{
+		fread(&got, sizeof(got), 1, Cft_stdio);
+		Cft_stdio_calls++;
+	}
+
+	Cft_mismatches += (got != val);
+}
+
+static void cft_Byte(sbyte val)
+{
+	sbyte got = 0;
+
+	if (Cft_mode == CFT_WRITE)
+	{
+		cf_WriteByte(Cft_cfile, val);
+		return;
+	}
+
+	if (Cft_mode == CFT_CFILE)
+		got = cf_ReadByte(Cft_cfile);
+	else
+	{
+		got = (sbyte)fgetc(Cft_stdio);
+		Cft_stdio_calls++;
+	}
+
+	Cft_mismatches += (got != val);
+}
+
+static void cft_Float(float val)
+{
+	float got = 0;
+
+	if (Cft_mode == CFT_WRITE)
+	{
+		cf_WriteFloat(Cft_cfile, val);
+		return;
+	}
+
+	if (Cft_mode == CFT_CFILE)
+		got = cf_ReadFloat(Cft_cfile);
+	else
+	{
+		fread(&got, sizeof(got), 1, Cft_stdio);
+		Cft_stdio_calls++;
+	}
+
+	Cft_mismatches += (got != val);
+}
+
+static void cft_String(const char *val)
+{
+	char got[64];
+
+	if (Cft_mode == CFT_WRITE)
+	{
+		cf_WriteString(Cft_cfile, val);
+		return;
+	}
+
+	if (Cft_mode == CFT_CFILE)
+		cf_ReadString(got, sizeof(got), Cft_cfile);
+	else
+	{
+		int i = 0, c;
+		while (((c = fgetc(Cft_stdio)) != EOF) && c && (i < (int)sizeof(got) - 1))
+			got[i++] = (char)c;
+		got[i] = 0;
+		Cft_stdio_calls += i + 1;
+	}
+
+	Cft_mismatches += (strcmp(got, val) != 0);
+}
+
+// A chunk the reader doesn't want.  It reads the length and seeks past it.
+static void cft_Skip(int len)
+{
+	if (Cft_mode == CFT_WRITE)
+	{
+		cf_WriteInt(Cft_cfile, len);
+		for (int i = 0; i < len; i++)
+			cf_WriteByte(Cft_cfile, (sbyte)(i * 7));
+		return;
+	}
+
+	cft_Int(len);
+
+	if (Cft_mode == CFT_CFILE)
+		cfseek(Cft_cfile, len, SEEK_CUR);
+	else
+	{
+		fseek(Cft_stdio, len, SEEK_CUR);
+		Cft_stdio_calls++;
+	}
+}
+
+// Writes or reads num_chunks chunks.  The values come from ps_rand(), so every pass goes through
+// the same ones.
+static void cft_Walk(int num_chunks)
+{
+	char name[32];
+	int i, k;
+
+	ps_srand(1);
+
+	for (int n = 0; n < num_chunks; n++)
+	{
+		int type = ps_rand() % 5;
+		int num = 1 + ps_rand() % 200;
+
+		cft_Int(type);
+		cft_Int(num);
+
+		switch (type)
+		{
+		case 0:
+			for (i = 0; i < num; i++)
+			{
+				int hi = ps_rand();
+				cft_Int((hi << 16) ^ ps_rand());
+			}
+			break;
+
+		case 1:
+			// Vertices
+			for (i = 0; i < num * 3; i++)
+				cft_Float((float)(ps_rand() - RAND_MAX / 2) / 16.0f);
+			break;
+
+		case 2:
+			// Faces: vertex count, flags, vertex numbers
+			for (i = 0; i < num; i++)
+			{
+				int num_verts = 3 + ps_rand() % 6;
+				cft_Short((short)num_verts);
+				cft_Byte((sbyte)ps_rand());
+				for (k = 0; k < num_verts; k++)
+					cft_Short((short)ps_rand());
+			}
+			break;
+
+		case 3:
+			// Names
+			for (i = 0; i < num; i++)
+			{
+				int len = ps_rand() % (sizeof(name) - 1);
+				for (k = 0; k < len; k++)
+					name[k] = 'a' + ps_rand() % 26;
+				name[len] = 0;
+				cft_String(name);
+			}
+			break;
+
+		case 4:
+			cft_Skip(num * 8);
+			break;
+		}
+	}
+}
+
+int test_CFileRead(int count)
+{
+	int failures = 0;
+	int pass;
+
+	printf("CFILE read test: %d chunks\n\n", count);
+
+	Cft_mode = CFT_WRITE;
+	Cft_cfile = cfopen(CFILE_TEST_NAME, "wb");
+	if (!Cft_cfile)
+	{
+		printf("Couldn't write %s\n", CFILE_TEST_NAME);
+		return 1;
+	}
+	cft_Walk(count);
+	cfclose(Cft_cfile);
+
+	// Through cfile
+	int reads = 0, seeks = 0, bytes = 0, size = 0;
+	auto start_time = std::chrono::steady_clock::now();
+
+	for (pass = 0; pass < CFILE_TEST_PASSES; pass++)
+	{
+		int start_reads, start_seeks, start_bytes;
+
+		Cft_mode = CFT_CFILE;
+		Cft_mismatches = 0;
+		Cft_cfile = cfopen(CFILE_TEST_NAME, "rb");
+		cf_GetIOStats(&start_reads, &start_seeks, &start_bytes);
+
+		try
+		{
+			cft_Walk(count);
+		}
+		catch (cfile_error *)
+		{
+			printf("Read error on pass %d at byte %d\n", pass, cftell(Cft_cfile));
+			failures++;
+		}
+
+		if (!cfeof(Cft_cfile))
+		{
+			printf("Pass %d stopped at byte %d of %d\n", pass, cftell(Cft_cfile), cfilelength(Cft_cfile));
+			failures++;
+		}
+
+		size = cfilelength(Cft_cfile);
+		cfclose(Cft_cfile);
+
+		cf_GetIOStats(&reads, &seeks, &bytes);
+		reads -= start_reads;
+		seeks -= start_seeks;
+		bytes -= start_bytes;
+
+		if (Cft_mismatches)
+		{
+			printf("%d values came back wrong on pass %d\n", Cft_mismatches, pass);
+			failures += Cft_mismatches;
+		}
+	}
+
+	double cfile_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count() / CFILE_TEST_PASSES;
+
+	// Straight from stdio
+	start_time = std::chrono::steady_clock::now();
+
+	for (pass = 0; pass < CFILE_TEST_PASSES; pass++)
+	{
+		Cft_mode = CFT_STDIO;
+		Cft_mismatches = 0;
+		Cft_stdio_calls = 0;
+		Cft_stdio = fopen(CFILE_TEST_NAME, "rb");
+		cft_Walk(count);
+		fclose(Cft_stdio);
+
+		if (Cft_mismatches)
+		{
+			printf("%d values came back wrong from stdio on pass %d\n", Cft_mismatches, pass);
+			failures += Cft_mismatches;
+		}
+	}
+
+	double stdio_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count() / CFILE_TEST_PASSES;
+
+	remove(CFILE_TEST_NAME);
+
+	printf("%d byte file\n", size);
+	printf("CFILE: %.3f ms a pass, %d reads, %d seeks, %d bytes read\n", cfile_time * 1000.0, reads, seeks, bytes);
+	printf("stdio: %.3f ms a pass, %d calls\n", stdio_time * 1000.0, Cft_stdio_calls);
+
+	return failures;
+}
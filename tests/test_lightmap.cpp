@@ -0,0 +1,175 @@
+/*
+* Descent 3
+* Copyright (C) 2024 Parallax Software
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Lights random lightmap rows with the dynamic lighting row kernel and with the scalar code,
+// and checks that every texel and the changed range come out the same.
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+#include "tests.h"
+#include "lighting.h"
+#include "grdefs.h"
+#include "psrand.h"
+
+#define LIGHTMAP_TEST_TIMING_ROWS	20000
+
+// Returns a random float from lo to hi
+static float lightmap_Rand(float lo, float hi)
+{
+	return lo + (hi - lo) * ((float)ps_rand() / (float)RAND_MAX);
+}
+
+// Times both kernels on a full size row lit by a directional light
+static void lightmap_Time()
+{
+	ushort original[LIGHTMAP_MAX_ROW];
+	ushort row[LIGHTMAP_MAX_ROW];
+	vector start, step, pos, dir;
+
+	start.x = start.y = start.z = 0;
+	step.x = LIGHTMAP_SPACING;
+	step.y = step.z = 0;
+	pos.x = LIGHTMAP_SPACING * LIGHTMAP_MAX_ROW / 2;
+	pos.y = 10;
+	pos.z = 0;
+	dir.x = 0;
+	dir.y = -1;
+	dir.z = 0;
+
+	for (int x = 0; x < LIGHTMAP_MAX_ROW; x++)
+		original[x] = OPAQUE_FLAG | (x & 0x7fff);
+
+	for (int pass = 0; pass < 2; pass++)
+	{
+		auto start_time = std::chrono::steady_clock::now();
+		int first, last;
+
+		for (int n = 0; n < LIGHTMAP_TEST_TIMING_ROWS; n++)
+		{
+			memcpy(row, original, sizeof(original));
+
+			if (pass == 0)
+				LightLightmapRowScalar(row, LIGHTMAP_MAX_ROW, &start, &step, &pos, 400.0f, 0.5f, 0.5f, 0.5f, &dir, 0.2f, &first, &last);
+			else
+				LightLightmapRow(row, LIGHTMAP_MAX_ROW, &start, &step, &pos, 400.0f, 0.5f, 0.5f, 0.5f, &dir, 0.2f, &first, &last);
+		}
+
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+		printf("%s: %.3f ms for %d rows of %d texels (%.1f ns a texel)\n", pass ? "Kernel" : "Scalar", elapsed * 1000.0,
+			LIGHTMAP_TEST_TIMING_ROWS, LIGHTMAP_MAX_ROW, elapsed * 1.0e9 / (LIGHTMAP_TEST_TIMING_ROWS * LIGHTMAP_MAX_ROW));
+	}
+}
+
+int test_LightmapKernel(int count)
+{
+	ushort original[LIGHTMAP_MAX_ROW];
+	ushort scalar_row[LIGHTMAP_MAX_ROW];
+	ushort fast_row[LIGHTMAP_MAX_ROW];
+	int failures = 0;
+	int texels_changed = 0;
+	int i, x;
+
+	printf("Dynamic lightmap kernel test: %d random rows, %s kernel\n\n", count, Lightmap_row_kernel);
+
+	ps_srand(1);
+
+	for (i = 0; i < count; i++)
+	{
+		int width = 1 + ps_rand() % LIGHTMAP_MAX_ROW;
+		float spacing = lightmap_Rand(0.5f, LIGHTMAP_SPACING * 2);
+		float light_dist = lightmap_Rand(1.0f, 80.0f);
+		vector start, step, pos, dir;
+
+		start.x = lightmap_Rand(-2000.0f, 2000.0f);
+		start.y = lightmap_Rand(-2000.0f, 2000.0f);
+		start.z = lightmap_Rand(-2000.0f, 2000.0f);
+		step.x = lightmap_Rand(-1.0f, 1.0f);
+		step.y = lightmap_Rand(-1.0f, 1.0f);
+		step.z = lightmap_Rand(-1.0f, 1.0f);
+		vm_NormalizeVector(&step);
+		step *= spacing;
+
+		// Put the light near the middle of the row
+		pos = start + step * (float)(ps_rand() % width);
+		pos.x += lightmap_Rand(-light_dist, light_dist);
+		pos.y += lightmap_Rand(-light_dist, light_dist);
+		pos.z += lightmap_Rand(-light_dist, light_dist);
+
+		// Sometimes right on a texel, to hit the zero length case
+		if ((ps_rand() % 64) == 0)
+			pos = start + step * (float)(ps_rand() % width);
+
+		dir.x = lightmap_Rand(-1.0f, 1.0f);
+		dir.y = lightmap_Rand(-1.0f, 1.0f);
+		dir.z = lightmap_Rand(-1.0f, 1.0f);
+		vm_NormalizeVector(&dir);
+
+		float red_scale = lightmap_Rand(-1.5f, 1.5f);
+		float green_scale = lightmap_Rand(-1.5f, 1.5f);
+		float blue_scale = lightmap_Rand(-1.5f, 1.5f);
+		float dot_range = lightmap_Rand(-0.5f, 0.95f);
+		vector *light_direction = (ps_rand() & 1) ? &dir : NULL;
+
+		for (x = 0; x < width; x++)
+		{
+			original[x] = (ushort)((ps_rand() << 1) ^ ps_rand());
+			if (ps_rand() % 8)
+				original[x] |= OPAQUE_FLAG;
+		}
+
+		memcpy(scalar_row, original, width * sizeof(ushort));
+		memcpy(fast_row, original, width * sizeof(ushort));
+
+		int scalar_first = -1, scalar_last = -1, fast_first = -1, fast_last = -1;
+		int scalar_changed = LightLightmapRowScalar(scalar_row, width, &start, &step, &pos, light_dist, red_scale, green_scale, blue_scale, light_direction, dot_range, &scalar_first, &scalar_last);
+		int fast_changed = LightLightmapRow(fast_row, width, &start, &step, &pos, light_dist, red_scale, green_scale, blue_scale, light_direction, dot_range, &fast_first, &fast_last);
+
+		texels_changed += scalar_changed;
+
+		if (memcmp(scalar_row, fast_row, width * sizeof(ushort)) || (scalar_changed != fast_changed) ||
+			(scalar_changed && ((scalar_first != fast_first) || (scalar_last != fast_last))))
+		{
+			if (failures < 20)
+			{
+				for (x = 0; (x < width) && (scalar_row[x] == fast_row[x]); x++)
+					;
+
+				printf("Mismatch on row %d: width %d, changed %d/%d, texel %d was %04x, scalar %04x, kernel %04x\n", i, width, scalar_changed, fast_changed, x,
+					(x < width) ? original[x] : 0, (x < width) ? scalar_row[x] : 0, (x < width) ? fast_row[x] : 0);
+			}
+			failures++;
+		}
+	}
+
+	printf("%d rows, %d texels changed, %d mismatches\n\n", count, texels_changed, failures);
+
+	// Every x86 build has SSE2, so the scalar kernel here means the build flags are wrong
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+	if (strcmp(Lightmap_row_kernel, "SSE2"))
+	{
+		printf("LightLightmapRow() was built without SSE2!\n\n");
+		failures++;
+	}
+#endif
+
+	lightmap_Time();
+
+	return failures;
+}
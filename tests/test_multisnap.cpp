@@ -0,0 +1,428 @@
+/*
+* Descent 3
+* Copyright (C) 2024 Parallax Software
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Fuzzes the robot snapshot encoder and decoder, and sends robots from a server to a client over
+// a link that loses and reorders packets
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "tests.h"
+#include "multi_snapshot_internal.h"
+#include "vecmat.h"
+#include "mem.h"
+
+#define SNAP_TEST_OBJECTS		300
+#define SNAP_TEST_MAX_PACKETS	512
+#define SNAP_TEST_LOSS			20			// Percent of packets dropped
+#define SNAP_TEST_MAX_DELAY	3			// In ticks
+
+struct snap_test_packet
+{
+	int deliver_tick;
+	int size;
+	ubyte data[MAX_GAME_DATA_SIZE];
+};
+
+struct snap_test_truth
+{
+	ushort seq;
+	multi_snap_state state;
+};
+
+static uint Snap_test_seed;
+static snap_test_truth (*Snap_test_sent)[MULTI_SNAP_TICKS];
+static ushort Snap_test_seq;								// Tick of the message being received
+static int Snap_test_applied, Snap_test_mismatches;
+
+static int SnapTestRand()
+{
+	Snap_test_seed = Snap_test_seed * 1103515245 + 12345;
+	return (Snap_test_seed >> 1) & 0x7fffffff;
+}
+
+static int SnapTestRange(int lo, int hi)
+{
+	return lo + SnapTestRand() % (hi - lo + 1);
+}
+
+static void SnapTestRandomState(multi_snap_state* state)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		state->pos[i] = SnapTestRange(-SNAP_POS_LIMIT, SNAP_POS_LIMIT);
+		state->orient[i] = SnapTestRange(-SNAP_QUAT_MAX, SNAP_QUAT_MAX);
+		state->vel[i] = SnapTestRange(-SNAP_VEL_LIMIT, SNAP_VEL_LIMIT);
+	}
+
+	state->orient_index = SnapTestRange(0, 3);
+	state->roomnum = SnapTestRange(0, 65535);
+	state->terrain = SnapTestRange(0, 1);
+}
+
+// Changes some of a state, by a little or a lot
+static void SnapTestMutate(multi_snap_state* state)
+{
+	multi_snap_state other;
+	SnapTestRandomState(&other);
+
+	const bool small = (SnapTestRand() & 1) != 0;
+
+	for (int i = 0; i < 3; i++)
+	{
+		if (SnapTestRand() & 1)
+			state->pos[i] = small ? state->pos[i] / 2 + SnapTestRange(-64, 64) : other.pos[i];
+		if (SnapTestRand() & 1)
+			state->orient[i] = small ? (short)(state->orient[i] / 2 + SnapTestRange(-8, 8)) : other.orient[i];
+		if (SnapTestRand() & 1)
+			state->vel[i] = small ? (short)(state->vel[i] / 2 + SnapTestRange(-64, 64)) : other.vel[i];
+	}
+
+	if ((SnapTestRand() & 3) == 0)
+		state->orient_index = other.orient_index;
+	if ((SnapTestRand() & 3) == 0)
+	{
+		state->roomnum = other.roomnum;
+		state->terrain = other.terrain;
+	}
+}
+
+// Encodes random robots and checks they decode the same.  Returns the number of failures.
+static int SnapTestRoundTrip(int iterations)
+{
+	multi_snap_state bases[40], states[40], decoded;
+	int objnums[40], ages[40];
+	ubyte buffer[40 * SNAP_MAX_OBJECT_BYTES];
+	int failures = 0;
+	int total_bits = 0, total_objects = 0;
+
+	for (int iter = 0; iter < iterations; iter++)
+	{
+		const int num = SnapTestRange(1, 40);
+		snap_bits b;
+		int i;
+
+		SnapBitsInit(&b, buffer, sizeof(buffer));
+
+		for (i = 0; i < num; i++)
+		{
+			objnums[i] = SnapTestRange(0, MAX_OBJECTS - 1);
+			ages[i] = SnapTestRange(0, MULTI_SNAP_TICKS - 1);
+
+			if (ages[i])
+				SnapTestRandomState(&bases[i]);
+			else
+				bases[i] = Snap_zero_state;
+
+			states[i] = bases[i];
+			SnapTestMutate(&states[i]);
+
+			const int start = b.pos;
+			SnapEncode(&b, objnums[i], ages[i], &bases[i], &states[i]);
+
+			if (b.pos - start > SNAP_MAX_OBJECT_BYTES * 8)
+			{
+				if (failures++ == 0)
+					printf("Robot took %d bits\n", b.pos - start);
+			}
+		}
+
+		if (b.overrun)
+		{
+			if (failures++ == 0)
+				printf("Encoder overran its buffer\n");
+			continue;
+		}
+
+		total_bits += b.pos;
+		total_objects += num;
+
+		const int used = SnapBitsBytes(&b);
+
+		// Decode everything
+		SnapBitsInit(&b, buffer, used);
+		for (i = 0; i < num; i++)
+		{
+			int objnum, age;
+			SnapDecodeHeader(&b, &objnum, &age);
+			SnapDecodeState(&b, &bases[i], &decoded);
+
+			if (b.overrun || objnum != objnums[i] || age != ages[i] || !SnapStatesEqual(&decoded, &states[i]))
+			{
+				if (failures++ == 0)
+					printf("Round trip mismatch at iteration %d robot %d\n", iter, i);
+				break;
+			}
+		}
+
+		// A short buffer has to be caught
+		SnapBitsInit(&b, buffer, SnapTestRange(0, used - 1));
+		for (i = 0; i < num && !b.overrun; i++)
+		{
+			int objnum, age;
+			SnapDecodeHeader(&b, &objnum, &age);
+			SnapDecodeState(&b, &bases[i], &decoded);
+		}
+
+		if (!b.overrun)
+		{
+			if (failures++ == 0)
+				printf("Short buffer wasn't caught at iteration %d\n", iter);
+		}
+
+		// Garbage mustn't read past the end
+		for (i = 0; i < used; i++)
+			buffer[i] = SnapTestRand();
+
+		SnapBitsInit(&b, buffer, used);
+		for (i = 0; i < num && !b.overrun; i++)
+		{
+			int objnum, age;
+			SnapDecodeHeader(&b, &objnum, &age);
+			SnapDecodeState(&b, &bases[i], &decoded);
+		}
+
+		if (b.pos > used * 8)
+		{
+			if (failures++ == 0)
+				printf("Decoder read past the end at iteration %d\n", iter);
+		}
+	}
+
+	printf("Round trip: %d iterations, %d robots, %.1f bits each, %d failures\n", iterations, total_objects, total_objects ? (float)total_bits / total_objects : 0.0f, failures);
+
+	return failures;
+}
+
+// Checks how close quantized states are to the real ones.  Returns the number of failures.
+static int SnapTestQuantize(int iterations)
+{
+	float max_orient_error = 0, max_pos_error = 0;
+	int failures = 0;
+
+	for (int iter = 0; iter < iterations; iter++)
+	{
+		matrix orient, decoded_orient;
+		vector pos, vel, decoded_pos, decoded_vel;
+		int roomnum, decoded_roomnum;
+		multi_snap_state state;
+
+		vm_AnglesToMatrix(&orient, SnapTestRange(0, 65535), SnapTestRange(0, 65535), SnapTestRange(0, 65535));
+		pos.x = SnapTestRange(0, 4096 * 16) / 16.0f + SnapTestRange(0, 999) / 1000.0f;
+		pos.y = SnapTestRange(-4096 * 16, 4096 * 16) / 16.0f;
+		pos.z = SnapTestRange(0, 4096 * 16) / 16.0f;
+		vel.x = SnapTestRange(-200, 200) / 3.0f;
+		vel.y = SnapTestRange(-200, 200) / 3.0f;
+		vel.z = SnapTestRange(-200, 200) / 3.0f;
+		roomnum = (SnapTestRand() & 1) ? MAKE_ROOMNUM(SnapTestRange(0, 65535)) : SnapTestRange(0, 399);
+
+		SnapMakeState(&pos, &orient, &vel, roomnum, &state);
+		SnapGetState(&state, &decoded_pos, &decoded_orient, &decoded_vel, &decoded_roomnum);
+
+		const float* a = &orient.rvec.x;
+		const float* b = &decoded_orient.rvec.x;
+		for (int i = 0; i < 9; i++)
+		{
+			const float error = fabsf(a[i] - b[i]);
+			if (error > max_orient_error)
+				max_orient_error = error;
+		}
+
+		const float pos_error = vm_VectorDistance(&pos, &decoded_pos);
+		if (pos_error > max_pos_error)
+			max_pos_error = pos_error;
+
+		if (decoded_roomnum != roomnum || vm_VectorDistance(&vel, &decoded_vel) > 0.01f)
+			failures++;
+	}
+
+	if (max_orient_error > 0.005f || max_pos_error > 0.06f)
+		failures++;
+
+	printf("Quantizing: largest orientation error %f, largest position error %f, %d failures\n", max_orient_error, max_pos_error, failures);
+
+	return failures;
+}
+
+static void SnapTestApply(int objnum, const multi_snap_state* state)
+{
+	snap_test_truth* sent = &Snap_test_sent[objnum][Snap_test_seq & SNAP_TICK_MASK];
+
+	Snap_test_applied++;
+
+	if (sent->seq != Snap_test_seq || !SnapStatesEqual(&sent->state, state))
+		Snap_test_mismatches++;
+}
+
+// Queues a copy of a packet to arrive a few ticks from now, unless it gets lost
+static void SnapTestSend(snap_test_packet* queue, int* num_queued, int tick, ubyte* data, int size)
+{
+	if (SnapTestRange(0, 99) < SNAP_TEST_LOSS || *num_queued >= SNAP_TEST_MAX_PACKETS)
+		return;
+
+	snap_test_packet* p = &queue[(*num_queued)++];
+	p->deliver_tick = tick + SnapTestRange(0, SNAP_TEST_MAX_DELAY);
+	p->size = size;
+	memcpy(p->data, data, size);
+}
+
+// Sends robots from a server to a client over a link that loses and reorders packets.  Returns
+// the number of failures.
+static int SnapTestLink(int num_ticks)
+{
+	snap_server* sv = (snap_server*)mem_malloc(sizeof(snap_server));
+	snap_receiver* rv = (snap_receiver*)mem_malloc(sizeof(snap_receiver));
+	snap_test_packet* to_client = (snap_test_packet*)mem_malloc(SNAP_TEST_MAX_PACKETS * sizeof(snap_test_packet));
+	snap_test_packet* to_server = (snap_test_packet*)mem_malloc(SNAP_TEST_MAX_PACKETS * sizeof(snap_test_packet));
+	multi_snap_state world[SNAP_TEST_OBJECTS];
+	int num_to_client = 0, num_to_server = 0;
+	int bytes_sent = 0, objects_sent = 0;
+	int i;
+
+	memset(sv, 0, sizeof(snap_server));
+	memset(rv, 0, sizeof(snap_receiver));
+	SnapServerReset(sv);
+
+	for (i = 0; i < SNAP_TEST_OBJECTS; i++)
+	{
+		vector pos = {(float)SnapTestRange(0, 4000), (float)SnapTestRange(0, 400), (float)SnapTestRange(0, 4000)};
+		vector vel = {0, 0, 0};
+		matrix orient;
+		vm_AnglesToMatrix(&orient, SnapTestRange(0, 65535), SnapTestRange(0, 65535), SnapTestRange(0, 65535));
+		SnapMakeState(&pos, &orient, &vel, SnapTestRange(0, 399), &world[i]);
+	}
+
+	Snap_test_sent = (snap_test_truth(*)[MULTI_SNAP_TICKS])mem_malloc(SNAP_TEST_OBJECTS * MULTI_SNAP_TICKS * sizeof(snap_test_truth));
+	memset(Snap_test_sent, 0, SNAP_TEST_OBJECTS * MULTI_SNAP_TICKS * sizeof(snap_test_truth));
+	Snap_test_applied = 0;
+	Snap_test_mismatches = 0;
+
+	for (int tick = 0; tick < num_ticks; tick++)
+	{
+		// Move some robots and send them
+		const int num_moved = SnapTestRange(0, SNAP_TEST_OBJECTS / 2);
+		const int first = SnapTestRange(0, SNAP_TEST_OBJECTS - 1);
+
+		for (i = 0; i < num_moved; i++)
+		{
+			const int objnum = (first + i * 7) % SNAP_TEST_OBJECTS;
+			multi_snap_state* state = &world[objnum];
+
+			for (int k = 0; k < 3; k++)
+			{
+				state->pos[k] += SnapTestRange(-40, 40);
+				state->vel[k] = (short)(state->vel[k] / 2 + SnapTestRange(-300, 300));
+				state->orient[k] = (short)((state->orient[k] * 7) / 8 + SnapTestRange(-6, 6));
+			}
+
+			if ((SnapTestRand() & 31) == 0)
+				state->roomnum = SnapTestRange(0, 399);
+
+			if (!sv->in_tick)
+				SnapServerBeginTick(sv);
+
+			if (sv->msg_open && SnapServerMessageFull(sv))
+			{
+				const int size = SnapServerCloseMessage(sv);
+				SnapTestSend(to_client, &num_to_client, tick, sv->msg, size);
+				bytes_sent += size;
+			}
+
+			if (!sv->msg_open)
+				SnapServerOpenMessage(sv, SnapTestRange(SNAP_HEADER_SIZE + SNAP_MAX_OBJECT_BYTES, MAX_GAME_DATA_SIZE - 1));
+
+			Snap_test_sent[objnum][sv->seq & SNAP_TICK_MASK].seq = sv->seq;
+			Snap_test_sent[objnum][sv->seq & SNAP_TICK_MASK].state = *state;
+
+			SnapServerAdd(sv, objnum, state);
+			objects_sent++;
+		}
+
+		if (sv->msg_open)
+		{
+			const int size = SnapServerCloseMessage(sv);
+			SnapTestSend(to_client, &num_to_client, tick, sv->msg, size);
+			bytes_sent += size;
+		}
+		sv->in_tick = false;
+
+		// Deliver whatever has arrived, and ack it
+		for (i = 0; i < num_to_client; i++)
+		{
+			if (to_client[i].deliver_tick > tick)
+				continue;
+
+			// The tick the message is from, for SnapTestApply()
+			int count = 0;
+			SKIP_HEADER(to_client[i].data, &count);
+			Snap_test_seq = MultiGetUshort(to_client[i].data, &count);
+
+			if (!SnapReceive(rv, to_client[i].data, SnapTestApply))
+				Snap_test_mismatches++;
+
+			to_client[i--] = to_client[--num_to_client];
+		}
+
+		ubyte ack[MAX_GAME_DATA_SIZE];
+		int ack_size;
+		while ((ack_size = SnapStuffAck(rv, ack)) != 0)
+			SnapTestSend(to_server, &num_to_server, tick, ack, ack_size);
+
+		for (i = 0; i < num_to_server; i++)
+		{
+			if (to_server[i].deliver_tick > tick)
+				continue;
+
+			SnapServerParseAck(sv, to_server[i].data);
+			to_server[i--] = to_server[--num_to_server];
+		}
+	}
+
+	// MP_ROBOT_POS was 28 bytes a robot
+	printf("Lossy link: %d ticks, %d robots sent, %d full, %d deltas, %d applied, %d missing baselines\n", num_ticks, objects_sent, sv->num_full, sv->num_delta, Snap_test_applied, rv->num_missing);
+	printf("  %d bytes, %.1f bytes a robot (MP_ROBOT_POS took 28), %d mismatches\n", bytes_sent, objects_sent ? (float)bytes_sent / objects_sent : 0.0f, Snap_test_mismatches);
+
+	// Missing baselines are allowed, since a late packet can arrive after the client has moved
+	// on, but nothing may decode differently from what was sent
+	int failures = Snap_test_mismatches;
+	if (num_ticks >= 100 && sv->num_delta == 0)
+		failures++;
+
+	mem_free(sv);
+	mem_free(rv);
+	mem_free(to_client);
+	mem_free(to_server);
+	mem_free(Snap_test_sent);
+	Snap_test_sent = NULL;
+
+	return failures;
+}
+
+int test_MultiSnap(int count)
+{
+	Snap_test_seed = 1;
+
+	printf("Robot snapshot test, %d iterations\n\n", count);
+
+	int failures = SnapTestRoundTrip(count);
+	failures += SnapTestQuantize(count);
+	failures += SnapTestLink(count);
+
+	return failures;
+}
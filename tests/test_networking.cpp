@@ -0,0 +1,512 @@
+/*
+* Descent 3
+* Copyright (C) 2024 Parallax Software
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Network tests.  These open the game's UDP socket on a free port and send packets to it over
+// the loopback address.
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+
+#include "tests.h"
+#include "networking.h"
+#include "ddio.h"
+#include "psrand.h"
+
+#ifdef __LINUX__
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#else
+#include <time.h>
+#endif
+
+#define NET_BENCH_PACKET_SIZE	200
+#define NET_BENCH_BATCH			64		// Packets sent before reading them back, so none get dropped
+
+#define NET_TEST_FRAME_TIME		(1.0f / 60.0f)
+#define NET_TEST_MAX_TIME		5.0f	// Seconds before a link gives up
+#define NET_TEST_MIN_MESSAGE	3		// Length byte and index
+#define NET_TEST_MAX_MESSAGE	200
+
+// Opens the game's socket if it isn't open yet and returns its loopback address.  Returns false
+// if it couldn't be opened.
+static bool net_OpenSocket(network_address *addr)
+{
+	static bool opened = false;
+	static network_address loopback;
+
+	if (!opened)
+	{
+#ifdef WIN32
+		WSADATA ws_data;
+		WSAStartup(MAKEWORD(1, 1), &ws_data);
+#endif
+		nw_InitSockets(0);
+		nw_GetMyAddress(&loopback);
+
+		loopback.connection_type = NP_TCP;
+		loopback.address[0] = 127;
+		loopback.address[1] = 0;
+		loopback.address[2] = 0;
+		loopback.address[3] = 1;
+
+		opened = true;
+	}
+
+	*addr = loopback;
+	return loopback.port != 0;
+}
+
+// Returns the processor time this process has used, in seconds
+static double net_CPUTime()
+{
+#ifdef __LINUX__
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000000.0;
+#else
+	return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+static void net_CloseRawSocket(SOCKET sock)
+{
+#ifdef WIN32
+	closesocket(sock);
+#else
+	close(sock);
+#endif
+}
+
+// Opens a nonblocking UDP socket on the loopback address and returns it and its address
+static SOCKET net_OpenRawSocket(SOCKADDR_IN *addr)
+{
+	socklen_t len = sizeof(SOCKADDR_IN);
+	SOCKET sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+	if (sock == INVALID_SOCKET)
+		return INVALID_SOCKET;
+
+	memset(addr, 0, sizeof(SOCKADDR_IN));
+	addr->sin_family = AF_INET;
+	addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr->sin_port = 0;
+
+	if ((bind(sock, (SOCKADDR *)addr, sizeof(SOCKADDR_IN)) == SOCKET_ERROR) || (getsockname(sock, (SOCKADDR *)addr, &len) == SOCKET_ERROR))
+	{
+		net_CloseRawSocket(sock);
+		return INVALID_SOCKET;
+	}
+
+	unsigned long nonblocking = 1;
+#ifdef WIN32
+	ioctlsocket(sock, FIONBIO, &nonblocking);
+#else
+	ioctl(sock, FIONBIO, &nonblocking);
+#endif
+
+	return sock;
+}
+
+static int Net_bench_received;
+
+static void *net_BenchCallback(ubyte *data, int len, network_address *from)
+{
+	Net_bench_received++;
+	return NULL;
+}
+
+// Sends num_packets packets between two sockets of our own, one sendto() and one recvfrom() a
+// packet, the way nw_SendWithID() and nw_DoReceiveCallbacks() used to.  Returns the number read.
+static int net_BenchRaw(int num_packets)
+{
+	SOCKADDR_IN from_addr, to_addr;
+	ubyte packet[NET_BENCH_PACKET_SIZE];
+	int received = 0;
+
+	SOCKET from = net_OpenRawSocket(&from_addr);
+	SOCKET to = net_OpenRawSocket(&to_addr);
+
+	if ((from != INVALID_SOCKET) && (to != INVALID_SOCKET))
+	{
+		memset(packet, 0, sizeof(packet));
+
+		for (int sent = 0; sent < num_packets; sent += NET_BENCH_BATCH)
+		{
+			for (int i = 0; (i < NET_BENCH_BATCH) && (sent + i < num_packets); i++)
+				sendto(from, (char *)packet, sizeof(packet), 0, (SOCKADDR *)&to_addr, sizeof(SOCKADDR_IN));
+
+			for (;;)
+			{
+				SOCKADDR_IN addr;
+				socklen_t addr_len = sizeof(SOCKADDR_IN);
+
+				if (recvfrom(to, (char *)packet, sizeof(packet), 0, (SOCKADDR *)&addr, &addr_len) == SOCKET_ERROR)
+					break;
+				received++;
+			}
+		}
+	}
+
+	if (from != INVALID_SOCKET)
+		net_CloseRawSocket(from);
+	if (to != INVALID_SOCKET)
+		net_CloseRawSocket(to);
+
+	return received;
+}
+
+// Sends num_packets packets to the game's own socket through nw_SendWithID(), in send batches if
+// batched is true, and reads them with nw_DoReceiveCallbacks().  Returns the number read.
+static int net_BenchGame(network_address *addr, int num_packets, bool batched)
+{
+	ubyte packet[NET_BENCH_PACKET_SIZE - 1];
+
+	memset(packet, 0, sizeof(packet));
+	Net_bench_received = 0;
+
+	for (int sent = 0; sent < num_packets; sent += NET_BENCH_BATCH)
+	{
+		if (batched)
+			nw_BeginSendBatch();
+
+		for (int i = 0; (i < NET_BENCH_BATCH) && (sent + i < num_packets); i++)
+			nw_SendWithID(NWT_UNRELIABLE, packet, sizeof(packet), addr);
+
+		if (batched)
+			nw_EndSendBatch();
+
+		nw_DoReceiveCallbacks();
+	}
+
+	return Net_bench_received;
+}
+
+int test_NetBench(int count)
+{
+	static const char *run_names[3] = {"One call a packet", "nw_SendWithID", "Batched"};
+	network_address addr;
+	int failures = 0;
+
+	if (!net_OpenSocket(&addr))
+	{
+		printf("Couldn't open the game socket\n");
+		return 1;
+	}
+
+	nw_RegisterCallback((NetworkReceiveCallback)net_BenchCallback, NWT_UNRELIABLE);
+
+	printf("Loopback benchmark: %d packets of %d bytes\n\n", count, NET_BENCH_PACKET_SIZE);
+
+	for (int run = 0; run < 3; run++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		double start_cpu = net_CPUTime();
+
+		int received = (run == 0) ? net_BenchRaw(count) : net_BenchGame(&addr, count, (run == 2));
+
+		double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		double cpu = net_CPUTime() - start_cpu;
+
+		printf("%s: %d received, %.0f packets/sec, %.2f usec CPU a packet\n", run_names[run], received,
+			(wall > 0) ? received / wall : 0.0, received ? (cpu * 1000000.0) / received : 0.0);
+
+		// Nothing should be lost over loopback when the packets are read back a batch at a time
+		if (received < count)
+			failures++;
+	}
+
+	nw_RegisterCallback((NetworkReceiveCallback)nw_HandleUnreliableData, NWT_UNRELIABLE);
+
+	return failures;
+}
+
+// ------------------------------------------------------------------------------------------------------
+// RELIABLE SOCKETS
+//
+// Two reliable sockets in this process talk to each other through a pair of relay sockets, so
+// each sees the other at its own address: what the game sends to one relay socket goes back to
+// the game from the other.  The link simulation makes the links lossy and slow.
+
+typedef struct
+{
+	float loss, latency, jitter;
+}net_test_link;
+
+static const net_test_link Net_test_links[] =
+{
+	{0.0f,  0.010f, 0.0f},
+	{0.05f, 0.020f, 0.010f},
+	{0.10f, 0.030f, 0.020f},
+	{0.20f, 0.050f, 0.030f},
+};
+
+#define NET_TEST_NUM_LINKS		(int)(sizeof(Net_test_links) / sizeof(net_test_link))
+
+// Sends everything waiting on one relay socket out of the other to the game.  Returns the number
+// of packets passed on.
+static int net_Relay(SOCKET from, SOCKET to, SOCKADDR_IN *game_addr)
+{
+	ubyte packet[1500];
+	int relayed = 0;
+	int len;
+
+	for (;;)
+	{
+		SOCKADDR_IN addr;
+		socklen_t addr_len = sizeof(SOCKADDR_IN);
+
+		len = recvfrom(from, (char *)packet, sizeof(packet), 0, (SOCKADDR *)&addr, &addr_len);
+		if (len == SOCKET_ERROR)
+			break;
+
+		sendto(to, (char *)packet, len, 0, (SOCKADDR *)game_addr, sizeof(SOCKADDR_IN));
+		relayed++;
+	}
+
+	return relayed;
+}
+
+// Builds test message number index.  Returns its length.
+static int net_MakeMessage(ubyte *data, int index)
+{
+	int len = NET_TEST_MIN_MESSAGE + (ps_rand() % (NET_TEST_MAX_MESSAGE - NET_TEST_MIN_MESSAGE + 1));
+
+	data[0] = len;
+	data[1] = index & 0xff;
+	data[2] = (index >> 8) & 0xff;
+	for (int i = NET_TEST_MIN_MESSAGE; i < len; i++)
+		data[i] = (ubyte)(index + i);
+
+	return len;
+}
+
+// Checks the messages in a received packet.  Returns the number of errors.
+static int net_CheckPacket(ubyte *data, int len, int *next_index, float *sent_times, float *total_delay, float *max_delay)
+{
+	int errors = 0;
+	int pos = 0;
+
+	while (pos < len)
+	{
+		int msg_len = data[pos];
+
+		if ((msg_len < NET_TEST_MIN_MESSAGE) || ((pos + msg_len) > len))
+			return errors + 1;
+
+		int index = data[pos + 1] | (data[pos + 2] << 8);
+
+		if (index != (*next_index & 0xffff))
+			errors++;
+
+		for (int i = NET_TEST_MIN_MESSAGE; i < msg_len; i++)
+		{
+			if (data[pos + i] != (ubyte)(index + i))
+			{
+				errors++;
+				break;
+			}
+		}
+
+		float delay = timer_GetTime() - sent_times[*next_index];
+		*total_delay += delay;
+		if (delay > *max_delay)
+			*max_delay = delay;
+
+		(*next_index)++;
+		pos += msg_len;
+	}
+
+	return errors;
+}
+
+// Sends count messages each way between two reliable sockets over one link.  Returns the
+// number of errors.
+static int net_TestLink(const net_test_link *link, network_address *game, int count, float **sent_times)
+{
+	ubyte message[NET_TEST_MAX_MESSAGE];
+	ubyte packet[NETBUFFERSIZE];
+	SOCKADDR_IN game_addr, relay_addr[2];
+	SOCKET relay[2];
+	SOCKET sockets[2] = {INVALID_SOCKET, INVALID_SOCKET};
+	network_address peer;
+	int num_sent[2] = {0, 0};
+	int num_received[2] = {0, 0};
+	float total_delay[2] = {0, 0};
+	float max_delay[2] = {0, 0};
+	int num_relayed = 0;
+	int errors = 0;
+	int i;
+
+	printf("%.0f%% loss, %.0f-%.0fms latency: ", link->loss * 100, link->latency * 1000, (link->latency + link->jitter) * 1000);
+
+	memset(&game_addr, 0, sizeof(SOCKADDR_IN));
+	game_addr.sin_family = AF_INET;
+	game_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	game_addr.sin_port = htons(game->port);
+
+	relay[0] = net_OpenRawSocket(&relay_addr[0]);
+	relay[1] = net_OpenRawSocket(&relay_addr[1]);
+
+	// Socket 0 sends to relay socket 0, which passes it on from relay socket 1, the address of
+	// socket 1, and the other way round
+	for (i = 0; i < 2; i++)
+	{
+		if (relay[i] == INVALID_SOCKET)
+			break;
+
+		memset(&peer, 0, sizeof(network_address));
+		peer.connection_type = NP_TCP;
+		peer.port = ntohs(relay_addr[i].sin_port);
+		memcpy(peer.address, &relay_addr[i].sin_addr, 4);
+
+		sockets[i] = nw_OpenReliableSocket(&peer);
+		if (sockets[i] == INVALID_SOCKET)
+			break;
+	}
+
+	if (i < 2)
+	{
+		printf("couldn't open the sockets\n");
+		errors++;
+	}
+	else
+	{
+		int start_resent;
+		tNetworkStatus stats;
+
+		nw_GetNetworkStats(&stats);
+		start_resent = stats.tcp_total_packets_resent;
+
+		nw_SetLinkSimulation(link->loss, link->latency, link->jitter);
+
+		float start = timer_GetTime();
+		auto next_frame = std::chrono::steady_clock::now();
+
+		while ((num_received[0] < count) || (num_received[1] < count))
+		{
+			if ((timer_GetTime() - start) > NET_TEST_MAX_TIME)
+			{
+				printf("timed out, ");
+				errors++;
+				break;
+			}
+
+			for (int from = 0; from < 2; from++)
+			{
+				// A few messages most frames, and now and then a burst
+				int num = ps_rand() % 4;
+				if ((ps_rand() % 64) == 0)
+					num = 40;
+
+				for (; (num > 0) && (num_sent[from] < count); num--)
+				{
+					int len = net_MakeMessage(message, num_sent[from]);
+
+					sent_times[from][num_sent[from]] = timer_GetTime();
+					if (nw_SendReliable(sockets[from], message, len, (ps_rand() % 8) == 0) != len)
+					{
+						errors++;
+						break;
+					}
+					num_sent[from]++;
+				}
+			}
+
+			num_relayed += net_Relay(relay[0], relay[1], &game_addr);
+			num_relayed += net_Relay(relay[1], relay[0], &game_addr);
+			nw_DoReceiveCallbacks();
+
+			for (int to = 0; to < 2; to++)
+			{
+				int from = to ^ 1;
+				int len;
+
+				while ((len = nw_ReceiveReliable(sockets[to], packet, sizeof(packet))) > 0)
+					errors += net_CheckPacket(packet, len, &num_received[from], sent_times[from], &total_delay[from], &max_delay[from]);
+			}
+
+			if (!nw_CheckReliableSocket(sockets[0]) || !nw_CheckReliableSocket(sockets[1]))
+			{
+				printf("socket broke, ");
+				errors++;
+				break;
+			}
+
+			next_frame += std::chrono::microseconds((int)(NET_TEST_FRAME_TIME * 1000000));
+			std::this_thread::sleep_until(next_frame);
+		}
+
+		int num_delivered = num_received[0] + num_received[1];
+
+		nw_GetNetworkStats(&stats);
+		printf("%d and %d delivered in %.2f seconds, %d packets got through, %d resent, delay %.0fms average, %.0fms most\n",
+			num_received[0], num_received[1], timer_GetTime() - start, num_relayed, stats.tcp_total_packets_resent - start_resent,
+			num_delivered ? ((total_delay[0] + total_delay[1]) * 1000) / num_delivered : 0.0f,
+			((max_delay[0] > max_delay[1]) ? max_delay[0] : max_delay[1]) * 1000);
+
+		if ((num_received[0] < count) || (num_received[1] < count))
+			errors++;
+
+		// Throw away anything still held so it can't turn up on the next link
+		nw_SetLinkSimulation(0, 0, 0);
+	}
+
+	for (i = 0; i < 2; i++)
+	{
+		if (sockets[i] != INVALID_SOCKET)
+			nw_CloseSocket(&sockets[i]);
+		if (relay[i] != INVALID_SOCKET)
+			net_CloseRawSocket(relay[i]);
+	}
+
+	return errors;
+}
+
+int test_Reliable(int count)
+{
+	network_address addr;
+	int failures = 0;
+
+	if (!net_OpenSocket(&addr))
+	{
+		printf("Couldn't open the game socket\n");
+		return 1;
+	}
+
+	timer_Init(0, false);
+	ps_srand(1);
+
+	float *sent_times[2];
+	sent_times[0] = new float[count];
+	sent_times[1] = new float[count];
+
+	printf("Reliable sockets: %d messages of %d-%d bytes each way\n\n", count, NET_TEST_MIN_MESSAGE, NET_TEST_MAX_MESSAGE);
+
+	for (int link = 0; link < NET_TEST_NUM_LINKS; link++)
+	{
+		if (net_TestLink(&Net_test_links[link], &addr, count, sent_times))
+			failures++;
+	}
+
+	delete[] sent_times[0];
+	delete[] sent_times[1];
+
+	return failures;
+}
@@ -0,0 +1,539 @@
+/*
+* Descent 3
+* Copyright (C) 2024 Parallax Software
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Runs the same random level, trigger and object timers through the OSIRIS timer queue and
+// through a copy of the old scan of every slot, and checks that both send the same events in
+// the same order.  The timer events start and cancel more timers the way scripts do, and kill
+// objects, which takes out the object's timers and cancels the timers it's the detonator for.
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+#include "tests.h"
+#include "osiris_dll.h"
+#include "game.h"
+#include "object.h"
+#include "mem.h"
+
+#define TIMER_TEST_FRAMES		900
+#define TIMER_TEST_FRAMETIME	(1.0f / 30.0f)
+#define TIMER_TEST_LOOKUPS		8			// Osiris_GetTimerHandle() calls per frame
+#define TIMER_TEST_SLOTS		32768		// MAX_OSIRIS_TIMERS
+#define TIMER_TEST_SLOT_BITS	15			// OSIRIS_TIMER_SLOT_BITS
+#define TIMER_TEST_OBJECTS		64			// Objects 1 to 64 own timers and set them off
+
+// Bumped by Osiris_CreateTimer() for every handle it makes
+extern int Osiris_timer_counter;
+
+// A timer slot in the old code
+#define REF_USED			0x0001
+#define REF_REPEATCALL	0x0002
+#define REF_TRIGGER		0x0004
+#define REF_LEVEL			0x0008
+#define REF_CANCELONDEAD	0x0010
+struct ref_timer
+{
+	int flags;
+	int trignum;
+	int objhandle;
+	int detonator;
+	int id;
+	int repeat_count;
+	int handle;
+	float timer_interval;
+	float timer_next_signal;
+	float timer_end;
+};
+
+struct timer_event
+{
+	int handle;
+	int event;			// EVT_TIMER, EVT_TIMERCANCEL, or 0 for a handle lookup
+	int id;
+	float time;
+};
+
+struct timer_test
+{
+	bool reference;				// Use the slot scan instead of the queue
+	ref_timer *ref_timers;		// Timers for the slot scan
+	timer_event *events;
+	int num_events, max_events;
+	int num_ids;
+	unsigned int seed;
+};
+
+// The run in progress, for the timer event hook
+static timer_test *Timer_test;
+
+static void timer_TestEvent(timer_test *test, int handle, int event, tOSIRISEventInfo *ei);
+
+static int timer_Rand(timer_test *test)
+{
+	test->seed = test->seed * 1103515245 + 12345;
+	return (test->seed >> 16) & 0x7FFF;
+}
+
+// Makes the test objects.  Nothing else uses Objects[] in the tests.
+static void timer_InitObjects(bool f_used)
+{
+	for (int i = 1; i <= TIMER_TEST_OBJECTS; i++)
+	{
+		Objects[i].type = f_used ? OBJ_ROBOT : OBJ_NONE;
+		Objects[i].handle = i + HANDLE_COUNT_INCREMENT;
+	}
+}
+
+static int timer_RandomObject(timer_test *test)
+{
+	return Objects[1 + timer_Rand(test) % TIMER_TEST_OBJECTS].handle;
+}
+
+// Kills a test object.  Some are ghosted, which sets off the timers they're the detonator for
+// but leaves their own timers running.  The rest are deleted like ObjDelete() does, and their
+// slot is used again right away with a new handle.
+static void timer_KillObject(timer_test *test)
+{
+	object *obj = &Objects[1 + timer_Rand(test) % TIMER_TEST_OBJECTS];
+
+	if ((obj->type != OBJ_GHOST) && (timer_Rand(test) % 4 == 0))
+	{
+		obj->type = OBJ_GHOST;
+		return;
+	}
+
+	obj->type = OBJ_NONE;
+	if (!test->reference)
+		Osiris_TimerObjectDeleted(obj->handle);
+
+	obj->type = OBJ_ROBOT;
+	obj->handle += HANDLE_COUNT_INCREMENT;
+}
+
+static void timer_Record(timer_test *test, int handle, int event, int id)
+{
+	if (test->num_events < test->max_events)
+	{
+		timer_event *e = &test->events[test->num_events];
+		e->handle = handle;
+		e->event = event;
+		e->id = id;
+		e->time = Gametime;
+	}
+
+	test->num_events++;
+}
+
+// The old timer code, for level and trigger timers
+static int ref_CreateTimer(ref_timer *timers, tOSIRISTIMER *ot)
+{
+	int i;
+	for (i = 0; i < TIMER_TEST_SLOTS; i++)
+	{
+		if (!(timers[i].flags & REF_USED))
+			break;
+	}
+
+	if (i >= TIMER_TEST_SLOTS)
+		return -1;
+
+	timers[i].flags = REF_USED;
+	timers[i].id = ot->id;
+	timers[i].repeat_count = 0;
+	timers[i].timer_end = ot->timer_interval + Gametime;
+	timers[i].timer_interval = ot->timer_interval;
+	timers[i].timer_next_signal = ot->timer_interval + Gametime;
+
+	if (ot->flags & OTF_TRIGGER)
+	{
+		timers[i].trignum = ot->trigger_number;
+		timers[i].flags |= REF_TRIGGER;
+	}
+	else if (ot->flags & OTF_LEVEL)
+	{
+		timers[i].flags |= REF_LEVEL;
+	}
+	else
+	{
+		timers[i].objhandle = ot->object_handle;
+	}
+
+	if (ot->flags & OTF_REPEATER)
+	{
+		timers[i].flags |= REF_REPEATCALL;
+		timers[i].repeat_count = ot->repeat_count;
+		if (ot->repeat_count != -1)
+			timers[i].timer_end = (ot->timer_interval * ot->repeat_count) + Gametime;
+	}
+
+	if (ot->flags & OTF_CANCELONDEAD)
+	{
+		timers[i].flags |= REF_CANCELONDEAD;
+		timers[i].detonator = ot->object_handle_detonator;
+	}
+
+	Osiris_timer_counter++;
+	timers[i].handle = (int)(((unsigned int)Osiris_timer_counter << TIMER_TEST_SLOT_BITS) | (unsigned int)i);
+
+	return timers[i].handle;
+}
+
+static bool ref_IsObjectTimer(ref_timer *t)
+{
+	return !(t->flags & (REF_TRIGGER | REF_LEVEL));
+}
+
+// The old code only sent an object timer's events if the object was still there
+static void ref_SendEvent(timer_test *test, ref_timer *t, int event, tOSIRISEventInfo *ei)
+{
+	if (ref_IsObjectTimer(t) && !ObjGet(t->objhandle))
+		return;
+
+	timer_TestEvent(test, t->handle, event, ei);
+}
+
+static void ref_CancelTimer(timer_test *test, int handle)
+{
+	ref_timer *timers = test->ref_timers;
+
+	for (int slot = 0; slot < TIMER_TEST_SLOTS; slot++)
+	{
+		if (timers[slot].handle == handle)
+		{
+			timers[slot].flags &= ~REF_USED;
+
+			tOSIRISEventInfo ei;
+			ei.evt_timercancel.detonated = 0;
+			ei.evt_timercancel.handle = handle;
+			ref_SendEvent(test, &timers[slot], EVT_TIMERCANCEL, &ei);
+			return;
+		}
+	}
+}
+
+static int ref_GetTimerHandle(ref_timer *timers, int id)
+{
+	for (int i = 0; i < TIMER_TEST_SLOTS; i++)
+	{
+		if ((timers[i].flags & REF_USED) && (timers[i].id == id))
+			return timers[i].handle;
+	}
+
+	return 0;
+}
+
+static void ref_ProcessTimers(timer_test *test)
+{
+	ref_timer *timers = test->ref_timers;
+	tOSIRISEventInfo ei;
+
+	for (int i = 0; i < TIMER_TEST_SLOTS; i++)
+	{
+		bool signal = false, kill = false;
+
+		if (!(timers[i].flags & REF_USED))
+			continue;
+
+		if (timers[i].flags & REF_CANCELONDEAD)
+		{
+			object *obj = ObjGet(timers[i].detonator);
+			if (!obj || (obj->type == OBJ_GHOST))
+			{
+				timers[i].flags &= ~REF_USED;
+
+				ei.evt_timercancel.detonated = 1;
+				ei.evt_timercancel.handle = timers[i].handle;
+				ref_SendEvent(test, &timers[i], EVT_TIMERCANCEL, &ei);
+				continue;
+			}
+		}
+
+		if (timers[i].timer_next_signal <= Gametime)
+		{
+			signal = true;
+
+			if (timers[i].flags & REF_REPEATCALL)
+			{
+				if (timers[i].repeat_count != -1)
+				{
+					timers[i].repeat_count--;
+					if (timers[i].repeat_count <= 0)
+					{
+						kill = true;
+						timers[i].repeat_count = 0;
+					}
+					else
+						timers[i].timer_next_signal += timers[i].timer_interval;
+				}
+				else
+					timers[i].timer_next_signal += timers[i].timer_interval;
+			}
+		}
+
+		if ((!((timers[i].flags & REF_REPEATCALL) && (timers[i].repeat_count == -1))) &&
+			timers[i].timer_end <= Gametime)
+		{
+			kill = true;
+			signal = true;
+		}
+
+		if (ref_IsObjectTimer(&timers[i]) && !ObjGet(timers[i].objhandle))
+		{
+			kill = true;
+		}
+		else if (signal)
+		{
+			ei.evt_timer.game_time = Gametime;
+			ei.evt_timer.id = timers[i].id;
+			timer_TestEvent(test, timers[i].handle, EVT_TIMER, &ei);
+		}
+
+		if (kill)
+			timers[i].flags &= ~REF_USED;
+	}
+}
+
+static void timer_Create(timer_test *test)
+{
+	tOSIRISTIMER ot;
+	memset(&ot, 0, sizeof(ot));
+
+	switch (timer_Rand(test) % 3)
+	{
+	case 0:
+		ot.flags = OTF_LEVEL;
+		break;
+
+	case 1:
+		ot.flags = OTF_TRIGGER;
+		ot.trigger_number = timer_Rand(test) % 64;
+		break;
+
+	case 2:
+		// Now and then for an object that's already gone
+		ot.object_handle = timer_RandomObject(test);
+		if ((timer_Rand(test) % 16 == 0) && ((ot.object_handle & HANDLE_COUNT_MASK) > HANDLE_COUNT_INCREMENT))
+			ot.object_handle -= HANDLE_COUNT_INCREMENT;
+		break;
+	}
+
+	if (timer_Rand(test) % 4 == 0)
+	{
+		ot.flags |= OTF_CANCELONDEAD;
+		ot.object_handle_detonator = timer_RandomObject(test);
+	}
+
+	ot.id = timer_Rand(test) % test->num_ids;
+
+	// Whole frames, so lots of timers go off in the same frame, and some go off right away
+	ot.timer_interval = (float)(timer_Rand(test) % 300) * TIMER_TEST_FRAMETIME;
+
+	if (timer_Rand(test) % 4 == 0)
+	{
+		ot.flags |= OTF_REPEATER;
+		ot.repeat_count = (timer_Rand(test) % 8 == 0) ? -1 : 1 + timer_Rand(test) % 5;
+		if (ot.timer_interval == 0.0f)
+			ot.timer_interval = TIMER_TEST_FRAMETIME;
+	}
+
+	if (test->reference)
+		ref_CreateTimer(test->ref_timers, &ot);
+	else
+		Osiris_CreateTimer(&ot);
+}
+
+static void timer_TestEvent(timer_test *test, int handle, int event, tOSIRISEventInfo *ei)
+{
+	timer_Record(test, handle, event, (event == EVT_TIMER) ? ei->evt_timer.id : ei->evt_timercancel.detonated);
+
+	if (event != EVT_TIMER)
+		return;
+
+	// Start and stop timers the way scripts do from their timer events
+	switch (timer_Rand(test) % 16)
+	{
+	case 0:
+	case 1:
+		timer_Create(test);
+		break;
+
+	case 2:
+	{
+		int id = timer_Rand(test) % test->num_ids;
+		if (test->reference)
+		{
+			int cancel = ref_GetTimerHandle(test->ref_timers, id);
+			if (cancel)
+				ref_CancelTimer(test, cancel);
+		}
+		else
+			Osiris_CancelTimerID(id);
+		break;
+	}
+
+	case 3:
+	{
+		// An older timer, which may have gone off already
+		int cancel = test->events[timer_Rand(test) % test->num_events % test->max_events].handle;
+		if (cancel == 0)
+			break;
+		if (test->reference)
+			ref_CancelTimer(test, cancel);
+		else
+			Osiris_CancelTimer(cancel);
+		break;
+	}
+
+	case 4:
+		timer_KillObject(test);
+		break;
+	}
+}
+
+// Gets the queue's timer events
+static void timer_Hook(int handle, int event, tOSIRISEventInfo *ei)
+{
+	timer_TestEvent(Timer_test, handle, event, ei);
+}
+
+// Runs the test with the queue or the slot scan.  Returns the time spent processing timers.
+static double timer_Run(timer_test *test, int num_timers)
+{
+	double process_time = 0.0;
+	int i;
+
+	test->seed = 1;
+	test->num_events = 0;
+
+	Gametime = 0.0f;
+	Osiris_timer_counter = 0;
+
+	if (test->reference)
+		memset(test->ref_timers, 0, TIMER_TEST_SLOTS * sizeof(ref_timer));
+	else
+		Osiris_InitTimers();
+
+	timer_InitObjects(true);
+
+	Timer_test = test;
+	Osiris_SetTimerEventHook(timer_Hook);
+
+	for (i = 0; i < num_timers; i++)
+		timer_Create(test);
+
+	for (int frame = 0; frame < TIMER_TEST_FRAMES; frame++)
+	{
+		Gametime += TIMER_TEST_FRAMETIME;
+
+		// Objects die between frames too
+		if (timer_Rand(test) % 4 == 0)
+			timer_KillObject(test);
+
+		auto start = std::chrono::steady_clock::now();
+		if (test->reference)
+			ref_ProcessTimers(test);
+		else
+			Osiris_ProcessTimers();
+		auto end = std::chrono::steady_clock::now();
+		process_time += std::chrono::duration<double>(end - start).count();
+
+		for (i = 0; i < TIMER_TEST_LOOKUPS; i++)
+		{
+			int id = timer_Rand(test) % test->num_ids;
+			int handle = test->reference ? ref_GetTimerHandle(test->ref_timers, id) : Osiris_GetTimerHandle(id);
+			timer_Record(test, handle, 0, id);
+		}
+	}
+
+	Osiris_SetTimerEventHook(NULL);
+	Timer_test = NULL;
+
+	timer_InitObjects(false);
+
+	return process_time;
+}
+
+int test_OsirisTimers(int count)
+{
+	int num_timers = count;
+	if (num_timers > TIMER_TEST_SLOTS)
+		num_timers = TIMER_TEST_SLOTS;
+
+	timer_test queue_test, ref_test;
+	memset(&queue_test, 0, sizeof(queue_test));
+
+	queue_test.max_events = num_timers * 16 + TIMER_TEST_FRAMES * TIMER_TEST_LOOKUPS;
+	queue_test.num_ids = num_timers / 4 + 1;
+	queue_test.events = (timer_event *)mem_malloc(queue_test.max_events * sizeof(timer_event));
+
+	ref_test = queue_test;
+	ref_test.reference = true;
+	ref_test.events = (timer_event *)mem_malloc(ref_test.max_events * sizeof(timer_event));
+	ref_test.ref_timers = (ref_timer *)mem_malloc(TIMER_TEST_SLOTS * sizeof(ref_timer));
+
+	double queue_time = timer_Run(&queue_test, num_timers);
+	double ref_time = timer_Run(&ref_test, num_timers);
+
+	printf("OSIRIS timer test, %d timers, %d frames\n\n", num_timers, TIMER_TEST_FRAMES);
+	printf("Slot scan: %d events, %.3f ms\n", ref_test.num_events, ref_time * 1000.0);
+	printf("Queue:     %d events, %.3f ms\n", queue_test.num_events, queue_time * 1000.0);
+
+	int num_checked = queue_test.num_events;
+	if (ref_test.num_events < num_checked)
+		num_checked = ref_test.num_events;
+	if (queue_test.max_events < num_checked)
+		num_checked = queue_test.max_events;
+
+	int mismatches = 0;
+	for (int i = 0; i < num_checked; i++)
+	{
+		timer_event *a = &ref_test.events[i];
+		timer_event *b = &queue_test.events[i];
+
+		if (a->handle != b->handle || a->event != b->event || a->id != b->id || a->time != b->time)
+		{
+			if (mismatches == 0)
+				printf("First mismatch at event %d: handle %d/%d event %d/%d id %d/%d time %f/%f\n", i, a->handle, b->handle,
+					a->event, b->event, a->id, b->id, a->time, b->time);
+
+			mismatches++;
+		}
+	}
+
+	if (queue_test.num_events != ref_test.num_events)
+	{
+		printf("Event counts differ\n");
+		mismatches++;
+	}
+
+	int num_detonated = 0;
+	for (int i = 0; i < num_checked; i++)
+		num_detonated += (queue_test.events[i].event == EVT_TIMERCANCEL) && queue_test.events[i].id;
+
+	printf("%d timers cancelled by their detonator dying\n", num_detonated);
+	printf("%d mismatches\n", mismatches);
+
+	mem_free(queue_test.events);
+	mem_free(ref_test.events);
+	mem_free(ref_test.ref_timers);
+
+	Osiris_InitTimers();
+
+	return mismatches;
+}
@@ -0,0 +1,185 @@
+/*
+* Descent 3
+* Copyright (C) 2024 Parallax Software
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Checks g3_RotatePointArray(), g3_ProjectPointArray() and g3_CodePointList() against the single
+// point functions.  Each pass sets up a random view, far plane and custom clip plane, and some
+// points are put exactly on the clip planes to check the edge cases.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "tests.h"
+#include "3d.h"
+#include "psrand.h"
+#include "../renderer/HardwareInternal.h"
+
+#define POINT_TEST_MAX_POINTS	64
+
+extern vector Clip_plane_point;
+
+// Returns a random float from lo to hi
+static float point_Rand(float lo, float hi)
+{
+	return lo + (hi - lo) * ((float)ps_rand() / (float)RAND_MAX);
+}
+
+// Sets up a random view, far plane and custom clip plane
+static void point_RandomView()
+{
+	vector fvec, uvec;
+
+	View_position.x = point_Rand(-3000, 3000);
+	View_position.y = point_Rand(-3000, 3000);
+	View_position.z = point_Rand(-3000, 3000);
+
+	fvec.x = point_Rand(-1, 1);
+	fvec.y = point_Rand(-1, 1);
+	fvec.z = point_Rand(-1, 1);
+	uvec.x = point_Rand(-1, 1);
+	uvec.y = point_Rand(-1, 1);
+	uvec.z = point_Rand(-1, 1);
+	vm_VectorToMatrix(&View_matrix, &fvec, &uvec, NULL);
+
+	Matrix_scale.x = point_Rand(0.5f, 2.0f);
+	Matrix_scale.y = point_Rand(0.5f, 2.0f);
+	Matrix_scale.z = 1.0f;
+	View_matrix.rvec *= Matrix_scale.x;
+	View_matrix.uvec *= Matrix_scale.y;
+
+	Far_clip_z = point_Rand(100, 5000);
+	Window_w2 = (float)(160 + ps_rand() % 800);
+	Window_h2 = (float)(120 + ps_rand() % 600);
+
+	Clip_custom = ps_rand() & 1;
+	Clip_plane.x = point_Rand(-1, 1);
+	Clip_plane.y = point_Rand(-1, 1);
+	Clip_plane.z = point_Rand(-1, 1);
+	vm_NormalizeVector(&Clip_plane);
+	Clip_plane_point.x = point_Rand(-500, 500);
+	Clip_plane_point.y = point_Rand(-500, 500);
+	Clip_plane_point.z = point_Rand(0, 1000);
+}
+
+int test_PointArrays(int count)
+{
+	vector src[POINT_TEST_MAX_POINTS];
+	g3Point single[POINT_TEST_MAX_POINTS], batch[POINT_TEST_MAX_POINTS];
+	g3Point *pointlist[POINT_TEST_MAX_POINTS];
+	int failures = 0, points_tested = 0;
+	int i, n;
+
+	printf("Point array test: %d random views, %s kernels\n\n", count, Point_array_kernels);
+
+	ps_srand(1);
+
+	for (n = 0; n < count; n++)
+	{
+		int num = 1 + ps_rand() % POINT_TEST_MAX_POINTS;
+
+		point_RandomView();
+
+		for (i = 0; i < num; i++)
+		{
+			int edge = ps_rand() % 8;
+
+			src[i].x = View_position.x + point_Rand(-6000, 6000);
+			src[i].y = View_position.y + point_Rand(-6000, 6000);
+			src[i].z = View_position.z + point_Rand(-6000, 6000);
+
+			// Put some points on the edges of the view or on the viewer
+			if (edge == 0)
+				src[i] = View_position;
+			else if (edge == 1)
+				src[i] = View_position + View_matrix.fvec * Far_clip_z;
+		}
+
+		memset(single, 0, sizeof(single));
+		memset(batch, 0, sizeof(batch));
+
+		for (i = 0; i < num; i++)
+		{
+			g3_RotatePoint(&single[i], &src[i]);
+			g3_ProjectPoint(&single[i]);
+		}
+
+		g3_RotatePointArray(batch, src, num);
+		g3_ProjectPointArray(batch, num);
+
+		// Move some of the rotated points onto the clip planes and recode them all
+		for (i = 0; i < num; i++)
+		{
+			int edge = ps_rand() % 8;
+
+			if (edge == 0)
+			{
+				single[i].p3_x = batch[i].p3_x = single[i].p3_z;
+				single[i].p3_y = batch[i].p3_y = -single[i].p3_z;
+				if (ps_rand() & 1)
+					single[i].p3_z = batch[i].p3_z = (ps_rand() & 1) ? 0.0f : -0.0f;
+			}
+			else if (edge == 1)
+			{
+				single[i].p3_z = batch[i].p3_z = Far_clip_z;
+			}
+			else if (edge == 2)
+			{
+				float d = point_Rand(-0.006f, -0.004f);
+				single[i].p3_x = batch[i].p3_x = Clip_plane_point.x + Clip_plane.x * Matrix_scale.x * d;
+				single[i].p3_y = batch[i].p3_y = Clip_plane_point.y + Clip_plane.y * Matrix_scale.y * d;
+				single[i].p3_z = batch[i].p3_z = Clip_plane_point.z + Clip_plane.z * Matrix_scale.z * d;
+			}
+		}
+
+		for (i = 0; i < num; i++)
+		{
+			g3_CodePoint(&single[i]);
+			pointlist[i] = &batch[i];
+		}
+		g3_CodePointList(num, pointlist);
+
+		for (i = 0; i < num; i++)
+		{
+			g3Point *s = &single[i], *b = &batch[i];
+
+			if (memcmp(&s->p3_vec, &b->p3_vec, sizeof(vector)) || memcmp(&s->p3_vecPreRot, &b->p3_vecPreRot, sizeof(vector)) ||
+				(s->p3_codes != b->p3_codes) || (s->p3_flags != b->p3_flags) ||
+				memcmp(&s->p3_sx, &b->p3_sx, sizeof(float)) || memcmp(&s->p3_sy, &b->p3_sy, sizeof(float)))
+			{
+				if (failures < 20)
+					printf("Mismatch on pass %d point %d: codes %02x/%02x flags %02x/%02x z %f/%f sx %f/%f\n", n, i,
+						s->p3_codes, b->p3_codes, s->p3_flags, b->p3_flags, s->p3_z, b->p3_z, s->p3_sx, b->p3_sx);
+				failures++;
+			}
+		}
+
+		points_tested += num;
+	}
+
+	printf("%d points, %d mismatches\n", points_tested, failures);
+
+	// Every x86 build has SSE2, so the scalar kernels here mean the build flags are wrong
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+	if (strcmp(Point_array_kernels, "SSE2"))
+	{
+		printf("The point array functions were built without SSE2!\n");
+		failures++;
+	}
+#endif
+
+	return failures;
+}
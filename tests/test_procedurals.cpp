@@ -0,0 +1,297 @@
+/*
+* Descent 3
+* Copyright (C) 2024 Parallax Software
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Runs water and fire textures for a fixed number of frames with the scalar procedural kernels
+// and the fast ones, checks every frame matches, and checks the last frame against the MD5 of
+// a known good image.  Then runs each kernel on random buffers both ways.
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+#include "tests.h"
+#include "procedurals_internal.h"
+#include "psrand.h"
+#include "../md5/md5.h"
+
+#define PROC_TEST_SIZE		(PROC_SIZE * PROC_SIZE)
+#define PROC_TEST_FRAMES	256
+#define PROC_TEST_TIMING	2000
+
+// MD5s of the last water and fire frames
+#define PROC_GOLDEN_WATER	"44a17390473b89a0d8d9d0f0e1e1b4f4"
+#define PROC_GOLDEN_FIRE	"45c974b9c073338daed50e8d70650543"
+
+typedef struct
+{
+	short *old_heights, *heights;
+	ubyte *fire;							// Two buffers, the second is what gets drawn
+	ushort *image;
+}proc_test_state;
+
+static ushort *Proc_src_image;
+static ushort Proc_palette[256];
+
+static void proc_AllocState(proc_test_state *st)
+{
+	st->old_heights = new short[PROC_TEST_SIZE];
+	st->heights = new short[PROC_TEST_SIZE];
+	st->fire = new ubyte[PROC_TEST_SIZE * 2];
+	st->image = new ushort[PROC_TEST_SIZE];
+
+	memset(st->old_heights, 0, PROC_TEST_SIZE * sizeof(short));
+	memset(st->heights, 0, PROC_TEST_SIZE * sizeof(short));
+	memset(st->fire, 0, PROC_TEST_SIZE * 2);
+	memset(st->image, 0, PROC_TEST_SIZE * sizeof(ushort));
+}
+
+static void proc_FreeState(proc_test_state *st)
+{
+	delete[] st->old_heights;
+	delete[] st->heights;
+	delete[] st->fire;
+	delete[] st->image;
+}
+
+// Writes the MD5 of a buffer out as hex
+static void proc_MD5(const void *data, int size, char *hex)
+{
+	unsigned char digest[16];
+	MD5 md5;
+
+	md5.MD5Init();
+	md5.MD5Update((unsigned char *)data, size);
+	md5.MD5Final(digest);
+
+	for (int i = 0; i < 16; i++)
+		sprintf(hex + i * 2, "%02x", digest[i]);
+}
+
+// Returns 1 and prints where two buffers first differ if they do
+static int proc_Compare(const char *kernel, int pass, const void *scalar, const void *fast, int size, int failures)
+{
+	if (!memcmp(scalar, fast, size))
+		return 0;
+
+	if (failures < 20)
+	{
+		int i;
+		for (i = 0; (i < size) && (((ubyte *)scalar)[i] == ((ubyte *)fast)[i]); i++)
+			;
+		printf("%s mismatch on pass %d at byte %d\n", kernel, pass, i);
+	}
+
+	return 1;
+}
+
+// Drops some water and fire on both textures and runs them for a frame, the first with the
+// scalar kernels and the second with the fast ones
+static void proc_RunFrame(proc_test_state *st, int frame, int drop, int drop_height, int spark, bool fast)
+{
+	int density = 2 + (frame / 64) % 6;
+	int lightval = 1 + (frame / 32) % 4;
+	short *temp;
+
+	st->old_heights[drop] += drop_height;
+
+	if (fast)
+		DrawWaterWithLightData(st->old_heights, Proc_src_image, st->image, lightval);
+	else
+		DrawWaterWithLightDataScalar(st->old_heights, Proc_src_image, st->image, lightval);
+
+	// The second half uses the other wave function
+	if (frame < PROC_TEST_FRAMES / 2)
+	{
+		if (fast)
+			CalcWaterData(st->old_heights, st->heights, density);
+		else
+			CalcWaterDataScalar(st->old_heights, st->heights, density);
+	}
+	else
+	{
+		if (fast)
+			CalcWater2Data(st->old_heights, st->heights, density);
+		else
+			CalcWater2DataScalar(st->old_heights, st->heights, density);
+	}
+
+	temp = st->old_heights;
+	st->old_heights = st->heights;
+	st->heights = temp;
+
+	if (fast)
+		FadeProcData(st->fire, 1 + (frame % 8));
+	else
+		FadeProcDataScalar(st->fire, 1 + (frame % 8));
+
+	st->fire[spark] = BRIGHT_COLOR;
+
+	if (fast)
+		BlendProcData(st->fire, st->fire + PROC_TEST_SIZE);
+	else
+		BlendProcDataScalar(st->fire, st->fire + PROC_TEST_SIZE);
+
+	memcpy(st->fire, st->fire + PROC_TEST_SIZE, PROC_TEST_SIZE);
+}
+
+// Fills a height field with random heights.  Some of them are near the limits of a short, so
+// the sums overflow the way they can in a game.
+static void proc_RandomHeights(short *data, int range)
+{
+	for (int i = 0; i < PROC_TEST_SIZE; i++)
+	{
+		if ((ps_rand() % 64) == 0)
+			data[i] = (short)((ps_rand() << 1) ^ (ps_rand() << 9));
+		else
+			data[i] = (short)((ps_rand() % (range * 2 + 1)) - range);
+	}
+}
+
+int test_ProcKernels(int count)
+{
+	proc_test_state scalar, fast;
+	ushort fire_image[PROC_TEST_SIZE];
+	char water_md5[33], fire_md5[33];
+	int failures = 0;
+	int i, n;
+
+	printf("Procedural kernel test, %s kernels\n\n", Proc_kernels);
+
+	InitWaterProcTables();
+
+	Proc_src_image = new ushort[PROC_TEST_SIZE];
+	proc_AllocState(&scalar);
+	proc_AllocState(&fast);
+
+	ps_srand(1);
+
+	for (i = 0; i < PROC_TEST_SIZE; i++)
+		Proc_src_image[i] = (ushort)((ps_rand() << 1) ^ ps_rand());
+	for (i = 0; i < 256; i++)
+		Proc_palette[i] = (ushort)((ps_rand() << 1) ^ ps_rand());
+
+	// Whole textures over a run of frames
+	for (n = 0; n < PROC_TEST_FRAMES; n++)
+	{
+		int drop = ps_rand() % PROC_TEST_SIZE;
+		int drop_height = 200 + ps_rand() % 2000;
+		int spark = ps_rand() % PROC_TEST_SIZE;
+
+		proc_RunFrame(&scalar, n, drop, drop_height, spark, false);
+		proc_RunFrame(&fast, n, drop, drop_height, spark, true);
+
+		failures += proc_Compare("Water frame", n, scalar.image, fast.image, PROC_TEST_SIZE * sizeof(ushort), failures);
+		failures += proc_Compare("Fire frame", n, scalar.fire, fast.fire, PROC_TEST_SIZE, failures);
+	}
+
+	proc_MD5(scalar.image, PROC_TEST_SIZE * sizeof(ushort), water_md5);
+
+	for (i = 0; i < PROC_TEST_SIZE; i++)
+		fire_image[i] = Proc_palette[scalar.fire[i]];
+	proc_MD5(fire_image, PROC_TEST_SIZE * sizeof(ushort), fire_md5);
+
+	printf("%d frames of water and fire\n", PROC_TEST_FRAMES);
+	printf("Water %s, expected %s\n", water_md5, PROC_GOLDEN_WATER);
+	printf("Fire  %s, expected %s\n\n", fire_md5, PROC_GOLDEN_FIRE);
+
+	if (strcmp(water_md5, PROC_GOLDEN_WATER))
+		failures++;
+	if (strcmp(fire_md5, PROC_GOLDEN_FIRE))
+		failures++;
+
+	// Kernels on random buffers
+	for (n = 0; n < count; n++)
+	{
+		int density = ps_rand() % 12;
+		int lightval = ps_rand() % 10;
+		int fadeval = 1 + ps_rand() % 32;
+
+		proc_RandomHeights(scalar.old_heights, 1 + ps_rand() % 2000);
+		proc_RandomHeights(scalar.heights, 1 + ps_rand() % 2000);
+		memcpy(fast.heights, scalar.heights, PROC_TEST_SIZE * sizeof(short));
+
+		CalcWaterDataScalar(scalar.old_heights, scalar.heights, density);
+		CalcWaterData(scalar.old_heights, fast.heights, density);
+		failures += proc_Compare("CalcWater", n, scalar.heights, fast.heights, PROC_TEST_SIZE * sizeof(short), failures);
+
+		CalcWater2DataScalar(scalar.old_heights, scalar.heights, density);
+		CalcWater2Data(scalar.old_heights, fast.heights, density);
+		failures += proc_Compare("CalcWater2", n, scalar.heights, fast.heights, PROC_TEST_SIZE * sizeof(short), failures);
+
+		DrawWaterWithLightDataScalar(scalar.old_heights, Proc_src_image, scalar.image, lightval);
+		DrawWaterWithLightData(scalar.old_heights, Proc_src_image, fast.image, lightval);
+		failures += proc_Compare("DrawWaterWithLight", n, scalar.image, fast.image, PROC_TEST_SIZE * sizeof(ushort), failures);
+
+		for (i = 0; i < PROC_TEST_SIZE; i++)
+			scalar.fire[i] = (ubyte)ps_rand();
+		memcpy(fast.fire, scalar.fire, PROC_TEST_SIZE);
+
+		FadeProcDataScalar(scalar.fire, fadeval);
+		FadeProcData(fast.fire, fadeval);
+		failures += proc_Compare("Fade", n, scalar.fire, fast.fire, PROC_TEST_SIZE, failures);
+
+		BlendProcDataScalar(scalar.fire, scalar.fire + PROC_TEST_SIZE);
+		BlendProcData(fast.fire, fast.fire + PROC_TEST_SIZE);
+		failures += proc_Compare("Blend", n, scalar.fire + PROC_TEST_SIZE, fast.fire + PROC_TEST_SIZE, PROC_TEST_SIZE, failures);
+	}
+
+	printf("%d passes of each kernel on random buffers, %d failures\n\n", count, failures);
+
+	// Every x86 build has SSE2, so the scalar kernels here mean the build flags are wrong
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+	if (strcmp(Proc_kernels, "SSE2"))
+	{
+		printf("The procedural kernels were built without SSE2!\n\n");
+		failures++;
+	}
+#endif
+
+	// Time both
+	for (int pass = 0; pass < 2; pass++)
+	{
+		auto start_time = std::chrono::steady_clock::now();
+
+		for (n = 0; n < PROC_TEST_TIMING; n++)
+		{
+			if (pass == 0)
+			{
+				DrawWaterWithLightDataScalar(scalar.old_heights, Proc_src_image, scalar.image, 2);
+				CalcWaterDataScalar(scalar.old_heights, scalar.heights, 4);
+				FadeProcDataScalar(scalar.fire, 4);
+				BlendProcDataScalar(scalar.fire, scalar.fire + PROC_TEST_SIZE);
+			}
+			else
+			{
+				DrawWaterWithLightData(scalar.old_heights, Proc_src_image, scalar.image, 2);
+				CalcWaterData(scalar.old_heights, scalar.heights, 4);
+				FadeProcData(scalar.fire, 4);
+				BlendProcData(scalar.fire, scalar.fire + PROC_TEST_SIZE);
+			}
+		}
+
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+		printf("%s: %.3f ms for %d water and fire textures (%.1f us a pair)\n", pass ? "Kernels" : "Scalar", elapsed * 1000.0,
+			PROC_TEST_TIMING, elapsed * 1.0e6 / PROC_TEST_TIMING);
+	}
+
+	proc_FreeState(&scalar);
+	proc_FreeState(&fast);
+	delete[] Proc_src_image;
+
+	return failures;
+}
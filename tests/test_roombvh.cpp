@@ -0,0 +1,420 @@
+/*
+* Descent 3
+* Copyright (C) 2024 Parallax Software
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Compares the room BVHs against the bbf region walk on random queries in a test mine
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#include "tests.h"
+#include "findintersection.h"
+#include "room.h"
+#include "object.h"
+#include "BOA.h"
+#include "mem.h"
+#include "psrand.h"
+
+// The test mine is a row of box rooms along x.  Each wall is a grid of square faces, and the
+// middle MINE_PORTAL_CELLS x MINE_PORTAL_CELLS faces of each wall between two rooms are portals.
+#define MINE_NUM_ROOMS 4
+#define MINE_ROOM_SIZE 200.0f
+#define MINE_WALL_CELLS 12
+#define MINE_WALL_VERTS ((MINE_WALL_CELLS + 1) * (MINE_WALL_CELLS + 1))
+#define MINE_PORTAL_CELLS 4
+#define MINE_PORTAL_FIRST ((MINE_WALL_CELLS - MINE_PORTAL_CELLS) / 2)
+#define MINE_WALL_PORTALS (MINE_PORTAL_CELLS * MINE_PORTAL_CELLS)
+
+// Builds one room of the test mine.  Wall w is on axis w / 2, at the low end of the room if w
+// is even and the high end if it's odd.
+static void mine_BuildRoom(int roomnum)
+{
+	room *rp = &Rooms[roomnum];
+	int num_portals = ((roomnum > 0) + (roomnum < MINE_NUM_ROOMS - 1)) * MINE_WALL_PORTALS;
+	float cell_size = MINE_ROOM_SIZE / MINE_WALL_CELLS;
+	vector room_min, center;
+	int w, a, b;
+
+	InitRoom(rp, 6 * MINE_WALL_VERTS, 6 * MINE_WALL_CELLS * MINE_WALL_CELLS, num_portals);
+
+	room_min.x = roomnum * MINE_ROOM_SIZE;
+	room_min.y = room_min.z = 0;
+	center = room_min;
+	center.x += MINE_ROOM_SIZE / 2;
+	center.y += MINE_ROOM_SIZE / 2;
+	center.z += MINE_ROOM_SIZE / 2;
+
+	for (w = 0; w < 6; w++)
+	{
+		int axis = w / 2;
+		int u = (axis + 1) % 3;
+		int v = (axis + 2) % 3;
+
+		for (a = 0; a <= MINE_WALL_CELLS; a++)
+		{
+			for (b = 0; b <= MINE_WALL_CELLS; b++)
+			{
+				float *pos = &rp->verts[w * MINE_WALL_VERTS + a * (MINE_WALL_CELLS + 1) + b].x;
+
+				pos[axis] = (&room_min.x)[axis] + ((w & 1) ? MINE_ROOM_SIZE : 0);
+				pos[u] = (&room_min.x)[u] + a * cell_size;
+				pos[v] = (&room_min.x)[v] + b * cell_size;
+			}
+		}
+
+		for (a = 0; a < MINE_WALL_CELLS; a++)
+		{
+			for (b = 0; b < MINE_WALL_CELLS; b++)
+			{
+				int facenum = (w * MINE_WALL_CELLS + a) * MINE_WALL_CELLS + b;
+				face *fp = &rp->faces[facenum];
+				int v0 = w * MINE_WALL_VERTS + a * (MINE_WALL_CELLS + 1) + b;
+
+				InitRoomFace(fp, 4);
+				fp->face_verts[0] = v0;
+				fp->face_verts[1] = v0 + 1;
+				fp->face_verts[2] = v0 + MINE_WALL_CELLS + 2;
+				fp->face_verts[3] = v0 + MINE_WALL_CELLS + 1;
+				ComputeFaceNormal(rp, facenum);
+
+				// Faces point into the room
+				vector to_center = center - rp->verts[v0];
+				if (fp->normal * to_center < 0)
+				{
+					short t = fp->face_verts[1];
+					fp->face_verts[1] = fp->face_verts[3];
+					fp->face_verts[3] = t;
+					ComputeFaceNormal(rp, facenum);
+				}
+			}
+		}
+	}
+
+	// Portals to the rooms on either side.  A room's portals on its low x wall come first, so
+	// portal n of the high x wall connects to portal n of the next room.
+	int p = 0;
+	for (w = 0; w < 2; w++)
+	{
+		int croom = roomnum + (w ? 1 : -1);
+		if (croom < 0 || croom >= MINE_NUM_ROOMS)
+			continue;
+
+		for (int n = 0; n < MINE_WALL_PORTALS; n++, p++)
+		{
+			portal *pp = &rp->portals[p];
+			a = MINE_PORTAL_FIRST + n / MINE_PORTAL_CELLS;
+			b = MINE_PORTAL_FIRST + n % MINE_PORTAL_CELLS;
+			int facenum = (w * MINE_WALL_CELLS + a) * MINE_WALL_CELLS + b;
+
+			memset(pp, 0, sizeof(portal));
+			pp->portal_face = facenum;
+			pp->croom = croom;
+			pp->cportal = (w || croom == 0) ? n : MINE_WALL_PORTALS + n;
+			pp->bnode_index = -1;
+			pp->combine_master = -1;
+			ComputeCenterPointOnFace(&pp->path_pnt, rp, facenum);
+
+			rp->faces[facenum].portal_num = p;
+		}
+	}
+}
+
+// Builds the test mine and its bbf regions and BVHs.  There are no objects in it.
+static void mine_Build()
+{
+	InitObjects();
+
+	for (int i = 0; i < MINE_NUM_ROOMS; i++)
+	{
+		mine_BuildRoom(i);
+		Highest_room_index = i;
+	}
+
+	ComputeAABB(true);
+}
+
+#define BENCH_MAX_RAY_LENGTH 200.0f
+#define BENCH_MAX_SPHERE_RAD 6.0f
+#define BENCH_MAX_FACE_LIST 200
+#define BENCH_FAN_SIZE 8
+
+typedef struct
+{
+	vector p0, p1;
+	int startroom;
+	float rad;
+} bench_query;
+
+// Random float from 0 to 1
+static inline float bench_Rand()
+{
+	return (float)ps_rand() / (float)RAND_MAX;
+}
+
+// Picks a random point inside a random room of the test mine
+static bool bench_PickPoint(vector *pos, int *roomnum)
+{
+	for (int tries = 0; tries < 100; tries++)
+	{
+		int r = ps_rand() % (Highest_room_index + 1);
+		room *rp = &Rooms[r];
+
+		if (!rp->used || (rp->flags & RF_EXTERNAL) || rp->num_faces == 0)
+			continue;
+
+		for (int i = 0; i < 16; i++)
+		{
+			pos->x = rp->min_xyz.x + bench_Rand() * (rp->max_xyz.x - rp->min_xyz.x);
+			pos->y = rp->min_xyz.y + bench_Rand() * (rp->max_xyz.y - rp->min_xyz.y);
+			pos->z = rp->min_xyz.z + bench_Rand() * (rp->max_xyz.z - rp->min_xyz.z);
+
+			if (fvi_QuickRoomCheck(pos, rp))
+			{
+				*roomnum = r;
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+// Runs every query with the BVH on or off.  Returns the time taken in seconds.
+static double bench_RunFVI(const bench_query *queries, int num_queries, fvi_info *results, bool use_bvh)
+{
+	FVI_use_room_bvh = use_bvh;
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < num_queries; i++)
+	{
+		fvi_query fq;
+		memset(&fq, 0, sizeof(fvi_query));
+		vector p0 = queries[i].p0;
+		vector p1 = queries[i].p1;
+
+		fq.p0 = &p0;
+		fq.p1 = &p1;
+		fq.startroom = queries[i].startroom;
+		fq.rad = queries[i].rad;
+		fq.thisobjnum = -1;
+		fq.ignore_obj_list = NULL;
+		fq.flags = 0;
+
+		memset(&results[i], 0, sizeof(fvi_info));
+		fvi_FindIntersection(&fq, &results[i]);
+	}
+
+	auto end = std::chrono::steady_clock::now();
+
+	FVI_use_room_bvh = true;
+	return std::chrono::duration<double>(end - start).count();
+}
+
+// Runs every query one at a time, or all together through fvi_FindIntersectionBatch.  Every
+// BENCH_FAN_SIZE queries share a start point, like a robot checking several targets.  Returns the
+// time taken in seconds.
+static double bench_RunFVIFan(const bench_query *queries, int num_queries, fvi_query *fq, vector *points, fvi_info *results, bool batch)
+{
+	int i;
+
+	for (i = 0; i < num_queries; i++)
+	{
+		const bench_query *fan = &queries[i - (i % BENCH_FAN_SIZE)];
+
+		points[i * 2] = fan->p0;
+		points[i * 2 + 1] = fan->p0 + (queries[i].p1 - queries[i].p0);
+
+		memset(&fq[i], 0, sizeof(fvi_query));
+		fq[i].p0 = &points[i * 2];
+		fq[i].p1 = &points[i * 2 + 1];
+		fq[i].startroom = fan->startroom;
+		fq[i].rad = queries[i].rad;
+		fq[i].thisobjnum = -1;
+		fq[i].ignore_obj_list = NULL;
+		fq[i].flags = 0;
+
+		memset(&results[i], 0, sizeof(fvi_info));
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	if (batch)
+	{
+		fvi_FindIntersectionBatch(num_queries, fq, results);
+	}
+	else
+	{
+		for (i = 0; i < num_queries; i++)
+			fvi_FindIntersection(&fq[i], &results[i]);
+	}
+
+	auto end = std::chrono::steady_clock::now();
+
+	return std::chrono::duration<double>(end - start).count();
+}
+
+// Runs fvi_QuickDistFaceList for every query with the BVH on or off.  Returns the time taken.
+static double bench_RunFaceList(const bench_query *queries, int num_queries, fvi_face_room_list *lists, int *counts, bool use_bvh)
+{
+	FVI_use_room_bvh = use_bvh;
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < num_queries; i++)
+	{
+		vector pos = queries[i].p0;
+
+		memset(&lists[i * BENCH_MAX_FACE_LIST], 0, BENCH_MAX_FACE_LIST * sizeof(fvi_face_room_list));
+		counts[i] = fvi_QuickDistFaceList(queries[i].startroom, &pos, queries[i].rad * 10.0f, &lists[i * BENCH_MAX_FACE_LIST], BENCH_MAX_FACE_LIST);
+	}
+
+	auto end = std::chrono::steady_clock::now();
+
+	FVI_use_room_bvh = true;
+	return std::chrono::duration<double>(end - start).count();
+}
+
+// Fires count random rays, spheres and face list queries through the test mine with and without
+// the room BVHs.  Returns the number of queries whose results differ.
+int test_RoomBVH(int count)
+{
+	int failures = 0;
+	int i;
+
+	mine_Build();
+
+	bench_query *queries = (bench_query *)mem_malloc(count * sizeof(bench_query));
+	fvi_info *old_results = (fvi_info *)mem_malloc(count * sizeof(fvi_info));
+	fvi_info *new_results = (fvi_info *)mem_malloc(count * sizeof(fvi_info));
+	int num_valid = 0;
+
+	// Same queries every run
+	ps_srand(1);
+
+	for (i = 0; i < count; i++)
+	{
+		bench_query *q = &queries[num_valid];
+		vector dir;
+
+		if (!bench_PickPoint(&q->p0, &q->startroom))
+			break;
+
+		dir.x = bench_Rand() * 2.0f - 1.0f;
+		dir.y = bench_Rand() * 2.0f - 1.0f;
+		dir.z = bench_Rand() * 2.0f - 1.0f;
+		if (vm_NormalizeVector(&dir) == 0.0f)
+			continue;
+
+		q->p1 = q->p0 + dir * (bench_Rand() * BENCH_MAX_RAY_LENGTH);
+
+		// Half rays, half spheres
+		q->rad = (i & 1) ? bench_Rand() * BENCH_MAX_SPHERE_RAD : 0.0f;
+
+		num_valid++;
+	}
+
+	printf("Room BVH test, %d queries in %d rooms\n\n", num_valid, MINE_NUM_ROOMS);
+
+	if (num_valid == 0)
+	{
+		printf("Couldn't find any points inside the test mine\n");
+		failures++;
+	}
+
+	// Rays and spheres
+	double old_time = bench_RunFVI(queries, num_valid, old_results, false);
+	double new_time = bench_RunFVI(queries, num_valid, new_results, true);
+	int mismatches = 0;
+
+	for (i = 0; i < num_valid; i++)
+	{
+		if (memcmp(&old_results[i], &new_results[i], sizeof(fvi_info)))
+		{
+			if (mismatches < 20)
+				printf("Mismatch: query %d room %d rad %f hit %d/%d face %d/%d\n", i, queries[i].startroom, queries[i].rad,
+					old_results[i].hit_type[0], new_results[i].hit_type[0], old_results[i].hit_face[0], new_results[i].hit_face[0]);
+			mismatches++;
+		}
+	}
+
+	printf("fvi_FindIntersection: regions %.3f ms, BVH %.3f ms, %d mismatches\n", old_time * 1000.0, new_time * 1000.0, mismatches);
+	failures += mismatches;
+
+	// Fans of rays from shared start points, one at a time and batched
+	fvi_query *fan_fq = (fvi_query *)mem_malloc(num_valid * sizeof(fvi_query));
+	vector *fan_points = (vector *)mem_malloc(num_valid * 2 * sizeof(vector));
+
+	old_time = bench_RunFVIFan(queries, num_valid, fan_fq, fan_points, old_results, false);
+	new_time = bench_RunFVIFan(queries, num_valid, fan_fq, fan_points, new_results, true);
+	mismatches = 0;
+
+	for (i = 0; i < num_valid; i++)
+	{
+		if (memcmp(&old_results[i], &new_results[i], sizeof(fvi_info)))
+		{
+			if (mismatches < 20)
+				printf("Mismatch: fan query %d room %d rad %f hit %d/%d face %d/%d\n", i, fan_fq[i].startroom, fan_fq[i].rad,
+					old_results[i].hit_type[0], new_results[i].hit_type[0], old_results[i].hit_face[0], new_results[i].hit_face[0]);
+			mismatches++;
+		}
+	}
+
+	printf("fvi_FindIntersectionBatch: single %.3f ms, batched %.3f ms, %d mismatches\n", old_time * 1000.0, new_time * 1000.0, mismatches);
+	failures += mismatches;
+
+	mem_free(fan_fq);
+	mem_free(fan_points);
+	mem_free(old_results);
+	mem_free(new_results);
+
+	// Face lists
+	fvi_face_room_list *old_lists = (fvi_face_room_list *)mem_malloc(num_valid * BENCH_MAX_FACE_LIST * sizeof(fvi_face_room_list));
+	fvi_face_room_list *new_lists = (fvi_face_room_list *)mem_malloc(num_valid * BENCH_MAX_FACE_LIST * sizeof(fvi_face_room_list));
+	int *old_counts = (int *)mem_malloc(num_valid * sizeof(int));
+	int *new_counts = (int *)mem_malloc(num_valid * sizeof(int));
+
+	old_time = bench_RunFaceList(queries, num_valid, old_lists, old_counts, false);
+	new_time = bench_RunFaceList(queries, num_valid, new_lists, new_counts, true);
+	mismatches = 0;
+
+	for (i = 0; i < num_valid; i++)
+	{
+		if (old_counts[i] != new_counts[i] ||
+			 memcmp(&old_lists[i * BENCH_MAX_FACE_LIST], &new_lists[i * BENCH_MAX_FACE_LIST], BENCH_MAX_FACE_LIST * sizeof(fvi_face_room_list)))
+		{
+			if (mismatches < 20)
+				printf("Mismatch: face list %d room %d, %d faces vs %d\n", i, queries[i].startroom, old_counts[i], new_counts[i]);
+			mismatches++;
+		}
+	}
+
+	printf("fvi_QuickDistFaceList: regions %.3f ms, BVH %.3f ms, %d mismatches\n", old_time * 1000.0, new_time * 1000.0, mismatches);
+	failures += mismatches;
+
+	mem_free(old_lists);
+	mem_free(new_lists);
+	mem_free(old_counts);
+	mem_free(new_counts);
+	mem_free(queries);
+
+	FreeAllRooms();
+
+	return failures;
+}
@@ -0,0 +1,98 @@
+/*
+* Descent 3
+* Copyright (C) 2024 Parallax Software
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Unit tests and benchmarks for the engine.  They link against the same code as the game but
+// don't start it up, so each test sets up only what it uses.
+//
+//		PiccuTests <test> [count]
+//
+// The exit code is nonzero if the test found any failures.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tests.h"
+#include "fix.h"
+#include "mem.h"
+
+// Checked by Error().  There's no window to put a message box in.
+int no_debug_dialog = 1;
+
+typedef struct
+{
+	const char *name;
+	int (*func)(int count);
+	int default_count;
+} test_entry;
+
+static test_entry Tests[] =
+{
+	{"roombvh", test_RoomBVH, 20000},
+	{"boapaths", test_BOAPaths, 100},
+	{"osiristimers", test_OsirisTimers, 20000},
+	{"multisnap", test_MultiSnap, 2000},
+	{"netbench", test_NetBench, 100000},
+	{"reliable", test_Reliable, 100},
+	{"lightmap", test_LightmapKernel, 100000},
+	{"procedurals", test_ProcKernels, 1000},
+	{"points", test_PointArrays, 10000},
+	{"cfileread", test_CFileRead, 2000},
+};
+
+#define NUM_TESTS ((int)(sizeof(Tests) / sizeof(Tests[0])))
+
+int main(int argc, char *argv[])
+{
+	int i;
+
+	if (argc < 2)
+	{
+		printf("Usage: %s <test> [count]\nTests:", argv[0]);
+		for (i = 0; i < NUM_TESTS; i++)
+			printf(" %s", Tests[i].name);
+		printf("\n");
+		return 1;
+	}
+
+	for (i = 0; i < NUM_TESTS; i++)
+	{
+		if (!strcmp(argv[1], Tests[i].name))
+			break;
+	}
+
+	if (i == NUM_TESTS)
+	{
+		printf("Unknown test %s\n", argv[1]);
+		return 1;
+	}
+
+	int count = (argc > 2) ? atoi(argv[2]) : 0;
+	if (count <= 0)
+		count = Tests[i].default_count;
+
+	mem_Init();
+	InitMathTables();
+
+	int failures = Tests[i].func(count);
+
+	printf("\n%s: %s (%d failures)\n", Tests[i].name, failures ? "FAILED" : "Passed", failures);
+	fflush(stdout);
+
+	return failures ? 1 : 0;
+}
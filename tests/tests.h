@@ -0,0 +1,65 @@
+/*
+* Descent 3
+* Copyright (C) 2024 Parallax Software
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TESTS_H
+#define TESTS_H
+
+// Every test takes a count (queries, iterations, etc.), prints what it checked to stdout and
+// returns the number of failures
+
+// Fires random rays, spheres and face list queries through a test mine with and without the
+// room BVHs
+int test_RoomBVH(int count);
+
+// Finds the paths between every pair of rooms in count random mines with FindPath() and with the
+// path trees, and checks BOA_Array comes out the same both ways
+int test_BOAPaths(int count);
+
+// Runs count random level, trigger and object timers through the OSIRIS timer queue and a copy
+// of the old scan of every timer slot, and checks that both send the same events in the same order
+int test_OsirisTimers(int count);
+
+// Fuzzes the robot snapshot encoder and decoder count times, then sends count ticks of robots
+// over a lossy link
+int test_MultiSnap(int count);
+
+// Sends count packets over loopback one system call at a time, through nw_SendWithID(), and in
+// send batches, and times each
+int test_NetBench(int count);
+
+// Sends count messages each way between two reliable sockets over loopback links with more and
+// more loss and latency, and checks they all arrive once and in order
+int test_Reliable(int count);
+
+// Lights count random lightmap rows with the dynamic lighting kernel and the scalar code and
+// checks that they match bit for bit
+int test_LightmapKernel(int count);
+
+// Runs water and fire procedurals for a set number of frames and checks the images against
+// known good ones, then checks the fast kernels against the scalar ones on count random buffers
+int test_ProcKernels(int count);
+
+// Rotates, projects and codes points count times with the point array functions and the single
+// point ones, and checks that they match
+int test_PointArrays(int count);
+
+// Writes a file of count chunks laid out like a level and reads it back a value at a time through
+// cfile and through stdio, checks the values and times both
+int test_CFileRead(int count);
+
+#endif